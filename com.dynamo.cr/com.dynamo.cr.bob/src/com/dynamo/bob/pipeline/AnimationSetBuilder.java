@@ -37,7 +37,7 @@ import com.dynamo.rig.proto.Rig.AnimationSetDesc;
 import com.dynamo.rig.proto.Rig.AnimationInstanceDesc;
 import com.google.protobuf.TextFormat;
 
-@BuilderParams(name="AnimationSet", inExts=".animationset", outExt=".animationsetc", isCacheble = true)
+@BuilderParams(name="AnimationSet", inExts=".animationset", outExt=".animationsetc", isCacheble = true, paramsForSignature = {"model-compress-animations"})
 public class AnimationSetBuilder extends Builder  {
 
     public static void collectAnimations(Task.TaskBuilder taskBuilder, Project project, IResource owner, AnimationSetDesc.Builder animSetDescBuilder) throws IOException, CompileExceptionError  {
@@ -251,6 +251,10 @@ public class AnimationSetBuilder extends Builder  {
         String suffix = BuilderUtil.getSuffix(task.input(0).getPath());
         buildAnimations(task, suffix.equals("animationset"), dataResolver, animSetDescBuilder, animationSetBuilder, "", animFiles);
 
+        if (this.project.option("model-compress-animations", "false").equals("true")) {
+            ModelUtil.compressAnimationTracks(animationSetBuilder);
+        }
+
         // write merged animationset
         ByteArrayOutputStream out = new ByteArrayOutputStream(64 * 1024);
         animationSetBuilder.build().writeTo(out);
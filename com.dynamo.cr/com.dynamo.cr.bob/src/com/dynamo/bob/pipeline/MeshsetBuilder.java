@@ -34,7 +34,7 @@ import com.dynamo.rig.proto.Rig.MeshSet;
 import com.dynamo.rig.proto.Rig.Skeleton;
 
 
-@BuilderParams(name="Meshset", inExts={".gltf",".glb"}, outExt=".meshsetc", paramsForSignature = {"model-split-large-meshes"})
+@BuilderParams(name="Meshset", inExts={".gltf",".glb"}, outExt=".meshsetc", paramsForSignature = {"model-split-large-meshes", "model-compress-animations"})
 public class MeshsetBuilder extends Builder  {
     public static class ResourceDataResolver implements ModelImporterJni.DataResolver
     {
@@ -137,6 +137,9 @@ public class MeshsetBuilder extends Builder  {
             AnimationSet.Builder animationSetBuilder = AnimationSet.newBuilder();
             if (ModelUtil.getNumAnimations(scene) > 0) {
                 ModelUtil.loadAnimations(scene, animationSetBuilder, "", new ArrayList<String>());
+                if (this.project.option("model-compress-animations", "false").equals("true")) {
+                    ModelUtil.compressAnimationTracks(animationSetBuilder);
+                }
             }
 
             ByteArrayOutputStream out = new ByteArrayOutputStream(64 * 1024);
@@ -340,6 +340,140 @@ public class ModelUtil {
         }
     }
 
+    // Compressed tracks store each sample in 48 bits (see AnimationTrack in rig_ddf.proto)
+    private static final int COMPRESSED_SAMPLE_SIZE = 6;
+    private static final double QUAT_COMPONENT_RANGE = Math.sqrt(0.5);
+    private static final float CONSTANT_TRACK_EPSILON = 0.00001f;
+
+    private static void writeCompressedSample(ByteBuffer buffer, long value) {
+        for (int i = 0; i < COMPRESSED_SAMPLE_SIZE; ++i) {
+            buffer.put((byte)((value >> (i * 8)) & 0xFF));
+        }
+    }
+
+    // Returns true if all samples are equal to the first one
+    private static boolean isConstantTrack(List<Float> values, int dim) {
+        for (int i = dim; i < values.size(); ++i) {
+            if (Math.abs(values.get(i) - values.get(i % dim)) > CONSTANT_TRACK_EPSILON) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Quantizes each component to 16 bits within the [min, min+extent] range of the track
+    private static ByteString compressVec3Track(List<Float> values, List<Float> outRange) {
+        float[] min = new float[] { Float.MAX_VALUE, Float.MAX_VALUE, Float.MAX_VALUE };
+        float[] max = new float[] { -Float.MAX_VALUE, -Float.MAX_VALUE, -Float.MAX_VALUE };
+        for (int i = 0; i < values.size(); ++i) {
+            min[i % 3] = Math.min(min[i % 3], values.get(i));
+            max[i % 3] = Math.max(max[i % 3], values.get(i));
+        }
+        for (int c = 0; c < 3; ++c) {
+            outRange.add(min[c]);
+        }
+        for (int c = 0; c < 3; ++c) {
+            outRange.add(max[c] - min[c]);
+        }
+
+        int sampleCount = values.size() / 3;
+        ByteBuffer buffer = ByteBuffer.allocate(sampleCount * COMPRESSED_SAMPLE_SIZE);
+        for (int s = 0; s < sampleCount; ++s) {
+            long value = 0;
+            for (int c = 0; c < 3; ++c) {
+                float extent = max[c] - min[c];
+                long q = 0;
+                if (extent > 0.0f) {
+                    q = Math.round((values.get(s * 3 + c) - min[c]) / extent * 65535.0);
+                    q = Math.max(0, Math.min(65535, q));
+                }
+                value |= q << (c * 16);
+            }
+            writeCompressedSample(buffer, value);
+        }
+        return ByteString.copyFrom(buffer.array());
+    }
+
+    // Smallest three encoding: the largest component is dropped (and made positive), the other three
+    // are quantized to 15 bits each
+    private static ByteString compressQuatTrack(List<Float> values) {
+        int sampleCount = values.size() / 4;
+        ByteBuffer buffer = ByteBuffer.allocate(sampleCount * COMPRESSED_SAMPLE_SIZE);
+        double[] q = new double[4];
+        for (int s = 0; s < sampleCount; ++s) {
+            double length = 0.0;
+            for (int c = 0; c < 4; ++c) {
+                q[c] = values.get(s * 4 + c);
+                length += q[c] * q[c];
+            }
+            length = Math.sqrt(length);
+
+            int largest = 0;
+            for (int c = 0; c < 4; ++c) {
+                q[c] = length > 0.0 ? q[c] / length : (c == 3 ? 1.0 : 0.0);
+                if (Math.abs(q[c]) > Math.abs(q[largest])) {
+                    largest = c;
+                }
+            }
+            double sign = q[largest] < 0.0 ? -1.0 : 1.0;
+
+            long value = (long)largest << 45;
+            int shift = 30;
+            for (int c = 0; c < 4; ++c) {
+                if (c == largest) {
+                    continue;
+                }
+                double n = (sign * q[c] / QUAT_COMPONENT_RANGE + 1.0) * 0.5;
+                long v = Math.max(0, Math.min(32767, Math.round(n * 32767.0)));
+                value |= v << shift;
+                shift -= 15;
+            }
+            writeCompressedSample(buffer, value);
+        }
+        return ByteString.copyFrom(buffer.array());
+    }
+
+    // Replaces the float samples of the bone tracks with quantized samples, and collapses constant tracks into a single sample
+    public static void compressAnimationTracks(Rig.AnimationSet.Builder animationSetBuilder) {
+        for (Rig.RigAnimation.Builder animBuilder : animationSetBuilder.getAnimationsBuilderList()) {
+            for (Rig.AnimationTrack.Builder trackBuilder : animBuilder.getTracksBuilderList()) {
+                List<Float> positions = new ArrayList<>(trackBuilder.getPositionsList());
+                if (positions.size() > 3) {
+                    trackBuilder.clearPositions();
+                    if (isConstantTrack(positions, 3)) {
+                        trackBuilder.addAllPositions(positions.subList(0, 3));
+                    } else {
+                        List<Float> range = new ArrayList<>();
+                        trackBuilder.setCompressedPositions(compressVec3Track(positions, range));
+                        trackBuilder.addAllPositionsRange(range);
+                    }
+                }
+
+                List<Float> rotations = new ArrayList<>(trackBuilder.getRotationsList());
+                if (rotations.size() > 4) {
+                    trackBuilder.clearRotations();
+                    if (isConstantTrack(rotations, 4)) {
+                        trackBuilder.addAllRotations(rotations.subList(0, 4));
+                    } else {
+                        trackBuilder.setCompressedRotations(compressQuatTrack(rotations));
+                    }
+                }
+
+                List<Float> scale = new ArrayList<>(trackBuilder.getScaleList());
+                if (scale.size() > 3) {
+                    trackBuilder.clearScale();
+                    if (isConstantTrack(scale, 3)) {
+                        trackBuilder.addAllScale(scale.subList(0, 3));
+                    } else {
+                        List<Float> range = new ArrayList<>();
+                        trackBuilder.setCompressedScale(compressVec3Track(scale, range));
+                        trackBuilder.addAllScaleRange(range);
+                    }
+                }
+            }
+        }
+    }
+
     public static void loadAnimations(byte[] content, String suffix, Modelimporter.Options options, ModelImporterJni.DataResolver dataResolver,
                                         Rig.AnimationSet.Builder animationSetBuilder, String parentAnimationId, boolean selectLongest,
                                         ArrayList<String> animationIds) throws IOException {
@@ -14,6 +14,7 @@
 
 #include "file_descriptor.h"
 #include "log.h"
+#include "math.h"
 
 #include <stdint.h>
 
@@ -76,12 +77,30 @@ namespace dmFileDescriptor
         return false;
     }
 
-    void PollerReset(Poller* poller)
+    uint32_t PollerAdd(Poller* poller, PollEvent event, int fd)
     {
-        while (!poller->m_Pollfds.Empty())
+        if (poller->m_Pollfds.Full())
         {
-            poller->m_Pollfds.Pop();
+            poller->m_Pollfds.OffsetCapacity(dmMath::Max(poller->m_Pollfds.Capacity(), 4U));
         }
+
+        PollFD pfd;
+        pfd.fd = fd;
+        pfd.events = PollEventToNative(event);
+        pfd.revents = 0;
+        poller->m_Pollfds.Push(pfd);
+        return poller->m_Pollfds.Size() - 1;
+    }
+
+    bool PollerHasEventAt(Poller* poller, PollEvent event, uint32_t index)
+    {
+        int e = PollReturnEventToNative(event);
+        return poller->m_Pollfds[index].revents & e;
+    }
+
+    void PollerReset(Poller* poller)
+    {
+        poller->m_Pollfds.SetSize(0);
     }
 
     void PollerDump(Poller* poller)
@@ -17,4 +17,26 @@
 
 #include <dmsdk/dlib/file_descriptor.h>
 
+namespace dmFileDescriptor
+{
+    /**
+     * Add a file descriptor to the poller, without looking for an existing entry of the descriptor.
+     * Meant for pollers that are rebuilt before each wait, where the caller keeps the returned index.
+     * @param poller Poller
+     * @param event Event to poll for
+     * @param fd File descriptor
+     * @return the index of the entry
+     */
+    uint32_t PollerAdd(Poller* poller, PollEvent event, int fd);
+
+    /**
+     * Check if the event exists for the entry at the index returned by PollerAdd()
+     * @param poller Poller
+     * @param event Event to check
+     * @param index Index of the entry
+     * @return True if event exists.
+     */
+    bool PollerHasEventAt(Poller* poller, PollEvent event, uint32_t index);
+}
+
 #endif // DM_FILE_DESCRIPTOR_H
@@ -0,0 +1,761 @@
+// Copyright 2020-2026 The Defold Foundation
+// Copyright 2014-2020 King
+// Copyright 2009-2014 Ragnar Svensson, Christian Murray
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef DM_HASHTABLE_FLAT_H
+#define DM_HASHTABLE_FLAT_H
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define DM_HASHTABLE_FLAT_SSE2
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define DM_HASHTABLE_FLAT_NEON
+    #include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+namespace dmHashTableFlatInternal
+{
+    // Control byte values. A full slot stores the lower 7 bits of the key hash (0..127)
+    static const int8_t CTRL_EMPTY   = -128; // 0x80
+    static const int8_t CTRL_DELETED = -2;   // 0xFE
+
+    static const uint32_t GROUP_WIDTH = 16;
+
+    static inline uint32_t CountTrailingZeros(uint64_t v)
+    {
+    #if defined(_MSC_VER)
+        unsigned long index;
+        #if defined(_M_X64) || defined(_M_ARM64)
+            _BitScanForward64(&index, v);
+        #else
+            if (_BitScanForward(&index, (unsigned long)v) == 0)
+            {
+                _BitScanForward(&index, (unsigned long)(v >> 32));
+                index += 32;
+            }
+        #endif
+        return (uint32_t)index;
+    #else
+        return (uint32_t)__builtin_ctzll(v);
+    #endif
+    }
+
+    static inline uint32_t CountLeadingZeros(uint64_t v)
+    {
+    #if defined(_MSC_VER)
+        unsigned long index;
+        #if defined(_M_X64) || defined(_M_ARM64)
+            _BitScanReverse64(&index, v);
+        #else
+            if (_BitScanReverse(&index, (unsigned long)(v >> 32)))
+                index += 32;
+            else
+                _BitScanReverse(&index, (unsigned long)v);
+        #endif
+        return 63 - (uint32_t)index;
+    #else
+        return (uint32_t)__builtin_clzll(v);
+    #endif
+    }
+
+    // A bit mask with one or more bits per slot in the group (LANE_SHIFT is log2 of the bits per slot)
+    template <uint32_t LANE_SHIFT>
+    struct BitMask
+    {
+        uint64_t m_Mask;
+
+        BitMask(uint64_t mask) : m_Mask(mask) {}
+        operator bool() const { return m_Mask != 0; }
+
+        uint32_t LowestBitSet() const { return CountTrailingZeros(m_Mask) >> LANE_SHIFT; }
+        void     ClearLowestBit()     { m_Mask &= m_Mask - 1; }
+
+        // Number of empty lanes before the first set lane, counting from the start of the group
+        uint32_t TrailingZeros() const { return m_Mask ? CountTrailingZeros(m_Mask) >> LANE_SHIFT : GROUP_WIDTH; }
+        // Number of empty lanes after the last set lane, counting from the end of the group
+        uint32_t LeadingZeros() const
+        {
+            if (!m_Mask)
+                return GROUP_WIDTH;
+            uint32_t total_bits = GROUP_WIDTH << LANE_SHIFT;
+            return (CountLeadingZeros(m_Mask) - (64 - total_bits)) >> LANE_SHIFT;
+        }
+    };
+
+#if defined(DM_HASHTABLE_FLAT_SSE2)
+    // 16 control bytes, compared in parallel. One bit per slot
+    struct Group
+    {
+        typedef BitMask<0> Mask;
+        __m128i m_Ctrl;
+
+        explicit Group(const int8_t* ctrl) : m_Ctrl(_mm_loadu_si128((const __m128i*)ctrl)) {}
+
+        Mask Match(int8_t h2) const
+        {
+            return Mask((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), m_Ctrl)));
+        }
+        Mask MatchEmpty() const
+        {
+            return Mask((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(CTRL_EMPTY), m_Ctrl)));
+        }
+        Mask MatchEmptyOrDeleted() const
+        {
+            // Both special values are less than -1, while full slots are >= 0
+            return Mask((uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), m_Ctrl)));
+        }
+    };
+#elif defined(DM_HASHTABLE_FLAT_NEON)
+    // 16 control bytes, compared in parallel. Four bits per slot in the mask (narrowed from the byte compare result)
+    struct Group
+    {
+        typedef BitMask<2> Mask;
+        int8x16_t m_Ctrl;
+
+        explicit Group(const int8_t* ctrl) : m_Ctrl(vld1q_s8(ctrl)) {}
+
+        static uint64_t ToMask(uint8x16_t cmp)
+        {
+            // Keep only one bit per slot, so that ClearLowestBit() moves on to the next slot
+            uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+            return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0) & 0x8888888888888888ULL;
+        }
+
+        Mask Match(int8_t h2) const     { return Mask(ToMask(vceqq_s8(vdupq_n_s8(h2), m_Ctrl))); }
+        Mask MatchEmpty() const         { return Mask(ToMask(vceqq_s8(vdupq_n_s8(CTRL_EMPTY), m_Ctrl))); }
+        Mask MatchEmptyOrDeleted() const{ return Mask(ToMask(vcltq_s8(m_Ctrl, vdupq_n_s8(-1)))); }
+    };
+#else
+    // Portable fallback. One bit per slot
+    struct Group
+    {
+        typedef BitMask<0> Mask;
+        const int8_t* m_Ctrl;
+
+        explicit Group(const int8_t* ctrl) : m_Ctrl(ctrl) {}
+
+        Mask Match(int8_t h2) const
+        {
+            uint64_t mask = 0;
+            for (uint32_t i = 0; i < GROUP_WIDTH; ++i)
+                mask |= (uint64_t)(m_Ctrl[i] == h2) << i;
+            return Mask(mask);
+        }
+        Mask MatchEmpty() const
+        {
+            return Match(CTRL_EMPTY);
+        }
+        Mask MatchEmptyOrDeleted() const
+        {
+            uint64_t mask = 0;
+            for (uint32_t i = 0; i < GROUP_WIDTH; ++i)
+                mask |= (uint64_t)(m_Ctrl[i] < -1) << i;
+            return Mask(mask);
+        }
+    };
+#endif
+
+    // The keys are often already hashes (dmhash_t), but may also be small sequential integers,
+    // so we mix them to get good bits for both the probe position and the 7 bit control hash
+    template <typename KEY>
+    static inline uint64_t HashKey(KEY key)
+    {
+        uint64_t h = (uint64_t)key * 0x9E3779B97F4A7C15ULL;
+        return h ^ (h >> 29);
+    }
+}
+
+/*# hashtable with open addressing
+ * Hashtable with open addressing and group probing (SSE2/NEON, with a scalar fallback), memcpy-copy semantics (POD types).
+ * Lookups use one control byte per slot, comparing 16 slots at a time, before touching the key/value storage.
+ * Compared to dmHashTable, the API is the same except for user allocated memory (not supported).
+ * The key/value pairs are stored apart from the probed slots, so they stay in place during Put() and Erase(), and only move when the capacity is changed.
+ * Erased slots are reused by later Put() calls, and when Put() runs out of empty slots, the erased slots are reclaimed by rehashing the slots in place.
+ * @note The key type needs to be an integer type
+ * @type class
+ * @name dmHashTableFlat
+ * @tparam KEY
+ * @tparam T
+ */
+template <typename KEY, typename T>
+class dmHashTableFlat
+{
+    typedef dmHashTableFlatInternal::Group Group;
+
+    static const uint32_t MIN_SLOTS = dmHashTableFlatInternal::GROUP_WIDTH;
+    static const uint32_t INVALID_SLOT = 0xFFFFFFFF;
+
+public:
+    typedef KEY key_t;
+    typedef T   value_t;
+
+    struct Entry
+    {
+        key_t    m_Key;
+        value_t  m_Value;
+    };
+
+    /*#
+     * Constructor. Create an empty hashtable with zero capacity
+     * @name dmHashTableFlat
+     */
+    dmHashTableFlat()
+    {
+        memset(this, 0, sizeof(*this));
+    }
+
+    /**
+     * Destructor.
+     * @name ~dmHashTableFlat
+     */
+    ~dmHashTableFlat()
+    {
+        free(m_Ctrl);
+        free(m_FreeEntries);
+    }
+
+    /*#
+     * Removes all the entries from the table.
+     * @name Clear
+     */
+    void Clear()
+    {
+        if (m_Ctrl)
+            memset(m_Ctrl, dmHashTableFlatInternal::CTRL_EMPTY, m_NumSlots + dmHashTableFlatInternal::GROUP_WIDTH);
+        for (uint32_t i = 0; i < m_Capacity; ++i)
+            m_FreeEntries[i] = m_Capacity - 1 - i;
+        m_Count = 0;
+        m_GrowthLeft = MaxLoad(m_NumSlots);
+    }
+
+    /*#
+     * Number of entries stored in table.
+     * @name Size
+     * @return Number of entries.
+     */
+    uint32_t Size() const
+    {
+        return m_Count;
+    }
+
+    /*#
+     * Hashtable capacity. Maximum number of entries possible to store in table
+     * @name Capacity
+     * @return [type: uint32_t] the capacity of the table
+     */
+    uint32_t Capacity() const
+    {
+        return m_Capacity;
+    }
+
+    /**
+     * Set hashtable capacity. New capacity must be greater or equal to current capacity.
+     * The table_size is only kept for compatibility with dmHashTable, the number of slots is derived from the capacity
+     * @name SetCapacity
+     * @param table_size [type:uint32_t] Unused.
+     * @param capacity [type:uint32_t] Capacity. capacity < 0x7fffffff
+     */
+    void SetCapacity(uint32_t table_size, uint32_t capacity)
+    {
+        (void)table_size;
+        SetCapacity(capacity);
+    }
+
+    /*#
+     * Set hashtable capacity. New capacity must be greater or equal to current capacity.
+     * @note Moves the entries, invalidating any pointers to the values
+     * @name SetCapacity
+     * @param capacity [type:uint32_t] Capacity. capacity < 0x7fffffff
+     */
+    void SetCapacity(uint32_t capacity)
+    {
+        assert(capacity < 0x7fffffff);
+        assert(capacity >= Capacity());
+
+        // Leave room for some erased slots at full capacity, so that Put() reclaims them at most every num_slots/16 calls
+        uint32_t num_slots = MIN_SLOTS;
+        while (MaxLoad(num_slots) - num_slots / 16 < capacity)
+            num_slots *= 2;
+
+        if (capacity != m_Capacity)
+            AllocateEntries(capacity);
+        if (num_slots != m_NumSlots)
+            AllocateSlots(num_slots);
+    }
+
+    /*# hashtable offset capacity
+     *
+     * Relative change of capacity
+     * Equivalent to SetCapacity(Capacity() + offset).
+     *
+     * @name OffsetCapacity
+     * @param offset [type:uint32_t] relative amount of elements to change the capacity
+     */
+    void OffsetCapacity(int32_t offset)
+    {
+        SetCapacity(Capacity() + offset);
+    }
+
+    /*#
+     * Swaps the contents of two hash tables
+     * @name Swap
+     * @param other [type: dmHashTableFlat<KEY, T>&] the other table
+     */
+    void Swap(dmHashTableFlat<KEY, T>& other)
+    {
+        char buf[sizeof(*this)];
+        memcpy(buf, &other, sizeof(buf));
+        memcpy(&other, this, sizeof(buf));
+        memcpy(this, buf, sizeof(buf));
+    }
+
+    /*#
+     * Check if the table is full
+     * @name Full
+     * @return true if the table is full
+     */
+    bool Full()
+    {
+        return m_Count == Capacity();
+    }
+
+    /*#
+     * Check if the table is empty
+     * @name Empty
+     * @return true if the table is empty
+     */
+    bool Empty()
+    {
+        return m_Count == 0;
+    }
+
+    /*#
+     * Put key/value pair in hash table. NOTE: The method will "assert" if the hashtable is full.
+     * @name Put
+     * @param key [type: KEY] Key
+     * @param value [type: const T&] Value
+     */
+    void Put(KEY key, const T& value)
+    {
+        uint64_t hash = dmHashTableFlatInternal::HashKey(key);
+        Entry* entry = FindEntry(key, hash);
+        if (entry != 0)
+        {
+            entry->m_Value = value;
+            return;
+        }
+
+        assert(!Full());
+
+        // We never use up the last empty slots, since they're what stops the probing for a missing key.
+        // Instead, the erased slots are reclaimed (only the slot indices move, not the entries)
+        uint32_t index = FindInsertSlot(hash);
+        if (m_Ctrl[index] == dmHashTableFlatInternal::CTRL_EMPTY && m_GrowthLeft == 0)
+        {
+            DropDeletedSlots();
+            index = FindInsertSlot(hash);
+        }
+        if (m_Ctrl[index] == dmHashTableFlatInternal::CTRL_EMPTY)
+        {
+            assert(m_GrowthLeft > 0);
+            m_GrowthLeft--;
+        }
+
+        uint32_t entry_index = m_FreeEntries[m_Capacity - m_Count - 1];
+        SetCtrl(index, H2(hash));
+        m_Slots[index] = entry_index;
+        entry = &m_Entries[entry_index];
+        entry->m_Key = key;
+        entry->m_Value = value;
+        m_Count++;
+    }
+
+    /*#
+     * Get pointer to value from key
+     * @name Get
+     * @param key [type: KEY] Key
+     * @return value [type: T*] Pointer to value. NULL if the key/value pair doesn't exist.
+     */
+    T* Get(KEY key)
+    {
+        Entry* entry = FindEntry(key, dmHashTableFlatInternal::HashKey(key));
+        return entry ? &entry->m_Value : 0;
+    }
+
+    /**
+     * Get pointer to value from key. "const" version.
+     * @name Get
+     * @param key [type: KEY] Key
+     * @return value [type: const T*] Pointer to value. NULL if the key/value pair doesn't exist.
+     */
+    const T* Get(KEY key) const
+    {
+        Entry* entry = FindEntry(key, dmHashTableFlatInternal::HashKey(key));
+        return entry ? &entry->m_Value : 0;
+    }
+
+    /*#
+     * Remove key/value pair.
+     * @name Erase
+     * @param key [type: KEY] Key to remove
+     * @note Only valid if key exists in table
+     */
+    void Erase(KEY key)
+    {
+        uint32_t index = FindSlot(key, dmHashTableFlatInternal::HashKey(key));
+        assert(index != INVALID_SLOT && "Key not found (erase)");
+
+        uint32_t mask = m_NumSlots - 1;
+
+        // If no probe sequence could have passed this slot without also seeing an empty slot,
+        // we can mark it as empty directly, instead of leaving a tombstone
+        typename Group::Mask empty_before = Group(m_Ctrl + ((index - dmHashTableFlatInternal::GROUP_WIDTH) & mask)).MatchEmpty();
+        typename Group::Mask empty_after  = Group(m_Ctrl + index).MatchEmpty();
+        bool was_never_full = empty_before && empty_after &&
+                              (empty_after.TrailingZeros() + empty_before.LeadingZeros()) < dmHashTableFlatInternal::GROUP_WIDTH;
+
+        if (was_never_full)
+        {
+            SetCtrl(index, dmHashTableFlatInternal::CTRL_EMPTY);
+            m_GrowthLeft++;
+        }
+        else
+        {
+            SetCtrl(index, dmHashTableFlatInternal::CTRL_DELETED);
+        }
+        m_FreeEntries[m_Capacity - m_Count] = m_Slots[index];
+        m_Count--;
+    }
+
+    /*#
+     * Iterate over all entries in table
+     * @name Iterate
+     * @tparam CONTEXT
+     * @param call_back [type:void*] Call-back called for every entry
+     * @param context [type:CONTEXT*] Context
+     */
+    template <typename CONTEXT>
+    void Iterate(void (*call_back)(CONTEXT *context, const KEY* key, T* value), CONTEXT* context) const
+    {
+        for (uint32_t i = 0; i < m_NumSlots; ++i)
+        {
+            if (m_Ctrl[i] >= 0)
+            {
+                Entry* e = &m_Entries[m_Slots[i]];
+                call_back(context, &e->m_Key, &e->m_Value);
+            }
+        }
+    }
+
+    /*#
+     * Iterator to the key/value pairs of a hash table
+     * @struct
+     * @name Iterator
+     * @member GetKey()
+     * @member GetValue()
+     */
+    struct Iterator
+    {
+        // public
+        const KEY&  GetKey()    { return m_Table.m_Entries[m_Table.m_Slots[m_Index]].m_Key; }
+        const T&    GetValue()  { return m_Table.m_Entries[m_Table.m_Slots[m_Index]].m_Value; }
+
+        Iterator(dmHashTableFlat<KEY, T>& table)
+            : m_Table(table)
+            , m_Index(0xFFFFFFFF)
+        {
+        }
+
+        bool Next()
+        {
+            for (++m_Index; m_Index < m_Table.m_NumSlots; ++m_Index)
+            {
+                if (m_Table.m_Ctrl[m_Index] >= 0)
+                    return true;
+            }
+            return false;
+        }
+
+        // private
+        dmHashTableFlat<KEY, T>&    m_Table;
+        uint32_t                    m_Index;
+    };
+
+    /*#
+     * Get an iterator for the key/value pairs
+     * @name GetIterator
+     * @return iterator [type: dmHashTableFlat<T>::Iterator] the iterator
+     */
+    Iterator GetIterator()
+    {
+        return Iterator(*this);
+    }
+
+    /**
+     * Verify internal structure. "assert" if invalid. For unit testing
+     */
+    void Verify()
+    {
+        uint32_t real_count = 0;
+        uint32_t num_empty = 0;
+        for (uint32_t i = 0; i < m_NumSlots; ++i)
+        {
+            if (m_Ctrl[i] >= 0)
+            {
+                real_count++;
+                assert(m_Slots[i] < m_Capacity);
+                Entry* e = &m_Entries[m_Slots[i]];
+                assert(FindEntry(e->m_Key, dmHashTableFlatInternal::HashKey(e->m_Key)) == e);
+            }
+            else if (m_Ctrl[i] == dmHashTableFlatInternal::CTRL_EMPTY)
+            {
+                num_empty++;
+            }
+        }
+        for (uint32_t i = 0; m_NumSlots && i < dmHashTableFlatInternal::GROUP_WIDTH - 1; ++i)
+        {
+            assert(m_Ctrl[m_NumSlots + i] == m_Ctrl[i]);
+        }
+        assert(real_count == m_Count);
+        // The empty slots reserved by the max load are never used up
+        assert(m_NumSlots == 0 || num_empty == m_GrowthLeft + (m_NumSlots - MaxLoad(m_NumSlots)));
+    }
+
+private:
+    // Forbid assignment operator and copy-constructor
+    dmHashTableFlat(const dmHashTableFlat<KEY, T>&);
+    const dmHashTableFlat<KEY, T>& operator=(const dmHashTableFlat<KEY, T>&);
+
+    // We keep at least 1/8 of the slots empty, so that a probe for a missing key always terminates quickly
+    static uint32_t MaxLoad(uint32_t num_slots)
+    {
+        return num_slots - num_slots / 8;
+    }
+
+    static int8_t H2(uint64_t hash)
+    {
+        return (int8_t)(hash & 0x7F);
+    }
+
+    uint32_t H1(uint64_t hash) const
+    {
+        return (uint32_t)(hash >> 7) & (m_NumSlots - 1);
+    }
+
+    // The entries keep their index, so the slots stay valid when the entries are moved
+    void AllocateEntries(uint32_t capacity)
+    {
+        // The free list (a stack of entry indices) is followed by the entries
+        uint32_t free_size = (sizeof(uint32_t) * capacity + alignof(Entry) - 1) & ~(uint32_t)(alignof(Entry) - 1);
+        uint8_t* mem = (uint8_t*)malloc(free_size + sizeof(Entry) * capacity);
+        uint32_t* free_entries = (uint32_t*)mem;
+        Entry* entries = (Entry*)(mem + free_size);
+
+        uint32_t num_new = capacity - m_Capacity;
+        for (uint32_t i = 0; i < num_new; ++i)
+            free_entries[i] = capacity - 1 - i;
+        if (m_FreeEntries)
+        {
+            memcpy(free_entries + num_new, m_FreeEntries, sizeof(uint32_t) * (m_Capacity - m_Count));
+            memcpy(entries, m_Entries, sizeof(Entry) * m_Capacity);
+        }
+
+        free(m_FreeEntries);
+        m_FreeEntries = free_entries;
+        m_Entries = entries;
+        m_Capacity = capacity;
+    }
+
+    void AllocateSlots(uint32_t num_slots)
+    {
+        int8_t*   old_ctrl      = m_Ctrl;
+        uint32_t* old_slots     = m_Slots;
+        uint32_t  old_num_slots = m_NumSlots;
+
+        // The control bytes are followed by a copy of the first GROUP_WIDTH-1 bytes, so that a group can be loaded from any slot
+        uint32_t ctrl_size = (num_slots + dmHashTableFlatInternal::GROUP_WIDTH + sizeof(uint32_t) - 1) & ~(uint32_t)(sizeof(uint32_t) - 1);
+        uint8_t* mem = (uint8_t*)malloc(ctrl_size + sizeof(uint32_t) * num_slots);
+
+        m_Ctrl = (int8_t*)mem;
+        m_Slots = (uint32_t*)(mem + ctrl_size);
+        m_NumSlots = num_slots;
+        memset(m_Ctrl, dmHashTableFlatInternal::CTRL_EMPTY, num_slots + dmHashTableFlatInternal::GROUP_WIDTH);
+        m_GrowthLeft = MaxLoad(num_slots) - m_Count;
+
+        for (uint32_t i = 0; i < old_num_slots; ++i)
+        {
+            if (old_ctrl[i] >= 0)
+            {
+                uint64_t hash = dmHashTableFlatInternal::HashKey(m_Entries[old_slots[i]].m_Key);
+                uint32_t index = FindInsertSlot(hash);
+                SetCtrl(index, H2(hash));
+                m_Slots[index] = old_slots[i];
+            }
+        }
+        free(old_ctrl);
+    }
+
+    // Rehashes the slots in place, turning all erased slots into empty slots. The entries don't move
+    void DropDeletedSlots()
+    {
+        const uint32_t mask = m_NumSlots - 1;
+
+        // The full slots are marked as deleted until they've been placed, and the erased slots become empty
+        for (uint32_t i = 0; i < m_NumSlots; ++i)
+            m_Ctrl[i] = m_Ctrl[i] >= 0 ? dmHashTableFlatInternal::CTRL_DELETED : dmHashTableFlatInternal::CTRL_EMPTY;
+        memcpy(m_Ctrl + m_NumSlots, m_Ctrl, dmHashTableFlatInternal::GROUP_WIDTH - 1);
+
+        uint32_t i = 0;
+        while (i < m_NumSlots)
+        {
+            if (m_Ctrl[i] != dmHashTableFlatInternal::CTRL_DELETED)
+            {
+                ++i;
+                continue;
+            }
+
+            uint64_t hash = dmHashTableFlatInternal::HashKey(m_Entries[m_Slots[i]].m_Key);
+            uint32_t target = FindInsertSlot(hash);
+            uint32_t probe_start = H1(hash);
+
+            // Already in the first group of its probe sequence with a free slot
+            if (((i - probe_start) & mask) / dmHashTableFlatInternal::GROUP_WIDTH == ((target - probe_start) & mask) / dmHashTableFlatInternal::GROUP_WIDTH)
+            {
+                SetCtrl(i, H2(hash));
+                ++i;
+                continue;
+            }
+
+            if (m_Ctrl[target] == dmHashTableFlatInternal::CTRL_EMPTY)
+            {
+                SetCtrl(target, H2(hash));
+                m_Slots[target] = m_Slots[i];
+                SetCtrl(i, dmHashTableFlatInternal::CTRL_EMPTY);
+                ++i;
+            }
+            else
+            {
+                // The target holds a slot that isn't placed yet, so we swap them and process that slot next
+                SetCtrl(target, H2(hash));
+                uint32_t tmp = m_Slots[target];
+                m_Slots[target] = m_Slots[i];
+                m_Slots[i] = tmp;
+            }
+        }
+        m_GrowthLeft = MaxLoad(m_NumSlots) - m_Count;
+    }
+
+    void SetCtrl(uint32_t index, int8_t h)
+    {
+        const uint32_t cloned = dmHashTableFlatInternal::GROUP_WIDTH - 1;
+        m_Ctrl[index] = h;
+        m_Ctrl[((index - cloned) & (m_NumSlots - 1)) + cloned] = h;
+    }
+
+    Entry* FindEntry(KEY key, uint64_t hash) const
+    {
+        uint32_t index = FindSlot(key, hash);
+        return index != INVALID_SLOT ? &m_Entries[m_Slots[index]] : 0;
+    }
+
+    uint32_t FindSlot(KEY key, uint64_t hash) const
+    {
+        if (!m_Count)
+            return INVALID_SLOT;
+
+        const uint32_t mask = m_NumSlots - 1;
+        int8_t h2 = H2(hash);
+        uint32_t pos = H1(hash);
+        // The triangular probe sequence visits each group once
+        for (uint32_t step = 0; step < m_NumSlots;)
+        {
+            Group group(m_Ctrl + pos);
+            typename Group::Mask match = group.Match(h2);
+            while (match)
+            {
+                uint32_t index = (pos + match.LowestBitSet()) & mask;
+                if (m_Entries[m_Slots[index]].m_Key == key)
+                    return index;
+                match.ClearLowestBit();
+            }
+            if (group.MatchEmpty())
+                return INVALID_SLOT;
+
+            step += dmHashTableFlatInternal::GROUP_WIDTH;
+            pos = (pos + step) & mask;
+        }
+        return INVALID_SLOT;
+    }
+
+    // Returns the first empty or deleted slot in the probe sequence
+    uint32_t FindInsertSlot(uint64_t hash) const
+    {
+        const uint32_t mask = m_NumSlots - 1;
+        uint32_t pos = H1(hash);
+        for (uint32_t step = 0; step < m_NumSlots;)
+        {
+            typename Group::Mask free = Group(m_Ctrl + pos).MatchEmptyOrDeleted();
+            if (free)
+                return (pos + free.LowestBitSet()) & mask;
+
+            step += dmHashTableFlatInternal::GROUP_WIDTH;
+            pos = (pos + step) & mask;
+        }
+        assert(false && "No free slots in hashtable");
+        return 0;
+    }
+
+    // Control bytes, one per slot (plus the cloned bytes)
+    int8_t*   m_Ctrl;
+    // The entry index of each full slot, stored in the same allocation as the control bytes
+    uint32_t* m_Slots;
+    // The key/value pairs, one per unit of capacity
+    Entry*    m_Entries;
+    // Stack of the unused entry indices (Capacity() - Size() of them), stored in the same allocation as the entries
+    uint32_t* m_FreeEntries;
+    // Number of slots, a power of two
+    uint32_t  m_NumSlots;
+    // Number of key/value pairs in table
+    uint32_t  m_Count;
+    // Max number of key/value pairs, as set by the user
+    uint32_t  m_Capacity;
+    // Number of empty slots that may still be used before we reach the max load (erased slots don't count as empty)
+    uint32_t  m_GrowthLeft;
+};
+
+/*#
+ * Specialized flat hash table with [type:uint32_t] as keys
+ * @type class
+ * @name dmHashTableFlat32
+ */
+template <typename T>
+class dmHashTableFlat32 : public dmHashTableFlat<uint32_t, T> {};
+
+/*#
+ * Specialized flat hash table with [type:uint64_t] as keys
+ * @type class
+ * @name dmHashTableFlat64
+ */
+template <typename T>
+class dmHashTableFlat64 : public dmHashTableFlat<uint64_t, T> {};
+
+#endif // DM_HASHTABLE_FLAT_H
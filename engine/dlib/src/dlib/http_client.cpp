@@ -98,12 +98,9 @@ namespace dmHttpClient
 
     PoolCreator g_PoolCreator;
 
-    struct Response
+    struct Response : ResponseHeaders
     {
         HClient m_Client;
-        int m_Major;
-        int m_Minor;
-        int m_Status;
 
         // Offset to actual content in Client.m_Buffer,
         // ie after meta-data such as http-headers or chunk-size for transferring data with chunked encoding.
@@ -111,16 +108,6 @@ namespace dmHttpClient
         // Total amount of data received in Client.m_Buffer
         int m_TotalReceived;
 
-        // Headers
-        int      m_ContentLength;       // Size of the payload sent over the http
-        int      m_RangeStart;
-        int      m_RangeEnd;
-        int      m_DocumentSize;        // The actual size of the file itself (!= content length)
-        char     m_ETag[dmHttpCache::MAX_TAG_LEN];
-        uint32_t m_Chunked : 1;
-        uint32_t m_CloseConnection : 1;
-        uint32_t m_MaxAge;
-
         // Cache
         dmHttpCache::HCacheCreator m_CacheCreator;
 
@@ -133,19 +120,8 @@ namespace dmHttpClient
         Response(HClient client)
         {
             m_Client = client;
-            m_Major = 0;
-            m_Minor = 0;
-            m_Status = 0;
-            m_ContentLength = -1;
-            m_RangeStart = -1;
-            m_RangeEnd = -1;
-            m_DocumentSize = -1;
-            m_ETag[0] = '\0';
             m_ContentOffset = -1;
             m_TotalReceived = 0;
-            m_Chunked = 0;
-            m_CloseConnection = 0;
-            m_MaxAge = 0;
             m_CacheCreator = 0;
             m_Pool = 0;
             m_Connection = 0;
@@ -423,45 +399,57 @@ namespace dmHttpClient
         }
     }
 
-    static void HandleVersion(void* user_data, int major, int minor, int status, const char* status_str)
+    ResponseHeaders::ResponseHeaders()
     {
-        Response* resp = (Response*) user_data;
-        resp->m_Major = major;
-        resp->m_Minor = minor;
-        resp->m_Status = status;
+        m_Major = 0;
+        m_Minor = 0;
+        m_Status = 0;
+        m_ContentLength = -1;
+        m_RangeStart = -1;
+        m_RangeEnd = -1;
+        m_DocumentSize = -1;
+        m_ETag[0] = '\0';
+        m_Chunked = 0;
+        m_CloseConnection = 0;
+        m_MaxAge = 0;
+    }
+
+    void SetResponseVersion(ResponseHeaders* headers, int major, int minor, int status)
+    {
+        headers->m_Major = major;
+        headers->m_Minor = minor;
+        headers->m_Status = status;
 
         if ((major << 16 | minor) < (1 << 16 | 1))
         {
             // Close connection for HTTP protocol version < 1.1
-            resp->m_CloseConnection = 1;
+            headers->m_CloseConnection = 1;
         }
     }
 
-    static void HandleHeader(void* user_data, const char* key, const char* value)
+    void SetResponseHeader(ResponseHeaders* headers, const char* key, const char* value)
     {
-        Response* resp = (Response*) user_data;
-
         if (dmStrCaseCmp(key, "Content-Length") == 0)
         {
-            resp->m_ContentLength = strtol(value, 0, 10);
+            headers->m_ContentLength = strtol(value, 0, 10);
         }
         else if (dmStrCaseCmp(key, "Content-Range") == 0)
         {
             // https://developer.mozilla.org/en-US/docs/Web/HTTP/Range_requests
             // https://developer.mozilla.org/en-US/docs/Web/HTTP/Headers/Content-Range
-            sscanf(value, "bytes %d-%d/%d", &resp->m_RangeStart, &resp->m_RangeEnd, &resp->m_DocumentSize);
+            sscanf(value, "bytes %d-%d/%d", &headers->m_RangeStart, &headers->m_RangeEnd, &headers->m_DocumentSize);
         }
         else if (dmStrCaseCmp(key, "Transfer-Encoding") == 0 && dmStrCaseCmp(value, "chunked") == 0)
         {
-            resp->m_Chunked = 1;
+            headers->m_Chunked = 1;
         }
         else if (dmStrCaseCmp(key, "Connection") == 0 && dmStrCaseCmp(value, "close") == 0)
         {
-            resp->m_CloseConnection = 1;
+            headers->m_CloseConnection = 1;
         }
         else if (dmStrCaseCmp(key, "ETag") == 0)
         {
-            dmStrlCpy(resp->m_ETag, value, sizeof(resp->m_ETag));
+            dmStrlCpy(headers->m_ETag, value, sizeof(headers->m_ETag));
         }
         else if (dmStrCaseCmp(key, "Cache-Control") == 0)
         {
@@ -469,13 +457,25 @@ namespace dmHttpClient
             const char* max_age = strstr(value, "max-age=");
             if (max_age) {
                 max_age += strlen(substr);
-                resp->m_MaxAge = dmMath::Max(0, atoi(max_age));
-                if (resp->m_MaxAge > HTTP_CLIENT_MAXIMUM_CACHE_AGE)
+                headers->m_MaxAge = dmMath::Max(0, atoi(max_age));
+                if (headers->m_MaxAge > HTTP_CLIENT_MAXIMUM_CACHE_AGE)
                 {
-                    resp->m_MaxAge = HTTP_CLIENT_MAXIMUM_CACHE_AGE;
+                    headers->m_MaxAge = HTTP_CLIENT_MAXIMUM_CACHE_AGE;
                 }
             }
         }
+    }
+
+    static void HandleVersion(void* user_data, int major, int minor, int status, const char* status_str)
+    {
+        Response* resp = (Response*) user_data;
+        SetResponseVersion(resp, major, minor, status);
+    }
+
+    static void HandleHeader(void* user_data, const char* key, const char* value)
+    {
+        Response* resp = (Response*) user_data;
+        SetResponseHeader(resp, key, value);
 
         HClient c = resp->m_Client;
         if (c->m_HttpHeader)
@@ -803,40 +803,167 @@ bail:
         }
     }
 
-    static void HttpContentConsume(HResponse response, void* user_data, int status_code, const void* content_data, uint32_t content_data_size, int32_t content_length,
-                                    uint32_t range_start, uint32_t range_end, uint32_t document_size, const char* method)
+    enum ChunkState
     {
-        (void) response;
-        (void) user_data;
-        (void) status_code;
-        (void) content_data;
-        (void) content_data_size;
-        (void) content_length;
-        (void) range_start;
-        (void) range_end;
-        (void) document_size;
-        (void) method;
+        CHUNK_STATE_SIZE,           // The hex digits of the chunk size
+        CHUNK_STATE_SIZE_LINE,      // The rest of the chunk size line, i.e. chunk extensions
+        CHUNK_STATE_DATA,
+        CHUNK_STATE_DATA_END,       // The "\r\n" after the chunk data
+        CHUNK_STATE_TRAILER,        // Trailer fields, ended by an empty line
+        CHUNK_STATE_DONE,
+    };
+
+    ChunkDecoder::ChunkDecoder()
+    {
+        m_State = CHUNK_STATE_SIZE;
+        m_ChunkLeft = 0;
+        m_Digits = 0;
+        m_LineLength = 0;
     }
 
-#if !defined(DM_NO_HTTP_CACHE)
-    static Result HandleCached(HClient client, const char* path, Response* response, bool method_is_head)
+    static int HexDigit(char c)
     {
-        client->m_Statistics.m_CachedResponses++;
-        if (client->m_IgnoreCache)
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    ChunkResult DecodeChunk(ChunkDecoder* decoder, const char* data, uint32_t size, uint32_t* consumed, const char** content, uint32_t* content_size)
+    {
+        *content = 0;
+        *content_size = 0;
+
+        uint32_t i = 0;
+        while (i < size && decoder->m_State != CHUNK_STATE_DONE)
         {
-            return RESULT_OK;
+            char c = data[i];
+            switch (decoder->m_State)
+            {
+            case CHUNK_STATE_SIZE:
+                {
+                    int digit = HexDigit(c);
+                    if (digit < 0)
+                    {
+                        if (decoder->m_Digits == 0)
+                        {
+                            *consumed = i;
+                            return CHUNK_RESULT_ERROR;
+                        }
+                        decoder->m_State = CHUNK_STATE_SIZE_LINE;
+                        break;
+                    }
+                    // The size must fit in 32 bits
+                    if (decoder->m_Digits == 8)
+                    {
+                        *consumed = i;
+                        return CHUNK_RESULT_ERROR;
+                    }
+                    decoder->m_ChunkLeft = (decoder->m_ChunkLeft << 4) | (uint32_t) digit;
+                    decoder->m_Digits++;
+                    ++i;
+                }
+                break;
+
+            case CHUNK_STATE_SIZE_LINE:
+                ++i;
+                if (c == '\n')
+                {
+                    decoder->m_Digits = 0;
+                    decoder->m_LineLength = 0;
+                    decoder->m_State = decoder->m_ChunkLeft > 0 ? CHUNK_STATE_DATA : CHUNK_STATE_TRAILER;
+                }
+                break;
+
+            case CHUNK_STATE_DATA:
+                {
+                    uint32_t n = dmMath::Min(size - i, decoder->m_ChunkLeft);
+                    decoder->m_ChunkLeft -= n;
+                    if (decoder->m_ChunkLeft == 0)
+                    {
+                        decoder->m_State = CHUNK_STATE_DATA_END;
+                    }
+                    *content = data + i;
+                    *content_size = n;
+                    *consumed = i + n;
+                    return CHUNK_RESULT_CONTENT;
+                }
+
+            case CHUNK_STATE_DATA_END:
+                ++i;
+                if (c == '\n')
+                {
+                    decoder->m_State = CHUNK_STATE_SIZE;
+                }
+                break;
+
+            case CHUNK_STATE_TRAILER:
+                ++i;
+                if (c == '\n')
+                {
+                    decoder->m_State = decoder->m_LineLength == 0 ? CHUNK_STATE_DONE : CHUNK_STATE_TRAILER;
+                    decoder->m_LineLength = 0;
+                }
+                else if (c != '\r')
+                {
+                    decoder->m_LineLength++;
+                }
+                break;
+
+            default:
+                assert(false);
+                break;
+            }
         }
 
-        if (client->m_HttpCache == 0)
+        *consumed = i;
+        return decoder->m_State == CHUNK_STATE_DONE ? CHUNK_RESULT_DONE : CHUNK_RESULT_NEED_MORE_DATA;
+    }
+
+    Result ReadCachedContent(dmHttpCache::HCache cache, const char* cache_key, const char* etag, bool read_content,
+                             char* buffer, uint32_t buffer_size, CachedContent callback, void* user_data)
+    {
+        FILE* file = 0;
+        uint32_t file_size = 0;
+        uint64_t checksum;
+        uint32_t range_start;
+        uint32_t range_end;
+        uint32_t document_size;
+        dmHttpCache::Result cache_result = dmHttpCache::Get(cache, cache_key, etag, &file, &file_size, &checksum,
+                                                            &range_start, &range_end, &document_size);
+        if (cache_result != dmHttpCache::RESULT_OK)
         {
-            dmLogWarning("Got HTTP response NOT MODIFIED (304) but no cache present");
-            return RESULT_OK;
+            return RESULT_IO_ERROR;
+        }
+
+        if (read_content)
+        {
+            size_t nread;
+            do
+            {
+                nread = fread(buffer, 1, buffer_size - 1, file);
+                buffer[nread] = '\0';
+                callback(user_data, buffer, nread, file_size, range_start, range_end, document_size);
+            }
+            while (nread > 0);
+        }
+        else
+        {
+            callback(user_data, 0, 0, file_size, range_start, range_end, document_size);
         }
-        dmHttpCache::Result cache_result;
+        dmHttpCache::Release(cache, cache_key, etag, file);
+        return RESULT_OK;
+    }
 
+    Result ReadNotModified(dmHttpCache::HCache cache, const char* cache_key, const char* response_etag, bool read_content,
+                           char* buffer, uint32_t buffer_size, CachedContent callback, void* user_data)
+    {
         char cache_etag[dmHttpCache::MAX_TAG_LEN];
         cache_etag[0] = '\0';
-        cache_result = dmHttpCache::GetETag(client->m_HttpCache, client->m_CacheKey, cache_etag, sizeof(cache_etag));
+        dmHttpCache::Result cache_result = dmHttpCache::GetETag(cache, cache_key, cache_etag, sizeof(cache_etag));
 
         if (cache_result != dmHttpCache::RESULT_OK)
         {
@@ -844,7 +971,7 @@ bail:
             return RESULT_OK;
         }
 
-        if (response->m_ETag[0] != '\0')
+        if (response_etag[0] != '\0')
         {
             // The Entity Tag (ETag) is optional in HTTP 1.1.
             // It is the servers responsibility to verify the ETag in case it is included. The
@@ -853,55 +980,62 @@ bail:
             // 403 response even though it's been sent with a previous 200 response.
             // Even though it might be possible at times, the client has no formal responsibility
             // to perform this verification.
-            if (strcmp(cache_etag, response->m_ETag) != 0)
+            if (strcmp(cache_etag, response_etag) != 0)
             {
-                dmLogError("ETag mismatch (%s vs %s)", cache_etag, response->m_ETag);
+                dmLogError("ETag mismatch (%s vs %s)", cache_etag, response_etag);
                 return RESULT_IO_ERROR;
             }
         }
 
-        FILE* file = 0;
-        uint32_t file_size = 0;
-        uint64_t checksum;
-        uint32_t range_start;
-        uint32_t range_end;
-        uint32_t document_size;
-        cache_result = dmHttpCache::Get(client->m_HttpCache, client->m_CacheKey, cache_etag, &file, &file_size, &checksum,
-                                        &range_start, &range_end, &document_size);
-        if (cache_result == dmHttpCache::RESULT_OK)
+        // If the request is a "HEAD" request, and the URI is cached (i.e the file exists),
+        // then we should return the meta-data about the file (including triggering the progress callback).
+        Result r = ReadCachedContent(cache, cache_key, cache_etag, read_content, buffer, buffer_size, callback, user_data);
+        if (r != RESULT_OK)
         {
-            // If the request is a "HEAD" request, and the URI is cached (i.e the file exists),
-            // then we should return the meta-data about the file (including triggering the progress callback).
-            if (method_is_head)
-            {
-                client->m_HttpContent(response, client->m_Userdata, response->m_Status, 0, 0, file_size,
-                                        range_start, range_end, document_size,
-                                        "HEAD");
-            }
-            else
-            {
-                // NOTE: We have an extra byte for null-termination so no buffer overrun here.
-                size_t nread;
-                do
-                {
-                    nread = fread(client->m_Buffer, 1, BUFFER_SIZE, file);
-                    client->m_Buffer[nread] = '\0';
-                    client->m_HttpContent(response, client->m_Userdata, response->m_Status, client->m_Buffer, nread, file_size,
-                                        range_start, range_end, document_size,
-                                        0);
-                }
-                while (nread > 0);
-            }
-            dmHttpCache::Release(client->m_HttpCache, client->m_CacheKey, cache_etag, file);
+            return r;
         }
-        else
+
+        dmHttpCache::SetVerified(cache, cache_key, true);
+        return RESULT_OK;
+    }
+
+#if !defined(DM_NO_HTTP_CACHE)
+    struct CachedContentContext
+    {
+        HClient     m_Client;
+        Response*   m_Response;
+        int         m_Status;
+        const char* m_Method;
+    };
+
+    static void HttpContentCached(void* user_data, const char* content, uint32_t content_size, uint32_t file_size,
+                                  uint32_t range_start, uint32_t range_end, uint32_t document_size)
+    {
+        CachedContentContext* ctx = (CachedContentContext*) user_data;
+        HClient client = ctx->m_Client;
+        client->m_HttpContent(ctx->m_Response, client->m_Userdata, ctx->m_Status, content, content_size, file_size,
+                              range_start, range_end, document_size,
+                              ctx->m_Method);
+    }
+
+    static Result HandleCached(HClient client, const char* path, Response* response, bool method_is_head)
+    {
+        client->m_Statistics.m_CachedResponses++;
+        if (client->m_IgnoreCache)
         {
-            return RESULT_IO_ERROR;
+            return RESULT_OK;
         }
 
-        dmHttpCache::SetVerified(client->m_HttpCache, client->m_CacheKey, true);
+        if (client->m_HttpCache == 0)
+        {
+            dmLogWarning("Got HTTP response NOT MODIFIED (304) but no cache present");
+            return RESULT_OK;
+        }
 
-        return RESULT_OK;
+        // NOTE: We have an extra byte for null-termination so no buffer overrun here.
+        CachedContentContext ctx = { client, response, response->m_Status, method_is_head ? "HEAD" : 0 };
+        return ReadNotModified(client->m_HttpCache, client->m_CacheKey, response->m_ETag, !method_is_head,
+                               client->m_Buffer, BUFFER_SIZE + 1, &HttpContentCached, &ctx);
     }
 #endif
 
@@ -921,75 +1055,76 @@ bail:
         else if (response->m_Chunked)
         {
             // Chunked encoding
-            // Move actual data to the beginning of the buffer
-            memmove(client->m_Buffer, client->m_Buffer + response->m_ContentOffset, response->m_TotalReceived - response->m_ContentOffset);
-
-            response->m_TotalReceived = response->m_TotalReceived - response->m_ContentOffset;
-            response->m_ContentOffset = 0;
-
-            int chunk_size;
-            while(true)
+            ChunkDecoder decoder;
+            while (true)
             {
-                chunk_size = 0;
-                // NOTE: We have an extra byte for null-termination so no buffer overrun here.
-                client->m_Buffer[response->m_TotalReceived] = '\0';
-
-                char* chunk_size_end = strstr(client->m_Buffer, "\r\n");
-                if (chunk_size_end)
+                // The content is passed on directly from the buffer
+                ChunkResult chunk_result = CHUNK_RESULT_NEED_MORE_DATA;
+                while (response->m_ContentOffset < response->m_TotalReceived)
                 {
-                    // We found a chunk
-                    sscanf(client->m_Buffer, "%x", &chunk_size);
-                    chunk_size_end += 2; // "\r\n"
-
-                    // Move content-offset after chunk termination, ie after "\r\n"
-                    response->m_ContentOffset = chunk_size_end - client->m_Buffer;
-                    r = DoTransfer(client, response, chunk_size, client->m_HttpContent, true, method);
-                    if (r != RESULT_OK)
-                        break;
-
-                    // Consume \r\n"
-                    // NOTE: *not* added to cache
-                    r = DoTransfer(client, response, 2, &HttpContentConsume, false, method);
-                    if (r != RESULT_OK)
+                    uint32_t consumed;
+                    const char* content;
+                    uint32_t content_size;
+                    chunk_result = DecodeChunk(&decoder, client->m_Buffer + response->m_ContentOffset, response->m_TotalReceived - response->m_ContentOffset,
+                                               &consumed, &content, &content_size);
+                    response->m_ContentOffset += consumed;
+                    if (chunk_result != CHUNK_RESULT_CONTENT)
                         break;
 
-                    if (chunk_size == 0)
+                    client->m_HttpContent(response, client->m_Userdata, response->m_Status, content, content_size, response->m_ContentLength,
+                                          response->m_RangeStart, response->m_RangeEnd, response->m_DocumentSize,
+                                          method);
+#if !defined(DM_NO_HTTP_CACHE)
+                    if (response->m_CacheCreator)
                     {
-                        r = RESULT_OK;
-                        break;
+                        dmHttpCache::Add(client->m_HttpCache, response->m_CacheCreator, content, content_size);
                     }
+#endif
                 }
-                else
+
+                if (chunk_result == CHUNK_RESULT_ERROR)
+                {
+                    return RESULT_INVALID_RESPONSE;
+                }
+                else if (chunk_result == CHUNK_RESULT_DONE)
                 {
-                    // We need more data
-                    int max_to_recv = BUFFER_SIZE - response->m_TotalReceived;
+                    // Move "extra" bytes to buffer start
+                    memmove(client->m_Buffer, client->m_Buffer + response->m_ContentOffset, response->m_TotalReceived - response->m_ContentOffset);
+                    response->m_TotalReceived = response->m_TotalReceived - response->m_ContentOffset;
+                    response->m_ContentOffset = 0;
+                    r = RESULT_OK;
+                    break;
+                }
 
-                    if (max_to_recv <= 0)
-                    {
-                        return RESULT_HTTP_HEADERS_ERROR;
-                    }
+                // All received data is decoded, we need more data
+                response->m_ContentOffset = 0;
+                response->m_TotalReceived = 0;
 
-                    int recv_bytes;
-                    dmSocket::Result sock_r = Receive(response, client->m_Buffer + response->m_TotalReceived, max_to_recv, &recv_bytes);
+                int recv_bytes;
+                dmSocket::Result sock_r = Receive(response, client->m_Buffer, BUFFER_SIZE, &recv_bytes);
 
-                    if( sock_r == dmSocket::RESULT_WOULDBLOCK )
-                    {
-                        sock_r = dmSocket::RESULT_TRY_AGAIN;
-                    }
-                    if( (sock_r == dmSocket::RESULT_OK || sock_r == dmSocket::RESULT_TRY_AGAIN) && HasRequestTimedOut(client) )
-                    {
-                        sock_r = dmSocket::RESULT_WOULDBLOCK;
-                    }
+                if( sock_r == dmSocket::RESULT_WOULDBLOCK )
+                {
+                    sock_r = dmSocket::RESULT_TRY_AGAIN;
+                }
+                if( (sock_r == dmSocket::RESULT_OK || sock_r == dmSocket::RESULT_TRY_AGAIN) && HasRequestTimedOut(client) )
+                {
+                    sock_r = dmSocket::RESULT_WOULDBLOCK;
+                }
 
-                    if (sock_r == dmSocket::RESULT_TRY_AGAIN)
-                        continue;
+                if (sock_r == dmSocket::RESULT_TRY_AGAIN)
+                    continue;
 
-                    if (sock_r != dmSocket::RESULT_OK)
-                    {
-                        return RESULT_SOCKET_ERROR;
-                    }
-                    response->m_TotalReceived += recv_bytes;
+                if (sock_r != dmSocket::RESULT_OK)
+                {
+                    return RESULT_SOCKET_ERROR;
                 }
+
+                if (recv_bytes == 0)
+                {
+                    return RESULT_PARTIAL_CONTENT;
+                }
+                response->m_TotalReceived = recv_bytes;
             }
         }
         else
@@ -1235,35 +1370,11 @@ bail:
         Response response(client);
         client->m_Statistics.m_DirectFromCache++;
 
-        FILE* file = 0;
-        uint32_t file_size = 0;
-        uint64_t checksum;
-        uint32_t range_start;
-        uint32_t range_end;
-        uint32_t document_size;
-
-        dmHttpCache::Result cache_result = dmHttpCache::Get(client->m_HttpCache, client->m_CacheKey, info->m_ETag, &file, &file_size, &checksum,
-                                                            &range_start, &range_end, &document_size);
-        if (cache_result == dmHttpCache::RESULT_OK)
-        {
-            // NOTE: We have an extra byte for null-termination so no buffer overrun here.
-            size_t nread;
-            do
-            {
-                nread = fread(client->m_Buffer, 1, BUFFER_SIZE, file);
-                client->m_Buffer[nread] = '\0';
-                client->m_HttpContent(&response, client->m_Userdata, 304, client->m_Buffer, nread, file_size,
-                                      range_start, range_end, document_size,
-                                      "GET");
-            }
-            while (nread > 0);
-            dmHttpCache::Release(client->m_HttpCache, client->m_CacheKey, info->m_ETag, file);
-            return RESULT_NOT_200_OK;
-        }
-        else
-        {
-            return RESULT_IO_ERROR;
-        }
+        // NOTE: We have an extra byte for null-termination so no buffer overrun here.
+        CachedContentContext ctx = { client, &response, 304, "GET" };
+        Result r = ReadCachedContent(client->m_HttpCache, client->m_CacheKey, info->m_ETag, true,
+                                     client->m_Buffer, BUFFER_SIZE + 1, &HttpContentCached, &ctx);
+        return r == RESULT_OK ? RESULT_NOT_200_OK : r;
     }
 #endif
 
@@ -326,6 +326,115 @@ namespace dmHttpClient
      */
     const char* ResultToString(Result result);
 
+    /**
+     * The response header fields that decide how the body is transferred and cached.
+     * Used by the client, and by code that does its own (non-blocking) socket io.
+     */
+    struct ResponseHeaders
+    {
+        ResponseHeaders();
+
+        int      m_Major;
+        int      m_Minor;
+        int      m_Status;
+        int      m_ContentLength;       // Size of the payload sent over the http, -1 if not present
+        int      m_RangeStart;
+        int      m_RangeEnd;
+        int      m_DocumentSize;        // The actual size of the file itself (!= content length)
+        char     m_ETag[dmHttpCache::MAX_TAG_LEN];
+        uint32_t m_Chunked : 1;
+        uint32_t m_CloseConnection : 1;
+        uint32_t m_MaxAge;
+    };
+
+    /**
+     * Store the status line of a response. To be called from the version callback of ParseHeader()
+     * @param headers Response headers
+     * @param major Major version
+     * @param minor Minor version
+     * @param status Status code
+     */
+    void SetResponseVersion(ResponseHeaders* headers, int major, int minor, int status);
+
+    /**
+     * Store a response header field. To be called from the header callback of ParseHeader()
+     * @param headers Response headers
+     * @param key Header key
+     * @param value Header value
+     */
+    void SetResponseHeader(ResponseHeaders* headers, const char* key, const char* value);
+
+    /**
+     * Incremental decoder of a body with "Transfer-Encoding: chunked", for data that arrives in pieces
+     */
+    struct ChunkDecoder
+    {
+        ChunkDecoder();
+
+        uint32_t m_State;
+        uint32_t m_ChunkLeft;       // Data left of the current chunk
+        uint32_t m_Digits;          // Digits read of the current chunk size
+        uint32_t m_LineLength;      // Length of the current trailer line
+    };
+
+    enum ChunkResult
+    {
+        CHUNK_RESULT_CONTENT = 1,           //!< Content data was found
+        CHUNK_RESULT_NEED_MORE_DATA = 0,    //!< All data was consumed
+        CHUNK_RESULT_DONE = -1,             //!< The terminating chunk and trailer were consumed
+        CHUNK_RESULT_ERROR = -2,            //!< Invalid chunk encoding
+    };
+
+    /**
+     * Decode the next part of a chunked body.
+     * @param decoder Decoder
+     * @param data Received data
+     * @param size Size of data
+     * @param consumed [out] Number of bytes of data that were consumed
+     * @param content [out] Set to the content found in data for CHUNK_RESULT_CONTENT
+     * @param content_size [out] Size of content
+     * @return CHUNK_RESULT_CONTENT when content was found. Call again with the rest of the data.
+     */
+    ChunkResult DecodeChunk(ChunkDecoder* decoder, const char* data, uint32_t size, uint32_t* consumed, const char** content, uint32_t* content_size);
+
+    /**
+     * Called with the content of a cached entry. The content is null terminated.
+     * A final call with zero content size marks the end of the entry.
+     */
+    typedef void (*CachedContent)(void* user_data, const char* content, uint32_t content_size, uint32_t file_size,
+                                  uint32_t range_start, uint32_t range_end, uint32_t document_size);
+
+    /**
+     * Read a cached entry.
+     * @param cache Cache
+     * @param cache_key Cache key
+     * @param etag ETag of the entry
+     * @param read_content If false only the size of the entry is reported, with a single call without content
+     * @param buffer Buffer to read into. One byte is reserved for the null termination
+     * @param buffer_size Size of buffer
+     * @param callback Called with the content
+     * @param user_data User data to the callback
+     * @return RESULT_OK on success
+     */
+    Result ReadCachedContent(dmHttpCache::HCache cache, const char* cache_key, const char* etag, bool read_content,
+                             char* buffer, uint32_t buffer_size, CachedContent callback, void* user_data);
+
+    /**
+     * Read the cached entry for a "304 Not Modified" response, and mark the entry as verified.
+     * Nothing is read if the cache doesn't hold an ETag for the key.
+     * @param cache Cache
+     * @param cache_key Cache key
+     * @param response_etag ETag of the response. May be empty
+     * @param read_content If false only the size of the entry is reported
+     * @param buffer Buffer to read into. One byte is reserved for the null termination
+     * @param buffer_size Size of buffer
+     * @param callback Called with the content
+     * @param user_data User data to the callback
+     * @return RESULT_OK on success, RESULT_IO_ERROR if the ETags mismatch or the entry can't be read
+     */
+    Result ReadNotModified(dmHttpCache::HCache cache, const char* cache_key, const char* response_etag, bool read_content,
+                           char* buffer, uint32_t buffer_size, CachedContent callback, void* user_data);
+
     // For unit tests
     uint32_t GetNumPoolConnections();
 }
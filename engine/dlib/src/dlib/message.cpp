@@ -17,7 +17,7 @@
 #include "message.h"
 #include "atomic.h"
 #include "hash.h"
-#include "hashtable.h"
+#include "hashtable_flat.h"
 #include "array.h"
 #include "condition_variable.h"
 #include "dstrings.h"
@@ -129,7 +129,7 @@ namespace dmMessage
 
     struct MessageContext
     {
-        dmHashTable64<MessageSocket> m_Sockets;
+        dmHashTableFlat64<MessageSocket> m_Sockets;
     };
 
     MessageContext* g_MessageContext = 0;
@@ -257,6 +257,18 @@ namespace dmSocket
         return dmFileDescriptor::PollerHasEvent(&selector->m_Poller, event, socket);
     }
 
+    uint32_t SelectorAdd(Selector* selector, SelectorKind selector_kind, Socket socket)
+    {
+        dmFileDescriptor::PollEvent event = SelectorKindToPollEvent(selector_kind);
+        return dmFileDescriptor::PollerAdd(&selector->m_Poller, event, socket);
+    }
+
+    bool SelectorIsSetAt(Selector* selector, SelectorKind selector_kind, uint32_t index)
+    {
+        dmFileDescriptor::PollEvent event = SelectorKindToPollEvent(selector_kind);
+        return dmFileDescriptor::PollerHasEventAt(&selector->m_Poller, event, index);
+    }
+
     void SelectorZero(Selector* selector)
     {
         dmFileDescriptor::PollerReset(&selector->m_Poller);
@@ -247,6 +247,26 @@ namespace dmSocket
      * @return Number of bits that differs between a and b
      */
     uint32_t BitDifference(Address a, Address b);
+
+    /**
+     * Add a socket to the selector, without looking for an existing entry of the socket.
+     * SelectorSet() and SelectorIsSet() are linear in the number of sockets, so a selector
+     * with many sockets should be rebuilt with this function before each Select().
+     * @param selector Selector
+     * @param selector_kind Kind to set
+     * @param socket Socket to set
+     * @return the index of the entry, to pass to SelectorIsSetAt()
+     */
+    uint32_t SelectorAdd(Selector* selector, SelectorKind selector_kind, Socket socket);
+
+    /**
+     * Check if selector is set for the entry at the index returned by SelectorAdd()
+     * @param selector Selector
+     * @param selector_kind Selector kind
+     * @param index Index of the entry
+     * @return True if set.
+     */
+    bool SelectorIsSetAt(Selector* selector, SelectorKind selector_kind, uint32_t index);
 }
 
 #endif // DM_SOCKET_H
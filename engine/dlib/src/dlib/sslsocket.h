@@ -46,6 +46,18 @@ namespace dmSSLSocket
      * @return RESULT_OK on success
      */
     Result SetSslPublicKeys(const uint8_t* key, uint32_t keylen);
+
+    /**
+     * Switch a connected secure socket between blocking and non-blocking reads.
+     * In non-blocking mode Receive returns RESULT_WOULDBLOCK immediately when no
+     * complete record is available, instead of waiting for the receive timeout.
+     * The underlying socket must be switched with dmSocket::SetBlocking as well.
+     * @name dmSSLSocket::SetBlocking
+     * @param socket secure socket
+     * @param blocking true for blocking reads
+     * @return RESULT_OK on success, RESULT_OPNOTSUPP if the implementation can't read without blocking
+     */
+    dmSocket::Result SetBlocking(Socket socket, bool blocking);
 }
 
 #endif // DM_SSLSOCKET_H
\ No newline at end of file
@@ -392,4 +392,12 @@ namespace dmSSLSocket
     {
         return dmSocket::SetReceiveTimeout(socket->m_Socket, timeout);
     }
+
+    dmSocket::Result SetBlocking(Socket socket, bool blocking)
+    {
+        // The streams buffer decrypted data internally, so readiness of the raw
+        // socket doesn't tell whether a read would block.
+        (void) socket;
+        return blocking ? dmSocket::RESULT_OK : dmSocket::RESULT_OPNOTSUPP;
+    }
 }
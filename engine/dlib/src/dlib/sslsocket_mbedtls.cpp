@@ -62,6 +62,7 @@ struct CustomNetContext
 {
     mbedtls_net_context m_Context;
     uint64_t            m_Timeout;
+    bool                m_NonBlocking;
 };
 
 namespace dmSSLSocket
@@ -117,6 +118,10 @@ static int RecvTimeout(void* _ctx, unsigned char* buf, size_t len, uint32_t time
     if (fd < 0)
         return MBEDTLS_ERR_NET_INVALID_CONTEXT;
 
+    // The socket is non-blocking, so the read returns MBEDTLS_ERR_SSL_WANT_READ when there is no data
+    if (ctx->m_NonBlocking)
+        return mbedtls_net_recv(ctx, buf, len);
+
     if (timeout == 0 && ctx->m_Timeout != 0)
     {
         timeout = ctx->m_Timeout / 1000;
@@ -472,6 +477,12 @@ dmSocket::Result SetReceiveTimeout(Socket socket, uint64_t timeout)
     return dmSocket::RESULT_OK;
 }
 
+dmSocket::Result SetBlocking(Socket socket, bool blocking)
+{
+    socket->m_SSLNetContext->m_NonBlocking = !blocking;
+    return dmSocket::RESULT_OK;
+}
+
 } // namespace dmSSLSocket
 
 #if defined(MBEDTLS_THREADING_ALT)
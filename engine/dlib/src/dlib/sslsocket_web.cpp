@@ -75,4 +75,11 @@ namespace dmSSLSocket
         (void) timeout;
         return dmSocket::RESULT_OPNOTSUPP;
     }
+
+    dmSocket::Result SetBlocking(Socket socket, bool blocking)
+    {
+        (void) socket;
+        (void) blocking;
+        return dmSocket::RESULT_OPNOTSUPP;
+    }
 }
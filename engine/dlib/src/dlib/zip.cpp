@@ -15,6 +15,10 @@
 #include "zip.h"
 #include "zip/zip.h"
 
+#define MINIZ_HEADER_FILE_ONLY
+#include "zip/miniz_rename.h"
+#include "zip/miniz.h"
+
 namespace dmZip
 {
 
@@ -102,5 +106,52 @@ Result GetEntryDataOffset(HZip zip, uint32_t offset, uint32_t size, void* buffer
     return RESULT_OK;
 }
 
+Result GetEntryLocation(HZip zip, uint64_t* local_header_offset, uint32_t* compressed_size)
+{
+    if (zip_entry_index(zip) < 0)
+        return RESULT_NO_SUCH_ENTRY;
+    *local_header_offset = (uint64_t)zip_entry_header_offset(zip);
+    *compressed_size = (uint32_t)(zip_entry_comp_size(zip) & 0xFFFFFFFF);
+    return RESULT_OK;
+}
+
+static uint16_t ReadU16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+Result GetStoredData(const void* archive, uint64_t archive_size, uint64_t local_header_offset, uint32_t compressed_size, const uint8_t** data, bool* deflated)
+{
+    // Local file header: signature (4), version (2), flags (2), method (2), time (2), date (2),
+    //                    crc (4), compressed size (4), size (4), name length (2), extra length (2)
+    const uint32_t LOCAL_HEADER_SIZE = 30;
+    if (local_header_offset + LOCAL_HEADER_SIZE > archive_size)
+        return RESULT_INVALID_DATA;
+
+    const uint8_t* header = (const uint8_t*)archive + local_header_offset;
+    if (header[0] != 'P' || header[1] != 'K' || header[2] != 3 || header[3] != 4)
+        return RESULT_INVALID_DATA;
+
+    uint16_t method = ReadU16(header + 8);
+    if (method != 0 && method != MZ_DEFLATED)
+        return RESULT_UNSUPPORTED;
+
+    uint64_t data_offset = local_header_offset + LOCAL_HEADER_SIZE + ReadU16(header + 26) + ReadU16(header + 28);
+    if (data_offset + compressed_size > archive_size)
+        return RESULT_INVALID_DATA;
+
+    *data = (const uint8_t*)archive + data_offset;
+    *deflated = method == MZ_DEFLATED;
+    return RESULT_OK;
+}
+
+Result Inflate(const void* data, uint32_t data_size, void* buffer, uint32_t buffer_size)
+{
+    // Raw deflate stream, i.e. no zlib header
+    size_t n = tinfl_decompress_mem_to_mem(buffer, buffer_size, data, data_size, 0);
+    if (n == TINFL_DECOMPRESS_MEM_TO_MEM_FAILED || n != buffer_size)
+        return RESULT_INVALID_DATA;
+    return RESULT_OK;
+}
 
 } // namespace
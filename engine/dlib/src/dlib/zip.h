@@ -28,6 +28,8 @@ namespace dmZip
         RESULT_OK,
         RESULT_NO_SUCH_ENTRY,
         RESULT_BUFFER_NOT_LARGE_ENOUGH,
+        RESULT_INVALID_DATA,
+        RESULT_UNSUPPORTED,
     };
 
     /*# Opens a read only zip archive
@@ -98,6 +100,22 @@ namespace dmZip
      *
      */
     Result GetEntryDataOffset(HZip zip, uint32_t offset, uint32_t size, void* buffer, uint32_t* nread);
+
+    /*# get the location of the currently open entry within the archive
+     * Used together with GetStoredData() to read entries from an archive mapped into memory
+     */
+    Result GetEntryLocation(HZip zip, uint64_t* local_header_offset, uint32_t* compressed_size);
+
+    /*# gets the data of an entry, as stored in an archive mapped into memory
+     * Doesn't use the zip handle, and may be called from several threads at the same time
+     * The data is either stored as is, or deflated (see Inflate())
+     */
+    Result GetStoredData(const void* archive, uint64_t archive_size, uint64_t local_header_offset, uint32_t compressed_size, const uint8_t** data, bool* deflated);
+
+    /*# inflates deflated entry data into a buffer of the uncompressed size
+     * May be called from several threads at the same time
+     */
+    Result Inflate(const void* data, uint32_t data_size, void* buffer, uint32_t buffer_size);
 }
 
 #endif // DM_ZIP_H
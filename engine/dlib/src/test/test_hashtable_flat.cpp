@@ -0,0 +1,437 @@
+// Copyright 2020-2026 The Defold Foundation
+// Copyright 2014-2020 King
+// Copyright 2009-2014 Ragnar Svensson, Christian Murray
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include <map>
+
+#define JC_TEST_IMPLEMENTATION
+#include <jc_test/jc_test.h>
+
+#include "dlib/hashtable.h"
+#include "dlib/hashtable_flat.h"
+
+static uint64_t MixKey(uint32_t key)
+{
+    return ((uint64_t) key * 11400714819323198485ull) ^ 0x9e3779b97f4a7c15ull;
+}
+
+TEST(dmHashTableFlat, EmtpyConstructor)
+{
+    dmHashTableFlat32<int> ht;
+
+    EXPECT_EQ(0U, ht.Size());
+    EXPECT_EQ(0U, ht.Capacity());
+    EXPECT_EQ(true, ht.Full());
+    EXPECT_EQ(true, ht.Empty());
+    EXPECT_EQ((int*)0, ht.Get(1));
+}
+
+TEST(dmHashTableFlat, SimplePut)
+{
+    dmHashTableFlat<uint32_t, uint32_t> ht;
+    ht.SetCapacity(10, 10);
+    ht.Put(12, 23);
+
+    uint32_t* val = ht.Get(12);
+    ASSERT_NE((uintptr_t) 0, (uintptr_t) val);
+    EXPECT_EQ((uint32_t) 23, *val);
+
+    ht.Put(12, 24);
+    EXPECT_EQ(1U, ht.Size());
+    EXPECT_EQ((uint32_t) 24, *ht.Get(12));
+    ht.Verify();
+}
+
+TEST(dmHashTableFlat, SimpleErase)
+{
+    dmHashTableFlat64<int> ht;
+    ht.SetCapacity(10);
+    ht.Put(1, 10);
+    ht.Put(2, 20);
+    ht.Put(3, 30);
+
+    ht.Erase(2);
+    EXPECT_EQ(2U, ht.Size());
+    EXPECT_EQ((int*)0, ht.Get(2));
+    EXPECT_EQ(10, *ht.Get(1));
+    EXPECT_EQ(30, *ht.Get(3));
+    ht.Verify();
+}
+
+TEST(dmHashTableFlat, Grow)
+{
+    dmHashTableFlat<uint32_t, int> ht;
+    std::map<uint32_t, int> map;
+
+    for (uint32_t i = 0; i < 40; ++i)
+    {
+        uint32_t n = rand() % 97;
+        for (uint32_t iter = 0; iter < n; ++iter)
+        {
+            if (ht.Full())
+            {
+                ht.OffsetCapacity((rand() % 4) + 1);
+            }
+            uint32_t key = rand();
+            int val = rand();
+            ht.Put(key, val);
+            map[key] = val;
+        }
+
+        ASSERT_EQ(map.size(), ht.Size());
+        for (std::map<uint32_t, int>::iterator iter = map.begin(); iter != map.end(); ++iter)
+        {
+            ASSERT_EQ(iter->second, *ht.Get(iter->first));
+        }
+        ht.Verify();
+    }
+}
+
+// Lots of puts and erases in a full table, which leaves erased slots
+TEST(dmHashTableFlat, Churn)
+{
+    const uint32_t capacity = 200;
+    dmHashTableFlat64<uint32_t> ht;
+    ht.SetCapacity(capacity);
+    std::map<uint64_t, uint32_t> map;
+
+    for (uint32_t i = 0; i < 20000; ++i)
+    {
+        uint64_t key = MixKey(rand() % 1000);
+        if (map.find(key) != map.end())
+        {
+            ht.Erase(key);
+            map.erase(key);
+        }
+        else if (!ht.Full())
+        {
+            ht.Put(key, i);
+            map[key] = i;
+        }
+
+        if ((i % 1000) == 0)
+        {
+            ht.Verify();
+        }
+    }
+
+    ht.Verify();
+    ASSERT_EQ(map.size(), ht.Size());
+    for (std::map<uint64_t, uint32_t>::iterator iter = map.begin(); iter != map.end(); ++iter)
+    {
+        ASSERT_NE((uint32_t*)0, ht.Get(iter->first));
+        ASSERT_EQ(iter->second, *ht.Get(iter->first));
+    }
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        uint64_t key = MixKey(i);
+        ASSERT_EQ(map.find(key) != map.end(), ht.Get(key) != 0);
+    }
+}
+
+// Erasing old keys and putting new ones in a nearly full table leaves erased slots all over the table.
+// They must be reclaimed, so that the empty slots (which stop the probing for a missing key) are never used up
+TEST(dmHashTableFlat, ChurnThenMiss)
+{
+    const uint32_t capacity = 832;
+    const uint32_t live = 800;
+    dmHashTableFlat64<uint32_t> ht;
+    ht.SetCapacity(capacity);
+
+    for (uint32_t i = 0; i < live; ++i)
+    {
+        ht.Put(MixKey(i), i);
+    }
+    uint32_t* first = ht.Get(MixKey(0));
+
+    // Always erase the oldest key (except the first one), and put a new one
+    for (uint32_t i = live; i < live + 100000; ++i)
+    {
+        ht.Erase(MixKey(i - live + 1));
+        ht.Put(MixKey(i), i);
+
+        if ((i % 1000) == 0)
+        {
+            ht.Verify();
+        }
+    }
+
+    ht.Verify();
+    ASSERT_EQ(live, ht.Size());
+    ASSERT_EQ(first, ht.Get(MixKey(0)));
+    ASSERT_EQ(0U, *first);
+    for (uint32_t i = 100001; i < live + 100000; ++i)
+    {
+        ASSERT_NE((uint32_t*)0, ht.Get(MixKey(i)));
+        ASSERT_EQ(i, *ht.Get(MixKey(i)));
+    }
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        ASSERT_EQ((uint32_t*)0, ht.Get(MixKey(live + 100000 + i)));
+    }
+}
+
+// The values must not move during Put/Erase (e.g. resource descriptors are held while loading other resources)
+TEST(dmHashTableFlat, StablePointers)
+{
+    const uint32_t capacity = 64;
+    dmHashTableFlat32<uint32_t> ht;
+    ht.SetCapacity(capacity);
+
+    ht.Put(0xFFFFFFFF, 1);
+    uint32_t* value = ht.Get(0xFFFFFFFF);
+
+    for (uint32_t i = 0; i < 10000; ++i)
+    {
+        uint32_t key = i % (capacity * 2);
+        if (ht.Get(key))
+            ht.Erase(key);
+        else if (!ht.Full())
+            ht.Put(key, i);
+        ASSERT_EQ(value, ht.Get(0xFFFFFFFF));
+    }
+    ASSERT_EQ(1U, *value);
+    ht.Verify();
+}
+
+void IterateCallback(uint32_t* context, const uint32_t* key, int* value)
+{
+    *context += (uint32_t) *value;
+}
+
+TEST(dmHashTableFlat, Iterate)
+{
+    for (uint32_t capacity = 1; capacity < 100; ++capacity)
+    {
+        dmHashTableFlat<uint32_t, int> ht;
+        ht.SetCapacity(capacity);
+
+        uint32_t sum = 0;
+        uint32_t key_sum = 0;
+        for (uint32_t i = 0; i < capacity; ++i)
+        {
+            int x = rand();
+            ht.Put(i, x);
+            sum += (uint32_t) x;
+            key_sum += i;
+        }
+        uint32_t context = 0;
+        ht.Iterate(IterateCallback, &context);
+        ASSERT_EQ(sum, context);
+
+        uint32_t result = 0;
+        uint32_t keyresult = 0;
+        dmHashTableFlat<uint32_t, int>::Iterator iter = ht.GetIterator();
+        while(iter.Next())
+        {
+            keyresult += iter.GetKey();
+            result += (uint32_t) iter.GetValue();
+        }
+        ASSERT_EQ(sum, result);
+        ASSERT_EQ(key_sum, keyresult);
+    }
+}
+
+TEST(dmHashTableFlat, Clear)
+{
+    dmHashTableFlat<uint32_t, int> ht;
+    ht.SetCapacity(32);
+    for (uint32_t iter = 0; iter < 4; ++iter)
+    {
+        for (uint32_t i = 0; i < 32; ++i)
+        {
+            ht.Put(i * 7, (int)i);
+        }
+        ASSERT_TRUE(ht.Full());
+        ht.Clear();
+        ASSERT_TRUE(ht.Empty());
+        ASSERT_EQ((int*)0, ht.Get(7));
+        ht.Verify();
+    }
+}
+
+TEST(dmHashTableFlat, Swap)
+{
+    dmHashTableFlat<int, int> h1;
+    dmHashTableFlat<int, int> h2;
+    h1.SetCapacity(10);
+    h2.SetCapacity(10);
+
+    h1.Put(1, 10);
+    h1.Put(2, 20);
+
+    h2.Put(10, 100);
+    h2.Put(20, 200);
+
+    h1.Swap(h2);
+
+    ASSERT_EQ(10, *h2.Get(1));
+    ASSERT_EQ(20, *h2.Get(2));
+    ASSERT_EQ(100, *h1.Get(10));
+    ASSERT_EQ(200, *h1.Get(20));
+}
+
+// *******************************************************************************
+// Benchmarks against dmHashTable
+
+static void PrintPerformanceResult(const char* name, uint32_t count, jc_test_time_t usec, uint64_t checksum)
+{
+    double ns_per_op = usec == 0 ? 0.0 : ((double) usec * 1000.0) / (double) count;
+    jc_test_get_logger()->Logf("%s: %u ops, %lu us, %.2f ns/op, checksum=%llu\n", name, count, (unsigned long) usec, ns_per_op, (unsigned long long) checksum);
+}
+
+template <typename TableType>
+static void RunPerformance64(const char* name, uint32_t N)
+{
+    TableType ht;
+    ht.SetCapacity(N);
+
+    char label[128];
+
+    jc_test_time_t start_put = jc_test_get_time();
+    for (uint32_t i = 0; i < N; ++i)
+    {
+        ht.Put(MixKey(i), (uint64_t) i * 10);
+    }
+    jc_test_time_t end_put = jc_test_get_time();
+
+    uint64_t checksum = 0;
+    jc_test_time_t start_get = jc_test_get_time();
+    for (uint32_t i = 0; i < N; ++i)
+    {
+        uint64_t* value = ht.Get(MixKey(i));
+        checksum += value ? *value : 0;
+    }
+    jc_test_time_t end_get = jc_test_get_time();
+
+    // Lookups of missing keys
+    uint32_t num_found = 0;
+    jc_test_time_t start_miss = jc_test_get_time();
+    for (uint32_t i = 0; i < N; ++i)
+    {
+        num_found += ht.Get(MixKey(N + i)) != 0 ? 1 : 0;
+    }
+    jc_test_time_t end_miss = jc_test_get_time();
+
+    jc_test_time_t start_erase = jc_test_get_time();
+    for (uint32_t i = 0; i < N; i += 2)
+    {
+        ht.Erase(MixKey(i));
+    }
+    jc_test_time_t end_erase = jc_test_get_time();
+
+    snprintf(label, sizeof(label), "%s.Put", name);
+    PrintPerformanceResult(label, N, end_put - start_put, checksum);
+    snprintf(label, sizeof(label), "%s.Get", name);
+    PrintPerformanceResult(label, N, end_get - start_get, checksum);
+    snprintf(label, sizeof(label), "%s.GetMissing", name);
+    PrintPerformanceResult(label, N, end_miss - start_miss, checksum);
+    snprintf(label, sizeof(label), "%s.EraseHalf", name);
+    PrintPerformanceResult(label, (N + 1) / 2, end_erase - start_erase, checksum);
+
+    ASSERT_EQ(0U, num_found);
+    ASSERT_EQ(N / 2, ht.Size());
+    ASSERT_EQ((uint64_t) N * (N - 1) * 5, checksum);
+
+    // Check every key after the erase (not timed)
+    for (uint32_t i = 0; i < N; ++i)
+    {
+        uint64_t* value = ht.Get(MixKey(i));
+        if (i % 2 == 0)
+        {
+            ASSERT_EQ((uint64_t*) 0, value);
+        }
+        else
+        {
+            ASSERT_NE((uint64_t*) 0, value);
+            ASSERT_EQ((uint64_t) i * 10, *value);
+        }
+    }
+}
+
+// Lookups of missing keys, after many erases and puts in a nearly full table
+template <typename TableType>
+static void RunChurnPerformance64(const char* name, uint32_t capacity, uint32_t live, uint32_t num_churn)
+{
+    TableType ht;
+    ht.SetCapacity(capacity);
+
+    for (uint32_t i = 0; i < live; ++i)
+    {
+        ht.Put(MixKey(i), (uint64_t) i);
+    }
+
+    jc_test_time_t start_churn = jc_test_get_time();
+    for (uint32_t i = live; i < live + num_churn; ++i)
+    {
+        ht.Erase(MixKey(i - live));
+        ht.Put(MixKey(i), (uint64_t) i);
+    }
+    jc_test_time_t end_churn = jc_test_get_time();
+
+    const uint32_t N = 32768;
+    uint32_t num_found = 0;
+    jc_test_time_t start_miss = jc_test_get_time();
+    for (uint32_t i = 0; i < N; ++i)
+    {
+        num_found += ht.Get(MixKey(live + num_churn + i)) != 0 ? 1 : 0;
+    }
+    jc_test_time_t end_miss = jc_test_get_time();
+
+    char label[128];
+    snprintf(label, sizeof(label), "%s.Churn", name);
+    PrintPerformanceResult(label, num_churn, end_churn - start_churn, 0);
+    snprintf(label, sizeof(label), "%s.GetMissingAfterChurn", name);
+    PrintPerformanceResult(label, N, end_miss - start_miss, 0);
+
+    ASSERT_EQ(0U, num_found);
+    ASSERT_EQ(live, ht.Size());
+    for (uint32_t i = num_churn; i < live + num_churn; ++i)
+    {
+        uint64_t* value = ht.Get(MixKey(i));
+        ASSERT_NE((uint64_t*) 0, value);
+        ASSERT_EQ((uint64_t) i, *value);
+    }
+}
+
+TEST(dmHashTableFlat, Performance64)
+{
+    const uint32_t N = 32768;
+    RunPerformance64<dmHashTable64<uint64_t> >("dmHashTable64", N);
+    RunPerformance64<dmHashTableFlat64<uint64_t> >("dmHashTableFlat64", N);
+}
+
+TEST(dmHashTableFlat, Performance64Small)
+{
+    // Typical size of e.g. the message sockets
+    const uint32_t N = 256;
+    RunPerformance64<dmHashTable64<uint64_t> >("dmHashTable64(small)", N);
+    RunPerformance64<dmHashTableFlat64<uint64_t> >("dmHashTableFlat64(small)", N);
+}
+
+TEST(dmHashTableFlat, PerformanceChurn64)
+{
+    // The flat table uses 1024 slots for this capacity
+    RunChurnPerformance64<dmHashTable64<uint64_t> >("dmHashTable64(churn)", 832, 830, 100000);
+    RunChurnPerformance64<dmHashTableFlat64<uint64_t> >("dmHashTableFlat64(churn)", 832, 830, 100000);
+}
+
+int main(int argc, char **argv)
+{
+    jc_test_init(&argc, argv);
+    return jc_test_run_all();
+}
@@ -509,6 +509,70 @@ TEST_F(dmHttpClientParserTest, TestNoContent)
     ASSERT_EQ("Jetty(7.0.2.v20100331)", m_Headers["Server"]);
 }
 
+// Decodes the body, fed in pieces of at most piece_size bytes. Returns the last result
+static dmHttpClient::ChunkResult DecodeChunked(const char* body, uint32_t piece_size, std::string* content, uint32_t* left)
+{
+    dmHttpClient::ChunkDecoder decoder;
+    dmHttpClient::ChunkResult r = dmHttpClient::CHUNK_RESULT_NEED_MORE_DATA;
+    uint32_t size = strlen(body);
+    uint32_t offset = 0;
+    while (offset < size)
+    {
+        uint32_t piece = dmMath::Min(piece_size, size - offset);
+        const char* data = body + offset;
+        while (piece > 0)
+        {
+            uint32_t consumed;
+            const char* chunk;
+            uint32_t chunk_size;
+            r = dmHttpClient::DecodeChunk(&decoder, data, piece, &consumed, &chunk, &chunk_size);
+            if (r == dmHttpClient::CHUNK_RESULT_CONTENT)
+            {
+                content->append(chunk, chunk_size);
+            }
+            data += consumed;
+            piece -= consumed;
+            offset += consumed;
+            if (r == dmHttpClient::CHUNK_RESULT_DONE || r == dmHttpClient::CHUNK_RESULT_ERROR)
+            {
+                *left = size - offset;
+                return r;
+            }
+        }
+    }
+    *left = 0;
+    return r;
+}
+
+TEST(dmHttpClientChunkDecoder, Decode)
+{
+    const char* body = "4\r\nWiki\r\n6;ext=1\r\npedia \r\nE\r\nin \r\n\r\nchunks.\r\n0\r\nExpires: never\r\n\r\nleft";
+    for (uint32_t piece_size = 1; piece_size <= strlen(body); ++piece_size)
+    {
+        std::string content;
+        uint32_t left = 0;
+        ASSERT_EQ(dmHttpClient::CHUNK_RESULT_DONE, DecodeChunked(body, piece_size, &content, &left));
+        ASSERT_EQ("Wikipedia in \r\n\r\nchunks.", content);
+        ASSERT_EQ(4U, left);
+    }
+}
+
+TEST(dmHttpClientChunkDecoder, Partial)
+{
+    std::string content;
+    uint32_t left = 0;
+    ASSERT_EQ(dmHttpClient::CHUNK_RESULT_NEED_MORE_DATA, DecodeChunked("4\r\nWiki\r\n0\r\n", 3, &content, &left));
+    ASSERT_EQ("Wiki", content);
+}
+
+TEST(dmHttpClientChunkDecoder, Invalid)
+{
+    std::string content;
+    uint32_t left = 0;
+    ASSERT_EQ(dmHttpClient::CHUNK_RESULT_ERROR, DecodeChunked("x\r\n", 16, &content, &left));
+    ASSERT_EQ(dmHttpClient::CHUNK_RESULT_ERROR, DecodeChunked("123456789\r\n", 16, &content, &left));
+}
+
 #ifndef DM_DISABLE_HTTPCLIENT_TESTS
 
 #if defined(DM_PLATFORM_VENDOR)
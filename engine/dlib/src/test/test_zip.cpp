@@ -185,6 +185,54 @@ TEST_P(ZipArchiveTest, ReadPartial)
     dmZip::CloseEntry(m_Zip);
 }
 
+TEST_P(ZipArchiveTest, ReadStoredData)
+{
+    std::string archive;
+    ASSERT_TRUE(ReadFile(GetParam().m_Path, &archive));
+
+    const char* names[] = { "hello.txt", "dir/data.bin" };
+    const uint8_t* expected[] = { (const uint8_t*)"Hello Zip\n", ExpectedDataBin };
+
+    for (uint32_t i = 0; i < sizeof(names)/sizeof(names[0]); ++i)
+    {
+        dmZip::Result zr = dmZip::OpenEntry(m_Zip, names[i]);
+        ASSERT_EQ(dmZip::RESULT_OK, zr);
+
+        uint32_t size = 0;
+        dmZip::GetEntrySize(m_Zip, &size);
+
+        uint64_t local_header_offset = 0;
+        uint32_t compressed_size = 0;
+        zr = dmZip::GetEntryLocation(m_Zip, &local_header_offset, &compressed_size);
+        ASSERT_EQ(dmZip::RESULT_OK, zr);
+        dmZip::CloseEntry(m_Zip);
+
+        const uint8_t* data = 0;
+        bool deflated = false;
+        zr = dmZip::GetStoredData(archive.data(), archive.size(), local_header_offset, compressed_size, &data, &deflated);
+        ASSERT_EQ(dmZip::RESULT_OK, zr);
+
+        std::string buffer;
+        buffer.resize(size);
+        if (deflated)
+        {
+            zr = dmZip::Inflate(data, compressed_size, &buffer[0], size);
+            ASSERT_EQ(dmZip::RESULT_OK, zr);
+        }
+        else
+        {
+            ASSERT_EQ(size, compressed_size);
+            memcpy(&buffer[0], data, size);
+        }
+        ASSERT_ARRAY_EQ_LEN(expected[i], (const uint8_t*)buffer.data(), size);
+    }
+
+    // Out of bounds
+    const uint8_t* data = 0;
+    bool deflated = false;
+    ASSERT_EQ(dmZip::RESULT_INVALID_DATA, dmZip::GetStoredData(archive.data(), archive.size(), archive.size(), 1, &data, &deflated));
+}
+
 const ZipArchiveParams params_zip_archives[] = {
     { "src/test/data/zip/archive_deflated.zip", false },
     { "src/test/data/zip/archive_stored.zip", false },
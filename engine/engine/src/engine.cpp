@@ -104,6 +104,12 @@ extern uint32_t      DEBUG_SPC_SIZE;
 DM_PROPERTY_EXTERN(rmtp_Script);
 DM_PROPERTY_U32(rmtp_LuaMem, 0, PROFILE_PROPERTY_FRAME_RESET, "kb", &rmtp_Script); // kilo bytes
 DM_PROPERTY_U32(rmtp_LuaRefs, 0, PROFILE_PROPERTY_FRAME_RESET, "# Lua references", &rmtp_Script);
+DM_PROPERTY_U32(rmtp_LuaMemGO, 0, PROFILE_PROPERTY_FRAME_RESET, "kb, game object (or shared) state", &rmtp_Script);
+DM_PROPERTY_U32(rmtp_LuaMemGui, 0, PROFILE_PROPERTY_FRAME_RESET, "kb, gui state", &rmtp_Script);
+DM_PROPERTY_U32(rmtp_LuaMemRender, 0, PROFILE_PROPERTY_FRAME_RESET, "kb, render state", &rmtp_Script);
+DM_PROPERTY_U32(rmtp_LuaGCTimeGO, 0, PROFILE_PROPERTY_FRAME_RESET, "us, game object (or shared) state", &rmtp_Script);
+DM_PROPERTY_U32(rmtp_LuaGCTimeGui, 0, PROFILE_PROPERTY_FRAME_RESET, "us, gui state", &rmtp_Script);
+DM_PROPERTY_U32(rmtp_LuaGCTimeRender, 0, PROFILE_PROPERTY_FRAME_RESET, "us, render state", &rmtp_Script);
 
 namespace dmEngine
 {
@@ -408,6 +414,7 @@ namespace dmEngine
     , m_ConnectionAppMode(false)
     , m_RunWhileIconified(false)
     , m_UseSwVSync(false)
+    , m_LuaGCBudgetUs(0)
     , m_Width(960)
     , m_Height(640)
     , m_InvPhysicalWidth(1.0f/960)
@@ -1231,11 +1238,48 @@ namespace dmEngine
         params.m_HttpCache = engine->m_HttpCache;
         params.m_JobThreadContext = engine->m_JobThreadContext;
 
+        // 0: no verification, 1: verify the whole bundled archive at startup, 2: verify each resource on first load
+        char verify_record_dir[1024];
+        int verify_mode = dmConfigFile::GetInt(engine->m_Config, "resource.verify_archive", 0);
+        if (verify_mode < dmResource::ARCHIVE_VERIFY_MODE_NONE || verify_mode > dmResource::ARCHIVE_VERIFY_MODE_LAZY)
+        {
+            dmLogWarning("Invalid value for resource.verify_archive: %d", verify_mode);
+            verify_mode = dmResource::ARCHIVE_VERIFY_MODE_NONE;
+        }
+        params.m_ArchiveVerifyMode = (dmResource::ArchiveVerifyMode)verify_mode;
+        if (params.m_ArchiveVerifyMode == dmResource::ARCHIVE_VERIFY_MODE_FULL &&
+            dmSys::GetApplicationSupportPath(DMSYS_APPLICATION_NAME, verify_record_dir, sizeof(verify_record_dir)) == dmSys::RESULT_OK)
+        {
+            // Cache the result, so that an unchanged archive isn't verified again on the next start
+            dmStrlCat(verify_record_dir, "/archive-verify", sizeof(verify_record_dir));
+            dmSys::Result sys_result = dmSys::Mkdir(verify_record_dir, 0755);
+            if (sys_result == dmSys::RESULT_OK || sys_result == dmSys::RESULT_EXIST)
+            {
+                params.m_ArchiveVerifyRecordDir = verify_record_dir;
+            }
+        }
+
         if (dLib::IsDebugMode())
         {
             params.m_Flags = RESOURCE_FACTORY_FLAGS_RELOAD_SUPPORT;
         }
 
+        // Replay the recorded prefetch lists, or record new ones into the given directory
+        if (dmConfigFile::GetInt(engine->m_Config, "resource.prefetch", 0))
+        {
+            params.m_Flags |= RESOURCE_FACTORY_FLAGS_PREFETCH;
+        }
+        // Let paths with identical content (according to the manifests) share the same resource
+        if (dmConfigFile::GetInt(engine->m_Config, "resource.share_content", 0))
+        {
+            params.m_Flags |= RESOURCE_FACTORY_FLAGS_SHARE_CONTENT;
+        }
+        const char* prefetch_record_dir = dmConfigFile::GetString(engine->m_Config, "resource.prefetch_record_dir", "");
+        if (prefetch_record_dir[0] != 0)
+        {
+            params.m_PrefetchRecordDir = prefetch_record_dir;
+        }
+
 #if !defined(DM_RELEASE)
         params.m_ArchiveIndex.m_Data = (const void*) BUILTINS_ARCI;
         params.m_ArchiveIndex.m_Size = BUILTINS_ARCI_SIZE;
@@ -1261,13 +1305,19 @@ namespace dmEngine
         script_params.m_Factory         = engine->m_Factory;
         script_params.m_ConfigFile      = engine->m_Config;
         script_params.m_GraphicsContext = engine->m_GraphicsContext;
+        script_params.m_UseCustomAllocator = dmConfigFile::GetInt(engine->m_Config, "script.custom_allocator", 0) != 0;
 
+        const uint64_t mb = 1024 * 1024;
+        uint64_t go_memory_budget = (uint64_t)dmMath::Max(0, dmConfigFile::GetInt(engine->m_Config, "script.memory_budget_go", 0)) * mb;
+        uint64_t gui_memory_budget = (uint64_t)dmMath::Max(0, dmConfigFile::GetInt(engine->m_Config, "script.memory_budget_gui", 0)) * mb;
+        uint64_t render_memory_budget = (uint64_t)dmMath::Max(0, dmConfigFile::GetInt(engine->m_Config, "script.memory_budget_render", 0)) * mb;
 
         ScopedExtensionParams extension_params(engine);
 
         bool shared = dmConfigFile::GetInt(engine->m_Config, "script.shared_state", 0);
         if (shared)
         {
+            script_params.m_MemoryBudget = go_memory_budget;
             engine->m_SharedScriptContext = dmScript::NewContext(script_params);
             dmScript::Initialize(engine->m_SharedScriptContext);
             extension_params.SetLuaContext(engine->m_SharedScriptContext);
@@ -1281,16 +1331,19 @@ namespace dmEngine
         }
         else
         {
+            script_params.m_MemoryBudget = go_memory_budget;
             engine->m_GOScriptContext = dmScript::NewContext(script_params);
             dmScript::Initialize(engine->m_GOScriptContext);
             extension_params.SetLuaContext(engine->m_GOScriptContext);
             dmExtension::Initialize(extension_params);
 
+            script_params.m_MemoryBudget = render_memory_budget;
             engine->m_RenderScriptContext = dmScript::NewContext(script_params);
             dmScript::Initialize(engine->m_RenderScriptContext);
             extension_params.SetLuaContext(engine->m_RenderScriptContext);
             dmExtension::Initialize(extension_params);
 
+            script_params.m_MemoryBudget = gui_memory_budget;
             engine->m_GuiScriptContext = dmScript::NewContext(script_params);
             dmScript::Initialize(engine->m_GuiScriptContext);
             extension_params.SetLuaContext(engine->m_GuiScriptContext);
@@ -1302,6 +1355,15 @@ namespace dmEngine
             module_script_contexts.Push(engine->m_GuiScriptContext);
         }
 
+        engine->m_LuaGCBudgetUs = (uint32_t)dmMath::Max(0, dmConfigFile::GetInt(engine->m_Config, "script.gc_budget_us", 0));
+        if (engine->m_LuaGCBudgetUs > 0)
+        {
+            for (uint32_t i = 0; i < module_script_contexts.Size(); ++i)
+            {
+                dmScript::SetManualGC(module_script_contexts[i], true);
+            }
+        }
+
         dmSound::InitializeParams sound_params;
         sound_params.m_OutputDevice = "default";
 #if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
@@ -1309,6 +1371,7 @@ namespace dmEngine
 #else
         sound_params.m_UseThread = dmConfigFile::GetInt(engine->m_Config, "sound.use_thread", 1) != 0;
 #endif
+        sound_params.m_JobContext = engine->m_JobThreadContext;
         dmSound::Result soundInit = dmSound::Initialize(engine->m_Config, &sound_params);
         if (dmSound::RESULT_OK == soundInit) {
             dmLogInfo("Initialised sound device '%s'", sound_params.m_OutputDevice);
@@ -1476,6 +1539,7 @@ namespace dmEngine
         engine->m_SpriteContext.m_Factory = engine->m_Factory;
         engine->m_SpriteContext.m_MaxSpriteCount = dmConfigFile::GetInt(engine->m_Config, "sprite.max_count", 128);
         engine->m_SpriteContext.m_Subpixels = dmConfigFile::GetInt(engine->m_Config, "sprite.subpixels", 1);
+        engine->m_SpriteContext.m_OffscreenUpdateInterval = (uint16_t) dmConfigFile::GetInt(engine->m_Config, "sprite.offscreen_update_interval", 1);
 
         engine->m_ModelContext.m_RenderContext = engine->m_RenderContext;
         engine->m_ModelContext.m_Factory = engine->m_Factory;
@@ -1484,6 +1548,9 @@ namespace dmEngine
         engine->m_ModelContext.m_MaxBoneMatrixTextureHeight = (uint16_t) dmConfigFile::GetInt(engine->m_Config, "model.max_bone_matrix_texture_height", 1024);
         engine->m_ModelContext.m_MaxMorphTargetTextureWidth  = (uint16_t) dmConfigFile::GetInt(engine->m_Config, "model.max_morph_target_texture_width", 1024);
         engine->m_ModelContext.m_MaxMorphTargetTextureHeight = (uint16_t) dmConfigFile::GetInt(engine->m_Config, "model.max_morph_target_texture_height", 1024);
+        engine->m_ModelContext.m_OffscreenUpdateInterval = (uint16_t) dmConfigFile::GetInt(engine->m_Config, "model.offscreen_update_interval", 1);
+        engine->m_ModelContext.m_StaticBatching = (uint8_t) dmConfigFile::GetInt(engine->m_Config, "model.static_batching", 0);
+        engine->m_ModelContext.m_JobContext = engine->m_JobThreadContext;
 
         engine->m_LabelContext.m_RenderContext      = engine->m_RenderContext;
         engine->m_LabelContext.m_MaxLabelCount      = dmConfigFile::GetInt(engine->m_Config, "label.max_count", 64);
@@ -1853,6 +1920,57 @@ bail:
         return memcount;
     }
 
+    static void UpdateLuaMemProperties(HEngine engine)
+    {
+        if (engine->m_SharedScriptContext) {
+            DM_PROPERTY_SET_U32(rmtp_LuaMemGO, dmScript::GetLuaGCCount(dmScript::GetLuaState(engine->m_SharedScriptContext)));
+        } else {
+            DM_PROPERTY_SET_U32(rmtp_LuaMemGO, dmScript::GetLuaGCCount(dmScript::GetLuaState(engine->m_GOScriptContext)));
+            DM_PROPERTY_SET_U32(rmtp_LuaMemGui, dmScript::GetLuaGCCount(dmScript::GetLuaState(engine->m_GuiScriptContext)));
+            DM_PROPERTY_SET_U32(rmtp_LuaMemRender, dmScript::GetLuaGCCount(dmScript::GetLuaState(engine->m_RenderScriptContext)));
+        }
+    }
+
+    static void AddLuaGCTimeProperty(HEngine engine, dmScript::HContext context, uint64_t time_us)
+    {
+        if (context == engine->m_GOScriptContext) {
+            DM_PROPERTY_ADD_U32(rmtp_LuaGCTimeGO, (uint32_t)time_us);
+        } else if (context == engine->m_GuiScriptContext) {
+            DM_PROPERTY_ADD_U32(rmtp_LuaGCTimeGui, (uint32_t)time_us);
+        } else if (context == engine->m_RenderScriptContext) {
+            DM_PROPERTY_ADD_U32(rmtp_LuaGCTimeRender, (uint32_t)time_us);
+        }
+    }
+
+    // Each script context gets an equal share of the per frame GC budget, so that one context
+    // can't starve the others. The time left is then given to the contexts that still have garbage to collect.
+    static void StepLuaGC(HEngine engine)
+    {
+        dmArray<dmScript::HContext>& contexts = engine->m_ModuleContext.m_ScriptContexts;
+        uint32_t count = contexts.Size();
+        if (count == 0)
+        {
+            return;
+        }
+
+        uint64_t budget = engine->m_LuaGCBudgetUs;
+        uint64_t share = budget / count;
+        uint64_t spent = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint64_t time_us = dmScript::StepGC(contexts[i], share);
+            AddLuaGCTimeProperty(engine, contexts[i], time_us);
+            spent += time_us;
+        }
+
+        for (uint32_t i = 0; i < count && spent < budget; ++i)
+        {
+            uint64_t time_us = dmScript::StepGC(contexts[i], budget - spent);
+            AddLuaGCTimeProperty(engine, contexts[i], time_us);
+            spent += time_us;
+        }
+    }
+
     static void Exit(HEngine engine, int32_t code)
     {
         engine->m_Alive = false;
@@ -2115,10 +2233,16 @@ bail:
                 }
 
                 dmMessage::Dispatch(engine->m_SystemSocket, Dispatch, engine);
+
+                if (engine->m_LuaGCBudgetUs > 0)
+                {
+                    StepLuaGC(engine);
+                }
             } // Sim
 
             DM_PROPERTY_SET_U32(rmtp_LuaRefs, dmScript::GetLuaRefCount());
             DM_PROPERTY_SET_U32(rmtp_LuaMem, GetLuaMemCount(engine));
+            UpdateLuaMemProperties(engine);
 
             if (dLib::IsDebugMode())
             {
@@ -168,6 +168,7 @@ namespace dmEngine
         float                                       m_AccumFrameTime;           // Used to trigger frame updates when using m_UpdateFrequency != 0
         uint32_t                                    m_UpdateFrequency;
         uint32_t                                    m_FixedUpdateFrequency;
+        uint32_t                                    m_LuaGCBudgetUs;            // Per frame Lua GC budget. 0 = automatic GC
         uint32_t                                    m_Width;
         uint32_t                                    m_Height;
         uint32_t                                    m_ClearColor;
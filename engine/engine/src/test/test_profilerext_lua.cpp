@@ -14,6 +14,7 @@
 
 #include <dlib/array.h>
 #include <dlib/configfile.h>
+#include <dlib/hash.h>
 #include <dlib/log.h>
 #include <extension/extension.hpp>
 #include <script/script.h>
@@ -152,6 +153,23 @@ namespace
     };
 
     ProfilerExtLuaTest* ProfilerExtLuaTest::s_LogCaptureContext = 0;
+
+    const char* INSTANCE_SCOPES_PATH = "/instance_scopes_go";
+
+    int InstanceGetURL(lua_State* L)
+    {
+        dmMessage::URL url;
+        dmMessage::ResetURL(&url);
+        url.m_Path = dmHashString64(INSTANCE_SCOPES_PATH);
+        dmScript::PushURL(L, url);
+        return 1;
+    }
+
+    const luaL_reg INSTANCE_META_TABLE[] =
+    {
+        {dmScript::META_TABLE_GET_URL, InstanceGetURL},
+        {0, 0}
+    };
 }
 
 TEST_F(ProfilerExtLuaTest, ScopeEndWithoutBeginRaisesLuaError)
@@ -279,6 +297,87 @@ TEST_F(ProfilerExtLuaTest, GarbageCollectedCoroutineScopeStateIsReleasedOnPreRen
 
 }
 
+TEST_F(ProfilerExtLuaTest, SetInstanceScopes)
+{
+    ASSERT_FALSE(dmScript::GetProfileInstanceScopes());
+
+    ASSERT_TRUE(RunString("profiler.set_instance_scopes(true)\n"));
+    ASSERT_TRUE(dmScript::GetProfileInstanceScopes());
+
+    ASSERT_TRUE(RunString(
+        "assert(not pcall(profiler.set_instance_scopes, 1))\n"
+        "profiler.set_instance_scopes(false)\n"));
+    ASSERT_FALSE(dmScript::GetProfileInstanceScopes());
+}
+
+TEST_F(ProfilerExtLuaTest, InstanceScopeNames)
+{
+    dmHashEnableReverseHash(true);
+
+    char buffer[128];
+    ASSERT_STREQ("update@main/test.script", dmScript::GetProfilerString(m_L, 0, "main/test.script", "update", 0, buffer, sizeof(buffer)));
+
+    // Without a current script instance, the name is the same as before
+    dmScript::SetProfileInstanceScopes(true);
+    ASSERT_STREQ("update@main/test.script", dmScript::GetProfilerString(m_L, 0, "main/test.script", "update", 0, buffer, sizeof(buffer)));
+
+    lua_newuserdata(m_L, 4);
+    luaL_newmetatable(m_L, "ProfilerExtLuaTestInstance");
+    luaL_register(m_L, 0, INSTANCE_META_TABLE);
+    lua_setmetatable(m_L, -2);
+    dmScript::SetInstance(m_L);
+
+    ASSERT_STREQ("update@main/test.script:/instance_scopes_go", dmScript::GetProfilerString(m_L, 0, "main/test.script", "update", 0, buffer, sizeof(buffer)));
+    ASSERT_STREQ("on_message[ping]@main/test.script:/instance_scopes_go", dmScript::GetProfilerString(m_L, 0, "main/test.script", "on_message", "ping", buffer, sizeof(buffer)));
+
+    dmScript::SetProfileInstanceScopes(false);
+    ASSERT_STREQ("update@main/test.script", dmScript::GetProfilerString(m_L, 0, "main/test.script", "update", 0, buffer, sizeof(buffer)));
+
+    lua_pushnil(m_L);
+    dmScript::SetInstance(m_L);
+}
+
+TEST_F(ProfilerExtLuaTest, LuaSampling)
+{
+    ASSERT_TRUE(RunString(
+        "assert(profiler.stop_lua_sampling() == nil)\n"
+        "assert(not pcall(profiler.start_lua_sampling, 0))\n"
+        "if not jit then\n"
+        "    assert(not profiler.start_lua_sampling())\n"
+        "    return\n"
+        "end\n"
+        "assert(profiler.start_lua_sampling(1))\n"
+        "assert(not profiler.start_lua_sampling(1))\n"
+        "local function busy_function()\n"
+        "    local start = os.clock()\n"
+        "    local sum = 0\n"
+        "    while os.clock() - start < 0.2 do\n"
+        "        sum = sum + math.sin(sum)\n"
+        "    end\n"
+        "    return sum\n"
+        "end\n"
+        "busy_function()\n"
+        "local samples = profiler.stop_lua_sampling()\n"
+        "assert(#samples > 0)\n"
+        "for i = 1, #samples do\n"
+        "    assert(type(samples[i].name) == \"string\")\n"
+        "    assert(samples[i].samples > 0)\n"
+        "    if i > 1 then\n"
+        "        assert(samples[i - 1].samples >= samples[i].samples)\n"
+        "    end\n"
+        "end\n"
+        "assert(profiler.stop_lua_sampling() == nil)\n"));
+}
+
+TEST_F(ProfilerExtLuaTest, LuaSamplingIsStoppedOnFinalize)
+{
+    ASSERT_TRUE(RunString("profiler.start_lua_sampling(1)\n"));
+
+    FinalizeExtension();
+
+    ASSERT_TRUE(RunString("assert(profiler.stop_lua_sampling() == nil)\n"));
+}
+
 extern "C" void dmExportedSymbols();
 
 int main(int argc, char **argv)
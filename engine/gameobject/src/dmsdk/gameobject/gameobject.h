@@ -1082,6 +1082,37 @@ namespace dmGameObject
      */
     PropertyResult SetPropertyFromMatrix4(HInstance instance, dmhash_t component_id, dmhash_t property_id, const dmVMath::Matrix4& value);
 
+    /*#
+     * Gets the value of the same property from several instances.
+     * The transform properties (position, rotation, scale) of the game objects are read directly from the instances,
+     * other properties are looked up per instance.
+     * @name GetPropertyMany
+     * @param instances [type:HInstance*] Array of instances to get the property from
+     * @param count [type:uint32_t] Number of instances
+     * @param component_id [type:dmhash_t] Id of the component, or 0 for the game object itself
+     * @param property_id [type:dmhash_t] Id of the property
+     * @param out_values [type:PropertyVar*] Array of at least `count` values that receives the property values
+     * @param out_failed_index [type:uint32_t*] Optional. Receives the index of the first instance that failed
+     * @return PROPERTY_RESULT_OK if all values could be read. Otherwise the result of the first failure, in which case the values from that index and onward are undefined.
+     */
+    PropertyResult GetPropertyMany(const HInstance* instances, uint32_t count, dmhash_t component_id, dmhash_t property_id, PropertyVar* out_values, uint32_t* out_failed_index);
+
+    /*#
+     * Sets the value of the same property on several instances.
+     * The transform properties (position, rotation, scale) of the game objects are written directly to the instances,
+     * other properties are set per instance.
+     * @name SetPropertyMany
+     * @param instances [type:HInstance*] Array of instances to set the property on
+     * @param count [type:uint32_t] Number of instances
+     * @param component_id [type:dmhash_t] Id of the component, or 0 for the game object itself
+     * @param property_id [type:dmhash_t] Id of the property
+     * @param values [type:PropertyVar*] Array of values. If `values_count` is 1, the same value is set on all instances.
+     * @param values_count [type:uint32_t] Number of values, either 1 or `count`
+     * @param out_failed_index [type:uint32_t*] Optional. Receives the index of the first instance that failed
+     * @return PROPERTY_RESULT_OK if all values could be set. Otherwise the result of the first failure, in which case the instances from that index and onward are left untouched.
+     */
+    PropertyResult SetPropertyMany(const HInstance* instances, uint32_t count, dmhash_t component_id, dmhash_t property_id, const PropertyVar* values, uint32_t values_count, uint32_t* out_failed_index);
+
     // These functions are used for profiling functionality
 
     // Currently used internally by component types to implement iteration
@@ -4187,6 +4187,151 @@ namespace dmGameObject
         return r;
     }
 
+    // The transform properties that the bulk functions access directly on the instance
+    enum BulkTransformProperty
+    {
+        BULK_TRANSFORM_PROPERTY_NONE,
+        BULK_TRANSFORM_PROPERTY_POSITION,
+        BULK_TRANSFORM_PROPERTY_ROTATION,
+        BULK_TRANSFORM_PROPERTY_SCALE,
+    };
+
+    static BulkTransformProperty GetBulkTransformProperty(dmhash_t component_id, dmhash_t property_id)
+    {
+        if (component_id != 0)
+            return BULK_TRANSFORM_PROPERTY_NONE;
+        if (property_id == PROP_POSITION)
+            return BULK_TRANSFORM_PROPERTY_POSITION;
+        if (property_id == PROP_ROTATION)
+            return BULK_TRANSFORM_PROPERTY_ROTATION;
+        if (property_id == PROP_SCALE)
+            return BULK_TRANSFORM_PROPERTY_SCALE;
+        return BULK_TRANSFORM_PROPERTY_NONE;
+    }
+
+    PropertyResult GetPropertyMany(const HInstance* instances, uint32_t count, dmhash_t component_id, dmhash_t property_id, PropertyVar* out_values, uint32_t* out_failed_index)
+    {
+        BulkTransformProperty transform_property = GetBulkTransformProperty(component_id, property_id);
+        PropertyOptions options;
+        PropertyDesc desc;
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            HInstance instance = instances[i];
+            PropertyResult result = PROPERTY_RESULT_OK;
+            if (instance == 0)
+            {
+                result = PROPERTY_RESULT_INVALID_INSTANCE;
+            }
+            else if (transform_property == BULK_TRANSFORM_PROPERTY_POSITION)
+            {
+                out_values[i] = PropertyVar(instance->m_Transform.GetTranslation());
+            }
+            else if (transform_property == BULK_TRANSFORM_PROPERTY_ROTATION)
+            {
+                if (HasEulerChanged(instance))
+                {
+                    UpdateEulerToRotation(instance);
+                }
+                out_values[i] = PropertyVar(instance->m_Transform.GetRotation());
+            }
+            else if (transform_property == BULK_TRANSFORM_PROPERTY_SCALE)
+            {
+                out_values[i] = PropertyVar(instance->m_Transform.GetScale());
+            }
+            else
+            {
+                result = GetProperty(instance, component_id, property_id, options, desc);
+                if (result == PROPERTY_RESULT_OK)
+                {
+                    out_values[i] = desc.m_Variant;
+                }
+            }
+
+            if (result != PROPERTY_RESULT_OK)
+            {
+                if (out_failed_index)
+                    *out_failed_index = i;
+                return result;
+            }
+        }
+        return PROPERTY_RESULT_OK;
+    }
+
+    PropertyResult SetPropertyMany(const HInstance* instances, uint32_t count, dmhash_t component_id, dmhash_t property_id, const PropertyVar* values, uint32_t values_count, uint32_t* out_failed_index)
+    {
+        if (values_count != 1 && values_count < count)
+        {
+            if (out_failed_index)
+                *out_failed_index = values_count;
+            return PROPERTY_RESULT_BUFFER_OVERFLOW;
+        }
+
+        BulkTransformProperty transform_property = GetBulkTransformProperty(component_id, property_id);
+        PropertyOptions options;
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            HInstance instance = instances[i];
+            const PropertyVar& value = values[values_count == 1 ? 0 : i];
+            PropertyResult result = PROPERTY_RESULT_OK;
+            if (instance == 0)
+            {
+                result = PROPERTY_RESULT_INVALID_INSTANCE;
+            }
+            else if (transform_property != BULK_TRANSFORM_PROPERTY_NONE)
+            {
+                float* dst = 0;
+                uint32_t dst_count = 0;
+                if (transform_property == BULK_TRANSFORM_PROPERTY_POSITION && value.m_Type == PROPERTY_TYPE_VECTOR3)
+                {
+                    dst = instance->m_Transform.GetPositionPtr();
+                    dst_count = 3;
+                }
+                else if (transform_property == BULK_TRANSFORM_PROPERTY_ROTATION && value.m_Type == PROPERTY_TYPE_QUAT)
+                {
+                    dst = instance->m_Transform.GetRotationPtr();
+                    dst_count = 4;
+                }
+                else if (transform_property == BULK_TRANSFORM_PROPERTY_SCALE && value.m_Type == PROPERTY_TYPE_VECTOR3)
+                {
+                    dst = instance->m_Transform.GetScalePtr();
+                    dst_count = 3;
+                }
+                else if (transform_property == BULK_TRANSFORM_PROPERTY_SCALE && value.m_Type == PROPERTY_TYPE_NUMBER)
+                {
+                    instance->m_Transform.SetUniformScale((float)value.m_Number);
+                    instance->m_Collection->m_DirtyTransforms = 1;
+                }
+                else
+                {
+                    result = PROPERTY_RESULT_TYPE_MISMATCH;
+                }
+
+                if (dst)
+                {
+                    for (uint32_t c = 0; c < dst_count; ++c)
+                    {
+                        dst[c] = value.m_V4[c];
+                    }
+                    instance->m_Collection->m_DirtyTransforms = 1;
+                }
+            }
+            else
+            {
+                result = SetProperty(instance, component_id, property_id, options, value);
+            }
+
+            if (result != PROPERTY_RESULT_OK)
+            {
+                if (out_failed_index)
+                    *out_failed_index = i;
+                return result;
+            }
+        }
+        return PROPERTY_RESULT_OK;
+    }
+
     // Recreate the instance at the given index with a new prototype.
     // Specifically:
     //  - recreate components and call init/final functions
@@ -18,6 +18,7 @@
 
 #include <ddf/ddf.h>
 
+#include <dlib/array.h>
 #include <dlib/log.h>
 #include <dlib/hash.h>
 #include <dlib/hashtable.h>
@@ -859,12 +860,342 @@ namespace dmGameObject
         return 0;
     }
 
+    // Scratch buffers for go.get_many/go.set_many. They are reused between the calls to avoid allocations,
+    // and since they outlive the calls nothing leaks when a Lua error unwinds the stack.
+    struct BulkPropertyScratch
+    {
+        dmArray<HInstance>      m_Instances;
+        dmArray<dmMessage::URL> m_URLs;
+        dmArray<PropertyVar>    m_Values;
+    };
+    static BulkPropertyScratch g_BulkScratch;
+
+    static void PrepareBulkArray(dmArray<PropertyVar>& values, uint32_t count)
+    {
+        if (values.Capacity() < count)
+        {
+            values.SetCapacity(count);
+        }
+        values.SetSize(count);
+    }
+
+    // Resolves every id in the table at 'index' once, for the bulk property functions.
+    // All ids must address the same component (or all none), since the property is looked up by a single component id.
+    static void ResolveBulkInstances(lua_State* L, const char* fn_name, int index)
+    {
+        dmArray<HInstance>& instances = g_BulkScratch.m_Instances;
+        dmArray<dmMessage::URL>& urls = g_BulkScratch.m_URLs;
+        DM_HASH_REVERSE_MEM(hash_ctx, 256);
+        ScriptInstance* i = ScriptInstance_Check(L);
+        HCollection collection = dmGameObject::GetCollection(i->m_Instance);
+        dmMessage::HSocket socket = dmGameObject::GetMessageSocket(i->m_Instance->m_Collection->m_HCollection);
+
+        luaL_checktype(L, index, LUA_TTABLE);
+        uint32_t count = lua_objlen(L, index);
+        instances.SetSize(0);
+        urls.SetSize(0);
+        if (instances.Capacity() < count)
+        {
+            instances.SetCapacity(count);
+            urls.SetCapacity(count);
+        }
+
+        dmMessage::URL sender;
+        dmScript::GetURL(L, &sender);
+        for (uint32_t n = 0; n < count; ++n)
+        {
+            lua_rawgeti(L, index, n + 1);
+            dmMessage::URL target;
+            dmScript::ResolveURL(L, lua_gettop(L), &target, &sender);
+            lua_pop(L, 1);
+
+            if (target.m_Socket != socket)
+            {
+                luaL_error(L, "%s can only access instances within the same collection.", fn_name);
+            }
+            if (n > 0 && target.m_Fragment != urls[0].m_Fragment)
+            {
+                luaL_error(L, "%s requires all ids to address the same component, '%s' differs from '%s'.", fn_name,
+                           dmHashReverseSafe64Alloc(&hash_ctx, target.m_Fragment), dmHashReverseSafe64Alloc(&hash_ctx, urls[0].m_Fragment));
+            }
+            HInstance target_instance = dmGameObject::GetInstanceFromIdentifier(collection, target.m_Path);
+            if (target_instance == 0)
+            {
+                luaL_error(L, "Could not find any instance with id '%s'.", dmHashReverseSafe64Alloc(&hash_ctx, target.m_Path));
+            }
+            instances.Push(target_instance);
+            urls.Push(target);
+        }
+    }
+
+    static int BulkPropertyError(lua_State* L, const char* fn_name, PropertyResult result, dmhash_t property_id, const dmMessage::URL& target)
+    {
+        DM_HASH_REVERSE_MEM(hash_ctx, 512);
+        const char* path = dmHashReverseSafe64Alloc(&hash_ctx, target.m_Path);
+        const char* property = dmHashReverseSafe64Alloc(&hash_ctx, property_id);
+        switch (result)
+        {
+        case PROPERTY_RESULT_NOT_FOUND:
+            return luaL_error(L, "%s: '%s' does not have any property called '%s'", fn_name, path, property);
+        case PROPERTY_RESULT_COMP_NOT_FOUND:
+            return luaL_error(L, "%s: could not find component '%s' in '%s'", fn_name, dmHashReverseSafe64Alloc(&hash_ctx, target.m_Fragment), path);
+        case PROPERTY_RESULT_UNSUPPORTED_TYPE:
+        case PROPERTY_RESULT_TYPE_MISMATCH:
+            return luaL_error(L, "%s: the property '%s' of '%s' has a different type than the value", fn_name, property, path);
+        case PROPERTY_RESULT_READ_ONLY:
+            return luaL_error(L, "%s: unable to set the property '%s' since it is read only", fn_name, property);
+        default:
+            return luaL_error(L, "%s failed for '%s' with error code %d", fn_name, path, result);
+        }
+    }
+
+    /*# gets the same property from several game objects or components
+     *
+     * Gets a named property from each of the specified game objects or components. The ids are resolved and the
+     * property is looked up once per call, which is considerably cheaper than calling [ref:go.get] for each id
+     * when driving a large number of objects.
+     *
+     * All ids must address the same component id (or no component, for the game object properties).
+     *
+     * @name go.get_many
+     * @param ids [type:table] array of ids (string|hash|url) of the game objects or components having the property
+     * @param property [type:string|hash] id of the property to retrieve
+     * @param [out] [type:table] optional table to store the values in. vector3, vector4 and quaternion values already in the table are written to in place, instead of allocating new ones.
+     * @return values [type:table] array of values, in the same order as the ids
+     * @examples
+     *
+     * Read the positions of a swarm, reusing the same table and vectors every frame:
+     *
+     * ```lua
+     * function update(self, dt)
+     *     self.positions = go.get_many(self.ids, "position", self.positions)
+     * end
+     * ```
+     */
+    static int Script_GetMany(lua_State* L)
+    {
+        int top = lua_gettop(L);
+        dmhash_t property_id = dmScript::CheckHashOrString(L, 2);
+
+        ResolveBulkInstances(L, "go.get_many", 1);
+        dmArray<HInstance>& instances = g_BulkScratch.m_Instances;
+        dmArray<dmMessage::URL>& urls = g_BulkScratch.m_URLs;
+        dmArray<PropertyVar>& values = g_BulkScratch.m_Values;
+        uint32_t count = instances.Size();
+        PrepareBulkArray(values, count);
+
+        dmhash_t component_id = count > 0 ? urls[0].m_Fragment : 0;
+        uint32_t failed_index = 0;
+        PropertyResult result = dmGameObject::GetPropertyMany(instances.Begin(), count, component_id, property_id, values.Begin(), &failed_index);
+        if (result != PROPERTY_RESULT_OK)
+        {
+            return BulkPropertyError(L, "go.get_many", result, property_id, urls[failed_index]);
+        }
+
+        if (top >= 3 && lua_istable(L, 3))
+        {
+            lua_pushvalue(L, 3);
+        }
+        else
+        {
+            lua_createtable(L, count, 0);
+        }
+
+        for (uint32_t n = 0; n < count; ++n)
+        {
+            const PropertyVar& var = values[n];
+            bool written = false;
+            if (var.m_Type == PROPERTY_TYPE_VECTOR3 || var.m_Type == PROPERTY_TYPE_VECTOR4 || var.m_Type == PROPERTY_TYPE_QUAT)
+            {
+                lua_rawgeti(L, -1, n + 1);
+                if (var.m_Type == PROPERTY_TYPE_VECTOR3)
+                {
+                    dmVMath::Vector3* v = dmScript::ToVector3(L, -1);
+                    if (v)
+                    {
+                        *v = dmVMath::Vector3(var.m_V4[0], var.m_V4[1], var.m_V4[2]);
+                        written = true;
+                    }
+                }
+                else if (var.m_Type == PROPERTY_TYPE_VECTOR4)
+                {
+                    dmVMath::Vector4* v = dmScript::ToVector4(L, -1);
+                    if (v)
+                    {
+                        *v = dmVMath::Vector4(var.m_V4[0], var.m_V4[1], var.m_V4[2], var.m_V4[3]);
+                        written = true;
+                    }
+                }
+                else
+                {
+                    dmVMath::Quat* q = dmScript::ToQuat(L, -1);
+                    if (q)
+                    {
+                        *q = dmVMath::Quat(var.m_V4[0], var.m_V4[1], var.m_V4[2], var.m_V4[3]);
+                        written = true;
+                    }
+                }
+                lua_pop(L, 1);
+            }
+
+            if (!written)
+            {
+                dmGameObject::LuaPushVar(L, var);
+                lua_rawseti(L, -2, n + 1);
+            }
+        }
+        return 1;
+    }
+
+    /*# sets the same property on several game objects or components
+     *
+     * Sets a named property on each of the specified game objects or components. The ids are resolved and the
+     * property is looked up once per call, and the transform properties (position, rotation and scale) are written
+     * directly to the game objects. This is considerably cheaper than calling [ref:go.set] for each id when driving
+     * a large number of objects.
+     *
+     * All ids must address the same component id (or no component, for the game object properties).
+     * Array properties and the options of [ref:go.set] are not supported.
+     *
+     * @name go.set_many
+     * @param ids [type:table] array of ids (string|hash|url) of the game objects or components having the property
+     * @param property [type:string|hash] id of the property to set
+     * @param values [type:table|number|boolean|hash|url|vector3|vector4|quaternion|resource] array of values, in the same order as the ids, or a single value to set on all of them
+     * @examples
+     *
+     * Move a formation of game objects:
+     *
+     * ```lua
+     * function update(self, dt)
+     *     for i, p in ipairs(self.positions) do
+     *         vmath.add_to(p, p, self.velocity * dt)
+     *     end
+     *     go.set_many(self.ids, "position", self.positions)
+     * end
+     * ```
+     *
+     * Hide a group of sprites:
+     *
+     * ```lua
+     * go.set_many({"a#sprite", "b#sprite", "c#sprite"}, "tint.w", 0)
+     * ```
+     */
+    static int Script_SetMany(lua_State* L)
+    {
+        DM_LUA_STACK_CHECK(L, 0);
+
+        dmhash_t property_id = dmScript::CheckHashOrString(L, 2);
+        if (lua_isnoneornil(L, 3))
+        {
+            return luaL_error(L, "go.set_many requires a value or a table of values.");
+        }
+
+        ResolveBulkInstances(L, "go.set_many", 1);
+        dmArray<HInstance>& instances = g_BulkScratch.m_Instances;
+        dmArray<dmMessage::URL>& urls = g_BulkScratch.m_URLs;
+        dmArray<PropertyVar>& values = g_BulkScratch.m_Values;
+        uint32_t count = instances.Size();
+
+        if (lua_istable(L, 3))
+        {
+            uint32_t values_count = lua_objlen(L, 3);
+            if (values_count != count)
+            {
+                return luaL_error(L, "go.set_many got %d values for %d ids.", values_count, count);
+            }
+            PrepareBulkArray(values, count);
+            for (uint32_t n = 0; n < count; ++n)
+            {
+                lua_rawgeti(L, 3, n + 1);
+                PropertyResult result = dmGameObject::LuaToVar(L, -1, values[n]);
+                lua_pop(L, 1);
+                if (result != PROPERTY_RESULT_OK)
+                {
+                    return BulkPropertyError(L, "go.set_many", result, property_id, urls[n]);
+                }
+            }
+        }
+        else
+        {
+            PrepareBulkArray(values, 1);
+            PropertyResult result = dmGameObject::LuaToVar(L, 3, values[0]);
+            if (result != PROPERTY_RESULT_OK && count > 0)
+            {
+                return BulkPropertyError(L, "go.set_many", result, property_id, urls[0]);
+            }
+        }
+
+        dmhash_t component_id = count > 0 ? urls[0].m_Fragment : 0;
+        uint32_t failed_index = 0;
+        PropertyResult result = dmGameObject::SetPropertyMany(instances.Begin(), count, component_id, property_id, values.Begin(), values.Size(), &failed_index);
+        if (result != PROPERTY_RESULT_OK)
+        {
+            return BulkPropertyError(L, "go.set_many", result, property_id, urls[failed_index]);
+        }
+        return 0;
+    }
+
+    // The transform getters take an optional 'out' value as their second argument, e.g. go.get_position([id], [out]).
+    // If present, the out value is moved to the bottom of the stack so that the id is the last argument for ResolveInstance().
+    static dmVMath::Vector3* GetOutVector3(lua_State* L)
+    {
+        if (lua_isnoneornil(L, 2))
+        {
+            lua_settop(L, 1);
+            return 0;
+        }
+        dmVMath::Vector3* out = dmScript::CheckVector3(L, 2);
+        lua_settop(L, 2);
+        lua_insert(L, 1);
+        return out;
+    }
+
+    static dmVMath::Quat* GetOutQuat(lua_State* L)
+    {
+        if (lua_isnoneornil(L, 2))
+        {
+            lua_settop(L, 1);
+            return 0;
+        }
+        dmVMath::Quat* out = dmScript::CheckQuat(L, 2);
+        lua_settop(L, 2);
+        lua_insert(L, 1);
+        return out;
+    }
+
+    static void PushOrWriteVector3(lua_State* L, dmVMath::Vector3* out, const dmVMath::Vector3& v)
+    {
+        if (out)
+        {
+            *out = v;
+            lua_pushvalue(L, 1);
+        }
+        else
+        {
+            dmScript::PushVector3(L, v);
+        }
+    }
+
+    static void PushOrWriteQuat(lua_State* L, dmVMath::Quat* out, const dmVMath::Quat& q)
+    {
+        if (out)
+        {
+            *out = q;
+            lua_pushvalue(L, 1);
+        }
+        else
+        {
+            dmScript::PushQuat(L, q);
+        }
+    }
+
     /*# gets the position of a game object instance
      * The position is relative the parent (if any). Use [ref:go.get_world_position] to retrieve the global world position.
      *
      * @name go.get_position
      * @replaces request_transform transform_response
      * @param [id] [type:string|hash|url] optional id of the game object instance to get the position for, by default the instance of the calling script
+     * @param [out] [type:vector3] optional vector to store the position in, instead of creating a new vector
      * @return position [type:vector3] instance position
      * @examples
      *
@@ -879,11 +1210,24 @@ namespace dmGameObject
      * ```lua
      * local pos = go.get_position("my_gameobject")
      * ```
+     *
+     * Reuse a vector to avoid creating a new one each frame:
+     *
+     * ```lua
+     * function init(self)
+     *     self.position = vmath.vector3()
+     * end
+     *
+     * function update(self, dt)
+     *     go.get_position(nil, self.position)
+     * end
+     * ```
      */
     int Script_GetPosition(lua_State* L)
     {
-        Instance* instance = ResolveInstance(L, 1);
-        dmScript::PushVector3(L, dmVMath::Vector3(dmGameObject::GetPosition(instance)));
+        dmVMath::Vector3* out = GetOutVector3(L);
+        Instance* instance = ResolveInstance(L, out ? 2 : 1);
+        PushOrWriteVector3(L, out, dmVMath::Vector3(dmGameObject::GetPosition(instance)));
         return 1;
     }
 
@@ -892,6 +1236,7 @@ namespace dmGameObject
      *
      * @name go.get_rotation
      * @param [id] [type:string|hash|url] optional id of the game object instance to get the rotation for, by default the instance of the calling script
+     * @param [out] [type:quaternion] optional quaternion to store the rotation in, instead of creating a new quaternion
      * @return rotation [type:quaternion] instance rotation
      * @examples
      *
@@ -909,8 +1254,9 @@ namespace dmGameObject
      */
     int Script_GetRotation(lua_State* L)
     {
-        Instance* instance = ResolveInstance(L, 1);
-        dmScript::PushQuat(L, dmGameObject::GetRotation(instance));
+        dmVMath::Quat* out = GetOutQuat(L);
+        Instance* instance = ResolveInstance(L, out ? 2 : 1);
+        PushOrWriteQuat(L, out, dmGameObject::GetRotation(instance));
         return 1;
     }
 
@@ -919,6 +1265,7 @@ namespace dmGameObject
      *
      * @name go.get_scale
      * @param [id] [type:string|hash|url] optional id of the game object instance to get the scale for, by default the instance of the calling script
+     * @param [out] [type:vector3] optional vector to store the scale in, instead of creating a new vector
      * @return scale [type:vector3] instance scale factor
      * @examples
      *
@@ -936,8 +1283,9 @@ namespace dmGameObject
      */
     static int Script_GetScale(lua_State* L)
     {
-        Instance* instance = ResolveInstance(L, 1);
-        dmScript::PushVector3(L, dmGameObject::GetScale(instance));
+        dmVMath::Vector3* out = GetOutVector3(L);
+        Instance* instance = ResolveInstance(L, out ? 2 : 1);
+        PushOrWriteVector3(L, out, dmGameObject::GetScale(instance));
         return 1;
     }
 
@@ -1299,6 +1647,7 @@ namespace dmGameObject
      *
      * @name go.get_world_position
      * @param [id] [type:string|hash|url] optional id of the game object instance to get the world position for, by default the instance of the calling script
+     * @param [out] [type:vector3] optional vector to store the world position in, instead of creating a new vector
      * @return position [type:vector3] instance world position
      * @examples
      *
@@ -1316,8 +1665,9 @@ namespace dmGameObject
      */
     int Script_GetWorldPosition(lua_State* L)
     {
-        Instance* instance = ResolveInstance(L, 1);
-        dmScript::PushVector3(L, dmVMath::Vector3(dmGameObject::GetWorldPosition(instance)));
+        dmVMath::Vector3* out = GetOutVector3(L);
+        Instance* instance = ResolveInstance(L, out ? 2 : 1);
+        PushOrWriteVector3(L, out, dmVMath::Vector3(dmGameObject::GetWorldPosition(instance)));
         return 1;
     }
 
@@ -1328,6 +1678,7 @@ namespace dmGameObject
      *
      * @name go.get_world_rotation
      * @param [id] [type:string|hash|url] optional id of the game object instance to get the world rotation for, by default the instance of the calling script
+     * @param [out] [type:quaternion] optional quaternion to store the world rotation in, instead of creating a new quaternion
      * @return rotation [type:quaternion] instance world rotation
      * @examples
      *
@@ -1345,8 +1696,9 @@ namespace dmGameObject
      */
     int Script_GetWorldRotation(lua_State* L)
     {
-        Instance* instance = ResolveInstance(L, 1);
-        dmScript::PushQuat(L, dmGameObject::GetWorldRotation(instance));
+        dmVMath::Quat* out = GetOutQuat(L);
+        Instance* instance = ResolveInstance(L, out ? 2 : 1);
+        PushOrWriteQuat(L, out, dmGameObject::GetWorldRotation(instance));
         return 1;
     }
 
@@ -1359,6 +1711,7 @@ namespace dmGameObject
      *
      * @name go.get_world_scale
      * @param [id] [type:string|hash|url] optional id of the game object instance to get the world scale for, by default the instance of the calling script
+     * @param [out] [type:vector3] optional vector to store the world scale in, instead of creating a new vector
      * @return scale [type:vector3] instance world 3D scale factor
      * @examples
      *
@@ -1376,8 +1729,9 @@ namespace dmGameObject
      */
     int Script_GetWorldScale(lua_State* L)
     {
-        Instance* instance = ResolveInstance(L, 1);
-        dmScript::PushVector3(L, dmGameObject::GetWorldScale(instance));
+        dmVMath::Vector3* out = GetOutVector3(L);
+        Instance* instance = ResolveInstance(L, out ? 2 : 1);
+        PushOrWriteVector3(L, out, dmGameObject::GetWorldScale(instance));
         return 1;
     }
 
@@ -2250,6 +2604,8 @@ namespace dmGameObject
     {
         {"get",                     Script_Get},
         {"set",                     Script_Set},
+        {"get_many",                Script_GetMany},
+        {"set_many",                Script_SetMany},
         {"get_position",            Script_GetPosition},
         {"get_rotation",            Script_GetRotation},
         {"get_scale",               Script_GetScale},
@@ -682,6 +682,81 @@ TEST_F(PropsTest, PropsGetSetAs)
     dmGameObject::Delete(m_Collection, instance, false);
 }
 
+TEST_F(PropsTest, PropsGetSetMany)
+{
+    const uint32_t count = 3;
+    dmGameObject::HInstance instances[count];
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        instances[i] = dmGameObject::New(m_Collection, "/props_go.goc");
+        SetProperties(instances[i]);
+    }
+    dmGameObject::Init(m_Collection);
+
+    dmGameObject::PropertyResult r;
+    dmGameObject::PropertyVar values[count];
+    uint32_t failed_index = ~0u;
+
+    // transform properties, one value per instance
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        values[i] = dmGameObject::PropertyVar(dmVMath::Vector3((float)i, (float)i * 2, (float)i * 3));
+    }
+    r = dmGameObject::SetPropertyMany(instances, count, 0, hash("position"), values, count, &failed_index);
+    ASSERT_EQ(dmGameObject::PROPERTY_RESULT_OK, r);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        ASSERT_LT(DiffVector3(dmVMath::Vector3((float)i, (float)i * 2, (float)i * 3), dmVMath::Vector3(dmGameObject::GetPosition(instances[i]))), 0.0001f);
+    }
+
+    r = dmGameObject::GetPropertyMany(instances, count, 0, hash("position"), values, &failed_index);
+    ASSERT_EQ(dmGameObject::PROPERTY_RESULT_OK, r);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(dmGameObject::PROPERTY_TYPE_VECTOR3, values[i].m_Type);
+        ASSERT_EQ((float)i * 3, values[i].m_V4[2]);
+    }
+
+    // a single value for all instances
+    dmGameObject::PropertyVar scale(2.0f);
+    r = dmGameObject::SetPropertyMany(instances, count, 0, hash("scale"), &scale, 1, &failed_index);
+    ASSERT_EQ(dmGameObject::PROPERTY_RESULT_OK, r);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(2.0f, dmGameObject::GetUniformScale(instances[i]));
+    }
+
+    // component properties
+    dmGameObject::PropertyVar number(-5.0f);
+    r = dmGameObject::SetPropertyMany(instances, count, hash("script"), hash("number"), &number, 1, &failed_index);
+    ASSERT_EQ(dmGameObject::PROPERTY_RESULT_OK, r);
+    r = dmGameObject::GetPropertyMany(instances, count, hash("script"), hash("number"), values, &failed_index);
+    ASSERT_EQ(dmGameObject::PROPERTY_RESULT_OK, r);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(dmGameObject::PROPERTY_TYPE_NUMBER, values[i].m_Type);
+        ASSERT_EQ(-5.0, values[i].m_Number);
+    }
+
+    // errors report the first failing instance
+    dmGameObject::PropertyVar mixed[count] = { dmGameObject::PropertyVar(dmVMath::Quat(0, 0, 0, 1)), dmGameObject::PropertyVar(1.0f), dmGameObject::PropertyVar(dmVMath::Quat(0, 0, 0, 1)) };
+    r = dmGameObject::SetPropertyMany(instances, count, 0, hash("rotation"), mixed, count, &failed_index);
+    ASSERT_EQ(dmGameObject::PROPERTY_RESULT_TYPE_MISMATCH, r);
+    ASSERT_EQ(1u, failed_index);
+
+    r = dmGameObject::SetPropertyMany(instances, count, 0, hash("rotation"), mixed, 2, &failed_index);
+    ASSERT_EQ(dmGameObject::PROPERTY_RESULT_BUFFER_OVERFLOW, r);
+
+    r = dmGameObject::GetPropertyMany(instances, count, hash("script"), hash("not_found"), values, &failed_index);
+    ASSERT_EQ(dmGameObject::PROPERTY_RESULT_NOT_FOUND, r);
+    ASSERT_EQ(0u, failed_index);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        dmGameObject::Delete(m_Collection, instances[i], false);
+    }
+}
+
 TEST_F(PropsTest, PropsGetSetScript)
 {
     dmGameObject::HCollection collection;
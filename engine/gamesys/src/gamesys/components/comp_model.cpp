@@ -109,6 +109,15 @@ namespace dmGameSystem
         uint8_t                        m_Initialized   : 1;
     };
 
+    // Transformed vertices of a non-skinned render item using a world space material (model.static_batching)
+    struct StaticVertexCache
+    {
+        dmVMath::Matrix4               m_World;
+        dmArray<uint8_t>               m_Data;
+        dmGraphics::HVertexDeclaration m_VertexDeclaration;
+        dmRender::HMaterial            m_Material;
+    };
+
     struct MeshRenderItem
     {
         dmVMath::Matrix4            m_World;
@@ -120,6 +129,7 @@ namespace dmGameSystem
         dmRigDDF::Mesh*             m_Mesh;     // Used for world space materials
         dmGraphics::HTexture        m_MorphTargetTexture;
         HComponentRenderConstants   m_RenderConstants; // Used for PBR properties, will be null if PBR data not needed.
+        StaticVertexCache*          m_StaticVertexCache; // Allocated on first use, if static batching is enabled
         uint32_t                    m_InstanceRenderHash;
         uint32_t                    m_BoneIndex;
         uint32_t                    m_MaterialIndex;
@@ -150,13 +160,17 @@ namespace dmGameSystem
         /// Script morph weights - applied in ApplyMorphToRenderObject.
         dmArray<float>                   m_BlendWeightsOverride;
         uint16_t                         m_ComponentIndex;
+        /// How often the pose is sampled while the model is off-screen (see dmRig::SetUpdateInterval)
+        uint8_t                          m_OffscreenUpdateInterval;
         uint8_t                          m_Enabled : 1;
         uint8_t                          m_DoRender : 1;
         uint8_t                          m_AddedToUpdate : 1;
         uint8_t                          m_ReHash : 1;
         uint8_t                          m_RequiresBindPoseCaching : 1;
         uint8_t                          m_BlendWeightsOverrideActive : 1;
-        uint8_t                          : 2;
+        /// Set if any render item was drawn since the last update
+        uint8_t                          m_Visible : 1;
+        uint8_t                          : 1;
     };
 
     struct ModelSkinnedAnimationData
@@ -201,6 +215,10 @@ namespace dmGameSystem
         uint32_t                         m_StatisticsVertexCount;
         uint32_t                         m_StatisticsVertexDataSize;
         uint8_t                          m_CurrentFrameTick;
+        uint8_t                          m_OffscreenUpdateInterval;
+        uint8_t                          m_StaticBatching;
+        /// Set if the world was rendered since the last update, i.e. if ModelComponent::m_Visible is valid
+        uint8_t                          m_Rendered;
         // Test data:
         uint8_t                          m_RenderBatchLocalVSInstancedCount;
         uint8_t                          m_RenderBatchLocalVSUninstancedCount;
@@ -215,6 +233,7 @@ namespace dmGameSystem
     static const dmhash_t PROP_SKIN          = dmHashString64("skin");
     static const dmhash_t PROP_CURSOR        = dmHashString64("cursor");
     static const dmhash_t PROP_PLAYBACK_RATE = dmHashString64("playback_rate");
+    static const dmhash_t PROP_OFFSCREEN_UPDATE_INTERVAL = dmHashString64("offscreen_update_interval");
 
     static void ResourceReloadedCallback(const dmResource::ResourceReloadedParams* params);
     static void DestroyComponent(ModelWorld* world, uint32_t index);
@@ -228,6 +247,7 @@ namespace dmGameSystem
 
         dmRig::NewContextParams rig_params = {0};
         rig_params.m_MaxRigInstanceCount = comp_count;
+        rig_params.m_JobContext = context->m_JobContext;
         dmRig::Result rr = dmRig::NewContext(rig_params, &world->m_RigContext);
         if (rr != dmRig::RESULT_OK)
         {
@@ -286,6 +306,9 @@ namespace dmGameSystem
         dmGraphics::SetTexture(graphics_context, world->m_SkinnedAnimationData.m_BindPoseCacheTexture, default_texture_params);
 
         world->m_CurrentFrameTick           = 0;
+        world->m_OffscreenUpdateInterval    = (uint8_t)dmMath::Clamp(context->m_OffscreenUpdateInterval, (uint16_t)1, (uint16_t)255);
+        world->m_Rendered                   = 0;
+        world->m_StaticBatching             = context->m_StaticBatching;
         world->m_VertexBuffers              = new dmRender::HBufferedRenderBuffer[VERTEX_BUFFER_MAX_BATCHES];
         world->m_VertexBufferData           = new dmArray<uint8_t>[VERTEX_BUFFER_MAX_BATCHES];
         world->m_VertexBufferDispatchCounts = new uint32_t[VERTEX_BUFFER_MAX_BATCHES];
@@ -1053,8 +1076,32 @@ namespace dmGameSystem
         }
     }
 
+    static void InvalidateStaticVertexCaches(ModelComponent* component)
+    {
+        for (uint32_t i = 0; i < component->m_RenderItems.Size(); ++i)
+        {
+            StaticVertexCache* cache = component->m_RenderItems[i].m_StaticVertexCache;
+            if (cache)
+            {
+                cache->m_Material = 0;
+                cache->m_Data.SetSize(0);
+            }
+        }
+    }
+
+    static void DestroyStaticVertexCaches(ModelComponent* component)
+    {
+        for (uint32_t i = 0; i < component->m_RenderItems.Size(); ++i)
+        {
+            delete component->m_RenderItems[i].m_StaticVertexCache;
+            component->m_RenderItems[i].m_StaticVertexCache = 0;
+        }
+    }
+
     static void SetupRenderItems(ModelComponent* component, ModelResource* resource)
     {
+        DestroyStaticVertexCaches(component);
+
         component->m_RenderItems.SetCapacity(resource->m_Meshes.Size());
         component->m_RenderItems.SetSize(0);
 
@@ -1073,6 +1120,7 @@ namespace dmGameSystem
             item.m_Mesh = resource->m_Meshes[i].m_Mesh;
             item.m_MorphTargetTexture = resource->m_Meshes[i].m_MorphTargetTexture;
             item.m_RenderConstants = 0;
+            item.m_StaticVertexCache = 0;
             item.m_MaterialIndex = resource->m_Meshes[i].m_Mesh->m_MaterialIndex;
             item.m_AabbMin = item.m_Mesh->m_AabbMin;
             item.m_AabbMax = item.m_Mesh->m_AabbMax;
@@ -1171,6 +1219,7 @@ namespace dmGameSystem
         component->m_Resource = resource;
 
         component->m_ComponentIndex = params.m_ComponentIndex;
+        component->m_OffscreenUpdateInterval = world->m_OffscreenUpdateInterval;
         component->m_Enabled = 1;
         component->m_World = Matrix4::identity();
         component->m_DoRender = 0;
@@ -1245,6 +1294,7 @@ namespace dmGameSystem
 
             FreeMaterialAttribute(world->m_DynamicVertexAttributePool, component->m_RenderItems[i].m_DynamicVertexAttributeIndex);
         }
+        DestroyStaticVertexCaches(component);
 
         delete component;
         world->m_Components.Free(index, true);
@@ -2257,7 +2307,7 @@ namespace dmGameSystem
 
         for (uint32_t* i=begin; i != end; i++)
         {
-            const MeshRenderItem* render_item = (MeshRenderItem*) buf[*i].m_UserData;
+            MeshRenderItem* render_item = (MeshRenderItem*) buf[*i].m_UserData;
             const ModelComponent* c = render_item->m_Component;
             if (c->m_RigInstance)
             {
@@ -2275,9 +2325,49 @@ namespace dmGameSystem
                 }
 
                 dmVMath::Matrix4 world_matrix     = c->m_World * model_matrix;
+
+                // Non-skinned items only need to be transformed again when they have moved
+                StaticVertexCache* cache = 0;
+                bool unchanged = false;
+                if (world->m_StaticBatching && render_item->m_Buffers->m_RigModelVertexFormat == RIG_MODEL_VERTEX_FORMAT_STATIC)
+                {
+                    if (!render_item->m_StaticVertexCache)
+                    {
+                        render_item->m_StaticVertexCache = new StaticVertexCache();
+                        render_item->m_StaticVertexCache->m_Material = 0;
+                    }
+                    cache = render_item->m_StaticVertexCache;
+                    unchanged = cache->m_Material == material && cache->m_VertexDeclaration == vx_decl &&
+                                memcmp(&cache->m_World, &world_matrix, sizeof(world_matrix)) == 0;
+
+                    if (unchanged && !cache->m_Data.Empty())
+                    {
+                        memcpy(vb_end, cache->m_Data.Begin(), cache->m_Data.Size());
+                        vb_end += cache->m_Data.Size();
+                        continue;
+                    }
+                }
+
                 dmVMath::Matrix4 normal_matrix    = dmRender::GetNormalMatrix(render_context, world_matrix);
                 bool has_custom_vertex_attributes = vx_decl != world->m_VertexDeclaration;
+                uint8_t* item_begin = vb_end;
                 vb_end = WriteWorldSpaceVertexData(world, render_context, c, render_item, material_infos_vertex, vertex_stride, material, render_item->m_MaterialIndex, world_matrix, normal_matrix, has_custom_vertex_attributes, vb_end);
+
+                if (unchanged)
+                {
+                    // The item stayed in place since the last frame, keep the vertices around
+                    uint32_t size = vb_end - item_begin;
+                    cache->m_Data.SetCapacity(size);
+                    cache->m_Data.SetSize(size);
+                    memcpy(cache->m_Data.Begin(), item_begin, size);
+                }
+                else if (cache)
+                {
+                    cache->m_World             = world_matrix;
+                    cache->m_VertexDeclaration = vx_decl;
+                    cache->m_Material          = material;
+                    cache->m_Data.SetSize(0);
+                }
             }
         }
 
@@ -2587,10 +2677,19 @@ namespace dmGameSystem
                 }
             }
 
+            // Use the visibility from the last frame to lower the animation update rate of off-screen models
+            bool offscreen = world->m_Rendered && !component.m_Visible;
+            if (component.m_RigInstance)
+            {
+                dmRig::SetUpdateInterval(component.m_RigInstance, offscreen ? component.m_OffscreenUpdateInterval : 1);
+            }
+            component.m_Visible = 0;
+
             component.m_DoRender = 1;
 
             DM_PROPERTY_ADD_U32(rmtp_Model, 1);
         }
+        world->m_Rendered = 0;
 
         dmRig::Result rig_res = dmRig::Update(world->m_RigContext, params.m_UpdateContext->m_DT);
 
@@ -2640,6 +2739,15 @@ namespace dmGameSystem
         }
     }
 
+    // The models that are drawn count as visible, whether they were frustum culled or not
+    static void MarkVisible(dmRender::RenderListEntry* buf, uint32_t* begin, uint32_t* end)
+    {
+        for (uint32_t* i = begin; i != end; ++i)
+        {
+            ((MeshRenderItem*) buf[*i].m_UserData)->m_Component->m_Visible = 1;
+        }
+    }
+
     static void RenderListDispatch(dmRender::RenderListDispatchParams const &params)
     {
         ModelWorld *world = (ModelWorld *) params.m_UserData;
@@ -2658,10 +2766,12 @@ namespace dmGameSystem
                 {
                     world->m_VertexBufferData[batch_index].SetSize(0);
                 }
+                world->m_Rendered = 1;
                 break;
             }
             case dmRender::RENDER_LIST_OPERATION_BATCH:
             {
+                MarkVisible(params.m_Buf, params.m_Begin, params.m_End);
                 RenderBatch(world, params.m_Context, params.m_Buf, params.m_Begin, params.m_End);
                 break;
             }
@@ -2957,6 +3067,11 @@ namespace dmGameSystem
             out_value.m_Variant = dmGameObject::PropertyVar(dmRig::GetPlaybackRate(component->m_RigInstance));
             return dmGameObject::PROPERTY_RESULT_OK;
         }
+        else if (params.m_PropertyId == PROP_OFFSCREEN_UPDATE_INTERVAL)
+        {
+            out_value.m_Variant = dmGameObject::PropertyVar((float)component->m_OffscreenUpdateInterval);
+            return dmGameObject::PROPERTY_RESULT_OK;
+        }
         else if (params.m_PropertyId == PROP_MATERIAL)
         {
             return GetResourceProperty(dmGameObject::GetFactory(params.m_Instance), GetMaterialResource(component, component->m_Resource, 0), out_value);
@@ -3029,6 +3144,14 @@ namespace dmGameSystem
             }
             return dmGameObject::PROPERTY_RESULT_OK;
         }
+        else if (params.m_PropertyId == PROP_OFFSCREEN_UPDATE_INTERVAL)
+        {
+            if (params.m_Value.m_Type != dmGameObject::PROPERTY_TYPE_NUMBER)
+                return dmGameObject::PROPERTY_RESULT_TYPE_MISMATCH;
+
+            component->m_OffscreenUpdateInterval = (uint8_t)dmMath::Clamp((int32_t)params.m_Value.m_Number, 1, 255);
+            return dmGameObject::PROPERTY_RESULT_OK;
+        }
         else if (params.m_PropertyId == PROP_MATERIAL)
         {
             dmGameObject::PropertyResult res = SetResourceProperty(dmGameObject::GetFactory(params.m_Instance), params.m_Value, MATERIAL_EXT_HASH, (void**)&component->m_Material);
@@ -3069,6 +3192,7 @@ namespace dmGameSystem
                 {
                     render_item->m_DynamicVertexAttributesDirty = 1;
                 }
+                InvalidateStaticVertexCaches(component);
             }
         }
         return res;
@@ -3287,6 +3411,12 @@ namespace dmGameSystem
         *vx_buffers_count = VERTEX_BUFFER_MAX_BATCHES;
     }
 
+    void SetModelWorldStaticBatching(void* model_world, bool enabled)
+    {
+        ModelWorld* world = (ModelWorld*) model_world;
+        world->m_StaticBatching = enabled;
+    }
+
     void GetModelWorldRenderBatchStats(void* model_world, uint8_t* world_batch_count, uint8_t* local_batch_count, uint8_t* local_instanced_batch_count)
     {
         ModelWorld* world            = (ModelWorld*) model_world;
@@ -3295,6 +3425,12 @@ namespace dmGameSystem
         *local_instanced_batch_count = world->m_RenderBatchLocalVSInstancedCount;
     }
 
+    uint32_t GetModelComponentUpdateInterval(void* model_component)
+    {
+        ModelComponent* component = (ModelComponent*) model_component;
+        return component->m_RigInstance ? dmRig::GetUpdateInterval(component->m_RigInstance) : 0;
+    }
+
     void GetModelComponentRenderConstants(void* model_component, int render_item_ix, dmGameSystem::HComponentRenderConstants* render_constants)
     {
         ModelComponent* component = (ModelComponent*) model_component;
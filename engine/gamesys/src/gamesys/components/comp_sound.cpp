@@ -377,6 +377,7 @@ namespace dmGameSystem
                     dmSound::SetParameter(entry.m_SoundInstance, dmSound::PARAMETER_PAN, dmVMath::Vector4(pan, 0, 0, 0));
                     dmSound::SetParameter(entry.m_SoundInstance, dmSound::PARAMETER_SPEED, dmVMath::Vector4(speed, 0, 0, 0));
                     dmSound::SetLooping(entry.m_SoundInstance, sound->m_Looping, (sound->m_Looping && !sound->m_Loopcount) ? -1 : sound->m_Loopcount ); // loopcounter semantics differ a bit from loopcount. If -1, it means loopforever, otherwise it contains the # of loops remaining.
+                    dmSound::SetPriority(entry.m_SoundInstance, (uint8_t)dmMath::Min(play_sound->m_Priority, 255u));
 
                     // Apply start offset before playback (initial-only; not re-applied on loops)
                     // If both are provided via message, start_frame wins
@@ -542,6 +543,9 @@ namespace dmGameSystem
         int32_t sound_streaming_cache_size = dmConfigFile::GetInt(ctx->m_Config, "sound.stream_cache_size", 2 * 1024*1024);
         ResSoundDataSetStreamingCacheSize((uint32_t)sound_streaming_cache_size);
 
+        int32_t stream_prefetch_chunks = dmConfigFile::GetInt(ctx->m_Config, "sound.stream_prefetch_chunks", 2);
+        ResSoundDataSetStreamingPrefetchChunks((uint32_t)stream_prefetch_chunks);
+
         uint32_t cache_size = dmConfigFile::GetInt(ctx->m_Config, "sound.max_sound_instances", 256);
 
         ComponentTypeSetPrio(type, 600);
@@ -170,6 +170,10 @@ namespace dmGameSystem
         // texture set
         uint16_t                    m_AnimationPlayback : 7; // narrowed enum dmGameSystemDDF::Playback
         uint8_t                     m_NumTextures; // cached value from m_Resource->m_NumTextures
+        uint8_t                     m_OffscreenUpdateInterval; // change animation frame every N frames while culled
+        uint8_t                     m_UpdateCounter;
+        uint8_t                     m_Visible : 1; // drawn since the last update
+        uint8_t                     : 7;
     };
 
     struct SpriteCullingInfo
@@ -201,8 +205,10 @@ namespace dmGameSystem
         uint32_t                            m_DispatchCount;
         uint8_t*                            m_IndexBufferData;
         uint8_t*                            m_IndexBufferWritePtr;
+        uint8_t                             m_OffscreenUpdateInterval;
         uint8_t                             m_Is16BitIndex : 1;
         uint8_t                             m_ReallocBuffers : 1;
+        uint8_t                             m_Rendered : 1; // the world was rendered since the last update, i.e. SpriteComponent::m_Visible is valid
     };
 
     DM_GAMESYS_PROP_VECTOR3(SPRITE_PROP_SCALE, scale, false);
@@ -212,6 +218,7 @@ namespace dmGameSystem
     static const dmhash_t SPRITE_PROP_CURSOR        = dmHashString64("cursor");
     static const dmhash_t SPRITE_PROP_PLAYBACK_RATE = dmHashString64("playback_rate");
     static const dmhash_t SPRITE_PROP_FRAME_COUNT   = dmHashString64("frame_count");
+    static const dmhash_t SPRITE_PROP_OFFSCREEN_UPDATE_INTERVAL = dmHashString64("offscreen_update_interval");
 
     // The 9 slice function produces 16 vertices (4 rows 4 columns)
     // and since there's 2 triangles per quad and 9 quads in total,
@@ -272,6 +279,8 @@ namespace dmGameSystem
         sprite_world->m_VertexBufferData = 0;
         sprite_world->m_IndexBuffer      = 0;
         sprite_world->m_IndexBufferData  = 0;
+        sprite_world->m_OffscreenUpdateInterval = (uint8_t)dmMath::Clamp(sprite_context->m_OffscreenUpdateInterval, (uint16_t)1, (uint16_t)255);
+        sprite_world->m_Rendered = 0;
 
         InitializeMaterialAttributeInfos(sprite_world->m_DynamicVertexAttributePool, 8);
 
@@ -670,6 +679,8 @@ namespace dmGameSystem
             component->m_PlaybackRate = dmMath::Max(playback_rate, 0.0f);
             SetCursor(component, offset);
             UpdateCurrentAnimationFrame(component);
+            // A new animation isn't held back by the offscreen update interval of the previous one
+            component->m_UpdateCounter = 0;
         }
         else
         {
@@ -752,6 +763,9 @@ namespace dmGameSystem
         component->m_VertexStride = 1;
         component->m_IndexCount = 0;
         component->m_ComponentIndex = params.m_ComponentIndex;
+        component->m_OffscreenUpdateInterval = sprite_world->m_OffscreenUpdateInterval;
+        component->m_UpdateCounter = 0;
+        component->m_Visible = 0;
         component->m_Enabled = 1;
         component->m_FunctionRef = 0;
         component->m_ReHash = 1;
@@ -1945,7 +1959,7 @@ namespace dmGameSystem
     }
 
 
-    static void Animate(SpriteComponent* component, float dt)
+    static void Animate(SpriteComponent* component, float dt, bool offscreen)
     {
         if (component->m_IsPlaying && component->m_AddedToUpdate)
         {
@@ -1965,7 +1979,20 @@ namespace dmGameSystem
                         break;
                 }
             }
-            component->m_DoTick = 1;
+
+            // While culled, only pick a new frame every N frames. A finished animation always gets
+            // its last frame, so that the animation_done message reports the correct tile.
+            bool skip_frame = false;
+            if (offscreen)
+            {
+                skip_frame = component->m_UpdateCounter != 0 && component->m_AnimTimer < 1.0f;
+                component->m_UpdateCounter = (component->m_UpdateCounter + 1) % component->m_OffscreenUpdateInterval;
+            }
+            else
+            {
+                component->m_UpdateCounter = 0;
+            }
+            component->m_DoTick |= !skip_frame;
         }
 
         if (component->m_DoTick)
@@ -2044,7 +2071,10 @@ namespace dmGameSystem
             SpriteComponent* component = &components[i];
             if (!component->m_Enabled || !component->m_AddedToUpdate)
                 continue;
-            Animate(component, params.m_UpdateContext->m_DT);
+            // Use the visibility from the last frame to lower the animation update rate of off-screen sprites
+            bool offscreen = world->m_Rendered && !component->m_Visible;
+            component->m_Visible = 0;
+            Animate(component, params.m_UpdateContext->m_DT, offscreen);
 
             HComponentRenderConstants constants = GetRenderConstants(component);
             bool is_component_changed = component->m_ReHash || component->m_AnimationReHash;
@@ -2071,6 +2101,7 @@ namespace dmGameSystem
                 continue;
             PostMessages(component);
         }
+        world->m_Rendered = 0;
 
         dmRender::TrimBuffer(render_context, world->m_VertexBuffer);
         dmRender::RewindBuffer(render_context, world->m_VertexBuffer);
@@ -2156,6 +2187,16 @@ namespace dmGameSystem
         }
     }
 
+    // The sprites that are drawn count as visible, whether they were frustum culled or not
+    static void MarkVisible(SpriteWorld* world, dmRender::RenderListEntry* buf, uint32_t* begin, uint32_t* end)
+    {
+        SpriteComponent* components = world->m_Components.GetRawObjects().Begin();
+        for (uint32_t* i = begin; i != end; ++i)
+        {
+            components[buf[*i].m_UserData].m_Visible = 1;
+        }
+    }
+
     static void RenderListDispatch(dmRender::RenderListDispatchParams const &params)
     {
         SpriteWorld* world = (SpriteWorld*) params.m_UserData;
@@ -2166,6 +2207,7 @@ namespace dmGameSystem
                 world->m_VertexBufferWritePtr = world->m_VertexBufferData;
                 world->m_IndexBufferWritePtr = world->m_IndexBufferData;
                 world->m_RenderObjectsInUse = 0;
+                world->m_Rendered = 1;
                 break;
             case dmRender::RENDER_LIST_OPERATION_END:
                 {
@@ -2190,6 +2232,7 @@ namespace dmGameSystem
                 break;
             default:
                 assert(params.m_Operation == dmRender::RENDER_LIST_OPERATION_BATCH);
+                MarkVisible(world, params.m_Buf, params.m_Begin, params.m_End);
                 RenderBatch(world, params.m_Context, params.m_Buf, params.m_Begin, params.m_End);
         }
     }
@@ -2446,6 +2489,11 @@ namespace dmGameSystem
             out_value.m_Variant = dmGameObject::PropertyVar(GetPlaybackRate(component));
             return dmGameObject::PROPERTY_RESULT_OK;
         }
+        else if (get_property == SPRITE_PROP_OFFSCREEN_UPDATE_INTERVAL)
+        {
+            out_value.m_Variant = dmGameObject::PropertyVar((float)component->m_OffscreenUpdateInterval);
+            return dmGameObject::PROPERTY_RESULT_OK;
+        }
         else if (get_property == PROP_MATERIAL)
         {
             return GetResourceProperty(dmGameObject::GetFactory(params.m_Instance), GetMaterialResource(component), out_value);
@@ -2547,6 +2595,15 @@ namespace dmGameSystem
             SetPlaybackRate(component, params.m_Value.m_Number);
             return dmGameObject::PROPERTY_RESULT_OK;
         }
+        else if (params.m_PropertyId == SPRITE_PROP_OFFSCREEN_UPDATE_INTERVAL)
+        {
+            if (params.m_Value.m_Type != dmGameObject::PROPERTY_TYPE_NUMBER)
+                return dmGameObject::PROPERTY_RESULT_TYPE_MISMATCH;
+
+            component->m_OffscreenUpdateInterval = (uint8_t)dmMath::Clamp((int32_t)params.m_Value.m_Number, 1, 255);
+            component->m_UpdateCounter = 0;
+            return dmGameObject::PROPERTY_RESULT_OK;
+        }
         else if (set_property == PROP_MATERIAL)
         {
             dmGameObject::PropertyResult res = AddOverrideMaterial(dmGameObject::GetFactory(params.m_Instance), component, params.m_Value.m_Hash);
@@ -2764,4 +2821,10 @@ namespace dmGameSystem
         SpriteComponent* comp = (SpriteComponent*) sprite_component;
         return comp->m_AnimationID;
     }
+
+    uint32_t GetSpriteComponentAnimationFrame(void* sprite_component)
+    {
+        SpriteComponent* comp = (SpriteComponent*) sprite_component;
+        return comp->m_CurrentAnimationFrame;
+    }
 }
@@ -236,6 +236,8 @@ namespace dmGameSystem
         dmResource::HFactory        m_Factory;
         uint32_t                    m_MaxSpriteCount;
         uint32_t                    m_Subpixels : 1;
+        /// Flipbook animations of sprites that were culled the previous frame change frame once every N frames (see `sprite.offscreen_update_interval` in game.project)
+        uint16_t                    m_OffscreenUpdateInterval;
     };
 
     struct ModelContext
@@ -252,6 +254,12 @@ namespace dmGameSystem
         /// Max width/height in pixels for each mesh morph-target delta texture (see `model.max_morph_target_texture_*` in game.project).
         uint16_t                    m_MaxMorphTargetTextureWidth;
         uint16_t                    m_MaxMorphTargetTextureHeight;
+        /// Animated models that were culled the previous frame sample their pose once every N frames (see `model.offscreen_update_interval` in game.project)
+        uint16_t                    m_OffscreenUpdateInterval;
+        /// Keep the transformed vertices of non-moving models with world space materials between frames (see `model.static_batching` in game.project)
+        uint8_t                     m_StaticBatching;
+        /// Used to animate the rig instances in parallel. Optional
+        HJobContext                 m_JobContext;
     };
 
     struct ScriptLibContext
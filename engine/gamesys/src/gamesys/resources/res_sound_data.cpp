@@ -13,9 +13,9 @@
 // specific language governing permissions and limitations under the License.
 
 #include <string.h>
+#include <dlib/atomic.h>
 #include <dlib/log.h>
 #include <dlib/math.h>
-#include <dlib/mutex.h>
 #include <sound/sound.h>
 #include <resource/resource.h>
 #include <resource/resource_chunk_cache.h>
@@ -27,17 +27,19 @@ namespace dmGameSystem
 {
     static const uint32_t SOUNDDATA_DEFAULT_CACHE_SIZE = 2 * 1024*1024;
     static const uint32_t SOUNDDATA_DEFAULT_CHUNK_SIZE = 16 * 1024;
+    static const uint32_t SOUNDDATA_DEFAULT_PREFETCH_CHUNKS = 2;
 
     struct SoundDataContext
     {
-        dmMutex::HMutex         m_Mutex;
         dmResource::HFactory    m_Factory;
-        HResourceChunkCache     m_Cache;
+        HResourceChunkCache     m_Cache; // Thread safe
 
         // The cache size for all streaming sounds
         uint32_t m_CacheSize;
         // The chunk size when streaming in more data
         uint32_t m_ChunkSize;
+        // The number of chunks to keep loaded ahead of the current read offset
+        uint32_t m_PrefetchChunks;
     };
 
     struct SoundDataResource
@@ -49,8 +51,8 @@ namespace dmGameSystem
         SoundDataContext*       m_Context;
         const char*             m_Path;
         dmhash_t                m_PathHash;
-        uint32_t                m_FileSize:31;
-        uint32_t                m_RequestInFlight:1;        // Have we already requested the next chunk?
+        uint32_t                m_FileSize;
+        int32_atomic_t          m_RequestInFlight;          // Have we already requested the next chunk?
     };
 
     static SoundDataContext* g_SoundDataContext = 0;
@@ -75,6 +77,13 @@ namespace dmGameSystem
         g_SoundDataContext->m_ChunkSize = chunk_size;
     }
 
+    void ResSoundDataSetStreamingPrefetchChunks(uint32_t num_chunks)
+    {
+        if (!g_SoundDataContext)
+            return;
+        g_SoundDataContext->m_PrefetchChunks = dmMath::Max(num_chunks, 1U);
+    }
+
     static bool TryToGetTypeFromBuffer(char* buffer, uint32_t buffer_size, dmSound::SoundDataType* out)
     {
         if (buffer_size < 3)
@@ -140,13 +149,6 @@ namespace dmGameSystem
         return dmSound::RESULT_OK == r ? dmResource::RESULT_OK : dmResource::RESULT_INVAL;
     }
 
-    // Find the first chunk that contains the offset
-    static ResourceCacheChunk* FindChunk(SoundDataResource* resource, uint32_t offset, ResourceCacheChunk* out)
-    {
-        bool result = ResourceChunkCacheGet(resource->m_Context->m_Cache, resource->m_PathHash, offset, out);
-        return result ? out : 0;
-    }
-
     static void AddChunk(HResourceChunkCache cache, dmhash_t path_hash, uint8_t* data, uint32_t size, uint32_t offset)
     {
         // Offset==0 means the initial chunk of a file (the part that contains the header of a file)
@@ -172,10 +174,9 @@ namespace dmGameSystem
     static int StreamingPreloadCallback(dmResource::HFactory factory, void* cbk_ctx, HResourceDescriptor rd, uint32_t offset, uint32_t nread, uint8_t* buffer)
     {
         SoundDataResource* resource = (SoundDataResource*)cbk_ctx;
-        DM_MUTEX_SCOPED_LOCK(resource->m_Context->m_Mutex);
 
         AddChunk(resource->m_Context->m_Cache, resource->m_PathHash, buffer, nread, offset);
-        resource->m_RequestInFlight = 0;
+        dmAtomicStore32(&resource->m_RequestInFlight, 0);
         return 1;
     }
 
@@ -183,89 +184,47 @@ namespace dmGameSystem
     static dmSound::Result SoundDataReadCallback(void* context, uint32_t offset, uint32_t size, void* _out, uint32_t* out_size)
     {
         SoundDataResource* resource = (SoundDataResource*)context;
-        DM_MUTEX_SCOPED_LOCK(resource->m_Context->m_Mutex);
+        SoundDataContext* sound_context = resource->m_Context;
 
         if (offset >= resource->m_FileSize)
         {
             return dmSound::RESULT_END_OF_STREAM;
         }
 
-        uint8_t* out = (uint8_t*)_out;
-
-        uint32_t nread = 0;
-        uint32_t bytes_to_read = size;
-
-        uint32_t request_size   = g_SoundDataContext->m_ChunkSize;
-        uint32_t request_offset = uint32_t(offset / request_size) * request_size;
-
-        ResourceCacheChunk tmp = {0};
-        ResourceCacheChunk* chunk = FindChunk(resource, offset, &tmp);
-        while (chunk)
-        {
-            uint32_t chunk_size = chunk->m_Size;
-            uint32_t chunk_offset = chunk->m_Offset;
-
-            // We found a chunk and can start copying
-            uint32_t chunk_internal_offset = offset - chunk_offset; // the index to start from within this chunk
-            uint32_t chunk_remaining = chunk_size - chunk_internal_offset;
-            uint32_t to_read = dmMath::Min(bytes_to_read, chunk_remaining);
-            memcpy(out + nread, &chunk->m_Data[chunk_internal_offset], to_read);
-
-            bytes_to_read   -= to_read;
-            nread           += to_read;
-            offset          += to_read;
-
-            if (bytes_to_read > 0)
-                chunk = FindChunk(resource, offset, &tmp);
-            else
-                chunk = 0;
-        }
-
-        uint32_t next_chunk_offset = uint32_t(offset / request_size) * request_size;
-        if (next_chunk_offset == request_offset)
-            next_chunk_offset += request_size;
-
-        if (next_chunk_offset >= resource->m_FileSize) // Are we wrapping around?
-        {
-            next_chunk_offset = 0;
-            request_offset = 0;
-        }
-
-        ResourceCacheChunk* next_chunk = FindChunk(resource, next_chunk_offset, &tmp);
-        if (next_chunk && next_chunk->m_Offset != next_chunk_offset)
-        {
-            next_chunk = 0; // we're actually missing the next chunk. Let's trigger a pre fetch
-        }
-
+        // The data is copied while the cache holds its lock, so the chunks cannot be evicted while we read them
+        uint32_t nread = ResourceChunkCacheRead(sound_context->m_Cache, resource->m_PathHash, offset, size, (uint8_t*)_out);
         *out_size = nread;
 
-        // Last resort:
-        //  If we didn't have any chunks that matched
-        //  This will cause a delay
-        if (nread == 0) // we failed to read from the _current_ offset
+        uint32_t request_size   = sound_context->m_ChunkSize;
+        uint32_t request_offset = 0;
+        bool     request        = false;
+
+        if (nread == 0)
         {
+            // Last resort:
+            //  If we didn't have any chunks that matched
+            //  This will cause a delay
             // Round down to nearest chunk offset
             request_offset = uint32_t(offset / request_size) * request_size;
+            request = true;
         }
-        else if (next_chunk == 0)
-        {
-            request_offset = next_chunk_offset;
-        }
-
-        dmSound::Result result = dmSound::RESULT_PARTIAL_DATA;
-        if (offset >= resource->m_FileSize && nread == 0)
+        else
         {
-            // we cannot return any data as we reached the end of the resource
-            result = dmSound::RESULT_END_OF_STREAM;
+            // Keep the current and the next few chunks loaded, wrapping around to the start of the file (e.g. for looping sounds)
+            uint32_t next_offset = offset + nread;
+            if (next_offset >= resource->m_FileSize)
+                next_offset = 0;
+            request = ResourceChunkCacheGetPrefetchOffset(sound_context->m_Cache, resource->m_PathHash, next_offset, request_size,
+                                                          sound_context->m_PrefetchChunks + 1, resource->m_FileSize, &request_offset);
         }
 
-        if (next_chunk == 0 && !resource->m_RequestInFlight)
+        // Only one request per sound at a time. Once it has arrived, the next read will request the next missing chunk
+        if (request && dmAtomicCompareStore32(&resource->m_RequestInFlight, 1, 0) == 0)
         {
-            resource->m_RequestInFlight = 1;
-            dmResource::PreloadData(resource->m_Context->m_Factory, resource->m_Path, request_offset, request_size, StreamingPreloadCallback, (void*)resource);
+            dmResource::PreloadData(sound_context->m_Factory, resource->m_Path, request_offset, request_size, StreamingPreloadCallback, (void*)resource);
         }
 
-        return result;
+        return dmSound::RESULT_PARTIAL_DATA;
     }
 
     dmResource::Result ResSoundDataCreate(const dmResource::ResourceCreateParams* params)
@@ -371,9 +330,9 @@ namespace dmGameSystem
         {
             SoundDataContext* context = new SoundDataContext;
             memset(context, 0, sizeof(*context));
-            context->m_Mutex     = dmMutex::New();
             context->m_CacheSize = SOUNDDATA_DEFAULT_CACHE_SIZE;
             context->m_ChunkSize = SOUNDDATA_DEFAULT_CHUNK_SIZE;
+            context->m_PrefetchChunks = SOUNDDATA_DEFAULT_PREFETCH_CHUNKS;
             context->m_Cache     = 0;
 
             g_SoundDataContext = context;
@@ -394,9 +353,6 @@ namespace dmGameSystem
     {
         if (g_SoundDataContext)
         {
-            if (g_SoundDataContext->m_Mutex)
-                dmMutex::Delete(g_SoundDataContext->m_Mutex);
-
             if (g_SoundDataContext->m_Cache)
                 ResourceChunkCacheDestroy(g_SoundDataContext->m_Cache);
 
@@ -40,6 +40,9 @@ namespace dmGameSystem
 
     // set the size of each streaming chunk size
     void ResSoundDataSetStreamingChunkSize(uint32_t chunke_size);
+
+    // set the number of chunks to keep loaded ahead of the current read position
+    void ResSoundDataSetStreamingPrefetchChunks(uint32_t num_chunks);
 }
 
 #endif
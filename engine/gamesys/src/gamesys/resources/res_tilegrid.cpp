@@ -26,6 +26,35 @@
 
 namespace dmGameSystem
 {
+    // Doesn't depend on any other resources, so it's done in the preload function (on the load thread)
+    static void CalculateGridBounds(dmGameSystemDDF::TileGrid* tile_grid_ddf, TileGridResource* tile_grid)
+    {
+        int32_t min_x = INT32_MAX;
+        int32_t min_y = INT32_MAX;
+        int32_t max_x = INT32_MIN;
+        int32_t max_y = INT32_MIN;
+        for (uint32_t i = 0; i < tile_grid_ddf->m_Layers.m_Count; ++i)
+        {
+            dmGameSystemDDF::TileLayer* layer = &tile_grid_ddf->m_Layers[i];
+            // we hash it here in the resource loading in order to make it easier to generate the tilemap
+            // files from external tools
+            layer->m_IdHash = dmHashString64(layer->m_Id);
+            uint32_t cell_count = layer->m_Cell.m_Count;
+            for (uint32_t j = 0; j < cell_count; ++j)
+            {
+                dmGameSystemDDF::TileCell* cell = &layer->m_Cell[j];
+                min_x = dmMath::Min(min_x, cell->m_X);
+                min_y = dmMath::Min(min_y, cell->m_Y);
+                max_x = dmMath::Max(max_x, cell->m_X + 1);
+                max_y = dmMath::Max(max_y, cell->m_Y + 1);
+            }
+        }
+        tile_grid->m_ColumnCount = max_x - min_x;
+        tile_grid->m_RowCount = max_y - min_y;
+        tile_grid->m_MinCellX = min_x;
+        tile_grid->m_MinCellY = min_y;
+    }
+
     dmResource::Result AcquireResources(dmPhysics::HContext2D context, dmResource::HFactory factory, dmGameSystemDDF::TileGrid* tile_grid_ddf,
                           TileGridResource* tile_grid, const char* filename, bool reload)
     {
@@ -62,31 +91,11 @@ namespace dmGameSystem
             tile_grid_ddf->m_BlendMode = dmGameSystemDDF::TileGrid::BLEND_MODE_ADD;
         TextureSetResource* texture_set = tile_grid->m_TextureSet;
 
-        // find boundaries
-        int32_t min_x = INT32_MAX;
-        int32_t min_y = INT32_MAX;
-        int32_t max_x = INT32_MIN;
-        int32_t max_y = INT32_MIN;
-        for (uint32_t i = 0; i < tile_grid_ddf->m_Layers.m_Count; ++i)
-        {
-            dmGameSystemDDF::TileLayer* layer = &tile_grid_ddf->m_Layers[i];
-            // we hash it here in the resource loading in order to make it easier to generate the tilemap
-            // files from external tools
-            layer->m_IdHash = dmHashString64(layer->m_Id);
-            uint32_t cell_count = layer->m_Cell.m_Count;
-            for (uint32_t j = 0; j < cell_count; ++j)
-            {
-                dmGameSystemDDF::TileCell* cell = &layer->m_Cell[j];
-                min_x = dmMath::Min(min_x, cell->m_X);
-                min_y = dmMath::Min(min_y, cell->m_Y);
-                max_x = dmMath::Max(max_x, cell->m_X + 1);
-                max_y = dmMath::Max(max_y, cell->m_Y + 1);
-            }
-        }
-        tile_grid->m_ColumnCount = max_x - min_x;
-        tile_grid->m_RowCount = max_y - min_y;
-        tile_grid->m_MinCellX = min_x;
-        tile_grid->m_MinCellY = min_y;
+        // The boundaries are calculated by CalculateGridBounds
+        int32_t min_x = tile_grid->m_MinCellX;
+        int32_t min_y = tile_grid->m_MinCellY;
+        int32_t max_x = min_x + (int32_t)tile_grid->m_ColumnCount;
+        int32_t max_y = min_y + (int32_t)tile_grid->m_RowCount;
 
         dmGameSystemDDF::TextureSet* texture_set_ddf = texture_set->m_TextureSet;
         dmPhysics::HHullSet2D hull_set = (dmPhysics::HHullSet2D)texture_set->m_HullSet;
@@ -148,14 +157,19 @@ namespace dmGameSystem
         dmResource::PreloadHint(params->m_HintInfo, tile_grid_ddf->m_TileSet);
         dmResource::PreloadHint(params->m_HintInfo, tile_grid_ddf->m_Material);
 
-        *params->m_PreloadData = tile_grid_ddf;
+        // Leave only the work that needs the dependencies for the create function (on the main thread)
+        TileGridResource* tile_grid = new TileGridResource();
+        tile_grid->m_TileGrid = tile_grid_ddf;
+        CalculateGridBounds(tile_grid_ddf, tile_grid);
+
+        *params->m_PreloadData = tile_grid;
         return dmResource::RESULT_OK;
     }
 
     dmResource::Result ResTileGridCreate(const dmResource::ResourceCreateParams* params)
     {
-        TileGridResource* tile_grid = new TileGridResource();
-        dmGameSystemDDF::TileGrid* tile_grid_ddf = (dmGameSystemDDF::TileGrid*) params->m_PreloadData;
+        TileGridResource* tile_grid = (TileGridResource*) params->m_PreloadData;
+        dmGameSystemDDF::TileGrid* tile_grid_ddf = tile_grid->m_TileGrid;
 
         PhysicsContextBox2D* physics_context = (PhysicsContextBox2D*) params->m_Context;
 
@@ -192,6 +206,7 @@ namespace dmGameSystem
 
         TileGridResource* tile_grid = (TileGridResource*) dmResource::GetResource(params->m_Resource);
         TileGridResource tmp_tile_grid;
+        CalculateGridBounds(tile_grid_ddf, &tmp_tile_grid);
 
         PhysicsContextBox2D* physics_context = (PhysicsContextBox2D*) params->m_Context;
         dmResource::Result r = AcquireResources(physics_context->m_Context, params->m_Factory, tile_grid_ddf, &tmp_tile_grid, params->m_Filename, true);
@@ -22,11 +22,13 @@
 
 #include <ddf/ddf.h>
 #include <dlib/align.h>
+#include <dlib/buffer.h>
 #include <dlib/dstrings.h>
 #include <dlib/hash.h>
 #include <dlib/http_cache.h>
 #include <dlib/log.h>
 #include <dlib/math.h>
+#include <dlib/mutex.h>
 #include <dlib/uri.h>
 
 #include <script/script.h>
@@ -36,6 +38,7 @@
 #include <extension/extension.hpp>
 
 #include "script_http.h"
+#include "script_buffer.h"
 
 extern "C"
 {
@@ -60,6 +63,15 @@ namespace dmGameSystem
     static dmHttpService::HHttpService g_Service = 0;
     static uint64_t g_Timeout                    = 0;
 
+    struct ReleasedResponseBuffer
+    {
+        lua_State*  m_L;
+        int         m_Ref;
+    };
+
+    static dmMutex::HMutex                  g_ReleasedBuffersMutex = 0;
+    static dmArray<ReleasedResponseBuffer>  g_ReleasedBuffers;
+
     static void ReportProgressCallback(dmHttpDDF::HttpRequestProgress* msg, dmMessage::URL* url, uintptr_t user_data)
     {
         if (dmGameObject::RESULT_OK != dmGameObject::PostDDF(msg, 0, url, user_data, false))
@@ -68,6 +80,32 @@ namespace dmGameSystem
         }
     }
 
+    // Called by the http service when a response holding a buffer isn't decoded (e.g. the requester was deleted).
+    // The buffer is unreferenced later on the main thread, see ReleaseResponseBuffers()
+    static void ReleaseResponseBufferCallback(int32_t response_buffer_ref, uintptr_t user_data)
+    {
+        DM_MUTEX_SCOPED_LOCK(g_ReleasedBuffersMutex);
+        if (g_ReleasedBuffers.Full())
+        {
+            g_ReleasedBuffers.OffsetCapacity(16);
+        }
+        ReleasedResponseBuffer released;
+        released.m_L = (lua_State*) user_data;
+        // NOTE: By convention the ref is offset by LUA_NOREF, in order to have 0 for "no buffer"
+        released.m_Ref = response_buffer_ref + LUA_NOREF;
+        g_ReleasedBuffers.Push(released);
+    }
+
+    static void ReleaseResponseBuffers()
+    {
+        DM_MUTEX_SCOPED_LOCK(g_ReleasedBuffersMutex);
+        for (uint32_t i = 0; i < g_ReleasedBuffers.Size(); ++i)
+        {
+            luaL_unref(g_ReleasedBuffers[i].m_L, LUA_REGISTRYINDEX, g_ReleasedBuffers[i].m_Ref);
+        }
+        g_ReleasedBuffers.SetSize(0);
+    }
+
     /*# perform a HTTP/HTTPS request
      * Perform a HTTP/HTTPS request.
      *
@@ -91,6 +129,8 @@ namespace dmGameSystem
      * - [type:string] `response`: the response data (if not saved on disc)
      * - [type:table] `headers`: all the returned headers (if status is 200 or 206)
      * - [type:string] `path`: the stored path (if saved to disc)
+     * - [type:buffer] `buffer`: the buffer passed in the `buffer` option, holding the response data
+     * - [type:number] `response_length`: the number of bytes written to `buffer`
      * - [type:string] `error`: if any unforeseen errors occurred (e.g. file I/O)
      * - [type:number] `bytes_received`: the amount of bytes received/sent for a request, only if option `report_progress` is true
      * - [type:number] `bytes_total`: the total amount of bytes for a request, only if option `report_progress` is true
@@ -103,7 +143,8 @@ namespace dmGameSystem
      * @param [options] [type:table] optional table with request parameters. Supported entries:
      *
      * - [type:number] `timeout`: timeout in seconds
-     * - [type:string] `path`: path on disc where to download the file. Only overwrites the path if status is 200. [icon:attention] Path should be absolute
+     * - [type:string] `path`: path on disc where to download the file. Only overwrites the path if status is 200. The data is written as it arrives and is never held in memory. [icon:attention] Path should be absolute
+     * - [type:buffer] `buffer`: preallocated buffer where the response data is written as it arrives, instead of returning it as a string. The buffer must not be used until the callback is called. If the response doesn't fit, `error` is set in the response. [icon:attention] Not available in HTML5 build
      * - [type:boolean] `ignore_cache`: don't return cached data if we get a 304. [icon:attention] Not available in HTML5 build
      * - [type:boolean] `chunked_transfer`: use chunked transfer encoding for https requests larger than 16kb. Defaults to true. [icon:attention] Not available in HTML5 build
      * - [type:boolean] `report_progress`: when it is true, the amount of bytes sent and/or received for a request will be passed into the callback function
@@ -129,6 +170,19 @@ namespace dmGameSystem
      *     http.request("http://www.google.com", "GET", http_result, nil, nil, { report_progress = true })
      * end
      * ```
+     *
+     * Download a large file straight into a buffer, without creating a Lua string:
+     *
+     * ```lua
+     * function init(self)
+     *     local buf = buffer.create(8 * 1024 * 1024, { {name=hash("data"), type=buffer.VALUE_TYPE_UINT8, count=1 } })
+     *     http.request("http://www.site.com/image.png", "GET", function(self, _, response)
+     *         if response.status == 200 and not response.error then
+     *             local img = image.load_buffer(response.buffer)
+     *         end
+     *     end, nil, nil, { buffer = buf })
+     * end
+     * ```
      */
     static int Http_Request(lua_State* L)
     {
@@ -210,6 +264,9 @@ namespace dmGameSystem
             uint64_t timeout = g_Timeout;
             const char* path = 0;
             const char* proxy = 0;
+            void* response_buffer = 0;
+            uint32_t response_buffer_size = 0;
+            int response_buffer_ref = LUA_NOREF;
             bool ignore_cache = false;
             bool chunked_transfer = true;
             bool report_progress = false;
@@ -243,6 +300,13 @@ namespace dmGameSystem
                     {
                         proxy = luaL_checkstring(L, -1);
                     }
+                    else if (strcmp(attr, "buffer") == 0 && response_buffer_ref == LUA_NOREF)
+                    {
+                        dmBuffer::GetBytes(dmScript::CheckBufferUnpack(L, -1), &response_buffer, &response_buffer_size);
+                        // Keep the buffer alive while the http service writes to it
+                        lua_pushvalue(L, -1);
+                        response_buffer_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+                    }
 
                     lua_pop(L, 1);
                 }
@@ -269,15 +333,26 @@ namespace dmGameSystem
             request->m_ChunkedTransfer = chunked_transfer;
             request->m_ReportProgress = report_progress;
             request->m_Proxy = proxy;
+            request->m_ResponseBuffer = (uint64_t) response_buffer;
+            request->m_ResponseBufferSize = response_buffer_size;
+            // NOTE: Offset by LUA_NOREF, in order to have 0 for "no buffer"
+            request->m_ResponseBufferRef = response_buffer_ref - LUA_NOREF;
+            if (response_buffer && path)
+            {
+                dmLogWarning("Both 'path' and 'buffer' are set for the request to '%s'. The response is written to the path.", url);
+            }
 
             uint32_t post_len = sizeof(dmHttpDDF::HttpRequest) + method_len + 1 + url_len + 1;
             dmMessage::URL receiver;
             dmMessage::ResetURL(&receiver);
             receiver.m_Socket = dmHttpService::GetSocket(g_Service);
 
-            dmMessage::Result r = dmMessage::Post(&sender, &receiver, dmHttpDDF::HttpRequest::m_DDFHash, 0, (uintptr_t)callback, (uintptr_t) dmHttpDDF::HttpRequest::m_DDFDescriptor, buf, post_len, 0);
+            // The main Lua thread is passed back with the response, to release the buffer if the response never reaches the callback
+            uintptr_t main_thread = (uintptr_t) dmScript::GetMainThread(L);
+            dmMessage::Result r = dmMessage::Post(&sender, &receiver, dmHttpDDF::HttpRequest::m_DDFHash, main_thread, (uintptr_t)callback, (uintptr_t) dmHttpDDF::HttpRequest::m_DDFDescriptor, buf, post_len, 0);
             if (r != dmMessage::RESULT_OK) {
                 dmLogError("Failed to create HTTP request");
+                luaL_unref(L, LUA_REGISTRYINDEX, response_buffer_ref);
             }
             assert(top == lua_gettop(L));
             return 0;
@@ -314,14 +389,17 @@ namespace dmGameSystem
         {
             dmHttpService::Params service_params;
             service_params.m_ReportProgressCallback = ReportProgressCallback;
+            service_params.m_ReleaseResponseBufferCallback = ReleaseResponseBufferCallback;
 
             if (config_file)
             {
                 service_params.m_ThreadCount = dmConfigFile::GetInt(config_file, "network.http_thread_count", service_params.m_ThreadCount);
+                service_params.m_MaxConnections = dmConfigFile::GetInt(config_file, "network.http_max_connections", service_params.m_MaxConnections);
             }
 
             service_params.m_HttpCache = dmExtension::GetContextAsType<dmHttpCache::HCache>(params, "http_cache");
 
+            g_ReleasedBuffersMutex = dmMutex::New();
             g_Service = dmHttpService::New(&service_params);
             dmScript::RegisterDDFDecoder(dmHttpDDF::HttpResponse::m_DDFDescriptor, &HttpResponseDecoder);
             dmScript::RegisterDDFDecoder(dmHttpDDF::HttpRequestProgress::m_DDFDescriptor, &HttpRequestProgressDecoder);
@@ -341,15 +419,29 @@ namespace dmGameSystem
         return dmExtension::RESULT_OK;
     }
 
+    static dmExtension::Result ScriptHttpUpdate(dmExtension::Params* params)
+    {
+        if (g_Service != 0)
+        {
+            ReleaseResponseBuffers();
+        }
+        return dmExtension::RESULT_OK;
+    }
+
     static dmExtension::Result ScriptHttpFinalize(dmExtension::Params* params)
     {
         if (g_Service != 0)
         {
             dmHttpService::Delete(g_Service);
             g_Service = 0;
+
+            ReleaseResponseBuffers();
+            g_ReleasedBuffers.SetCapacity(0);
+            dmMutex::Delete(g_ReleasedBuffersMutex);
+            g_ReleasedBuffersMutex = 0;
         }
         return dmExtension::RESULT_OK;
     }
 
-    DM_DECLARE_EXTENSION(ScriptHttp, "ScriptHttp", 0, 0, ScriptHttpInitialize, 0, 0, ScriptHttpFinalize);
+    DM_DECLARE_EXTENSION(ScriptHttp, "ScriptHttp", 0, 0, ScriptHttpInitialize, ScriptHttpUpdate, 0, ScriptHttpFinalize);
 }
@@ -105,6 +105,9 @@ namespace dmGameSystem
         resp.m_ResponseLength = response_length;
         resp.m_Path = ctx->m_Path;
         resp.m_Url = ctx->m_Url;
+        resp.m_PathWritten = false;
+        resp.m_WriteError = false;
+        resp.m_ResponseBufferRef = 0;
 
         resp.m_Headers = (uint64_t) malloc(headers_length);
         memcpy((void*) resp.m_Headers, headers, headers_length);
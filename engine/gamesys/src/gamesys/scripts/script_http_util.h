@@ -61,9 +61,37 @@ namespace dmGameSystem
         lua_pushinteger(L, resp->m_Status);
         lua_setfield(L, -2, "status");
 
+        bool has_buffer = resp->m_ResponseBufferRef != 0;
+        if (has_buffer)
+        {
+            // NOTE: By convention the ref is offset by LUA_NOREF, in order to have 0 for "no buffer"
+            int buffer_ref = resp->m_ResponseBufferRef + LUA_NOREF;
+            if (!resp->m_Path)
+            {
+                if (resp->m_WriteError)
+                {
+                    lua_pushliteral(L, "The response doesn't fit in the buffer");
+                    lua_setfield(L, -2, "error");
+                }
+
+                lua_rawgeti(L, LUA_REGISTRYINDEX, buffer_ref);
+                lua_setfield(L, -2, "buffer");
+                lua_pushinteger(L, resp->m_ResponseLength);
+                lua_setfield(L, -2, "response_length");
+            }
+            luaL_unref(L, LUA_REGISTRYINDEX, buffer_ref);
+            // Tells the message destroy callback that the buffer is released
+            resp->m_ResponseBufferRef = 0;
+        }
+
         if (resp->m_Path)
         {
-            if (resp->m_Status == 200) {
+            if (resp->m_WriteError)
+            {
+                lua_pushliteral(L, "Failed to write to temp file");
+                lua_setfield(L, -2, "error");
+            }
+            else if (resp->m_Status == 200 && !resp->m_PathWritten) {
                 if (!WriteResponseToFile(resp->m_Path, response, resp->m_ResponseLength))
                 {
                     lua_pushliteral(L, "Failed to write to temp file");
@@ -73,7 +101,7 @@ namespace dmGameSystem
 
             lua_pushstring(L, resp->m_Path);
             lua_setfield(L, -2, "path");
-        } else {
+        } else if (!has_buffer) {
             lua_pushlstring(L, response, resp->m_ResponseLength);
             lua_setfield(L, -2, "response");
         }
@@ -205,7 +205,7 @@ namespace dmGameSystem
     * Load image (PNG or JPEG) from a string buffer.
     *
     * @name image.load_buffer
-    * @param buffer [type:string] image data buffer
+    * @param buffer [type:string|buffer] image data buffer. A buffer is read without being copied, e.g. the buffer from a `http.request` with the `buffer` option
     * @param [options] [type:table] An optional table containing parameters for loading the image. Supported entries:
     *
     * `premultiply_alpha`
@@ -249,9 +249,21 @@ namespace dmGameSystem
     static int Image_LoadBuffer(lua_State* L)
     {
         int top = lua_gettop(L);
-        luaL_checktype(L, 1, LUA_TSTRING);
         size_t buffer_len = 0;
-        const char* buffer = lua_tolstring(L, 1, &buffer_len);
+        const char* buffer = 0;
+        if (dmScript::IsBuffer(L, 1))
+        {
+            void* data = 0;
+            uint32_t data_size = 0;
+            dmBuffer::GetBytes(dmScript::CheckBufferUnpack(L, 1), &data, &data_size);
+            buffer = (const char*) data;
+            buffer_len = data_size;
+        }
+        else
+        {
+            luaL_checktype(L, 1, LUA_TSTRING);
+            buffer = lua_tolstring(L, 1, &buffer_len);
+        }
 
         bool premult = false;
         bool flip_vertically = false;
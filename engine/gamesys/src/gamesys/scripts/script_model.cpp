@@ -106,6 +106,29 @@ namespace dmGameSystem
      * The playback_rate is a non-negative number, a negative value will be clamped to 0.
      */
 
+    /*# [type:number] model offscreen_update_interval
+     *
+     * How often the animated pose is sampled while the model is outside the camera frustum.
+     * A value of N means that the pose is updated every N:th engine frame, and reused in between.
+     * The animation time still advances every frame. The default value is taken from
+     * `model.offscreen_update_interval` in game.project. The type of the property is number.
+     *
+     * @name offscreen_update_interval
+     * @property
+     *
+     * @examples
+     *
+     * How to let the model sample its animation at a quarter of the rate when off screen:
+     *
+     * ```lua
+     * function init(self)
+     *   go.set("#model", "offscreen_update_interval", 4)
+     * end
+     * ```
+     *
+     * The value is clamped to the range [1, 255].
+     */
+
      /*# [type:hash] model animation
      *
      * The current animation set on the component. The type of the property is hash.
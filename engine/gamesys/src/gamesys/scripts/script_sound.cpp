@@ -446,6 +446,9 @@ namespace dmGameSystem
 
      * `start_frame`
      * : [type:number] start playback offset (frames/samples). Optional, mutually exclusive with `start_time`. If both are provided, `start_frame` is used.
+
+     * `priority`
+     * : [type:number] voice priority between 0 and 255, default is 0. When more sounds play than the `sound.max_real_voices` setting allows, the ones with the lowest priority (and then the lowest gain) are virtual: they keep their play position but are not decoded or mixed.
      *
      * @param [complete_function] [type:function(self, message_id, message, sender)] function to call when the sound has finished playing or stopped manually via [ref:sound.stop].
      *
@@ -501,6 +504,7 @@ namespace dmGameSystem
         float delay = 0.0f, gain = 1.0f, pan = 0.0f, speed = 1.0f;
         float start_time = 0.0f;
         uint32_t start_frame = 0u;
+        uint32_t priority = 0u;
 
         if (top > 1 && !lua_isnil(L,2)) // table with args
         {
@@ -540,6 +544,14 @@ namespace dmGameSystem
             }
             lua_pop(L, 1);
 
+            lua_getfield(L, -1, "priority");
+            if (!lua_isnil(L, -1))
+            {
+                double v = luaL_checknumber(L, -1);
+                priority = (uint32_t)dmMath::Clamp(v, 0.0, 255.0);
+            }
+            lua_pop(L, 1);
+
             lua_pop(L, 1);
         }
 
@@ -567,6 +579,7 @@ namespace dmGameSystem
         // If both are set, start_frame wins
         msg.m_StartFrame = start_frame;
         msg.m_StartTime  = (start_frame != 0) ? 0.0f : start_time;
+        msg.m_Priority   = priority;
 
         dmMessage::Post(&sender, &receiver, dmGameSystemDDF::PlaySound::m_DDFDescriptor->m_NameHash, 0, functionref, (uintptr_t)dmGameSystemDDF::PlaySound::m_DDFDescriptor, &msg, sizeof(msg), 0);
 
@@ -782,6 +795,7 @@ namespace dmGameSystem
      * @param [play_id] [type:number] the identifier of the sound, can be used to distinguish between consecutive plays from the same component.
      * @param [start_time] [type:number] optional start offset (seconds). Mutually exclusive with `start_frame`.
      * @param [start_frame] [type:number] optional start offset (frames). If both are provided, `start_frame` is used.
+     * @param [priority] [type:number] optional voice priority between 0 and 255, see [ref:sound.play].
      * @examples
      *
      * Assuming the script belongs to an instance with a sound-component with id "sound", this will make the component play its sound after 1 second:
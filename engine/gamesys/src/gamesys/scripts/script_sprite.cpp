@@ -216,6 +216,29 @@ namespace dmGameSystem
     * ```
     */
 
+    /*# [type:number] sprite offscreen_update_interval
+    *
+    * How often the flipbook animation changes frame while the sprite is outside the camera frustum.
+    * A value of N means that the frame is updated every N:th engine frame. The animation time still advances
+    * every frame, so the sprite shows the correct frame again as soon as it becomes visible. The default value
+    * is taken from `sprite.offscreen_update_interval` in game.project. The type of the property is [type:number].
+    *
+    * The value is clamped to the range [1, 255].
+    *
+    * @name offscreen_update_interval
+    * @property
+    *
+    * @examples
+    *
+    * How to let the sprite animate at a quarter of the rate when off screen:
+    *
+    * ```lua
+    * function init(self)
+    *   go.set("#sprite", "offscreen_update_interval", 4)
+    * end
+    * ```
+    */
+
     /*# [type:hash] sprite animation
     *
     * [mark:READ ONLY] The current animation id. An animation that plays currently for the sprite. The type of the property is [type:hash].
@@ -118,8 +118,11 @@ namespace dmGameSystem
     extern void GetSpriteWorldDynamicAttributePool(void* sprite_world, DynamicAttributePool** pool_out);
     extern void GetSpriteComponentScale(void* sprite_component, dmVMath::Vector3* scale_out);
     extern uint16_t GetSpriteComponentAnimationIndex(void* sprite_component);
+    extern uint32_t GetSpriteComponentAnimationFrame(void* sprite_component);
     extern void GetModelWorldRenderBuffers(void* world, dmRender::HBufferedRenderBuffer** vx_buffers, uint32_t* vx_buffers_count);
     extern void GetModelWorldRenderBatchStats(void* model_world, uint8_t* world_batch_count, uint8_t* local_batch_count, uint8_t* local_instanced_batch_count);
+    extern void SetModelWorldStaticBatching(void* model_world, bool enabled);
+    extern uint32_t GetModelComponentUpdateInterval(void* model_component);
     extern void GetModelComponentRenderConstants(void* model_component, int render_item_ix, dmGameSystem::HComponentRenderConstants* render_constants);
     extern void GetModelComponentAttributeRenderData(void* model_component, int render_item_ix, dmGraphics::HVertexBuffer* vx_buffer, dmGraphics::HVertexDeclaration* vx_decl, dmGraphics::HVertexDeclaration* inst_decl);
     extern void GetParticleFXWorldRenderBuffers(void* world, dmRender::HBufferedRenderBuffer* vx_buffer);
@@ -2328,6 +2331,91 @@ TEST_F(SpriteTest, ScaleAffectsWorldSize)
     ASSERT_TRUE(dmGameObject::Final(m_Collection));
 }
 
+// Draws the collection, with a frustum that culls everything far from the origin if cull is set
+static void DrawCollection(dmRender::HRenderContext render_context, dmGameObject::HCollection collection, bool cull)
+{
+    dmRender::RenderListBegin(render_context);
+    dmGameObject::Render(collection);
+    dmRender::RenderListEnd(render_context);
+
+    dmRender::FrustumOptions frustum_options;
+    frustum_options.m_Matrix = Matrix4::orthographic(-100.0f, 100.0f, -100.0f, 100.0f, -1.0f, 1.0f);
+    frustum_options.m_NumPlanes = dmRender::FRUSTUM_PLANES_SIDES;
+    dmRender::DrawRenderList(render_context, 0x0, 0x0, cull ? &frustum_options : 0x0, dmRender::SORT_BACK_TO_FRONT);
+}
+
+static void PlaySpriteAnimation(dmGameObject::HCollection collection, dmGameObject::HInstance go, dmhash_t sprite_comp_id, dmhash_t animation_id)
+{
+    dmMessage::URL msg_url;
+    dmMessage::ResetURL(&msg_url);
+    msg_url.m_Socket = dmGameObject::GetMessageSocket(collection);
+    msg_url.m_Path = dmGameObject::GetIdentifier(go);
+    msg_url.m_Fragment = sprite_comp_id;
+
+    dmGameSystemDDF::PlayAnimation msg;
+    msg.m_Id = animation_id;
+    msg.m_Offset = 0.0f;
+    msg.m_PlaybackRate = 1.0f;
+    ASSERT_EQ(dmMessage::RESULT_OK, dmMessage::PostDDF(&msg, &msg_url, &msg_url, (uintptr_t)go, 0, 0));
+}
+
+TEST_F(SpriteTest, OffscreenUpdateInterval)
+{
+    dmhash_t sprite_comp_id = dmHashString64("sprite");
+    dmhash_t animation_id = dmHashString64("anim_loop");
+
+    // Far outside the frustum used by DrawCollection()
+    dmGameObject::HInstance go = Spawn(m_Factory, m_Collection, "/sprite/cursor.goc", dmHashString64("/go"), 0, Point3(1000, 0, 0), Quat(0, 0, 0, 1), Vector3(1, 1, 1));
+    ASSERT_NE((void*)0, go);
+
+    uint32_t component_type;
+    dmGameObject::HComponent component;
+    dmGameObject::HComponentWorld world;
+    ASSERT_EQ(dmGameObject::RESULT_OK, dmGameObject::GetComponent(go, sprite_comp_id, &component_type, &component, &world));
+
+    dmGameObject::PropertyOptions opts;
+    ASSERT_EQ(dmGameObject::PROPERTY_RESULT_OK, dmGameObject::SetProperty(go, sprite_comp_id, dmHashString64("offscreen_update_interval"), opts, dmGameObject::PropertyVar(2.0f)));
+
+    PlaySpriteAnimation(m_Collection, go, sprite_comp_id, animation_id);
+    m_UpdateContext.m_DT = 0.0f;
+    ASSERT_TRUE(dmGameObject::Update(m_Collection, &m_UpdateContext));
+    ASSERT_TRUE(dmGameObject::PostUpdate(m_Collection));
+
+    // The animation is one frame per second, so every tick shows a new frame
+    m_UpdateContext.m_DT = 1.0f;
+
+    // Drawn without frustum culling, the sprite counts as visible
+    for (int i = 0; i < 4; ++i)
+    {
+        uint32_t frame = dmGameSystem::GetSpriteComponentAnimationFrame(component);
+        DrawCollection(m_RenderContext, m_Collection, false);
+        ASSERT_TRUE(dmGameObject::Update(m_Collection, &m_UpdateContext));
+        ASSERT_TRUE(dmGameObject::PostUpdate(m_Collection));
+        ASSERT_NE(frame, dmGameSystem::GetSpriteComponentAnimationFrame(component));
+    }
+
+    // Culled, it only picks a new frame every other update
+    uint32_t frame_changes = 0;
+    for (int i = 0; i < 9; ++i)
+    {
+        uint32_t frame = dmGameSystem::GetSpriteComponentAnimationFrame(component);
+        DrawCollection(m_RenderContext, m_Collection, true);
+        ASSERT_TRUE(dmGameObject::Update(m_Collection, &m_UpdateContext));
+        ASSERT_TRUE(dmGameObject::PostUpdate(m_Collection));
+        frame_changes += frame != dmGameSystem::GetSpriteComponentAnimationFrame(component) ? 1 : 0;
+    }
+    ASSERT_EQ(5u, frame_changes);
+
+    // The last update was skipped, but a newly played animation starts ticking right away
+    PlaySpriteAnimation(m_Collection, go, sprite_comp_id, animation_id);
+    DrawCollection(m_RenderContext, m_Collection, true);
+    ASSERT_TRUE(dmGameObject::Update(m_Collection, &m_UpdateContext));
+    ASSERT_TRUE(dmGameObject::PostUpdate(m_Collection));
+    ASSERT_EQ(1u, dmGameSystem::GetSpriteComponentAnimationFrame(component));
+
+    ASSERT_TRUE(dmGameObject::Final(m_Collection));
+}
+
 // Test that animation done event reaches callback
 TEST_F(ParticleFxTest, PlayAnim)
 {
@@ -8917,6 +9005,41 @@ TEST_F(ModelTest, BlendWeightsScript)
     ASSERT_TRUE(dmGameObject::Final(m_Collection));
 }
 
+TEST_F(ModelTest, OffscreenUpdateInterval)
+{
+    dmhash_t model_comp_id = dmHashString64("model");
+
+    // Far outside the frustum used by DrawCollection()
+    dmGameObject::HInstance go = Spawn(m_Factory, m_Collection, "/model/valid_model.goc", dmHashString64("/go"), 0, Point3(1000, 0, 0), Quat(0, 0, 0, 1), Vector3(1, 1, 1));
+    ASSERT_NE((void*)0, go);
+
+    uint32_t component_type;
+    dmGameObject::HComponent component;
+    dmGameObject::HComponentWorld world;
+    ASSERT_EQ(dmGameObject::RESULT_OK, dmGameObject::GetComponent(go, model_comp_id, &component_type, &component, &world));
+
+    dmGameObject::PropertyOptions opts;
+    ASSERT_EQ(dmGameObject::PROPERTY_RESULT_OK, dmGameObject::SetProperty(go, model_comp_id, dmHashString64("offscreen_update_interval"), opts, dmGameObject::PropertyVar(3.0f)));
+
+    // Not drawn yet, so the visibility is unknown
+    ASSERT_TRUE(dmGameObject::Update(m_Collection, &m_UpdateContext));
+    ASSERT_TRUE(dmGameObject::PostUpdate(m_Collection));
+    ASSERT_EQ(1u, dmGameSystem::GetModelComponentUpdateInterval(component));
+
+    DrawCollection(m_RenderContext, m_Collection, true);
+    ASSERT_TRUE(dmGameObject::Update(m_Collection, &m_UpdateContext));
+    ASSERT_TRUE(dmGameObject::PostUpdate(m_Collection));
+    ASSERT_EQ(3u, dmGameSystem::GetModelComponentUpdateInterval(component));
+
+    // Drawn without frustum culling, the model counts as visible
+    DrawCollection(m_RenderContext, m_Collection, false);
+    ASSERT_TRUE(dmGameObject::Update(m_Collection, &m_UpdateContext));
+    ASSERT_TRUE(dmGameObject::PostUpdate(m_Collection));
+    ASSERT_EQ(1u, dmGameSystem::GetModelComponentUpdateInterval(component));
+
+    ASSERT_TRUE(dmGameObject::Final(m_Collection));
+}
+
 // A single mesh with multiple materials that have different coordinate spaces
 // should generate the corresponding batch types. In this case the .gltf file
 // has two sub-meshes (RenderItems) with one world space material and one
@@ -8950,6 +9073,57 @@ TEST_F(ModelTest, MultiMaterialVertexSpaceRenderBatching)
     ASSERT_TRUE(dmGameObject::Final(m_Collection));
 }
 
+TEST_F(ModelTest, StaticBatching)
+{
+    ASSERT_TRUE(dmGameObject::Init(m_Collection));
+
+    void* model_world = dmGameObject::GetWorld(m_Collection, dmGameObject::GetComponentTypeIndex(m_Collection, dmHashString64("modelc")));
+    ASSERT_NE((void*)0, model_world);
+    dmGameSystem::SetModelWorldStaticBatching(model_world, true);
+
+    dmGameObject::HInstance go = Spawn(m_Factory, m_Collection, "/misc/dispatch_buffers_test/dispatch_buffers_test.goc", dmHashString64("/go"), 0, Point3(0, 0, 0), Quat(0, 0, 0, 1), Vector3(1, 1, 1));
+    ASSERT_NE((void*)0, go);
+
+    // Same layout as /misc/dispatch_buffers_test/vs_format_a.vp
+    struct vs_format_a
+    {
+        float position[3];
+        float page_index;
+    };
+
+    uint32_t vx_buffers_count;
+    dmRender::BufferedRenderBuffer** vx_buffers;
+    dmGameSystem::GetModelWorldRenderBuffers(model_world, &vx_buffers, &vx_buffers_count);
+
+    // The first frames transform the vertices, the following frames reuse them
+    for (int frame = 0; frame < 4; ++frame)
+    {
+        if (frame == 3)
+        {
+            dmGameObject::SetPosition(go, Point3(10, 0, 0));
+        }
+
+        ASSERT_TRUE(dmGameObject::Update(m_Collection, &m_UpdateContext));
+        ASSERT_TRUE(dmGameObject::PostUpdate(m_Collection));
+
+        dmRender::RenderListBegin(m_RenderContext);
+        dmGameObject::Render(m_Collection);
+        dmRender::RenderListEnd(m_RenderContext);
+        dmRender::DrawRenderList(m_RenderContext, 0x0, 0x0, 0x0, dmRender::SORT_BACK_TO_FRONT);
+
+        dmGraphics::VertexBuffer* gfx_vx_buffer = (dmGraphics::VertexBuffer*) vx_buffers[0]->m_Buffers[0];
+        vs_format_a* vertices = (vs_format_a*) gfx_vx_buffer->m_Buffer;
+
+        float x_offset = frame == 3 ? 10.0f : 0.0f;
+        ASSERT_NEAR( 1.0f + x_offset, vertices[0].position[0], EPSILON);
+        ASSERT_NEAR( 1.0f, vertices[0].position[1], EPSILON);
+        ASSERT_NEAR(-1.0f + x_offset, vertices[2].position[0], EPSILON);
+        ASSERT_NEAR(-1.0f, vertices[2].position[1], EPSILON);
+    }
+
+    ASSERT_TRUE(dmGameObject::Final(m_Collection));
+}
+
 TEST_F(ModelTest, DynamicVertexAttributes)
 {
     dmGameObject::HInstance go = Spawn(m_Factory, m_Collection, "/model/dynamic_vertex_attributes.goc", dmHashString64("/go"), 0, Point3(0, 0, 0), Quat(0, 0, 0, 1), Vector3(1, 1, 1));
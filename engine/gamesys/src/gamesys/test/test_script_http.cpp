@@ -17,6 +17,7 @@
 #include <script/test_script.h>
 #include <script/script.h>
 #include <testmain/testmain.h>
+#include <dlib/buffer.h>
 #include <dlib/configfile.h>
 #include <dlib/dstrings.h>
 #include <dlib/hash.h>
@@ -116,6 +117,8 @@ protected:
 
         m_HttpResponseCount = 0;
 
+        dmBuffer::NewContext();
+
         WindowCreateParams win_params;
         WindowCreateParamsInitialize(&win_params);
         m_Window = dmPlatform::NewWindow();
@@ -228,6 +231,8 @@ protected:
         dmPlatform::DeleteWindow(m_Window);
 
         dmConfigFile::Delete(m_ConfigFile);
+
+        dmBuffer::DeleteContext();
     }
 
     void SetHttpAddress(lua_State* L)
@@ -320,6 +325,153 @@ TEST_F(ScriptHttpTest, TestGetPost)
     ASSERT_EQ(top, lua_gettop(L));
 }
 
+TEST_F(ScriptHttpTest, TestConcurrent)
+{
+    int top = lua_gettop(L);
+
+    ASSERT_TRUE(dmScriptTest::RunFile(L, "test_http_concurrent.lua.rawc", "build/src/gamesys/test/http"));
+    SetHttpAddress(L);
+
+    lua_getglobal(L, "functions");
+    ASSERT_EQ(LUA_TTABLE, lua_type(L, -1));
+    lua_getfield(L, -1, "test_http_concurrent");
+    ASSERT_EQ(LUA_TFUNCTION, lua_type(L, -1));
+    int result = dmScript::PCall(L, 0, LUA_MULTRET);
+    ASSERT_EQ(0, result);
+    lua_pop(L, 1);
+
+    uint64_t start = dmTime::GetMonotonicTime();
+    while (1) {
+        dmSys::PumpMessageQueue();
+        dmMessage::Dispatch(m_DefaultURL.m_Socket, DispatchCallbackDDF, this);
+
+        lua_getglobal(L, "requests_left");
+        int requests_left = lua_tointeger(L, -1);
+        lua_pop(L, 1);
+
+        if (requests_left == 0) {
+            break;
+        }
+
+        if( m_NumberOfFails )
+        {
+            break;
+        }
+
+        dmTime::Sleep(10 * 1000);
+
+        uint64_t elapsed = dmTime::GetMonotonicTime() - start;
+        if (elapsed / 1000000 > 8) {
+            dmLogError("The test timed out\n");
+            ASSERT_TRUE(0);
+        }
+    }
+
+    // All 16 requests were waiting on the server at the same time
+    lua_getglobal(L, "max_overlap");
+    int max_overlap = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    ASSERT_EQ(16, max_overlap);
+
+    ASSERT_EQ(top, lua_gettop(L));
+}
+
+TEST_F(ScriptHttpTest, TestManyConcurrent)
+{
+    int top = lua_gettop(L);
+
+    ASSERT_TRUE(dmScriptTest::RunFile(L, "test_http_concurrent.lua.rawc", "build/src/gamesys/test/http"));
+    SetHttpAddress(L);
+
+    lua_getglobal(L, "functions");
+    ASSERT_EQ(LUA_TTABLE, lua_type(L, -1));
+    lua_getfield(L, -1, "test_http_many_concurrent");
+    ASSERT_EQ(LUA_TFUNCTION, lua_type(L, -1));
+    int result = dmScript::PCall(L, 0, LUA_MULTRET);
+    ASSERT_EQ(0, result);
+    lua_pop(L, 1);
+
+    uint64_t start = dmTime::GetMonotonicTime();
+    while (1) {
+        dmSys::PumpMessageQueue();
+        dmMessage::Dispatch(m_DefaultURL.m_Socket, DispatchCallbackDDF, this);
+
+        lua_getglobal(L, "requests_left");
+        int requests_left = lua_tointeger(L, -1);
+        lua_pop(L, 1);
+
+        if (requests_left == 0) {
+            break;
+        }
+
+        if( m_NumberOfFails )
+        {
+            break;
+        }
+
+        dmTime::Sleep(10 * 1000);
+
+        uint64_t elapsed = dmTime::GetMonotonicTime() - start;
+        if (elapsed / 1000000 > 20) {
+            dmLogError("The test timed out\n");
+            ASSERT_TRUE(0);
+        }
+    }
+
+    // All 256 requests completed, and at most the default number of connections (32) were used at once
+    lua_getglobal(L, "max_overlap");
+    int max_overlap = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    ASSERT_EQ(32, max_overlap);
+
+    ASSERT_EQ(top, lua_gettop(L));
+}
+
+TEST_F(ScriptHttpTest, TestStream)
+{
+    int top = lua_gettop(L);
+
+    ASSERT_TRUE(dmScriptTest::RunFile(L, "test_http_stream.lua.rawc", "build/src/gamesys/test/http"));
+    SetHttpAddress(L);
+
+    lua_getglobal(L, "functions");
+    ASSERT_EQ(LUA_TTABLE, lua_type(L, -1));
+    lua_getfield(L, -1, "test_http_stream");
+    ASSERT_EQ(LUA_TFUNCTION, lua_type(L, -1));
+    int result = dmScript::PCall(L, 0, LUA_MULTRET);
+    ASSERT_EQ(0, result);
+    lua_pop(L, 1);
+
+    uint64_t start = dmTime::GetMonotonicTime();
+    while (1) {
+        dmSys::PumpMessageQueue();
+        dmMessage::Dispatch(m_DefaultURL.m_Socket, DispatchCallbackDDF, this);
+
+        lua_getglobal(L, "requests_left");
+        int requests_left = lua_tointeger(L, -1);
+        lua_pop(L, 1);
+
+        if (requests_left == 0) {
+            break;
+        }
+
+        if( m_NumberOfFails )
+        {
+            break;
+        }
+
+        dmTime::Sleep(10 * 1000);
+
+        uint64_t elapsed = dmTime::GetMonotonicTime() - start;
+        if (elapsed / 1000000 > 8) {
+            dmLogError("The test timed out\n");
+            ASSERT_TRUE(0);
+        }
+    }
+
+    ASSERT_EQ(top, lua_gettop(L));
+}
+
 struct SHttpRequestTimeoutGuard // Makes sure it gets reset after gtest returns
 {
     SHttpRequestTimeoutGuard(uint64_t timeout)
@@ -421,6 +573,48 @@ TEST_F(ScriptHttpTest, TestDeletedSocket)
     ASSERT_EQ(top, lua_gettop(L));
 }
 
+TEST_F(ScriptHttpTest, TestDeletedSocketBuffer)
+{
+    SHttpRequestTimeoutGuard timeoutguard(2000 * 1000);
+
+    int top = lua_gettop(L);
+
+    ASSERT_TRUE(dmScriptTest::RunFile(L, "test_http_stream.lua.rawc", "build/src/gamesys/test/http"));
+    SetHttpAddress(L);
+
+    lua_getglobal(L, "functions");
+    ASSERT_EQ(LUA_TTABLE, lua_type(L, -1));
+    lua_getfield(L, -1, "test_http_stream_deleted");
+    ASSERT_EQ(LUA_TFUNCTION, lua_type(L, -1));
+    int result = dmScript::PCall(L, 0, LUA_MULTRET);
+    ASSERT_EQ(0, result);
+    lua_pop(L, 1);
+
+    // The requester is deleted while the request is in flight
+    dmMessage::DeleteSocket(m_DefaultURL.m_Socket);
+    m_DefaultURL.m_Socket = 0;
+
+    // The response can't be delivered, and the buffer is released on the next extension update instead
+    bool released = false;
+    uint64_t start = dmTime::GetMonotonicTime();
+    while (!released && dmTime::GetMonotonicTime() - start < 4000000)
+    {
+        dmSys::PumpMessageQueue();
+        dmExtension::Update(&m_Params);
+        lua_gc(L, LUA_GCCOLLECT, 0);
+
+        lua_getglobal(L, "request_buffers");
+        lua_rawgeti(L, -1, 1);
+        released = lua_isnil(L, -1);
+        lua_pop(L, 2);
+
+        dmTime::Sleep(10 * 1000);
+    }
+    ASSERT_TRUE(released);
+
+    ASSERT_EQ(top, lua_gettop(L));
+}
+
 static void Destroy()
 {
     dmSocket::Finalize();
@@ -16,8 +16,11 @@
 
 #include <dlib/array.h>
 #include <dlib/dlib.h>
+#include <dlib/dstrings.h>
 #include <dlib/hash.h>
+#include <dlib/hashtable.h>
 #include <dlib/log.h>
+#include <dlib/math.h>
 #include <dlib/profile.h>
 #include <dlib/time.h>
 
@@ -79,6 +82,30 @@ struct LuaProfilerScopeState
 
 static LuaProfilerScopeState*            g_LuaProfilerScopeStates = 0;
 
+struct LuaSample
+{
+    uint64_t    m_NameHash;
+    uint32_t    m_NameOffset;
+    uint32_t    m_Count;
+    uint32_t    m_IntervalCount;    // Count since the last report
+};
+
+// Collects the samples from the LuaJIT sampling profiler (jit.profile)
+struct LuaSampler
+{
+    lua_State*                  m_L;                // Main thread of the sampled Lua state
+    dmArray<LuaSample>          m_Samples;
+    dmHashTable64<uint32_t>     m_SampleIndices;
+    dmArray<char>               m_Names;
+    dmArray<uint32_t>           m_SortedIndices;
+    uint64_t                    m_LastReportTime;
+    uint32_t                    m_IntervalCount;
+};
+
+static LuaSampler*                       g_LuaSampler = 0;
+static const uint64_t                    LUA_SAMPLER_REPORT_INTERVAL = 1000000; // us
+static const uint32_t                    LUA_SAMPLER_REPORT_COUNT = 8;
+
 static void SampleTreeCallback(void* _ctx, const char* thread_name, dmProfiler::HSample root);
 static void PropertyTreeCallback(void* _ctx, dmProfiler::HProperty root);
 static ExtensionResult PreRenderProfiler(dmExtension::Params* params);
@@ -803,6 +830,313 @@ static int ProfilerScopeEnd(lua_State* L)
 }
 
 
+/*# enables or disables profiler scopes per script instance
+ *
+ * By default the time spent in the script callbacks (`init`, `update`, `on_message`, `on_input` etc) is recorded
+ * per script resource. When enabled, the path of the game object is added to the scope names,
+ * so that the time is recorded per script instance instead.
+ * It can also be enabled with the `profiler.instance_scopes` project setting.
+ *
+ * @note This generates one profiler scope per instance and callback. With a large amount of instances
+ * the `profiler.max_sample_count` setting may need to be increased.
+ *
+ * @name profiler.set_instance_scopes
+ * @param enable [type:boolean] true to record the time per script instance
+ *
+ * @examples
+ * ```lua
+ * profiler.set_instance_scopes(true)
+ * ```
+ */
+static int ProfilerSetInstanceScopes(lua_State* L)
+{
+    DM_LUA_STACK_CHECK(L, 0);
+    luaL_checktype(L, 1, LUA_TBOOLEAN);
+    dmScript::SetProfileInstanceScopes(lua_toboolean(L, 1) != 0);
+    return 0;
+}
+
+static uint32_t AddLuaSample(LuaSampler* sampler, const char* name, uint32_t name_length, uint32_t count)
+{
+    uint64_t name_hash = dmHashBuffer64(name, name_length);
+    uint32_t* index = sampler->m_SampleIndices.Get(name_hash);
+    if (index == 0)
+    {
+        if (sampler->m_SampleIndices.Full())
+        {
+            uint32_t capacity = sampler->m_SampleIndices.Capacity() + 256;
+            sampler->m_SampleIndices.SetCapacity(capacity / 2 + 1, capacity);
+        }
+        EnsureLuaProfilerCapacity(&sampler->m_Samples, 1, 256);
+        EnsureLuaProfilerCapacity(&sampler->m_Names, name_length + 1, 4096);
+
+        LuaSample sample;
+        sample.m_NameHash = name_hash;
+        sample.m_NameOffset = sampler->m_Names.Size();
+        sample.m_Count = 0;
+        sample.m_IntervalCount = 0;
+        sampler->m_Names.PushArray(name, name_length);
+        sampler->m_Names.Push(0);
+
+        sampler->m_SampleIndices.Put(name_hash, sampler->m_Samples.Size());
+        sampler->m_Samples.Push(sample);
+        index = sampler->m_SampleIndices.Get(name_hash);
+    }
+
+    LuaSample& sample = sampler->m_Samples[*index];
+    sample.m_Count += count;
+    sample.m_IntervalCount += count;
+    sampler->m_IntervalCount += count;
+    return *index;
+}
+
+// Called by jit.profile with the arguments (thread, samples, vmstate)
+// Upvalue 1 is jit.profile.dumpstack
+static int LuaSamplerCallback(lua_State* L)
+{
+    LuaSampler* sampler = g_LuaSampler;
+    if (sampler == 0)
+    {
+        return 0;
+    }
+
+    uint32_t count = (uint32_t) luaL_optinteger(L, 2, 1);
+
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_pushvalue(L, 1);
+    lua_pushliteral(L, "pF");
+    lua_pushinteger(L, 1);
+    lua_call(L, 3, 1);
+
+    size_t name_length = 0;
+    const char* name = lua_tolstring(L, -1, &name_length);
+    if (name != 0 && name_length > 0)
+    {
+        AddLuaSample(sampler, name, (uint32_t) name_length, count);
+    }
+    lua_pop(L, 1);
+    return 0;
+}
+
+struct LuaSampleCountPred
+{
+    const LuaSample* m_Samples;
+    bool m_Interval;
+    bool operator()(uint32_t a, uint32_t b) const
+    {
+        if (m_Interval)
+            return m_Samples[a].m_IntervalCount > m_Samples[b].m_IntervalCount;
+        return m_Samples[a].m_Count > m_Samples[b].m_Count;
+    }
+};
+
+static void SortLuaSamples(LuaSampler* sampler, bool interval)
+{
+    uint32_t count = sampler->m_Samples.Size();
+    sampler->m_SortedIndices.SetSize(0);
+    EnsureLuaProfilerCapacity(&sampler->m_SortedIndices, count, 256);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (!interval || sampler->m_Samples[i].m_IntervalCount > 0)
+        {
+            sampler->m_SortedIndices.Push(i);
+        }
+    }
+    LuaSampleCountPred pred = { sampler->m_Samples.Begin(), interval };
+    std::sort(sampler->m_SortedIndices.Begin(), sampler->m_SortedIndices.End(), pred);
+}
+
+// Streams the hottest functions since the last report to the connected profiler
+static void ReportLuaSamples(LuaSampler* sampler)
+{
+    uint64_t time = dmTime::GetMonotonicTime();
+    if (time - sampler->m_LastReportTime < LUA_SAMPLER_REPORT_INTERVAL)
+    {
+        return;
+    }
+    sampler->m_LastReportTime = time;
+
+    if (sampler->m_IntervalCount == 0)
+    {
+        return;
+    }
+
+    SortLuaSamples(sampler, true);
+
+    uint32_t report_count = dmMath::Min(LUA_SAMPLER_REPORT_COUNT, sampler->m_SortedIndices.Size());
+    for (uint32_t i = 0; i < report_count; ++i)
+    {
+        const LuaSample& sample = sampler->m_Samples[sampler->m_SortedIndices[i]];
+        ProfileLogText("Lua samples: %5.1f%% %s", 100.0f * sample.m_IntervalCount / sampler->m_IntervalCount, sampler->m_Names.Begin() + sample.m_NameOffset);
+    }
+
+    for (uint32_t i = 0; i < sampler->m_Samples.Size(); ++i)
+    {
+        sampler->m_Samples[i].m_IntervalCount = 0;
+    }
+    sampler->m_IntervalCount = 0;
+}
+
+// Pushes the jit.profile module, or returns false if it isn't available (i.e. not running LuaJIT)
+static bool PushJitProfileModule(lua_State* L)
+{
+    lua_getglobal(L, "require");
+    lua_pushliteral(L, "jit.profile");
+    if (lua_pcall(L, 1, 1, 0) != 0 || !lua_istable(L, -1))
+    {
+        lua_pop(L, 1);
+        return false;
+    }
+    return true;
+}
+
+static void StopLuaSampler()
+{
+    LuaSampler* sampler = g_LuaSampler;
+    if (sampler == 0)
+    {
+        return;
+    }
+
+    lua_State* L = sampler->m_L;
+    if (PushJitProfileModule(L))
+    {
+        lua_getfield(L, -1, "stop");
+        if (lua_pcall(L, 0, 0, 0) != 0)
+        {
+            dmLogWarning("Failed to stop the Lua sampling profiler: %s", lua_tostring(L, -1));
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);
+    }
+    g_LuaSampler = 0;
+    delete sampler;
+}
+
+/*# starts the Lua sampling profiler
+ *
+ * Starts sampling the running Lua functions at a fixed interval, using the LuaJIT profiler (`jit.profile`).
+ * The overhead is low enough to keep it running while playing the game.
+ * Every second, the functions where the most samples were taken are sent as text to the connected profiler.
+ * Call `profiler.stop_lua_sampling()` to get all the results.
+ *
+ * @note The sampling profiler requires LuaJIT, and is not available on HTML5.
+ * Only one Lua state can be sampled at a time.
+ *
+ * @name profiler.start_lua_sampling
+ * @param [interval] [type:number] the sampling interval in milliseconds. Defaults to 1.
+ * @return started [type:boolean] true if the sampling profiler was started
+ *
+ * @examples
+ * ```lua
+ * if not profiler.start_lua_sampling(2) then
+ *     print("Lua sampling is not supported")
+ * end
+ * ```
+ */
+static int ProfilerStartLuaSampling(lua_State* L)
+{
+    DM_LUA_STACK_CHECK(L, 1);
+
+    int interval = luaL_optinteger(L, 1, 1);
+    if (interval < 1)
+    {
+        return DM_LUA_ERROR("The sampling interval must be at least 1 ms");
+    }
+
+    if (g_LuaSampler != 0)
+    {
+        dmLogWarning("The Lua sampling profiler is already running");
+        lua_pushboolean(L, 0);
+        return 1;
+    }
+
+    if (!PushJitProfileModule(L))
+    {
+        dmLogWarning("The Lua sampling profiler requires LuaJIT (jit.profile is not available)");
+        lua_pushboolean(L, 0);
+        return 1;
+    }
+
+    LuaSampler* sampler = new LuaSampler;
+    sampler->m_L = dmScript::GetMainThread(L);
+    sampler->m_LastReportTime = dmTime::GetMonotonicTime();
+    sampler->m_IntervalCount = 0;
+    g_LuaSampler = sampler;
+
+    char mode[16];
+    dmSnPrintf(mode, sizeof(mode), "fi%d", interval);
+
+    lua_getfield(L, -1, "start");
+    lua_pushstring(L, mode);
+    lua_getfield(L, -3, "dumpstack");
+    lua_pushcclosure(L, LuaSamplerCallback, 1);
+    if (lua_pcall(L, 2, 0, 0) != 0)
+    {
+        dmLogWarning("Failed to start the Lua sampling profiler: %s", lua_tostring(L, -1));
+        lua_pop(L, 2);
+        g_LuaSampler = 0;
+        delete sampler;
+        lua_pushboolean(L, 0);
+        return 1;
+    }
+    lua_pop(L, 1);
+
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+/*# stops the Lua sampling profiler
+ *
+ * Stops the sampling profiler started with `profiler.start_lua_sampling()` and returns the collected samples.
+ *
+ * @name profiler.stop_lua_sampling
+ * @return samples [type:table|nil] array of the sampled functions, sorted with the most sampled function first, or nil if the profiler wasn't running. Each entry is a table with:
+ *
+ * `name`
+ * : [type:string] the function name, in the form "path:function"
+ *
+ * `samples`
+ * : [type:number] the number of samples taken in the function
+ *
+ * @examples
+ * ```lua
+ * local samples = profiler.stop_lua_sampling()
+ * for i = 1, math.min(10, #samples) do
+ *     print(samples[i].samples, samples[i].name)
+ * end
+ * ```
+ */
+static int ProfilerStopLuaSampling(lua_State* L)
+{
+    DM_LUA_STACK_CHECK(L, 1);
+
+    LuaSampler* sampler = g_LuaSampler;
+    if (sampler == 0)
+    {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    SortLuaSamples(sampler, false);
+
+    uint32_t count = sampler->m_SortedIndices.Size();
+    lua_createtable(L, count, 0);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const LuaSample& sample = sampler->m_Samples[sampler->m_SortedIndices[i]];
+        lua_createtable(L, 0, 2);
+        lua_pushstring(L, sampler->m_Names.Begin() + sample.m_NameOffset);
+        lua_setfield(L, -2, "name");
+        lua_pushinteger(L, sample.m_Count);
+        lua_setfield(L, -2, "samples");
+        lua_rawseti(L, -2, i + 1);
+    }
+
+    StopLuaSampler();
+    return 1;
+}
+
 /*# continously show latest frame
 *
 * @name profiler.MODE_RUN
@@ -983,6 +1317,8 @@ static dmExtension::Result InitializeProfiler(dmExtension::Params* params)
         dmProfiler::g_TrackCpuUsage = true;
     }
 
+    dmScript::SetProfileInstanceScopes(dmConfigFile::GetInt(params->m_ConfigFile, "profiler.instance_scopes", 0) != 0);
+
     static const luaL_reg Module_methods[] =
     {
         {"get_memory_usage",            MemoryUsage},
@@ -1001,6 +1337,10 @@ static dmExtension::Result InitializeProfiler(dmExtension::Params* params)
         {"scope_begin",                 ProfilerScopeBegin},
         {"scope_end",                   ProfilerScopeEnd},
 
+        {"set_instance_scopes",         ProfilerSetInstanceScopes},
+        {"start_lua_sampling",          ProfilerStartLuaSampling},
+        {"stop_lua_sampling",           ProfilerStopLuaSampling},
+
         {0, 0}
     };
 
@@ -1046,12 +1386,17 @@ static ExtensionResult PreRenderProfiler(dmExtension::Params* params)
 {
     (void) params;
     AutoCloseLuaProfilerScopes();
+    if (g_LuaSampler)
+    {
+        ReportLuaSamples(g_LuaSampler);
+    }
     return EXTENSION_RESULT_OK;
 }
 
 static dmExtension::Result FinalizeProfiler(dmExtension::Params* params)
 {
     AutoCloseLuaProfilerScopes();
+    StopLuaSampler();
     DeleteLuaProfilerScopeStates();
     DeleteProfilerUI();
     return dmExtension::RESULT_OK;
@@ -483,7 +483,11 @@ typedef ResourceResult (*FResourceTypeDeregister)(HResourceTypeContext ctx, HRes
 typedef ResourceResult (*FResourcePreload)(const struct ResourcePreloadParams* params);
 
 /*#
- * Resource create function
+ * Resource create function. This is called on the main thread, once the resources
+ * hinted during the preload have been created.
+ * @note The preloader limits the number of creates per update to fit its time budget, but a single
+ * create can't be split. Do the heavy (thread safe) work in the preload function, and any work that
+ * can be spread over several frames in the postcreate function.
  * @typedef
  * @name FResourceCreate
  * @param param [type: const dmResource::ResourceCreateParams*] Resource parameters
@@ -494,6 +498,8 @@ typedef ResourceResult (*FResourceCreate)(const struct ResourceCreateParams* par
 /*#
  * Resource postcreate function
  * @note returning RESOURCE_CREATE_RESULT_PENDING will result in a repeated callback the following update.
+ * This can be used to finalize a resource in steps, or to wait for work started in the create function
+ * (e.g. an asynchronous texture upload) to complete.
  * @typedef
  * @name FResourcePostCreate
  * @param param [type: const dmResource::ResourcePostCreateParams*] Resource parameters
@@ -140,6 +140,7 @@ static Result DoMount(ArchiveLoader* loader, const dmURI::Parts* uri, HArchive b
         memcpy(&archive->m_Uri, uri, sizeof(dmURI::Parts));
         archive->m_Loader = loader;
         archive->m_Internal = internal;
+        archive->m_Mutex = dmMutex::New();
         *out_archive = archive;
     }
     return result;
@@ -158,6 +159,7 @@ Result CreateMount(ArchiveLoader* loader, void* internal, HArchive* out_archive)
     memset(archive, 0, sizeof(Archive));
     archive->m_Loader = loader;
     archive->m_Internal = internal;
+    archive->m_Mutex = dmMutex::New();
     *out_archive = archive;
     return RESULT_OK;
 }
@@ -165,22 +167,43 @@ Result CreateMount(ArchiveLoader* loader, void* internal, HArchive* out_archive)
 Result Unmount(HArchive archive)
 {
     Result result = archive->m_Loader->m_Unmount(archive->m_Internal);
+    dmMutex::Delete(archive->m_Mutex);
     delete archive;
     return result;
 }
 
+// Locks the archive for the duration of the scope, unless the loader is thread safe
+struct ArchiveScopedLock
+{
+    dmMutex::HMutex m_Mutex;
+    ArchiveScopedLock(HArchive archive)
+    {
+        m_Mutex = archive->m_Loader->m_ThreadSafe ? 0 : archive->m_Mutex;
+        if (m_Mutex)
+            dmMutex::Lock(m_Mutex);
+    }
+    ~ArchiveScopedLock()
+    {
+        if (m_Mutex)
+            dmMutex::Unlock(m_Mutex);
+    }
+};
+
 Result GetFileSize(HArchive archive, dmhash_t path_hash, const char* path, uint32_t* file_size)
 {
+    ArchiveScopedLock lock(archive);
     return archive->m_Loader->m_GetFileSize(archive->m_Internal, path_hash, path, file_size);
 }
 
 Result ReadFile(HArchive archive, dmhash_t path_hash, const char* path, uint8_t* buffer, uint32_t buffer_len)
 {
+    ArchiveScopedLock lock(archive);
     return archive->m_Loader->m_ReadFile(archive->m_Internal, path_hash, path, buffer, buffer_len);
 }
 
 Result ReadFilePartial(HArchive archive, dmhash_t path_hash, const char* path, uint32_t offset, uint32_t size, uint8_t* buffer, uint32_t* nread)
 {
+    ArchiveScopedLock lock(archive);
     return archive->m_Loader->m_ReadFilePartial(archive->m_Internal, path_hash, path, offset, size, buffer, nread);
 }
 
@@ -200,7 +223,10 @@ Result GetUri(HArchive archive, dmURI::Parts* out_uri)
 Result WriteFile(HArchive archive, dmhash_t path_hash, const char* path, const uint8_t* buffer, uint32_t buffer_len)
 {
     if (archive->m_Loader->m_WriteFile)
+    {
+        ArchiveScopedLock lock(archive);
         return archive->m_Loader->m_WriteFile(archive->m_Internal, path_hash, path, buffer, buffer_len);
+    }
     dmLogError("Archive type '%s' doesn't support writing files", dmHashReverseSafe64(archive->m_Loader->m_NameHash));
     return RESULT_NOT_SUPPORTED;
 }
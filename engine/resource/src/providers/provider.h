@@ -80,8 +80,11 @@ namespace dmResourceProvider
     // Plugin API
     struct ArchiveLoaderParams
     {
-        dmResource::HFactory    m_Factory;
-        dmHttpCache::HCache     m_HttpCache;
+        dmResource::HFactory            m_Factory;
+        dmHttpCache::HCache             m_HttpCache;
+        HJobContext                     m_JobContext;
+        dmResource::ArchiveVerifyMode   m_ArchiveVerifyMode;
+        const char*                     m_ArchiveVerifyRecordDir;
     };
 
     typedef void (*FRegisterLoader)(ArchiveLoader*);
@@ -21,9 +21,12 @@
 #include "../resource_manifest.h"
 #include "../resource_manifest_private.h"
 #include "../resource_archive.h"
+#include "../resource_verify.h"
 
+#include <dlib/atomic.h>
 #include <dlib/dstrings.h>
 #include <dlib/endian.hpp>
+#include <dlib/hash.h>
 #include <dlib/log.h>
 #include <dlib/math.h>
 #include <dlib/lz4.h>
@@ -36,6 +39,7 @@ namespace dmResourceProviderArchive
     {
         dmLiveUpdateDDF::ResourceEntry* m_ManifestEntry;
         dmResourceArchive::EntryData*   m_ArchiveInfo;
+        int32_atomic_t                  m_Verified; // Used with ARCHIVE_VERIFY_MODE_LAZY
     };
 
     struct GameArchiveFile
@@ -44,28 +48,33 @@ namespace dmResourceProviderArchive
         dmResource::HManifest                       m_Manifest;
         dmResourceArchive::HArchiveIndexContainer   m_ArchiveIndex;
         dmHashTable64<EntryInfo>                    m_EntryMap; // url hash -> entry in the manifest
+        uint8_t                                     m_VerifyOnRead:1;
 
         GameArchiveFile()
         : m_Manifest(0)
         , m_ArchiveIndex(0)
+        , m_VerifyOnRead(0)
         {}
     };
 
-    static dmResourceProvider::Result MountArchive(const dmURI::Parts* uri, dmResourceArchive::HArchiveIndexContainer* out)
+    static HJobContext                      g_JobContext = 0;
+    static dmResource::ArchiveVerifyMode    g_VerifyMode = dmResource::ARCHIVE_VERIFY_MODE_NONE;
+    static char                             g_VerifyRecordDir[DMPATH_MAX_PATH] = {0};
+
+    static dmResourceProvider::Result MountArchive(const dmURI::Parts* uri, dmResourceArchive::HArchiveIndexContainer* out,
+                                                   char* mount_archive_index_path, char* mount_archive_data_path) // DMPATH_MAX_PATH each
     {
         char archive_index_path[DMPATH_MAX_PATH];
         char archive_data_path[DMPATH_MAX_PATH];
         dmSnPrintf(archive_index_path, sizeof(archive_index_path), "%s%s.arci", uri->m_Location, uri->m_Path);
         dmSnPrintf(archive_data_path, sizeof(archive_data_path), "%s%s.arcd", uri->m_Location, uri->m_Path);
 
-        char mount_archive_index_path[DMPATH_MAX_PATH];
-        char mount_archive_data_path[DMPATH_MAX_PATH];
-        if (dmSys::RESULT_OK != dmSys::ResolveMountFileName(mount_archive_index_path, sizeof(mount_archive_index_path), archive_index_path))
+        if (dmSys::RESULT_OK != dmSys::ResolveMountFileName(mount_archive_index_path, DMPATH_MAX_PATH, archive_index_path))
         {
             dmLogError("File doesn’t exist or can’t be read: %s", archive_index_path);
             return dmResourceProvider::RESULT_ERROR_UNKNOWN;
         }
-        if (dmSys::RESULT_OK != dmSys::ResolveMountFileName(mount_archive_data_path, sizeof(mount_archive_data_path), archive_data_path))
+        if (dmSys::RESULT_OK != dmSys::ResolveMountFileName(mount_archive_data_path, DMPATH_MAX_PATH, archive_data_path))
         {
             dmLogError("File doesn’t exist or can’t be read: %s", mount_archive_data_path);
             return dmResourceProvider::RESULT_ERROR_UNKNOWN;
@@ -113,6 +122,7 @@ namespace dmResourceProviderArchive
 
             EntryInfo info;
             info.m_ManifestEntry = entry;
+            info.m_Verified = 0;
             dmResourceArchive::Result result = dmResourceArchive::FindEntry(archive->m_ArchiveIndex, entry->m_Hash.m_Data.m_Data, hash_len, &info.m_ArchiveInfo);
             if (result != dmResourceArchive::RESULT_OK)
             {
@@ -122,7 +132,52 @@ namespace dmResourceProviderArchive
         }
     }
 
-    static dmResourceProvider::Result LoadArchive(const dmURI::Parts* uri, dmResourceProvider::HArchiveInternal* out_archive)
+    static dmResourceProvider::Result VerifyArchive(GameArchiveFile* archive, const char* index_path, const char* data_path)
+    {
+        char record_path[DMPATH_MAX_PATH];
+        dmResource::VerifyArchiveParams params;
+        params.m_JobContext = g_JobContext;
+        params.m_IndexPath = index_path;
+        params.m_DataPath = data_path;
+        if (g_VerifyRecordDir[0])
+        {
+            dmSnPrintf(record_path, sizeof(record_path), "%s/%016llx.verified", g_VerifyRecordDir, (unsigned long long)dmHashString64(data_path));
+            params.m_RecordPath = record_path;
+        }
+
+        dmResource::Result result = dmResource::VerifyArchive(archive->m_Manifest, archive->m_ArchiveIndex, &params);
+        if (dmResource::RESULT_OK != result)
+        {
+            dmLogError("The archive '%s' failed verification: %s", data_path, dmResource::ResultToString(result));
+            return dmResourceProvider::RESULT_INVAL_ERROR;
+        }
+        return dmResourceProvider::RESULT_OK;
+    }
+
+    static dmResourceProvider::Result VerifyEntry(GameArchiveFile* archive, EntryInfo* entry)
+    {
+        if (dmAtomicGet32(&entry->m_Verified))
+            return dmResourceProvider::RESULT_OK;
+
+        // Liveupdate entries aren't part of the bundle, and are verified when they are stored
+        if (dmEndian::ToNetwork(entry->m_ArchiveInfo->m_Flags) & dmResourceArchive::ENTRY_FLAG_LIVEUPDATE_DATA)
+            return dmResourceProvider::RESULT_OK;
+
+        dmArray<uint8_t> scratch;
+        dmLiveUpdateDDF::HashAlgorithm algorithm = archive->m_Manifest->m_DDFData->m_Header.m_ResourceHashAlgorithm;
+        dmLiveUpdateDDF::HashDigest* hash = &entry->m_ManifestEntry->m_Hash;
+        dmResource::Result result = dmResource::VerifyArchiveEntry(archive->m_ArchiveIndex, entry->m_ArchiveInfo, algorithm,
+                                                                   hash->m_Data.m_Data, hash->m_Data.m_Count, &scratch);
+        if (dmResource::RESULT_OK != result)
+        {
+            dmLogError("Resource '%s' failed verification: %s", entry->m_ManifestEntry->m_Url, dmResource::ResultToString(result));
+            return dmResourceProvider::RESULT_IO_ERROR;
+        }
+        dmAtomicStore32(&entry->m_Verified, 1);
+        return dmResourceProvider::RESULT_OK;
+    }
+
+    static dmResourceProvider::Result LoadArchive(const dmURI::Parts* uri, bool is_base_archive, dmResourceProvider::HArchiveInternal* out_archive)
     {
         GameArchiveFile* archive = new GameArchiveFile;
         {
@@ -143,7 +198,9 @@ namespace dmResourceProviderArchive
     // printf("Manifest:\n");
     // dmResource::DebugPrintManifest(archive->m_Manifest);
 
-        dmResourceProvider::Result result = MountArchive(&archive->m_BaseUri, &archive->m_ArchiveIndex);
+        char index_path[DMPATH_MAX_PATH];
+        char data_path[DMPATH_MAX_PATH];
+        dmResourceProvider::Result result = MountArchive(&archive->m_BaseUri, &archive->m_ArchiveIndex, index_path, data_path);
         if (dmResourceProvider::RESULT_OK != result)
         {
             DeleteArchive(archive);
@@ -155,6 +212,21 @@ namespace dmResourceProviderArchive
 
         CreateEntryMap(archive);
 
+        // Only the bundled archive is verified here. Liveupdate content is verified when it's stored.
+        if (is_base_archive)
+        {
+            if (g_VerifyMode == dmResource::ARCHIVE_VERIFY_MODE_FULL)
+            {
+                result = VerifyArchive(archive, index_path, data_path);
+                if (dmResourceProvider::RESULT_OK != result)
+                {
+                    DeleteArchive(archive);
+                    return result;
+                }
+            }
+            archive->m_VerifyOnRead = g_VerifyMode == dmResource::ARCHIVE_VERIFY_MODE_LAZY;
+        }
+
         archive->m_Manifest->m_ArchiveIndex = archive->m_ArchiveIndex;
 
         *out_archive = (dmResourceProvider::HArchive)archive;
@@ -165,7 +237,7 @@ namespace dmResourceProviderArchive
     {
         if (!MatchesUri(uri))
             return dmResourceProvider::RESULT_NOT_SUPPORTED;
-        return LoadArchive(uri, out_archive);
+        return LoadArchive(uri, base_archive == 0, out_archive);
     }
 
     static dmResourceProvider::Result Unmount(dmResourceProvider::HArchiveInternal archive)
@@ -227,6 +299,12 @@ namespace dmResourceProviderArchive
         {
             if (buffer_len < dmEndian::ToNetwork(entry->m_ArchiveInfo->m_ResourceSize))
                 return dmResourceProvider::RESULT_INVAL_ERROR;
+            if (archive->m_VerifyOnRead)
+            {
+                dmResourceProvider::Result result = VerifyEntry(archive, entry);
+                if (dmResourceProvider::RESULT_OK != result)
+                    return result;
+            }
             dmResourceArchive::ReadEntry(archive->m_ArchiveIndex, entry->m_ArchiveInfo, buffer);
             return dmResourceProvider::RESULT_OK;
         }
@@ -240,6 +318,12 @@ namespace dmResourceProviderArchive
         EntryInfo* entry = archive->m_EntryMap.Get(path_hash);
         if (entry)
         {
+            if (archive->m_VerifyOnRead)
+            {
+                dmResourceProvider::Result result = VerifyEntry(archive, entry);
+                if (dmResourceProvider::RESULT_OK != result)
+                    return result;
+            }
             dmResourceArchive::ReadEntryPartial(archive->m_ArchiveIndex, entry->m_ArchiveInfo, offset, size, buffer, nread);
             return dmResourceProvider::RESULT_OK;
         }
@@ -267,7 +351,24 @@ namespace dmResourceProviderArchive
         loader->m_GetFileSize       = GetFileSize;
         loader->m_ReadFile          = ReadFile;
         loader->m_ReadFilePartial   = ReadFilePartial;
+        loader->m_ThreadSafe        = dmResourceArchive::CanReadEntryConcurrently();
+    }
+
+    static dmResourceProvider::Result InitializeArchiveLoader(dmResourceProvider::ArchiveLoaderParams* params, dmResourceProvider::ArchiveLoader* loader)
+    {
+        g_JobContext = params->m_JobContext;
+        g_VerifyMode = params->m_ArchiveVerifyMode;
+        dmStrlCpy(g_VerifyRecordDir, params->m_ArchiveVerifyRecordDir ? params->m_ArchiveVerifyRecordDir : "", sizeof(g_VerifyRecordDir));
+        return dmResourceProvider::RESULT_OK;
+    }
+
+    static dmResourceProvider::Result FinalizeArchiveLoader(dmResourceProvider::ArchiveLoaderParams* params, dmResourceProvider::ArchiveLoader* loader)
+    {
+        g_JobContext = 0;
+        g_VerifyMode = dmResource::ARCHIVE_VERIFY_MODE_NONE;
+        g_VerifyRecordDir[0] = 0;
+        return dmResourceProvider::RESULT_OK;
     }
 
-    DM_DECLARE_ARCHIVE_LOADER(ResourceProviderArchive, "archive", SetupArchiveLoader, 0, 0);
+    DM_DECLARE_ARCHIVE_LOADER(ResourceProviderArchive, "archive", SetupArchiveLoader, InitializeArchiveLoader, FinalizeArchiveLoader);
 }
@@ -135,6 +135,7 @@ namespace dmResourceProviderFile
         loader->m_GetFileSize       = GetFileSize;
         loader->m_ReadFile          = ReadFile;
         loader->m_ReadFilePartial   = ReadFilePartial;
+        loader->m_ThreadSafe        = 1; // Each read opens its own file handle
     }
 
     DM_DECLARE_ARCHIVE_LOADER(ResourceProviderFile, "file", SetupArchiveLoader, 0, 0);
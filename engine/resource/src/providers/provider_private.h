@@ -16,6 +16,7 @@
 #define DM_RESOURCE_PROVIDER_PRIVATE_H
 
 #include "provider.h"
+#include <dlib/mutex.h>
 #include <dlib/uri.h>
 
 namespace dmResourceProvider
@@ -25,6 +26,7 @@ namespace dmResourceProvider
         const ArchiveLoader*    m_Loader;
         void*                   m_Internal; // Each provider may have its own type to handle the code efficiently
         dmURI::Parts            m_Uri;
+        dmMutex::HMutex         m_Mutex;    // Serializes the calls to loaders that aren't thread safe
     };
 
     struct ArchiveLoader
@@ -43,6 +45,10 @@ namespace dmResourceProvider
         FReadFilePartial        m_ReadFilePartial;
         FWriteFile              m_WriteFile;        // For writeable archives
 
+        // Set if the loader supports calls from several threads at the same time (e.g. streaming partial reads).
+        // Otherwise, the calls are serialized per archive.
+        uint8_t                 m_ThreadSafe : 1;
+
         void Verify();
 
         // private
@@ -29,6 +29,7 @@
 #include <dlib/lz4.h>
 #include <dlib/math.h>
 #include <dlib/memory.h>
+#include <dlib/mutex.h>
 #include <dlib/sys.h>
 #include <dlib/zip.h>
 
@@ -45,6 +46,9 @@ struct EntryInfo
     dmLiveUpdateDDF::ResourceEntry* m_ManifestEntry; // If it's a resource provided by the manifest
     uint32_t                        m_Size;          // Used when there is no resource entry
     uint32_t                        m_EntryIndex;
+    uint32_t                        m_RawSize;       // Size of the zip entry once inflated
+    uint32_t                        m_CompressedSize;// Size of the zip entry as stored in the archive
+    uint64_t                        m_HeaderOffset;  // Offset of the local file header in the archive
 };
 
 struct ZipProviderContext
@@ -60,6 +64,19 @@ struct ZipProviderContext
     // length of the mapped zip asset
     uint32_t                    m_ZipAssetLength;
 
+    // pointer to the mapped zip file
+    // will only be set when the archive was mapped from a file
+    void*                       m_ZipMap;
+    uint32_t                    m_ZipMapLength;
+
+    // the archive bytes, if they are mapped into memory (from either an asset or a file)
+    // entries are then read directly from memory, without going through the zip handle
+    const uint8_t*              m_ZipData;
+    uint32_t                    m_ZipDataLength;
+
+    // serializes the use of the zip handle, which isn't thread safe
+    dmMutex::HMutex             m_Mutex;
+
     dmResource::HManifest       m_Manifest;
     dmHashTable64<EntryInfo>    m_EntryMap; // url hash -> entry in the manifest
 };
@@ -85,6 +102,10 @@ static void DeleteZipArchiveInternal(dmResourceProvider::HArchiveInternal _archi
         dmZip::Close(archive->m_Zip);
     if (archive->m_ZipAsset)
         dmResource::UnmapAsset(archive->m_ZipAsset, archive->m_ZipAssetLength);
+    if (archive->m_ZipMap)
+        dmResource::UnmapFile(archive->m_ZipMap, archive->m_ZipMapLength);
+    if (archive->m_Mutex)
+        dmMutex::Delete(archive->m_Mutex);
     delete archive;
 }
 
@@ -116,6 +137,8 @@ static void CreateEntryMap(ZipProviderContext* archive)
         info.m_ManifestEntry = 0;
         dmZip::GetEntrySize(zip, &info.m_Size);
         dmZip::GetEntryIndex(zip, &info.m_EntryIndex);
+        dmZip::GetEntryLocation(zip, &info.m_HeaderOffset, &info.m_CompressedSize);
+        info.m_RawSize = info.m_Size;
 
         dmZip::CloseEntry(zip);
 
@@ -153,6 +176,9 @@ static void CreateEntryMap(ZipProviderContext* archive)
         // If we have file in manifest, get file size from there
         manifest_info.m_Size = entry->m_Size;
         manifest_info.m_EntryIndex = info->m_EntryIndex;
+        manifest_info.m_RawSize = info->m_RawSize;
+        manifest_info.m_CompressedSize = info->m_CompressedSize;
+        manifest_info.m_HeaderOffset = info->m_HeaderOffset;
         entry_map->Put(entry->m_UrlHash, manifest_info);
         DM_RESOURCE_DBG_LOG(3, "Added entry: %s %llx (%u bytes)\n", archive_path_buffer, archive_path_hash, manifest_info.m_Size);
     }
@@ -227,6 +253,9 @@ static dmResourceProvider::Result Mount(const dmURI::Parts* uri, dmResourceProvi
             return dmResourceProvider::RESULT_NOT_FOUND;
         }
 
+        archive->m_ZipData = (const uint8_t*)zip_map;
+        archive->m_ZipDataLength = archive->m_ZipAssetLength;
+
         dmZip::Result zr = dmZip::OpenStream((const char*)zip_map, archive->m_ZipAssetLength, &archive->m_Zip);
         if (dmZip::RESULT_OK != zr)
         {
@@ -250,7 +279,23 @@ static dmResourceProvider::Result Mount(const dmURI::Parts* uri, dmResourceProvi
             return dmResourceProvider::RESULT_NOT_FOUND;
         }
 
-        dmZip::Result zr = dmZip::Open(mount_path, &archive->m_Zip);
+        // Prefer mapping the file, so that entries can be read without going through the zip handle
+        dmResource::Result mr = dmResource::MapFile(mount_path, archive->m_ZipMap, archive->m_ZipMapLength);
+        if (dmResource::RESULT_OK != mr)
+            archive->m_ZipMap = 0;
+
+        dmZip::Result zr;
+        if (archive->m_ZipMap)
+        {
+            archive->m_ZipData = (const uint8_t*)archive->m_ZipMap;
+            archive->m_ZipDataLength = archive->m_ZipMapLength;
+            zr = dmZip::OpenStream((const char*)archive->m_ZipData, archive->m_ZipDataLength, &archive->m_Zip);
+        }
+        else
+        {
+            zr = dmZip::Open(mount_path, &archive->m_Zip);
+        }
+
         if (dmZip::RESULT_OK != zr)
         {
             dmLogError("Could not open zip file '%s' (%d)", mount_path, zr);
@@ -268,6 +313,8 @@ static dmResourceProvider::Result Mount(const dmURI::Parts* uri, dmResourceProvi
 
     CreateEntryMap(archive);
 
+    archive->m_Mutex = dmMutex::New();
+
     *out_archive = (dmResourceProvider::HArchiveInternal)archive;
     return dmResourceProvider::RESULT_OK;
 }
@@ -331,6 +378,48 @@ static dmResourceProvider::Result UnpackData(const char* path, dmLiveUpdateDDF::
     return dmResourceProvider::RESULT_OK;
 }
 
+// Returns the stored bytes of the entry, if the archive is mapped into memory
+static bool GetMappedEntryData(ZipProviderContext* archive, EntryInfo* entry, const uint8_t** data, bool* deflated)
+{
+    if (!archive->m_ZipData)
+        return false;
+    dmZip::Result zr = dmZip::GetStoredData(archive->m_ZipData, archive->m_ZipDataLength, entry->m_HeaderOffset, entry->m_CompressedSize, data, deflated);
+    return dmZip::RESULT_OK == zr;
+}
+
+// Gets the inflated entry data from memory
+static dmResourceProvider::Result CopyMappedEntryData(const uint8_t* data, bool deflated, EntryInfo* entry, uint8_t* buffer)
+{
+    if (!deflated)
+    {
+        memcpy(buffer, data, entry->m_RawSize);
+        return dmResourceProvider::RESULT_OK;
+    }
+    dmZip::Result zr = dmZip::Inflate(data, entry->m_CompressedSize, buffer, entry->m_RawSize);
+    return dmZip::RESULT_OK == zr ? dmResourceProvider::RESULT_OK : dmResourceProvider::RESULT_IO_ERROR;
+}
+
+static dmResourceProvider::Result ReadMappedFile(const char* path, const uint8_t* data, bool deflated, EntryInfo* entry, uint8_t* buffer)
+{
+    if (!entry->m_ManifestEntry)
+    {
+        // Regular files (i.e. no Liveupdate header)
+        return CopyMappedEntryData(data, deflated, entry, buffer);
+    }
+
+    // The data is decrypted in place, so encrypted entries need their own copy
+    bool encrypted = entry->m_ManifestEntry->m_Flags & dmLiveUpdateDDF::ENCRYPTED;
+    if (!deflated && !encrypted)
+        return UnpackData(path, entry->m_ManifestEntry, (uint8_t*)data, entry->m_RawSize, buffer);
+
+    uint8_t* raw_data = new uint8_t[entry->m_RawSize];
+    dmResourceProvider::Result result = CopyMappedEntryData(data, deflated, entry, raw_data);
+    if (dmResourceProvider::RESULT_OK == result)
+        result = UnpackData(path, entry->m_ManifestEntry, raw_data, entry->m_RawSize, buffer);
+    delete[] raw_data;
+    return result;
+}
+
 static dmResourceProvider::Result ReadFile(dmResourceProvider::HArchiveInternal _archive, dmhash_t path_hash, const char* path, uint8_t* buffer, uint32_t buffer_len)
 {
     ZipProviderContext* archive = (ZipProviderContext*)_archive;
@@ -341,6 +430,13 @@ static dmResourceProvider::Result ReadFile(dmResourceProvider::HArchiveInternal
     if (buffer_len < entry->m_Size)
         return dmResourceProvider::RESULT_INVAL_ERROR;
 
+    const uint8_t* data;
+    bool deflated;
+    if (GetMappedEntryData(archive, entry, &data, &deflated))
+        return ReadMappedFile(path, data, deflated, entry, buffer);
+
+    DM_MUTEX_SCOPED_LOCK(archive->m_Mutex);
+
     dmZip::Result zr = dmZip::OpenEntry(archive->m_Zip, entry->m_EntryIndex);
     if (dmZip::RESULT_OK != zr)
         return dmResourceProvider::RESULT_IO_ERROR;
@@ -372,6 +468,21 @@ static dmResourceProvider::Result ReadFilePartial(dmResourceProvider::HArchiveIn
     if (!entry)
         return dmResourceProvider::RESULT_NOT_FOUND;
 
+    // Stored entries are copied straight from memory. Deflated entries are streamed
+    // through the zip handle, which stops inflating once the range has been read
+    const uint8_t* data;
+    bool deflated;
+    if (GetMappedEntryData(archive, entry, &data, &deflated) && !deflated)
+    {
+        if (offset >= entry->m_RawSize)
+            return dmResourceProvider::RESULT_IO_ERROR;
+        *nread = dmMath::Min(size, entry->m_RawSize - offset);
+        memcpy(buffer, data + offset, *nread);
+        return dmResourceProvider::RESULT_OK;
+    }
+
+    DM_MUTEX_SCOPED_LOCK(archive->m_Mutex);
+
     dmZip::Result zr = dmZip::OpenEntry(archive->m_Zip, entry->m_EntryIndex);
     if (dmZip::RESULT_OK != zr)
         return dmResourceProvider::RESULT_IO_ERROR;
@@ -405,6 +516,7 @@ static void SetupArchiveLoaderHttpZip(dmResourceProvider::ArchiveLoader* loader)
     loader->m_GetFileSize       = GetFileSize;
     loader->m_ReadFile          = ReadFile;
     loader->m_ReadFilePartial   = ReadFilePartial;
+    loader->m_ThreadSafe        = 1; // Mapped entries are read from memory, the zip handle is guarded by a mutex
 }
 
 DM_DECLARE_ARCHIVE_LOADER(ResourceProviderZip, "zip", SetupArchiveLoaderHttpZip, 0, 0);
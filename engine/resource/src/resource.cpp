@@ -29,6 +29,7 @@
 #include <dlib/dstrings.h>
 #include <dlib/hash.h>
 #include <dlib/hashtable.h>
+#include <dlib/hashtable_flat.h>
 #include <dlib/jobsystem.h>
 #include <dlib/log.h>
 #include <dlib/math.h>
@@ -78,13 +79,18 @@ const uint32_t MAX_RESOURCE_TYPES = 128;
 struct ResourceFactory
 {
     // TODO: Arg... budget. Two hash-maps. Really necessary?
-    dmHashTable64<ResourceDescriptor>*           m_Resources;
+    dmHashTableFlat64<ResourceDescriptor>*       m_Resources;
     dmHashTable<uintptr_t, uint64_t>*            m_ResourceToHash;
     // Only valid if RESOURCE_FACTORY_FLAGS_RELOAD_SUPPORT is set
     // Used for reloading of resources
     dmHashTable64<const char*>*                  m_ResourceHashToFilename;
     // Only valid if RESOURCE_FACTORY_FLAGS_RELOAD_SUPPORT is set
     dmArray<ResourceReloadedCallbackPair>*       m_ResourceReloadedCallbacks;
+    // Only valid if RESOURCE_FACTORY_FLAGS_SHARE_CONTENT is set
+    // Content hash -> path hash of the resource loaded with that content
+    dmHashTable64<dmhash_t>*                     m_ContentToResource;
+    // Path hash -> the resource it shares content with, and the next alias of that resource
+    dmHashTable64<ResourceAlias>*                m_ResourceAliases;
     ResourceType                                 m_ResourceTypes[MAX_RESOURCE_TYPES];
     uint32_t                                     m_ResourceTypesCount;
 
@@ -114,6 +120,10 @@ struct ResourceFactory
     // Streaming chunked reading support
     HJobContext                                  m_JobThreadContext;
 
+    // Recorded prefetch lists, see NewFactoryParams::m_PrefetchRecordDir
+    char*                                        m_PrefetchRecordDir;
+    bool                                         m_PrefetchEnabled;
+
     // Serial version that increases per resource insertion
     uint16_t                                     m_Version;
 };
@@ -129,6 +139,7 @@ const char* BUNDLE_MANIFEST_FILENAME            = "game.dmanifest";
 const char* BUNDLE_INDEX_FILENAME               = "game.arci";
 const char* BUNDLE_DATA_FILENAME                = "game.arcd";
 const char* MAX_RESOURCES_KEY = "resource.max_resources";
+const char* PREFETCH_PATH_PREFIX                = "/_prefetch";
 
 
 static inline uint16_t IncreaseVersion(HResourceFactory factory)
@@ -243,10 +254,16 @@ HFactory NewFactory(NewFactoryParams* params, const char* uri)
     dmResourceProvider::ArchiveLoaderParams archive_loader_params;
     archive_loader_params.m_Factory = factory;
     archive_loader_params.m_HttpCache = params->m_HttpCache;
+    archive_loader_params.m_JobContext = params->m_JobThreadContext;
+    archive_loader_params.m_ArchiveVerifyMode = params->m_ArchiveVerifyMode;
+    archive_loader_params.m_ArchiveVerifyRecordDir = params->m_ArchiveVerifyRecordDir;
     dmResourceProvider::InitializeLoaders(&archive_loader_params);
 
     factory->m_JobThreadContext = params->m_JobThreadContext;
 
+    factory->m_PrefetchRecordDir = params->m_PrefetchRecordDir ? strdup(params->m_PrefetchRecordDir) : 0;
+    factory->m_PrefetchEnabled = (params->m_Flags & RESOURCE_FACTORY_FLAGS_PREFETCH) != 0;
+
     int num_mounted = 0;
     bool mount_unsupported = false;
     for (uint32_t i = 0; i < DM_ARRAY_SIZE(type_pairs); ++i)
@@ -305,7 +322,7 @@ HFactory NewFactory(NewFactoryParams* params, const char* uri)
 
     factory->m_ResourceTypesCount = 0;
 
-    factory->m_Resources = new dmHashTable64<ResourceDescriptor>();
+    factory->m_Resources = new dmHashTableFlat64<ResourceDescriptor>();
     factory->m_Resources->OffsetCapacity(params->m_MaxResources);
 
     factory->m_ResourceToHash = new dmHashTable<uintptr_t, uint64_t>();
@@ -325,6 +342,12 @@ HFactory NewFactory(NewFactoryParams* params, const char* uri)
         factory->m_ResourceReloadedCallbacks = 0;
     }
 
+    if (params->m_Flags & RESOURCE_FACTORY_FLAGS_SHARE_CONTENT)
+    {
+        factory->m_ContentToResource = new dmHashTable64<dmhash_t>();
+        factory->m_ResourceAliases = new dmHashTable64<ResourceAlias>();
+    }
+
     factory->m_BuiltinMount = 0;
     if (params->m_ArchiveManifest.m_Size && params->m_ArchiveIndex.m_Size && params->m_ArchiveData.m_Size)
     {
@@ -352,6 +375,9 @@ void DeleteFactory(HFactory factory)
     dmResourceProvider::ArchiveLoaderParams archive_loader_params;
     archive_loader_params.m_Factory = factory;
     archive_loader_params.m_HttpCache = 0;
+    archive_loader_params.m_JobContext = 0;
+    archive_loader_params.m_ArchiveVerifyMode = ARCHIVE_VERIFY_MODE_NONE;
+    archive_loader_params.m_ArchiveVerifyRecordDir = 0;
     dmResourceProvider::FinalizeLoaders(&archive_loader_params);
 
     if (factory->m_Socket)
@@ -375,6 +401,9 @@ void DeleteFactory(HFactory factory)
         delete factory->m_ResourceHashToFilename;
     if (factory->m_ResourceReloadedCallbacks)
         delete factory->m_ResourceReloadedCallbacks;
+    delete factory->m_ContentToResource;
+    delete factory->m_ResourceAliases;
+    free(factory->m_PrefetchRecordDir);
     delete factory;
 }
 
@@ -804,12 +833,102 @@ static Result DoCreateResource(HFactory factory, ResourceType* resource_type, co
     }
 }
 
+// Gets a loaded resource, also when the path shares the content of another path
+static ResourceDescriptor* GetDescriptorInternal(HFactory factory, dmhash_t canonical_path_hash)
+{
+    ResourceDescriptor* rd = factory->m_Resources->Get(canonical_path_hash);
+    if (!rd && factory->m_ResourceAliases)
+    {
+        ResourceAlias* alias = factory->m_ResourceAliases->Get(canonical_path_hash);
+        if (alias)
+            rd = factory->m_Resources->Get(alias->m_OwnerHash);
+    }
+    return rd;
+}
+
+template <typename T>
+static void AddToTable(dmHashTable64<T>* table, dmhash_t key, const T& value)
+{
+    if (table->Full())
+    {
+        table->OffsetCapacity(64);
+    }
+    table->Put(key, value);
+}
+
+ResourceDescriptor* FindByContent(HFactory factory, const char* canonical_path, dmhash_t canonical_path_hash, HResourceType type)
+{
+    if (!factory->m_ContentToResource || factory->m_ContentToResource->Empty())
+        return 0;
+
+    dmhash_t content_hash;
+    if (dmResourceMounts::GetResourceContentHash(factory->m_Mounts, canonical_path_hash, canonical_path, &content_hash) != RESULT_OK)
+        return 0;
+
+    dmhash_t* owner_hash = factory->m_ContentToResource->Get(content_hash);
+    if (!owner_hash)
+        return 0;
+
+    // The same bytes may be interpreted differently by different resource types
+    ResourceDescriptor* rd = factory->m_Resources->Get(*owner_hash);
+    if (!rd || rd->m_ResourceType != type)
+        return 0;
+
+    // Link the alias into the list of the resource, so that they can be removed together
+    ResourceAlias alias;
+    alias.m_OwnerHash = *owner_hash;
+    alias.m_NextAliasHash = rd->m_FirstAliasHash;
+    AddToTable(factory->m_ResourceAliases, canonical_path_hash, alias);
+    rd->m_FirstAliasHash = canonical_path_hash;
+    DM_RESOURCE_DBG_LOG(2, "Sharing content of %s with " DM_HASH_FMT "\n", canonical_path, *owner_hash);
+    return rd;
+}
+
+void RegisterContent(HFactory factory, const char* canonical_path, dmhash_t canonical_path_hash)
+{
+    if (!factory->m_ContentToResource)
+        return;
+
+    ResourceDescriptor* rd = factory->m_Resources->Get(canonical_path_hash);
+    if (!rd)
+        return;
+
+    dmhash_t content_hash;
+    if (dmResourceMounts::GetResourceContentHash(factory->m_Mounts, canonical_path_hash, canonical_path, &content_hash) != RESULT_OK)
+        return;
+
+    // Keep the first resource loaded with the content
+    if (factory->m_ContentToResource->Get(content_hash))
+        return;
+
+    AddToTable(factory->m_ContentToResource, content_hash, canonical_path_hash);
+    rd->m_ContentHash = content_hash;
+}
+
+// Called when a resource with shared content is destroyed
+static void UnregisterContent(HFactory factory, dmhash_t canonical_path_hash, const ResourceDescriptor* rd)
+{
+    dmhash_t* owner_hash = factory->m_ContentToResource->Get(rd->m_ContentHash);
+    if (owner_hash && *owner_hash == canonical_path_hash)
+        factory->m_ContentToResource->Erase(rd->m_ContentHash);
+
+    dmhash_t alias_hash = rd->m_FirstAliasHash;
+    while (alias_hash)
+    {
+        ResourceAlias* alias = factory->m_ResourceAliases->Get(alias_hash);
+        assert(alias && alias->m_OwnerHash == canonical_path_hash);
+        dmhash_t next_alias_hash = alias->m_NextAliasHash;
+        factory->m_ResourceAliases->Erase(alias_hash);
+        alias_hash = next_alias_hash;
+    }
+}
+
 static Result CheckAndGetResourceFromPath(HFactory factory, dmhash_t canonical_path_hash, void** resource_out)
 {
     *resource_out = 0;
 
     // Try to get from already loaded resources
-    ResourceDescriptor* rd = factory->m_Resources->Get(canonical_path_hash);
+    ResourceDescriptor* rd = GetDescriptorInternal(factory, canonical_path_hash);
     if (rd)
     {
         assert(factory->m_ResourceToHash->Get((uintptr_t) rd->m_Resource));
@@ -883,6 +1002,14 @@ static Result CreateAndLoadResource(HFactory factory, const char* path, void** r
         return RESULT_OK;
     }
 
+    ResourceDescriptor* shared = FindByContent(factory, canonical_path, canonical_path_hash, resource_type);
+    if (shared)
+    {
+        shared->m_ReferenceCount++;
+        *resource = shared->m_Resource;
+        return RESULT_OK;
+    }
+
     uint32_t preload_size = RESOURCE_INVALID_PRELOAD_SIZE;
     if (ResourceTypeIsStreaming(resource_type))
     {
@@ -899,8 +1026,13 @@ static Result CreateAndLoadResource(HFactory factory, const char* path, void** r
     }
     assert(buffer == factory->m_Buffer.Begin());
 
-    return DoCreateResource(factory, resource_type, path, canonical_path, canonical_path_hash,
+    result = DoCreateResource(factory, resource_type, path, canonical_path, canonical_path_hash,
                                 buffer, buffer_size, resource_size, resource);
+    if (result == RESULT_OK)
+    {
+        RegisterContent(factory, canonical_path, canonical_path_hash);
+    }
+    return result;
 }
 
 Result CreateResourcePartial(HFactory factory, HResourceType type, const char* name, void* data, uint32_t data_size, uint32_t file_size, void** resource)
@@ -1005,7 +1137,7 @@ Result Get(HFactory factory, const char* path, void** resource)
 
 ResourceDescriptor* FindByHash(HFactory factory, uint64_t canonical_path_hash)
 {
-    return factory->m_Resources->Get(canonical_path_hash);
+    return GetDescriptorInternal(factory, canonical_path_hash);
 }
 
 Result GetWithExt(HFactory factory, dmhash_t path_hash, dmhash_t ext_hash, void** resource)
@@ -1379,7 +1511,7 @@ Result GetExtensionFromType(HFactory factory, HResourceType type, const char** e
 
 Result GetDescriptorByHash(HFactory factory, dmhash_t path_hash, HResourceDescriptor* descriptor)
 {
-    ResourceDescriptor* tmp_descriptor = factory->m_Resources->Get(path_hash);
+    ResourceDescriptor* tmp_descriptor = GetDescriptorInternal(factory, path_hash);
     if (tmp_descriptor)
     {
         *descriptor = tmp_descriptor;
@@ -1399,7 +1531,7 @@ Result GetDescriptor(HFactory factory, const char* name, HResourceDescriptor* de
 
 Result GetDescriptorWithExt(HFactory factory, uint64_t hashed_name, const uint64_t* exts, uint32_t ext_count, HResourceDescriptor* descriptor)
 {
-    ResourceDescriptor* tmp_descriptor = factory->m_Resources->Get(hashed_name);
+    ResourceDescriptor* tmp_descriptor = GetDescriptorInternal(factory, hashed_name);
     if (!tmp_descriptor) {
         return RESULT_NOT_LOADED;
     }
@@ -1462,7 +1594,7 @@ uint32_t GetRefCount(HFactory factory, void* resource)
 
 uint32_t GetRefCount(HFactory factory, dmhash_t identifier)
 {
-    ResourceDescriptor* rd = factory->m_Resources->Get(identifier);
+    ResourceDescriptor* rd = GetDescriptorInternal(factory, identifier);
     if(!rd)
         return 0;
     return rd->m_ReferenceCount;
@@ -1493,6 +1625,11 @@ void Release(HFactory factory, void* resource)
         params.m_Resource   = rd;
         resource_type->m_DestroyFunction(&params);
 
+        if (rd->m_ContentHash)
+        {
+            UnregisterContent(factory, *resource_hash, rd);
+        }
+
         factory->m_ResourceToHash->Erase((uintptr_t) resource);
         factory->m_Resources->Erase(*resource_hash);
         if (factory->m_ResourceHashToFilename)
@@ -1570,6 +1707,16 @@ HJobContext GetJobThread(const dmResource::HFactory factory)
     return factory->m_JobThreadContext;
 }
 
+const char* GetPrefetchRecordDir(HFactory factory)
+{
+    return factory->m_PrefetchRecordDir;
+}
+
+bool IsPrefetchEnabled(HFactory factory)
+{
+    return factory->m_PrefetchEnabled;
+}
+
 dmMutex::HMutex GetLoadMutex(const dmResource::HFactory factory)
 {
     return factory->m_LoadMutex;
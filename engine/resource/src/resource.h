@@ -71,6 +71,28 @@ namespace dmResource
      */
     #define RESOURCE_FACTORY_FLAGS_RELOAD_SUPPORT (1 << 0)
 
+    /**
+     * Replay recorded prefetch lists when preloading. See NewFactoryParams::m_PrefetchRecordDir
+     */
+    #define RESOURCE_FACTORY_FLAGS_PREFETCH (1 << 1)
+
+    /**
+     * Share a single resource between paths that have identical content, as given by the content hashes
+     * in the manifests. A path that is loaded while a resource of the same type and content is alive
+     * returns that resource, and shares its reference count.
+     */
+    #define RESOURCE_FACTORY_FLAGS_SHARE_CONTENT (1 << 2)
+
+    /**
+     * How the content of the bundled archive is verified against its content hashes
+     */
+    enum ArchiveVerifyMode
+    {
+        ARCHIVE_VERIFY_MODE_NONE = 0, // No verification
+        ARCHIVE_VERIFY_MODE_FULL = 1, // All entries are verified when the archive is mounted
+        ARCHIVE_VERIFY_MODE_LAZY = 2, // Each entry is verified the first time it is read
+    };
+
     typedef dmArray<char> LoadBufferType;
     typedef HResourcePreloader HPreloader;
 
@@ -134,6 +156,16 @@ namespace dmResource
 
         HJobContext             m_JobThreadContext;
 
+        /// How the bundled archive is verified. Default is ARCHIVE_VERIFY_MODE_NONE
+        ArchiveVerifyMode       m_ArchiveVerifyMode;
+
+        /// Directory where the result of a full verification is cached. If 0, the archive is verified on each start
+        const char*             m_ArchiveVerifyRecordDir;
+
+        /// Directory where each preloader writes the list of resources it loaded, as <dir>/_prefetch/<root path>.prefetch
+        /// The lists are replayed by later preloads if RESOURCE_FACTORY_FLAGS_PREFETCH is set. If 0, nothing is recorded
+        const char*             m_PrefetchRecordDir;
+
         NewFactoryParams()
         {
             SetDefaultNewFactoryParams(this);
@@ -31,6 +31,15 @@
 #include <dlib/path.h>
 #include <dlib/sys.h>
 
+#if defined(_WIN32)
+    #include <dlib/safe_windows.h>
+    #include <io.h>
+#elif !defined(DM_PLATFORM_VENDOR)
+    #include <errno.h>
+    #include <unistd.h>
+    #define DM_RESOURCE_ARCHIVE_PREAD
+#endif
+
 #define DEBUG_LOG 1
 #if defined(DEBUG_LOG)
     #define LOG(...) dmLogInfo(__VA_ARGS__)
@@ -296,6 +305,62 @@ namespace dmResourceArchive
         }
     }
 
+    bool CanReadEntryConcurrently()
+    {
+#if defined(_WIN32) || defined(DM_RESOURCE_ARCHIVE_PREAD)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Reads at an absolute offset without using the (shared) file position of the FILE handle,
+    // so that several threads may read from the same archive file at the same time
+    static bool ReadFileAt(FILE* file, uint32_t offset, uint32_t size, void* buffer, uint32_t* nread)
+    {
+#if defined(_WIN32)
+        HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+        OVERLAPPED overlapped;
+        memset(&overlapped, 0, sizeof(overlapped));
+        overlapped.Offset = offset;
+        DWORD bytes_read = 0;
+        if (!::ReadFile(handle, buffer, size, &bytes_read, &overlapped) && GetLastError() != ERROR_HANDLE_EOF)
+        {
+            return false;
+        }
+        *nread = (uint32_t)bytes_read;
+        return true;
+#elif defined(DM_RESOURCE_ARCHIVE_PREAD)
+        int fd = fileno(file);
+        uint32_t total = 0;
+        while (total < size)
+        {
+            ssize_t r = pread(fd, (uint8_t*)buffer + total, size - total, (off_t)offset + total);
+            if (r < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            if (r == 0)
+                break; // EOF
+            total += (uint32_t)r;
+        }
+        *nread = total;
+        return true;
+#else
+        // The caller must serialize the reads (see CanReadEntryConcurrently())
+        fseek(file, offset, SEEK_SET);
+        size_t nmemb = fread(buffer, 1, size, file);
+        if (ferror(file))
+        {
+            return false;
+        }
+        *nread = (uint32_t)nmemb;
+        return true;
+#endif
+    }
+
     Result ReadEntry(HArchiveIndexContainer archive, const EntryData* entry, void* buffer)
     {
         // We always assume it's in Host format, since it may arrive from memory mapped data
@@ -318,7 +383,7 @@ namespace dmResourceArchive
         {
             // we need to read from the file on disc
             FILE* resource_file = afi->m_FileResourceData;
-            fseek(resource_file, resource_offset, SEEK_SET);
+            uint32_t nread = 0;
 
             Result result = dmResourceArchive::RESULT_OK;
             // Note, we don't need to check if it's encrypted here, as it's guaranteed to
@@ -327,7 +392,7 @@ namespace dmResourceArchive
             if (!compressed)
             {
                 // we can read directly to the output buffer
-                if (fread(buffer, 1, size, resource_file) != size)
+                if (!ReadFileAt(resource_file, resource_offset, size, buffer, &nread) || nread != size)
                 {
                     result = dmResourceArchive::RESULT_IO_ERROR;
                 }
@@ -338,7 +403,7 @@ namespace dmResourceArchive
             {
                 // We need a temp buffer to read to, since we can't decompress to the same buffer
                 temp_data = new uint8_t[compressed_size];
-                if (fread(temp_data, 1, compressed_size, resource_file) != compressed_size)
+                if (!ReadFileAt(resource_file, resource_offset, compressed_size, temp_data, &nread) || nread != compressed_size)
                 {
                     result = RESULT_IO_ERROR;
                 }
@@ -438,17 +503,9 @@ namespace dmResourceArchive
 
         if (!afi->m_IsMemMapped)
         {
-            // we need to read from the file on disc
-            FILE* resource_file = afi->m_FileResourceData;
-            fseek(resource_file, resource_offset+offset, SEEK_SET);
-
-            // we can read directly to the output buffer
-            size_t nmemb = fread(buffer, 1, size, resource_file);
-            if (!ferror(resource_file))
+            // we need to read from the file on disc, directly to the output buffer
+            if (!ReadFileAt(afi->m_FileResourceData, resource_offset+offset, size, buffer, nread))
             {
-                *nread = (uint32_t)nmemb;
-            }
-            else {
                 result = RESULT_IO_ERROR;
             }
 
@@ -464,6 +521,41 @@ namespace dmResourceArchive
         return dmResourceArchive::RESULT_OK;
     }
 
+    uint32_t GetEntryStoredSize(const EntryData* entry)
+    {
+        const uint32_t flags = dmEndian::ToNetwork(entry->m_Flags);
+        if (flags & dmResourceArchive::ENTRY_FLAG_COMPRESSED)
+        {
+            return dmEndian::ToNetwork(entry->m_ResourceCompressedSize);
+        }
+        return dmEndian::ToNetwork(entry->m_ResourceSize);
+    }
+
+    Result ReadEntryRaw(HArchiveIndexContainer archive, const EntryData* entry, void* buffer)
+    {
+        const uint32_t resource_offset  = dmEndian::ToNetwork(entry->m_ResourceDataOffset);
+        const uint32_t size             = GetEntryStoredSize(entry);
+
+        const ArchiveFileIndex* afi = archive->m_ArchiveFileIndex;
+        if (!afi->m_IsMemMapped)
+        {
+            uint32_t nread = 0;
+            if (!ReadFileAt(afi->m_FileResourceData, resource_offset, size, buffer, &nread) || nread != size)
+            {
+                return RESULT_IO_ERROR;
+            }
+        }
+        else
+        {
+            if ((uint64_t)resource_offset + size > afi->m_ResourceSize)
+            {
+                return RESULT_INVALID_DATA;
+            }
+            memcpy(buffer, afi->m_ResourceData + resource_offset, size);
+        }
+        return RESULT_OK;
+    }
+
     void SetNewArchiveIndex(HArchiveIndexContainer archive_container, HArchiveIndex new_index, bool mem_mapped)
     {
         if (!archive_container->m_IsMemMapped)
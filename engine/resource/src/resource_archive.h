@@ -224,6 +224,31 @@ namespace dmResourceArchive
      */
     Result ReadEntryPartial(HArchiveIndexContainer archive, const EntryData* entry, uint32_t offset, uint32_t size, void* buffer, uint32_t* nread);
 
+    /**
+     * Get the size of the resource as it is stored in the archive (i.e. the compressed size if it's compressed)
+     * @param entry entry data
+     * @return the stored size in bytes
+     */
+    uint32_t GetEntryStoredSize(const EntryData* entry);
+
+    /**
+     * Read the resource as it is stored in the archive, without decrypting or decompressing it.
+     * This is the data that the content hash of the entry is calculated from.
+     * @param archive archive index handle
+     * @param entry entry data
+     * @param buffer buffer to load to. Must be at least GetEntryStoredSize() bytes
+     * @return RESULT_OK on success
+     */
+    Result ReadEntryRaw(HArchiveIndexContainer archive, const EntryData* entry, void* buffer);
+
+    /**
+     * Check if ReadEntry(), ReadEntryPartial() and ReadEntryRaw() may be called from several threads at the same time.
+     * This is the case on platforms where we can read at an absolute file offset (e.g. pread),
+     * leaving the shared file position untouched.
+     * @return true if the reads are thread safe
+     */
+    bool CanReadEntryConcurrently();
+
     /**
      * Delete archive index. Only required for archives created with LoadArchive function
      * @param archive archive index handle
@@ -16,14 +16,27 @@
 
 #include <dlib/static_assert.h>
 #include <dlib/array.h>
+#include <dlib/atomic.h>
 #include <dlib/double_linked_list.h>
 #include <dlib/hash.h>
 #include <dlib/log.h>
+#include <dlib/math.h>
+#include <dlib/mutex.h>
+#include <dlib/profile.h>
 
 #include <stdio.h>   // printf
 #include <stddef.h>  // offsetof
 #include <algorithm> // lower_bound
 
+DM_PROPERTY_GROUP(rmtp_ChunkCache, "Resource Chunk Cache", 0);
+DM_PROPERTY_U32(rmtp_ChunkCacheHits, 0, PROFILE_PROPERTY_FRAME_RESET, "# chunk lookups found in the cache", &rmtp_ChunkCache);
+DM_PROPERTY_U32(rmtp_ChunkCacheMisses, 0, PROFILE_PROPERTY_FRAME_RESET, "# chunk lookups not found in the cache", &rmtp_ChunkCache);
+DM_PROPERTY_U32(rmtp_ChunkCacheEvictions, 0, PROFILE_PROPERTY_FRAME_RESET, "# chunks evicted to make room", &rmtp_ChunkCache);
+DM_PROPERTY_U32(rmtp_ChunkCacheUsed, 0, PROFILE_PROPERTY_NONE, "size of cached chunks in bytes", &rmtp_ChunkCache);
+
+// The chunks of a file always end up in the same shard, as we key the shards on the path hash
+static const uint32_t CHUNK_CACHE_NUM_SHARDS = 8;
+
 struct ResourceInternalDataChunk
 {
     dmDoubleLinkedList::ListNode m_ListNode; // must be first in the struct
@@ -31,6 +44,7 @@ struct ResourceInternalDataChunk
     dmhash_t m_PathHash;
     uint8_t* m_Data;
     uint32_t m_Size;        // Size of data
+    uint32_t m_LastUsed;    // Cache tick of the last access. Used for finding the least recently used chunk of all shards
     uint32_t m_Offset:31;   // Offset into the file
     uint32_t m_NoEvict:1;   // Set if the chunk mustn't be evicted
 };
@@ -39,34 +53,65 @@ struct ResourceInternalDataChunk
     DM_STATIC_ASSERT(offsetof(ResourceInternalDataChunk, m_ListNode) == 0, "m_ListNode must be first in struct!");
 #endif
 
-struct ResourceChunkCache
+struct ResourceChunkCacheShard
 {
+    dmMutex::HMutex                     m_Mutex;
     // The array is sorted on (path_hash, offset)
     dmArray<ResourceInternalDataChunk*> m_Chunks;
+    dmDoubleLinkedList::List            m_LRU;             // head is MRU, tail is LRU
+    dmDoubleLinkedList::List            m_LRUNoEvict;      // head is MRU, tail is LRU
+};
 
+struct ResourceChunkCache
+{
+    ResourceChunkCacheShard    m_Shards[CHUNK_CACHE_NUM_SHARDS];
     uint32_t                   m_CacheSize;       // The cache size for all streaming sounds
-    uint32_t                   m_CacheSizeUsed;   // The amount of cache currently used
-    dmDoubleLinkedList::List   m_LRU;             // head is MRU, tail is LRU
-    dmDoubleLinkedList::List   m_LRUNoEvict;      // head is MRU, tail is LRU
+    int32_atomic_t             m_CacheSizeUsed;   // The amount of cache currently used
+    int32_atomic_t             m_Tick;            // Increased on each access
+    int32_atomic_t             m_Hits;
+    int32_atomic_t             m_Misses;
+    int32_atomic_t             m_Evictions;
 };
 
+static inline ResourceChunkCacheShard* GetShard(ResourceChunkCache* cache, dmhash_t path_hash)
+{
+    return &cache->m_Shards[(uint32_t)(path_hash ^ (path_hash >> 32)) & (CHUNK_CACHE_NUM_SHARDS - 1)];
+}
+
+static inline uint32_t NextTick(ResourceChunkCache* cache)
+{
+    return (uint32_t)dmAtomicIncrement32(&cache->m_Tick);
+}
+
+// Reserves the memory for a new chunk. Returns false if it doesn't fit
+static bool ReserveMemory(ResourceChunkCache* cache, uint32_t size)
+{
+    while (true)
+    {
+        int32_t used = dmAtomicGet32(&cache->m_CacheSizeUsed);
+        if (size > (cache->m_CacheSize - (uint32_t)used))
+            return false;
+        if (dmAtomicCompareStore32(&cache->m_CacheSizeUsed, used + (int32_t)size, used) == used)
+            return true;
+    }
+}
+
 static ResourceInternalDataChunk* AllocChunk(ResourceChunkCache* cache, dmhash_t path_hash, uint8_t* data, uint32_t data_size, uint32_t offset, int flags)
 {
     ResourceInternalDataChunk* chunk = new ResourceInternalDataChunk;
     chunk->m_PathHash = path_hash;
     chunk->m_Offset = offset;
     chunk->m_Size = data_size;
+    chunk->m_LastUsed = NextTick(cache);
     chunk->m_NoEvict = flags & RESOURCE_CHUNK_CACHE_NO_EVICT?1:0;
     chunk->m_Data = new uint8_t[data_size];
     memcpy(chunk->m_Data, data, data_size);
-
-    cache->m_CacheSizeUsed += data_size;
     return chunk;
 }
 
 static void FreeChunk(ResourceChunkCache* cache, ResourceInternalDataChunk* chunk)
 {
-    cache->m_CacheSizeUsed -= chunk->m_Size;
+    dmAtomicSub32(&cache->m_CacheSizeUsed, (int32_t)chunk->m_Size);
     delete[] chunk->m_Data;
     delete chunk;
 }
@@ -88,9 +133,9 @@ static int ChunkComparePathOffsetFn(const void* a, const void* b)
     return (int)offseta - (int)offsetb;
 }
 
-static void SortChunksOnPathAndOffset(ResourceChunkCache* cache)
+static void SortChunksOnPathAndOffset(ResourceChunkCacheShard* shard)
 {
-    qsort(cache->m_Chunks.Begin(), cache->m_Chunks.Size(), sizeof(cache->m_Chunks[0]), ChunkComparePathOffsetFn);
+    qsort(shard->m_Chunks.Begin(), shard->m_Chunks.Size(), sizeof(shard->m_Chunks[0]), ChunkComparePathOffsetFn);
 }
 
 static bool ChunkComparePathFn(const ResourceInternalDataChunk* chunk, dmhash_t path_hash)
@@ -98,19 +143,19 @@ static bool ChunkComparePathFn(const ResourceInternalDataChunk* chunk, dmhash_t
     return chunk->m_PathHash < path_hash;
 }
 
-static void PrintChunk(ResourceChunkCache* cache, ResourceInternalDataChunk* chunk)
+static void PrintChunk(ResourceInternalDataChunk* chunk)
 {
-    printf("  offset: %8u  size: %8u  data: %p  noevict: %s  file: '%s'\n", chunk->m_Offset, chunk->m_Size, chunk->m_Data, chunk->m_NoEvict?"true":"false", dmHashReverseSafe64(chunk->m_PathHash));
+    printf("  offset: %8u  size: %8u  data: %p  noevict: %s  used: %u  file: '%s'\n", chunk->m_Offset, chunk->m_Size, chunk->m_Data, chunk->m_NoEvict?"true":"false", chunk->m_LastUsed, dmHashReverseSafe64(chunk->m_PathHash));
 }
 
-static void PrintList(ResourceChunkCache* cache, dmDoubleLinkedList::List* list)
+static void PrintList(dmDoubleLinkedList::List* list)
 {
     dmDoubleLinkedList::ListNode* item = list->m_Head.m_Next;
     dmDoubleLinkedList::ListNode* end = &list->m_Tail;
     while (item != end)
     {
         ResourceInternalDataChunk* chunk = (ResourceInternalDataChunk*)item;
-        PrintChunk(cache, chunk);
+        PrintChunk(chunk);
 
         item = item->m_Next;
     }
@@ -118,18 +163,27 @@ static void PrintList(ResourceChunkCache* cache, dmDoubleLinkedList::List* list)
 
 void ResourceChunkCacheDebugChunks(ResourceChunkCache* cache)
 {
-    uint32_t num_chunks = cache->m_Chunks.Size();
-    printf("CACHE: size: %u  used: %u\n", cache->m_CacheSize, cache->m_CacheSizeUsed);
-    printf("NUM CHUNKS: %u\n", num_chunks);
-    for (uint32_t i = 0; i < num_chunks; ++i)
+    printf("CACHE: size: %u  used: %u\n", cache->m_CacheSize, (uint32_t)dmAtomicGet32(&cache->m_CacheSizeUsed));
+    printf("NUM CHUNKS: %u\n", ResourceChunkCacheGetNumChunks(cache));
+    for (uint32_t s = 0; s < CHUNK_CACHE_NUM_SHARDS; ++s)
     {
-        ResourceInternalDataChunk* chunk = cache->m_Chunks[i];
-        PrintChunk(cache, chunk);
+        ResourceChunkCacheShard* shard = &cache->m_Shards[s];
+        DM_MUTEX_SCOPED_LOCK(shard->m_Mutex);
+
+        uint32_t num_chunks = shard->m_Chunks.Size();
+        if (num_chunks == 0)
+            continue;
+
+        printf("SHARD %u:\n", s);
+        for (uint32_t i = 0; i < num_chunks; ++i)
+        {
+            PrintChunk(shard->m_Chunks[i]);
+        }
+        printf("LRU:\n");
+        PrintList(&shard->m_LRU);
+        printf("LRU (no evict):\n");
+        PrintList(&shard->m_LRUNoEvict);
     }
-    printf("LRU:\n");
-    PrintList(cache, &cache->m_LRU);
-    printf("LRU (no evict):\n");
-    PrintList(cache, &cache->m_LRUNoEvict);
 }
 
 // **********************************************************************************
@@ -139,51 +193,69 @@ HResourceChunkCache ResourceChunkCacheCreate(uint32_t max_memory)
     ResourceChunkCache* cache = new ResourceChunkCache;
     cache->m_CacheSize = max_memory;
     cache->m_CacheSizeUsed = 0;
+    cache->m_Tick = 0;
+    cache->m_Hits = 0;
+    cache->m_Misses = 0;
+    cache->m_Evictions = 0;
 
-    ListInit(&cache->m_LRU);
-    ListInit(&cache->m_LRUNoEvict);
+    for (uint32_t s = 0; s < CHUNK_CACHE_NUM_SHARDS; ++s)
+    {
+        ResourceChunkCacheShard* shard = &cache->m_Shards[s];
+        shard->m_Mutex = dmMutex::New();
+        ListInit(&shard->m_LRU);
+        ListInit(&shard->m_LRUNoEvict);
+    }
     return cache;
 }
 
 void ResourceChunkCacheDestroy(HResourceChunkCache cache)
 {
-    uint32_t num_chunks = cache->m_Chunks.Size();
-    for (uint32_t i = 0; i < num_chunks; ++i)
+    for (uint32_t s = 0; s < CHUNK_CACHE_NUM_SHARDS; ++s)
     {
-        FreeChunk(cache, cache->m_Chunks[i]);
+        ResourceChunkCacheShard* shard = &cache->m_Shards[s];
+        uint32_t num_chunks = shard->m_Chunks.Size();
+        for (uint32_t i = 0; i < num_chunks; ++i)
+        {
+            FreeChunk(cache, shard->m_Chunks[i]);
+        }
+        dmMutex::Delete(shard->m_Mutex);
     }
+    DM_PROPERTY_SET_U32(rmtp_ChunkCacheUsed, 0);
     delete cache;
 }
 
 // **********************************************************************************
 
-static ResourceInternalDataChunk* ResourceChunkCacheFind(ResourceChunkCache* cache, dmhash_t path_hash, uint32_t offset)
+// Assumes the shard lock is held
+static ResourceInternalDataChunk* FindChunk(ResourceChunkCacheShard* shard, dmhash_t path_hash, uint32_t offset)
 {
-    ResourceInternalDataChunk** begin = cache->m_Chunks.Begin();
-    ResourceInternalDataChunk** end = cache->m_Chunks.End();
+    ResourceInternalDataChunk** begin = shard->m_Chunks.Begin();
+    ResourceInternalDataChunk** end = shard->m_Chunks.End();
     ResourceInternalDataChunk** lbound = std::lower_bound(begin, end, path_hash, ChunkComparePathFn);
-    if (lbound != end)
+    for (ResourceInternalDataChunk** it = lbound; it != end; ++it)
     {
-        ResourceInternalDataChunk* chunk = *lbound;
-        if (chunk->m_PathHash == path_hash && chunk->m_Offset == offset)
+        ResourceInternalDataChunk* chunk = *it;
+        if (chunk->m_PathHash != path_hash || offset < chunk->m_Offset)
+            break;
+        if (chunk->m_Offset == offset)
             return chunk;
     }
     return 0;
 }
 
-static uint32_t ResourceChunkCacheFindIndex(ResourceChunkCache* cache, ResourceInternalDataChunk* _chunk)
+static uint32_t FindChunkIndex(ResourceChunkCacheShard* shard, ResourceInternalDataChunk* _chunk)
 {
     dmhash_t path_hash = _chunk->m_PathHash;
     uint32_t offset = _chunk->m_Offset;
 
-    ResourceInternalDataChunk** begin = cache->m_Chunks.Begin();
-    ResourceInternalDataChunk** end = cache->m_Chunks.End();
+    ResourceInternalDataChunk** begin = shard->m_Chunks.Begin();
+    ResourceInternalDataChunk** end = shard->m_Chunks.End();
     ResourceInternalDataChunk** lbound = std::lower_bound(begin, end, path_hash, ChunkComparePathFn);
     if (lbound != end)
     {
         uint32_t start_index = lbound - begin;
 
-        uint32_t num_chunks = cache->m_Chunks.Size();
+        uint32_t num_chunks = shard->m_Chunks.Size();
         for (uint32_t i = start_index; i < num_chunks; ++i)
         {
             ResourceInternalDataChunk* chunk = begin[i];
@@ -194,54 +266,108 @@ static uint32_t ResourceChunkCacheFindIndex(ResourceChunkCache* cache, ResourceI
         }
     }
     assert(false);
-    return cache->m_Chunks.Size();
+    return shard->m_Chunks.Size();
 }
 
-
-bool ResourceChunkCacheGet(HResourceChunkCache cache, dmhash_t path_hash, uint32_t offset, ResourceCacheChunk* out)
+// Finds the chunk containing the offset, and marks it as the most recently used.
+// Assumes the shard lock is held
+static ResourceInternalDataChunk* GetChunk(ResourceChunkCache* cache, ResourceChunkCacheShard* shard, dmhash_t path_hash, uint32_t offset)
 {
-    ResourceInternalDataChunk** begin = cache->m_Chunks.Begin();
-    ResourceInternalDataChunk** end = cache->m_Chunks.End();
+    ResourceInternalDataChunk** begin = shard->m_Chunks.Begin();
+    ResourceInternalDataChunk** end = shard->m_Chunks.End();
     ResourceInternalDataChunk** lbound = std::lower_bound(begin, end, path_hash, ChunkComparePathFn);
-    if (lbound == end)
-        return false;
-
-    uint32_t start_index = lbound - begin;
 
     // We assume the array is sorted on path and offset in ascending order
-    uint32_t num_chunks = cache->m_Chunks.Size();
-    for (uint32_t i = start_index; i < num_chunks; ++i)
+    for (ResourceInternalDataChunk** it = lbound; it != end; ++it)
     {
-        ResourceInternalDataChunk* chunk = begin[i];
+        ResourceInternalDataChunk* chunk = *it;
         dmhash_t chunk_path_hash = chunk->m_PathHash;
-        uint32_t chunk_size = chunk->m_Size;
-
-        if (path_hash < chunk_path_hash)
-            return false;
-
-        if (chunk_path_hash < path_hash)
-            continue;
-
-        // we got the correct file
         uint32_t chunk_offset = chunk->m_Offset;
 
+        if (chunk_path_hash != path_hash)
+            break; // no more chunks for this file
+
         if (offset < chunk_offset)
-            return false; // We currently don't have the chunk in question, and need to request it
+            break; // We currently don't have the chunk in question, and need to request it
 
         // The offset is within the bounds of the chunk
-        if (offset < (chunk_offset + chunk_size))
+        if (offset < (chunk_offset + chunk->m_Size))
         {
-            out->m_Data = chunk->m_Data;
-            out->m_Offset = chunk->m_Offset;
-            out->m_Size = chunk_size;
-
             // Update the LRU by placing the item first in the queue
-            dmDoubleLinkedList::List* list = &cache->m_LRU;
+            dmDoubleLinkedList::List* list = &shard->m_LRU;
             if (chunk->m_NoEvict)
-                list = &cache->m_LRUNoEvict;
+                list = &shard->m_LRUNoEvict;
 
             ListRemove(list, (dmDoubleLinkedList::ListNode*)chunk);
             ListAdd(list, (dmDoubleLinkedList::ListNode*)chunk);
+            chunk->m_LastUsed = NextTick(cache);
+
+            dmAtomicIncrement32(&cache->m_Hits);
+            DM_PROPERTY_ADD_U32(rmtp_ChunkCacheHits, 1);
+            return chunk;
+        }
+    }
+
+    dmAtomicIncrement32(&cache->m_Misses);
+    DM_PROPERTY_ADD_U32(rmtp_ChunkCacheMisses, 1);
+    return 0;
+}
+
+bool ResourceChunkCacheGet(HResourceChunkCache cache, dmhash_t path_hash, uint32_t offset, ResourceCacheChunk* out)
+{
+    ResourceChunkCacheShard* shard = GetShard(cache, path_hash);
+    DM_MUTEX_SCOPED_LOCK(shard->m_Mutex);
+
+    ResourceInternalDataChunk* chunk = GetChunk(cache, shard, path_hash, offset);
+    if (!chunk)
+        return false;
+
+    out->m_Data = chunk->m_Data;
+    out->m_Offset = chunk->m_Offset;
+    out->m_Size = chunk->m_Size;
+    return true;
+}
+
+uint32_t ResourceChunkCacheRead(HResourceChunkCache cache, dmhash_t path_hash, uint32_t offset, uint32_t size, uint8_t* out)
+{
+    ResourceChunkCacheShard* shard = GetShard(cache, path_hash);
+    DM_MUTEX_SCOPED_LOCK(shard->m_Mutex);
+
+    uint32_t nread = 0;
+    while (nread < size)
+    {
+        ResourceInternalDataChunk* chunk = GetChunk(cache, shard, path_hash, offset);
+        if (!chunk)
+            break;
+
+        uint32_t chunk_internal_offset = offset - chunk->m_Offset; // the index to start from within this chunk
+        uint32_t to_read = dmMath::Min(size - nread, chunk->m_Size - chunk_internal_offset);
+        memcpy(out + nread, chunk->m_Data + chunk_internal_offset, to_read);
+
+        nread  += to_read;
+        offset += to_read;
+    }
+    return nread;
+}
+
+bool ResourceChunkCacheGetPrefetchOffset(HResourceChunkCache cache, dmhash_t path_hash, uint32_t offset, uint32_t chunk_size, uint32_t count, uint32_t file_size, uint32_t* out_offset)
+{
+    if (chunk_size == 0 || file_size == 0)
+        return false;
+
+    ResourceChunkCacheShard* shard = GetShard(cache, path_hash);
+    DM_MUTEX_SCOPED_LOCK(shard->m_Mutex);
+
+    // The chunks are requested on chunk size boundaries, and we wrap around to the start of the file
+    uint32_t num_file_chunks = (file_size + chunk_size - 1) / chunk_size;
+    uint32_t first_chunk = (offset / chunk_size) % num_file_chunks;
+    count = dmMath::Min(count, num_file_chunks);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t chunk_offset = ((first_chunk + i) % num_file_chunks) * chunk_size;
+        if (!FindChunk(shard, path_hash, chunk_offset))
+        {
+            *out_offset = chunk_offset;
             return true;
         }
     }
@@ -251,96 +377,148 @@ bool ResourceChunkCacheGet(HResourceChunkCache cache, dmhash_t path_hash, uint32
 // Stores a new resoruce chunk
 bool ResourceChunkCachePut(HResourceChunkCache cache, uint64_t path_hash, int flags, ResourceCacheChunk* _chunk)
 {
-    if (!ResourceChunkCacheCanFit(cache, _chunk->m_Size))
+    ResourceChunkCacheShard* shard = GetShard(cache, path_hash);
+    DM_MUTEX_SCOPED_LOCK(shard->m_Mutex);
+
+    ResourceInternalDataChunk* prev = FindChunk(shard, path_hash, _chunk->m_Offset);
+    if (prev)
     {
-        dmLogError("Cache is full. Failed to add chunk: '%s' size: %u, offset: %u", dmHashReverseSafe64(path_hash), _chunk->m_Size, _chunk->m_Offset);
+        dmLogError("Chunk already exists: '%s' size: %u, offset: %u", dmHashReverseSafe64(path_hash), prev->m_Size, prev->m_Offset);
         return false;
     }
 
-    ResourceInternalDataChunk* prev = ResourceChunkCacheFind(cache, path_hash, _chunk->m_Offset);
-    if (prev)
+    if (!ReserveMemory(cache, _chunk->m_Size))
     {
-        dmLogError("Chunk already exists: '%s' size: %u, offset: %u", dmHashReverseSafe64(path_hash), prev->m_Size, prev->m_Offset);
+        dmLogError("Cache is full. Failed to add chunk: '%s' size: %u, offset: %u", dmHashReverseSafe64(path_hash), _chunk->m_Size, _chunk->m_Offset);
         return false;
     }
 
-    if (cache->m_Chunks.Full())
+    if (shard->m_Chunks.Full())
     {
-        cache->m_Chunks.OffsetCapacity(16);
+        shard->m_Chunks.OffsetCapacity(16);
     }
 
     ResourceInternalDataChunk* chunk = AllocChunk(cache, path_hash, _chunk->m_Data, _chunk->m_Size, _chunk->m_Offset, flags);
-    cache->m_Chunks.Push(chunk);
-    SortChunksOnPathAndOffset(cache);
+    shard->m_Chunks.Push(chunk);
+    SortChunksOnPathAndOffset(shard);
 
-    dmDoubleLinkedList::List* list = &cache->m_LRU;
+    dmDoubleLinkedList::List* list = &shard->m_LRU;
     if (flags & RESOURCE_CHUNK_CACHE_NO_EVICT)
-        list = &cache->m_LRUNoEvict;
+        list = &shard->m_LRUNoEvict;
     ListAdd(list, (dmDoubleLinkedList::ListNode*)chunk); // add it first in the LRU
+
+    DM_PROPERTY_SET_U32(rmtp_ChunkCacheUsed, (uint32_t)dmAtomicGet32(&cache->m_CacheSizeUsed));
     return true;
 }
 
 // Returns true if the cache can fit the chunk
 bool ResourceChunkCacheCanFit(HResourceChunkCache cache, uint32_t size)
 {
-    //printf("  size: %u  m_CacheSize: %u  m_CacheSizeUsed: %u  -> %d\n", size, cache->m_CacheSize, cache->m_CacheSizeUsed, size <= (cache->m_CacheSize - cache->m_CacheSizeUsed));
-    return size <= (cache->m_CacheSize - cache->m_CacheSizeUsed);
+    return size <= (cache->m_CacheSize - (uint32_t)dmAtomicGet32(&cache->m_CacheSizeUsed));
 }
 
 // Returns number of bytes used by the cache
 uint32_t ResourceChunkCacheGetUsedMemory(HResourceChunkCache cache)
 {
-    return cache->m_CacheSizeUsed;
+    return (uint32_t)dmAtomicGet32(&cache->m_CacheSizeUsed);
 }
 
 // Returns number of chunks stored (unit test only)
 uint32_t ResourceChunkCacheGetNumChunks(HResourceChunkCache cache)
 {
-    return cache->m_Chunks.Size();
+    uint32_t num_chunks = 0;
+    for (uint32_t s = 0; s < CHUNK_CACHE_NUM_SHARDS; ++s)
+    {
+        ResourceChunkCacheShard* shard = &cache->m_Shards[s];
+        DM_MUTEX_SCOPED_LOCK(shard->m_Mutex);
+        num_chunks += shard->m_Chunks.Size();
+    }
+    return num_chunks;
+}
+
+void ResourceChunkCacheGetStats(HResourceChunkCache cache, ResourceChunkCacheStats* stats)
+{
+    stats->m_Hits       = (uint32_t)dmAtomicGet32(&cache->m_Hits);
+    stats->m_Misses     = (uint32_t)dmAtomicGet32(&cache->m_Misses);
+    stats->m_Evictions  = (uint32_t)dmAtomicGet32(&cache->m_Evictions);
 }
 
-static void RemoveChunks(HResourceChunkCache cache, uint32_t index, uint32_t count)
+static void RemoveChunks(ResourceChunkCacheShard* shard, uint32_t index, uint32_t count)
 {
-    uint32_t num_chunks = cache->m_Chunks.Size();
-    ResourceInternalDataChunk** begin = cache->m_Chunks.Begin();
+    uint32_t num_chunks = shard->m_Chunks.Size();
+    ResourceInternalDataChunk** begin = shard->m_Chunks.Begin();
     // Shift the elements in the array
     uint32_t num_to_move = num_chunks - (index + count);
     memmove(begin + index, begin + index + count, num_to_move * sizeof(ResourceInternalDataChunk*));
-    cache->m_Chunks.SetSize(num_chunks - count);
+    shard->m_Chunks.SetSize(num_chunks - count);
 }
 
 bool ResourceChunkCacheEvictMemory(HResourceChunkCache cache, uint32_t size)
 {
-    dmDoubleLinkedList::List* list = &cache->m_LRU;
+    // Lock all shards (always in the same order) so that we can find the least recently used chunk of the whole cache
+    for (uint32_t s = 0; s < CHUNK_CACHE_NUM_SHARDS; ++s)
+    {
+        dmMutex::Lock(cache->m_Shards[s].m_Mutex);
+    }
+
     while (!ResourceChunkCacheCanFit(cache, size))
     {
-        dmDoubleLinkedList::ListNode* last = ListGetLast(list);
-        if (!last)
+        // Each shard list tail is the oldest chunk in that shard
+        ResourceChunkCacheShard* oldest_shard = 0;
+        ResourceInternalDataChunk* oldest = 0;
+        for (uint32_t s = 0; s < CHUNK_CACHE_NUM_SHARDS; ++s)
+        {
+            ResourceChunkCacheShard* shard = &cache->m_Shards[s];
+            ResourceInternalDataChunk* chunk = (ResourceInternalDataChunk*)ListGetLast(&shard->m_LRU);
+            if (!chunk)
+                continue;
+            // The tick may wrap around, so we compare the difference
+            if (!oldest || (int32_t)(chunk->m_LastUsed - oldest->m_LastUsed) < 0)
+            {
+                oldest = chunk;
+                oldest_shard = shard;
+            }
+        }
+
+        if (!oldest)
             break;
 
-        ListRemove(list, last);
+        ListRemove(&oldest_shard->m_LRU, (dmDoubleLinkedList::ListNode*)oldest);
 
-        ResourceInternalDataChunk* chunk = (ResourceInternalDataChunk*)last;
-        uint32_t index = ResourceChunkCacheFindIndex(cache, chunk);
-        RemoveChunks(cache, index, 1);
-        FreeChunk(cache, chunk);
+        uint32_t index = FindChunkIndex(oldest_shard, oldest);
+        RemoveChunks(oldest_shard, index, 1);
+        FreeChunk(cache, oldest);
+
+        dmAtomicIncrement32(&cache->m_Evictions);
+        DM_PROPERTY_ADD_U32(rmtp_ChunkCacheEvictions, 1);
     }
 
-    return ResourceChunkCacheCanFit(cache, size);
+    bool result = ResourceChunkCacheCanFit(cache, size);
+
+    for (uint32_t s = CHUNK_CACHE_NUM_SHARDS; s > 0; --s)
+    {
+        dmMutex::Unlock(cache->m_Shards[s-1].m_Mutex);
+    }
+
+    DM_PROPERTY_SET_U32(rmtp_ChunkCacheUsed, (uint32_t)dmAtomicGet32(&cache->m_CacheSizeUsed));
+    return result;
 }
 
 // Evicts the chunks associated with path_hash
 void ResourceChunkCacheEvictPathHash(HResourceChunkCache cache, uint64_t path_hash)
 {
-    ResourceInternalDataChunk** begin = cache->m_Chunks.Begin();
-    ResourceInternalDataChunk** end = cache->m_Chunks.End();
+    ResourceChunkCacheShard* shard = GetShard(cache, path_hash);
+    DM_MUTEX_SCOPED_LOCK(shard->m_Mutex);
+
+    ResourceInternalDataChunk** begin = shard->m_Chunks.Begin();
+    ResourceInternalDataChunk** end = shard->m_Chunks.End();
     ResourceInternalDataChunk** lbound = std::lower_bound(begin, end, path_hash, ChunkComparePathFn);
-    if (!lbound)
+    if (lbound == end)
         return;
 
     uint32_t count = 0;
     uint32_t start_index = lbound - begin;
-    uint32_t num_chunks = cache->m_Chunks.Size();
+    uint32_t num_chunks = shard->m_Chunks.Size();
     for (uint32_t i = start_index; i < num_chunks; ++i)
     {
         ResourceInternalDataChunk* chunk = begin[i];
@@ -350,42 +528,55 @@ void ResourceChunkCacheEvictPathHash(HResourceChunkCache cache, uint64_t path_ha
 
         ++count;
 
-        dmDoubleLinkedList::List* list = &cache->m_LRU;
+        dmDoubleLinkedList::List* list = &shard->m_LRU;
         if (chunk->m_NoEvict)
-            list = &cache->m_LRUNoEvict;
+            list = &shard->m_LRUNoEvict;
 
         ListRemove(list, (dmDoubleLinkedList::ListNode*)chunk);
         FreeChunk(cache, chunk);
     }
 
-    RemoveChunks(cache, start_index, count);
+    RemoveChunks(shard, start_index, count);
+
+    DM_PROPERTY_SET_U32(rmtp_ChunkCacheUsed, (uint32_t)dmAtomicGet32(&cache->m_CacheSizeUsed));
 }
 
 // Unit test only
 bool ResourceChunkCacheVerify(HResourceChunkCache cache)
 {
-    // Verify the sorting of the chunks
-    ResourceInternalDataChunk** chunks = cache->m_Chunks.Begin();
-    uint32_t num_chunks = cache->m_Chunks.Size();
-    uint64_t prev_hash = 0;
-    uint32_t prev_offset = 0;
-    for (uint32_t i = 0; i < num_chunks; ++i)
+    for (uint32_t s = 0; s < CHUNK_CACHE_NUM_SHARDS; ++s)
     {
-        ResourceInternalDataChunk* chunk = chunks[i];
-        assert(chunk);
-        uint64_t chunk_path_hash = chunk->m_PathHash;
-        uint32_t chunk_offset = chunk->m_Offset;
-        if (prev_hash != chunk_path_hash)
-            prev_offset = 0;
-
-        if (prev_hash > chunk_path_hash || prev_offset > chunk_offset)
+        ResourceChunkCacheShard* shard = &cache->m_Shards[s];
+        DM_MUTEX_SCOPED_LOCK(shard->m_Mutex);
+
+        // Verify the sorting of the chunks
+        ResourceInternalDataChunk** chunks = shard->m_Chunks.Begin();
+        uint32_t num_chunks = shard->m_Chunks.Size();
+        uint64_t prev_hash = 0;
+        uint32_t prev_offset = 0;
+        for (uint32_t i = 0; i < num_chunks; ++i)
         {
-            dmLogError("Chunk %u is out of order", i);
-            ResourceChunkCacheDebugChunks(cache);
-            return false;
+            ResourceInternalDataChunk* chunk = chunks[i];
+            assert(chunk);
+            uint64_t chunk_path_hash = chunk->m_PathHash;
+            uint32_t chunk_offset = chunk->m_Offset;
+            if (prev_hash != chunk_path_hash)
+                prev_offset = 0;
+
+            if (prev_hash > chunk_path_hash || prev_offset > chunk_offset)
+            {
+                dmLogError("Chunk %u in shard %u is out of order", i, s);
+                ResourceChunkCacheDebugChunks(cache);
+                return false;
+            }
+            if (GetShard(cache, chunk_path_hash) != shard)
+            {
+                dmLogError("Chunk %u is stored in the wrong shard (%u)", i, s);
+                return false;
+            }
+            prev_hash = chunk_path_hash;
+            prev_offset = chunk_offset;
         }
-        prev_hash = chunk_path_hash;
-        prev_offset = chunk_offset;
     }
     return true;
 }
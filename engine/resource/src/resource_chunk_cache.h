@@ -31,6 +31,15 @@ enum ResourceChunkCacheFlags
     RESOURCE_CHUNK_CACHE_NO_EVICT    = 1,
 };
 
+struct ResourceChunkCacheStats
+{
+    uint32_t m_Hits;        // Number of lookups that found a chunk
+    uint32_t m_Misses;      // Number of lookups that didn't find a chunk
+    uint32_t m_Evictions;   // Number of chunks evicted to make room for new chunks
+};
+
+// The cache is thread safe. The chunks are stored in shards (keyed on the path hash), each with its own lock.
+// Eviction is done in least recently used order, over all shards.
 typedef struct ResourceChunkCache* HResourceChunkCache;
 
 HResourceChunkCache ResourceChunkCacheCreate(uint32_t max_memory);
@@ -38,8 +47,17 @@ void                ResourceChunkCacheDestroy(HResourceChunkCache cache);
 
 // Get the chunk that contains the requested offset
 // Also updates the timestamp
+// Note: The data pointer is only valid until the chunk is evicted. Use ResourceChunkCacheRead() if other threads may evict chunks
 bool ResourceChunkCacheGet(HResourceChunkCache cache, dmhash_t path_hash, uint32_t offset, ResourceCacheChunk* out);
 
+// Copies up to size bytes, starting at offset, from the consecutive cached chunks
+// Returns the number of bytes copied (0 if the chunk containing the offset isn't cached)
+uint32_t ResourceChunkCacheRead(HResourceChunkCache cache, dmhash_t path_hash, uint32_t offset, uint32_t size, uint8_t* out);
+
+// For prefetching sequential reads: Checks the count chunks (of size chunk_size) starting with the chunk containing offset,
+// wrapping around at the end of the file. Returns true and the offset of the first chunk not in the cache, or false if all are cached
+bool ResourceChunkCacheGetPrefetchOffset(HResourceChunkCache cache, dmhash_t path_hash, uint32_t offset, uint32_t chunk_size, uint32_t count, uint32_t file_size, uint32_t* out_offset);
+
 // Stores a new resoruce chunk. Returns true if successful, false if the operation failed
 // Flags are a set of ResourceChunkCacheFlags
 bool ResourceChunkCachePut(HResourceChunkCache cache, dmhash_t path_hash, int flags, ResourceCacheChunk* chunk);
@@ -57,6 +75,9 @@ void ResourceChunkCacheEvictPathHash(HResourceChunkCache cache, dmhash_t path_ha
 // Returns number of bytes used by the cache
 uint32_t ResourceChunkCacheGetUsedMemory(HResourceChunkCache cache);
 
+// Gets the hit/miss/eviction counters since the cache was created
+void ResourceChunkCacheGetStats(HResourceChunkCache cache, ResourceChunkCacheStats* stats);
+
 // *************************************************************************************
 // Unit test functions
 
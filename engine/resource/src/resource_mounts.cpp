@@ -18,6 +18,8 @@
 #include "providers/provider.h"
 #include <resource/liveupdate_ddf.h>
 
+#include <dlib/atomic.h>
+#include <dlib/condition_variable.h>
 #include <dlib/dstrings.h>
 #include <dlib/log.h>
 #include <dlib/math.h>
@@ -48,7 +50,12 @@ struct ResourceMountsContext
     dmHashTable64<CustomFile>       m_CustomFiles;
     dmResourceProvider::HArchive    m_ResourceBaseArchive;
     dmMutex::HMutex                 m_Mutex;
-
+    // Number of partial reads in progress. They don't hold the mutex while reading,
+    // so any change to the mounts or custom files must wait for them (see WaitForActiveReads())
+    int32_atomic_t                  m_ActiveReads;
+    // Signaled when the last active read is done. The mutex is separate from m_Mutex, which is held during the wait
+    dmMutex::HMutex                 m_ReadsMutex;
+    dmConditionVariable::HConditionVariable m_ReadsDone;
 };
 
 
@@ -65,12 +72,30 @@ static dmResource::Result ProviderResultToResult(dmResourceProvider::Result resu
 
 static dmResource::Result DestroyMounts(HContext ctx);
 
+// Assumes mutex lock is held, which keeps new reads from starting
+static void WaitForActiveReads(HContext ctx)
+{
+    if (dmAtomicGet32(&ctx->m_ActiveReads) == 0)
+    {
+        return;
+    }
+
+    DM_MUTEX_SCOPED_LOCK(ctx->m_ReadsMutex);
+    while (dmAtomicGet32(&ctx->m_ActiveReads) > 0)
+    {
+        dmConditionVariable::Wait(ctx->m_ReadsDone, ctx->m_ReadsMutex);
+    }
+}
+
 HContext Create(dmResourceProvider::HArchive base_archive)
 {
     ResourceMountsContext* ctx = new ResourceMountsContext;
     ctx->m_Mounts.SetCapacity(2);
     ctx->m_Mutex = dmMutex::New();
     ctx->m_ResourceBaseArchive = base_archive;
+    ctx->m_ActiveReads = 0;
+    ctx->m_ReadsMutex = dmMutex::New();
+    ctx->m_ReadsDone = dmConditionVariable::New();
     return ctx;
 }
 
@@ -82,6 +107,8 @@ void Destroy(HContext ctx)
 
         ctx->m_CustomFiles.Clear();
     }
+    dmConditionVariable::Delete(ctx->m_ReadsDone);
+    dmMutex::Delete(ctx->m_ReadsMutex);
     dmMutex::Delete(ctx->m_Mutex);
     delete ctx;
 }
@@ -105,6 +132,7 @@ static void SortMounts(dmArray<ArchiveMount>& mounts)
 static void AddMountInternal(HContext ctx, const ArchiveMount& mount)
 {
     DM_MUTEX_SCOPED_LOCK(ctx->m_Mutex);
+    WaitForActiveReads(ctx);
 
     if (ctx->m_Mounts.Full())
         ctx->m_Mounts.OffsetCapacity(2);
@@ -150,6 +178,7 @@ static dmResource::Result RemoveMountByIndexInternal(HContext ctx, uint32_t inde
     if (index >= ctx->m_Mounts.Size())
         return dmResource::RESULT_RESOURCE_NOT_FOUND;
 
+    WaitForActiveReads(ctx);
     ctx->m_Mounts.EraseSwap(index); // TODO: We'd like an Erase() function in dmArray, to keep the internal ordering
     SortMounts(ctx->m_Mounts);
 
@@ -183,6 +212,7 @@ dmResource::Result RemoveAndUnmountByNameHash(HContext ctx, dmhash_t name_hash)
         ArchiveMount& mount = ctx->m_Mounts[i];
         if (mount.m_NameHash == name_hash)
         {
+            WaitForActiveReads(ctx);
             dmResourceProvider::Unmount(mount.m_Archive);
             return RemoveMountByIndexInternal(ctx, i);
         }
@@ -229,6 +259,7 @@ dmResource::Result GetMountByNameHash(HContext ctx, dmhash_t name_hash, SGetMoun
 
 static dmResource::Result DestroyMounts(HContext ctx)
 {
+    WaitForActiveReads(ctx);
     uint32_t size = ctx->m_Mounts.Size();
     for (uint32_t i = 0; i < size; ++i)
     {
@@ -272,7 +303,7 @@ static dmResource::Result ReadCustomResource(HContext ctx, dmhash_t path_hash, u
 
 static dmResource::Result ReadCustomResourcePartial(HContext ctx, dmhash_t path_hash, uint32_t offset, uint32_t size, uint8_t* buffer, uint32_t* nread)
 {
-    // Lock should already be held
+    // The read is registered in m_ActiveReads, so the custom files won't change
     CustomFile* file = ctx->m_CustomFiles.Get(path_hash);
     if (file)
     {
@@ -323,6 +354,36 @@ dmResource::Result ResourceExists(HContext ctx, dmhash_t path_hash)
     return GetResourceSize(ctx, path_hash, 0, &resource_size);
 }
 
+dmResource::Result GetResourceContentHash(HContext ctx, dmhash_t path_hash, const char* path, dmhash_t* content_hash)
+{
+    DM_MUTEX_SCOPED_LOCK(ctx->m_Mutex);
+
+    uint32_t size = ctx->m_Mounts.Size();
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        ArchiveMount& mount = ctx->m_Mounts[i];
+        uint32_t resource_size;
+        dmResourceProvider::Result result = dmResourceProvider::GetFileSize(mount.m_Archive, path_hash, path, &resource_size);
+        if (dmResourceProvider::RESULT_NOT_FOUND == result)
+            continue;
+        if (dmResourceProvider::RESULT_OK != result)
+            return ProviderResultToResult(result);
+
+        // The mount that would serve the resource decides its content
+        dmResource::Manifest* manifest;
+        if (dmResourceProvider::RESULT_OK != dmResourceProvider::GetManifest(mount.m_Archive, &manifest))
+            return dmResource::RESULT_RESOURCE_NOT_FOUND;
+
+        dmLiveUpdateDDF::ResourceEntry* entry = dmResource::FindEntry(manifest, path_hash);
+        if (!entry)
+            return dmResource::RESULT_RESOURCE_NOT_FOUND;
+
+        *content_hash = dmHashBuffer64(entry->m_Hash.m_Data.m_Data, dmResource::GetEntryHashLength(manifest));
+        return dmResource::RESULT_OK;
+    }
+    return dmResource::RESULT_RESOURCE_NOT_FOUND;
+}
+
 dmResource::Result ReadResource(HContext ctx, dmhash_t path_hash, const char* path, uint8_t* buffer, uint32_t buffer_size)
 {
     DM_MUTEX_SCOPED_LOCK(ctx->m_Mutex);
@@ -349,10 +410,9 @@ dmResource::Result ReadResource(HContext ctx, dmhash_t path_hash, const char* pa
     return dmResource::RESULT_RESOURCE_NOT_FOUND;
 }
 
-dmResource::Result ReadResourcePartial(HContext ctx, dmhash_t path_hash, const char* path, uint32_t offset, uint32_t size, uint8_t* buffer, uint32_t* nread)
+// Called without holding the mutex, see ReadResourcePartial()
+static dmResource::Result ReadResourcePartialInternal(HContext ctx, dmhash_t path_hash, const char* path, uint32_t offset, uint32_t size, uint8_t* buffer, uint32_t* nread)
 {
-    DM_MUTEX_SCOPED_LOCK(ctx->m_Mutex);
-
     uint32_t num_mounts = ctx->m_Mounts.Size();
     for (uint32_t i = 0; i < num_mounts; ++i)
     {
@@ -375,12 +435,33 @@ dmResource::Result ReadResourcePartial(HContext ctx, dmhash_t path_hash, const c
     return dmResource::RESULT_RESOURCE_NOT_FOUND;
 }
 
+dmResource::Result ReadResourcePartial(HContext ctx, dmhash_t path_hash, const char* path, uint32_t offset, uint32_t size, uint8_t* buffer, uint32_t* nread)
+{
+    // The mutex is only held while registering the read, so that several (streaming) reads may run in parallel.
+    // While there are active reads, the mounts and custom files are left untouched
+    {
+        DM_MUTEX_SCOPED_LOCK(ctx->m_Mutex);
+        dmAtomicIncrement32(&ctx->m_ActiveReads);
+    }
+
+    dmResource::Result result = ReadResourcePartialInternal(ctx, path_hash, path, offset, size, buffer, nread);
+
+    if (dmAtomicDecrement32(&ctx->m_ActiveReads) == 1)
+    {
+        // Taking the lock makes sure a waiting change is either already waiting, or sees the count
+        DM_MUTEX_SCOPED_LOCK(ctx->m_ReadsMutex);
+        dmConditionVariable::Broadcast(ctx->m_ReadsDone);
+    }
+    return result;
+}
+
 // ****************************************
 // Custom files
 
 dmResource::Result AddFile(HContext context, dmhash_t path_hash, uint32_t size, const void* resource)
 {
     DM_MUTEX_SCOPED_LOCK(context->m_Mutex);
+    WaitForActiveReads(context);
 
     CustomFile* prevfile = context->m_CustomFiles.Get(path_hash);
     if (prevfile)
@@ -405,6 +486,8 @@ dmResource::Result RemoveFile(HContext context, dmhash_t path_hash)
     if (!file)
         return dmResource::RESULT_RESOURCE_NOT_FOUND;
 
+    WaitForActiveReads(context);
+
     context->m_CustomFiles.Erase(path_hash);
     return dmResource::RESULT_OK;
 }
@@ -49,6 +49,10 @@ namespace dmResourceMounts
     dmResource::Result ReadResource(HContext ctx, dmhash_t path_hash, const char* path, dmArray<char>* buffer);
     dmResource::Result ReadResourcePartial(HContext ctx, dmhash_t path_hash, const char* path, uint32_t offset, uint32_t size, uint8_t* buffer, uint32_t* nread);
 
+    // Gets a hash of the manifest content hash of the resource, from the first mount that has the resource.
+    // Returns RESULT_RESOURCE_NOT_FOUND if that mount has no manifest entry for it (e.g. loose files)
+    dmResource::Result GetResourceContentHash(HContext ctx, dmhash_t path_hash, const char* path, dmhash_t* content_hash);
+
     struct SGetMountResult
     {
         dmhash_t                     m_NameHash;
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <string.h>
 #include <time.h>
@@ -22,9 +23,11 @@
 #include <dlib/hash.h>
 #include <dlib/hashtable.h>
 #include <dlib/log.h>
+#include <dlib/math.h>
 #include <dlib/uri.h>
 #include <dlib/time.h>
 #include <dlib/spinlock.h>
+#include <dlib/sys.h>
 
 #include "block_allocator.h"
 #include "resource.h"
@@ -71,6 +74,18 @@
 
 // If max number of preload items is reached or the path cache is full new items added to the preloader will
 // be thrown away and can potentially cause synced loading of those resources.
+//
+// Discovering the tree is serial: a resource has to be loaded and preloaded before its children are known.
+// To avoid this, a preloader can record the resources it loaded (in load order) into a prefetch list for
+// the root resource, see NewFactoryParams::m_PrefetchRecordDir. When a prefetch list is found for the root,
+// its entries are added up front as children of the root, so they are all scheduled for load at once.
+// Any resource missing from the list is discovered as usual, and an outdated list only costs extra loads.
+//
+// Creating resources happens on the main thread, within the soft time limit given to UpdatePreloader.
+// The time spent in the create and postcreate functions is tracked per resource type, and a create (or postcreate)
+// that isn't expected to fit in what remains of the update is deferred to the next update. At least one
+// create or postcreate is done per update, to guarantee progress. A parent whose create is deferred stays
+// in the tree (with its buffer and no pending children) until it is picked up again.
 
 
 
@@ -95,6 +110,10 @@ static const uint32_t MAX_PRELOADER_PATHS            = 1536;
 static const uint32_t PATH_BUFFER_TABLE_SIZE         = 509;
 static const uint32_t PATH_BUFFER_TABLE_CAPACITY     = MAX_PRELOADER_PATHS;
 static const uint32_t PATH_BUFFER_HASHDATA_SIZE      = (PATH_BUFFER_TABLE_SIZE * sizeof(uint32_t)) + (PATH_BUFFER_TABLE_CAPACITY * sizeof(TPathHashTable::Entry));
+// Leave room in the request tree for resources discovered during the load
+static const uint32_t MAX_PREFETCH_REQUESTS          = MAX_PRELOADER_REQUESTS / 2;
+static const char     PREFETCH_FILE_SUFFIX[]         = ".prefetch";
+static const char     PREFETCH_FILE_HEADER[]         = "# prefetch 1";
 
 struct PathDescriptor
 {
@@ -119,6 +138,13 @@ struct PendingHint
     TRequestIndex m_Parent;
 };
 
+struct PrefetchRecordEntry
+{
+    const char* m_CanonicalPath; // Internalized
+    dmhash_t    m_CanonicalPathHash;
+    uint32_t    m_Size;
+};
+
 struct PreloadRequest
 {
     PathDescriptor m_PathDescriptor;
@@ -185,10 +211,22 @@ struct ResourcePreloader
     uint32_t m_PostCreateCallbackIndex;
     dmArray<ResourcePostCreateParamsInternal> m_PostCreateCallbacks;
 
+    // Time budget of the current update
+    uint64_t m_CreateDeadline;
+    bool m_HasCreated;
+    bool m_BudgetExceeded;
+
     // How many of the initial resources where requested - they should not be release until preloader destruction
     TRequestIndex m_PersistResourceCount;
 
     dmArray<void*> m_PersistedResources;
+
+    // Set if the loaded resources should be recorded into a prefetch list
+    bool m_RecordPrefetch;
+    dmArray<PrefetchRecordEntry> m_PrefetchRecord;
+    dmHashTable64<bool> m_PrefetchRecorded;
+    // Number of resources queued from a recorded prefetch list
+    uint32_t m_PrefetchCount;
 };
 
 namespace dmResource
@@ -446,6 +484,156 @@ namespace dmResource
         assert(req->m_PendingChildCount == 0);
     }
 
+    static void RecordPrefetch(ResourcePreloader* preloader, TRequestIndex index, uint32_t size)
+    {
+        // The root is always loaded first, so it isn't part of its own prefetch list
+        if (!preloader->m_RecordPrefetch || index == 0)
+        {
+            return;
+        }
+        const PathDescriptor* path_descriptor = &preloader->m_Request[index].m_PathDescriptor;
+        if (preloader->m_PrefetchRecorded.Get(path_descriptor->m_CanonicalPathHash))
+        {
+            return;
+        }
+        if (preloader->m_PrefetchRecorded.Full())
+        {
+            preloader->m_PrefetchRecorded.OffsetCapacity(256);
+        }
+        preloader->m_PrefetchRecorded.Put(path_descriptor->m_CanonicalPathHash, true);
+
+        if (preloader->m_PrefetchRecord.Full())
+        {
+            preloader->m_PrefetchRecord.OffsetCapacity(256);
+        }
+        PrefetchRecordEntry entry;
+        entry.m_CanonicalPath     = path_descriptor->m_InternalizedCanonicalPath;
+        entry.m_CanonicalPathHash = path_descriptor->m_CanonicalPathHash;
+        entry.m_Size              = size;
+        preloader->m_PrefetchRecord.Push(entry);
+    }
+
+    static void GetPrefetchPath(const char* root_canonical_path, char* buffer, uint32_t buffer_size)
+    {
+        dmSnPrintf(buffer, buffer_size, "%s%s%s", PREFETCH_PATH_PREFIX, root_canonical_path, PREFETCH_FILE_SUFFIX);
+    }
+
+    // Writes <record dir>/_prefetch/<root path>.prefetch, one "<path hash> <size> <path>" line per loaded resource
+    static void WritePrefetchRecord(ResourcePreloader* preloader)
+    {
+        const char* record_dir = GetPrefetchRecordDir(preloader->m_Factory);
+        const PathDescriptor* root = &preloader->m_Request[0].m_PathDescriptor;
+
+        char prefetch_path[RESOURCE_PATH_MAX];
+        GetPrefetchPath(root->m_InternalizedCanonicalPath, prefetch_path, sizeof(prefetch_path));
+
+        char path[RESOURCE_PATH_MAX];
+        int path_len = dmSnPrintf(path, sizeof(path), "%s%s", record_dir, prefetch_path);
+        if (path_len < 0)
+        {
+            dmLogWarning("Prefetch list path is too long: %s%s", record_dir, prefetch_path);
+            return;
+        }
+
+        // Create the intermediate directories
+        for (int i = (int)strlen(record_dir) + 1; i < path_len; ++i)
+        {
+            if (path[i] == '/')
+            {
+                path[i] = 0;
+                dmSys::Mkdir(path, 0755);
+                path[i] = '/';
+            }
+        }
+
+        FILE* file = fopen(path, "wb");
+        if (!file)
+        {
+            dmLogWarning("Failed to write prefetch list '%s'", path);
+            return;
+        }
+
+        fprintf(file, "%s\n", PREFETCH_FILE_HEADER);
+        for (uint32_t i = 0; i < preloader->m_PrefetchRecord.Size(); ++i)
+        {
+            const PrefetchRecordEntry& entry = preloader->m_PrefetchRecord[i];
+            fprintf(file, "%016llx %u %s\n", (unsigned long long)entry.m_CanonicalPathHash, entry.m_Size, entry.m_CanonicalPath);
+        }
+        fclose(file);
+
+        dmLogDebug("Wrote prefetch list '%s' (%u resources)", path, preloader->m_PrefetchRecord.Size());
+    }
+
+    // Adds the entries of the prefetch list of the root (if any) as children of the root
+    static void ReplayPrefetchRecord(ResourcePreloader* preloader)
+    {
+        const PathDescriptor* root = &preloader->m_Request[0].m_PathDescriptor;
+
+        char prefetch_path[RESOURCE_PATH_MAX];
+        GetPrefetchPath(root->m_InternalizedCanonicalPath, prefetch_path, sizeof(prefetch_path));
+
+        void* data;
+        uint32_t data_size;
+        if (GetRaw(preloader->m_Factory, prefetch_path, &data, &data_size) != RESULT_OK)
+        {
+            return;
+        }
+
+        const uint32_t header_len = sizeof(PREFETCH_FILE_HEADER) - 1;
+        if (data_size < header_len || memcmp(data, PREFETCH_FILE_HEADER, header_len) != 0)
+        {
+            dmLogWarning("Invalid prefetch list '%s'", prefetch_path);
+            free(data);
+            return;
+        }
+
+        dmArray<PathDescriptor> entries;
+        entries.SetCapacity(MAX_PREFETCH_REQUESTS);
+
+        char line[RESOURCE_PATH_MAX + 32];
+        const char* cursor = (const char*)data;
+        const char* end = cursor + data_size;
+        while (cursor < end && !entries.Full())
+        {
+            const char* line_end = (const char*)memchr(cursor, '\n', end - cursor);
+            if (!line_end)
+                line_end = end;
+            uint32_t line_len = dmMath::Min((uint32_t)(line_end - cursor), (uint32_t)sizeof(line) - 1);
+            memcpy(line, cursor, line_len);
+            line[line_len] = 0;
+            cursor = line_end + 1;
+
+            unsigned long long path_hash;
+            unsigned int size;
+            int path_offset = 0;
+            if (line[0] == '#' || sscanf(line, "%llx %u %n", &path_hash, &size, &path_offset) != 2 || path_offset == 0)
+            {
+                continue;
+            }
+
+            // Skip entries that no longer match their path, or that can't be loaded by the preloader
+            PathDescriptor path_descriptor;
+            if (MakePathDescriptor(preloader, line + path_offset, path_descriptor) != RESULT_OK ||
+                path_descriptor.m_CanonicalPathHash != path_hash ||
+                path_descriptor.m_CanonicalPathHash == root->m_CanonicalPathHash ||
+                path_descriptor.m_ResourceType == 0)
+            {
+                continue;
+            }
+            entries.Push(path_descriptor);
+        }
+        free(data);
+
+        // Children are inserted first in the list, so insert backwards to load in the recorded order
+        for (uint32_t i = entries.Size(); i > 0; --i)
+        {
+            PreloadPathDescriptor(preloader, 0, entries[i - 1]);
+        }
+        preloader->m_PrefetchCount = entries.Size();
+
+        dmLogDebug("Prefetching %u resources from '%s'", entries.Size(), prefetch_path);
+    }
+
     HPreloader NewPreloader(HFactory factory, const dmArray<const char*>& names)
     {
         ResourcePreloader* preloader = new ResourcePreloader();
@@ -499,6 +687,22 @@ namespace dmResource
             }
         }
 
+        // When recording, let the load discover the resources by itself
+        preloader->m_RecordPrefetch = GetPrefetchRecordDir(factory) != 0;
+        preloader->m_PrefetchCount = 0;
+        if (root->m_LoadResult == RESULT_PENDING)
+        {
+            if (preloader->m_RecordPrefetch)
+            {
+                preloader->m_PrefetchRecord.SetCapacity(256);
+                preloader->m_PrefetchRecorded.SetCapacity(256);
+            }
+            else if (IsPrefetchEnabled(factory))
+            {
+                ReplayPrefetchRecord(preloader);
+            }
+        }
+
         return preloader;
     }
 
@@ -509,6 +713,25 @@ namespace dmResource
         return NewPreloader(factory, names);
     }
 
+    static void UpdateCost(uint32_t* cost, uint64_t start_time)
+    {
+        uint32_t sample = (uint32_t)(dmTime::GetMonotonicTime() - start_time);
+        *cost = *cost ? (*cost * 3 + sample) / 4 : sample;
+    }
+
+    // Returns true if work of the given (estimated) cost fits in the remaining time of the update
+    // A create that doesn't fit is deferred to the next update as a whole. There is no resumable create, so a single
+    // create that takes longer than the time limit still overruns it (see FResourceCreate)
+    static bool FitsInBudget(ResourcePreloader* preloader, uint32_t cost)
+    {
+        if (!preloader->m_HasCreated || dmTime::GetMonotonicTime() + cost <= preloader->m_CreateDeadline)
+        {
+            return true;
+        }
+        preloader->m_BudgetExceeded = true;
+        return false;
+    }
+
     // CreateResource operation ends either with
     //   1) Having created the resource and free:d all buffers => RESULT_OK + m_Resource
     //   2) Having failed, (or created and destroyed), leaving => RESULT_SOME_ERROR + everything free:d
@@ -548,7 +771,9 @@ namespace dmResource
             params.m_BufferSize               = req->m_BufferSize;
             params.m_FileSize                 = req->m_FileSize;
             params.m_IsBufferPartial          = req->m_BufferSize != req->m_FileSize;
+            uint64_t create_start             = dmTime::GetMonotonicTime();
             req->m_LoadResult                 = (Result)resource_type->m_CreateFunction(&params);
+            UpdateCost(&resource_type->m_CreateCost, create_start);
 
             dmBlockAllocator::Free(preloader->m_BlockAllocator, req->m_Buffer, req->m_BufferSize);
 
@@ -561,8 +786,11 @@ namespace dmResource
             params.m_BufferSize               = buffer_size;
             params.m_FileSize                 = resource_size;
             params.m_IsBufferPartial          = buffer_size != resource_size;
+            uint64_t create_start             = dmTime::GetMonotonicTime();
             req->m_LoadResult                 = (Result)resource_type->m_CreateFunction(&params);
+            UpdateCost(&resource_type->m_CreateCost, create_start);
         }
+        preloader->m_HasCreated = true;
 
         if (req->m_LoadResult == RESULT_OK)
         {
@@ -621,6 +849,7 @@ namespace dmResource
             if (req->m_LoadResult == RESULT_OK)
             {
                 req->m_Resource = tmp_resource.m_Resource;
+                RegisterContent(preloader->m_Factory, req->m_PathDescriptor.m_InternalizedCanonicalPath, req->m_PathDescriptor.m_CanonicalPathHash);
             }
             else
             {
@@ -691,6 +920,11 @@ namespace dmResource
         {
             return false;
         }
+        // The parent is picked up again in DoPreloaderUpdateOneReq
+        if (parent_req->m_PathDescriptor.m_ResourceType && !FitsInBudget(preloader, parent_req->m_PathDescriptor.m_ResourceType->m_CreateCost))
+        {
+            return false;
+        }
         CreateResource(preloader, parent_req, 0, 0, 0);
         UnmarkPathInProgress(preloader, &parent_req->m_PathDescriptor);
         PreloaderTryPruneParent(preloader, parent_req);
@@ -698,8 +932,8 @@ namespace dmResource
     }
 
     // Ends the Load part of the resource and handles the result of the load
-    // It will create the resource if it has no children, otherwise it will
-    // copy the loaded buffer for later use when all the children has been created.
+    // It will create the resource if it has no children and the create fits in the budget, otherwise it will
+    // copy the loaded buffer for later use when all the children has been created (or there is time to create it).
     //
     // Returns true if the resource was created
     static bool FinishLoad(HPreloader preloader, PreloadRequest* req, dmLoadQueue::LoadResult& load_result, void* buffer, uint32_t buffer_size, uint32_t resource_size)
@@ -707,6 +941,11 @@ namespace dmResource
         // Pop any hints the load/preload of the item that may have been generated
         PopHints(preloader);
 
+        if (load_result.m_LoadResult == RESULT_OK)
+        {
+            RecordPrefetch(preloader, (TRequestIndex)(req - preloader->m_Request), resource_size);
+        }
+
         // Propagate errors
         if (load_result.m_LoadResult != RESULT_OK)
         {
@@ -729,7 +968,7 @@ namespace dmResource
         bool created_resource = false;
 
         // If no children, do the create step immediately with the buffer in place
-        if (req->m_FirstChild == -1)
+        if (req->m_FirstChild == -1 && (req->m_LoadResult != RESULT_PENDING || FitsInBudget(preloader, req->m_PathDescriptor.m_ResourceType->m_CreateCost)))
         {
             if (req->m_LoadResult == RESULT_PENDING)
             {
@@ -745,7 +984,7 @@ namespace dmResource
         }
         else
         {
-            // Keep the loaded bytes until we have loaded all children
+            // Keep the loaded bytes until we have loaded all children, or until the next update
             req->m_Buffer = dmBlockAllocator::Allocate(preloader->m_BlockAllocator, buffer_size);
             memcpy(req->m_Buffer, buffer, buffer_size);
             req->m_BufferSize = buffer_size;
@@ -807,6 +1046,7 @@ namespace dmResource
         }
 
         // If loading it must finish first before trying to go down to children
+        // The budget is checked once the load has finished (see FinishLoad()), as a pending load doesn't cost anything
         if (req->m_LoadRequest)
         {
             void* buffer;
@@ -832,6 +1072,19 @@ namespace dmResource
         // It has a buffer if is waiting for children to complete first
         if (req->m_Buffer)
         {
+            // All children are done, but the create was deferred
+            if (req->m_PendingChildCount == 0)
+            {
+                if (!FitsInBudget(preloader, req->m_PathDescriptor.m_ResourceType->m_CreateCost))
+                {
+                    return false;
+                }
+                CreateResource(preloader, req, 0, 0, 0);
+                UnmarkPathInProgress(preloader, &req->m_PathDescriptor);
+                PreloaderTryPruneParent(preloader, req);
+                return true;
+            }
+
             // traverse depth first
             if (PreloaderUpdateOneItem(preloader, req->m_FirstChild))
             {
@@ -842,8 +1095,14 @@ namespace dmResource
 
         // It might have been loaded by unhinted resource Gets or loaded by a different preloader, just grab & bump refcount
         ResourceDescriptor* rd = FindByHash(preloader->m_Factory, req->m_PathDescriptor.m_CanonicalPathHash);
+        if (!rd)
+        {
+            // Or the same content might have been loaded through a different path
+            rd = FindByContent(preloader->m_Factory, req->m_PathDescriptor.m_InternalizedCanonicalPath, req->m_PathDescriptor.m_CanonicalPathHash, req->m_PathDescriptor.m_ResourceType);
+        }
         if (rd)
         {
+            RecordPrefetch(preloader, index, rd->m_ResourceSizeOnDisc);
             rd->m_ReferenceCount++;
             req->m_Resource   = rd->m_Resource;
             req->m_LoadResult = RESULT_OK;
@@ -895,7 +1154,14 @@ namespace dmResource
         ResourcePostCreateParams& params     = ip.m_Params;
         params.m_Resource                    = &ip.m_ResourceDesc;
         ResourceType* resource_type          = params.m_Resource->m_ResourceType;
+        if (!FitsInBudget(preloader, resource_type->m_PostCreateCost))
+        {
+            return RESULT_PENDING;
+        }
+        uint64_t post_create_start           = dmTime::GetMonotonicTime();
         Result ret                           = (Result)resource_type->m_PostCreateFunction(&params);
+        UpdateCost(&resource_type->m_PostCreateCost, post_create_start);
+        preloader->m_HasCreated              = true;
 
         if (ret == RESULT_PENDING)
         {
@@ -940,6 +1206,10 @@ namespace dmResource
         uint32_t empty_runs      = 0;
         bool close_to_time_limit = soft_time_limit < 1000;
 
+        preloader->m_CreateDeadline = start + soft_time_limit;
+        preloader->m_HasCreated     = false;
+        preloader->m_BudgetExceeded = false;
+
         do
         {
             Result root_result        = preloader->m_Request[0].m_LoadResult;
@@ -977,6 +1247,10 @@ namespace dmResource
                     // call the post-create function (if given) and then post-create
                     // of all created items
                     preloader->m_CreateComplete = true;
+                    if (root_result == RESULT_OK && preloader->m_RecordPrefetch)
+                    {
+                        WritePrefetchRecord(preloader);
+                    }
                     if (root_result == RESULT_OK && complete_callback)
                     {
                         if (!complete_callback(complete_callback_params))
@@ -1002,6 +1276,12 @@ namespace dmResource
                 continue;
             }
 
+            // The next create doesn't fit in this update
+            if (preloader->m_BudgetExceeded)
+            {
+                break;
+            }
+
             if (close_to_time_limit)
             {
                 ++empty_runs;
@@ -1090,4 +1370,9 @@ namespace dmResource
 
         return true;
     }
+
+    uint32_t GetPreloaderPrefetchCount(HPreloader preloader)
+    {
+        return preloader->m_PrefetchCount;
+    }
 } // namespace dmResource
@@ -59,6 +59,17 @@ struct ResourceDescriptor
     uint32_t        m_ResourceSizeOnDisc;
     uint32_t        m_ReferenceCount;
     uint16_t        m_Version;
+    // Hash of the manifest content hash, if other paths may share the resource. See RESOURCE_FACTORY_FLAGS_SHARE_CONTENT
+    dmhash_t        m_ContentHash;
+    // First path sharing the resource, or 0. The rest are linked through ResourceAlias::m_NextAliasHash
+    dmhash_t        m_FirstAliasHash;
+};
+
+// A path that shares the resource loaded by another path. See RESOURCE_FACTORY_FLAGS_SHARE_CONTENT
+struct ResourceAlias
+{
+    dmhash_t        m_OwnerHash;
+    dmhash_t        m_NextAliasHash;
 };
 
 struct ResourceType
@@ -77,6 +88,10 @@ struct ResourceType
     FResourceDestroy    m_DestroyFunction;
     FResourceRecreate   m_RecreateFunction;
     uint32_t            m_PreloadSize;
+    // Moving averages of the time (in microseconds) spent in the create and postcreate functions.
+    // Used by the preloader to avoid starting work that doesn't fit in the remaining time of an update
+    uint32_t            m_CreateCost;
+    uint32_t            m_PostCreateCost;
     uint8_t             m_Index;
 };
 
@@ -110,6 +125,22 @@ namespace dmResource
 
     Result InsertResource(HFactory factory, const char* path, uint64_t canonical_path_hash, HResourceDescriptor descriptor);
 
+    // If content sharing is enabled, finds a loaded resource of the same type that has the same content as the path.
+    // The path is then registered as an alias of the found resource. The caller increases the reference count
+    ResourceDescriptor* FindByContent(HFactory factory, const char* canonical_path, dmhash_t canonical_path_hash, HResourceType type);
+    // Makes a resource that was just loaded (and inserted) from the mounts available for content sharing
+    void RegisterContent(HFactory factory, const char* canonical_path, dmhash_t canonical_path_hash);
+
+    // Resource path prefix of the recorded prefetch lists, see NewFactoryParams::m_PrefetchRecordDir
+    extern const char* PREFETCH_PATH_PREFIX;
+
+    // Returns the directory preloaders record into, or 0 if recording is disabled
+    const char* GetPrefetchRecordDir(HFactory factory);
+    // Returns true if preloaders should replay recorded prefetch lists
+    bool IsPrefetchEnabled(HFactory factory);
+    // Returns the number of resources the preloader queued from a recorded prefetch list
+    uint32_t GetPreloaderPrefetchCount(HPreloader preloader);
+
     HResourceType FindResourceType(HFactory factory, const char* extension);
     uint32_t GetRefCount(HFactory factory, void* resource);
     uint32_t GetRefCount(HFactory factory, dmhash_t identifier);
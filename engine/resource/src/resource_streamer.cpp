@@ -42,8 +42,8 @@ static int JobProcess(HJobContext, HJob hjob, void* context, void* data)
         job->m_Data.SetCapacity(job->m_Size);
     }
 
-    DM_MUTEX_SCOPED_LOCK(dmResource::GetLoadMutex(factory));
-
+    // The factory load mutex isn't needed here: the mounts and the providers synchronize the partial reads themselves,
+    // which allows several chunks to be streamed in parallel
     uint32_t resource_size;
     uint32_t buffer_size;
     dmResource::Result result = dmResource::LoadResourceToBufferWithOffset(factory, job->m_CanonicalPath, job->m_Path, job->m_Offset, job->m_Size, &resource_size, &buffer_size, &job->m_Data);
@@ -14,14 +14,19 @@
 
 
 #include "resource_archive.h"
+#include "resource_archive_private.h"
 #include "resource_manifest_private.h"
 #include "resource_util.h"
 #include "resource_verify.h"
 
+#include <dlib/atomic.h>
+#include <dlib/crypt.h>
 #include <dlib/dalloca.h>
 #include <dlib/endian.hpp>
 #include <dlib/log.h>
+#include <dlib/math.h>
 #include <dlib/sys.h>
+#include <dlib/time.h>
 
 namespace dmResource
 {
@@ -80,6 +85,337 @@ namespace dmResource
         return dmResource::MemCompare(hexDigest, hexDigestLength-1, expected, expected_length);
     }
 
+    // Number of archive entries that have been hashed, for unit tests
+    static int32_atomic_t g_VerifiedEntryCount = 0;
+
+    Result VerifyArchiveEntry(dmResourceArchive::HArchiveIndexContainer archive, const dmResourceArchive::EntryData* entry,
+                              dmLiveUpdateDDF::HashAlgorithm algorithm, const uint8_t* hash, uint32_t hash_len, dmArray<uint8_t>* scratch)
+    {
+        if (hash_len > dmResourceArchive::MAX_HASH || hash_len != dmResource::HashLength(algorithm))
+        {
+            return RESULT_INVALID_DATA;
+        }
+        dmAtomicIncrement32(&g_VerifiedEntryCount);
+
+        const uint32_t size = dmResourceArchive::GetEntryStoredSize(entry);
+        const dmResourceArchive::ArchiveFileIndex* afi = archive->m_ArchiveFileIndex;
+
+        const uint8_t* data = 0;
+        if (afi->m_IsMemMapped)
+        {
+            // Hash the data in place
+            const uint32_t offset = dmEndian::ToNetwork(entry->m_ResourceDataOffset);
+            if ((uint64_t)offset + size > afi->m_ResourceSize)
+            {
+                return RESULT_INVALID_DATA;
+            }
+            data = afi->m_ResourceData + offset;
+        }
+        else
+        {
+            if (scratch->Capacity() < size)
+            {
+                scratch->OffsetCapacity(size - scratch->Capacity());
+            }
+            scratch->SetSize(size);
+            if (dmResourceArchive::RESULT_OK != dmResourceArchive::ReadEntryRaw(archive, entry, scratch->Begin()))
+            {
+                return RESULT_IO_ERROR;
+            }
+            data = scratch->Begin();
+        }
+
+        uint8_t digest[dmResourceArchive::MAX_HASH];
+        Result r = dmResource::CreateResourceHash(algorithm, data, size, digest);
+        if (RESULT_OK != r)
+        {
+            return r;
+        }
+        return memcmp(digest, hash, hash_len) == 0 ? RESULT_OK : RESULT_INVALID_DATA;
+    }
+
+    // *********************************************************************************
+    // Archive verification
+
+    static const uint32_t VERIFY_RECORD_MAGIC   = 0x52564144; // "DAVR"
+    static const uint32_t VERIFY_RECORD_VERSION = 1;
+    static const uint32_t VERIFY_ROOT_HASH_LEN  = 20; // SHA1
+
+    // The result of a successful verification. If none of the fields changed, the archive is considered verified.
+    struct VerifyRecord
+    {
+        uint32_t m_Magic;
+        uint32_t m_Version;
+        uint64_t m_IndexSize;
+        uint64_t m_DataSize;
+        uint32_t m_IndexModified;
+        uint32_t m_DataModified;
+        uint8_t  m_RootHash[VERIFY_ROOT_HASH_LEN];
+    };
+
+    struct VerifyArchiveContext
+    {
+        dmResourceArchive::HArchiveIndexContainer   m_Archive;
+        const uint8_t*                              m_Hashes;
+        const dmResourceArchive::EntryData*         m_Entries;
+        dmArray<uint32_t>                           m_Chunks;       // First entry of each chunk, followed by the entry count
+        dmLiveUpdateDDF::HashAlgorithm              m_Algorithm;
+        uint32_t                                    m_HashLength;
+        int32_atomic_t                              m_NextChunk;
+        int32_atomic_t                              m_Result;
+        int32_atomic_t                              m_FailedEntry;
+        int32_atomic_t                              m_JobsDone;
+    };
+
+    VerifyArchiveParams::VerifyArchiveParams()
+    {
+        memset(this, 0, sizeof(*this));
+        m_ChunkSize = 1024 * 1024;
+    }
+
+    static void GetArchiveIndexData(dmResourceArchive::HArchiveIndexContainer archive, const uint8_t** hashes, const dmResourceArchive::EntryData** entries)
+    {
+        // If archive is loaded from file use the member arrays for hashes and entries, otherwise read with mem offsets.
+        if (!archive->m_IsMemMapped)
+        {
+            *hashes = archive->m_ArchiveFileIndex->m_Hashes;
+            *entries = archive->m_ArchiveFileIndex->m_Entries;
+        }
+        else
+        {
+            uint32_t entry_offset = dmEndian::ToNetwork(archive->m_ArchiveIndex->m_EntryDataOffset);
+            uint32_t hash_offset = dmEndian::ToNetwork(archive->m_ArchiveIndex->m_HashOffset);
+            *hashes = (const uint8_t*)((uintptr_t)archive->m_ArchiveIndex + hash_offset);
+            *entries = (const dmResourceArchive::EntryData*)((uintptr_t)archive->m_ArchiveIndex + entry_offset);
+        }
+    }
+
+    // Liveupdate entries aren't part of the bundle, and are verified when they are stored
+    static bool IsBundledEntry(const dmResourceArchive::EntryData* entry)
+    {
+        return (dmEndian::ToNetwork(entry->m_Flags) & dmResourceArchive::ENTRY_FLAG_LIVEUPDATE_DATA) == 0;
+    }
+
+    // The root hash covers the content hashes and the layout of all entries,
+    // so that a modified index invalidates the verification record
+    static void CreateRootHash(const uint8_t* hashes, const dmResourceArchive::EntryData* entries, uint32_t entry_count, uint8_t* root_hash)
+    {
+        uint8_t digests[VERIFY_ROOT_HASH_LEN*2];
+        dmCrypt::HashSha1(hashes, entry_count * dmResourceArchive::MAX_HASH, digests);
+        dmCrypt::HashSha1((const uint8_t*)entries, entry_count * sizeof(dmResourceArchive::EntryData), digests + VERIFY_ROOT_HASH_LEN);
+        dmCrypt::HashSha1(digests, sizeof(digests), root_hash);
+    }
+
+    static bool CreateVerifyRecord(const VerifyArchiveParams* params, const uint8_t* root_hash, VerifyRecord* record)
+    {
+        if (!params->m_IndexPath || !params->m_DataPath)
+        {
+            return false;
+        }
+
+        dmSys::StatInfo index_info;
+        dmSys::StatInfo data_info;
+        if (dmSys::RESULT_OK != dmSys::Stat(params->m_IndexPath, &index_info) ||
+            dmSys::RESULT_OK != dmSys::Stat(params->m_DataPath, &data_info))
+        {
+            return false;
+        }
+
+        memset(record, 0, sizeof(VerifyRecord));
+        record->m_Magic         = VERIFY_RECORD_MAGIC;
+        record->m_Version       = VERIFY_RECORD_VERSION;
+        record->m_IndexSize     = index_info.m_Size;
+        record->m_DataSize      = data_info.m_Size;
+        record->m_IndexModified = index_info.m_ModifiedTime;
+        record->m_DataModified  = data_info.m_ModifiedTime;
+        memcpy(record->m_RootHash, root_hash, VERIFY_ROOT_HASH_LEN);
+        return true;
+    }
+
+    static bool ReadVerifyRecord(const char* path, VerifyRecord* record)
+    {
+        FILE* f = fopen(path, "rb");
+        if (!f)
+        {
+            return false;
+        }
+        bool ok = fread(record, 1, sizeof(VerifyRecord), f) == sizeof(VerifyRecord);
+        fclose(f);
+        return ok;
+    }
+
+    static void WriteVerifyRecord(const char* path, const VerifyRecord* record)
+    {
+        FILE* f = fopen(path, "wb");
+        bool ok = f != 0 && fwrite(record, 1, sizeof(VerifyRecord), f) == sizeof(VerifyRecord);
+        if (f)
+        {
+            fclose(f);
+        }
+        if (!ok)
+        {
+            dmLogWarning("Failed to write archive verification record '%s'", path);
+            dmSys::Unlink(path);
+        }
+    }
+
+    static void VerifyArchiveChunks(VerifyArchiveContext* ctx)
+    {
+        dmArray<uint8_t> scratch;
+        const uint32_t chunk_count = ctx->m_Chunks.Size() - 1;
+        while (dmAtomicGet32(&ctx->m_Result) == RESULT_OK)
+        {
+            uint32_t chunk = (uint32_t)dmAtomicIncrement32(&ctx->m_NextChunk);
+            if (chunk >= chunk_count)
+            {
+                break;
+            }
+
+            for (uint32_t i = ctx->m_Chunks[chunk]; i < ctx->m_Chunks[chunk+1]; ++i)
+            {
+                const dmResourceArchive::EntryData* entry = &ctx->m_Entries[i];
+                if (!IsBundledEntry(entry))
+                {
+                    continue;
+                }
+
+                const uint8_t* hash = ctx->m_Hashes + dmResourceArchive::MAX_HASH * i;
+                Result r = VerifyArchiveEntry(ctx->m_Archive, entry, ctx->m_Algorithm, hash, ctx->m_HashLength, &scratch);
+                if (RESULT_OK != r)
+                {
+                    if (dmAtomicCompareStore32(&ctx->m_FailedEntry, (int32_t)i, -1) == -1)
+                    {
+                        dmAtomicStore32(&ctx->m_Result, r);
+                    }
+                    return;
+                }
+            }
+        }
+    }
+
+    static int32_t VerifyArchiveJobProcess(HJobContext, HJob, void* context, void*)
+    {
+        VerifyArchiveContext* ctx = (VerifyArchiveContext*)context;
+        VerifyArchiveChunks(ctx);
+        // Signal from the worker thread, as the caller doesn't pump the job callbacks while waiting
+        dmAtomicIncrement32(&ctx->m_JobsDone);
+        return 0;
+    }
+
+    Result VerifyArchive(const HManifest manifest, dmResourceArchive::HArchiveIndexContainer archive, const VerifyArchiveParams* params)
+    {
+        if (manifest == 0x0 || archive == 0x0)
+        {
+            return RESULT_INVALID_DATA;
+        }
+
+        const uint32_t entry_count = dmResourceArchive::GetEntryCount(archive);
+
+        VerifyArchiveContext ctx;
+        ctx.m_Archive       = archive;
+        ctx.m_Algorithm     = manifest->m_DDFData->m_Header.m_ResourceHashAlgorithm;
+        ctx.m_HashLength    = dmResource::HashLength(ctx.m_Algorithm);
+        ctx.m_NextChunk     = 0;
+        ctx.m_Result        = RESULT_OK;
+        ctx.m_FailedEntry   = -1;
+        ctx.m_JobsDone      = 0;
+        GetArchiveIndexData(archive, &ctx.m_Hashes, &ctx.m_Entries);
+
+        uint8_t root_hash[VERIFY_ROOT_HASH_LEN];
+        CreateRootHash(ctx.m_Hashes, ctx.m_Entries, entry_count, root_hash);
+
+        VerifyRecord record;
+        bool has_record = params->m_RecordPath && CreateVerifyRecord(params, root_hash, &record);
+        if (has_record)
+        {
+            VerifyRecord prev_record;
+            if (ReadVerifyRecord(params->m_RecordPath, &prev_record) && memcmp(&prev_record, &record, sizeof(VerifyRecord)) == 0)
+            {
+                dmLogDebug("Archive '%s' is unchanged since it was last verified", params->m_DataPath);
+                return RESULT_OK;
+            }
+        }
+
+        // Split the entries into chunks of roughly the same number of bytes
+        uint32_t chunk_size = params->m_ChunkSize ? params->m_ChunkSize : 1;
+        uint32_t bytes = 0;
+        ctx.m_Chunks.SetCapacity(16);
+        ctx.m_Chunks.Push(0);
+        for (uint32_t i = 0; i < entry_count; ++i)
+        {
+            if (!IsBundledEntry(&ctx.m_Entries[i]))
+            {
+                continue;
+            }
+
+            bytes += dmResourceArchive::GetEntryStoredSize(&ctx.m_Entries[i]);
+            if (bytes >= chunk_size && i+1 < entry_count)
+            {
+                if (ctx.m_Chunks.Full())
+                {
+                    ctx.m_Chunks.OffsetCapacity(ctx.m_Chunks.Capacity());
+                }
+                ctx.m_Chunks.Push(i+1);
+                bytes = 0;
+            }
+        }
+        if (ctx.m_Chunks.Full())
+        {
+            ctx.m_Chunks.OffsetCapacity(1);
+        }
+        ctx.m_Chunks.Push(entry_count);
+
+        const uint32_t chunk_count = ctx.m_Chunks.Size() - 1;
+
+        // Reading from file on several threads requires reads at absolute offsets
+        uint32_t num_jobs = 0;
+        HJobContext job_context = params->m_JobContext;
+        if (job_context && chunk_count > 1 && (archive->m_ArchiveFileIndex->m_IsMemMapped || dmResourceArchive::CanReadEntryConcurrently()))
+        {
+            num_jobs = dmMath::Min(JobSystemGetWorkerCount(job_context), chunk_count - 1);
+        }
+
+        uint32_t num_pushed = 0;
+        for (uint32_t i = 0; i < num_jobs; ++i)
+        {
+            Job job = {0};
+            job.m_Process = VerifyArchiveJobProcess;
+            job.m_Context = &ctx;
+            HJob hjob = JobSystemCreateJob(job_context, &job);
+            if (!hjob || JOBSYSTEM_RESULT_OK != JobSystemPushJob(job_context, hjob))
+            {
+                break;
+            }
+            ++num_pushed;
+        }
+
+        // The calling thread takes part in the work, and then waits for the workers to finish their current chunk
+        VerifyArchiveChunks(&ctx);
+        while ((uint32_t)dmAtomicGet32(&ctx.m_JobsDone) < num_pushed)
+        {
+            dmTime::Sleep(100);
+        }
+
+        Result result = (Result)ctx.m_Result;
+        if (RESULT_OK != result)
+        {
+            char hash_buffer[dmResourceArchive::MAX_HASH*2+1];
+            dmResource::BytesToHexString(ctx.m_Hashes + dmResourceArchive::MAX_HASH * ctx.m_FailedEntry, ctx.m_HashLength, hash_buffer, sizeof(hash_buffer));
+            dmLogError("Archive entry %s failed verification: %s", hash_buffer, dmResource::ResultToString(result));
+            if (params->m_RecordPath)
+            {
+                dmSys::Unlink(params->m_RecordPath);
+            }
+            return result;
+        }
+
+        if (has_record)
+        {
+            WriteVerifyRecord(params->m_RecordPath, &record);
+        }
+        return RESULT_OK;
+    }
+
     Result VerifyManifestSupportedEngineVersion(const dmResource::HManifest manifest)
     {
         // Calculate running dmengine version SHA1 hash
@@ -139,6 +475,12 @@ namespace dmResource
     //     return VerifyManifestBundledResources(dmResource::GetManifest(g_LiveUpdate.m_ResourceFactory)->m_ArchiveIndex, manifest);
     // }
 
+    // For unit test
+    uint32_t GetVerifiedEntryCount()
+    {
+        return (uint32_t)dmAtomicGet32(&g_VerifiedEntryCount);
+    }
+
     // For unit test
     int VerifyArchiveIndex(dmResourceArchive::HArchiveIndexContainer archive)
     {
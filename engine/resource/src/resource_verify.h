@@ -17,6 +17,9 @@
 
 #include <stdint.h>
 
+#include <dlib/array.h>
+#include <dlib/jobsystem.h>
+
 #include "resource.h" // Result
 #include "resource_archive.h"
 #include <resource/liveupdate_ddf.h>
@@ -31,6 +34,26 @@ namespace dmResource
 
     Result VerifyResourcesBundled(dmResourceArchive::HArchiveIndexContainer base_archive, const Manifest* manifest);
 
+    // Verifies the data of a single archive entry, as stored on disc, against its content hash.
+    // The scratch buffer is used when the data needs to be read from file, and may be reused between calls.
+    Result VerifyArchiveEntry(dmResourceArchive::HArchiveIndexContainer archive, const dmResourceArchive::EntryData* entry,
+                              dmLiveUpdateDDF::HashAlgorithm algorithm, const uint8_t* hash, uint32_t hash_len, dmArray<uint8_t>* scratch);
+
+    struct VerifyArchiveParams
+    {
+        VerifyArchiveParams();
+
+        HJobContext m_JobContext;   // If set, the work is shared with the worker threads of the job system
+        const char* m_IndexPath;    // Path to the .arci file. Needed for the verification record
+        const char* m_DataPath;     // Path to the .arcd file. Needed for the verification record
+        const char* m_RecordPath;   // If set, the result is cached and an unchanged archive is not verified again
+        uint32_t    m_ChunkSize;    // The approximate number of bytes hashed per work item
+    };
+
+    // Verifies the content hashes of all bundled entries in the archive.
+    // Returns RESULT_OK if all entries are valid, or if the verification record shows that the archive is unchanged since the last successful verification.
+    Result VerifyArchive(const HManifest manifest, dmResourceArchive::HArchiveIndexContainer archive, const VerifyArchiveParams* params);
+
     // Should be private, but is used in unit tests as well
     Result VerifyResourcesBundled(dmLiveUpdateDDF::ResourceEntry* entries, uint32_t num_entries, uint32_t hash_len, dmResourceArchive::HArchiveIndexContainer archive_index);
 
@@ -38,6 +61,8 @@ namespace dmResource
     // Unit tests ->
     // For testing ascending order
     int VerifyArchiveIndex(dmResourceArchive::HArchiveIndexContainer archive);
+    // The number of archive entries that have been hashed by VerifyArchiveEntry()
+    uint32_t GetVerifiedEntryCount();
 }
 #endif // DM_RESOURCE_VERIFY_H
 
@@ -233,6 +233,23 @@ TEST_F(ArchiveProvidersMulti, ReadFile)
     }
 }
 
+TEST_F(ArchiveProvidersMulti, GetResourceContentHash)
+{
+    dmhash_t content_hash4 = 0;
+    dmhash_t content_hash1 = 0;
+    ASSERT_EQ(dmResource::RESULT_OK, dmResourceMounts::GetResourceContentHash(m_Mounts, dmHashString64("/archive_data/file4.adc"), "/archive_data/file4.adc", &content_hash4));
+    ASSERT_EQ(dmResource::RESULT_OK, dmResourceMounts::GetResourceContentHash(m_Mounts, dmHashString64("/archive_data/file1.adc"), "/archive_data/file1.adc", &content_hash1));
+    ASSERT_NE(0U, content_hash4);
+    ASSERT_NE(content_hash1, content_hash4);
+
+    // The file mount has no manifest
+    dmhash_t content_hash;
+    ASSERT_EQ(dmResource::RESULT_RESOURCE_NOT_FOUND, dmResourceMounts::GetResourceContentHash(m_Mounts, dmHashString64("/somedata.adc"), "/somedata.adc", &content_hash));
+    // Exists in archive, but overridden in file mount
+    ASSERT_EQ(dmResource::RESULT_RESOURCE_NOT_FOUND, dmResourceMounts::GetResourceContentHash(m_Mounts, dmHashString64("/archive_data/file2.adc"), "/archive_data/file2.adc", &content_hash));
+    ASSERT_EQ(dmResource::RESULT_RESOURCE_NOT_FOUND, dmResourceMounts::GetResourceContentHash(m_Mounts, dmHashString64("/not_exist.adc"), "/not_exist.adc", &content_hash));
+}
+
 TEST_F(ArchiveProvidersMulti, ReadCustomFile)
 {
     uint8_t     file0_data[] = {0,1,2,3,4,5,6,7,8,9};
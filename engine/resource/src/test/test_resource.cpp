@@ -16,8 +16,10 @@
 
 #include <dlib/atomic.h>
 #include <dlib/dstrings.h>
+#include <dlib/endian.hpp>
 #include <dlib/hash.h>
 #include <dlib/log.h>
+#include <dlib/math.h>
 #include <dlib/message.h>
 #include <dlib/socket.h>
 #include <dlib/sys.h>
@@ -68,6 +70,12 @@ extern unsigned char RESOURCES_ARCD[];
 extern uint32_t RESOURCES_ARCD_SIZE;
 extern unsigned char RESOURCES_DMANIFEST[];
 extern uint32_t RESOURCES_DMANIFEST_SIZE;
+extern unsigned char RESOURCES_SHARED_ARCI[];
+extern uint32_t RESOURCES_SHARED_ARCI_SIZE;
+extern unsigned char RESOURCES_SHARED_ARCD[];
+extern uint32_t RESOURCES_SHARED_ARCD_SIZE;
+extern unsigned char RESOURCES_SHARED_DMANIFEST[];
+extern uint32_t RESOURCES_SHARED_DMANIFEST_SIZE;
 
 #define EXT_CONSTANTS(prefix, ext)\
     static const dmhash_t prefix##_EXT_HASH = dmHashString64(ext);\
@@ -241,6 +249,7 @@ protected:
         m_FooResourceCreateCallCount = 0;
         m_FooResourcePostCreateCallCount = 0;
         m_FooResourceDestroyCallCount = 0;
+        m_FooResourceCreateDelay = 0;
 
         dmResource::NewFactoryParams params;
         params.m_MaxResources = 16;
@@ -309,6 +318,7 @@ public:
     uint32_t           m_FooResourceCreateCallCount;
     uint32_t           m_FooResourcePostCreateCallCount;
     uint32_t           m_FooResourceDestroyCallCount;
+    uint32_t           m_FooResourceCreateDelay; // microseconds
 
     dmResource::HFactory m_Factory;
     const char*        m_ResourceName;
@@ -398,6 +408,8 @@ dmResource::Result FooResourceCreate(const dmResource::ResourceCreateParams* par
     HResourceType type = params->m_Type;
     GetResourceTest* self = (GetResourceTest*) ResourceTypeGetContext(type);
     self->m_FooResourceCreateCallCount++;
+    if (self->m_FooResourceCreateDelay)
+        dmTime::Sleep(self->m_FooResourceCreateDelay);
 
     TestResource::ResourceFoo* resource_foo;
 
@@ -925,6 +937,155 @@ TEST_P(GetResourceTest, PreloadGetAbort)
     }
 }
 
+TEST_P(GetResourceTest, PreloadCreateBudget)
+{
+    // Each create takes longer than the time given to an update, so there must be at most one create per update
+    m_FooResourceCreateDelay = 20000;
+    dmResource::HPreloader pr = dmResource::NewPreloader(m_Factory, m_ResourceName);
+
+    dmResource::Result r = dmResource::RESULT_PENDING;
+    for (uint32_t i = 0; i < 200 && r == dmResource::RESULT_PENDING; ++i)
+    {
+        uint32_t create_count = m_FooResourceCreateCallCount + m_ResourceContainerCreateCallCount;
+        r = dmResource::UpdatePreloader(pr, 0, 0, 10000);
+        ASSERT_GE(create_count + 1, m_FooResourceCreateCallCount + m_ResourceContainerCreateCallCount);
+        if (r == dmResource::RESULT_PENDING)
+            dmTime::Sleep(1000);
+    }
+
+    ASSERT_EQ(dmResource::RESULT_OK, r);
+    ASSERT_EQ(2U, m_FooResourceCreateCallCount);
+    ASSERT_EQ(2U, m_FooResourcePostCreateCallCount);
+    ASSERT_EQ(1U, m_ResourceContainerCreateCallCount);
+    dmResource::DeletePreloader(pr);
+}
+
+class PrefetchResourceTest : public GetResourceTest
+{
+protected:
+    void NewPrefetchFactory(const char* record_dir, uint32_t flags)
+    {
+        dmResource::DeleteFactory(m_Factory);
+
+        dmResource::NewFactoryParams params;
+        params.m_MaxResources = 16;
+        params.m_Flags = flags;
+        params.m_PrefetchRecordDir = record_dir;
+        m_Factory = dmResource::NewFactory(&params, GetParam());
+        ASSERT_NE((void*) 0, m_Factory);
+
+        dmResource::Result e;
+        e = dmResource::RegisterType(m_Factory, "cont", this, &ResourceContainerPreload, &ResourceContainerCreate, 0, &ResourceContainerDestroy, 0);
+        ASSERT_EQ(dmResource::RESULT_OK, e);
+        e = dmResource::RegisterType(m_Factory, "foo", this, 0, &FooResourceCreate, &FooResourcePostCreate, &FooResourceDestroy, 0);
+        ASSERT_EQ(dmResource::RESULT_OK, e);
+    }
+};
+
+const char* params_prefetch_resource_paths[] = {
+    "build/src/test",
+};
+INSTANTIATE_TEST_CASE_P(PrefetchResourceTestURI, PrefetchResourceTest, jc_test_values_in(params_prefetch_resource_paths));
+
+TEST_P(PrefetchResourceTest, RecordAndReplay)
+{
+    const char* prefetch_path = "build/src/test/_prefetch/test.cont.prefetch";
+    dmSys::Unlink(prefetch_path);
+
+    // Record the resources loaded by the preloader
+    NewPrefetchFactory("build/src/test", RESOURCE_FACTORY_FLAGS_EMPTY);
+    void* resource = 0;
+    ASSERT_EQ(dmResource::RESULT_OK, PreloaderGet(m_Factory, m_ResourceName, &resource));
+    dmResource::Release(m_Factory, resource);
+
+    char buffer[512] = {0};
+    FILE* f = fopen(prefetch_path, "rb");
+    ASSERT_NE((FILE*) 0, f);
+    size_t nread = fread(buffer, 1, sizeof(buffer) - 1, f);
+    fclose(f);
+    ASSERT_GT(nread, 0U);
+    ASSERT_EQ(buffer, strstr(buffer, "# prefetch 1\n"));
+    ASSERT_NE((char*) 0, strstr(buffer, " /test01.foo\n"));
+    ASSERT_NE((char*) 0, strstr(buffer, " /test02.foo\n"));
+    ASSERT_EQ((char*) 0, strstr(buffer, " /test.cont\n"));
+
+    // Replay the list, the result must be the same as when discovering the resources
+    NewPrefetchFactory(0, RESOURCE_FACTORY_FLAGS_PREFETCH);
+    m_FooResourceCreateCallCount = 0;
+    m_FooResourceDestroyCallCount = 0;
+
+    // Both resources are queued from the list up front, before the container is loaded
+    dmResource::HPreloader pr = dmResource::NewPreloader(m_Factory, m_ResourceName);
+    ASSERT_EQ(2U, dmResource::GetPreloaderPrefetchCount(pr));
+    dmResource::Result r = dmResource::RESULT_PENDING;
+    for (uint32_t i = 0; i < 33 && r == dmResource::RESULT_PENDING; ++i)
+    {
+        r = dmResource::UpdatePreloader(pr, 0, 0, 30*1000);
+        if (r == dmResource::RESULT_PENDING)
+            dmTime::Sleep(30000);
+    }
+    ASSERT_EQ(dmResource::RESULT_OK, r);
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(m_Factory, m_ResourceName, (void**) &resource));
+    dmResource::DeletePreloader(pr);
+    ASSERT_EQ(2U, m_FooResourceCreateCallCount);
+    ASSERT_EQ(0U, m_FooResourceDestroyCallCount);
+
+    // Only the container holds the references to the prefetched resources
+    ASSERT_EQ(1U, dmResource::GetRefCount(m_Factory, dmHashString64("/test01.foo")));
+    ASSERT_EQ(1U, dmResource::GetRefCount(m_Factory, dmHashString64("/test02.foo")));
+    dmResource::Release(m_Factory, resource);
+    ASSERT_EQ(2U, m_FooResourceDestroyCallCount);
+
+    dmSys::Unlink(prefetch_path);
+}
+
+class LazyVerifyResourceTest : public GetResourceTest
+{
+protected:
+    void NewLazyVerifyFactory()
+    {
+        dmResource::DeleteFactory(m_Factory);
+
+        dmResource::NewFactoryParams params;
+        params.m_MaxResources = 16;
+        params.m_ArchiveVerifyMode = dmResource::ARCHIVE_VERIFY_MODE_LAZY;
+        m_Factory = dmResource::NewFactory(&params, GetParam());
+        ASSERT_NE((void*) 0, m_Factory);
+
+        dmResource::Result e;
+        e = dmResource::RegisterType(m_Factory, "cont", this, &ResourceContainerPreload, &ResourceContainerCreate, 0, &ResourceContainerDestroy, 0);
+        ASSERT_EQ(dmResource::RESULT_OK, e);
+        e = dmResource::RegisterType(m_Factory, "foo", this, 0, &FooResourceCreate, &FooResourcePostCreate, &FooResourceDestroy, 0);
+        ASSERT_EQ(dmResource::RESULT_OK, e);
+    }
+};
+
+const char* params_lazy_verify_resource_paths[] = {
+    "dmanif:build/src/test/resources_pb.dmanifest",
+};
+INSTANTIATE_TEST_CASE_P(LazyVerifyResourceTestURI, LazyVerifyResourceTest, jc_test_values_in(params_lazy_verify_resource_paths));
+
+TEST_P(LazyVerifyResourceTest, VerifyOnFirstRead)
+{
+    // Nothing is verified when the archive is mounted
+    uint32_t verified_count = dmResource::GetVerifiedEntryCount();
+    NewLazyVerifyFactory();
+    ASSERT_EQ(verified_count, dmResource::GetVerifiedEntryCount());
+
+    // The container and its two resources are verified when they are read
+    void* resource = 0;
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(m_Factory, m_ResourceName, &resource));
+    ASSERT_EQ(verified_count + 3, dmResource::GetVerifiedEntryCount());
+    dmResource::Release(m_Factory, resource);
+    ASSERT_EQ(2U, m_FooResourceDestroyCallCount);
+
+    // The entries are read again, but only verified the first time
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(m_Factory, m_ResourceName, &resource));
+    ASSERT_EQ(verified_count + 3, dmResource::GetVerifiedEntryCount());
+    ASSERT_EQ(4U, m_FooResourceCreateCallCount);
+    dmResource::Release(m_Factory, resource);
+}
+
 
 dmResource::Result RecreateResourceCreate(const dmResource::ResourceCreateParams* params)
 {
@@ -1048,6 +1209,135 @@ TEST(dmResource, Builtins)
     dmResource::DeleteFactory(factory);
 }
 
+// file8 and file9 have identical content
+static const char* SHARED_PATH8 = "/archive_data/file8.adc";
+static const char* SHARED_PATH9 = "/archive_data/file9.adc";
+
+static dmResource::HFactory NewSharedContentFactory(uint32_t flags)
+{
+    dmResource::NewFactoryParams params;
+    params.m_MaxResources = 16;
+    params.m_Flags = flags;
+
+    params.m_ArchiveIndex.m_Data    = (const void*) RESOURCES_SHARED_ARCI;
+    params.m_ArchiveIndex.m_Size    = RESOURCES_SHARED_ARCI_SIZE;
+
+    params.m_ArchiveData.m_Data     = (const void*) RESOURCES_SHARED_ARCD;
+    params.m_ArchiveData.m_Size     = RESOURCES_SHARED_ARCD_SIZE;
+
+    params.m_ArchiveManifest.m_Data = (const void*) RESOURCES_SHARED_DMANIFEST;
+    params.m_ArchiveManifest.m_Size = RESOURCES_SHARED_DMANIFEST_SIZE;
+
+    dmResource::HFactory factory = dmResource::NewFactory(&params, ".");
+    if (factory)
+    {
+        dmResource::RegisterType(factory, "adc", 0, 0, AdResourceCreate, 0, AdResourceDestroy, 0);
+    }
+    return factory;
+}
+
+TEST(SharedContent, IdenticalContent)
+{
+    dmResource::HFactory factory = NewSharedContentFactory(RESOURCE_FACTORY_FLAGS_SHARE_CONTENT);
+    ASSERT_NE((void*) 0, factory);
+
+    void* resource8;
+    void* resource9;
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(factory, SHARED_PATH8, &resource8));
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(factory, SHARED_PATH9, &resource9));
+    ASSERT_STREQ("shared_data", (const char*) resource8);
+
+    ASSERT_EQ(resource8, resource9);
+    ASSERT_EQ(2U, dmResource::GetRefCount(factory, resource8));
+
+    dmResource::Release(factory, resource9);
+    dmResource::Release(factory, resource8);
+    dmResource::DeleteFactory(factory);
+}
+
+TEST(SharedContent, NotSharedByDefault)
+{
+    dmResource::HFactory factory = NewSharedContentFactory(0);
+    ASSERT_NE((void*) 0, factory);
+
+    void* resource8;
+    void* resource9;
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(factory, SHARED_PATH8, &resource8));
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(factory, SHARED_PATH9, &resource9));
+
+    ASSERT_NE(resource8, resource9);
+    ASSERT_STREQ((const char*) resource8, (const char*) resource9);
+    ASSERT_EQ(1U, dmResource::GetRefCount(factory, resource8));
+    ASSERT_EQ(1U, dmResource::GetRefCount(factory, resource9));
+
+    dmResource::Release(factory, resource9);
+    dmResource::Release(factory, resource8);
+    dmResource::DeleteFactory(factory);
+}
+
+TEST(SharedContent, AliasLookup)
+{
+    dmResource::HFactory factory = NewSharedContentFactory(RESOURCE_FACTORY_FLAGS_SHARE_CONTENT);
+    ASSERT_NE((void*) 0, factory);
+
+    void* resource8;
+    void* resource9;
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(factory, SHARED_PATH8, &resource8));
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(factory, SHARED_PATH9, &resource9));
+
+    // The alias is found by path, and by path hash
+    HResourceDescriptor descriptor;
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::GetDescriptor(factory, SHARED_PATH9, &descriptor));
+    ASSERT_EQ(resource8, ResourceDescriptorGetResource(descriptor));
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::GetDescriptorByHash(factory, dmHashString64(SHARED_PATH9), &descriptor));
+    ASSERT_EQ(resource8, ResourceDescriptorGetResource(descriptor));
+    ASSERT_EQ(2U, dmResource::GetRefCount(factory, dmHashString64(SHARED_PATH9)));
+
+    // Getting the alias again doesn't load anything
+    void* resource9_again;
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(factory, SHARED_PATH9, &resource9_again));
+    ASSERT_EQ(resource8, resource9_again);
+    ASSERT_EQ(3U, dmResource::GetRefCount(factory, dmHashString64(SHARED_PATH8)));
+
+    dmResource::Release(factory, resource9_again);
+    dmResource::Release(factory, resource9);
+    dmResource::Release(factory, resource8);
+    dmResource::DeleteFactory(factory);
+}
+
+TEST(SharedContent, AliasRemovedWithResource)
+{
+    dmResource::HFactory factory = NewSharedContentFactory(RESOURCE_FACTORY_FLAGS_SHARE_CONTENT);
+    ASSERT_NE((void*) 0, factory);
+
+    void* resource8;
+    void* resource9;
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(factory, SHARED_PATH8, &resource8));
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(factory, SHARED_PATH9, &resource9));
+
+    // The alias keeps the resource alive, even after the path that loaded it is released
+    dmResource::Release(factory, resource8);
+    HResourceDescriptor descriptor;
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::GetDescriptor(factory, SHARED_PATH9, &descriptor));
+    ASSERT_EQ(1U, dmResource::GetRefCount(factory, resource9));
+
+    dmResource::Release(factory, resource9);
+    ASSERT_EQ(dmResource::RESULT_NOT_LOADED, dmResource::GetDescriptor(factory, SHARED_PATH8, &descriptor));
+    ASSERT_EQ(dmResource::RESULT_NOT_LOADED, dmResource::GetDescriptor(factory, SHARED_PATH9, &descriptor));
+    ASSERT_EQ(0U, dmResource::GetRefCount(factory, dmHashString64(SHARED_PATH9)));
+
+    // Loading the paths in the other order makes file9 the owner
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(factory, SHARED_PATH9, &resource9));
+    ASSERT_EQ(dmResource::RESULT_OK, dmResource::Get(factory, SHARED_PATH8, &resource8));
+    ASSERT_EQ(resource9, resource8);
+    ASSERT_EQ(2U, dmResource::GetRefCount(factory, resource9));
+
+    dmResource::Release(factory, resource9);
+    dmResource::Release(factory, resource8);
+    ASSERT_EQ(dmResource::RESULT_NOT_LOADED, dmResource::GetDescriptor(factory, SHARED_PATH8, &descriptor));
+    dmResource::DeleteFactory(factory);
+}
+
 struct ReloadData {
     ReloadData(): m_Old(0), m_New(0) {}
     int m_Old;
@@ -1589,6 +1879,299 @@ TEST_F(ResourceTest, ManifestBundledResourcesVerificationFail)
     dmResource::DeleteManifest(manifest);
 }
 
+TEST_F(ResourceTest, ArchiveVerification)
+{
+    dmResource::Manifest* manifest;
+    dmResource::Result result = dmResource::LoadManifestFromBuffer(RESOURCES_DMANIFEST, RESOURCES_DMANIFEST_SIZE, &manifest);
+    ASSERT_EQ(dmResource::RESULT_OK, result);
+
+    dmResourceArchive::ArchiveIndexContainer* archive = 0;
+    dmResourceArchive::Result r = dmResourceArchive::WrapArchiveBuffer(RESOURCES_ARCI, RESOURCES_ARCI_SIZE, true, RESOURCES_ARCD, RESOURCES_ARCD_SIZE, true, &archive);
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, r);
+
+    // Single threaded
+    dmResource::VerifyArchiveParams params;
+    result = dmResource::VerifyArchive(manifest, archive, &params);
+    ASSERT_EQ(dmResource::RESULT_OK, result);
+
+    // One entry per chunk, shared with the job thread
+    params.m_JobContext = m_JobContext;
+    params.m_ChunkSize = 1;
+    result = dmResource::VerifyArchive(manifest, archive, &params);
+    ASSERT_EQ(dmResource::RESULT_OK, result);
+
+    dmResourceArchive::Delete(archive);
+    dmResource::DeleteManifest(manifest);
+}
+
+TEST_F(ResourceTest, ArchiveVerificationFail)
+{
+    dmResource::Manifest* manifest;
+    dmResource::Result result = dmResource::LoadManifestFromBuffer(RESOURCES_DMANIFEST, RESOURCES_DMANIFEST_SIZE, &manifest);
+    ASSERT_EQ(dmResource::RESULT_OK, result);
+
+    uint8_t* data = (uint8_t*)malloc(RESOURCES_ARCD_SIZE);
+    for (uint32_t i = 0; i < RESOURCES_ARCD_SIZE; ++i)
+    {
+        data[i] = RESOURCES_ARCD[i] ^ 0xFF;
+    }
+
+    dmResourceArchive::ArchiveIndexContainer* archive = 0;
+    dmResourceArchive::Result r = dmResourceArchive::WrapArchiveBuffer(RESOURCES_ARCI, RESOURCES_ARCI_SIZE, true, data, RESOURCES_ARCD_SIZE, true, &archive);
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, r);
+
+    dmResource::VerifyArchiveParams params;
+    params.m_JobContext = m_JobContext;
+    params.m_ChunkSize = 1;
+    result = dmResource::VerifyArchive(manifest, archive, &params);
+    ASSERT_EQ(dmResource::RESULT_INVALID_DATA, result);
+
+    dmResourceArchive::Delete(archive);
+    dmResource::DeleteManifest(manifest);
+    free(data);
+}
+
+static bool ReadVerifyRecord(const char* path, uint8_t* buffer, uint32_t buffer_size, uint32_t* size)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return false;
+    *size = (uint32_t)fread(buffer, 1, buffer_size, f);
+    fclose(f);
+    return true;
+}
+
+TEST_F(ResourceTest, ArchiveVerificationRecord)
+{
+    dmResource::Manifest* manifest;
+    dmResource::Result result = dmResource::LoadManifestFromBuffer(RESOURCES_DMANIFEST, RESOURCES_DMANIFEST_SIZE, &manifest);
+    ASSERT_EQ(dmResource::RESULT_OK, result);
+
+    char index_path[512];
+    char data_path[512];
+    char record_path[512];
+    dmTestUtil::MakeHostPath(index_path, sizeof(index_path), "build/src/test/resources.arci");
+    dmTestUtil::MakeHostPath(data_path, sizeof(data_path), "build/src/test/resources.arcd");
+    dmTestUtil::MakeHostPath(record_path, sizeof(record_path), "build/src/test/resources.verified");
+    dmSys::Unlink(record_path);
+
+    dmResourceArchive::HArchiveIndexContainer archive = 0;
+    dmResourceArchive::Result r = dmResourceArchive::LoadArchiveFromFile(index_path, data_path, &archive);
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, r);
+
+    dmResource::VerifyArchiveParams params;
+    params.m_JobContext = m_JobContext;
+    params.m_IndexPath = index_path;
+    params.m_DataPath = data_path;
+    params.m_RecordPath = record_path;
+    uint32_t verified_count = dmResource::GetVerifiedEntryCount();
+    result = dmResource::VerifyArchive(manifest, archive, &params);
+    ASSERT_EQ(dmResource::RESULT_OK, result);
+    ASSERT_LT(verified_count, dmResource::GetVerifiedEntryCount());
+
+    uint8_t record[256];
+    uint32_t record_size = 0;
+    ASSERT_TRUE(ReadVerifyRecord(record_path, record, sizeof(record), &record_size));
+    ASSERT_LT(0U, record_size);
+
+    // Unchanged archive, the record is used as is and no entry is hashed
+    verified_count = dmResource::GetVerifiedEntryCount();
+    result = dmResource::VerifyArchive(manifest, archive, &params);
+    ASSERT_EQ(dmResource::RESULT_OK, result);
+    ASSERT_EQ(verified_count, dmResource::GetVerifiedEntryCount());
+
+    // An invalid record triggers a new verification, which writes a new record
+    FILE* f = fopen(record_path, "wb");
+    ASSERT_NE((FILE*)0, f);
+    fwrite("invalid", 1, 7, f);
+    fclose(f);
+
+    result = dmResource::VerifyArchive(manifest, archive, &params);
+    ASSERT_EQ(dmResource::RESULT_OK, result);
+    ASSERT_LT(verified_count, dmResource::GetVerifiedEntryCount());
+
+    uint8_t new_record[256];
+    uint32_t new_record_size = 0;
+    ASSERT_TRUE(ReadVerifyRecord(record_path, new_record, sizeof(new_record), &new_record_size));
+    ASSERT_EQ(record_size, new_record_size);
+    ASSERT_EQ(0, memcmp(record, new_record, record_size));
+
+    dmSys::Unlink(record_path);
+    dmResourceArchive::Delete(archive);
+    dmResource::DeleteManifest(manifest);
+}
+
+TEST_F(ResourceTest, ArchiveEntryVerification)
+{
+    dmResource::Manifest* manifest;
+    dmResource::Result result = dmResource::LoadManifestFromBuffer(RESOURCES_DMANIFEST, RESOURCES_DMANIFEST_SIZE, &manifest);
+    ASSERT_EQ(dmResource::RESULT_OK, result);
+
+    dmResourceArchive::ArchiveIndexContainer* archive = 0;
+    dmResourceArchive::Result r = dmResourceArchive::WrapArchiveBuffer(RESOURCES_ARCI, RESOURCES_ARCI_SIZE, true, RESOURCES_ARCD, RESOURCES_ARCD_SIZE, true, &archive);
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, r);
+
+    dmLiveUpdateDDF::HashAlgorithm algorithm = manifest->m_DDFData->m_Header.m_ResourceHashAlgorithm;
+    uint32_t hash_len = dmResource::HashLength(algorithm);
+
+    dmArray<uint8_t> scratch;
+    uint32_t num_verified = 0;
+    for (uint32_t i = 0; i < manifest->m_DDFData->m_Resources.m_Count; ++i)
+    {
+        dmLiveUpdateDDF::ResourceEntry* entry = &manifest->m_DDFData->m_Resources.m_Data[i];
+        if (entry->m_Flags != dmLiveUpdateDDF::BUNDLED)
+            continue;
+
+        dmResourceArchive::EntryData* entry_data = 0;
+        ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::FindEntry(archive, entry->m_Hash.m_Data.m_Data, hash_len, &entry_data));
+
+        result = dmResource::VerifyArchiveEntry(archive, entry_data, algorithm, entry->m_Hash.m_Data.m_Data, hash_len, &scratch);
+        ASSERT_EQ(dmResource::RESULT_OK, result);
+
+        uint8_t wrong_hash[dmResourceArchive::MAX_HASH];
+        memcpy(wrong_hash, entry->m_Hash.m_Data.m_Data, hash_len);
+        wrong_hash[0] ^= 0xFF;
+        result = dmResource::VerifyArchiveEntry(archive, entry_data, algorithm, wrong_hash, hash_len, &scratch);
+        ASSERT_EQ(dmResource::RESULT_INVALID_DATA, result);
+        ++num_verified;
+    }
+    ASSERT_LT(0U, num_verified);
+
+    dmResourceArchive::Delete(archive);
+    dmResource::DeleteManifest(manifest);
+}
+
+struct ArchiveStreamerContext
+{
+    dmResourceArchive::HArchiveIndexContainer   m_Archive;
+    dmArray<dmResourceArchive::EntryData*>*     m_Entries;
+    dmArray<uint8_t*>*                          m_Expected;
+    uint32_t                                    m_ChunkSize;
+    uint32_t                                    m_Iterations;
+    uint64_t                                    m_BytesRead;
+    uint32_t                                    m_Errors;
+};
+
+// Streams all entries in small chunks, the same way the streaming resources read from the archive
+static void ArchiveStreamerThread(void* _ctx)
+{
+    ArchiveStreamerContext* ctx = (ArchiveStreamerContext*)_ctx;
+    uint8_t buffer[4096];
+    for (uint32_t iter = 0; iter < ctx->m_Iterations; ++iter)
+    {
+        for (uint32_t i = 0; i < ctx->m_Entries->Size(); ++i)
+        {
+            dmResourceArchive::EntryData* entry = (*ctx->m_Entries)[i];
+            const uint8_t* expected = (*ctx->m_Expected)[i];
+            uint32_t size = dmEndian::ToNetwork(entry->m_ResourceSize);
+
+            for (uint32_t offset = 0; offset < size; offset += ctx->m_ChunkSize)
+            {
+                uint32_t nread = 0;
+                dmResourceArchive::Result r = dmResourceArchive::ReadEntryPartial(ctx->m_Archive, entry, offset, ctx->m_ChunkSize, buffer, &nread);
+                uint32_t expected_nread = dmMath::Min(ctx->m_ChunkSize, size - offset);
+                if (r != dmResourceArchive::RESULT_OK || nread != expected_nread || memcmp(buffer, expected + offset, nread) != 0)
+                {
+                    ctx->m_Errors++;
+                    return;
+                }
+                ctx->m_BytesRead += nread;
+            }
+        }
+    }
+}
+
+// Several streamers reading from the same (non memory mapped) archive file at once
+TEST_F(ResourceTest, ArchiveConcurrentStreaming)
+{
+    if (!dmResourceArchive::CanReadEntryConcurrently())
+    {
+        dmLogWarning("Concurrent archive reads not supported on this platform, skipping test");
+        return;
+    }
+
+    dmResource::Manifest* manifest;
+    dmResource::Result result = dmResource::LoadManifestFromBuffer(RESOURCES_DMANIFEST, RESOURCES_DMANIFEST_SIZE, &manifest);
+    ASSERT_EQ(dmResource::RESULT_OK, result);
+
+    char index_path[512];
+    char data_path[512];
+    dmTestUtil::MakeHostPath(index_path, sizeof(index_path), "build/src/test/resources.arci");
+    dmTestUtil::MakeHostPath(data_path, sizeof(data_path), "build/src/test/resources.arcd");
+
+    dmResourceArchive::HArchiveIndexContainer archive = 0;
+    dmResourceArchive::Result r = dmResourceArchive::LoadArchiveFromFile(index_path, data_path, &archive);
+    ASSERT_EQ(dmResourceArchive::RESULT_OK, r);
+    ASSERT_FALSE(archive->m_ArchiveFileIndex->m_IsMemMapped);
+
+    uint32_t hash_len = dmResource::HashLength(manifest->m_DDFData->m_Header.m_ResourceHashAlgorithm);
+
+    dmArray<dmResourceArchive::EntryData*> entries;
+    dmArray<uint8_t*> expected;
+    for (uint32_t i = 0; i < manifest->m_DDFData->m_Resources.m_Count; ++i)
+    {
+        dmLiveUpdateDDF::ResourceEntry* entry = &manifest->m_DDFData->m_Resources.m_Data[i];
+        if (entry->m_Flags != dmLiveUpdateDDF::BUNDLED)
+            continue;
+
+        dmResourceArchive::EntryData* entry_data = 0;
+        ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::FindEntry(archive, entry->m_Hash.m_Data.m_Data, hash_len, &entry_data));
+
+        // The partial reads are only done on the stored data as is
+        uint32_t flags = dmEndian::ToNetwork(entry_data->m_Flags);
+        if (flags & (dmResourceArchive::ENTRY_FLAG_ENCRYPTED | dmResourceArchive::ENTRY_FLAG_COMPRESSED))
+            continue;
+
+        uint8_t* data = (uint8_t*)malloc(dmEndian::ToNetwork(entry_data->m_ResourceSize));
+        ASSERT_EQ(dmResourceArchive::RESULT_OK, dmResourceArchive::ReadEntry(archive, entry_data, data));
+
+        entries.OffsetCapacity(1);
+        entries.Push(entry_data);
+        expected.OffsetCapacity(1);
+        expected.Push(data);
+    }
+    ASSERT_LT(0U, entries.Size());
+
+    const uint32_t num_streamers = 8;
+    ArchiveStreamerContext contexts[num_streamers];
+    dmThread::Thread threads[num_streamers];
+
+    uint64_t tstart = dmTime::GetMonotonicTime();
+    for (uint32_t i = 0; i < num_streamers; ++i)
+    {
+        ArchiveStreamerContext& ctx = contexts[i];
+        ctx.m_Archive       = archive;
+        ctx.m_Entries       = &entries;
+        ctx.m_Expected      = &expected;
+        ctx.m_ChunkSize     = 3 + i; // odd sizes, so the chunks don't line up between the streamers
+        ctx.m_Iterations    = 2000;
+        ctx.m_BytesRead     = 0;
+        ctx.m_Errors        = 0;
+        threads[i] = dmThread::New(&ArchiveStreamerThread, 0x10000, &ctx, "streamer");
+    }
+
+    uint64_t total_bytes = 0;
+    for (uint32_t i = 0; i < num_streamers; ++i)
+    {
+        dmThread::Join(threads[i]);
+        ASSERT_EQ(0U, contexts[i].m_Errors);
+        total_bytes += contexts[i].m_BytesRead;
+    }
+    uint64_t tend = dmTime::GetMonotonicTime();
+
+    double elapsed = (tend - tstart) / 1000000.0;
+    dmLogInfo("%u streamers read %llu bytes in %.3f s (%.2f MB/s)", num_streamers, (unsigned long long)total_bytes, elapsed,
+                elapsed > 0.0 ? (total_bytes / (1024.0 * 1024.0)) / elapsed : 0.0);
+    ASSERT_LT(0U, total_bytes);
+
+    for (uint32_t i = 0; i < expected.Size(); ++i)
+    {
+        free(expected[i]);
+    }
+    dmResourceArchive::Delete(archive);
+    dmResource::DeleteManifest(manifest);
+}
+
 TEST(ResourceUtil, HexDigestLength)
 {
     uint32_t actual = 0;
@@ -1766,6 +2349,110 @@ TEST_F(ResourceTest, PartialReadTest)
     dmSys::Unlink(path);
 }
 
+class ResourceStreamingTest : public jc_test_base_class
+{
+protected:
+    void SetUp() override
+    {
+        JobSystemCreateParams job_thread_create_param = {0};
+        job_thread_create_param.m_ThreadCount    = 4;
+        m_JobContext = JobSystemCreate(&job_thread_create_param);
+
+        dmResource::NewFactoryParams params;
+        params.m_MaxResources = 16;
+        params.m_Flags = RESOURCE_FACTORY_FLAGS_RELOAD_SUPPORT;
+        params.m_JobThreadContext = m_JobContext;
+
+        factory = dmResource::NewFactory(&params, MOUNT_DIR);
+        ASSERT_NE((void*) 0, factory);
+    }
+
+    void TearDown() override
+    {
+        if (factory != NULL)
+        {
+            dmResource::DeleteFactory(factory);
+        }
+        JobSystemDestroy(m_JobContext);
+    }
+
+    dmResource::HFactory factory;
+    HJobContext m_JobContext;
+};
+
+// Several resources streaming at once, with the chunks being read in parallel on the job threads
+TEST_F(ResourceStreamingTest, ConcurrentPartialReads)
+{
+    dmResource::Result e;
+    e = dmResource::RegisterType(factory, "foo", 0, 0, &StreamResourceCreate, 0, &StreamResourceDestroy, 0);
+    ASSERT_EQ(dmResource::RESULT_OK, e);
+
+    dmResource::HResourceType type;
+    e = dmResource::GetTypeFromExtension(factory, "foo", &type);
+    ASSERT_EQ(dmResource::RESULT_OK, e);
+
+    const uint32_t preload_size = 64;
+    ResourceTypeSetStreaming(type, preload_size);
+
+    const uint32_t num_resources = 4;
+    const uint32_t data_len = 16 * 1024;
+    uint8_t* expected_data = (uint8_t*)malloc(data_len);
+    for (uint32_t i = 0; i < data_len; ++i)
+    {
+        expected_data[i] = uint8_t((i * 7) % 0xFF);
+    }
+
+    char resource_names[num_resources][64];
+    char paths[num_resources][256];
+    for (uint32_t i = 0; i < num_resources; ++i)
+    {
+        dmSnPrintf(resource_names[i], sizeof(resource_names[i]), "/__teststreaming%u__.foo", i);
+        dmTestUtil::MakeHostPathf(paths[i], sizeof(paths[i]), "%s/%s", TMP_DIR, resource_names[i]);
+
+        FILE* f = fopen(paths[i], "wb");
+        ASSERT_NE((FILE*) 0, f);
+        fwrite(expected_data, 1, data_len, f);
+        fclose(f);
+    }
+
+    StreamTestResource* resources[num_resources];
+    for (uint32_t i = 0; i < num_resources; ++i)
+    {
+        dmResource::Result fr = dmResource::Get(factory, resource_names[i], (void**) &resources[i]);
+        ASSERT_EQ(dmResource::RESULT_OK, fr);
+        ASSERT_EQ(true, resources[i]->m_IsBufferPartial);
+    }
+
+    uint64_t tstart = dmTime::GetMonotonicTime();
+    bool done = false;
+    while (!done)
+    {
+        uint64_t tend = dmTime::GetMonotonicTime();
+        if ((tend - tstart) > 10 * 1000000)
+        {
+            dmLogError("Timeout!");
+            ASSERT_TRUE(false);
+        }
+
+        JobSystemUpdate(m_JobContext, 2000); // pump the results from the job threads to the main thread
+
+        done = true;
+        for (uint32_t i = 0; i < num_resources; ++i)
+        {
+            ASSERT_ARRAY_EQ_LEN(expected_data, resources[i]->m_Data, resources[i]->m_Offset);
+            done &= resources[i]->m_Offset >= data_len;
+        }
+    }
+
+    for (uint32_t i = 0; i < num_resources; ++i)
+    {
+        ASSERT_EQ(data_len, resources[i]->m_Offset);
+        dmResource::Release(factory, resources[i]);
+        dmSys::Unlink(paths[i]);
+    }
+    free(expected_data);
+}
+
 
 
 
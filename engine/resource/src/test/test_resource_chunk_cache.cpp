@@ -15,9 +15,12 @@
 #include <stdio.h>
 #include <stdint.h>
 
+#include <dlib/atomic.h>
+#include <dlib/dstrings.h>
 #include <dlib/log.h>
 #include <dlib/hash.h>
 #include <dlib/testutil.h>
+#include <dlib/thread.h>
 
 #include "../resource_chunk_cache.h"
 
@@ -262,6 +265,157 @@ TEST(ResourceChunkCache, Multiple)
 }
 
 
+TEST(ResourceChunkCache, ReadAndStats)
+{
+    uint32_t chunk_size = 8;
+    const char* data = "Chunk 1\0Chunk 2\0Chunk 3\0";
+    ResourceCacheChunk chunk1 = {(uint8_t*)data + chunk_size*0, chunk_size*0, chunk_size};
+    ResourceCacheChunk chunk2 = {(uint8_t*)data + chunk_size*1, chunk_size*1, chunk_size};
+    ResourceCacheChunk chunk3 = {(uint8_t*)data + chunk_size*2, chunk_size*2, chunk_size};
+    uint64_t path_hash1 = dmHashString64("fileA");
+    uint64_t path_hash2 = dmHashString64("fileB");
+
+    HResourceChunkCache cache = ResourceChunkCacheCreate(4*chunk_size);
+    ASSERT_TRUE(ResourceChunkCachePut(cache, path_hash1, RESOURCE_CHUNK_CACHE_NO_EVICT, &chunk1));
+    ASSERT_TRUE(ResourceChunkCachePut(cache, path_hash1, RESOURCE_CHUNK_CACHE_DEFAULT, &chunk2));
+
+    // Reads over the chunk boundary
+    char buffer[32] = {0};
+    ASSERT_EQ(10u, ResourceChunkCacheRead(cache, path_hash1, 4, 10, (uint8_t*)buffer));
+    ASSERT_ARRAY_EQ_LEN(data + 4, buffer, 10);
+
+    // Stops at the first missing chunk
+    ASSERT_EQ(12u, ResourceChunkCacheRead(cache, path_hash1, 4, 20, (uint8_t*)buffer));
+    ASSERT_EQ(0u, ResourceChunkCacheRead(cache, path_hash1, 16, 8, (uint8_t*)buffer));
+    ASSERT_EQ(0u, ResourceChunkCacheRead(cache, path_hash2, 0, 8, (uint8_t*)buffer));
+
+    ResourceChunkCacheStats stats;
+    ResourceChunkCacheGetStats(cache, &stats);
+    ASSERT_EQ(4u, stats.m_Hits);
+    ASSERT_EQ(3u, stats.m_Misses);
+    ASSERT_EQ(0u, stats.m_Evictions);
+
+    // Prefetching: the first missing chunk within the window
+    uint32_t file_size = chunk_size*3;
+    uint32_t prefetch_offset = 0;
+    ASSERT_FALSE(ResourceChunkCacheGetPrefetchOffset(cache, path_hash1, 4, chunk_size, 2, file_size, &prefetch_offset));
+    ASSERT_TRUE(ResourceChunkCacheGetPrefetchOffset(cache, path_hash1, 4, chunk_size, 3, file_size, &prefetch_offset));
+    ASSERT_EQ(16u, prefetch_offset);
+
+    ASSERT_TRUE(ResourceChunkCachePut(cache, path_hash1, RESOURCE_CHUNK_CACHE_DEFAULT, &chunk3));
+    ASSERT_FALSE(ResourceChunkCacheGetPrefetchOffset(cache, path_hash1, 4, chunk_size, 3, file_size, &prefetch_offset));
+
+    // Wraps around at the end of the file
+    ResourceChunkCacheEvictPathHash(cache, path_hash1);
+    ASSERT_TRUE(ResourceChunkCachePut(cache, path_hash1, RESOURCE_CHUNK_CACHE_DEFAULT, &chunk3));
+    ASSERT_TRUE(ResourceChunkCacheGetPrefetchOffset(cache, path_hash1, 20, chunk_size, 2, file_size, &prefetch_offset));
+    ASSERT_EQ(0u, prefetch_offset);
+
+    // The least recently used chunk is evicted, regardless of which file it belongs to
+    ResourceCacheChunk chunkb = {(uint8_t*)data, 0, chunk_size};
+    ASSERT_TRUE(ResourceChunkCachePut(cache, path_hash2, RESOURCE_CHUNK_CACHE_DEFAULT, &chunkb));
+    ASSERT_TRUE(ResourceChunkCachePut(cache, path_hash1, RESOURCE_CHUNK_CACHE_DEFAULT, &chunk1));
+    ASSERT_TRUE(ResourceChunkCachePut(cache, path_hash1, RESOURCE_CHUNK_CACHE_DEFAULT, &chunk2));
+    ASSERT_EQ(4u, ResourceChunkCacheGetNumChunks(cache));
+
+    ResourceCacheChunk getter;
+    ASSERT_TRUE(ResourceChunkCacheGet(cache, path_hash1, 16, &getter)); // touch chunk 3, so that the file B chunk is the oldest
+    ASSERT_TRUE(ResourceChunkCacheEvictMemory(cache, chunk_size));
+    ASSERT_FALSE(ResourceChunkCacheGet(cache, path_hash2, 0, &getter));
+    ASSERT_TRUE(ResourceChunkCacheGet(cache, path_hash1, 0, &getter));
+
+    ResourceChunkCacheGetStats(cache, &stats);
+    ASSERT_EQ(1u, stats.m_Evictions);
+
+    ASSERT_TRUE(ResourceChunkCacheVerify(cache));
+    ResourceChunkCacheDestroy(cache);
+}
+
+struct ChunkCacheThreadContext
+{
+    HResourceChunkCache m_Cache;
+    const uint8_t*      m_Data;
+    uint32_t            m_ChunkSize;
+    uint32_t            m_NumChunks;
+    uint32_t            m_Index;
+    int32_atomic_t      m_Errors;
+};
+
+static void ChunkCacheThread(void* _ctx)
+{
+    ChunkCacheThreadContext* ctx = (ChunkCacheThreadContext*)_ctx;
+    char path[32];
+    dmSnPrintf(path, sizeof(path), "file%u", ctx->m_Index);
+    dmhash_t path_hash = dmHashString64(path);
+
+    uint8_t buffer[64];
+    for (uint32_t iteration = 0; iteration < 200; ++iteration)
+    {
+        for (uint32_t i = 0; i < ctx->m_NumChunks; ++i)
+        {
+            uint32_t offset = i * ctx->m_ChunkSize;
+            uint32_t nread = ResourceChunkCacheRead(ctx->m_Cache, path_hash, offset, ctx->m_ChunkSize, buffer);
+            if (nread == 0)
+            {
+                ResourceCacheChunk chunk = {(uint8_t*)ctx->m_Data + offset, offset, ctx->m_ChunkSize};
+                if (!ResourceChunkCacheCanFit(ctx->m_Cache, chunk.m_Size))
+                    ResourceChunkCacheEvictMemory(ctx->m_Cache, chunk.m_Size);
+                ResourceChunkCachePut(ctx->m_Cache, path_hash, RESOURCE_CHUNK_CACHE_DEFAULT, &chunk); // may fail if another thread filled the cache
+            }
+            else if (nread != ctx->m_ChunkSize || memcmp(buffer, ctx->m_Data + offset, nread) != 0)
+            {
+                dmAtomicIncrement32(&ctx->m_Errors);
+            }
+        }
+    }
+}
+
+TEST(ResourceChunkCache, Threads)
+{
+    const uint32_t num_threads = 4;
+    const uint32_t chunk_size = 64;
+    const uint32_t num_chunks = 16;
+
+    uint8_t data[chunk_size * num_chunks];
+    for (uint32_t i = 0; i < sizeof(data); ++i)
+    {
+        data[i] = (uint8_t)(i * 13);
+    }
+
+    // Room for about half of the chunks, to force evictions
+    HResourceChunkCache cache = ResourceChunkCacheCreate(num_threads * num_chunks * chunk_size / 2);
+
+    ChunkCacheThreadContext contexts[num_threads];
+    dmThread::Thread threads[num_threads];
+    for (uint32_t i = 0; i < num_threads; ++i)
+    {
+        ChunkCacheThreadContext& ctx = contexts[i];
+        ctx.m_Cache = cache;
+        ctx.m_Data = data;
+        ctx.m_ChunkSize = chunk_size;
+        ctx.m_NumChunks = num_chunks;
+        ctx.m_Index = i;
+        ctx.m_Errors = 0;
+        threads[i] = dmThread::New(ChunkCacheThread, 0x80000, (void*)&ctx, "chunkcache");
+    }
+
+    for (uint32_t i = 0; i < num_threads; ++i)
+    {
+        dmThread::Join(threads[i]);
+        ASSERT_EQ(0, contexts[i].m_Errors);
+    }
+
+    ASSERT_TRUE(ResourceChunkCacheVerify(cache));
+    ASSERT_EQ(ResourceChunkCacheGetNumChunks(cache) * chunk_size, ResourceChunkCacheGetUsedMemory(cache));
+
+    ResourceChunkCacheStats stats;
+    ResourceChunkCacheGetStats(cache, &stats);
+    ASSERT_LT(0u, stats.m_Evictions);
+
+    ResourceChunkCacheDestroy(cache);
+}
+
+
 extern "C" void dmExportedSymbols();
 
 int main(int argc, char **argv)
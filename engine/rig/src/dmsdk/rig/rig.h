@@ -21,6 +21,7 @@
 #include <dmsdk/dlib/align.h>
 #include <dmsdk/dlib/hash.h>
 #include <dmsdk/dlib/hashtable.h>
+#include <dmsdk/dlib/jobsystem.h>
 #include <dmsdk/dlib/transform.h>
 #include <dmsdk/dlib/vmath.h>
 #include <dmsdk/graphics/graphics.h>
@@ -138,6 +139,7 @@ namespace dmRig
 
     struct NewContextParams {
         uint32_t     m_MaxRigInstanceCount;
+        HJobContext  m_JobContext; // If set, the instance poses are animated in parallel on the worker threads
     };
 
     typedef void (*RigEventCallback)(RigEventType, void*, void* userdata1, void* userdata2);
@@ -206,6 +208,9 @@ namespace dmRig
     bool ResetIKTarget(HRigInstance instance, dmhash_t constraint_id);
     void SetEnabled(HRigInstance instance, bool enabled);
     bool GetEnabled(HRigInstance instance);
+    /** Sample the pose once every \a interval updates (1 = every update). The animation cursor and events still advance every update. */
+    void SetUpdateInterval(HRigInstance instance, uint32_t interval);
+    uint32_t GetUpdateInterval(HRigInstance instance);
     bool IsValid(HRigInstance instance);
     uint32_t GetBoneCount(HRigInstance instance);
     uint32_t GetMaxBoneCount(HRigInstance instance);
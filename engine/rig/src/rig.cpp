@@ -15,14 +15,17 @@
 #include "rig.h"
 #include "rig_private.h"
 
+#include <dlib/atomic.h>
 #include <dlib/log.h>
 #include <dlib/math.h>
 #include <dlib/vmath.h>
 #include <dlib/profile.h>
+#include <dlib/time.h>
 #include <dmsdk/dlib/object_pool.h>
 #include <graphics/graphics.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 namespace dmRig
@@ -31,6 +34,8 @@ namespace dmRig
 
     static const dmhash_t NULL_ANIMATION = dmHashString64("");
     static const float CURSOR_EPSILON = 0.0001f;
+    // Number of rig instances a job animates at a time
+    static const uint32_t ANIMATE_BATCH_SIZE = 16;
 
     const float TEXTURE_TRANSFORM_2D_IDENTITY[9] = {
         1.0f, 0.0f, 0.0f,
@@ -39,12 +44,17 @@ namespace dmRig
     };
 
     static void DoAnimate(HRigContext context, RigInstance* instance, float dt);
+    static void UpdatePlayers(HRigContext context, RigInstance* instance, float dt);
+    static void AnimatePose(HRigContext context, RigInstance* instance);
     static bool DoPostUpdate(RigInstance* instance);
 
     struct RigContext
     {
         dmObjectPool<HRigInstance>      m_Instances;
         PoseMatrixCache                 m_PoseMatrixCache;
+        HJobContext                     m_JobContext;
+        // The animation jobs pushed during Animate()
+        dmArray<HJob>                   m_AnimateJobs;
         // Temporary scratch buffers used for store pose as transform and matrices
         // (avoids modifying the real pose transform data during rendering).
         dmArray<dmVMath::Matrix4>       m_ScratchPoseMatrixBuffer;
@@ -73,6 +83,7 @@ namespace dmRig
 
         context->m_Instances.SetCapacity(params.m_MaxRigInstanceCount);
         context->m_ScratchPoseMatrixBuffer.SetCapacity(0);
+        context->m_JobContext = params.m_JobContext;
 
         ResetPoseMatrixCache(&context->m_PoseMatrixCache);
 
@@ -402,6 +413,59 @@ namespace dmRig
         return slerp(frac, Quat(data[i+0], data[i+1], data[i+2], data[i+3]), Quat(data[i+0+4], data[i+1+4], data[i+2+4], data[i+3+4]));
     }
 
+    // Compressed samples are 48 bits each, see AnimationTrack in rig_ddf.proto
+    static const uint32_t COMPRESSED_SAMPLE_SIZE = 6;
+    // All components of a unit quaternion, except the largest one, are within [-1/sqrt(2), 1/sqrt(2)]
+    static const float QUAT_COMPONENT_RANGE = 0.70710678f;
+
+    static inline uint64_t ReadCompressedSample(const uint8_t* data, uint32_t sample)
+    {
+        const uint8_t* p = data + sample * COMPRESSED_SAMPLE_SIZE;
+        return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) | ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40);
+    }
+
+    static inline Vector3 DecodeVec3(const uint8_t* data, uint32_t sample, const Vector3& min, const Vector3& scale)
+    {
+        uint64_t v = ReadCompressedSample(data, sample);
+        Vector3 q((float)(v & 0xFFFF), (float)((v >> 16) & 0xFFFF), (float)((v >> 32) & 0xFFFF));
+        return min + mulPerElem(q, scale);
+    }
+
+    static inline Quat DecodeQuat(const uint8_t* data, uint32_t sample)
+    {
+        uint64_t v = ReadCompressedSample(data, sample);
+        uint32_t largest = (uint32_t)(v >> 45) & 0x3;
+        Vector3 q((float)((v >> 30) & 0x7FFF), (float)((v >> 15) & 0x7FFF), (float)(v & 0x7FFF));
+        Vector3 c = (q * (2.0f / 32767.0f) - Vector3(1.0f)) * QUAT_COMPONENT_RANGE;
+        float w = sqrtf(dmMath::Max(0.0f, 1.0f - lengthSqr(c)));
+
+        float smallest[3] = { c.getX(), c.getY(), c.getZ() };
+        float out[4];
+        for (uint32_t i = 0, j = 0; i < 4; ++i)
+        {
+            out[i] = i == largest ? w : smallest[j++];
+        }
+        return Quat(out[0], out[1], out[2], out[3]);
+    }
+
+    static Vector3 SampleCompressedVec3(uint32_t sample, float frac, const uint8_t* data, uint32_t data_size, const float* range)
+    {
+        uint32_t last = data_size / COMPRESSED_SAMPLE_SIZE - 1;
+        Vector3 min(range[0], range[1], range[2]);
+        Vector3 scale = Vector3(range[3], range[4], range[5]) * (1.0f / 65535.0f);
+        Vector3 v0 = DecodeVec3(data, dmMath::Min(sample, last), min, scale);
+        Vector3 v1 = DecodeVec3(data, dmMath::Min(sample + 1, last), min, scale);
+        return lerp(frac, v0, v1);
+    }
+
+    static Quat SampleCompressedQuat(uint32_t sample, float frac, const uint8_t* data, uint32_t data_size)
+    {
+        uint32_t last = data_size / COMPRESSED_SAMPLE_SIZE - 1;
+        Quat q0 = DecodeQuat(data, dmMath::Min(sample, last));
+        Quat q1 = DecodeQuat(data, dmMath::Min(sample + 1, last));
+        return slerp(frac, q0, q1);
+    }
+
     static float CursorToTime(float cursor, float duration, bool backwards, bool once_pingpong)
     {
         float t = cursor;
@@ -611,7 +675,12 @@ namespace dmRig
                 }
                 dmTransform::Transform& transform = pose[*bone_index].m_Local;
 
-                if (track->m_Positions.m_Count > 0)
+                if (track->m_CompressedPositions.m_Count > 0)
+                {
+                    Vector3 v = SampleCompressedVec3(sample, fraction, track->m_CompressedPositions.m_Data, track->m_CompressedPositions.m_Count, track->m_PositionsRange.m_Data);
+                    transform.SetTranslation(lerp(blend_weight, transform.GetTranslation(), v));
+                }
+                else if (track->m_Positions.m_Count > 0)
                 {
                     Vector3 v;
                     if (track->m_Positions.m_Count == 3)
@@ -621,7 +690,12 @@ namespace dmRig
 
                     transform.SetTranslation(lerp(blend_weight, transform.GetTranslation(), v));
                 }
-                if (track->m_Rotations.m_Count > 0)
+                if (track->m_CompressedRotations.m_Count > 0)
+                {
+                    Quat q = SampleCompressedQuat(sample, fraction, track->m_CompressedRotations.m_Data, track->m_CompressedRotations.m_Count);
+                    transform.SetRotation(slerp(blend_weight, transform.GetRotation(), q));
+                }
+                else if (track->m_Rotations.m_Count > 0)
                 {
                     Quat q;
                     if (track->m_Rotations.m_Count == 4)
@@ -631,7 +705,12 @@ namespace dmRig
 
                     transform.SetRotation(slerp(blend_weight, transform.GetRotation(), q));
                 }
-                if (track->m_Scale.m_Count > 0)
+                if (track->m_CompressedScale.m_Count > 0)
+                {
+                    Vector3 s = SampleCompressedVec3(sample, fraction, track->m_CompressedScale.m_Data, track->m_CompressedScale.m_Count, track->m_ScaleRange.m_Data);
+                    transform.SetScale(lerp(blend_weight, transform.GetScale(), s));
+                }
+                else if (track->m_Scale.m_Count > 0)
                 {
                     Vector3 s;
                     if (track->m_Scale.m_Count == 3)
@@ -645,6 +724,52 @@ namespace dmRig
         }
     }
 
+    struct AnimateJobContext
+    {
+        HRigContext         m_Context;
+        RigInstance* const* m_Instances;
+        uint32_t            m_InstanceCount;
+        int32_atomic_t      m_NextBatch;
+        int32_atomic_t      m_BatchesDone;
+        int32_atomic_t      m_RefCount; // the main thread and each pushed job
+    };
+
+    static void ReleaseAnimateJobContext(AnimateJobContext* ctx)
+    {
+        if (dmAtomicDecrement32(&ctx->m_RefCount) == 1)
+        {
+            free(ctx);
+        }
+    }
+
+    static void AnimateBatches(AnimateJobContext* ctx)
+    {
+        for (;;)
+        {
+            uint32_t start = (uint32_t)dmAtomicIncrement32(&ctx->m_NextBatch) * ANIMATE_BATCH_SIZE;
+            if (start >= ctx->m_InstanceCount)
+            {
+                break;
+            }
+
+            uint32_t end = dmMath::Min(start + ANIMATE_BATCH_SIZE, ctx->m_InstanceCount);
+            for (uint32_t i = start; i < end; ++i)
+            {
+                AnimatePose(ctx->m_Context, ctx->m_Instances[i]);
+            }
+            dmAtomicIncrement32(&ctx->m_BatchesDone);
+        }
+    }
+
+    static int32_t AnimateJobProcess(HJobContext, HJob, void* context, void*)
+    {
+        DM_PROFILE("RigAnimateJob");
+        AnimateJobContext* ctx = (AnimateJobContext*)context;
+        AnimateBatches(ctx);
+        ReleaseAnimateJobContext(ctx);
+        return 0;
+    }
+
     static void Animate(HRigContext context, float dt)
     {
         DM_PROFILE("RigAnimate");
@@ -659,16 +784,79 @@ namespace dmRig
         cache_pose_matrices.SetCapacity(size);
         cache_pose_matrices.SetSize(size);
 
-        // animate each rig instance
-        // the final step of DoAnimate will commit the bone poses to the pose
-        // matrix cache which is resized above
+        // advance the players of each rig instance on the main thread,
+        // since the event callbacks may not be called from other threads
         const dmArray<RigInstance*>& instances = context->m_Instances.GetRawObjects();
         uint32_t n = instances.Size();
         for (uint32_t i = 0; i < n; ++i)
         {
-            RigInstance* instance = instances[i];
-            DoAnimate(context, instance, dt);
+            UpdatePlayers(context, instances[i], dt);
+        }
+
+        uint32_t batch_count = (n + ANIMATE_BATCH_SIZE - 1) / ANIMATE_BATCH_SIZE;
+        uint32_t num_jobs = 0;
+        if (context->m_JobContext && batch_count > 1)
+        {
+            num_jobs = dmMath::Min(JobSystemGetWorkerCount(context->m_JobContext), batch_count - 1);
+        }
+
+        if (num_jobs == 0)
+        {
+            for (uint32_t i = 0; i < n; ++i)
+            {
+                AnimatePose(context, instances[i]);
+            }
+            return;
+        }
+
+        // the instances are independent from here on, and each one writes
+        // to its own entry in the pose matrix cache which is resized above.
+        // The context is released by the last one using it, as a job may still
+        // be starting up when this function returns (it will find no work left)
+        AnimateJobContext* ctx = (AnimateJobContext*)malloc(sizeof(AnimateJobContext));
+        ctx->m_Context       = context;
+        ctx->m_Instances     = instances.Begin();
+        ctx->m_InstanceCount = n;
+        ctx->m_NextBatch     = 0;
+        ctx->m_BatchesDone   = 0;
+        ctx->m_RefCount      = 1;
+
+        dmArray<HJob>& jobs = context->m_AnimateJobs;
+        EnsureSize(jobs, num_jobs);
+        jobs.SetSize(0);
+        for (uint32_t i = 0; i < num_jobs; ++i)
+        {
+            Job job = {0};
+            job.m_Process = AnimateJobProcess;
+            job.m_Context = ctx;
+            dmAtomicIncrement32(&ctx->m_RefCount);
+            HJob hjob = JobSystemCreateJob(context->m_JobContext, &job);
+            if (!hjob || JOBSYSTEM_RESULT_OK != JobSystemPushJob(context->m_JobContext, hjob))
+            {
+                // The push only fails when the job system is shutting down, and the job won't run
+                dmAtomicDecrement32(&ctx->m_RefCount);
+                break;
+            }
+            jobs.Push(hjob);
+        }
+
+        // The main thread takes part in the work. The jobs that haven't started by then are canceled,
+        // so we only wait for the batches that the workers are currently animating
+        AnimateBatches(ctx);
+        for (uint32_t i = 0; i < jobs.Size(); ++i)
+        {
+            if (JOBSYSTEM_RESULT_CANCELED == JobSystemCancelJob(context->m_JobContext, jobs[i]))
+            {
+                dmAtomicDecrement32(&ctx->m_RefCount);
+            }
+        }
+        jobs.SetSize(0);
+
+        while ((uint32_t)dmAtomicGet32(&ctx->m_BatchesDone) < batch_count)
+        {
+            dmTime::Sleep(0);
         }
+        ReleaseAnimateJobContext(ctx);
     }
 
     static void ResetPose(const dmRigDDF::Skeleton* skeleton, dmArray<BonePose>& pose)
@@ -705,6 +893,7 @@ namespace dmRig
         }
     }
 
+    // Writes the pose to the cache entry of the instance. Instances have separate entries, so it's thread safe
     static void CommitPoseMatrixToCache(HRigContext context, HRigInstance instance)
     {
         uint32_t bone_count = GetBoneCount(instance);
@@ -727,8 +916,6 @@ namespace dmRig
             Matrix4& pose_matrix = pose_matrix_write_ptr[bi];
             pose_matrix = pose_matrix * bind_pose[bi].m_ModelToLocal;
         }
-
-        cache->m_MaxBoneCount = dmMath::Max(cache->m_MaxBoneCount, (uint32_t) instance->m_MaxBoneCount);
     }
 
     bool IsAnimating(HRigInstance instance)
@@ -738,14 +925,72 @@ namespace dmRig
     }
 
     static void DoAnimate(HRigContext context, RigInstance* instance, float dt)
+    {
+        UpdatePlayers(context, instance, dt);
+        AnimatePose(context, instance);
+    }
+
+    // Advances the players and posts the animation events. Also updates the shared state of the pose matrix cache.
+    static void UpdatePlayers(HRigContext context, RigInstance* instance, float dt)
     {
         // NOTE we previously checked for (!instance->m_Enabled || !instance->m_AddedToUpdate) here also
+        instance->m_AnimatePose = IsAnimating(instance);
+
+        if (GetBoneCount(instance) != 0 && instance->m_PoseMatrixCacheIndex != INVALID_POSE_MATRIX_CACHE_ENTRY)
+        {
+            PoseMatrixCache* cache = &context->m_PoseMatrixCache;
+            cache->m_MaxBoneCount = dmMath::Max(cache->m_MaxBoneCount, (uint32_t) instance->m_MaxBoneCount);
+        }
+
+        if (!instance->m_AnimatePose)
+        {
+            return;
+        }
+
+        // Only sample the pose every m_UpdateInterval updates, the players still advance every update
+        instance->m_SkipPose = instance->m_UpdateCounter != 0;
+        instance->m_UpdateCounter = (instance->m_UpdateCounter + 1) % instance->m_UpdateInterval;
+
+        UpdateBlend(instance, dt);
+
+        RigPlayer* player = GetPlayer(instance);
+        if (instance->m_Blending)
+        {
+            float fade_rate = instance->m_BlendTimer / instance->m_BlendDuration;
+            for (uint32_t pi = 0; pi < 2; ++pi)
+            {
+                RigPlayer* p = &instance->m_Players[pi];
+                // How much relative blending between the two players
+                float blend_weight = fade_rate;
+                if (player != p) {
+                    blend_weight = 1.0f - fade_rate;
+                }
+                UpdatePlayer(instance, p, dt, blend_weight);
+            }
+        }
+        else
+        {
+            UpdatePlayer(instance, player, dt, 1.0f);
+        }
+    }
+
+    // Samples the players into the pose, and commits it to the pose matrix cache.
+    // Only touches the instance itself, so instances may be animated in parallel.
+    static void AnimatePose(HRigContext context, RigInstance* instance)
+    {
+        if (instance->m_AnimatePose && instance->m_SkipPose)
+        {
+            // Keep the previous pose (and morph weights), but the cache is rewritten every frame
+            CommitPoseMatrixToCache(context, instance);
+            return;
+        }
+
         if (!instance->m_MorphSlots.Empty())
         {
             ResetMorphWeights(instance);
         }
 
-        if (!IsAnimating(instance))
+        if (!instance->m_AnimatePose)
         {
             // Skinned meshes sample the pose matrix cache every frame. If we skip the cache write while
             // idle, the vertex shader falls back to non-skinned positions which can cause a disparity
@@ -776,8 +1021,6 @@ namespace dmRig
             ik_animation[ii].m_Positive = ik->m_Positive;
         }
 
-        UpdateBlend(instance, dt);
-
         if (instance->m_Blending)
         {
             float fade_rate = instance->m_BlendTimer / instance->m_BlendDuration;
@@ -786,13 +1029,6 @@ namespace dmRig
             for (uint32_t pi = 0; pi < 2; ++pi)
             {
                 RigPlayer* p = &instance->m_Players[pi];
-                // How much relative blending between the two players
-                float blend_weight = fade_rate;
-                if (player != p) {
-                    blend_weight = 1.0f - fade_rate;
-                }
-
-                UpdatePlayer(instance, p, dt, blend_weight);
                 ApplyAnimation(instance, p, pose, ik_animation, alpha);
                 ApplyMorphAnimation(instance, p, alpha);
                 if (player == p)
@@ -807,7 +1043,6 @@ namespace dmRig
         }
         else
         {
-            UpdatePlayer(instance, player, dt, 1.0f);
             ApplyAnimation(instance, player, pose, ik_animation, 1.0f);
             ApplyMorphAnimation(instance, player, 1.0f);
         }
@@ -990,6 +1225,8 @@ namespace dmRig
         }
 
         player->m_Cursor = t;
+        // Make sure the new cursor is sampled on the next update
+        instance->m_UpdateCounter = 0;
 
         return dmRig::RESULT_OK;
     }
@@ -1083,62 +1320,8 @@ namespace dmRig
         }
 
         // Skinned data
-        const uint32_t* indices = mesh->m_BoneIndices.m_Data;
-        const float* weights = mesh->m_Weights.m_Data;
-        for (uint32_t i = 0; i < vertex_count; ++i)
-        {
-            const Vector3 normal_in(normals_in[i*3+0], normals_in[i*3+1], normals_in[i*3+2]);
-            Vector4 normal_out(0.0f, 0.0f, 0.0f, 0.0f);
-
-            const Vector3 tangent_in = has_tangents ? Vector3(tangents_in[i*4+0], tangents_in[i*4+1], tangents_in[i*4+2]) : Vector3(0,0,0);
-            const float tangent_handedness = has_tangents ? tangents_in[i*4+3] : 0.0f;
-            Vector4 tangent_out(0.0f, 0.0f, 0.0f, 0.0f);
-
-            const uint32_t bi_offset = i * 4;
-            const uint32_t* bone_indices = &indices[bi_offset];
-            const float* bone_weights = &weights[bi_offset];
-
-            if (bone_weights[0])
-            {
-                normal_out += (pose_matrices[bone_indices[0]] * normal_in) * bone_weights[0];
-                tangent_out += (pose_matrices[bone_indices[0]] * tangent_in) * bone_weights[0];
-                if (bone_weights[1])
-                {
-                    normal_out += (pose_matrices[bone_indices[1]] * normal_in) * bone_weights[1];
-                    tangent_out += (pose_matrices[bone_indices[1]] * tangent_in) * bone_weights[1];
-                    if (bone_weights[2])
-                    {
-                        normal_out += (pose_matrices[bone_indices[2]] * normal_in) * bone_weights[2];
-                        tangent_out += (pose_matrices[bone_indices[2]] * tangent_in) * bone_weights[2];
-                        if (bone_weights[3])
-                        {
-                            normal_out += (pose_matrices[bone_indices[3]] * normal_in) * bone_weights[3];
-                            tangent_out += (pose_matrices[bone_indices[3]] * tangent_in) * bone_weights[3];
-                        }
-                    }
-                }
-            }
-
-            normal = normal_matrix * normal_out.getXYZ();
-            if (lengthSqr(normal) > 0.0f) {
-                normalize(normal);
-            }
-            *normals_buffer++ = normal[0];
-            *normals_buffer++ = normal[1];
-            *normals_buffer++ = normal[2];
-
-            if (has_tangents)
-            {
-                tangent = normal_matrix * tangent_out;
-                if (lengthSqr(tangent) > 0.0f) {
-                    normalize(tangent);
-                }
-                *tangents_buffer++ = tangent[0];
-                *tangents_buffer++ = tangent[1];
-                *tangents_buffer++ = tangent[2];
-                *tangents_buffer++ = tangent_handedness;
-            }
-        }
+        SkinNormals(normals_in, tangents_in, mesh->m_BoneIndices.m_Data, mesh->m_Weights.m_Data, vertex_count,
+                    pose_matrices.Begin(), normal_matrix, normals_buffer, tangents_buffer);
     }
 
     static void GeneratePositionData(const dmRigDDF::Mesh* mesh, const Matrix4& model_matrix, const dmArray<Matrix4>& pose_matrices, float* out_buffer_world, float* out_buffer_local)
@@ -1173,53 +1356,8 @@ namespace dmRig
             return;
         }
 
-        const uint32_t* indices = mesh->m_BoneIndices.m_Data;
-        const float* weights = mesh->m_Weights.m_Data;
-        for (uint32_t i = 0; i < vertex_count; ++i)
-        {
-            Vector4 in_v;
-            in_v.setX(*positions++);
-            in_v.setY(*positions++);
-            in_v.setZ(*positions++);
-            in_v.setW(1.0f);
-
-            Vector4 out_p(0.0f, 0.0f, 0.0f, 0.0f);
-            const uint32_t bi_offset = i * 4;
-            const uint32_t* bone_indices = &indices[bi_offset];
-            const float* bone_weights = &weights[bi_offset];
-
-            if(bone_weights[0])
-            {
-                out_p += pose_matrices[bone_indices[0]] * in_v * bone_weights[0];
-                if(bone_weights[1])
-                {
-                    out_p += pose_matrices[bone_indices[1]] * in_v * bone_weights[1];
-                    if(bone_weights[2])
-                    {
-                        out_p += pose_matrices[bone_indices[2]] * in_v * bone_weights[2];
-                        if(bone_weights[3])
-                        {
-                            out_p += pose_matrices[bone_indices[3]] * in_v * bone_weights[3];
-                        }
-                    }
-                }
-            }
-
-            if (out_buffer_world)
-            {
-                v = model_matrix * Point3(out_p.getX(), out_p.getY(), out_p.getZ());
-                *out_buffer_world++ = v[0];
-                *out_buffer_world++ = v[1];
-                *out_buffer_world++ = v[2];
-            }
-            if (out_buffer_local)
-            {
-                *out_buffer_local++ = out_p.getX();
-                *out_buffer_local++ = out_p.getY();
-                *out_buffer_local++ = out_p.getZ();
-            }
-        }
-        return;
+        SkinPositions(positions, mesh->m_BoneIndices.m_Data, mesh->m_Weights.m_Data, vertex_count,
+                      pose_matrices.Begin(), model_matrix, out_buffer_world, out_buffer_local);
     }
 
     void SetMeshWriteAttributeParams(dmGraphics::WriteAttributeParams* params,
@@ -1605,6 +1743,21 @@ namespace dmRig
         instance->m_Enabled = enabled;
     }
 
+    void SetUpdateInterval(HRigInstance instance, uint32_t interval)
+    {
+        interval = dmMath::Clamp(interval, 1u, 255u);
+        if (instance->m_UpdateInterval != interval)
+        {
+            instance->m_UpdateInterval = (uint8_t)interval;
+            instance->m_UpdateCounter = 0;
+        }
+    }
+
+    uint32_t GetUpdateInterval(HRigInstance instance)
+    {
+        return instance->m_UpdateInterval;
+    }
+
     bool GetEnabled(HRigInstance instance)
     {
         return instance->m_Enabled;
@@ -1757,6 +1910,7 @@ namespace dmRig
         instance->m_PoseMatrixCacheIndex = INVALID_POSE_MATRIX_CACHE_ENTRY;
 
         instance->m_Enabled = 1;
+        instance->m_UpdateInterval = 1;
 
         SetModel(instance, instance->m_ModelId);
 
@@ -109,6 +109,15 @@ namespace dmRig
         return true;
     }
 
+    void SetUpdateInterval(HRigInstance instance, uint32_t interval)
+    {
+    }
+
+    uint32_t GetUpdateInterval(HRigInstance instance)
+    {
+        return 1;
+    }
+
     bool IsValid(HRigInstance instance)
     {
         return false;
@@ -105,13 +105,20 @@ namespace dmRig
         // Max bone count used by skeleton (if it is used) and meshset
         uint16_t                      m_MaxBoneCount;
         uint16_t                      m_PoseMatrixCacheIndex;
+        /// The pose is sampled once every m_UpdateInterval updates (see SetUpdateInterval)
+        uint8_t                       m_UpdateInterval;
+        uint8_t                       m_UpdateCounter;
         /// Current player index
         uint8_t                       m_CurrentPlayer : 1;
         /// Whether we are currently X-fading or not
         uint8_t                       m_Blending : 1;
         uint8_t                       m_Enabled : 1;
         uint8_t                       m_DoRender : 1;
-        uint8_t                       : 4;
+        /// Whether the pose is sampled from the players this frame (see UpdatePlayers)
+        uint8_t                       m_AnimatePose : 1;
+        /// Whether the previous pose is kept this frame, due to the update interval
+        uint8_t                       m_SkipPose : 1;
+        uint8_t                       : 2;
     };
 
     /** Pose matrix cache
@@ -132,6 +139,23 @@ namespace dmRig
     };
 
     PoseMatrixCache* GetPoseMatrixCache(HRigContext context);
+
+    // Skinning kernels (rig_skinning.cpp). Each vertex has 4 bone indices/weights, and the weights
+    // are ordered so that the first zero weight ends the influences of that vertex.
+    // The output buffers are tightly packed (3 floats per position/normal, 4 per tangent) and may be 0 if not wanted.
+
+    /// Skins the positions, writing the model space positions to out_local and the world space positions to out_world
+    void SkinPositions(const float* positions, const uint32_t* bone_indices, const float* bone_weights, uint32_t vertex_count,
+                       const dmVMath::Matrix4* pose_matrices, const dmVMath::Matrix4& model_matrix, float* out_world, float* out_local);
+    /// Skins the normals and (optional) tangents, and transforms them with the normal matrix
+    void SkinNormals(const float* normals, const float* tangents, const uint32_t* bone_indices, const float* bone_weights, uint32_t vertex_count,
+                     const dmVMath::Matrix4* pose_matrices, const dmVMath::Matrix4& normal_matrix, float* out_normals, float* out_tangents);
+
+    // Scalar versions of the kernels above, used when no SIMD instruction set is available
+    void SkinPositionsScalar(const float* positions, const uint32_t* bone_indices, const float* bone_weights, uint32_t vertex_count,
+                             const dmVMath::Matrix4* pose_matrices, const dmVMath::Matrix4& model_matrix, float* out_world, float* out_local);
+    void SkinNormalsScalar(const float* normals, const float* tangents, const uint32_t* bone_indices, const float* bone_weights, uint32_t vertex_count,
+                           const dmVMath::Matrix4* pose_matrices, const dmVMath::Matrix4& normal_matrix, float* out_normals, float* out_tangents);
 }
 
 #endif
@@ -0,0 +1,309 @@
+// Copyright 2020-2026 The Defold Foundation
+// Copyright 2014-2020 King
+// Copyright 2009-2014 Ragnar Svensson, Christian Murray
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "rig_private.h"
+
+#include <dlib/static_assert.h>
+#include <dlib/vmath.h>
+
+#if defined(__wasm_simd128__)
+    #define DM_RIG_SKINNING_WASM
+    #include <wasm_simd128.h>
+#elif defined(__SSE2__) || defined(_M_AMD64) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define DM_RIG_SKINNING_SSE2
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define DM_RIG_SKINNING_NEON
+    #include <arm_neon.h>
+#endif
+
+#if defined(DM_RIG_SKINNING_WASM) || defined(DM_RIG_SKINNING_SSE2) || defined(DM_RIG_SKINNING_NEON)
+    #define DM_RIG_SKINNING_SIMD
+#endif
+
+namespace dmRig
+{
+    using namespace dmVMath;
+
+    void SkinPositionsScalar(const float* positions, const uint32_t* indices, const float* weights, uint32_t vertex_count,
+                             const Matrix4* pose_matrices, const Matrix4& model_matrix, float* out_buffer_world, float* out_buffer_local)
+    {
+        Vector4 v;
+        for (uint32_t i = 0; i < vertex_count; ++i)
+        {
+            Vector4 in_v;
+            in_v.setX(*positions++);
+            in_v.setY(*positions++);
+            in_v.setZ(*positions++);
+            in_v.setW(1.0f);
+
+            Vector4 out_p(0.0f, 0.0f, 0.0f, 0.0f);
+            const uint32_t bi_offset = i * 4;
+            const uint32_t* bone_indices = &indices[bi_offset];
+            const float* bone_weights = &weights[bi_offset];
+
+            if(bone_weights[0])
+            {
+                out_p += pose_matrices[bone_indices[0]] * in_v * bone_weights[0];
+                if(bone_weights[1])
+                {
+                    out_p += pose_matrices[bone_indices[1]] * in_v * bone_weights[1];
+                    if(bone_weights[2])
+                    {
+                        out_p += pose_matrices[bone_indices[2]] * in_v * bone_weights[2];
+                        if(bone_weights[3])
+                        {
+                            out_p += pose_matrices[bone_indices[3]] * in_v * bone_weights[3];
+                        }
+                    }
+                }
+            }
+
+            if (out_buffer_world)
+            {
+                v = model_matrix * Point3(out_p.getX(), out_p.getY(), out_p.getZ());
+                *out_buffer_world++ = v[0];
+                *out_buffer_world++ = v[1];
+                *out_buffer_world++ = v[2];
+            }
+            if (out_buffer_local)
+            {
+                *out_buffer_local++ = out_p.getX();
+                *out_buffer_local++ = out_p.getY();
+                *out_buffer_local++ = out_p.getZ();
+            }
+        }
+    }
+
+    void SkinNormalsScalar(const float* normals_in, const float* tangents_in, const uint32_t* indices, const float* weights, uint32_t vertex_count,
+                           const Matrix4* pose_matrices, const Matrix4& normal_matrix, float* normals_buffer, float* tangents_buffer)
+    {
+        bool has_tangents = tangents_in != 0;
+        Vector4 normal;
+        Vector4 tangent;
+        for (uint32_t i = 0; i < vertex_count; ++i)
+        {
+            const Vector3 normal_in(normals_in[i*3+0], normals_in[i*3+1], normals_in[i*3+2]);
+            Vector4 normal_out(0.0f, 0.0f, 0.0f, 0.0f);
+
+            const Vector3 tangent_in = has_tangents ? Vector3(tangents_in[i*4+0], tangents_in[i*4+1], tangents_in[i*4+2]) : Vector3(0,0,0);
+            const float tangent_handedness = has_tangents ? tangents_in[i*4+3] : 0.0f;
+            Vector4 tangent_out(0.0f, 0.0f, 0.0f, 0.0f);
+
+            const uint32_t bi_offset = i * 4;
+            const uint32_t* bone_indices = &indices[bi_offset];
+            const float* bone_weights = &weights[bi_offset];
+
+            if (bone_weights[0])
+            {
+                normal_out += (pose_matrices[bone_indices[0]] * normal_in) * bone_weights[0];
+                tangent_out += (pose_matrices[bone_indices[0]] * tangent_in) * bone_weights[0];
+                if (bone_weights[1])
+                {
+                    normal_out += (pose_matrices[bone_indices[1]] * normal_in) * bone_weights[1];
+                    tangent_out += (pose_matrices[bone_indices[1]] * tangent_in) * bone_weights[1];
+                    if (bone_weights[2])
+                    {
+                        normal_out += (pose_matrices[bone_indices[2]] * normal_in) * bone_weights[2];
+                        tangent_out += (pose_matrices[bone_indices[2]] * tangent_in) * bone_weights[2];
+                        if (bone_weights[3])
+                        {
+                            normal_out += (pose_matrices[bone_indices[3]] * normal_in) * bone_weights[3];
+                            tangent_out += (pose_matrices[bone_indices[3]] * tangent_in) * bone_weights[3];
+                        }
+                    }
+                }
+            }
+
+            normal = normal_matrix * normal_out.getXYZ();
+            if (lengthSqr(normal) > 0.0f) {
+                normalize(normal);
+            }
+            *normals_buffer++ = normal[0];
+            *normals_buffer++ = normal[1];
+            *normals_buffer++ = normal[2];
+
+            if (has_tangents)
+            {
+                tangent = normal_matrix * tangent_out;
+                if (lengthSqr(tangent) > 0.0f) {
+                    normalize(tangent);
+                }
+                *tangents_buffer++ = tangent[0];
+                *tangents_buffer++ = tangent[1];
+                *tangents_buffer++ = tangent[2];
+                *tangents_buffer++ = tangent_handedness;
+            }
+        }
+    }
+
+#if defined(DM_RIG_SKINNING_SIMD)
+
+    // A minimal set of 4-wide float operations, implemented for each instruction set.
+    // The kernels below are written once using these.
+
+#if defined(DM_RIG_SKINNING_SSE2)
+    typedef __m128 vec4;
+
+    static inline vec4 Load(const float* p)                 { return _mm_loadu_ps(p); }
+    static inline void Store(float* p, vec4 v)              { _mm_storeu_ps(p, v); }
+    static inline vec4 Splat(float f)                       { return _mm_set1_ps(f); }
+    static inline vec4 Mul(vec4 a, vec4 b)                  { return _mm_mul_ps(a, b); }
+    static inline vec4 MulAdd(vec4 a, vec4 b, vec4 c)       { return _mm_add_ps(a, _mm_mul_ps(b, c)); }
+    static inline vec4 SplatX(vec4 v)                       { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)); }
+    static inline vec4 SplatY(vec4 v)                       { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)); }
+    static inline vec4 SplatZ(vec4 v)                       { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)); }
+    static inline vec4 SplatW(vec4 v)                       { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)); }
+
+#elif defined(DM_RIG_SKINNING_NEON)
+    typedef float32x4_t vec4;
+
+    static inline vec4 Load(const float* p)                 { return vld1q_f32(p); }
+    static inline void Store(float* p, vec4 v)              { vst1q_f32(p, v); }
+    static inline vec4 Splat(float f)                       { return vdupq_n_f32(f); }
+    static inline vec4 Mul(vec4 a, vec4 b)                  { return vmulq_f32(a, b); }
+    static inline vec4 MulAdd(vec4 a, vec4 b, vec4 c)       { return vmlaq_f32(a, b, c); }
+    static inline vec4 SplatX(vec4 v)                       { return vdupq_lane_f32(vget_low_f32(v), 0); }
+    static inline vec4 SplatY(vec4 v)                       { return vdupq_lane_f32(vget_low_f32(v), 1); }
+    static inline vec4 SplatZ(vec4 v)                       { return vdupq_lane_f32(vget_high_f32(v), 0); }
+    static inline vec4 SplatW(vec4 v)                       { return vdupq_lane_f32(vget_high_f32(v), 1); }
+
+#elif defined(DM_RIG_SKINNING_WASM)
+    typedef v128_t vec4;
+
+    static inline vec4 Load(const float* p)                 { return wasm_v128_load(p); }
+    static inline void Store(float* p, vec4 v)              { wasm_v128_store(p, v); }
+    static inline vec4 Splat(float f)                       { return wasm_f32x4_splat(f); }
+    static inline vec4 Mul(vec4 a, vec4 b)                  { return wasm_f32x4_mul(a, b); }
+    static inline vec4 MulAdd(vec4 a, vec4 b, vec4 c)       { return wasm_f32x4_add(a, wasm_f32x4_mul(b, c)); }
+    static inline vec4 SplatX(vec4 v)                       { return wasm_i32x4_shuffle(v, v, 0, 0, 0, 0); }
+    static inline vec4 SplatY(vec4 v)                       { return wasm_i32x4_shuffle(v, v, 1, 1, 1, 1); }
+    static inline vec4 SplatZ(vec4 v)                       { return wasm_i32x4_shuffle(v, v, 2, 2, 2, 2); }
+    static inline vec4 SplatW(vec4 v)                       { return wasm_i32x4_shuffle(v, v, 3, 3, 3, 3); }
+#endif
+
+    // The matrices are column major, 4 floats per column
+    struct Columns
+    {
+        vec4 m_C0, m_C1, m_C2, m_C3;
+    };
+
+    static inline void LoadColumns(const Matrix4& m, Columns& out)
+    {
+        const float* f = (const float*)&m;
+        out.m_C0 = Load(f + 0);
+        out.m_C1 = Load(f + 4);
+        out.m_C2 = Load(f + 8);
+        out.m_C3 = Load(f + 12);
+    }
+
+    static inline void StoreXYZ(float* out, vec4 v)
+    {
+        float tmp[4];
+        Store(tmp, v);
+        out[0] = tmp[0];
+        out[1] = tmp[1];
+        out[2] = tmp[2];
+    }
+
+    void SkinPositions(const float* positions, const uint32_t* indices, const float* weights, uint32_t vertex_count,
+                       const Matrix4* pose_matrices, const Matrix4& model_matrix, float* out_world, float* out_local)
+    {
+        DM_STATIC_ASSERT(sizeof(Matrix4) == sizeof(float) * 16, Invalid_Matrix4_Layout);
+
+        Columns model;
+        LoadColumns(model_matrix, model);
+
+        for (uint32_t i = 0; i < vertex_count; ++i, positions += 3, indices += 4, weights += 4)
+        {
+            vec4 x = Splat(positions[0]);
+            vec4 y = Splat(positions[1]);
+            vec4 z = Splat(positions[2]);
+
+            vec4 p = Splat(0.0f);
+            for (uint32_t b = 0; b < 4 && weights[b]; ++b)
+            {
+                const float* m = (const float*)&pose_matrices[indices[b]];
+                vec4 bone_p = MulAdd(MulAdd(MulAdd(Load(m + 12), Load(m + 0), x), Load(m + 4), y), Load(m + 8), z);
+                p = MulAdd(p, bone_p, Splat(weights[b]));
+            }
+
+            if (out_world)
+            {
+                vec4 w = MulAdd(MulAdd(MulAdd(model.m_C3, model.m_C0, SplatX(p)), model.m_C1, SplatY(p)), model.m_C2, SplatZ(p));
+                StoreXYZ(out_world, w);
+                out_world += 3;
+            }
+            if (out_local)
+            {
+                StoreXYZ(out_local, p);
+                out_local += 3;
+            }
+        }
+    }
+
+    void SkinNormals(const float* normals, const float* tangents, const uint32_t* indices, const float* weights, uint32_t vertex_count,
+                     const Matrix4* pose_matrices, const Matrix4& normal_matrix, float* out_normals, float* out_tangents)
+    {
+        Columns nm;
+        LoadColumns(normal_matrix, nm);
+
+        for (uint32_t i = 0; i < vertex_count; ++i, normals += 3, indices += 4, weights += 4)
+        {
+            // Blend the rotation part of the bone matrices, and share it between the normal and tangent
+            vec4 c0 = Splat(0.0f);
+            vec4 c1 = Splat(0.0f);
+            vec4 c2 = Splat(0.0f);
+            for (uint32_t b = 0; b < 4 && weights[b]; ++b)
+            {
+                const float* m = (const float*)&pose_matrices[indices[b]];
+                vec4 w = Splat(weights[b]);
+                c0 = MulAdd(c0, Load(m + 0), w);
+                c1 = MulAdd(c1, Load(m + 4), w);
+                c2 = MulAdd(c2, Load(m + 8), w);
+            }
+
+            vec4 n = MulAdd(MulAdd(Mul(c0, Splat(normals[0])), c1, Splat(normals[1])), c2, Splat(normals[2]));
+            n = MulAdd(MulAdd(Mul(nm.m_C0, SplatX(n)), nm.m_C1, SplatY(n)), nm.m_C2, SplatZ(n));
+            StoreXYZ(out_normals, n);
+            out_normals += 3;
+
+            if (tangents)
+            {
+                vec4 t = MulAdd(MulAdd(Mul(c0, Splat(tangents[0])), c1, Splat(tangents[1])), c2, Splat(tangents[2]));
+                t = MulAdd(MulAdd(MulAdd(Mul(nm.m_C0, SplatX(t)), nm.m_C1, SplatY(t)), nm.m_C2, SplatZ(t)), nm.m_C3, SplatW(t));
+                StoreXYZ(out_tangents, t);
+                out_tangents[3] = tangents[3];
+                out_tangents += 4;
+                tangents += 4;
+            }
+        }
+    }
+
+#else
+
+    void SkinPositions(const float* positions, const uint32_t* indices, const float* weights, uint32_t vertex_count,
+                       const Matrix4* pose_matrices, const Matrix4& model_matrix, float* out_world, float* out_local)
+    {
+        SkinPositionsScalar(positions, indices, weights, vertex_count, pose_matrices, model_matrix, out_world, out_local);
+    }
+
+    void SkinNormals(const float* normals, const float* tangents, const uint32_t* indices, const float* weights, uint32_t vertex_count,
+                     const Matrix4* pose_matrices, const Matrix4& normal_matrix, float* out_normals, float* out_tangents)
+    {
+        SkinNormalsScalar(normals, tangents, indices, weights, vertex_count, pose_matrices, normal_matrix, out_normals, out_tangents);
+    }
+
+#endif // DM_RIG_SKINNING_SIMD
+}
@@ -20,6 +20,7 @@
 #include <dlib/log.h>
 #include <dlib/hash.h>
 #include <dlib/hashtable.h>
+#include <dlib/jobsystem.h>
 #include <dmsdk/dlib/vmath.h>
 #include <dmsdk/dlib/dstrings.h>
 
@@ -89,6 +90,17 @@ static void DeleteRigAnimation(dmRigDDF::RigAnimation& anim)
         if (anim_track.m_Scale.m_Count) {
             delete [] anim_track.m_Scale.m_Data;
         }
+        if (anim_track.m_CompressedPositions.m_Count) {
+            delete [] anim_track.m_CompressedPositions.m_Data;
+            delete [] anim_track.m_PositionsRange.m_Data;
+        }
+        if (anim_track.m_CompressedRotations.m_Count) {
+            delete [] anim_track.m_CompressedRotations.m_Data;
+        }
+        if (anim_track.m_CompressedScale.m_Count) {
+            delete [] anim_track.m_CompressedScale.m_Data;
+            delete [] anim_track.m_ScaleRange.m_Data;
+        }
     }
 
     if (anim.m_Tracks.m_Count) {
@@ -476,6 +488,112 @@ static void DeleteAnimationTracks(const dmRigDDF::AnimationTrack* tracks, uint32
     }
 }
 
+static void WriteCompressedSample(uint8_t* out, uint64_t value)
+{
+    for (uint32_t i = 0; i < 6; ++i)
+        out[i] = (uint8_t)(value >> (i * 8));
+}
+
+// Same encoding as ModelUtil.compressAnimationTracks in bob
+static uint8_t* CompressVec3Track(const float* values, uint32_t count, float** out_range)
+{
+    uint32_t sample_count = count / 3;
+    float* range = new float[6];
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        float min = values[c];
+        float max = values[c];
+        for (uint32_t s = 1; s < sample_count; ++s)
+        {
+            min = dmMath::Min(min, values[s*3+c]);
+            max = dmMath::Max(max, values[s*3+c]);
+        }
+        range[c] = min;
+        range[3+c] = max - min;
+    }
+
+    uint8_t* data = new uint8_t[sample_count * 6];
+    for (uint32_t s = 0; s < sample_count; ++s)
+    {
+        uint64_t value = 0;
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            uint64_t q = range[3+c] > 0.0f ? (uint64_t)((values[s*3+c] - range[c]) / range[3+c] * 65535.0f + 0.5f) : 0;
+            value |= q << (c * 16);
+        }
+        WriteCompressedSample(&data[s * 6], value);
+    }
+    *out_range = range;
+    return data;
+}
+
+static uint8_t* CompressQuatTrack(const float* values, uint32_t count)
+{
+    const float component_range = 0.70710678f;
+    uint32_t sample_count = count / 4;
+    uint8_t* data = new uint8_t[sample_count * 6];
+    for (uint32_t s = 0; s < sample_count; ++s)
+    {
+        const float* q = &values[s*4];
+        uint32_t largest = 0;
+        for (uint32_t c = 1; c < 4; ++c)
+        {
+            if (fabsf(q[c]) > fabsf(q[largest]))
+                largest = c;
+        }
+        float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+
+        uint64_t value = (uint64_t)largest << 45;
+        uint32_t shift = 30;
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            if (c == largest)
+                continue;
+            float n = (sign * q[c] / component_range + 1.0f) * 0.5f;
+            uint64_t v = (uint64_t)dmMath::Clamp(n * 32767.0f + 0.5f, 0.0f, 32767.0f);
+            value |= v << shift;
+            shift -= 15;
+        }
+        WriteCompressedSample(&data[s * 6], value);
+    }
+    return data;
+}
+
+// Replaces the float samples of all animated tracks with compressed samples
+static void CompressAnimationTracks(dmRigDDF::RigAnimation& anim)
+{
+    for (uint32_t t = 0; t < anim.m_Tracks.m_Count; ++t)
+    {
+        dmRigDDF::AnimationTrack& track = anim.m_Tracks.m_Data[t];
+        if (track.m_Positions.m_Count > 3)
+        {
+            track.m_CompressedPositions.m_Data = CompressVec3Track(track.m_Positions.m_Data, track.m_Positions.m_Count, &track.m_PositionsRange.m_Data);
+            track.m_CompressedPositions.m_Count = (track.m_Positions.m_Count / 3) * 6;
+            track.m_PositionsRange.m_Count = 6;
+            delete[] track.m_Positions.m_Data;
+            track.m_Positions.m_Data = 0;
+            track.m_Positions.m_Count = 0;
+        }
+        if (track.m_Rotations.m_Count > 4)
+        {
+            track.m_CompressedRotations.m_Data = CompressQuatTrack(track.m_Rotations.m_Data, track.m_Rotations.m_Count);
+            track.m_CompressedRotations.m_Count = (track.m_Rotations.m_Count / 4) * 6;
+            delete[] track.m_Rotations.m_Data;
+            track.m_Rotations.m_Data = 0;
+            track.m_Rotations.m_Count = 0;
+        }
+        if (track.m_Scale.m_Count > 3)
+        {
+            track.m_CompressedScale.m_Data = CompressVec3Track(track.m_Scale.m_Data, track.m_Scale.m_Count, &track.m_ScaleRange.m_Data);
+            track.m_CompressedScale.m_Count = (track.m_Scale.m_Count / 3) * 6;
+            track.m_ScaleRange.m_Count = 6;
+            delete[] track.m_Scale.m_Data;
+            track.m_Scale.m_Data = 0;
+            track.m_Scale.m_Count = 0;
+        }
+    }
+}
+
 void SetUpSimpleRig(dmArray<dmRig::RigBone>& bind_pose, dmHashTable64<uint32_t>& bone_indices, dmRigDDF::Skeleton* skeleton, dmRigDDF::MeshSet* mesh_set, dmRigDDF::AnimationSet* animation_set)
 {
 
@@ -1403,6 +1521,76 @@ TEST_F(RigInstanceTest, PoseAnim)
     ASSERT_EQ(Quat::identity(), pose[1].m_World.GetRotation());
 }
 
+TEST_F(RigInstanceTest, PoseAnimCompressed)
+{
+    for (uint32_t i = 0; i < m_AnimationSet->m_Animations.m_Count; ++i)
+    {
+        CompressAnimationTracks(m_AnimationSet->m_Animations.m_Data[i]);
+    }
+
+    ASSERT_EQ(dmRig::RESULT_OK, dmRig::Update(m_Context, 1.0f));
+    ASSERT_EQ(dmRig::RESULT_OK, dmRig::PlayAnimation(m_Instance, dmHashString64("valid"), dmRig::PLAYBACK_LOOP_FORWARD, 0.0f, 0.0f, 1.0f));
+
+    dmArray<dmRig::BonePose>& pose = *dmRig::GetPose(m_Instance);
+
+    // sample 0 ( the initial skeleton pose ))
+    ASSERT_EQ(Vector3(0.0f, 0.0f, 0.0f), pose[0].m_World.GetTranslation());
+    ASSERT_EQ(Quat::identity(), pose[0].m_World.GetRotation());
+    ASSERT_EQ(Vector3(1.0f, 0.0f, 0.0f), pose[1].m_World.GetTranslation());
+    ASSERT_EQ(Quat::identity(), pose[1].m_World.GetRotation());
+    ASSERT_EQ(dmRig::RESULT_OK, dmRig::Update(m_Context, 1.0f));
+
+    // sample 1
+    ASSERT_EQ(Vector3(0.0f, 0.0f, 0.0f), pose[0].m_World.GetTranslation());
+    ASSERT_EQ(Quat::identity(), pose[0].m_World.GetRotation());
+    ASSERT_EQ(Vector3(1.0f, 0.0f, 0.0f), pose[1].m_World.GetTranslation());
+    ASSERT_EQ(Quat::rotationZ((float)M_PI / 2.0f), pose[1].m_World.GetRotation());
+
+    ASSERT_EQ(dmRig::RESULT_OK, dmRig::Update(m_Context, 1.0f));
+
+    // sample 2
+    ASSERT_EQ(Vector3(0.0f, 0.0f, 0.0f), pose[0].m_World.GetTranslation());
+    ASSERT_EQ(Quat::rotationZ((float)M_PI / 2.0f), pose[0].m_World.GetRotation());
+    ASSERT_EQ(Vector3(0.0f, 1.0f, 0.0f), pose[1].m_World.GetTranslation());
+    ASSERT_EQ(Quat::rotationZ((float)M_PI / 2.0f), pose[1].m_World.GetRotation());
+
+    // half way between sample 0 and 1 in the "scaling" animation (scale track interpolation)
+    ASSERT_EQ(dmRig::RESULT_OK, dmRig::PlayAnimation(m_Instance, dmHashString64("scaling"), dmRig::PLAYBACK_LOOP_FORWARD, 0.0f, 0.0f, 1.0f));
+    ASSERT_EQ(dmRig::RESULT_OK, dmRig::Update(m_Context, 0.5f));
+    ASSERT_EQ(Vector3(1.5f, 1.0f, 1.0f), pose[5].m_Local.GetScale());
+}
+
+TEST_F(RigInstanceTest, PoseAnimUpdateInterval)
+{
+    ASSERT_EQ(dmRig::RESULT_OK, dmRig::Update(m_Context, 1.0f));
+    ASSERT_EQ(dmRig::RESULT_OK, dmRig::PlayAnimation(m_Instance, dmHashString64("valid"), dmRig::PLAYBACK_LOOP_FORWARD, 0.0f, 0.0f, 1.0f));
+    dmRig::SetUpdateInterval(m_Instance, 2);
+    ASSERT_EQ(2u, dmRig::GetUpdateInterval(m_Instance));
+
+    dmArray<dmRig::BonePose>& pose = *dmRig::GetPose(m_Instance);
+
+    // sample 1
+    ASSERT_EQ(dmRig::RESULT_OK, dmRig::Update(m_Context, 1.0f));
+    ASSERT_EQ(Quat::identity(), pose[0].m_World.GetRotation());
+    ASSERT_EQ(Quat::rotationZ((float)M_PI / 2.0f), pose[1].m_World.GetRotation());
+
+    // the cursor advances, but the pose of sample 1 is kept
+    ASSERT_EQ(dmRig::RESULT_OK, dmRig::Update(m_Context, 1.0f));
+    ASSERT_NEAR(2.0f, dmRig::GetCursor(m_Instance, false), RIG_EPSILON_FLOAT);
+    ASSERT_EQ(Quat::identity(), pose[0].m_World.GetRotation());
+    ASSERT_EQ(Quat::rotationZ((float)M_PI / 2.0f), pose[1].m_World.GetRotation());
+
+    // sample 0 (looped)
+    ASSERT_EQ(dmRig::RESULT_OK, dmRig::Update(m_Context, 1.0f));
+    ASSERT_EQ(Quat::identity(), pose[0].m_World.GetRotation());
+    ASSERT_EQ(Quat::identity(), pose[1].m_World.GetRotation());
+
+    // setting the cursor samples the pose on the next update
+    ASSERT_EQ(dmRig::RESULT_OK, dmRig::SetCursor(m_Instance, 2.0f, false));
+    ASSERT_EQ(dmRig::RESULT_OK, dmRig::Update(m_Context, 0.0f));
+    ASSERT_EQ(Quat::rotationZ((float)M_PI / 2.0f), pose[0].m_World.GetRotation());
+}
+
 TEST_F(RigInstanceTest, PoseAnimOnceHoldsLastFrame)
 {
     ASSERT_EQ(dmRig::RESULT_OK, dmRig::Update(m_Context, 1.0f));
@@ -2239,6 +2427,84 @@ TEST(RigMorphWeights, SetMorphWeightsOverriddenByNextUpdate)
     dmRig::DeleteContext(ctx);
 }
 
+TEST(RigAnimateParallel, SameAsSerial)
+{
+    // Enough instances for several batches of jobs
+    const uint32_t instance_count = 100;
+
+    JobSystemCreateParams job_params;
+    job_params.m_ThreadNamePrefix = "RigTest";
+    job_params.m_ThreadCount = 4;
+    HJobContext job_context = JobSystemCreate(&job_params);
+    ASSERT_NE((HJobContext)0, job_context);
+
+    dmRig::HRigContext contexts[2];
+    dmRig::NewContextParams cp = {};
+    cp.m_MaxRigInstanceCount = instance_count;
+    ASSERT_EQ(dmRig::RESULT_OK, dmRig::NewContext(cp, &contexts[0]));
+    cp.m_JobContext = job_context;
+    ASSERT_EQ(dmRig::RESULT_OK, dmRig::NewContext(cp, &contexts[1]));
+
+    dmRigDDF::Skeleton*     skeleton      = new dmRigDDF::Skeleton();
+    dmRigDDF::MeshSet*      mesh_set      = new dmRigDDF::MeshSet();
+    dmRigDDF::AnimationSet* animation_set = new dmRigDDF::AnimationSet();
+    dmArray<dmRig::RigBone> bind_pose;
+    dmHashTable64<uint32_t> bone_indices;
+    SetUpSimpleRig(bind_pose, bone_indices, skeleton, mesh_set, animation_set);
+
+    dmRig::InstanceCreateParams create_params = {0};
+    create_params.m_BindPose         = &bind_pose;
+    create_params.m_BoneIndices      = &bone_indices;
+    create_params.m_Skeleton         = skeleton;
+    create_params.m_MeshSet          = mesh_set;
+    create_params.m_ModelId          = dmHashString64("test");
+    create_params.m_DefaultAnimation = dmHashString64("");
+    create_params.m_AnimationSet     = animation_set;
+
+    dmRig::HRigInstance instances[2][instance_count];
+    for (uint32_t c = 0; c < 2; ++c)
+    {
+        for (uint32_t i = 0; i < instance_count; ++i)
+        {
+            ASSERT_EQ(dmRig::RESULT_OK, dmRig::InstanceCreate(contexts[c], create_params, &instances[c][i]));
+            ASSERT_NE(dmRig::INVALID_POSE_MATRIX_CACHE_ENTRY, dmRig::AcquirePoseMatrixCacheEntry(contexts[c], instances[c][i]));
+            // Every other instance is idle, and the rest are at different points in the animation
+            if (i % 2)
+            {
+                ASSERT_EQ(dmRig::RESULT_OK, dmRig::PlayAnimation(instances[c][i], dmHashString64("valid"), dmRig::PLAYBACK_LOOP_FORWARD, 0.0f, (i % 7) / 7.0f, 1.0f));
+            }
+        }
+    }
+
+    for (uint32_t frame = 0; frame < 4; ++frame)
+    {
+        ASSERT_EQ(dmRig::RESULT_OK, dmRig::Update(contexts[0], 0.4f));
+        ASSERT_EQ(dmRig::RESULT_OK, dmRig::Update(contexts[1], 0.4f));
+
+        const dmRig::PoseMatrixCache* serial_cache = dmRig::GetPoseMatrixCache(contexts[0]);
+        const dmRig::PoseMatrixCache* parallel_cache = dmRig::GetPoseMatrixCache(contexts[1]);
+        ASSERT_EQ(serial_cache->m_PoseMatrices.Size(), parallel_cache->m_PoseMatrices.Size());
+        ASSERT_EQ(serial_cache->m_MaxBoneCount, parallel_cache->m_MaxBoneCount);
+        ASSERT_ARRAY_EQ_LEN((const float*)serial_cache->m_PoseMatrices.Begin(), (const float*)parallel_cache->m_PoseMatrices.Begin(), serial_cache->m_PoseMatrices.Size() * 16);
+
+        for (uint32_t i = 0; i < instance_count; ++i)
+        {
+            ASSERT_EQ(dmRig::GetCursor(instances[0][i], false), dmRig::GetCursor(instances[1][i], false));
+        }
+    }
+
+    for (uint32_t c = 0; c < 2; ++c)
+    {
+        for (uint32_t i = 0; i < instance_count; ++i)
+        {
+            dmRig::InstanceDestroy(contexts[c], instances[c][i]);
+        }
+        dmRig::DeleteContext(contexts[c]);
+    }
+    DeleteRigData(mesh_set, skeleton, animation_set);
+    JobSystemDestroy(job_context);
+}
+
 #undef ASSERT_VERT_POS
 #undef ASSERT_VERT_NORM
 #undef ASSERT_VERT_UV
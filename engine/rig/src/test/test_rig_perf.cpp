@@ -0,0 +1,167 @@
+// Copyright 2020-2026 The Defold Foundation
+// Copyright 2014-2020 King
+// Copyright 2009-2014 Ragnar Svensson, Christian Murray
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#define JC_TEST_IMPLEMENTATION
+#include <jc_test/jc_test.h>
+#include <dlib/array.h>
+#include <dlib/math.h>
+#include <dlib/time.h>
+#include <dmsdk/dlib/vmath.h>
+
+#include <../rig_private.h>
+
+using namespace dmVMath;
+
+static const uint32_t BONE_COUNT = 64;
+static const uint32_t VERTEX_COUNT = 64 * 1024;
+static const uint32_t ITERATIONS = 20;
+
+static float RandomFloat()
+{
+    return rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+// A skinned mesh in the layout of dmRigDDF::Mesh
+struct SkinningData
+{
+    dmArray<Matrix4>  m_PoseMatrices;
+    dmArray<float>    m_Positions;
+    dmArray<float>    m_Normals;
+    dmArray<float>    m_Tangents;
+    dmArray<uint32_t> m_BoneIndices;
+    dmArray<float>    m_BoneWeights;
+    Matrix4           m_ModelMatrix;
+    Matrix4           m_NormalMatrix;
+
+    SkinningData(uint32_t vertex_count)
+    {
+        srand(42);
+        m_PoseMatrices.SetCapacity(BONE_COUNT);
+        for (uint32_t i = 0; i < BONE_COUNT; ++i)
+        {
+            Quat rotation = normalize(Quat(RandomFloat(), RandomFloat(), RandomFloat(), RandomFloat()));
+            m_PoseMatrices.Push(Matrix4(rotation, Vector3(RandomFloat(), RandomFloat(), RandomFloat())));
+        }
+
+        m_Positions.SetCapacity(vertex_count * 3);
+        m_Normals.SetCapacity(vertex_count * 3);
+        m_Tangents.SetCapacity(vertex_count * 4);
+        m_BoneIndices.SetCapacity(vertex_count * 4);
+        m_BoneWeights.SetCapacity(vertex_count * 4);
+        for (uint32_t i = 0; i < vertex_count; ++i)
+        {
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                m_Positions.Push(RandomFloat());
+                m_Normals.Push(RandomFloat());
+                m_Tangents.Push(RandomFloat());
+            }
+            m_Tangents.Push(1.0f);
+
+            // Vary the number of influences (1-4) per vertex
+            uint32_t influences = 1 + i % 4;
+            for (uint32_t b = 0; b < 4; ++b)
+            {
+                m_BoneIndices.Push(rand() % BONE_COUNT);
+                m_BoneWeights.Push(b < influences ? 1.0f / influences : 0.0f);
+            }
+        }
+
+        m_ModelMatrix = Matrix4(Quat::rotationY(0.5f), Vector3(1.0f, 2.0f, 3.0f));
+        m_NormalMatrix = transpose(inverse(m_ModelMatrix));
+    }
+};
+
+TEST(RigSkinning, SameAsScalar)
+{
+    const uint32_t vertex_count = 1021; // Not a multiple of 4
+    SkinningData data(vertex_count);
+
+    dmArray<float> world, local, normals, tangents;
+    dmArray<float> world_ref, local_ref, normals_ref, tangents_ref;
+    world.SetCapacity(vertex_count * 3); world.SetSize(vertex_count * 3);
+    local.SetCapacity(vertex_count * 3); local.SetSize(vertex_count * 3);
+    normals.SetCapacity(vertex_count * 3); normals.SetSize(vertex_count * 3);
+    tangents.SetCapacity(vertex_count * 4); tangents.SetSize(vertex_count * 4);
+    world_ref.SetCapacity(vertex_count * 3); world_ref.SetSize(vertex_count * 3);
+    local_ref.SetCapacity(vertex_count * 3); local_ref.SetSize(vertex_count * 3);
+    normals_ref.SetCapacity(vertex_count * 3); normals_ref.SetSize(vertex_count * 3);
+    tangents_ref.SetCapacity(vertex_count * 4); tangents_ref.SetSize(vertex_count * 4);
+
+    dmRig::SkinPositions(data.m_Positions.Begin(), data.m_BoneIndices.Begin(), data.m_BoneWeights.Begin(), vertex_count,
+                         data.m_PoseMatrices.Begin(), data.m_ModelMatrix, world.Begin(), local.Begin());
+    dmRig::SkinPositionsScalar(data.m_Positions.Begin(), data.m_BoneIndices.Begin(), data.m_BoneWeights.Begin(), vertex_count,
+                               data.m_PoseMatrices.Begin(), data.m_ModelMatrix, world_ref.Begin(), local_ref.Begin());
+    dmRig::SkinNormals(data.m_Normals.Begin(), data.m_Tangents.Begin(), data.m_BoneIndices.Begin(), data.m_BoneWeights.Begin(), vertex_count,
+                       data.m_PoseMatrices.Begin(), data.m_NormalMatrix, normals.Begin(), tangents.Begin());
+    dmRig::SkinNormalsScalar(data.m_Normals.Begin(), data.m_Tangents.Begin(), data.m_BoneIndices.Begin(), data.m_BoneWeights.Begin(), vertex_count,
+                             data.m_PoseMatrices.Begin(), data.m_NormalMatrix, normals_ref.Begin(), tangents_ref.Begin());
+
+    for (uint32_t i = 0; i < vertex_count * 3; ++i)
+    {
+        ASSERT_NEAR(world_ref[i], world[i], 0.0001f);
+        ASSERT_NEAR(local_ref[i], local[i], 0.0001f);
+        ASSERT_NEAR(normals_ref[i], normals[i], 0.0001f);
+    }
+    for (uint32_t i = 0; i < vertex_count * 4; ++i)
+    {
+        ASSERT_NEAR(tangents_ref[i], tangents[i], 0.0001f);
+    }
+}
+
+TEST(RigSkinning, Benchmark)
+{
+    SkinningData data(VERTEX_COUNT);
+
+    dmArray<float> positions, normals, tangents;
+    positions.SetCapacity(VERTEX_COUNT * 3); positions.SetSize(VERTEX_COUNT * 3);
+    normals.SetCapacity(VERTEX_COUNT * 3); normals.SetSize(VERTEX_COUNT * 3);
+    tangents.SetCapacity(VERTEX_COUNT * 4); tangents.SetSize(VERTEX_COUNT * 4);
+
+    uint64_t time_scalar = 0;
+    uint64_t time_simd = 0;
+    for (uint32_t i = 0; i < ITERATIONS; ++i)
+    {
+        uint64_t t0 = dmTime::GetMonotonicTime();
+        dmRig::SkinPositionsScalar(data.m_Positions.Begin(), data.m_BoneIndices.Begin(), data.m_BoneWeights.Begin(), VERTEX_COUNT,
+                                   data.m_PoseMatrices.Begin(), data.m_ModelMatrix, positions.Begin(), 0);
+        dmRig::SkinNormalsScalar(data.m_Normals.Begin(), data.m_Tangents.Begin(), data.m_BoneIndices.Begin(), data.m_BoneWeights.Begin(), VERTEX_COUNT,
+                                 data.m_PoseMatrices.Begin(), data.m_NormalMatrix, normals.Begin(), tangents.Begin());
+        uint64_t t1 = dmTime::GetMonotonicTime();
+        dmRig::SkinPositions(data.m_Positions.Begin(), data.m_BoneIndices.Begin(), data.m_BoneWeights.Begin(), VERTEX_COUNT,
+                             data.m_PoseMatrices.Begin(), data.m_ModelMatrix, positions.Begin(), 0);
+        dmRig::SkinNormals(data.m_Normals.Begin(), data.m_Tangents.Begin(), data.m_BoneIndices.Begin(), data.m_BoneWeights.Begin(), VERTEX_COUNT,
+                           data.m_PoseMatrices.Begin(), data.m_NormalMatrix, normals.Begin(), tangents.Begin());
+        uint64_t t2 = dmTime::GetMonotonicTime();
+        time_scalar += t1 - t0;
+        time_simd += t2 - t1;
+    }
+
+    const float us_to_ms = 0.001f;
+    float vertices = (float)VERTEX_COUNT * ITERATIONS;
+    float scalar_ms = dmMath::Max(time_scalar * us_to_ms, 0.001f);
+    float simd_ms = dmMath::Max(time_simd * us_to_ms, 0.001f);
+    printf("Skinning %u vertices x %u (position, normal, tangent)\n", VERTEX_COUNT, ITERATIONS);
+    printf("  Scalar: %.3f ms, %.0f vertices/ms\n", scalar_ms, vertices / scalar_ms);
+    printf("  SIMD:   %.3f ms, %.0f vertices/ms\n", simd_ms, vertices / simd_ms);
+}
+
+int main(int argc, char **argv)
+{
+    jc_test_init(&argc, argv);
+    return jc_test_run_all();
+}
@@ -14,22 +14,48 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <dlib/array.h>
+#include <dlib/condition_variable.h>
+#include <dlib/connection_pool.h>
 #include <dlib/dstrings.h>
+#include <dlib/hash.h>
 #include <dlib/thread.h>
 #include <dlib/time.h>
 #include <dlib/message.h>
+#include <dlib/mutex.h>
 #include <dlib/http_client.h>
 #include <dlib/http_cache.h>
 #include <dlib/log.h>
+#include <dlib/socket.h>
+#include <dlib/sslsocket.h>
 #include <dlib/sys.h>
 #include <dlib/uri.h>
 #include <dlib/math.h>
+#include <dlib/path.h>
 #include <ddf/ddf.h>
 #include "http_ddf.h"
 #include "http_service.h"
 
+/*
+ The http service is a single event loop thread that multiplexes all in-flight
+ requests over non-blocking keep-alive connections:
+
+   @http socket -> pending -> (connect thread) -> active -> response message
+                      ^                              |
+                      +------ idle connections <-----+
+
+ The only blocking operations left are the name lookup, the TCP connect and the
+ TLS handshake (and the CONNECT exchange with a proxy). These run on a small set
+ of connect threads, which hand the connection back to the event loop with an
+ internal message. If the secure socket implementation can't read without
+ blocking, the connect thread completes the request itself in blocking mode.
+
+ Finished connections are kept in the idle list and handed directly to the next
+ request for the same host, which avoids both the name lookup and the thread hop.
+*/
+
 namespace dmHttpService
 {
     #define HTTP_SOCKET_NAME "@http"
@@ -39,219 +65,1067 @@ namespace dmHttpService
     // (Reason: Our HTTP service threads call getaddrinfo() which
     //  resulted in a writes outside the stack space inside libc.)
     const uint32_t THREAD_STACK_SIZE = 0x20000;
-    const uint32_t DEFAULT_RESPONSE_BUFFER_SIZE = 64 * 1024;
-    const uint32_t DEFAULT_HEADER_BUFFER_SIZE = 16 * 1024;
+    const uint32_t DEFAULT_RESPONSE_BUFFER_SIZE = 16 * 1024;
+    // Must be larger than the maximum TLS record (16kb), so that a read never leaves decrypted data behind
+    const uint32_t RECEIVE_BUFFER_SIZE = 64 * 1024;
+    const uint32_t MAX_HEADER_SIZE = 64 * 1024;
+    // Since https post requests have an upper limit of 2^14 bytes
+    // we need to be able to handle chunked uploads.
+    // See https://tools.ietf.org/html/rfc8446, chapter 5.1
+    const uint32_t MAX_HTTPS_POST_CHUNK_SIZE = 16384;
+    // Number of times a request is retried on a fresh connection when a kept-alive one was closed by the peer
+    const uint32_t MAX_STALE_RETRIES = 2;
+    // Number of reads per connection and loop iteration, to keep the loop fair between connections
+    const uint32_t MAX_READS_PER_ITERATION = 16;
+    // How long the event loop sleeps in the poll while requests are in flight (microseconds).
+    // New requests are picked up between polls.
+    const uint32_t POLL_TIMEOUT = 4 * 1000;
+    const uint64_t IDLE_CONNECTION_TIMEOUT = 5 * 1000000U;
+    const uint64_t CACHE_FLUSH_PERIOD = 5 * 1000000U;
+    const int SOCKET_TIMEOUT = 500 * 1000;
+
+    enum RequestState
+    {
+        STATE_PENDING,              // Waiting for a connection
+        STATE_CONNECTING,           // Owned by a connect thread
+        STATE_SENDING,
+        STATE_RECEIVING_HEADERS,
+        STATE_RECEIVING_BODY,
+        STATE_FINISHED,
+    };
 
+    enum BodyEncoding
+    {
+        BODY_ENCODING_NONE,
+        BODY_ENCODING_LENGTH,
+        BODY_ENCODING_CHUNKED,
+        BODY_ENCODING_UNTIL_CLOSE,
+    };
+
+    enum IOResult
+    {
+        IO_RESULT_OK,
+        IO_RESULT_WOULDBLOCK,
+    };
+
+    struct Connection
+    {
+        dmConnectionPool::HConnection m_Handle;
+        dmSocket::Socket              m_Socket;
+        dmSSLSocket::Socket           m_SSLSocket;
+        dmhash_t                      m_HostKey;
+        uint64_t                      m_IdleSince;
+        // The secure socket can't read without blocking, so the connection is only used from the connect threads
+        uint8_t                       m_Blocking : 1;
+        uint8_t                       m_Reused : 1;
+    };
 
     struct HttpService;
 
+    struct Request
+    {
+        dmMessage::URL          m_Requester;
+        uintptr_t               m_UserData1;
+        uintptr_t               m_UserData2;
+        dmHttpDDF::HttpRequest  m_Request;      // Owns m_Headers and m_Request
+        char                    m_Method[17];
+        char*                   m_Url;
+        char*                   m_Path;
+        dmURI::Parts            m_URI;
+        dmURI::Parts            m_ProxyURI;
+        char                    m_CacheKey[dmURI::MAX_URI_LEN];
+        dmhash_t                m_HostKey;
+        uint64_t                m_Deadline;     // 0 if there is no timeout
+
+        RequestState            m_State;
+        Connection              m_Connection;
+        uint32_t                m_StaleRetries;
+        dmSocket::Result        m_SocketResult;
+
+        // Outgoing request, including the body
+        dmArray<char>           m_SendBuffer;
+        uint32_t                m_SendOffset;
+        uint32_t                m_SendBodyOffset;
+
+        // Response
+        dmArray<char>           m_ReceiveBuffer; // Headers
+        dmArray<char>           m_Headers;       // "key:value\n"
+        char*                   m_Body;
+        uint32_t                m_BodySize;
+        uint32_t                m_BodyCapacity;
+        dmHttpClient::ResponseHeaders m_Response;
+        int                     m_HeaderSize;
+        BodyEncoding            m_BodyEncoding;
+        dmHttpClient::ChunkDecoder m_ChunkDecoder;
+        uint32_t                m_BodyLeft;      // Left of the content length
+        dmHttpCache::HCacheCreator m_CacheCreator;
+
+        // Streaming of the body, instead of returning it in the response message
+        FILE*                   m_File;          // Temporary file, renamed to m_Path when the request succeeds
+        char*                   m_ResponseBuffer;
+        uint32_t                m_ResponseBufferSize;
+
+        uint16_t                m_Secure : 1;
+        uint16_t                m_UseProxy : 1;
+        uint16_t                m_IsHead : 1;
+        uint16_t                m_UseCache : 1;
+        uint16_t                m_CloseConnection : 1;
+        uint16_t                m_ReceivedData : 1;
+        uint16_t                m_Retry : 1;
+        uint16_t                m_ReadAgain : 1;
+        uint16_t                m_PathWritten : 1;
+        uint16_t                m_WriteError : 1;
+    };
+
     struct Worker
     {
-        dmThread::Thread      m_Thread;
-        dmMessage::HSocket    m_Socket;
-        dmHttpClient::HClient m_Client;
-        dmURI::Parts          m_CurrentURL;
-        dmURI::Parts          m_CurrentProxyURL;
-        dmMessage::URL        m_CurrentRequesterURL;
-        dmHttpDDF::HttpRequest*   m_Request;
-        const char*           m_Filepath;
-        int                   m_Status;
-        uint32_t              m_RangeStart;
-        uint32_t              m_RangeEnd;
-        uint32_t              m_DocumentSize;
-        uintptr_t             m_ResponseUserData1;
-        uintptr_t             m_ResponseUserData2;
-        dmArray<char>         m_Response;
-        dmArray<char>         m_Headers;
-        const HttpService*    m_Service;
-        bool                  m_CacheFlusher;
-        volatile bool         m_Run;
-        int                   m_Canceled;
-        bool                  m_ReportProgress;
+        dmThread::Thread    m_Thread;
+        HttpService*        m_Service;
+        char*               m_Buffer;
     };
 
     struct HttpService
     {
         HttpService()
         {
-            m_Balancer = 0;
+            m_Thread = 0;
             m_Socket = 0;
             m_HttpCache = 0;
-            m_LoadBalanceCount = 0;
+            m_Pool = 0;
+            m_ReportProgressCallback = 0;
+            m_ConnectedMessageId = 0;
+            m_Buffer = 0;
+            m_ConnectionCount = 0;
+            m_MaxConnections = 0;
+            m_ConnectMutex = 0;
+            m_ConnectCondition = 0;
+            m_Cancel = 0;
+            m_ConnectRun = false;
             m_Run = false;
         }
         dmArray<Worker*>          m_Workers;
-        dmThread::Thread          m_Balancer;
+        dmThread::Thread          m_Thread;
         dmMessage::HSocket        m_Socket;
         dmHttpCache::HCache       m_HttpCache;
+        dmConnectionPool::HPool   m_Pool;
         ReportProgressCallback    m_ReportProgressCallback;
-        int                       m_LoadBalanceCount;
+        dmhash_t                  m_ConnectedMessageId;
+
+        // Owned by the event loop thread
+        dmArray<Request*>         m_Pending;
+        dmArray<Request*>         m_Active;
+        dmArray<Connection>       m_IdleConnections;
+        dmSocket::Selector        m_Selector;
+        char*                     m_Buffer;
+        // Connections that are dialing, in use or idle
+        uint32_t                  m_ConnectionCount;
+        uint32_t                  m_MaxConnections;
+
+        // Shared with the connect threads
+        dmMutex::HMutex           m_ConnectMutex;
+        dmConditionVariable::HConditionVariable m_ConnectCondition;
+        dmArray<Request*>         m_ConnectQueue;
+        int                       m_Cancel;
+        volatile bool             m_ConnectRun;
         volatile bool             m_Run;
     };
 
-    void HttpHeader(dmHttpClient::HResponse response, void* user_data, int status_code, const char* key, const char* value)
+    // The message destroy callback has no context, and there is only one http service
+    static ReleaseResponseBufferCallback g_ReleaseResponseBufferCallback = 0;
+
+    static void ReleaseResponseBuffer(int32_t response_buffer_ref, uintptr_t user_data)
+    {
+        if (response_buffer_ref && g_ReleaseResponseBufferCallback)
+        {
+            g_ReleaseResponseBufferCallback(response_buffer_ref, user_data);
+        }
+    }
+
+    static void MessageDestroyCallback(dmMessage::Message* message)
+    {
+        dmHttpDDF::HttpResponse* response = (dmHttpDDF::HttpResponse*)message->m_Data;
+        free((void*) response->m_Headers);
+        free((void*) response->m_Response);
+        // The decoder clears the ref when it takes over the buffer
+        ReleaseResponseBuffer(response->m_ResponseBufferRef, message->m_UserData1);
+    }
+
+    // Takes ownership of the response body
+    static void SendResponse(Request* request, int status)
+    {
+        // The url and path strings are stored after the headers, so that they live as long as the message
+        uint32_t headers_length = request->m_Headers.Size();
+        uint32_t url_length = strlen(request->m_Url) + 1;
+        uint32_t path_length = request->m_Path ? strlen(request->m_Path) + 1 : 0;
+        char* headers = (char*) malloc(headers_length + url_length + path_length);
+        if (headers_length)
+        {
+            memcpy(headers, request->m_Headers.Begin(), headers_length);
+        }
+        memcpy(headers + headers_length, request->m_Url, url_length);
+        if (path_length)
+        {
+            memcpy(headers + headers_length + url_length, request->m_Path, path_length);
+        }
+
+        if (request->m_Body == 0)
+        {
+            request->m_Body = (char*) malloc(1);
+        }
+
+        // A body streamed to a file isn't part of the message. A body streamed to the
+        // response buffer isn't either, but the length tells how much was written.
+        uint32_t response_length = request->m_Path ? 0 : request->m_BodySize;
+
+        dmHttpDDF::HttpResponse resp;
+        resp.m_Status = status;
+        resp.m_Headers = (uint64_t) headers;
+        resp.m_HeadersLength = headers_length;
+        resp.m_Response = (uint64_t) request->m_Body;
+        resp.m_ResponseLength = response_length;
+        resp.m_Url = headers + headers_length;
+        resp.m_Path = path_length ? headers + headers_length + url_length : 0;
+        resp.m_RangeStart = request->m_Response.m_RangeStart;
+        resp.m_RangeEnd = request->m_Response.m_RangeEnd;
+        resp.m_DocumentSize = request->m_Response.m_DocumentSize;
+        resp.m_PathWritten = request->m_PathWritten;
+        resp.m_WriteError = request->m_WriteError;
+        resp.m_ResponseBufferRef = request->m_Request.m_ResponseBufferRef;
+
+        request->m_Body = 0;
+        request->m_BodySize = 0;
+        request->m_BodyCapacity = 0;
+
+        if (dmMessage::RESULT_OK != dmMessage::Post(0, &request->m_Requester, dmHttpDDF::HttpResponse::m_DDFHash, request->m_UserData1, request->m_UserData2, (uintptr_t) dmHttpDDF::HttpResponse::m_DDFDescriptor, &resp, sizeof(resp), MessageDestroyCallback) )
+        {
+            free((void*) resp.m_Headers);
+            free((void*) resp.m_Response);
+            ReleaseResponseBuffer(resp.m_ResponseBufferRef, request->m_UserData1);
+            dmLogWarning("Failed to return http-response. Requester deleted?");
+        }
+    }
+
+    static void ReportProgress(HttpService* service, Request* request, uint32_t bytes_sent, uint32_t bytes_received, uint32_t bytes_total)
+    {
+        if (!request->m_Request.m_ReportProgress)
+            return;
+        assert(service->m_ReportProgressCallback);
+
+        dmHttpDDF::HttpRequestProgress progress = {};
+        progress.m_BytesSent        = bytes_sent;
+        progress.m_BytesReceived    = bytes_received;
+        progress.m_BytesTotal       = bytes_total;
+        progress.m_Url              = request->m_Url;
+        service->m_ReportProgressCallback(&progress, &request->m_Requester, request->m_UserData2);
+    }
+
+    static bool ReserveBody(Request* request, uint32_t size)
+    {
+        if (request->m_BodyCapacity >= size)
+            return true;
+        char* body = (char*) realloc(request->m_Body, size);
+        if (!body)
+            return false;
+        request->m_Body = body;
+        request->m_BodyCapacity = size;
+        return true;
+    }
+
+    static void GetTempPath(Request* request, char* buffer, uint32_t buffer_size)
+    {
+        dmStrlCpy(buffer, request->m_Path, buffer_size);
+        dmStrlCat(buffer, "._httptmp", buffer_size);
+    }
+
+    // The body is written to a temporary file, so that the file at the path is only replaced if the request succeeds
+    static void OpenTempFile(Request* request)
+    {
+        char tmpname[DMPATH_MAX_PATH];
+        GetTempPath(request, tmpname, sizeof(tmpname));
+        request->m_File = fopen(tmpname, "wb");
+        if (!request->m_File)
+        {
+            dmLogError("Failed to open '%s' for writing", tmpname);
+            request->m_WriteError = 1;
+        }
+    }
+
+    static void CloseTempFile(Request* request, bool keep)
+    {
+        char tmpname[DMPATH_MAX_PATH];
+        GetTempPath(request, tmpname, sizeof(tmpname));
+        if (fclose(request->m_File) != 0)
+        {
+            request->m_WriteError = 1;
+        }
+        request->m_File = 0;
+
+        if (keep && !request->m_WriteError)
+        {
+            if (dmSys::Rename(request->m_Path, tmpname) == dmSys::RESULT_OK)
+            {
+                request->m_PathWritten = 1;
+                return;
+            }
+            dmLogError("Failed to rename '%s' to '%s'", tmpname, request->m_Path);
+            request->m_WriteError = 1;
+        }
+        dmSys::Unlink(tmpname);
+    }
+
+    // Called when the request is done, successfully or not. Safe to call from any of the service threads.
+    static void FinishRequest(HttpService* service, Request* request, bool ok)
+    {
+#if !defined(DM_NO_HTTP_CACHE)
+        if (request->m_CacheCreator)
+        {
+            if (!ok)
+            {
+                dmHttpCache::SetError(service->m_HttpCache, request->m_CacheCreator);
+            }
+            dmHttpCache::End(service->m_HttpCache, request->m_CacheCreator);
+            request->m_CacheCreator = 0;
+        }
+#endif
+        if (!ok)
+        {
+            request->m_CloseConnection = 1;
+        }
+
+        if (request->m_File)
+        {
+            CloseTempFile(request, ok && request->m_Response.m_Status == 200);
+        }
+
+        SendResponse(request, ok ? request->m_Response.m_Status : 0);
+        request->m_State = STATE_FINISHED;
+    }
+
+    static void FailRequest(HttpService* service, Request* request, const char* reason)
+    {
+        dmLogError("HTTP request to '%s' failed (%s, socket result: %s)", request->m_Url, reason, dmSocket::ResultToString(request->m_SocketResult));
+        FinishRequest(service, request, false);
+    }
+
+    static bool HasTimedOut(Request* request)
+    {
+        return request->m_Deadline != 0 && dmTime::GetMonotonicTime() >= request->m_Deadline;
+    }
+
+    // The timeout left for the blocking operations, or 0 for no timeout
+    static int GetRemainingTimeout(Request* request)
+    {
+        if (request->m_Deadline == 0)
+            return 0;
+        uint64_t now = dmTime::GetMonotonicTime();
+        if (now >= request->m_Deadline)
+            return 1;
+        return (int) dmMath::Min(request->m_Deadline - now, (uint64_t) 0x7fffffff);
+    }
+
+#if !defined(DM_NO_HTTP_CACHE)
+    // Size of the buffer that cached entries are read through
+    const uint32_t CACHE_READ_BUFFER_SIZE = 4 * 1024;
+
+    struct CacheReadContext
+    {
+        Request* m_Request;
+        uint32_t m_FileSize;
+        uint32_t m_Read;
+        bool     m_OutOfMemory;
+    };
+
+    static void HandleCachedContent(void* user_data, const char* content, uint32_t content_size, uint32_t file_size,
+                                    uint32_t range_start, uint32_t range_end, uint32_t document_size)
     {
-        Worker* worker = (Worker*) user_data;
-        worker->m_Status = status_code;
-        dmArray<char>& h = worker->m_Headers;
-        uint32_t len = strlen(key) + strlen(value) + 2;
+        CacheReadContext* ctx = (CacheReadContext*) user_data;
+        Request* request = ctx->m_Request;
+        request->m_Response.m_RangeStart = range_start;
+        request->m_Response.m_RangeEnd = range_end;
+        request->m_Response.m_DocumentSize = document_size;
+        ctx->m_FileSize = file_size;
+        if (content_size == 0 || ctx->m_OutOfMemory || request->m_WriteError)
+            return;
+
+        if (request->m_ResponseBuffer)
+        {
+            if (file_size > request->m_ResponseBufferSize)
+            {
+                request->m_WriteError = 1;
+                request->m_BodySize = 0;
+                return;
+            }
+            memcpy(request->m_ResponseBuffer + request->m_BodySize, content, content_size);
+        }
+        else
+        {
+            if (!ReserveBody(request, file_size + 1))
+            {
+                ctx->m_OutOfMemory = true;
+                return;
+            }
+            memcpy(request->m_Body + request->m_BodySize, content, content_size);
+        }
+        request->m_BodySize += content_size;
+        ctx->m_Read += content_size;
+    }
+
+    // Reads a cached entry into the response body. If not_modified is set, the entry is
+    // verified against the ETag of the "304 Not Modified" response instead.
+    static bool ReadFromCache(HttpService* service, Request* request, const char* etag, bool not_modified)
+    {
+        // The file at the path is only written for 200 responses
+        bool read_content = !request->m_IsHead && !request->m_Path;
+        char buffer[CACHE_READ_BUFFER_SIZE];
+        CacheReadContext ctx = { request, 0, 0, false };
+        request->m_BodySize = 0;
+
+        dmHttpClient::Result r;
+        if (not_modified)
+        {
+            r = dmHttpClient::ReadNotModified(service->m_HttpCache, request->m_CacheKey, etag, read_content,
+                                              buffer, sizeof(buffer), &HandleCachedContent, &ctx);
+        }
+        else
+        {
+            r = dmHttpClient::ReadCachedContent(service->m_HttpCache, request->m_CacheKey, etag, read_content,
+                                                buffer, sizeof(buffer), &HandleCachedContent, &ctx);
+        }
+
+        bool ok = r == dmHttpClient::RESULT_OK && !ctx.m_OutOfMemory;
+        if (ok && read_content && !request->m_WriteError && ctx.m_Read != ctx.m_FileSize)
+        {
+            ok = false;
+        }
+        if (!ok)
+        {
+            request->m_BodySize = 0;
+            return false;
+        }
+        ReportProgress(service, request, 0, request->m_BodySize, ctx.m_FileSize);
+        return true;
+    }
+
+    // Serves a GET request directly from the cache, without contacting the server, if the cache entry is trusted
+    static bool ServeFromCache(HttpService* service, Request* request)
+    {
+        if (!request->m_UseCache || strcmp(request->m_Method, "GET") != 0)
+            return false;
+
+        dmHttpCache::EntryInfo info;
+        if (dmHttpCache::GetInfo(service->m_HttpCache, request->m_CacheKey, &info) != dmHttpCache::RESULT_OK)
+            return false;
+
+        dmHttpCache::ConsistencyPolicy policy = dmHttpCache::GetConsistencyPolicy(service->m_HttpCache);
+        bool ok_etag = info.m_Verified && policy == dmHttpCache::CONSISTENCY_POLICY_TRUST_CACHE;
+        if (!ok_etag && !info.m_Valid)
+            return false;
+
+        if (!ReadFromCache(service, request, info.m_ETag, false))
+            return false;
+
+        request->m_Response.m_Status = 304;
+        FinishRequest(service, request, true);
+        return true;
+    }
+
+    // The server responded "304 Not Modified"
+    static bool HandleNotModified(HttpService* service, Request* request)
+    {
+        if (!request->m_UseCache)
+            return true;
+        return ReadFromCache(service, request, request->m_Response.m_ETag, true);
+    }
+#endif
+
+    static void AppendContent(HttpService* service, Request* request, const char* data, uint32_t size)
+    {
+        if (size == 0)
+            return;
+
+#if !defined(DM_NO_HTTP_CACHE)
+        if (request->m_CacheCreator)
+        {
+            dmHttpCache::Add(service->m_HttpCache, request->m_CacheCreator, data, size);
+        }
+#endif
+
+        if (request->m_Path)
+        {
+            if (request->m_File && !request->m_WriteError && fwrite(data, 1, size, request->m_File) != size)
+            {
+                dmLogError("Failed to write %u bytes to '%s'", size, request->m_Path);
+                request->m_WriteError = 1;
+            }
+            request->m_BodySize += size;
+            ReportProgress(service, request, 0, request->m_BodySize, request->m_Response.m_ContentLength);
+            return;
+        }
+
+        if (request->m_ResponseBuffer)
+        {
+            if (request->m_BodySize + size > request->m_ResponseBufferSize)
+            {
+                if (!request->m_WriteError)
+                {
+                    dmLogError("The response from '%s' doesn't fit in the buffer (%u bytes)", request->m_Url, request->m_ResponseBufferSize);
+                }
+                request->m_WriteError = 1;
+                return;
+            }
+            memcpy(request->m_ResponseBuffer + request->m_BodySize, data, size);
+            request->m_BodySize += size;
+            ReportProgress(service, request, 0, request->m_BodySize, request->m_Response.m_ContentLength);
+            return;
+        }
+
+        uint32_t required = request->m_BodySize + size;
+        if (required > request->m_BodyCapacity)
+        {
+            uint32_t capacity = dmMath::Max(required, dmMath::Max(request->m_BodyCapacity * 2, DEFAULT_RESPONSE_BUFFER_SIZE));
+            if (!ReserveBody(request, capacity))
+            {
+                request->m_SocketResult = dmSocket::RESULT_NOBUFS;
+                return;
+            }
+        }
+        memcpy(request->m_Body + request->m_BodySize, data, size);
+        request->m_BodySize += size;
+
+        ReportProgress(service, request, 0, request->m_BodySize, request->m_Response.m_ContentLength);
+    }
+
+    static void CompleteResponse(HttpService* service, Request* request)
+    {
+        bool ok = true;
+        if (request->m_Response.m_Status == 304)
+        {
+#if !defined(DM_NO_HTTP_CACHE)
+            ok = HandleNotModified(service, request);
+#endif
+        }
+        if (request->m_SocketResult == dmSocket::RESULT_NOBUFS)
+        {
+            dmLogError("Out of memory when receiving the response from '%s'", request->m_Url);
+            ok = false;
+        }
+        FinishRequest(service, request, ok);
+    }
+
+    static void HandleVersion(void* user_data, int major, int minor, int status, const char* status_str)
+    {
+        Request* request = (Request*) user_data;
+        dmHttpClient::SetResponseVersion(&request->m_Response, major, minor, status);
+    }
+
+    static void HandleHeader(void* user_data, const char* key, const char* value)
+    {
+        Request* request = (Request*) user_data;
+        dmHttpClient::SetResponseHeader(&request->m_Response, key, value);
+
+        dmArray<char>& h = request->m_Headers;
+        uint32_t key_len = strlen(key);
+        uint32_t value_len = strlen(value);
+        uint32_t len = key_len + value_len + 2;
         uint32_t left = h.Capacity() - h.Size();
-        if (left < len) {
-            h.OffsetCapacity((int32_t) dmMath::Max(len - left, 8U * 1024U));
+        if (left < len)
+        {
+            h.OffsetCapacity((int32_t) dmMath::Max(len - left, 1024U));
         }
-        h.PushArray(key, strlen(key));
+        h.PushArray(key, key_len);
         h.Push(':');
-        h.PushArray(value, strlen(value));
+        h.PushArray(value, value_len);
         h.Push('\n');
     }
 
-    // Called from the http thread(s)
-    void HttpContent(dmHttpClient::HResponse response, void* user_data, int status_code,
-                    const void* content_data, uint32_t content_data_size, int32_t content_length,
-                    uint32_t range_start, uint32_t range_end, uint32_t document_size,
-                    const char* method)
+    static void HandleContent(void* user_data, int offset)
     {
-        Worker* worker = (Worker*) user_data;
-        worker->m_Status = status_code;
-        worker->m_RangeStart = range_start;
-        worker->m_RangeEnd = range_end;
-        worker->m_DocumentSize = document_size;
-        dmArray<char>& r = worker->m_Response;
-        bool method_is_head = method && strcmp(method, "HEAD") == 0;
+        Request* request = (Request*) user_data;
+        request->m_HeaderSize = offset;
+    }
+
+    static void OnBody(HttpService* service, Request* request, const char* data, uint32_t size);
 
-        if (!method_is_head && !content_data && !content_data_size)
+    static void OnHeaders(HttpService* service, Request* request)
+    {
+        if (request->m_Response.m_CloseConnection)
+        {
+            request->m_CloseConnection = 1;
+        }
+        if (request->m_Response.m_Status == 204 /* No Content */)
+        {
+            request->m_Response.m_ContentLength = 0;
+        }
+
+        bool is_connect = strcmp(request->m_Method, "CONNECT") == 0;
+        if (request->m_IsHead || is_connect || request->m_Response.m_Status == 304 || request->m_Response.m_Status < 200)
+        {
+            if (request->m_Response.m_Status == 304 && request->m_Response.m_ContentLength > 0)
+            {
+                dmLogWarning("Unexpected Content-Length: %d for NOT MODIFIED response (304)", request->m_Response.m_ContentLength);
+                request->m_CloseConnection = 1;
+            }
+            request->m_BodyEncoding = BODY_ENCODING_NONE;
+        }
+        else if (request->m_Response.m_Chunked)
+        {
+            request->m_BodyEncoding = BODY_ENCODING_CHUNKED;
+        }
+        else if (request->m_Response.m_ContentLength >= 0)
         {
-            r.SetSize(0);
+            request->m_BodyEncoding = BODY_ENCODING_LENGTH;
+            request->m_BodyLeft = request->m_Response.m_ContentLength;
+        }
+        else
+        {
+            // Without Content-Length the body ends when the server closes the connection
+            request->m_BodyEncoding = BODY_ENCODING_UNTIL_CLOSE;
+            request->m_CloseConnection = 1;
+        }
+
+        if (request->m_Response.m_Status != 304)
+        {
+            // Let's make the range values valid, even if it might not be a ranged request
+            if (request->m_Response.m_DocumentSize == -1)
+            {
+                request->m_Response.m_DocumentSize = request->m_Response.m_ContentLength;
+                request->m_Response.m_RangeStart = 0;
+                request->m_Response.m_RangeEnd = request->m_Response.m_DocumentSize - 1;
+            }
+
+#if !defined(DM_NO_HTTP_CACHE)
+            bool is_ok = request->m_Response.m_Status == 200 || request->m_Response.m_Status == 206;
+            if (request->m_UseCache && !request->m_IsHead && !is_connect && is_ok)
+            {
+                uint32_t document_size = dmMath::Max(request->m_Response.m_ContentLength, request->m_Response.m_DocumentSize);
+                uint32_t range_start = request->m_Response.m_RangeStart != -1 ? request->m_Response.m_RangeStart : 0;
+                uint32_t range_end = request->m_Response.m_RangeEnd != -1 ? request->m_Response.m_RangeEnd : document_size - 1;
+                dmHttpCache::Begin(service->m_HttpCache, request->m_CacheKey, request->m_Response.m_ETag, request->m_Response.m_MaxAge,
+                                   range_start, range_end, document_size, &request->m_CacheCreator);
+            }
+#endif
+        }
+
+        if (request->m_Path && request->m_Response.m_Status == 200 && request->m_BodyEncoding != BODY_ENCODING_NONE)
+        {
+            OpenTempFile(request);
+        }
+        else if (request->m_Path || request->m_ResponseBuffer)
+        {
+            // The body isn't kept in memory
+        }
+        else if (request->m_BodyEncoding == BODY_ENCODING_LENGTH)
+        {
+            // The body is handed over to the response message as is, so allocate it once when the size is known
+            if (!ReserveBody(request, request->m_Response.m_ContentLength + 1))
+            {
+                request->m_SocketResult = dmSocket::RESULT_NOBUFS;
+            }
+        }
+
+        if (request->m_IsHead)
+        {
+            ReportProgress(service, request, 0, 0, request->m_Response.m_ContentLength);
+        }
+
+        request->m_State = STATE_RECEIVING_BODY;
+        if (request->m_BodyEncoding == BODY_ENCODING_NONE || (request->m_BodyEncoding == BODY_ENCODING_LENGTH && request->m_BodyLeft == 0))
+        {
+            if ((uint32_t) request->m_HeaderSize != request->m_ReceiveBuffer.Size())
+            {
+                dmLogError("Not all bytes were handled during the response (%d bytes left). Method: %s Status: %d", request->m_ReceiveBuffer.Size() - request->m_HeaderSize, request->m_Method, request->m_Response.m_Status);
+                request->m_CloseConnection = 1;
+            }
+            CompleteResponse(service, request);
             return;
         }
 
-        uint32_t bytes_received = 0;
-        if (!method_is_head)
+        OnBody(service, request, request->m_ReceiveBuffer.Begin() + request->m_HeaderSize, request->m_ReceiveBuffer.Size() - request->m_HeaderSize);
+    }
+
+    static void OnBody(HttpService* service, Request* request, const char* data, uint32_t size)
+    {
+        while (size > 0 && request->m_State == STATE_RECEIVING_BODY)
+        {
+            switch (request->m_BodyEncoding)
+            {
+            case BODY_ENCODING_UNTIL_CLOSE:
+                AppendContent(service, request, data, size);
+                size = 0;
+                break;
+
+            case BODY_ENCODING_LENGTH:
+                {
+                    uint32_t n = dmMath::Min(size, request->m_BodyLeft);
+                    AppendContent(service, request, data, n);
+                    request->m_BodyLeft -= n;
+                    data += n;
+                    size -= n;
+                    if (request->m_BodyLeft == 0)
+                    {
+                        if (size > 0)
+                        {
+                            dmLogError("Not all bytes were handled during the response (%d bytes left). Method: %s Status: %d", size, request->m_Method, request->m_Response.m_Status);
+                            request->m_CloseConnection = 1;
+                        }
+                        CompleteResponse(service, request);
+                        return;
+                    }
+                }
+                break;
+
+            case BODY_ENCODING_CHUNKED:
+                {
+                    uint32_t consumed = 0;
+                    const char* content = 0;
+                    uint32_t content_size = 0;
+                    dmHttpClient::ChunkResult r = dmHttpClient::DecodeChunk(&request->m_ChunkDecoder, data, size, &consumed, &content, &content_size);
+                    data += consumed;
+                    size -= consumed;
+                    if (r == dmHttpClient::CHUNK_RESULT_CONTENT)
+                    {
+                        AppendContent(service, request, content, content_size);
+                    }
+                    else if (r == dmHttpClient::CHUNK_RESULT_ERROR)
+                    {
+                        FailRequest(service, request, "invalid chunk encoding");
+                        return;
+                    }
+                    else if (r == dmHttpClient::CHUNK_RESULT_DONE)
+                    {
+                        if (size > 0)
+                        {
+                            dmLogError("Not all bytes were handled during the response (%d bytes left). Method: %s Status: %d", size, request->m_Method, request->m_Response.m_Status);
+                            request->m_CloseConnection = 1;
+                        }
+                        CompleteResponse(service, request);
+                        return;
+                    }
+                }
+                break;
+
+            default:
+                assert(false);
+                return;
+            }
+        }
+    }
+
+    static void OnData(HttpService* service, Request* request, const char* data, uint32_t size, bool end_of_stream)
+    {
+        if (request->m_State == STATE_RECEIVING_HEADERS)
+        {
+            dmArray<char>& buffer = request->m_ReceiveBuffer;
+            if (buffer.Size() + size > MAX_HEADER_SIZE)
+            {
+                FailRequest(service, request, "headers too large");
+                return;
+            }
+            // NOTE: Extra byte for null-termination
+            if (buffer.Remaining() < size + 1)
+            {
+                buffer.OffsetCapacity(dmMath::Max(size + 1 - buffer.Remaining(), 4096U));
+            }
+            buffer.PushArray(data, size);
+            buffer.Push('\0');
+            buffer.SetSize(buffer.Size() - 1);
+
+            dmHttpClient::ParseResult parse_res = dmHttpClient::ParseHeader(buffer.Begin(), request, end_of_stream, &HandleVersion, &HandleHeader, &HandleContent);
+            if (parse_res == dmHttpClient::PARSE_RESULT_NEED_MORE_DATA)
+            {
+                if (end_of_stream)
+                {
+                    FailRequest(service, request, "unexpected end of stream");
+                }
+                return;
+            }
+            else if (parse_res == dmHttpClient::PARSE_RESULT_SYNTAX_ERROR)
+            {
+                FailRequest(service, request, "invalid headers");
+                return;
+            }
+            OnHeaders(service, request);
+        }
+        else if (request->m_State == STATE_RECEIVING_BODY)
+        {
+            OnBody(service, request, data, size);
+        }
+
+        if (end_of_stream && request->m_State == STATE_RECEIVING_BODY)
+        {
+            if (request->m_BodyEncoding == BODY_ENCODING_UNTIL_CLOSE)
+            {
+                CompleteResponse(service, request);
+            }
+            else
+            {
+                FailRequest(service, request, "partial content");
+            }
+        }
+    }
+
+    static void OnConnectionError(HttpService* service, Request* request, const char* reason)
+    {
+        // A kept-alive connection may have been closed by the peer before we used it.
+        // Retry on a new connection, unless we have already received parts of the response.
+        if (request->m_Connection.m_Reused && !request->m_ReceivedData && request->m_StaleRetries < MAX_STALE_RETRIES)
+        {
+            request->m_Retry = 1;
+            return;
+        }
+        FailRequest(service, request, reason);
+    }
+
+    static dmSocket::Result SocketSend(Connection* connection, const char* buffer, int length, int* sent_bytes)
+    {
+        if (connection->m_SSLSocket)
+            return dmSSLSocket::Send(connection->m_SSLSocket, buffer, length, sent_bytes);
+        return dmSocket::Send(connection->m_Socket, buffer, length, sent_bytes);
+    }
+
+    static dmSocket::Result SocketReceive(Connection* connection, char* buffer, int length, int* received_bytes)
+    {
+        if (connection->m_SSLSocket)
+            return dmSSLSocket::Receive(connection->m_SSLSocket, buffer, length, received_bytes);
+        return dmSocket::Receive(connection->m_Socket, buffer, length, received_bytes);
+    }
+
+    static IOResult Send(HttpService* service, Request* request)
+    {
+        while (request->m_SendOffset < request->m_SendBuffer.Size())
+        {
+            int sent_bytes = 0;
+            dmSocket::Result r = SocketSend(&request->m_Connection, request->m_SendBuffer.Begin() + request->m_SendOffset,
+                                            request->m_SendBuffer.Size() - request->m_SendOffset, &sent_bytes);
+            if (r == dmSocket::RESULT_WOULDBLOCK || r == dmSocket::RESULT_TRY_AGAIN)
+            {
+                return IO_RESULT_WOULDBLOCK;
+            }
+            if (r != dmSocket::RESULT_OK)
+            {
+                request->m_SocketResult = r;
+                OnConnectionError(service, request, "send failed");
+                return IO_RESULT_OK;
+            }
+
+            request->m_SendOffset += sent_bytes;
+            if (request->m_Request.m_RequestLength > 0 && request->m_SendOffset > request->m_SendBodyOffset)
+            {
+                uint32_t body_sent = dmMath::Min(request->m_SendOffset - request->m_SendBodyOffset, request->m_Request.m_RequestLength);
+                ReportProgress(service, request, body_sent, 0, request->m_Request.m_RequestLength);
+            }
+        }
+
+        request->m_State = STATE_RECEIVING_HEADERS;
+        return IO_RESULT_OK;
+    }
+
+    static IOResult Receive(HttpService* service, Request* request, char* buffer, uint32_t buffer_size)
+    {
+        int received_bytes = 0;
+        dmSocket::Result r = SocketReceive(&request->m_Connection, buffer, (int) buffer_size, &received_bytes);
+        if (r == dmSocket::RESULT_WOULDBLOCK || r == dmSocket::RESULT_TRY_AGAIN)
+        {
+            return IO_RESULT_WOULDBLOCK;
+        }
+
+        if (r == dmSocket::RESULT_OK && received_bytes > 0)
+        {
+            request->m_ReceivedData = 1;
+            OnData(service, request, buffer, (uint32_t) received_bytes, false);
+        }
+        else if (r == dmSocket::RESULT_OK || r == dmSocket::RESULT_CONNRESET)
+        {
+            // The peer closed the connection
+            request->m_SocketResult = r;
+            request->m_CloseConnection = 1;
+            if (!request->m_ReceivedData)
+            {
+                OnConnectionError(service, request, "connection closed");
+            }
+            else
+            {
+                OnData(service, request, buffer, 0, true);
+            }
+        }
+        else
+        {
+            request->m_SocketResult = r;
+            OnConnectionError(service, request, "receive failed");
+        }
+        return IO_RESULT_OK;
+    }
+
+    static bool IsDone(Request* request)
+    {
+        return request->m_State == STATE_FINISHED || request->m_Retry;
+    }
+
+    // Progress a request on a non-blocking connection, as far as possible without blocking
+    static void Process(HttpService* service, Request* request)
+    {
+        if (request->m_State == STATE_SENDING)
+        {
+            if (Send(service, request) == IO_RESULT_WOULDBLOCK || IsDone(request))
+                return;
+        }
+
+        request->m_ReadAgain = 0;
+        for (uint32_t i = 0; !IsDone(request); ++i)
+        {
+            if (i == MAX_READS_PER_ITERATION)
+            {
+                // There may be decrypted data buffered in the secure socket, so don't wait for the socket to be readable
+                request->m_ReadAgain = 1;
+                break;
+            }
+            if (Receive(service, request, service->m_Buffer, RECEIVE_BUFFER_SIZE) == IO_RESULT_WOULDBLOCK)
+                break;
+        }
+    }
+
+    static void AppendString(dmArray<char>& buffer, const char* str, uint32_t len)
+    {
+        if (buffer.Remaining() < len)
+        {
+            buffer.OffsetCapacity(dmMath::Max(len - buffer.Remaining(), 1024U));
+        }
+        buffer.PushArray(str, len);
+    }
+
+    static void AppendString(dmArray<char>& buffer, const char* str)
+    {
+        AppendString(buffer, str, strlen(str));
+    }
+
+    static void BuildRequest(HttpService* service, Request* request)
+    {
+        dmArray<char>& b = request->m_SendBuffer;
+        dmHttpDDF::HttpRequest* r = &request->m_Request;
+
+        b.SetCapacity(1024 + r->m_HeadersLength + r->m_RequestLength);
+        b.SetSize(0);
+        AppendString(b, request->m_Method);
+        AppendString(b, " ");
+        AppendString(b, request->m_URI.m_Path);
+        AppendString(b, " HTTP/1.1\r\nHost: ");
+        AppendString(b, request->m_URI.m_Hostname);
+        AppendString(b, "\r\n");
+
+        // Headers are either 0, of a list of strings "header1:value\nheader2:value\n"
+        const char* current = (const char*) r->m_Headers;
+        const char* headers_end = current + r->m_HeadersLength;
+        while (current < headers_end)
+        {
+            const char* end = (const char*) memchr(current, '\n', headers_end - current);
+            if (!end)
+                end = headers_end;
+            const char* colon = (const char*) memchr(current, ':', end - current);
+            if (colon)
+            {
+                uint32_t value_len = end - (colon + 1);
+                if (value_len > 0 && colon[value_len] == '\0')
+                    value_len--; // The header string is null terminated
+                AppendString(b, current, colon - current);
+                AppendString(b, ": ");
+                AppendString(b, colon + 1, value_len);
+                AppendString(b, "\r\n");
+            }
+            current = end + 1;
+        }
+
+#if !defined(DM_NO_HTTP_CACHE)
+        if (request->m_UseCache)
         {
-            // do we have enough room to fit the content? if not, grow the array
-            uint32_t left = r.Capacity() - r.Size();
-            if (content_data_size > left)
+            char etag[dmHttpCache::MAX_TAG_LEN] = "";
+            if (dmHttpCache::GetETag(service->m_HttpCache, request->m_CacheKey, etag, sizeof(etag)) == dmHttpCache::RESULT_OK)
             {
-                r.OffsetCapacity(content_data_size - left);
+                AppendString(b, "If-None-Match: ");
+                AppendString(b, etag);
+                AppendString(b, "\r\n");
             }
-            r.PushArray((char*) content_data, content_data_size);
-            bytes_received = r.Size();
         }
+#endif
 
-        if (worker->m_ReportProgress && (method_is_head || content_data_size > 0))
+        bool has_body = strcmp(request->m_Method, "POST") == 0 || strcmp(request->m_Method, "PUT") == 0 || strcmp(request->m_Method, "PATCH") == 0;
+        bool chunked = has_body && request->m_Secure && r->m_RequestLength > MAX_HTTPS_POST_CHUNK_SIZE && r->m_ChunkedTransfer;
+        if (chunked)
         {
-            assert(worker->m_Service->m_ReportProgressCallback);
-
-            dmHttpDDF::HttpRequestProgress progress = {};
-            progress.m_BytesReceived                = bytes_received;
-            progress.m_BytesTotal                   = content_length;
-            progress.m_Url                          = worker->m_Request->m_Url;
-            worker->m_Service->m_ReportProgressCallback(&progress, &worker->m_CurrentRequesterURL, worker->m_ResponseUserData2);
+            AppendString(b, "Transfer-Encoding: chunked\r\n");
         }
-    }
-
-    uint32_t HttpSendContentLength(dmHttpClient::HResponse response, void* user_data)
-    {
-        Worker* worker = (Worker*) user_data;
-        return worker->m_Request->m_RequestLength;
-    }
-
-    dmHttpClient::Result HttpWrite(dmHttpClient::HResponse response, uint32_t offset, uint32_t size, void* user_data)
-    {
-        Worker* worker = (Worker*) user_data;
-        uint8_t* request = (uint8_t*)worker->m_Request->m_Request;
-        uint32_t request_len = dmMath::Min(worker->m_Request->m_RequestLength - offset, size);
-
-        dmHttpClient::Result res_write = dmHttpClient::Write(response, (const void*) &request[offset], request_len);
-
-        if (res_write == dmHttpClient::RESULT_OK && worker->m_ReportProgress && size > 0)
+        else if (has_body)
         {
-            assert(worker->m_Service->m_ReportProgressCallback);
-            dmHttpDDF::HttpRequestProgress progress = {};
-            progress.m_BytesSent                    = offset + size;
-            progress.m_BytesTotal                   = worker->m_Request->m_RequestLength;
-            worker->m_Service->m_ReportProgressCallback(&progress, &worker->m_CurrentRequesterURL, worker->m_ResponseUserData2);
+            char buf[64];
+            dmSnPrintf(buf, sizeof(buf), "Content-Length: %u\r\n", r->m_RequestLength);
+            AppendString(b, buf);
         }
+        AppendString(b, "\r\n");
 
-        return res_write;
-    }
-
-    dmHttpClient::Result HttpWriteHeaders(dmHttpClient::HResponse response, void* user_data)
-    {
-        Worker* worker = (Worker*) user_data;
-        char* headers = 0;
-        if (worker->m_Request->m_HeadersLength > 0) {
-            headers = (char*) malloc(worker->m_Request->m_HeadersLength);
-            // NOTE: We must copy the buffer as retry might happen
-            // and dmStrTok is destructive
-            // We don't know the actual size inadvance, hence the malloc()
-            memcpy(headers, (char*) worker->m_Request->m_Headers, worker->m_Request->m_HeadersLength);
-            headers[worker->m_Request->m_HeadersLength-1] = '\0';
-
-            char* s, *last;
-            s = dmStrTok(headers, "\n", &last);
-            while (s) {
-                char* colon = strchr(s, ':');
-                *colon = '\0';
-                dmHttpClient::Result r = dmHttpClient::WriteHeader(response, s, colon + 1);
-                if (r != dmHttpClient::RESULT_OK) {
-                    free(headers);
-                    return r;
-                }
-                *colon = ':';
-                s = dmStrTok(0, "\n", &last);
-            }
+        request->m_SendBodyOffset = b.Size();
+        if (!has_body)
+            return;
 
+        const char* body = (const char*) r->m_Request;
+        if (!chunked)
+        {
+            AppendString(b, body, r->m_RequestLength);
+            return;
         }
 
-        free(headers);
-        return dmHttpClient::RESULT_OK;
+        // https://en.wikipedia.org/wiki/Chunked_transfer_encoding
+        uint32_t offset = 0;
+        while (offset < r->m_RequestLength)
+        {
+            uint32_t length = dmMath::Min(r->m_RequestLength - offset, MAX_HTTPS_POST_CHUNK_SIZE);
+            char buf[64];
+            dmSnPrintf(buf, sizeof(buf), "%x\r\n", length);
+            AppendString(b, buf);
+            AppendString(b, body + offset, length);
+            AppendString(b, "\r\n");
+            offset += length;
+        }
+        // The terminating chunk + trailing blank line (currently no trailer properties)
+        AppendString(b, "0\r\n\r\n");
     }
 
-    static void MessageDestroyCallback(dmMessage::Message* message)
+    // Resets the response state, so that the request can be sent again on a new connection
+    static void ResetRequest(Request* request)
     {
-        dmHttpDDF::HttpResponse* response = (dmHttpDDF::HttpResponse*)message->m_Data;
-        free((void*) response->m_Headers);
-        free((void*) response->m_Response);
+        request->m_SendOffset = 0;
+        request->m_ReceiveBuffer.SetSize(0);
+        request->m_Headers.SetSize(0);
+        request->m_BodySize = 0;
+        request->m_Response = dmHttpClient::ResponseHeaders();
+        request->m_HeaderSize = 0;
+        request->m_BodyEncoding = BODY_ENCODING_NONE;
+        request->m_ChunkDecoder = dmHttpClient::ChunkDecoder();
+        request->m_BodyLeft = 0;
+        request->m_CloseConnection = 0;
+        request->m_ReceivedData = 0;
+        request->m_Retry = 0;
+        request->m_ReadAgain = 0;
+        request->m_SocketResult = dmSocket::RESULT_OK;
     }
 
-    static void SendResponse(const dmMessage::URL* requester, uintptr_t userdata1, uintptr_t userdata2, int status,
-                             const char* headers, uint32_t headers_length,
-                             const char* response, uint32_t response_length,
-                             const char* url,
-                             const char* filepath,
-                             uint32_t range_start,
-                             uint32_t range_end,
-                             uint32_t document_size)
+    static void DeleteRequest(Request* request)
     {
-        dmHttpDDF::HttpResponse resp;
-        resp.m_Status = status;
-        resp.m_HeadersLength = headers_length;
-        resp.m_ResponseLength = response_length;
-        resp.m_RangeStart = range_start;
-        resp.m_RangeEnd = range_end;
-        resp.m_DocumentSize = document_size;
-
-        resp.m_Headers = (uint64_t) malloc(headers_length);
-        memcpy((void*) resp.m_Headers, headers, headers_length);
-        resp.m_Response = (uint64_t) malloc(response_length);
-        memcpy((void*) resp.m_Response, response, response_length);
-        resp.m_Path = filepath;
-        resp.m_Url = url;
-
-        if (dmMessage::RESULT_OK != dmMessage::Post(0, requester, dmHttpDDF::HttpResponse::m_DDFHash, userdata1, userdata2, (uintptr_t) dmHttpDDF::HttpResponse::m_DDFDescriptor, &resp, sizeof(resp), MessageDestroyCallback) )
+        if (request->m_File)
         {
-            free((void*) resp.m_Headers);
-            free((void*) resp.m_Response);
-            dmLogWarning("Failed to return http-response. Requester deleted?");
+            CloseTempFile(request, false);
         }
+        free((void*) request->m_Request.m_Headers);
+        free((void*) request->m_Request.m_Request);
+        free(request->m_Body);
+        free(request->m_Url);
+        free(request->m_Path);
+        delete request;
     }
 
-    static const char* FindHeader(Worker* worker, const char* header, char* buffer, uint32_t buffer_length)
+    static const char* FindHeader(Request* request, const char* header, char* buffer, uint32_t buffer_length)
     {
         // Headers are either 0, of a list of strings "header1: value\nheader2: value\n"
-        const char* current = (const char*)worker->m_Request->m_Headers;
-        const char* headers_end = current + worker->m_Request->m_HeadersLength;
+        const char* current = (const char*)request->m_Request.m_Headers;
+        const char* headers_end = current + request->m_Request.m_HeadersLength;
         uint32_t header_length = strlen(header);
         while (current < headers_end)
         {
@@ -275,126 +1149,350 @@ namespace dmHttpService
         return 0;
     }
 
-    void HandleRequest(Worker* worker, const dmMessage::URL* requester, uintptr_t userdata1, uintptr_t userdata2, dmHttpDDF::HttpRequest* request)
+    static dmhash_t CalculateHostKey(const dmURI::Parts* uri, const dmURI::Parts* proxy_uri, bool secure)
     {
-        dmURI::Parts url;
-        request->m_Method = (const char*) ((uintptr_t) request + (uintptr_t) request->m_Method);
-        request->m_Url = (const char*) ((uintptr_t) request + (uintptr_t) request->m_Url);
+        HashState64 hs;
+        dmHashInit64(&hs, false);
+        dmHashUpdateBuffer64(&hs, uri->m_Hostname, strlen(uri->m_Hostname));
+        dmHashUpdateBuffer64(&hs, &uri->m_Port, sizeof(uri->m_Port));
+        dmHashUpdateBuffer64(&hs, &secure, sizeof(secure));
+        dmHashUpdateBuffer64(&hs, proxy_uri->m_Hostname, strlen(proxy_uri->m_Hostname));
+        dmHashUpdateBuffer64(&hs, &proxy_uri->m_Port, sizeof(proxy_uri->m_Port));
+        return dmHashFinal64(&hs);
+    }
 
-        dmURI::Result ur = dmURI::Parse(request->m_Url, &url);
+    // Creates a request from the message. Returns 0 if the request was answered directly
+    static Request* NewRequest(HttpService* service, dmMessage::Message* message)
+    {
+        dmHttpDDF::HttpRequest* ddf = (dmHttpDDF::HttpRequest*) &message->m_Data[0];
+        const char* method = (const char*) ((uintptr_t) ddf + (uintptr_t) ddf->m_Method);
+        const char* url = (const char*) ((uintptr_t) ddf + (uintptr_t) ddf->m_Url);
+
+        Request* request = new Request();
+        memcpy(&request->m_Request, ddf, sizeof(*ddf));
+        memcpy(&request->m_Requester, &message->m_Sender, sizeof(dmMessage::URL));
+        request->m_UserData1 = message->m_UserData1;
+        request->m_UserData2 = message->m_UserData2;
+        dmStrlCpy(request->m_Method, method, sizeof(request->m_Method));
+        request->m_Url = strdup(url);
+        // The path is a pointer into the requesting Lua state, so copy it while we know it's valid
+        request->m_Path = ddf->m_Path ? strdup(ddf->m_Path) : 0;
+        request->m_Request.m_Method = request->m_Method;
+        request->m_Request.m_Url = request->m_Url;
+        request->m_Request.m_Path = request->m_Path;
+        request->m_Request.m_Proxy = 0;
+        request->m_ResponseBuffer = (char*) ddf->m_ResponseBuffer;
+        request->m_ResponseBufferSize = ddf->m_ResponseBufferSize;
+        request->m_Deadline = ddf->m_Timeout ? dmTime::GetMonotonicTime() + ddf->m_Timeout : 0;
+        request->m_State = STATE_PENDING;
+        request->m_IsHead = strcmp(method, "HEAD") == 0;
+        ResetRequest(request);
+
+        dmURI::Result ur = dmURI::Parse(url, &request->m_URI);
+        if (ur == dmURI::RESULT_OK && ddf->m_Proxy)
+        {
+            ur = dmURI::Parse(ddf->m_Proxy, &request->m_ProxyURI);
+        }
         if (ur != dmURI::RESULT_OK)
         {
-            SendResponse(requester, 0, 0, 0, 0, 0, 0, 0, worker->m_Request->m_Url, 0, 0, 0, 0);
-            return;
+            dmLogError("Failed to parse the url '%s'", url);
+            FinishRequest(service, request, false);
+            DeleteRequest(request);
+            return 0;
         }
-        if (url.m_Path[0] == '\0') {
+        if (request->m_URI.m_Path[0] == '\0')
+        {
             // NOTE: Default to / for empty path
-            url.m_Path[0] = '/';
-            url.m_Path[1] = '\0';
+            request->m_URI.m_Path[0] = '/';
+            request->m_URI.m_Path[1] = '\0';
+        }
+
+        request->m_Secure = strcmp(request->m_URI.m_Scheme, "https") == 0 || strcmp(request->m_URI.m_Scheme, "wss") == 0;
+        request->m_UseProxy = request->m_ProxyURI.m_Hostname[0] != '\0';
+        request->m_HostKey = CalculateHostKey(&request->m_URI, &request->m_ProxyURI, request->m_Secure);
+#if !defined(DM_NO_HTTP_CACHE)
+        request->m_UseCache = service->m_HttpCache != 0 && !ddf->m_IgnoreCache;
+#endif
+
+        dmSnPrintf(request->m_CacheKey, sizeof(request->m_CacheKey), "%s://%s:%d%s", request->m_Secure ? "https" : "http",
+                   request->m_URI.m_Hostname, request->m_URI.m_Port, request->m_URI.m_Path);
+        char header_buffer[256];
+        const char* range_header = FindHeader(request, "Range:", header_buffer, sizeof(header_buffer));
+        if (range_header)
+        {
+            // If we find a range header, let's use it to append to the cache key
+            range_header += strlen("Range:");
+            while(*range_header == ' ')
+                ++range_header;
+            dmStrlCat(request->m_CacheKey, "=", sizeof(request->m_CacheKey));
+            dmStrlCat(request->m_CacheKey, range_header, sizeof(request->m_CacheKey)); // "=bytes=%d-%d"
+        }
+
+#if !defined(DM_NO_HTTP_CACHE)
+        if (ServeFromCache(service, request))
+        {
+            DeleteRequest(request);
+            return 0;
+        }
+#endif
+
+        BuildRequest(service, request);
+        return request;
+    }
+
+    static void CloseConnection(HttpService* service, Connection* connection)
+    {
+        dmConnectionPool::Close(service->m_Pool, connection->m_Handle);
+        connection->m_Handle = 0;
+    }
+
+    // Called from the event loop when the request no longer needs its connection
+    static void ReleaseConnection(HttpService* service, Request* request)
+    {
+        Connection* connection = &request->m_Connection;
+        if (connection->m_Handle == 0)
+        {
+            // The connection slot was reserved, but the connect failed
+            service->m_ConnectionCount--;
+            return;
+        }
+
+        if (request->m_CloseConnection || request->m_State != STATE_FINISHED)
+        {
+            CloseConnection(service, connection);
+            service->m_ConnectionCount--;
+            return;
         }
 
-        dmURI::Parts proxy_url;
-        if (request->m_Proxy)
+        if (service->m_IdleConnections.Full())
         {
-            dmURI::Result pr = dmURI::Parse(request->m_Proxy, &proxy_url);
-            if (pr != dmURI::RESULT_OK)
+            service->m_IdleConnections.OffsetCapacity(16);
+        }
+        connection->m_IdleSince = dmTime::GetMonotonicTime();
+        connection->m_Reused = 1;
+        service->m_IdleConnections.Push(*connection);
+        connection->m_Handle = 0;
+    }
+
+    // An idle connection should have nothing to read. If it has, the peer closed it or sent garbage.
+    static bool IsIdleConnectionAlive(HttpService* service, Connection* connection)
+    {
+        dmSocket::Selector* selector = &service->m_Selector;
+        dmSocket::SelectorZero(selector);
+        uint32_t index = dmSocket::SelectorAdd(selector, dmSocket::SELECTOR_KIND_READ, connection->m_Socket);
+        dmSocket::SelectorSet(selector, dmSocket::SELECTOR_KIND_EXCEPT, connection->m_Socket);
+        dmSocket::Select(selector, 0);
+        return !dmSocket::SelectorIsSetAt(selector, dmSocket::SELECTOR_KIND_READ, index) &&
+               !dmSocket::SelectorIsSetAt(selector, dmSocket::SELECTOR_KIND_EXCEPT, index);
+    }
+
+    static bool TakeIdleConnection(HttpService* service, dmhash_t host_key, Connection* out)
+    {
+        dmArray<Connection>& idle = service->m_IdleConnections;
+        // Prefer the most recently used connection
+        for (int32_t i = (int32_t) idle.Size() - 1; i >= 0; --i)
+        {
+            if (idle[i].m_HostKey != host_key)
+                continue;
+
+            Connection connection = idle[i];
+            idle.EraseSwap(i);
+            if (IsIdleConnectionAlive(service, &connection))
             {
-                SendResponse(requester, 0, 0, 0, 0, 0, 0, 0, worker->m_Request->m_Url, 0, 0, 0, 0);
-                return;
+                *out = connection;
+                return true;
             }
+            CloseConnection(service, &connection);
+            service->m_ConnectionCount--;
         }
-        else
+        return false;
+    }
+
+    static bool CloseOldestIdleConnection(HttpService* service)
+    {
+        dmArray<Connection>& idle = service->m_IdleConnections;
+        if (idle.Empty())
+            return false;
+        uint32_t oldest = 0;
+        for (uint32_t i = 1; i < idle.Size(); ++i)
         {
-            memset(&proxy_url, 0, sizeof(proxy_url));
+            if (idle[i].m_IdleSince < idle[oldest].m_IdleSince)
+                oldest = i;
         }
+        CloseConnection(service, &idle[oldest]);
+        idle.EraseSwap(oldest);
+        service->m_ConnectionCount--;
+        return true;
+    }
 
-        if (worker->m_Client == 0 ||
-            !dmURI::Compare(&url, &worker->m_CurrentURL) ||
-            !dmURI::Compare(&proxy_url, &worker->m_CurrentProxyURL)) {
-
-            if (worker->m_Client) {
-                dmHttpClient::Delete(worker->m_Client);
+    static void ExpireIdleConnections(HttpService* service)
+    {
+        dmArray<Connection>& idle = service->m_IdleConnections;
+        uint64_t now = dmTime::GetMonotonicTime();
+        for (uint32_t i = 0; i < idle.Size();)
+        {
+            if (now - idle[i].m_IdleSince >= IDLE_CONNECTION_TIMEOUT)
+            {
+                CloseConnection(service, &idle[i]);
+                idle.EraseSwap(i);
+                service->m_ConnectionCount--;
+            }
+            else
+            {
+                ++i;
             }
-            // New connection
-            dmHttpClient::NewParams params;
-            params.m_HttpContent = &HttpContent;
-            params.m_HttpHeader = &HttpHeader;
-            params.m_HttpSendContentLength = &HttpSendContentLength;
-            params.m_HttpWrite = &HttpWrite;
-            params.m_HttpWriteHeaders = &HttpWriteHeaders;
-            params.m_Userdata = worker;
-            params.m_HttpCache = worker->m_Service->m_HttpCache;
-            params.m_RequestTimeout = request->m_Timeout;
+        }
+    }
 
-            worker->m_Client = dmHttpClient::New(&params, &url, &worker->m_Canceled, &proxy_url);
+    static void QueueConnect(HttpService* service, Request* request)
+    {
+        request->m_State = STATE_CONNECTING;
+        DM_MUTEX_SCOPED_LOCK(service->m_ConnectMutex);
+        if (service->m_ConnectQueue.Full())
+        {
+            service->m_ConnectQueue.OffsetCapacity(64);
+        }
+        service->m_ConnectQueue.Push(request);
+        dmConditionVariable::Signal(service->m_ConnectCondition);
+    }
+
+    static void AddActive(HttpService* service, Request* request)
+    {
+        if (service->m_Active.Full())
+        {
+            service->m_Active.OffsetCapacity(64);
+        }
+        service->m_Active.Push(request);
+    }
 
-            memcpy(&worker->m_CurrentURL, &url, sizeof(url));
-            memcpy(&worker->m_CurrentProxyURL, &proxy_url, sizeof(proxy_url));
+    static void AddPending(HttpService* service, Request* request)
+    {
+        request->m_State = STATE_PENDING;
+        if (service->m_Pending.Full())
+        {
+            service->m_Pending.OffsetCapacity(64);
         }
+        service->m_Pending.Push(request);
+    }
+
+    // Hands out connections to the pending requests, in the order they were made
+    static void StartPending(HttpService* service)
+    {
+        dmArray<Request*>& pending = service->m_Pending;
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < pending.Size(); ++i)
+        {
+            Request* request = pending[i];
+            if (HasTimedOut(request))
+            {
+                FailRequest(service, request, "timed out");
+                DeleteRequest(request);
+                continue;
+            }
+
+            if (TakeIdleConnection(service, request->m_HostKey, &request->m_Connection))
+            {
+                if (request->m_Connection.m_Blocking)
+                {
+                    QueueConnect(service, request);
+                }
+                else
+                {
+                    request->m_State = STATE_SENDING;
+                    AddActive(service, request);
+                }
+                continue;
+            }
 
-        worker->m_Response.SetSize(0);
-        worker->m_Response.SetCapacity(DEFAULT_RESPONSE_BUFFER_SIZE);
-        worker->m_Headers.SetSize(0);
-        worker->m_Headers.SetCapacity(DEFAULT_HEADER_BUFFER_SIZE);
-        worker->m_Filepath = request->m_Path;
-        worker->m_RangeStart = 0;
-        worker->m_RangeEnd = 0;
-        worker->m_DocumentSize = 0;
-        worker->m_ReportProgress = false;
+            if (service->m_ConnectionCount < service->m_MaxConnections || CloseOldestIdleConnection(service))
+            {
+                service->m_ConnectionCount++;
+                QueueConnect(service, request);
+                continue;
+            }
+
+            pending[kept++] = request;
+        }
+        pending.SetSize(kept);
+    }
 
-        if (request->m_ReportProgress)
+    static void PollActive(HttpService* service)
+    {
+        dmArray<Request*>& active = service->m_Active;
+        dmSocket::Selector* selector = &service->m_Selector;
+        dmSocket::SelectorZero(selector);
+        bool read_again = false;
+        // Each request has its own connection, so the selector entry of a request is at the index of the request
+        for (uint32_t i = 0; i < active.Size(); ++i)
         {
-            worker->m_ReportProgress    = request->m_ReportProgress;
-            worker->m_ResponseUserData1 = userdata1;
-            worker->m_ResponseUserData2 = userdata2;
-            memcpy(&worker->m_CurrentRequesterURL, requester, sizeof(dmMessage::URL));
+            Request* request = active[i];
+            dmSocket::SelectorKind kind = request->m_State == STATE_SENDING ? dmSocket::SELECTOR_KIND_WRITE : dmSocket::SELECTOR_KIND_READ;
+            dmSocket::SelectorAdd(selector, kind, request->m_Connection.m_Socket);
+            read_again |= request->m_ReadAgain;
         }
 
-        if (worker->m_Client) {
-            worker->m_Request = request;
-            dmHttpClient::SetOptionInt(worker->m_Client, dmHttpClient::OPTION_REQUEST_TIMEOUT, request->m_Timeout);
-            dmHttpClient::SetOptionInt(worker->m_Client, dmHttpClient::OPTION_REQUEST_IGNORE_CACHE, request->m_IgnoreCache);
-            dmHttpClient::SetOptionInt(worker->m_Client, dmHttpClient::OPTION_REQUEST_CHUNKED_TRANSFER, request->m_ChunkedTransfer);
+        dmSocket::Select(selector, read_again ? 0 : POLL_TIMEOUT);
 
-            char cache_key[dmURI::MAX_URI_LEN];
-            dmHttpClient::GetURI(worker->m_Client, url.m_Path, cache_key, sizeof(cache_key));
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < active.Size(); ++i)
+        {
+            Request* request = active[i];
+            dmSocket::SelectorKind kind = request->m_State == STATE_SENDING ? dmSocket::SELECTOR_KIND_WRITE : dmSocket::SELECTOR_KIND_READ;
+            if (request->m_ReadAgain || dmSocket::SelectorIsSetAt(selector, kind, i) || dmSocket::SelectorIsSetAt(selector, dmSocket::SELECTOR_KIND_EXCEPT, i))
+            {
+                Process(service, request);
+            }
 
-            char header_buffer[256];
-            const char* range_header = FindHeader(worker, "Range:", header_buffer, sizeof(header_buffer));
-            if (range_header)
+            if (!IsDone(request) && HasTimedOut(request))
             {
-                // If we find a range header, let's use it to append to the cache key
-                range_header += strlen("Range:");
-                while(*range_header == ' ')
-                    ++range_header;
-                dmStrlCat(cache_key, "=", sizeof(cache_key));
-                dmStrlCat(cache_key, range_header, sizeof(cache_key));// "=bytes=%d-%d"
+                request->m_SocketResult = dmSocket::RESULT_WOULDBLOCK;
+                FailRequest(service, request, "timed out");
             }
-            dmHttpClient::SetCacheKey(worker->m_Client, cache_key);
 
-            dmHttpClient::Result r = dmHttpClient::Request(worker->m_Client, request->m_Method, url.m_Path);
+            if (request->m_Retry)
+            {
+                CloseConnection(service, &request->m_Connection);
+                service->m_ConnectionCount--;
+                request->m_StaleRetries++;
+                ResetRequest(request);
+                AddPending(service, request);
+                continue;
+            }
 
-            if (r == dmHttpClient::RESULT_OK || r == dmHttpClient::RESULT_NOT_200_OK) {
-                SendResponse(requester, userdata1, userdata2, worker->m_Status, worker->m_Headers.Begin(), worker->m_Headers.Size(), worker->m_Response.Begin(), worker->m_Response.Size(), request->m_Url, worker->m_Filepath,
-                                    worker->m_RangeStart, worker->m_RangeEnd, worker->m_DocumentSize);
-            } else {
-                // TODO: Error codes to lua?
-                dmLogError("HTTP request to '%s' failed (http result: %d  socket result: %d)", request->m_Url, r, GetLastSocketResult(worker->m_Client));
-                SendResponse(requester, userdata1, userdata2, 0, worker->m_Headers.Begin(), worker->m_Headers.Size(), worker->m_Response.Begin(), worker->m_Response.Size(), request->m_Url, worker->m_Filepath,
-                                worker->m_RangeStart, worker->m_RangeEnd, worker->m_DocumentSize);
+            if (request->m_State == STATE_FINISHED)
+            {
+                ReleaseConnection(service, request);
+                DeleteRequest(request);
+                continue;
             }
-        } else {
-            // TODO: Error codes to lua?
-            SendResponse(requester, userdata1, userdata2, 0, worker->m_Headers.Begin(), worker->m_Headers.Size(), worker->m_Response.Begin(), worker->m_Response.Size(), request->m_Url, worker->m_Filepath,
-                            worker->m_RangeStart, worker->m_RangeEnd, worker->m_DocumentSize);
-            dmLogError("Unable to create HTTP connection to '%s'. No route to host?", request->m_Url);
+
+            active[kept++] = request;
+        }
+        active.SetSize(kept);
+    }
+
+    // A connect thread is done with the request
+    static void OnConnected(HttpService* service, Request* request)
+    {
+        if (request->m_State == STATE_SENDING)
+        {
+            AddActive(service, request);
+            return;
         }
+
+        // The request was completed (or failed) on the connect thread
+        assert(request->m_State == STATE_FINISHED);
+        ReleaseConnection(service, request);
+        DeleteRequest(request);
     }
 
-    void Dispatch(dmMessage::Message *message, void* user_ptr)
+    static void Dispatch(dmMessage::Message *message, void* user_ptr)
     {
-        Worker* worker = (Worker*) user_ptr;
-        if (!worker->m_Run) {
+        HttpService* service = (HttpService*) user_ptr;
+
+        if (message->m_Id == service->m_ConnectedMessageId && message->m_Descriptor == 0)
+        {
+            OnConnected(service, (Request*) message->m_UserData1);
             return;
         }
 
@@ -404,14 +1502,23 @@ namespace dmHttpService
 
             if (message->m_Descriptor == (uintptr_t) dmHttpDDF::HttpRequest::m_DDFDescriptor)
             {
-                dmHttpDDF::HttpRequest* request = (dmHttpDDF::HttpRequest*) &message->m_Data[0];
-                HandleRequest(worker, &message->m_Sender, 0, message->m_UserData2, request);
-                free((void*) request->m_Headers);
-                free((void*) request->m_Request);
+                if (!service->m_Run)
+                {
+                    dmHttpDDF::HttpRequest* request = (dmHttpDDF::HttpRequest*) &message->m_Data[0];
+                    free((void*) request->m_Headers);
+                    free((void*) request->m_Request);
+                    return;
+                }
+
+                Request* request = NewRequest(service, message);
+                if (request)
+                {
+                    AddPending(service, request);
+                }
             }
             else if (message->m_Descriptor == (uintptr_t) dmHttpDDF::StopHttp::m_DDFDescriptor)
             {
-                worker->m_Run = false;
+                service->m_Run = false;
             }
             else
             {
@@ -435,50 +1542,272 @@ namespace dmHttpService
         }
     }
 
-    void LoadBalance(dmMessage::Message *message, void* user_ptr)
+    static void Loop(void* arg)
     {
-        HttpService* service = (HttpService*) user_ptr;
-        if (message->m_Descriptor == (uintptr_t) dmHttpDDF::StopHttp::m_DDFDescriptor) {
-            service->m_Run = false;
-        } else {
-            dmMessage::URL r = message->m_Receiver;
-            r.m_Socket = service->m_Workers[service->m_LoadBalanceCount % service->m_Workers.Size()]->m_Socket;
-            dmMessage::Post(&message->m_Sender,
-                            &r,
-                            message->m_Id,
-                            message->m_UserData1,
-                            message->m_UserData2,
-                            message->m_Descriptor,
-                            message->m_Data,
-                            message->m_DataSize, 0);
-            service->m_LoadBalanceCount++;
+        HttpService* service = (HttpService*) arg;
+
+        uint64_t next_flush = dmTime::GetMonotonicTime() + CACHE_FLUSH_PERIOD;
+        while (service->m_Run)
+        {
+            if (service->m_Active.Empty())
+            {
+                // Nothing to poll, so wait for new requests or connections
+                dmMessage::DispatchBlocking(service->m_Socket, &Dispatch, service);
+            }
+            else
+            {
+                PollActive(service);
+                dmMessage::Dispatch(service->m_Socket, &Dispatch, service);
+            }
+            if (!service->m_Run)
+                break;
+
+            StartPending(service);
+            ExpireIdleConnections(service);
+
+            if (service->m_HttpCache && dmTime::GetMonotonicTime() > next_flush) {
+                dmHttpCache::Flush(service->m_HttpCache);
+                next_flush = dmTime::GetMonotonicTime() + CACHE_FLUSH_PERIOD;
+            }
+        }
+
+        for (uint32_t i = 0; i < service->m_Active.Size(); ++i)
+        {
+            Request* request = service->m_Active[i];
+            CloseConnection(service, &request->m_Connection);
+            DeleteRequest(request);
+        }
+        service->m_Active.SetSize(0);
+        for (uint32_t i = 0; i < service->m_Pending.Size(); ++i)
+        {
+            DeleteRequest(service->m_Pending[i]);
+        }
+        service->m_Pending.SetSize(0);
+        for (uint32_t i = 0; i < service->m_IdleConnections.Size(); ++i)
+        {
+            CloseConnection(service, &service->m_IdleConnections[i]);
         }
+        service->m_IdleConnections.SetSize(0);
     }
 
-    static void Loop(void* arg)
+    // Blocking helpers used by the connect threads
+
+    static bool SetBlocking(Connection* connection, bool blocking)
     {
-        Worker* worker = (Worker*) arg;
+        if (dmSocket::SetBlocking(connection->m_Socket, blocking) != dmSocket::RESULT_OK)
+            return false;
+        if (connection->m_SSLSocket && dmSSLSocket::SetBlocking(connection->m_SSLSocket, blocking) != dmSocket::RESULT_OK)
+        {
+            dmSocket::SetBlocking(connection->m_Socket, !blocking);
+            return false;
+        }
+        if (blocking)
+        {
+            dmSocket::SetSendTimeout(connection->m_Socket, SOCKET_TIMEOUT);
+            dmSocket::SetReceiveTimeout(connection->m_Socket, SOCKET_TIMEOUT);
+            if (connection->m_SSLSocket)
+            {
+                dmSSLSocket::SetReceiveTimeout(connection->m_SSLSocket, SOCKET_TIMEOUT);
+            }
+        }
+        return true;
+    }
+
+    // Sends a CONNECT request to the proxy, to tunnel the connection to the host
+    static bool ConnectProxy(HttpService* service, Worker* worker, Request* request)
+    {
+        Connection* connection = &request->m_Connection;
+        SetBlocking(connection, true);
+
+        char buf[dmURI::MAX_LOCATION_LEN * 2 + 64];
+        dmSnPrintf(buf, sizeof(buf), "CONNECT %s:%d HTTP/1.1\r\nHost: %s:%d\r\n\r\n",
+                   request->m_URI.m_Hostname, request->m_URI.m_Port, request->m_URI.m_Hostname, request->m_URI.m_Port);
+
+        int length = strlen(buf);
+        int offset = 0;
+        while (offset < length)
+        {
+            int sent_bytes = 0;
+            dmSocket::Result r = dmSocket::Send(connection->m_Socket, buf + offset, length - offset, &sent_bytes);
+            if ((r == dmSocket::RESULT_WOULDBLOCK || r == dmSocket::RESULT_TRY_AGAIN) && !HasTimedOut(request) && !service->m_Cancel)
+                continue;
+            if (r != dmSocket::RESULT_OK)
+            {
+                request->m_SocketResult = r;
+                return false;
+            }
+            offset += sent_bytes;
+        }
 
-        uint64_t flush_period = 5 * 1000000U;
-        uint64_t next_flush = dmTime::GetMonotonicTime() + flush_period;
-        while (worker->m_Run)
+        // Read the proxy response, one byte at a time, so that nothing after the headers is consumed
+        uint32_t received = 0;
+        while (received < RECEIVE_BUFFER_SIZE - 1)
         {
-            dmMessage::DispatchBlocking(worker->m_Socket, &Dispatch, worker);
-            if (!worker->m_Run)
+            int received_bytes = 0;
+            dmSocket::Result r = dmSocket::Receive(connection->m_Socket, worker->m_Buffer + received, 1, &received_bytes);
+            if ((r == dmSocket::RESULT_WOULDBLOCK || r == dmSocket::RESULT_TRY_AGAIN) && !HasTimedOut(request) && !service->m_Cancel)
+                continue;
+            if (r != dmSocket::RESULT_OK || received_bytes == 0)
+            {
+                request->m_SocketResult = r;
+                return false;
+            }
+            received++;
+            if (received >= 4 && memcmp(worker->m_Buffer + received - 4, "\r\n\r\n", 4) == 0)
                 break;
+        }
+        worker->m_Buffer[received] = '\0';
+
+        int major, minor, status;
+        if (sscanf(worker->m_Buffer, "HTTP/%d.%d %d", &major, &minor, &status) != 3 || status != 200)
+        {
+            dmLogError("Proxy '%s' refused the connection to '%s'", request->m_ProxyURI.m_Location, request->m_URI.m_Location);
+            return false;
+        }
+
+        if (request->m_Secure)
+        {
+            dmConnectionPool::Result r = dmConnectionPool::CreateSSLSocket(service->m_Pool, connection->m_Handle, request->m_URI.m_Hostname, GetRemainingTimeout(request), &request->m_SocketResult);
+            if (r != dmConnectionPool::RESULT_OK)
+                return false;
+            connection->m_SSLSocket = dmConnectionPool::GetSSLSocket(service->m_Pool, connection->m_Handle);
+        }
+        return true;
+    }
+
+    static bool Dial(HttpService* service, Worker* worker, Request* request)
+    {
+        Connection* connection = &request->m_Connection;
+        const dmURI::Parts* uri = request->m_UseProxy ? &request->m_ProxyURI : &request->m_URI;
+        bool secure = request->m_UseProxy ? false : request->m_Secure;
+
+        dmConnectionPool::HConnection handle = 0;
+        dmConnectionPool::Result r = dmConnectionPool::Dial(service->m_Pool, uri->m_Hostname, uri->m_Port, secure, GetRemainingTimeout(request),
+                                                            &service->m_Cancel, &handle, &request->m_SocketResult);
+        if (r != dmConnectionPool::RESULT_OK)
+        {
+            return false;
+        }
+
+        memset(connection, 0, sizeof(*connection));
+        connection->m_Handle = handle;
+        connection->m_Socket = dmConnectionPool::GetSocket(service->m_Pool, handle);
+        connection->m_SSLSocket = dmConnectionPool::GetSSLSocket(service->m_Pool, handle);
+        connection->m_HostKey = request->m_HostKey;
+        connection->m_Reused = dmConnectionPool::GetReuseCount(service->m_Pool, handle) > 0;
+
+        if (request->m_UseProxy && !ConnectProxy(service, worker, request))
+        {
+            dmConnectionPool::Close(service->m_Pool, handle);
+            connection->m_Handle = 0;
+            return false;
+        }
+
+        dmSocket::SetNoDelay(connection->m_Socket, true);
+        return true;
+    }
+
+    // Runs the request to completion on a blocking connection
+    static void RunBlocking(HttpService* service, Worker* worker, Request* request)
+    {
+        while (!IsDone(request))
+        {
+            IOResult r;
+            if (request->m_State == STATE_SENDING)
+                r = Send(service, request);
+            else
+                r = Receive(service, request, worker->m_Buffer, RECEIVE_BUFFER_SIZE);
 
-            if (worker->m_CacheFlusher && dmTime::GetMonotonicTime() > next_flush) {
-                dmHttpCache::Flush(worker->m_Service->m_HttpCache);
-                next_flush = dmTime::GetMonotonicTime() + flush_period;
+            if (r == IO_RESULT_WOULDBLOCK && (HasTimedOut(request) || service->m_Cancel))
+            {
+                request->m_SocketResult = dmSocket::RESULT_WOULDBLOCK;
+                FailRequest(service, request, "timed out");
             }
         }
     }
 
-    static void LoadBalancer(void* arg)
+    static void Connect(HttpService* service, Worker* worker, Request* request)
     {
-        HttpService* service = (HttpService*) arg;
-        while (service->m_Run) {
-            dmMessage::DispatchBlocking(service->m_Socket, &LoadBalance, service);
+        while (true)
+        {
+            if (request->m_Connection.m_Handle == 0 && !Dial(service, worker, request))
+            {
+                dmLogError("Unable to create HTTP connection to '%s'. No route to host?", request->m_Url);
+                FinishRequest(service, request, false);
+                return;
+            }
+
+            request->m_State = STATE_SENDING;
+            Connection* connection = &request->m_Connection;
+            if (!connection->m_Blocking)
+            {
+                if (SetBlocking(connection, false))
+                    return; // Continue on the event loop
+                connection->m_Blocking = 1;
+            }
+
+            SetBlocking(connection, true);
+            RunBlocking(service, worker, request);
+            if (!request->m_Retry)
+                return;
+
+            dmConnectionPool::Close(service->m_Pool, connection->m_Handle);
+            connection->m_Handle = 0;
+            request->m_StaleRetries++;
+            ResetRequest(request);
+        }
+    }
+
+    static void ConnectThread(void* arg)
+    {
+        Worker* worker = (Worker*) arg;
+        HttpService* service = worker->m_Service;
+
+        while (true)
+        {
+            Request* request = 0;
+            {
+                DM_MUTEX_SCOPED_LOCK(service->m_ConnectMutex);
+                while (service->m_ConnectRun && service->m_ConnectQueue.Empty())
+                {
+                    dmConditionVariable::Wait(service->m_ConnectCondition, service->m_ConnectMutex);
+                }
+                if (!service->m_ConnectRun)
+                    break;
+
+                dmArray<Request*>& queue = service->m_ConnectQueue;
+                request = queue[0];
+                memmove(queue.Begin(), queue.Begin() + 1, (queue.Size() - 1) * sizeof(Request*));
+                queue.SetSize(queue.Size() - 1);
+            }
+
+            Connect(service, worker, request);
+
+            dmMessage::URL url;
+            dmMessage::ResetURL(&url);
+            url.m_Socket = service->m_Socket;
+            dmMessage::Post(0, &url, service->m_ConnectedMessageId, (uintptr_t) request, 0, 0, 0, 0, 0);
+        }
+    }
+
+    // Used when shutting down, to free the requests that are still in the socket queue
+    static void DispatchRemaining(dmMessage::Message *message, void* user_ptr)
+    {
+        HttpService* service = (HttpService*) user_ptr;
+        if (message->m_Id == service->m_ConnectedMessageId && message->m_Descriptor == 0)
+        {
+            Request* request = (Request*) message->m_UserData1;
+            if (request->m_Connection.m_Handle)
+            {
+                CloseConnection(service, &request->m_Connection);
+            }
+            DeleteRequest(request);
+        }
+        else if (message->m_Descriptor == (uintptr_t) dmHttpDDF::HttpRequest::m_DDFDescriptor)
+        {
+            dmHttpDDF::HttpRequest* request = (dmHttpDDF::HttpRequest*) &message->m_Data[0];
+            free((void*) request->m_Headers);
+            free((void*) request->m_Request);
         }
     }
 
@@ -487,42 +1816,44 @@ namespace dmHttpService
         HttpService* service = new HttpService;
 
         service->m_HttpCache = params->m_HttpCache;
+        service->m_ReportProgressCallback = params->m_ReportProgressCallback;
+        g_ReleaseResponseBufferCallback = params->m_ReleaseResponseBufferCallback;
+        service->m_ConnectedMessageId = dmHashString64("http_service_connected");
+        service->m_MaxConnections = dmMath::Max(1U, params->m_MaxConnections);
 
-        int threadcount = params->m_ThreadCount;
+        int threadcount = dmMath::Max(1, (int) params->m_ThreadCount);
 #if defined(__NX__)
         if (threadcount > 2)
             threadcount = 2;
 #endif
 
+        dmConnectionPool::Params pool_params;
+        pool_params.m_MaxConnections = service->m_MaxConnections;
+        dmConnectionPool::New(&pool_params, &service->m_Pool);
+
+        service->m_Buffer = (char*) malloc(RECEIVE_BUFFER_SIZE);
+        service->m_Pending.SetCapacity(64);
+        service->m_Active.SetCapacity(64);
+        service->m_IdleConnections.SetCapacity(16);
+        service->m_ConnectQueue.SetCapacity(64);
+        service->m_ConnectMutex = dmMutex::New();
+        service->m_ConnectCondition = dmConditionVariable::New();
+
         service->m_Run = true;
+        service->m_ConnectRun = true;
         dmMessage::NewSocket(HTTP_SOCKET_NAME, &service->m_Socket);
+
         service->m_Workers.SetCapacity(threadcount);
-        for (uint32_t i = 0; i < threadcount; ++i)
+        for (int i = 0; i < threadcount; ++i)
         {
             Worker* worker = new Worker();
-            char tmp[128];
-            dmSnPrintf(tmp, sizeof(tmp), "@__http_worker_%d", i);
-            dmMessage::NewSocket(tmp, &worker->m_Socket);
-            worker->m_Client = 0;
-            memset(&worker->m_CurrentURL, 0, sizeof(worker->m_CurrentURL));
-            memset(&worker->m_CurrentProxyURL, 0, sizeof(worker->m_CurrentProxyURL));
-            worker->m_Request = 0;
-            worker->m_Status = 0;
             worker->m_Service = service;
-            worker->m_CacheFlusher = i == 0 && worker->m_Service->m_HttpCache != 0;
-            worker->m_Run = true;
-            worker->m_Canceled = 0;
-            worker->m_ReportProgress = false;
+            worker->m_Buffer = (char*) malloc(RECEIVE_BUFFER_SIZE);
+            worker->m_Thread = dmThread::New(&ConnectThread, THREAD_STACK_SIZE, worker, "http_connect");
             service->m_Workers.Push(worker);
-
-            dmThread::Thread t = dmThread::New(&Loop, THREAD_STACK_SIZE, worker, "http");
-            worker->m_Thread = t;
         }
 
-        dmThread::Thread t = dmThread::New(&LoadBalancer, THREAD_STACK_SIZE, service, "http_balance");
-        service->m_Balancer = t;
-
-        service->m_ReportProgressCallback = params->m_ReportProgressCallback;
+        service->m_Thread = dmThread::New(&Loop, THREAD_STACK_SIZE, service, "http");
 
         return service;
     }
@@ -535,45 +1866,49 @@ namespace dmHttpService
     void Delete(HHttpService http_service)
     {
         dmMessage::URL url;
+        dmMessage::ResetURL(&url);
         url.m_Socket = http_service->m_Socket;
-        dmMessage::Post(0, &url, 0, 0, (uintptr_t) dmHttpDDF::StopHttp::m_DDFDescriptor, 0, 0, 0);
+        dmMessage::Post(0, &url, 0, 0, 0, (uintptr_t) dmHttpDDF::StopHttp::m_DDFDescriptor, 0, 0, 0);
 
-        // Stop the balancer first, so we don't accept any new requests
-        dmThread::Join(http_service->m_Balancer);
+        // Stop the event loop first, so we don't accept any new requests
+        dmThread::Join(http_service->m_Thread);
 
-        // Cancel them all first, as opposed to one-by-one
-        for (uint32_t i = 0; i < http_service->m_Workers.Size(); ++i)
+        // Interrupt the name lookups, connects and handshakes in progress
+        http_service->m_Cancel = 1;
+        dmConnectionPool::Shutdown(http_service->m_Pool, dmSocket::SHUTDOWNTYPE_READWRITE);
         {
-            dmHttpService::Worker* worker = http_service->m_Workers[i];
-
-            url.m_Socket = worker->m_Socket;
-            dmMessage::Post(0, &url, 0, 0, (uintptr_t) dmHttpDDF::StopHttp::m_DDFDescriptor, 0, 0, 0);
-
-            worker->m_Canceled = 1;
+            DM_MUTEX_SCOPED_LOCK(http_service->m_ConnectMutex);
+            http_service->m_ConnectRun = false;
+            dmConditionVariable::Broadcast(http_service->m_ConnectCondition);
         }
 
         for (uint32_t i = 0; i < http_service->m_Workers.Size(); ++i)
         {
-            dmHttpService::Worker* worker = http_service->m_Workers[i];
-
-            // DNS lookups using dmSocket::GetHostByName are using getaddrinfo which may block for an undefined
-            // amount of time. We do not wish to wait for the thread during shutdown
-            // We now use detach() on the thread on creation so that we don't have to wait for the thread
-            if (worker->m_Thread)
-            {
-                dmThread::Join(worker->m_Thread);
-            }
+            Worker* worker = http_service->m_Workers[i];
+            dmThread::Join(worker->m_Thread);
+            free(worker->m_Buffer);
+            delete worker;
+        }
 
-            dmMessage::DeleteSocket(worker->m_Socket);
-            if (worker->m_Client)
+        // Requests that never reached a connect thread
+        for (uint32_t i = 0; i < http_service->m_ConnectQueue.Size(); ++i)
+        {
+            Request* request = http_service->m_ConnectQueue[i];
+            if (request->m_Connection.m_Handle)
             {
-                dmHttpClient::Delete(worker->m_Client);
+                CloseConnection(http_service, &request->m_Connection);
             }
-            delete worker;
+            DeleteRequest(request);
         }
+        dmMessage::Dispatch(http_service->m_Socket, &DispatchRemaining, http_service);
 
         dmMessage::DeleteSocket(http_service->m_Socket);
+        dmConditionVariable::Delete(http_service->m_ConnectCondition);
+        dmMutex::Delete(http_service->m_ConnectMutex);
+        dmConnectionPool::Delete(http_service->m_Pool);
+        free(http_service->m_Buffer);
         delete http_service;
+        g_ReleaseResponseBufferCallback = 0;
     }
 
 }
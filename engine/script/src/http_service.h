@@ -23,17 +23,26 @@ namespace dmHttpService
     typedef struct HttpService* HHttpService;
 
     typedef void (*ReportProgressCallback)(dmHttpDDF::HttpRequestProgress* msg, dmMessage::URL* url, uintptr_t user_data);
+    // Called when a response holding a response buffer isn't decoded by the requester (e.g. it was deleted), with the
+    // response_buffer_ref and user data 1 of the request. May be called from any thread
+    typedef void (*ReleaseResponseBufferCallback)(int32_t response_buffer_ref, uintptr_t user_data);
 
     struct Params
     {
     	Params()
         : m_HttpCache(0)
         , m_ReportProgressCallback(0)
+        , m_ReleaseResponseBufferCallback(0)
+        , m_MaxConnections(32)
         , m_ThreadCount(4)
     	{}
 
         dmHttpCache::HCache    m_HttpCache;
         ReportProgressCallback m_ReportProgressCallback;
+        ReleaseResponseBufferCallback m_ReleaseResponseBufferCallback;
+        // Max number of open connections, including idle keep-alive connections
+        uint32_t               m_MaxConnections;
+        // Number of threads doing name lookups, connects and handshakes
     	uint32_t               m_ThreadCount  : 4;
     };
 
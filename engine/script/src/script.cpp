@@ -19,6 +19,7 @@
 #include <dlib/math.h>
 #include <dlib/pprint.h>
 #include <dlib/profile.h>
+#include <dlib/time.h>
 
 #include "script_private.h"
 #include "script_hash.h"
@@ -33,6 +34,7 @@
 #include "script_luasocket.h"
 #include "script_bitop.h"
 #include "script_timer.h"
+#include "script_allocator.h"
 
 extern "C"
 {
@@ -66,6 +68,12 @@ extern "C" int dm_luaL_error_asan(lua_State* L, const char* fmt, ...)
 #endif
 
 DM_PROPERTY_GROUP(rmtp_Script, "", 0);
+DM_PROPERTY_U32(rmtp_LuaAllocatorMem, 0, PROFILE_PROPERTY_FRAME_RESET, "kb", &rmtp_Script);
+DM_PROPERTY_U32(rmtp_LuaAllocatorReserved, 0, PROFILE_PROPERTY_FRAME_RESET, "kb", &rmtp_Script);
+DM_PROPERTY_U32(rmtp_LuaAllocs, 0, PROFILE_PROPERTY_FRAME_RESET, "# Lua allocations this frame", &rmtp_Script);
+DM_PROPERTY_U32(rmtp_LuaVmathValues, 0, PROFILE_PROPERTY_FRAME_RESET, "# vmath values created this frame", &rmtp_Script);
+DM_PROPERTY_U32(rmtp_LuaGCTime, 0, PROFILE_PROPERTY_FRAME_RESET, "us", &rmtp_Script);
+DM_PROPERTY_U32(rmtp_LuaGCSteps, 0, PROFILE_PROPERTY_FRAME_RESET, "# incremental GC steps this frame", &rmtp_Script);
 
 namespace dmScript
 {
@@ -96,6 +104,15 @@ namespace dmScript
     const char SCRIPT_METATABLE_TYPE_HASH_KEY_NAME[] = "__dmengine_type";
     static const uint32_t SCRIPT_METATABLE_TYPE_HASH_KEY = dmHashBufferNoReverse32(SCRIPT_METATABLE_TYPE_HASH_KEY_NAME, sizeof(SCRIPT_METATABLE_TYPE_HASH_KEY_NAME) - 1);
 
+    // Step sizes (in kb) passed to lua_gc(LUA_GCSTEP) when the collector is stepped manually
+    static const uint32_t GC_MIN_STEP_SIZE_KB = 1;
+    static const uint32_t GC_MAX_STEP_SIZE_KB = 1024;
+    // Same as the default Lua gc pause (LUAI_GCPAUSE): wait for the heap to double before starting a new cycle
+    static const uint32_t GC_PAUSE_FACTOR = 2;
+    // The heap growth (relative to the pause threshold) at which the collector can't keep up with the allocations
+    // within the budget, and a full collection is done instead
+    static const uint32_t GC_FULL_COLLECT_FACTOR = 4;
+
     // A debug value for profiling lua references
     int g_LuaReferenceCount = 0;
     const uint32_t INVALID_SCRIPT_ID = 0xFFFFFFFF;
@@ -110,12 +127,30 @@ namespace dmScript
         context->m_ConfigFile = params.m_ConfigFile;
         context->m_ResourceFactory = params.m_Factory;
         context->m_GraphicsContext = params.m_GraphicsContext;
-        context->m_LuaState = lua_open();
+        context->m_Allocator = 0;
+        context->m_LastAllocCount = 0;
+        context->m_LuaState = 0;
+        if (params.m_UseCustomAllocator)
+        {
+            context->m_Allocator = NewLuaAllocator(params.m_MemoryBudget);
+            context->m_LuaState = lua_newstate(LuaAllocatorAlloc, context->m_Allocator);
+            if (context->m_LuaState == 0)
+            {
+                // E.g. LuaJIT on 64 bit targets without GC64 doesn't support custom allocators
+                dmLogWarning("Failed to create Lua state with custom allocator, using the default allocator.");
+                DeleteLuaAllocator(context->m_Allocator);
+                context->m_Allocator = 0;
+            }
+        }
+        if (context->m_LuaState == 0)
+        {
+            context->m_LuaState = lua_open();
+        }
 #if defined(DM_SANITIZE_THREAD) && defined(__linux__) && !defined(ANDROID) && defined(__aarch64__)
         // Linux arm64 TSan reserves large shadow-memory ranges. This can make
         // LuaJIT's mmap probe fail to reserve a valid Lua state range, so retry
         // state creation before treating it as a real allocation failure.
-        for (int i = 0; context->m_LuaState == 0 && i < 16; ++i)
+        for (int i = 0; context->m_LuaState == 0 && context->m_Allocator == 0 && i < 16; ++i)
         {
             context->m_LuaState = lua_open();
         }
@@ -127,6 +162,10 @@ namespace dmScript
         }
         context->m_ContextTableRef = LUA_NOREF;
         context->m_ContextWeakTableRef = LUA_NOREF;
+        context->m_GCStepSizeKb = GC_MIN_STEP_SIZE_KB;
+        context->m_GCPauseHeapKb = 0;
+        context->m_ManualGC = 0;
+        context->m_GCCycleFinished = 0;
         return context;
     }
 
@@ -134,6 +173,10 @@ namespace dmScript
     {
         ClearModules(context);
         lua_close(context->m_LuaState);
+        if (context->m_Allocator)
+        {
+            DeleteLuaAllocator(context->m_Allocator);
+        }
         delete context;
     }
 
@@ -290,6 +333,24 @@ namespace dmScript
         context->m_ScriptExtensions.Push(script_extension);
     }
 
+    static void UpdateMemoryStats(HContext context)
+    {
+        // The vmath value counter is shared by all contexts
+        DM_PROPERTY_ADD_U32(rmtp_LuaVmathValues, ResetVmathValueCount());
+
+        if (!context->m_Allocator)
+        {
+            return;
+        }
+
+        MemoryStats stats;
+        GetLuaAllocatorStats(context->m_Allocator, &stats);
+        DM_PROPERTY_ADD_U32(rmtp_LuaAllocatorMem, (uint32_t)(stats.m_Allocated / 1024));
+        DM_PROPERTY_ADD_U32(rmtp_LuaAllocatorReserved, (uint32_t)(stats.m_Reserved / 1024));
+        DM_PROPERTY_ADD_U32(rmtp_LuaAllocs, stats.m_AllocCount - context->m_LastAllocCount);
+        context->m_LastAllocCount = stats.m_AllocCount;
+    }
+
     void Update(HContext context)
     {
         for (HScriptExtension* l = context->m_ScriptExtensions.Begin(); l != context->m_ScriptExtensions.End(); ++l)
@@ -299,6 +360,8 @@ namespace dmScript
                 (*l)->Update(context);
             }
         }
+
+        UpdateMemoryStats(context);
     }
 
     void Finalize(HContext context)
@@ -1610,6 +1673,103 @@ namespace dmScript
         return (uint32_t)lua_gc(L, LUA_GCCOUNT, 0);
     }
 
+    void SetManualGC(HContext context, bool manual)
+    {
+        lua_State* L = context->m_LuaState;
+        context->m_ManualGC = manual;
+        context->m_GCCycleFinished = 0;
+        context->m_GCPauseHeapKb = (uint32_t)lua_gc(L, LUA_GCCOUNT, 0);
+        lua_gc(L, manual ? LUA_GCSTOP : LUA_GCRESTART, 0);
+    }
+
+    uint64_t StepGC(HContext context, uint64_t budget_us)
+    {
+        if (!context->m_ManualGC)
+        {
+            return 0;
+        }
+
+        DM_PROFILE("LuaGC");
+        lua_State* L = context->m_LuaState;
+
+        uint32_t heap_kb = (uint32_t)lua_gc(L, LUA_GCCOUNT, 0);
+        uint32_t threshold_kb = dmMath::Max(context->m_GCPauseHeapKb, 1u) * GC_PAUSE_FACTOR;
+        if (context->m_GCCycleFinished)
+        {
+            if (heap_kb < threshold_kb)
+            {
+                return 0;
+            }
+            context->m_GCCycleFinished = 0;
+        }
+
+        uint64_t start = dmTime::GetMonotonicTime();
+        uint64_t now = start;
+        uint32_t steps = 0;
+
+        if (heap_kb >= threshold_kb * GC_FULL_COLLECT_FACTOR)
+        {
+            // The heap would otherwise grow without bounds
+            lua_gc(L, LUA_GCCOLLECT, 0);
+            now = dmTime::GetMonotonicTime();
+            ++steps;
+            context->m_GCCycleFinished = 1;
+            context->m_GCPauseHeapKb = (uint32_t)lua_gc(L, LUA_GCCOUNT, 0);
+            budget_us = 0;
+        }
+        else if (heap_kb > threshold_kb)
+        {
+            // The allocations outpace the collection cycle, so the budget is scaled with the growth beyond the threshold
+            budget_us = budget_us * heap_kb / threshold_kb;
+        }
+
+        while (now - start < budget_us)
+        {
+            int finished = lua_gc(L, LUA_GCSTEP, context->m_GCStepSizeKb);
+            uint64_t step_end = dmTime::GetMonotonicTime();
+            uint64_t step_time = step_end - now;
+            now = step_end;
+            ++steps;
+
+            // Aim for steps taking between 1/8 and 1/2 of the budget to keep the timing overhead
+            // low while still being able to stop close to the budget
+            if (step_time * 8 < budget_us && context->m_GCStepSizeKb < GC_MAX_STEP_SIZE_KB)
+            {
+                context->m_GCStepSizeKb *= 2;
+            }
+            else if (step_time * 2 > budget_us && context->m_GCStepSizeKb > GC_MIN_STEP_SIZE_KB)
+            {
+                context->m_GCStepSizeKb /= 2;
+            }
+
+            if (finished)
+            {
+                context->m_GCCycleFinished = 1;
+                context->m_GCPauseHeapKb = (uint32_t)lua_gc(L, LUA_GCCOUNT, 0);
+                break;
+            }
+        }
+
+        // Stepping the collector re-arms the automatic collection threshold
+        lua_gc(L, LUA_GCSTOP, 0);
+
+        uint64_t elapsed = now - start;
+        DM_PROPERTY_ADD_U32(rmtp_LuaGCTime, (uint32_t)elapsed);
+        DM_PROPERTY_ADD_U32(rmtp_LuaGCSteps, steps);
+        return elapsed;
+    }
+
+    bool GetMemoryStats(HContext context, MemoryStats* stats)
+    {
+        if (!context->m_Allocator)
+        {
+            memset(stats, 0, sizeof(*stats));
+            return false;
+        }
+        GetLuaAllocatorStats(context->m_Allocator, stats);
+        return true;
+    }
+
     LuaStackCheck::LuaStackCheck(lua_State* L, int diff, const char* filename, int linenumber) : m_L(L), m_Filename(filename), m_Linenumber(linenumber), m_Top(lua_gettop(L)), m_Diff(diff)
     {
         if (!(m_Diff >= -m_Top)) {
@@ -2092,6 +2252,18 @@ namespace dmScript
         return false;
     }
 
+    static bool g_ProfileInstanceScopes = false;
+
+    void SetProfileInstanceScopes(bool enable)
+    {
+        g_ProfileInstanceScopes = enable;
+    }
+
+    bool GetProfileInstanceScopes()
+    {
+        return g_ProfileInstanceScopes;
+    }
+
     // Fast length limited string concatenation that assume we already point to
     // the end of the string. Returns the new end of the string so we do not need
     // to calculate the length of the input string or output string
@@ -2161,6 +2333,28 @@ namespace dmScript
         }
         w_ptr = ConcatString(w_ptr, w_ptr_end, "@");
         w_ptr = ConcatString(w_ptr, w_ptr_end, function_source);
+
+        if (g_ProfileInstanceScopes)
+        {
+            // Record the time per instance, e.g. "update@main/player.script:/hero"
+            dmMessage::URL url;
+            dmMessage::ResetURL(&url);
+            if (GetURL(L, &url) && url.m_Path != 0)
+            {
+                w_ptr = ConcatString(w_ptr, w_ptr_end, ":");
+                const char* path = (const char*)dmHashReverse64(url.m_Path, 0);
+                if (path)
+                {
+                    w_ptr = ConcatString(w_ptr, w_ptr_end, path);
+                }
+                else
+                {
+                    char path_hash_buffer[24];
+                    dmSnPrintf(path_hash_buffer, sizeof(path_hash_buffer), "%016llx", (unsigned long long)url.m_Path);
+                    w_ptr = ConcatString(w_ptr, w_ptr_end, path_hash_buffer);
+                }
+            }
+        }
         *w_ptr++ = 0;
 
         return buffer;
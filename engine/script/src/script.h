@@ -88,6 +88,23 @@ namespace dmScript
         dmConfigFile::HConfig m_ConfigFile;
         dmResource::HFactory  m_Factory;
         dmGraphics::HContext  m_GraphicsContext;
+        uint64_t              m_MemoryBudget;           // Max number of bytes the Lua state may allocate (0 = unlimited). Requires m_UseCustomAllocator
+        uint8_t               m_UseCustomAllocator : 1; // Use the size class pooled allocator instead of the default Lua allocator
+    };
+
+    /**
+     * Memory statistics for a script context.
+     * Only available when the context was created with ContextParams::m_UseCustomAllocator
+     */
+    struct MemoryStats
+    {
+        uint64_t m_Allocated;           // Bytes currently allocated by the Lua state
+        uint64_t m_PeakAllocated;       // Max value of m_Allocated since the context was created
+        uint64_t m_Reserved;            // Bytes reserved by the allocator (pool pages and large allocations)
+        uint64_t m_Budget;              // The memory budget (0 = unlimited)
+        uint32_t m_AllocCount;          // Total number of allocations
+        uint32_t m_PooledAllocCount;    // Total number of allocations served from the size class pools
+        uint32_t m_FailedAllocCount;    // Total number of allocations rejected due to the memory budget
     };
 
     /**
@@ -661,6 +678,31 @@ namespace dmScript
     */
     uint32_t GetLuaGCCount(lua_State* L);
 
+    /** Gets the memory statistics of the custom Lua allocator
+    * @param context script context
+    * @param stats [out] the memory statistics
+    * @return true if the context uses the custom allocator
+    */
+    bool GetMemoryStats(HContext context, MemoryStats* stats);
+
+    /** Stops the automatic Lua garbage collector of the context.
+    * The collector must instead be stepped each frame with StepGC()
+    * @param context script context
+    * @param manual true to step the collector manually, false to restore automatic collection
+    */
+    void SetManualGC(HContext context, bool manual);
+
+    /** Performs incremental garbage collection steps until the time budget is exhausted.
+    * Once a collection cycle finishes, no new cycle is started until the heap has doubled.
+    * The time spent stays within the budget, give or take the last step, as long as the collector keeps up with the
+    * allocations. Beyond the doubled heap, the budget is scaled with the heap size, and a full collection is done
+    * once the heap has grown four times past it.
+    * @param context script context, with manual garbage collection enabled
+    * @param budget_us the time budget in microseconds
+    * @return the time spent in microseconds
+    */
+    uint64_t StepGC(HContext context, uint64_t budget_us);
+
 // DEPRECATED
 // I really don't like this callback setup (mistake on my part). It's clunky.
 // Perhaps better to have a lambda function? (now that all compilers support C++11) /MAWE
@@ -710,6 +752,20 @@ namespace dmScript
      */
     const char* GetProfilerString(lua_State* L, int optional_callback_index, const char* source_file_name, const char* function_name, const char* optional_message_name, char* buffer, uint32_t buffer_size);
 
+    /**
+     * Enable or disable per instance profiler scopes. When enabled, GetProfilerString() appends the
+     * path of the current script instance, so that the time of each script callback is recorded
+     * per instance rather than per script resource.
+     * @param enable true to enable per instance profiler scopes
+     */
+    void SetProfileInstanceScopes(bool enable);
+
+    /**
+     * Check if per instance profiler scopes are enabled
+     * @return true if enabled
+     */
+    bool GetProfileInstanceScopes();
+
     /**
      * Prints the current stack (uses dmLogInfo)
      * @param L lua state
@@ -0,0 +1,284 @@
+// Copyright 2020-2026 The Defold Foundation
+// Copyright 2014-2020 King
+// Copyright 2009-2014 Ragnar Svensson, Christian Murray
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "script_allocator.h"
+#include "script.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <dlib/array.h>
+#include <dlib/memory.h>
+
+namespace dmScript
+{
+    // The pages are split into fixed size blocks, one size class per page.
+    // Freed blocks are kept in a per size class free list and are never
+    // returned to the system until the allocator is deleted.
+    static const uint32_t PAGE_SIZE          = 16 * 1024;
+    static const uint32_t BLOCK_ALIGNMENT    = 16;
+    static const uint32_t MAX_POOLED_SIZE    = 256;
+    static const uint32_t SIZE_CLASS_COUNT   = 8;
+
+    static const uint32_t SIZE_CLASSES[SIZE_CLASS_COUNT] = { 16, 32, 48, 64, 96, 128, 192, 256 };
+
+    // Maps (size - 1) / 16 to a size class index
+    static const uint8_t SIZE_TO_CLASS[MAX_POOLED_SIZE / BLOCK_ALIGNMENT] = { 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7 };
+
+    struct FreeBlock
+    {
+        FreeBlock* m_Next;
+    };
+
+    struct SizeClassPool
+    {
+        FreeBlock* m_FreeList;
+        uint8_t*   m_Cursor;    // Next unused block in the current page
+        uint8_t*   m_End;       // End of the current page
+    };
+
+    struct ShrunkBlock
+    {
+        void*    m_Ptr;
+        uint32_t m_Size;
+    };
+
+    struct LuaAllocator
+    {
+        SizeClassPool   m_Pools[SIZE_CLASS_COUNT];
+        dmArray<void*>  m_Pages;
+        // Large blocks that were shrunk to a pooled size when no pool block could be allocated.
+        // They are still malloc'ed.
+        dmArray<ShrunkBlock> m_ShrunkBlocks;
+        uint64_t        m_Budget;
+        uint64_t        m_Allocated;
+        uint64_t        m_PeakAllocated;
+        uint64_t        m_LargeAllocated;
+        uint32_t        m_AllocCount;
+        uint32_t        m_PooledAllocCount;
+        uint32_t        m_FailedAllocCount;
+    };
+
+    static inline uint32_t GetSizeClass(size_t size)
+    {
+        return SIZE_TO_CLASS[(size - 1) / BLOCK_ALIGNMENT];
+    }
+
+    static void* PoolAlloc(LuaAllocator* allocator, uint32_t size_class)
+    {
+        SizeClassPool* pool = &allocator->m_Pools[size_class];
+        if (pool->m_FreeList)
+        {
+            FreeBlock* block = pool->m_FreeList;
+            pool->m_FreeList = block->m_Next;
+            return block;
+        }
+
+        uint32_t block_size = SIZE_CLASSES[size_class];
+        if (pool->m_Cursor + block_size > pool->m_End)
+        {
+            void* page = 0;
+            if (dmMemory::RESULT_OK != dmMemory::AlignedMalloc(&page, BLOCK_ALIGNMENT, PAGE_SIZE))
+            {
+                return 0;
+            }
+            if (allocator->m_Pages.Full())
+            {
+                allocator->m_Pages.OffsetCapacity(32);
+            }
+            allocator->m_Pages.Push(page);
+            pool->m_Cursor = (uint8_t*)page;
+            pool->m_End = pool->m_Cursor + PAGE_SIZE;
+        }
+
+        void* block = pool->m_Cursor;
+        pool->m_Cursor += block_size;
+        return block;
+    }
+
+    static void PoolFree(LuaAllocator* allocator, void* ptr, uint32_t size_class)
+    {
+        FreeBlock* block = (FreeBlock*)ptr;
+        block->m_Next = allocator->m_Pools[size_class].m_FreeList;
+        allocator->m_Pools[size_class].m_FreeList = block;
+    }
+
+    static void* Allocate(LuaAllocator* allocator, size_t size)
+    {
+        ++allocator->m_AllocCount;
+        if (size <= MAX_POOLED_SIZE)
+        {
+            ++allocator->m_PooledAllocCount;
+            return PoolAlloc(allocator, GetSizeClass(size));
+        }
+        allocator->m_LargeAllocated += size;
+        return malloc(size);
+    }
+
+    // Returns the malloc'ed size of the block, or 0 if it is a pool block
+    static uint32_t RemoveShrunkBlock(LuaAllocator* allocator, void* ptr)
+    {
+        dmArray<ShrunkBlock>& blocks = allocator->m_ShrunkBlocks;
+        for (uint32_t i = 0; i < blocks.Size(); ++i)
+        {
+            if (blocks[i].m_Ptr == ptr)
+            {
+                uint32_t size = blocks[i].m_Size;
+                blocks.EraseSwap(i);
+                return size;
+            }
+        }
+        return 0;
+    }
+
+    static void Free(LuaAllocator* allocator, void* ptr, size_t size)
+    {
+        if (size <= MAX_POOLED_SIZE)
+        {
+            uint32_t shrunk_size = RemoveShrunkBlock(allocator, ptr);
+            if (shrunk_size == 0)
+            {
+                PoolFree(allocator, ptr, GetSizeClass(size));
+                return;
+            }
+            size = shrunk_size;
+        }
+        allocator->m_LargeAllocated -= size;
+        free(ptr);
+    }
+
+    // Follows the lua_Alloc contract: osize is the size of the block pointed to by ptr,
+    // nsize == 0 frees the block, and shrinking a block must never fail.
+    void* LuaAllocatorAlloc(void* ud, void* ptr, size_t osize, size_t nsize)
+    {
+        LuaAllocator* allocator = (LuaAllocator*)ud;
+        if (ptr == 0)
+        {
+            osize = 0;
+        }
+
+        if (nsize > osize && allocator->m_Budget != 0 && allocator->m_Allocated + (nsize - osize) > allocator->m_Budget)
+        {
+            ++allocator->m_FailedAllocCount;
+            return 0;
+        }
+
+        void* result = 0;
+        if (nsize == 0)
+        {
+            if (ptr)
+            {
+                Free(allocator, ptr, osize);
+            }
+        }
+        else if (ptr == 0)
+        {
+            result = Allocate(allocator, nsize);
+        }
+        else if (osize <= MAX_POOLED_SIZE && nsize <= MAX_POOLED_SIZE && GetSizeClass(osize) == GetSizeClass(nsize))
+        {
+            // Still fits the same block
+            result = ptr;
+        }
+        else if (osize > MAX_POOLED_SIZE && nsize > MAX_POOLED_SIZE)
+        {
+            result = realloc(ptr, nsize);
+            if (result)
+            {
+                allocator->m_LargeAllocated = allocator->m_LargeAllocated - osize + nsize;
+            }
+        }
+        else
+        {
+            result = Allocate(allocator, nsize);
+            if (result)
+            {
+                memcpy(result, ptr, osize < nsize ? osize : nsize);
+                Free(allocator, ptr, osize);
+            }
+            else if (osize > MAX_POOLED_SIZE && nsize <= MAX_POOLED_SIZE)
+            {
+                // Out of pool pages. Shrink the large block in place instead, to the size of the
+                // size class so that it can still grow within the class, and keep it tracked as large.
+                uint32_t block_size = SIZE_CLASSES[GetSizeClass(nsize)];
+                result = realloc(ptr, block_size);
+                if (result == 0)
+                {
+                    // The old block is larger, and still valid
+                    result = ptr;
+                    block_size = osize;
+                }
+                if (allocator->m_ShrunkBlocks.Full())
+                {
+                    allocator->m_ShrunkBlocks.OffsetCapacity(16);
+                }
+                ShrunkBlock block = { result, block_size };
+                allocator->m_ShrunkBlocks.Push(block);
+                allocator->m_LargeAllocated = allocator->m_LargeAllocated - osize + block_size;
+            }
+        }
+
+        if (result == 0 && nsize != 0)
+        {
+            if (nsize <= osize)
+            {
+                // Shrinking must not fail, keep the old (larger) block
+                return ptr;
+            }
+            return 0;
+        }
+
+        allocator->m_Allocated = allocator->m_Allocated - osize + nsize;
+        if (allocator->m_Allocated > allocator->m_PeakAllocated)
+        {
+            allocator->m_PeakAllocated = allocator->m_Allocated;
+        }
+        return result;
+    }
+
+    HLuaAllocator NewLuaAllocator(uint64_t budget)
+    {
+        LuaAllocator* allocator = new LuaAllocator;
+        memset(allocator->m_Pools, 0, sizeof(allocator->m_Pools));
+        allocator->m_Pages.SetCapacity(32);
+        allocator->m_Budget = budget;
+        allocator->m_Allocated = 0;
+        allocator->m_PeakAllocated = 0;
+        allocator->m_LargeAllocated = 0;
+        allocator->m_AllocCount = 0;
+        allocator->m_PooledAllocCount = 0;
+        allocator->m_FailedAllocCount = 0;
+        return allocator;
+    }
+
+    void DeleteLuaAllocator(HLuaAllocator allocator)
+    {
+        for (uint32_t i = 0; i < allocator->m_Pages.Size(); ++i)
+        {
+            dmMemory::AlignedFree(allocator->m_Pages[i]);
+        }
+        delete allocator;
+    }
+
+    void GetLuaAllocatorStats(HLuaAllocator allocator, MemoryStats* stats)
+    {
+        stats->m_Allocated          = allocator->m_Allocated;
+        stats->m_PeakAllocated      = allocator->m_PeakAllocated;
+        stats->m_Reserved           = (uint64_t)allocator->m_Pages.Size() * PAGE_SIZE + allocator->m_LargeAllocated;
+        stats->m_Budget             = allocator->m_Budget;
+        stats->m_AllocCount         = allocator->m_AllocCount;
+        stats->m_PooledAllocCount   = allocator->m_PooledAllocCount;
+        stats->m_FailedAllocCount   = allocator->m_FailedAllocCount;
+    }
+}
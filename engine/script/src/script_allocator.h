@@ -0,0 +1,55 @@
+// Copyright 2020-2026 The Defold Foundation
+// Copyright 2014-2020 King
+// Copyright 2009-2014 Ragnar Svensson, Christian Murray
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef DM_SCRIPT_ALLOCATOR_H
+#define DM_SCRIPT_ALLOCATOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace dmScript
+{
+    struct MemoryStats;
+
+    typedef struct LuaAllocator* HLuaAllocator;
+
+    /**
+     * Create a Lua allocator. Small allocations (<= 256 bytes) are served from
+     * size class pools, larger allocations go directly to the system allocator.
+     * @param budget max number of bytes allocated at any time (0 = unlimited)
+     * @return the allocator
+     */
+    HLuaAllocator NewLuaAllocator(uint64_t budget);
+
+    /**
+     * Delete the allocator and release all pool memory.
+     * The Lua state using the allocator must be closed before this call.
+     * @param allocator the allocator
+     */
+    void DeleteLuaAllocator(HLuaAllocator allocator);
+
+    /**
+     * The lua_Alloc compatible allocation function. Pass the allocator as user data.
+     */
+    void* LuaAllocatorAlloc(void* ud, void* ptr, size_t osize, size_t nsize);
+
+    /**
+     * Get the current statistics of the allocator
+     * @param allocator the allocator
+     * @param stats [out] the statistics
+     */
+    void GetLuaAllocatorStats(HLuaAllocator allocator, MemoryStats* stats);
+}
+
+#endif // DM_SCRIPT_ALLOCATOR_H
@@ -66,6 +66,7 @@ namespace dmScript
     };
 
     typedef struct ScriptExtension* HScriptExtension;
+    typedef struct LuaAllocator* HLuaAllocator;
 
     struct Context
     {
@@ -77,6 +78,12 @@ namespace dmScript
         dmHashTable64<int>          m_HashInstances;
         dmArray<HScriptExtension>   m_ScriptExtensions;
         lua_State*                  m_LuaState;
+        HLuaAllocator               m_Allocator;
+        uint32_t                    m_LastAllocCount;
+        uint32_t                    m_GCStepSizeKb;      // Adapted so that each step takes a fraction of the frame budget
+        uint32_t                    m_GCPauseHeapKb;     // Heap size when the last GC cycle finished
+        uint8_t                     m_ManualGC : 1;
+        uint8_t                     m_GCCycleFinished : 1;
         int                         m_ContextTableRef;
         int                         m_ContextWeakTableRef;
     };
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "script.h"
+#include "script_vmath.h"
 
 #include <dmsdk/dlib/vmath.h>
 #include <assert.h>
@@ -99,6 +100,9 @@ namespace dmScript
 
     uint32_t TYPE_HASHES[SCRIPT_TYPE_UNKNOWN];
 
+    // Number of vmath userdata values created since the last ResetVmathValueCount()
+    static uint32_t g_VmathValueCount = 0;
+
     static inline bool CheckVector3Components(Vector3* v)
     {
         return !isnan(v->getX()) && !isnan(v->getY()) && !isnan(v->getZ());
@@ -2704,6 +2708,247 @@ namespace dmScript
         return 1;
     }
 
+    /*# adds two vectors into an existing vector
+     *
+     * Adds `v1` and `v2` and stores the result in `out`, instead of creating a new vector.
+     * `out` may be one of the operands.
+     *
+     * @name vmath.add_to
+     * @param out [type:vector3|vector4] the vector to store the result in
+     * @param v1 [type:vector3|vector4] first vector
+     * @param v2 [type:vector3|vector4] second vector
+     * @return out [type:vector3|vector4] the `out` vector
+     * @examples
+     *
+     * ```lua
+     * function update(self, dt)
+     *     vmath.mul_to(self.step, self.velocity, dt)
+     *     vmath.add_to(self.position, self.position, self.step)
+     *     go.set_position(self.position)
+     * end
+     * ```
+     */
+    static int AddTo(lua_State* L)
+    {
+        void* out = 0;
+        void* argument1 = 0;
+        void* argument2 = 0;
+        const ScriptUserType type = CheckUserData(L, 1, &out);
+        const ScriptUserType type1 = CheckUserData(L, 2, &argument1);
+        const ScriptUserType type2 = CheckUserData(L, 3, &argument2);
+        if (type == type1 && type == type2 && type == SCRIPT_TYPE_VECTOR3)
+        {
+            *(Vector3*)out = *(Vector3*)argument1 + *(Vector3*)argument2;
+        }
+        else if (type == type1 && type == type2 && type == SCRIPT_TYPE_VECTOR4)
+        {
+            *(Vector4*)out = *(Vector4*)argument1 + *(Vector4*)argument2;
+        }
+        else
+        {
+            return luaL_error(L, "%s.%s accepts three %s.%ss or three %s.%ss as arguments.", SCRIPT_LIB_NAME, "add_to", SCRIPT_LIB_NAME, SCRIPT_TYPE_NAME_VECTOR3, SCRIPT_LIB_NAME, SCRIPT_TYPE_NAME_VECTOR4);
+        }
+        lua_settop(L, 1);
+        return 1;
+    }
+
+    /*# subtracts two vectors into an existing vector
+     *
+     * Subtracts `v2` from `v1` and stores the result in `out`, instead of creating a new vector.
+     * `out` may be one of the operands.
+     *
+     * @name vmath.sub_to
+     * @param out [type:vector3|vector4] the vector to store the result in
+     * @param v1 [type:vector3|vector4] first vector
+     * @param v2 [type:vector3|vector4] second vector
+     * @return out [type:vector3|vector4] the `out` vector
+     * @examples
+     *
+     * ```lua
+     * vmath.sub_to(self.direction, target_position, self.position)
+     * ```
+     */
+    static int SubTo(lua_State* L)
+    {
+        void* out = 0;
+        void* argument1 = 0;
+        void* argument2 = 0;
+        const ScriptUserType type = CheckUserData(L, 1, &out);
+        const ScriptUserType type1 = CheckUserData(L, 2, &argument1);
+        const ScriptUserType type2 = CheckUserData(L, 3, &argument2);
+        if (type == type1 && type == type2 && type == SCRIPT_TYPE_VECTOR3)
+        {
+            *(Vector3*)out = *(Vector3*)argument1 - *(Vector3*)argument2;
+        }
+        else if (type == type1 && type == type2 && type == SCRIPT_TYPE_VECTOR4)
+        {
+            *(Vector4*)out = *(Vector4*)argument1 - *(Vector4*)argument2;
+        }
+        else
+        {
+            return luaL_error(L, "%s.%s accepts three %s.%ss or three %s.%ss as arguments.", SCRIPT_LIB_NAME, "sub_to", SCRIPT_LIB_NAME, SCRIPT_TYPE_NAME_VECTOR3, SCRIPT_LIB_NAME, SCRIPT_TYPE_NAME_VECTOR4);
+        }
+        lua_settop(L, 1);
+        return 1;
+    }
+
+    /*# multiplies into an existing value
+     *
+     * Multiplies `a` and `b` and stores the result in `out`, instead of creating a new value.
+     * `out` may be one of the operands. The supported combinations are:
+     *
+     * - `vector3` = `vector3` * `number`
+     * - `vector4` = `vector4` * `number`
+     * - `quat` = `quat` * `quat`
+     * - `matrix4` = `matrix4` * `matrix4`
+     * - `vector4` = `matrix4` * `vector4`
+     *
+     * @name vmath.mul_to
+     * @param out [type:vector3|vector4|quaternion|matrix4] the value to store the result in
+     * @param a [type:vector3|vector4|quaternion|matrix4] first operand
+     * @param b [type:number|vector4|quaternion|matrix4] second operand
+     * @return out [type:vector3|vector4|quaternion|matrix4] the `out` value
+     * @examples
+     *
+     * ```lua
+     * vmath.mul_to(self.rotation, self.rotation, self.spin)
+     * ```
+     */
+    static int MulTo(lua_State* L)
+    {
+        void* out = 0;
+        void* argument1 = 0;
+        const ScriptUserType type = CheckUserData(L, 1, &out);
+        const ScriptUserType type1 = CheckUserData(L, 2, &argument1);
+        if (lua_type(L, 3) == LUA_TNUMBER)
+        {
+            float s = (float) lua_tonumber(L, 3);
+            if (type == type1 && type == SCRIPT_TYPE_VECTOR3)
+            {
+                *(Vector3*)out = *(Vector3*)argument1 * s;
+                lua_settop(L, 1);
+                return 1;
+            }
+            else if (type == type1 && type == SCRIPT_TYPE_VECTOR4)
+            {
+                *(Vector4*)out = *(Vector4*)argument1 * s;
+                lua_settop(L, 1);
+                return 1;
+            }
+        }
+        else
+        {
+            void* argument2 = 0;
+            const ScriptUserType type2 = CheckUserData(L, 3, &argument2);
+            if (type == SCRIPT_TYPE_QUAT && type1 == SCRIPT_TYPE_QUAT && type2 == SCRIPT_TYPE_QUAT)
+            {
+                *(Quat*)out = *(Quat*)argument1 * *(Quat*)argument2;
+                lua_settop(L, 1);
+                return 1;
+            }
+            else if (type == SCRIPT_TYPE_MATRIX4 && type1 == SCRIPT_TYPE_MATRIX4 && type2 == SCRIPT_TYPE_MATRIX4)
+            {
+                *(Matrix4*)out = *(Matrix4*)argument1 * *(Matrix4*)argument2;
+                lua_settop(L, 1);
+                return 1;
+            }
+            else if (type == SCRIPT_TYPE_VECTOR4 && type1 == SCRIPT_TYPE_MATRIX4 && type2 == SCRIPT_TYPE_VECTOR4)
+            {
+                *(Vector4*)out = *(Matrix4*)argument1 * *(Vector4*)argument2;
+                lua_settop(L, 1);
+                return 1;
+            }
+        }
+        return luaL_error(L, "%s.%s has unsupported argument types.", SCRIPT_LIB_NAME, "mul_to");
+    }
+
+    /*# lerps between two values into an existing value
+     *
+     * Linearly interpolates between `v1` and `v2` and stores the result in `out`, instead of creating a new value.
+     * `out` may be one of the operands. See [ref:vmath.lerp].
+     *
+     * @name vmath.lerp_to
+     * @param out [type:vector3|vector4|quaternion] the value to store the result in
+     * @param t [type:number] interpolation parameter, 0-1
+     * @param v1 [type:vector3|vector4|quaternion] value to lerp from
+     * @param v2 [type:vector3|vector4|quaternion] value to lerp to
+     * @return out [type:vector3|vector4|quaternion] the `out` value
+     * @examples
+     *
+     * ```lua
+     * vmath.lerp_to(self.position, 0.1, self.position, self.target)
+     * ```
+     */
+    static int LerpTo(lua_State* L)
+    {
+        void* out = 0;
+        void* argument1 = 0;
+        void* argument2 = 0;
+        const ScriptUserType type = CheckUserData(L, 1, &out);
+        float t = (float) luaL_checknumber(L, 2);
+        const ScriptUserType type1 = CheckUserData(L, 3, &argument1);
+        const ScriptUserType type2 = CheckUserData(L, 4, &argument2);
+        if (type == type1 && type == type2 && type == SCRIPT_TYPE_VECTOR3)
+        {
+            *(Vector3*)out = dmVMath::Lerp(t, *(Vector3*)argument1, *(Vector3*)argument2);
+        }
+        else if (type == type1 && type == type2 && type == SCRIPT_TYPE_VECTOR4)
+        {
+            *(Vector4*)out = dmVMath::Lerp(t, *(Vector4*)argument1, *(Vector4*)argument2);
+        }
+        else if (type == type1 && type == type2 && type == SCRIPT_TYPE_QUAT)
+        {
+            *(Quat*)out = dmVMath::Lerp(t, *(Quat*)argument1, *(Quat*)argument2);
+        }
+        else
+        {
+            return luaL_error(L, "%s.%s takes a %s.%s, %s.%s or %s.%s to store the result in and a pair of the same type to interpolate between.", SCRIPT_LIB_NAME, "lerp_to", SCRIPT_LIB_NAME, SCRIPT_TYPE_NAME_VECTOR3, SCRIPT_LIB_NAME, SCRIPT_TYPE_NAME_VECTOR4, SCRIPT_LIB_NAME, SCRIPT_TYPE_NAME_QUAT);
+        }
+        lua_settop(L, 1);
+        return 1;
+    }
+
+    /*# normalizes a vector into an existing vector
+     *
+     * Normalizes `v` and stores the result in `out`, instead of creating a new value.
+     * `out` may be the same value as `v`. See [ref:vmath.normalize].
+     *
+     * @name vmath.normalize_to
+     * @param out [type:vector3|vector4|quaternion] the value to store the result in
+     * @param v [type:vector3|vector4|quaternion] the value to normalize
+     * @return out [type:vector3|vector4|quaternion] the `out` value
+     * @examples
+     *
+     * ```lua
+     * vmath.normalize_to(self.direction, self.direction)
+     * ```
+     */
+    static int NormalizeTo(lua_State* L)
+    {
+        void* out = 0;
+        void* argument = 0;
+        const ScriptUserType type = CheckUserData(L, 1, &out);
+        const ScriptUserType type1 = CheckUserData(L, 2, &argument);
+        if (type == type1 && type == SCRIPT_TYPE_VECTOR3)
+        {
+            *(Vector3*)out = dmVMath::Normalize(*(Vector3*)argument);
+        }
+        else if (type == type1 && type == SCRIPT_TYPE_VECTOR4)
+        {
+            *(Vector4*)out = dmVMath::Normalize(*(Vector4*)argument);
+        }
+        else if (type == type1 && type == SCRIPT_TYPE_QUAT)
+        {
+            *(Quat*)out = dmVMath::Normalize(*(Quat*)argument);
+        }
+        else
+        {
+            return luaL_error(L, "%s.%s accepts two (%s|%s|%s) of the same type as arguments.", SCRIPT_LIB_NAME, "normalize_to", SCRIPT_TYPE_NAME_VECTOR3, SCRIPT_TYPE_NAME_VECTOR4, SCRIPT_TYPE_NAME_QUAT);
+        }
+        lua_settop(L, 1);
+        return 1;
+    }
+
     static const luaL_reg methods[] =
     {
         {SCRIPT_TYPE_NAME_VECTOR, Vector_new},
@@ -2747,6 +2992,11 @@ namespace dmScript
         {"clamp", Vector_Clamp},
         {"quat_to_euler", QuatToEuler},
         {"euler_to_quat", EulerToQuat},
+        {"add_to", AddTo},
+        {"sub_to", SubTo},
+        {"mul_to", MulTo},
+        {"lerp_to", LerpTo},
+        {"normalize_to", NormalizeTo},
         {0, 0}
     };
 
@@ -2779,6 +3029,13 @@ namespace dmScript
         assert(top == lua_gettop(L));
     }
 
+    uint32_t ResetVmathValueCount()
+    {
+        uint32_t count = g_VmathValueCount;
+        g_VmathValueCount = 0;
+        return count;
+    }
+
     void PushVector(lua_State* L, FloatVector* v)
     {
         FloatVector** vp = (FloatVector**)lua_newuserdata(L, sizeof(FloatVector*));
@@ -2794,6 +3051,7 @@ namespace dmScript
 
     void PushVector3(lua_State* L, const Vector3& v)
     {
+        ++g_VmathValueCount;
         Vector3* vp = (Vector3*)lua_newuserdata(L, sizeof(Vector3));
         *vp = v;
         luaL_getmetatable(L, SCRIPT_TYPE_NAME_VECTOR3);
@@ -2812,6 +3070,7 @@ namespace dmScript
 
     void PushVector4(lua_State* L, const Vector4& v)
     {
+        ++g_VmathValueCount;
         Vector4* vp = (Vector4*)lua_newuserdata(L, sizeof(Vector4));
         *vp = v;
         luaL_getmetatable(L, SCRIPT_TYPE_NAME_VECTOR4);
@@ -2830,6 +3089,7 @@ namespace dmScript
 
     void PushQuat(lua_State* L, const Quat& q)
     {
+        ++g_VmathValueCount;
         Quat* qp = (Quat*)lua_newuserdata(L, sizeof(Quat));
         *qp = q;
         luaL_getmetatable(L, SCRIPT_TYPE_NAME_QUAT);
@@ -2848,6 +3108,7 @@ namespace dmScript
 
     void PushMatrix4(lua_State* L, const Matrix4& m)
     {
+        ++g_VmathValueCount;
         Matrix4* mp = (Matrix4*)lua_newuserdata(L, sizeof(Matrix4));
         *mp = m;
         luaL_getmetatable(L, SCRIPT_TYPE_NAME_MATRIX4);
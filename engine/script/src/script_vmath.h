@@ -20,9 +20,17 @@ extern "C"
 #include <lua/lua.h>
 }
 
+#include <stdint.h>
+
 namespace dmScript
 {
     void InitializeVmath(lua_State* L);
+
+    /**
+     * Get the number of vector3, vector4, quat and matrix4 values created since the last call
+     * @return the number of created values
+     */
+    uint32_t ResetVmathValueCount();
 }
 
 #endif // DM_SCRIPT_VMATH_H
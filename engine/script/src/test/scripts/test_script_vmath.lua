@@ -51,4 +51,38 @@ print(vmath.clamp(vec4_3, vec4_min, vec4_max))
 assert(vmath.clamp(vec4_3, vec4_min, vec4_max) == vmath.vector4(5, 5, 5, 1))
 
 print(vmath.clamp(vec4_1, 86.2, 200.1))
-assert(vmath.clamp(vec4_1, 86.2, 200.1) == vmath.vector4(86.2, 86.2, 86.2, 86.2))
\ No newline at end of file
+assert(vmath.clamp(vec4_1, 86.2, 200.1) == vmath.vector4(86.2, 86.2, 86.2, 86.2))
+
+--- in place functions
+
+local out3 = vmath.vector3()
+local a3 = vmath.vector3(1, 2, 3)
+local b3 = vmath.vector3(4, 5, 6)
+assert(vmath.add_to(out3, a3, b3) == out3)
+assert(out3 == vmath.vector3(5, 7, 9))
+assert(vmath.sub_to(out3, out3, b3) == out3)
+assert(out3 == a3)
+vmath.mul_to(out3, out3, 2)
+assert(out3 == vmath.vector3(2, 4, 6))
+vmath.lerp_to(out3, 0.5, a3, b3)
+assert(out3 == vmath.vector3(2.5, 3.5, 4.5))
+vmath.normalize_to(out3, vmath.vector3(0, 0, 2))
+assert(out3 == vmath.vector3(0, 0, 1))
+
+local out4 = vmath.vector4()
+vmath.add_to(out4, vmath.vector4(1, 2, 3, 4), vmath.vector4(1, 1, 1, 1))
+assert(out4 == vmath.vector4(2, 3, 4, 5))
+vmath.mul_to(out4, vmath.matrix4(), out4)
+assert(out4 == vmath.vector4(2, 3, 4, 5))
+
+local q = vmath.quat()
+vmath.mul_to(q, vmath.quat_rotation_z(0), vmath.quat_rotation_z(0))
+assert(q == vmath.quat())
+
+local m = vmath.matrix4_translation(vmath.vector3(1, 2, 3))
+vmath.mul_to(m, m, vmath.matrix4())
+assert(m == vmath.matrix4_translation(vmath.vector3(1, 2, 3)))
+
+-- mismatching types
+assert(not pcall(vmath.add_to, out3, a3, out4))
+assert(not pcall(vmath.mul_to, q, out3, 2))
@@ -1308,6 +1308,122 @@ TEST_F(ScriptTestLua, TestCallbackCollisionByInstanceReuse)
     ASSERT_TRUE(RunString(L, "assert(_G.cb2_call_count == 1)"));
 }
 
+static dmScript::HContext NewCustomAllocatorContext(dmConfigFile::HConfig config, dmResource::HFactory factory, uint64_t budget)
+{
+    dmScript::ContextParams context_params = {};
+    context_params.m_ConfigFile         = config;
+    context_params.m_Factory            = factory;
+    context_params.m_UseCustomAllocator = 1;
+    context_params.m_MemoryBudget       = budget;
+    dmScript::HContext context = dmScript::NewContext(context_params);
+    dmScript::Initialize(context);
+    return context;
+}
+
+TEST_F(ScriptTestLua, CustomAllocator)
+{
+    dmScript::HContext context = NewCustomAllocatorContext(m_ConfigFile, m_ResourceFactory, 0);
+    lua_State* state = dmScript::GetLuaState(context);
+
+    dmScript::MemoryStats stats;
+    ASSERT_TRUE(dmScript::GetMemoryStats(context, &stats));
+    ASSERT_LT(0u, stats.m_Allocated);
+    ASSERT_LE(stats.m_Allocated, stats.m_Reserved);
+    ASSERT_EQ(0u, stats.m_Budget);
+    uint32_t alloc_count = stats.m_AllocCount;
+    uint32_t pooled_alloc_count = stats.m_PooledAllocCount;
+
+    ASSERT_TRUE(RunString(state, "_G.vectors = {} for i=1,1000 do _G.vectors[i] = vmath.vector3(i) end"));
+
+    ASSERT_TRUE(dmScript::GetMemoryStats(context, &stats));
+    ASSERT_LT(alloc_count + 1000, stats.m_AllocCount);
+    ASSERT_LT(pooled_alloc_count + 1000, stats.m_PooledAllocCount);
+    // The allocator and the Lua GC must agree on the heap size
+    ASSERT_EQ((uint64_t)lua_gc(state, LUA_GCCOUNT, 0), stats.m_Allocated / 1024);
+
+    uint64_t allocated = stats.m_Allocated;
+    ASSERT_TRUE(RunString(state, "_G.vectors = nil"));
+    lua_gc(state, LUA_GCCOLLECT, 0);
+
+    ASSERT_TRUE(dmScript::GetMemoryStats(context, &stats));
+    ASSERT_GT(allocated, stats.m_Allocated);
+    ASSERT_LE(allocated, stats.m_PeakAllocated);
+    ASSERT_EQ(0u, stats.m_FailedAllocCount);
+
+    dmScript::Finalize(context);
+    dmScript::DeleteContext(context);
+
+    // The default context doesn't use the custom allocator
+    ASSERT_FALSE(dmScript::GetMemoryStats(m_Context, &stats));
+}
+
+TEST_F(ScriptTestLua, CustomAllocatorBudget)
+{
+    const uint64_t budget = 4 * 1024 * 1024;
+    dmScript::HContext context = NewCustomAllocatorContext(m_ConfigFile, m_ResourceFactory, budget);
+    lua_State* state = dmScript::GetLuaState(context);
+
+    ASSERT_FALSE(RunString(state, "_G.tables = {} for i=1,1000000 do _G.tables[i] = { i } end"));
+
+    dmScript::MemoryStats stats;
+    ASSERT_TRUE(dmScript::GetMemoryStats(context, &stats));
+    ASSERT_EQ(budget, stats.m_Budget);
+    ASSERT_LE(stats.m_PeakAllocated, budget);
+    ASSERT_LT(0u, stats.m_FailedAllocCount);
+
+    // The state is still usable once the memory is released
+    lua_pushnil(state);
+    lua_setglobal(state, "tables");
+    lua_gc(state, LUA_GCCOLLECT, 0);
+    ASSERT_TRUE(RunString(state, "local v = vmath.vector3(1, 2, 3) assert(v.x == 1)"));
+
+    dmScript::Finalize(context);
+    dmScript::DeleteContext(context);
+}
+
+TEST_F(ScriptTestLua, ManualGC)
+{
+    dmScript::SetManualGC(m_Context, true);
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    lua_gc(L, LUA_GCSTOP, 0);
+    int heap_start = lua_gc(L, LUA_GCCOUNT, 0);
+
+    // The collector doesn't run automatically
+    ASSERT_TRUE(RunString(L, "for i=1,100000 do local t = { i } end"));
+    int heap_garbage = lua_gc(L, LUA_GCCOUNT, 0);
+    ASSERT_LT(heap_start + 1024, heap_garbage);
+
+    for (int i = 0; i < 1000 && lua_gc(L, LUA_GCCOUNT, 0) >= heap_garbage; ++i)
+    {
+        dmScript::StepGC(m_Context, 1000);
+    }
+    ASSERT_GT(heap_garbage, lua_gc(L, LUA_GCCOUNT, 0));
+
+    dmScript::SetManualGC(m_Context, false);
+    ASSERT_EQ(0u, dmScript::StepGC(m_Context, 1000));
+}
+
+TEST_F(ScriptTestLua, ManualGCHeapLimit)
+{
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    dmScript::SetManualGC(m_Context, true);
+    int heap_start = lua_gc(L, LUA_GCCOUNT, 0);
+
+    // Without any budget, the heap only grows until the collector falls back to a full collection
+    ASSERT_TRUE(RunString(L, "local limit = collectgarbage('count') * 8 + 1024 while collectgarbage('count') < limit do local t = { 1, 2, 3 } end"));
+    int heap_garbage = lua_gc(L, LUA_GCCOUNT, 0);
+    ASSERT_LT(heap_start * 8, heap_garbage);
+
+    dmScript::StepGC(m_Context, 0);
+    ASSERT_GT(heap_start * 2, lua_gc(L, LUA_GCCOUNT, 0));
+
+    // The collector is still stopped afterwards
+    ASSERT_TRUE(RunString(L, "for i=1,100000 do local t = { i } end"));
+    ASSERT_LT(heap_start + 1024, lua_gc(L, LUA_GCCOUNT, 0));
+
+    dmScript::SetManualGC(m_Context, false);
+}
+
 #undef USE_PANIC_FN
 
 extern "C" void dmExportedSymbols();
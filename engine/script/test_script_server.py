@@ -20,6 +20,11 @@ import time
 import sys
 import socket
 
+# State of the /overlap requests that are currently handled
+overlap_condition = threading.Condition()
+overlap_active = 0
+overlap_max = 0
+
 class Handler(BaseHTTPRequestHandler):
 
     def version_string(self):
@@ -53,6 +58,22 @@ class Handler(BaseHTTPRequestHandler):
             sys.stdout.flush()
             time.sleep( sleeptime )
             to_send = "slept for %f" % sleeptime
+
+        elif self.path.startswith('/overlap'):
+            # Holds the request until the given number of /overlap requests are handled at the same time,
+            # or for at most 4 seconds, and returns the largest number of requests that were handled at once
+            global overlap_active, overlap_max
+            tokens = self.path.split('/')
+            count = int(tokens[2])
+            with overlap_condition:
+                overlap_active += 1
+                overlap_max = max(overlap_max, overlap_active)
+                overlap_condition.notify_all()
+                overlap_condition.wait_for(lambda: overlap_max >= count, 4.0)
+                to_send = "overlap %d" % overlap_max
+                overlap_active -= 1
+                if overlap_active == 0:
+                    overlap_max = 0
         else:
             try:
                 import test_script_server_plugin
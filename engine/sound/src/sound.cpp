@@ -28,10 +28,12 @@
 
 #include "sound.h"
 #include "sound_codec.h"
+#include "sound_decoder.h"
 #include "sound_private.h"
 #include "sound_dsp.h"
 
 #include <math.h>
+#include <algorithm>
 
 /**
  * Defold simple sound system
@@ -48,6 +50,10 @@ namespace dmSound
     DM_PROPERTY_U32(rmtp_SoundDataSize, 0, PROFILE_PROPERTY_NONE, "size of sound data in bytes", &rmtp_SoundSystem);
     DM_PROPERTY_U32(rmtp_ScratchBufferSize, 0, PROFILE_PROPERTY_NONE, "size of decoder scratch buffers in bytes", &rmtp_SoundSystem);
     DM_PROPERTY_U32(rmtp_InstanceBufferSize, 0, PROFILE_PROPERTY_NONE, "size of instance frame buffers in bytes", &rmtp_SoundSystem);
+    DM_PROPERTY_U32(rmtp_PcmCacheCount, 0, PROFILE_PROPERTY_NONE, "# sounds in the decoded sound cache", &rmtp_SoundSystem);
+    DM_PROPERTY_U32(rmtp_PcmCacheSize, 0, PROFILE_PROPERTY_NONE, "size of the decoded sound cache in bytes", &rmtp_SoundSystem);
+    DM_PROPERTY_U32(rmtp_RealVoiceCount, 0, PROFILE_PROPERTY_NONE, "# playing voices that are mixed", &rmtp_SoundSystem);
+    DM_PROPERTY_U32(rmtp_VirtualVoiceCount, 0, PROFILE_PROPERTY_NONE, "# playing voices that are virtual (not decoded or mixed)", &rmtp_SoundSystem);
 
     static void SoundThread(void* ctx);
 
@@ -95,6 +101,14 @@ namespace dmSound
             m_Current = m_Next;
         }
 
+        /**
+         * The largest value of the ramp being mixed, and the next one
+         */
+        inline float GetMax() const
+        {
+            return dmMath::Max(dmMath::Max(m_Prev, m_Current), m_Next);
+        }
+
         Value()
         {
             Reset(1.0f);
@@ -145,16 +159,38 @@ namespace dmSound
         FSoundDataGetData   m_GetData;
     };
 
+    // Fully decoded (float, non-interleaved) frames of a short compressed sound
+    struct PcmCacheEntry
+    {
+        float*      m_Frames[SOUND_MAX_DECODE_CHANNELS];
+        uint32_t    m_FrameCount;
+        uint32_t    m_Rate;
+        uint32_t    m_Size;         // bytes
+        uint32_t    m_LastUsed;     // for the LRU eviction
+        uint16_t    m_RefCount;     // number of decoders playing the entry
+        uint16_t    m_SoundDataIndex;
+        uint8_t     m_Channels;
+        uint8_t     m_Orphaned : 1; // evicted while playing, freed when the last decoder is closed
+        uint8_t     : 7;
+    };
+
     struct SoundData
     {
         dmhash_t            m_NameHash;
         void*               m_Data;
         int                 m_Size;
         SoundDataCallbacks  m_DataCallbacks;
+        PcmCacheEntry*      m_PcmCacheEntry;
         // Index in m_SoundData
         uint16_t            m_Index;
         SoundDataType       m_Type;
         uint16_t            m_RefCount;
+        uint32_t            m_FrameCount;           // the number of frames in the sound, 0 if unknown (see GetInstanceFrameCount())
+        uint32_t            m_PcmCacheGeneration;   // the cache generation when the sound didn't fit in the cache (see BackOffPcmCache())
+        uint8_t             m_PcmUncacheable : 1; // too long, or failed to decode
+        uint8_t             m_PcmCacheBackOff : 1;
+        uint8_t             m_FrameCountValid : 1;
+        uint8_t             : 5;
     };
 
     struct SoundInstance
@@ -180,8 +216,34 @@ namespace dmSound
         uint8_t     m_Playing : 1;
         uint8_t     m_ScaleDirty : 1;
         uint8_t     m_ScaleInit : 1;
-        uint8_t     : 3;
+        uint8_t     m_DecodeAhead : 1;      // compressed sound, decoded ahead of the mixer (see DecodeAhead())
+        uint8_t     m_AheadEndOfStream : 1; // the decoder reached the end of the stream
+        uint8_t     m_AheadMuted : 1;       // skip instead of decode
         int8_t      m_Loopcounter; // if set to 3, there will be 3 loops effectively playing the sound 4 times.
+        uint8_t     m_Priority;    // higher priority voices are kept real (see SelectRealVoices())
+        uint8_t     m_Virtual : 1; // the play cursor advances, without decoding or mixing (see AdvanceVirtualInstance())
+        uint8_t     m_PcmCached : 1;        // played from the decoded sound cache
+        uint8_t     m_VirtualLooped : 1;    // the play cursor of the virtual voice wrapped around, behind the decoder
+        uint8_t     : 5;
+        // The playing state after the queued play/stop/pause commands are applied. Written by the caller without the lock,
+        // so it must not share a bitfield with the state written by the mixer
+        uint8_t     m_RequestedPlaying;
+        float       m_Audibility;
+        uint64_t    m_VirtualFrame;         // the play cursor of a virtual voice
+        uint32_t    m_VirtualFrameCount;    // the number of frames in the sound of a virtual voice
+        int32_atomic_t m_PublishedPlaying;  // m_Playing, as seen by IsPlaying() without locking
+        int32_atomic_t m_PendingCommands;   // queued play/stop/pause commands
+        int32_atomic_t m_QueuedCommands;    // all queued commands for the instance (see DeleteSoundInstance())
+
+        // Decoded (float, non-interleaved) frames not yet consumed by the mixer
+        float*      m_AheadFrames[SOUND_MAX_DECODE_CHANNELS];
+        void*       m_AheadTemp;            // raw decoder output, prior to conversion
+        uint32_t    m_AheadFrameCapacity;
+        uint32_t    m_AheadTempCapacity;    // bytes
+        uint32_t    m_AheadStart;           // first unconsumed frame
+        uint32_t    m_AheadCount;           // number of unconsumed frames
+        uint32_t    m_AheadTarget;          // number of frames to keep decoded
+        dmSoundCodec::Result m_AheadResult;
     };
 
     struct SoundGroup
@@ -197,6 +259,28 @@ namespace dmSound
         int      m_NextMemorySlot;
     };
 
+    enum SoundCommandType
+    {
+        SOUND_COMMAND_PLAY,
+        SOUND_COMMAND_STOP,
+        SOUND_COMMAND_PAUSE,
+        SOUND_COMMAND_SET_PARAMETER,
+        SOUND_COMMAND_SET_GROUP_GAIN,
+        SOUND_COMMAND_SET_GROUP,
+        SOUND_COMMAND_SET_LOOPING,
+        SOUND_COMMAND_SET_PRIORITY,
+    };
+
+    // A change from the main thread, applied by the mixer at the start of the next mix period
+    struct SoundCommand
+    {
+        SoundInstance*  m_Instance;
+        dmhash_t        m_Group;
+        float           m_Value;
+        uint8_t         m_Type;      // SoundCommandType
+        uint8_t         m_Parameter; // Parameter
+    };
+
     struct SoundSystem
     {
         dmSoundCodec::HCodecContext   m_CodecContext;
@@ -204,6 +288,7 @@ namespace dmSound
         HDevice                       m_Device;
         OpenDeviceParams              m_DeviceParams;
         dmThread::Thread              m_Thread;
+        dmThread::Thread              m_CommandThread;  // the thread calling Initialize(), owning the command queue and the instances (see PushCommand())
         dmMutex::HMutex               m_Mutex;
 
         dmArray<SoundInstance>  m_Instances;
@@ -215,6 +300,11 @@ namespace dmSound
         dmHashTable<dmhash_t, int> m_GroupMap;
         SoundGroup              m_Groups[MAX_GROUPS];
 
+        // Single producer (the thread calling the dmSound api), single consumer (the mixer, holding m_Mutex)
+        dmArray<SoundCommand>   m_Commands;
+        int32_atomic_t          m_CommandWrite;
+        int32_atomic_t          m_CommandRead;
+
         int32_atomic_t          m_IsRunning;
         int32_atomic_t          m_IsPaused;
         int32_atomic_t          m_Status; // type Result
@@ -235,7 +325,22 @@ namespace dmSound
         uint8_t                 m_UseFloatOutput : 1;
         uint8_t                 m_NormalizeFloatOutput : 1;
         uint8_t                 m_NonInterleavedOutput : 1;
-        uint8_t                 : 5;
+        uint8_t                 m_DecodeAhead : 1;
+        uint8_t                 : 4;
+
+        HJobContext             m_JobContext;
+        dmArray<SoundInstance*> m_DecodeAheadInstances;
+        struct DecodeAheadJobContext* m_DecodeAheadJob; // the instances being decoded ahead of the next mix (see StartDecodeAhead())
+
+        dmArray<SoundInstance*> m_Voices;
+        uint32_t                m_MaxRealVoices; // 0 disables the voice virtualization
+
+        dmArray<PcmCacheEntry*> m_PcmCache;
+        uint32_t                m_PcmCacheSize;         // bytes, including entries evicted while playing
+        uint32_t                m_PcmCacheCapacity;     // bytes, 0 disables the cache
+        uint32_t                m_PcmCacheMaxDuration;  // milliseconds
+        uint32_t                m_PcmCacheTick;
+        uint32_t                m_PcmCacheGeneration;   // incremented when there may be room for more sounds in the cache
 
         bool                    m_IsDeviceStarted;
         bool                    m_IsAudioInterrupted;
@@ -250,6 +355,8 @@ namespace dmSound
 
     DeviceType* g_FirstDevice = 0;
 
+    static void WaitForDecodeAheadNoLock(SoundSystem* sound);
+
     void SetDefaultInitializeParams(InitializeParams* params)
     {
         memset(params, 0, sizeof(InitializeParams));
@@ -263,6 +370,9 @@ namespace dmSound
         params->m_UseThread = true;
         params->m_DSPImplementation = DSPIMPL_TYPE_DEFAULT;
         params->m_UseLinearGain = true;
+        params->m_PcmCacheSize = 0;
+        params->m_PcmCacheMaxDuration = 500;
+        params->m_MaxRealVoices = 0;
     }
 
     Result RegisterDevice(struct DeviceType* device)
@@ -401,6 +511,10 @@ namespace dmSound
         uint32_t max_instances = params->m_MaxInstances;
         uint32_t sample_frame_count = params->m_FrameCount; // 0 means, use the defaults
         bool use_linear_gain = params->m_UseLinearGain;
+        bool decode_ahead = params->m_DecodeAhead;
+        uint32_t pcm_cache_size = params->m_PcmCacheSize;
+        uint32_t pcm_cache_max_duration = params->m_PcmCacheMaxDuration;
+        uint32_t max_real_voices = params->m_MaxRealVoices;
 
         if (config)
         {
@@ -410,6 +524,10 @@ namespace dmSound
             max_instances = (uint32_t) dmConfigFile::GetInt(config, "sound.max_sound_instances", (int32_t) max_instances);
             sample_frame_count = (uint32_t) dmConfigFile::GetInt(config, "sound.sample_frame_count", (int32_t) sample_frame_count);
             use_linear_gain = dmConfigFile::GetInt(config, "sound.use_linear_gain", (int32_t) use_linear_gain) != 0;
+            decode_ahead = dmConfigFile::GetInt(config, "sound.decode_ahead", (int32_t) decode_ahead) != 0;
+            pcm_cache_size = (uint32_t) dmConfigFile::GetInt(config, "sound.pcm_cache_size", (int32_t) pcm_cache_size);
+            pcm_cache_max_duration = (uint32_t) dmConfigFile::GetInt(config, "sound.pcm_cache_max_duration", (int32_t) pcm_cache_max_duration);
+            max_real_voices = (uint32_t) dmConfigFile::GetInt(config, "sound.max_real_voices", (int32_t) max_real_voices);
         }
 
         HDevice device = 0;
@@ -450,6 +568,22 @@ namespace dmSound
         codec_params.m_MaxDecoders = params->m_MaxInstances;
         sound->m_CodecContext = dmSoundCodec::New(&codec_params);
         sound->m_UseLinearGain = use_linear_gain;
+        sound->m_DecodeAhead = decode_ahead;
+        sound->m_JobContext = params->m_JobContext;
+        sound->m_DecodeAheadInstances.SetCapacity(max_instances);
+        sound->m_DecodeAheadJob = 0;
+        sound->m_Voices.SetCapacity(max_instances);
+        sound->m_Commands.SetCapacity(SOUND_COMMAND_QUEUE_SIZE);
+        sound->m_Commands.SetSize(SOUND_COMMAND_QUEUE_SIZE);
+        sound->m_CommandWrite = 0;
+        sound->m_CommandRead = 0;
+        sound->m_MaxRealVoices = max_real_voices;
+        sound->m_PcmCache.SetCapacity(max_sound_data);
+        sound->m_PcmCacheSize = 0;
+        sound->m_PcmCacheCapacity = pcm_cache_size;
+        sound->m_PcmCacheMaxDuration = pcm_cache_max_duration;
+        sound->m_PcmCacheTick = 0;
+        sound->m_PcmCacheGeneration = 0;
 
         // The device wanted to provide the count (e.g. Wasapi)
         if (device_info.m_FrameCount)
@@ -517,6 +651,10 @@ namespace dmSound
         DM_PROPERTY_SET_U32(rmtp_SoundDataSize, 0);
         DM_PROPERTY_SET_U32(rmtp_ScratchBufferSize, 0);
         DM_PROPERTY_SET_U32(rmtp_InstanceBufferSize, max_instances * initial_instance_frame_capacity * sizeof(float) * SOUND_MAX_DECODE_CHANNELS);
+        DM_PROPERTY_SET_U32(rmtp_PcmCacheCount, 0);
+        DM_PROPERTY_SET_U32(rmtp_PcmCacheSize, 0);
+        DM_PROPERTY_SET_U32(rmtp_RealVoiceCount, 0);
+        DM_PROPERTY_SET_U32(rmtp_VirtualVoiceCount, 0);
 
         sound->m_UseFloatOutput = device_info.m_UseFloats;
         sound->m_NormalizeFloatOutput = device_info.m_UseNormalized;
@@ -543,6 +681,7 @@ namespace dmSound
         dmAtomicStore32(&sound->m_Status, (int)RESULT_NOTHING_TO_PLAY);
 
         sound->m_Thread = 0;
+        sound->m_CommandThread = dmThread::GetCurrentThread();
         sound->m_Mutex = 0;
         if (use_thread)
         {
@@ -553,6 +692,7 @@ namespace dmSound
         dmLogInfo("Sound");
         dmLogInfo("  nSamplesPerSec:   %d", device_info.m_MixRate);
         dmLogInfo("       useThread:   %d", use_thread);
+        dmLogInfo("     decodeAhead:   %d", decode_ahead);
 
         return r;
     }
@@ -569,6 +709,7 @@ namespace dmSound
             dmThread::Join(sound->m_Thread);
             dmMutex::Delete(sound->m_Mutex);
         }
+        WaitForDecodeAheadNoLock(sound);
 
         PlatformFinalize();
 
@@ -586,10 +727,18 @@ namespace dmSound
                 for (uint32_t c = 0; c < SOUND_MAX_DECODE_CHANNELS; ++c)
                 {
                     free(instance->m_Frames[c]);
+                    free(instance->m_AheadFrames[c]);
                 }
+                free(instance->m_AheadTemp);
                 memset(instance, 0, sizeof(*instance));
             }
 
+            for (uint32_t i = 0; i < sound->m_PcmCache.Size(); ++i)
+            {
+                free(sound->m_PcmCache[i]->m_Frames[0]);
+                delete sound->m_PcmCache[i];
+            }
+
             free(sound->m_DecoderTempOutput);
             for (uint32_t i = 0; i < SOUND_MAX_DECODE_CHANNELS; ++i)
             {
@@ -622,6 +771,10 @@ namespace dmSound
             DM_PROPERTY_SET_U32(rmtp_SoundDataSize, 0);
             DM_PROPERTY_SET_U32(rmtp_ScratchBufferSize, 0);
             DM_PROPERTY_SET_U32(rmtp_InstanceBufferSize, 0);
+            DM_PROPERTY_SET_U32(rmtp_PcmCacheCount, 0);
+            DM_PROPERTY_SET_U32(rmtp_PcmCacheSize, 0);
+            DM_PROPERTY_SET_U32(rmtp_RealVoiceCount, 0);
+            DM_PROPERTY_SET_U32(rmtp_VirtualVoiceCount, 0);
 
             delete sound;
             g_SoundSystem = 0;
@@ -683,6 +836,57 @@ namespace dmSound
         return (uint32_t)(info.m_Channels * (info.m_BitsPerSample / 8));
     }
 
+    // Converts decoded data from the temp decoder output (interleaved) to per channel data (non-interleaved) & to float as needed
+    static void ConvertDecodedFrames(const dmSoundCodec::Info& info, void* decoded, float* out[], uint32_t frame_count)
+    {
+        // Interleaved?
+        if (!info.m_IsInterleaved)
+        {
+            // No...
+
+            // For now we only support floats in this case
+            // (in which case we have nothing more to process)
+            assert(info.m_BitsPerSample == 32);
+            return;
+        }
+
+        const uint32_t nc = info.m_Channels;
+        if (info.m_BitsPerSample == 8)
+        {
+            if (nc == 1)
+            {
+                ConvertFromS8(out[0], (int8_t*)decoded, frame_count);
+            }
+            else
+            {
+                assert(nc == 2);
+                DeinterleaveFromS8(out, (int8_t*)decoded, frame_count);
+            }
+        }
+        else if (info.m_BitsPerSample == 16)
+        {
+            if (nc == 1)
+            {
+                ConvertFromS16(out[0], (int16_t*)decoded, frame_count);
+            }
+            else
+            {
+                assert(nc == 2);
+                DeinterleaveFromS16(out, (int16_t*)decoded, frame_count);
+            }
+        }
+        else
+        {
+            assert(info.m_BitsPerSample == 32);
+            // We only need to convert anything if the output has more than one channel...
+            if (nc != 1)
+            {
+                assert(nc == 2);
+                Deinterleave(out, (float*)decoded, frame_count);
+            }
+        }
+    }
+
     static Result EnsureDecoderScratchBufferSize(SoundSystem* sound, const dmSoundCodec::Info& info, uint32_t required_frame_capacity)
     {
         const uint64_t required_temp_output_capacity = (uint64_t)required_frame_capacity * GetDecoderOutputStrideBytes(info);
@@ -743,11 +947,50 @@ namespace dmSound
         return RESULT_OK;
     }
 
-    static void ResetInstanceMixState(SoundInstance* instance)
+    static Result EnsureAheadBufferSize(SoundInstance* instance, const dmSoundCodec::Info& info, uint32_t required_frame_capacity)
     {
-        instance->m_FrameFraction = 0;
-        instance->m_EndOfStream = 0;
+        const uint64_t required_temp_capacity = (uint64_t)required_frame_capacity * GetDecoderOutputStrideBytes(info);
+        if (required_temp_capacity > 0xffffffffU)
+            return RESULT_OUT_OF_MEMORY;
+
+        if (required_frame_capacity > instance->m_AheadFrameCapacity)
+        {
+            for (uint32_t c = 0; c < SOUND_MAX_DECODE_CHANNELS; ++c)
+            {
+                float* new_frame_buffer = (float*)realloc(instance->m_AheadFrames[c], required_frame_capacity * sizeof(float));
+                if (new_frame_buffer == 0)
+                    return RESULT_OUT_OF_MEMORY;
+
+                instance->m_AheadFrames[c] = new_frame_buffer;
+            }
+            DM_PROPERTY_ADD_U32(rmtp_InstanceBufferSize, (required_frame_capacity - instance->m_AheadFrameCapacity) * sizeof(float) * SOUND_MAX_DECODE_CHANNELS);
+            instance->m_AheadFrameCapacity = required_frame_capacity;
+        }
 
+        if (required_temp_capacity > instance->m_AheadTempCapacity)
+        {
+            void* new_temp = realloc(instance->m_AheadTemp, (size_t)required_temp_capacity);
+            if (new_temp == 0)
+                return RESULT_OUT_OF_MEMORY;
+
+            DM_PROPERTY_ADD_U32(rmtp_InstanceBufferSize, (uint32_t)required_temp_capacity - instance->m_AheadTempCapacity);
+            instance->m_AheadTemp = new_temp;
+            instance->m_AheadTempCapacity = (uint32_t)required_temp_capacity;
+        }
+
+        return RESULT_OK;
+    }
+
+    static void ResetDecodeAhead(SoundInstance* instance)
+    {
+        instance->m_AheadStart = 0;
+        instance->m_AheadCount = 0;
+        instance->m_AheadEndOfStream = 0;
+        instance->m_AheadResult = dmSoundCodec::RESULT_OK;
+    }
+
+    static void ResetInstanceHistory(SoundInstance* instance)
+    {
         for (uint32_t c = 0; c < SOUND_MAX_DECODE_CHANNELS; ++c)
         {
             memset(instance->m_Frames[c], 0, SOUND_MAX_HISTORY * sizeof(float));
@@ -755,9 +998,34 @@ namespace dmSound
         instance->m_FrameCount = SOUND_MAX_HISTORY;
     }
 
+    static void ResetInstanceMixState(SoundInstance* instance)
+    {
+        instance->m_FrameFraction = 0;
+        instance->m_EndOfStream = 0;
+        instance->m_Virtual = 0;
+        instance->m_VirtualLooped = 0;
+        ResetDecodeAhead(instance);
+        ResetInstanceHistory(instance);
+    }
+
+
+    static void EvictPcmCacheEntry(SoundSystem* sound, PcmCacheEntry* entry);
+
+    static void InvalidatePcmCache(HSoundData sound_data)
+    {
+        if (sound_data->m_PcmCacheEntry)
+        {
+            EvictPcmCacheEntry(g_SoundSystem, sound_data->m_PcmCacheEntry);
+        }
+        sound_data->m_PcmUncacheable = 0;
+        sound_data->m_PcmCacheBackOff = 0;
+    }
 
     static Result SetSoundDataNoLock(HSoundData sound_data, const void* sound_buffer, uint32_t sound_buffer_size)
     {
+        InvalidatePcmCache(sound_data);
+        sound_data->m_FrameCountValid = 0;
+
         const uint32_t previous_sound_size = sound_data->m_Size;
         free(sound_data->m_Data);
         sound_data->m_Data = malloc(sound_buffer_size);
@@ -795,6 +1063,12 @@ namespace dmSound
         sd->m_Size = 0;
         sd->m_DataCallbacks.m_Context = cbk_ctx;
         sd->m_DataCallbacks.m_GetData = cbk;
+        sd->m_PcmCacheEntry = 0;
+        sd->m_PcmUncacheable = 0;
+        sd->m_PcmCacheBackOff = 0;
+        sd->m_PcmCacheGeneration = 0;
+        sd->m_FrameCount = 0;
+        sd->m_FrameCountValid = 0;
         sd->m_RefCount = 1;
         DM_PROPERTY_ADD_U32(rmtp_SoundDataSize, sizeof(SoundData));
 
@@ -826,12 +1100,16 @@ namespace dmSound
     Result SetSoundData(HSoundData sound_data, const void* sound_buffer, uint32_t sound_buffer_size)
     {
         DM_MUTEX_OPTIONAL_SCOPED_LOCK(g_SoundSystem->m_Mutex);
+        WaitForDecodeAheadNoLock(g_SoundSystem);
         return SetSoundDataNoLock(sound_data, sound_buffer, sound_buffer_size);
     }
 
     Result SetSoundDataCallback(HSoundData sound_data, FSoundDataGetData cbk, void* cbk_ctx)
     {
         DM_MUTEX_OPTIONAL_SCOPED_LOCK(g_SoundSystem->m_Mutex);
+        WaitForDecodeAheadNoLock(g_SoundSystem);
+        InvalidatePcmCache(sound_data);
+        sound_data->m_FrameCountValid = 0;
         sound_data->m_DataCallbacks.m_Context = cbk_ctx;
         sound_data->m_DataCallbacks.m_GetData = cbk;
         return RESULT_OK;
@@ -865,6 +1143,8 @@ namespace dmSound
         if (sound_data->m_Data != 0x0)
             free((void*) sound_data->m_Data);
 
+        InvalidatePcmCache(sound_data);
+
         SoundSystem* sound = g_SoundSystem;
         DM_PROPERTY_ADD_U32(rmtp_SoundDataSize, -((int32_t)sizeof(SoundData) + (int32_t)sound_data->m_Size));
         sound->m_SoundDataPool.Push(sound_data->m_Index);
@@ -905,193 +1185,660 @@ namespace dmSound
         return RESULT_END_OF_STREAM;
     }
 
-    Result NewSoundInstance(HSoundData sound_data, HSoundInstance* sound_instance)
+    // Called when an entry is removed from the cache, or is no longer playing, as there may be room for other sounds
+    static void OnPcmCacheRoomMade(SoundSystem* sound)
     {
-        SoundSystem* ss = g_SoundSystem;
-
-        dmSoundCodec::HDecoder decoder;
+        sound->m_PcmCacheGeneration++;
+    }
 
-        dmSoundCodec::Format codec_format = dmSoundCodec::FORMAT_WAV;
-        if (sound_data->m_Type == SOUND_DATA_TYPE_WAV) {
-            codec_format = dmSoundCodec::FORMAT_WAV;
-        } else if (sound_data->m_Type == SOUND_DATA_TYPE_OGG_VORBIS) {
-            codec_format = dmSoundCodec::FORMAT_VORBIS;
-        } else if (sound_data->m_Type == SOUND_DATA_TYPE_OPUS) {
-            codec_format = dmSoundCodec::FORMAT_OPUS;
-        } else {
-            assert(0);
-        }
+    static void FreePcmCacheEntry(SoundSystem* sound, PcmCacheEntry* entry)
+    {
+        sound->m_PcmCacheSize -= entry->m_Size;
+        DM_PROPERTY_SET_U32(rmtp_PcmCacheSize, sound->m_PcmCacheSize);
+        free(entry->m_Frames[0]);
+        delete entry;
+    }
 
-        uint16_t index;
+    // Removes the entry from the cache. If it's still being played, it's freed when the last decoder is closed
+    static void EvictPcmCacheEntry(SoundSystem* sound, PcmCacheEntry* entry)
+    {
+        for (uint32_t i = 0; i < sound->m_PcmCache.Size(); ++i)
         {
-            DM_MUTEX_OPTIONAL_SCOPED_LOCK(ss->m_Mutex);
-
-            if (ss->m_InstancesPool.Remaining() == 0)
+            if (sound->m_PcmCache[i] == entry)
             {
-                *sound_instance = 0;
-                dmLogError("Out of sound data instance slots (%u). Increase the project setting 'sound.max_sound_instances'", ss->m_InstancesPool.Capacity());
-                return RESULT_OUT_OF_INSTANCES;
-            }
-
-            dmSoundCodec::Result r = dmSoundCodec::NewDecoder(ss->m_CodecContext, codec_format, sound_data, &decoder);
-            if (r != dmSoundCodec::RESULT_OK) {
-                if (r == dmSoundCodec::RESULT_UNSUPPORTED) {
-                    const char* name = dmHashReverseSafe64(sound_data->m_NameHash);
-                    const char* format_str = dmSoundCodec::FormatToString(codec_format);
-                    dmLogError("Sound '%s' uses %s, but no decoder was found. Ensure the codec is included in your App Manifest.", name, format_str);
-                } else {
-                    dmLogError("Failed to decode sound %s: (%d)", dmHashReverseSafe64(sound_data->m_NameHash), r);
-                }
-                return RESULT_INVALID_STREAM_DATA;
+                sound->m_PcmCache.EraseSwap(i);
+                break;
             }
-
-            index = ss->m_InstancesPool.Pop();
-            DM_PROPERTY_SET_U32(rmtp_InstanceCount, ss->m_InstancesPool.Size());
         }
+        DM_PROPERTY_SET_U32(rmtp_PcmCacheCount, sound->m_PcmCache.Size());
 
-        sound_data->m_RefCount ++;
-
-        SoundInstance* si = &ss->m_Instances[index];
-        assert(si->m_Index == 0xffff);
-
-        si->m_SoundDataIndex = sound_data->m_Index;
-        si->m_Index = index;
-        si->m_Gain.Reset(1.0f);
-        si->m_Pan.Reset(0.5f);
-        for(uint32_t c=0; c<SOUND_MAX_DECODE_CHANNELS; ++c)
+        sound->m_SoundData[entry->m_SoundDataIndex].m_PcmCacheEntry = 0;
+        if (entry->m_RefCount == 0)
         {
-            si->m_ScaleL[c].Reset(0.70711f);
-            si->m_ScaleR[c].Reset(0.70711f);
+            FreePcmCacheEntry(sound, entry);
         }
-        si->m_ScaleDirty = 1;
-        si->m_ScaleInit = 1;
-        for(uint32_t c=0; c<SOUND_MAX_DECODE_CHANNELS; ++c)
+        else
         {
-            si->m_ScaleL[c].Reset(0.70711f);
-            si->m_ScaleR[c].Reset(0.70711f);
+            entry->m_Orphaned = 1;
         }
-        si->m_ScaleDirty = 1;
-        si->m_ScaleInit = 1;
-        si->m_Looping = 0;
-        si->m_EndOfStream = 0;
-        si->m_Playing = 0;
-        si->m_Decoder = decoder;
-        si->m_Group = MASTER_GROUP_HASH;
-        ResetInstanceMixState(si);
+        OnPcmCacheRoomMade(sound);
+    }
 
-        *sound_instance = si;
+    // Evicts the least recently used entries that aren't playing, until 'size' bytes fit in the cache
+    static bool MakeRoomInPcmCache(SoundSystem* sound, uint32_t size)
+    {
+        while (sound->m_PcmCacheSize + size > sound->m_PcmCacheCapacity)
+        {
+            PcmCacheEntry* lru = 0;
+            for (uint32_t i = 0; i < sound->m_PcmCache.Size(); ++i)
+            {
+                PcmCacheEntry* entry = sound->m_PcmCache[i];
+                if (entry->m_RefCount == 0 && (lru == 0 || entry->m_LastUsed < lru->m_LastUsed))
+                {
+                    lru = entry;
+                }
+            }
 
-        return RESULT_OK;
+            if (lru == 0)
+            {
+                return false;
+            }
+            EvictPcmCacheEntry(sound, lru);
+        }
+        return true;
     }
 
-    static void StopNoLock(SoundSystem* sound, HSoundInstance sound_instance);
-
-    Result DeleteSoundInstance(HSoundInstance sound_instance)
+    static dmSoundCodec::Format GetCodecFormat(SoundDataType type)
     {
-        SoundSystem* sound = g_SoundSystem;
-        DM_MUTEX_OPTIONAL_SCOPED_LOCK(sound->m_Mutex);
+        dmSoundCodec::Format codec_format = dmSoundCodec::FORMAT_WAV;
+        if (type == SOUND_DATA_TYPE_WAV) {
+            codec_format = dmSoundCodec::FORMAT_WAV;
+        } else if (type == SOUND_DATA_TYPE_OGG_VORBIS) {
+            codec_format = dmSoundCodec::FORMAT_VORBIS;
+        } else if (type == SOUND_DATA_TYPE_OPUS) {
+            codec_format = dmSoundCodec::FORMAT_OPUS;
+        } else {
+            assert(0);
+        }
+        return codec_format;
+    }
 
-        if (IsPlaying(sound_instance))
+    // The number of frames in a sound, from the headers of the sound file. 0 if unknown, e.g. for streamed sounds
+    static uint32_t GetSoundDataFrameCount(SoundData* sound_data, const dmSoundCodec::Info& info)
+    {
+        if (!sound_data->m_FrameCountValid)
         {
-            dmLogError("Deleting playing sound instance (%s)", GetSoundName(sound, sound_instance));
-            StopNoLock(sound, sound_instance);
+            sound_data->m_FrameCount = 0;
+            if (sound_data->m_Data && !sound_data->m_DataCallbacks.m_GetData)
+            {
+                uint64_t frame_count = dmSoundCodec::GetFrameCount(GetCodecFormat(sound_data->m_Type), sound_data->m_Data, sound_data->m_Size, &info);
+                sound_data->m_FrameCount = (uint32_t)dmMath::Min(frame_count, (uint64_t)0xffffffff);
+            }
+            sound_data->m_FrameCountValid = 1;
         }
-
-        uint16_t index = sound_instance->m_Index;
-        sound->m_InstancesPool.Push(index);
-        DM_PROPERTY_SET_U32(rmtp_InstanceCount, sound->m_InstancesPool.Size());
-        sound_instance->m_Index = 0xffff;
-        DeleteSoundData(&sound->m_SoundData[sound_instance->m_SoundDataIndex]);
-        sound_instance->m_SoundDataIndex = 0xffff;
-        dmSoundCodec::DeleteDecoder(sound->m_CodecContext, sound_instance->m_Decoder);
-        sound_instance->m_Decoder = 0;
-        sound_instance->m_FrameCount = 0;
-        sound_instance->m_FrameFraction = 0;
-        sound_instance->m_Speed = 1.0f;
-        sound_instance->m_EndOfStream = 0;
-
-        return RESULT_OK;
+        return sound_data->m_FrameCount;
     }
 
-    Result SetInstanceGroup(HSoundInstance instance, const char* group_name)
+    // If the sound didn't fit in the cache, we don't try again until there may be room for it
+    static void BackOffPcmCache(SoundSystem* sound, HSoundData sound_data)
     {
-        dmhash_t group_hash = dmHashString64(group_name);
-        return SetInstanceGroup(instance, group_hash);
+        sound_data->m_PcmCacheBackOff = 1;
+        sound_data->m_PcmCacheGeneration = sound->m_PcmCacheGeneration;
     }
 
-    Result SetInstanceGroup(HSoundInstance instance, dmhash_t group_hash)
+    static bool IsPcmCacheable(SoundSystem* sound, HSoundData sound_data)
     {
-        DM_MUTEX_OPTIONAL_SCOPED_LOCK(g_SoundSystem->m_Mutex);
-        SoundSystem* sound = g_SoundSystem;
-        int* index = sound->m_GroupMap.Get(group_hash);
-        if (!index) {
-            return RESULT_NO_SUCH_GROUP;
+        if (sound->m_PcmCacheCapacity == 0 || sound_data->m_Type == SOUND_DATA_TYPE_WAV || sound_data->m_PcmUncacheable || sound_data->m_DataCallbacks.m_GetData)
+        {
+            return false;
         }
-        instance->m_Group = group_hash;
-        return RESULT_OK;
+        return !sound_data->m_PcmCacheBackOff || sound_data->m_PcmCacheGeneration != sound->m_PcmCacheGeneration;
     }
 
-    Result AddGroup(const char* group)
+    // Creates the decoder used to fill a cache entry. Returns 0 if the sound is too long, or doesn't fit in the cache.
+    // The size is checked from the headers of the sound file (if possible), so that we don't decode the sound in vain
+    static dmSoundCodec::HDecoder BeginPcmCacheEntry(SoundSystem* sound, HSoundData sound_data, dmSoundCodec::Format codec_format, dmSoundCodec::Info* info, uint32_t* max_frame_count)
     {
-        DM_MUTEX_OPTIONAL_SCOPED_LOCK(g_SoundSystem->m_Mutex);
-        int index = GetOrCreateGroup(group);
-        if (index == -1) {
-            return RESULT_OUT_OF_GROUPS;
+        dmSoundCodec::HDecoder decoder;
+        if (dmSoundCodec::NewDecoder(sound->m_CodecContext, codec_format, sound_data, &decoder) != dmSoundCodec::RESULT_OK)
+        {
+            return 0; // reported when creating the instance
         }
-        return RESULT_OK;
+
+        dmSoundCodec::GetInfo(sound->m_CodecContext, decoder, info);
+
+        bool correct_bit_depth = info->m_BitsPerSample == 32 || info->m_BitsPerSample == 16 || info->m_BitsPerSample == 8;
+        bool correct_num_channels = info->m_Channels == 1 || info->m_Channels == 2;
+        *max_frame_count = (uint32_t)(((uint64_t)info->m_Rate * sound->m_PcmCacheMaxDuration) / 1000);
+
+        uint32_t frame_count = GetSoundDataFrameCount(sound_data, *info);
+        uint64_t size = (uint64_t)frame_count * info->m_Channels * sizeof(float);
+        if (!correct_bit_depth || !correct_num_channels || frame_count > *max_frame_count || size > sound->m_PcmCacheCapacity)
+        {
+            dmSoundCodec::DeleteDecoder(sound->m_CodecContext, decoder);
+            sound_data->m_PcmUncacheable = 1;
+            return 0;
+        }
+
+        if (!MakeRoomInPcmCache(sound, (uint32_t)size) || sound->m_PcmCache.Full())
+        {
+            dmSoundCodec::DeleteDecoder(sound->m_CodecContext, decoder);
+            BackOffPcmCache(sound, sound_data);
+            return 0;
+        }
+        return decoder;
     }
 
-    Result SetGroupGain(dmhash_t group_hash, float gain)
+    // Decodes a short compressed sound in full, into 'channel_capacity' frames per channel. Returns the number of frames decoded
+    static uint32_t DecodePcmCacheEntry(SoundSystem* sound, dmSoundCodec::HDecoder decoder, const dmSoundCodec::Info& info, float* out[], uint32_t channel_capacity, dmSoundCodec::Result* result)
     {
-        DM_MUTEX_OPTIONAL_SCOPED_LOCK(g_SoundSystem->m_Mutex);
-        SoundSystem* sound = g_SoundSystem;
-        int* index = sound->m_GroupMap.Get(group_hash);
-        if (!index) {
-            return RESULT_NO_SUCH_GROUP;
-        }
+        DM_PROFILE(__FUNCTION__);
 
-        // If all playing sounds is currently at gain zero
-        // we can safely do a hard reset of the group gain
-        bool reset = true;
-        uint32_t instances = sound->m_Instances.Size();
-        for (uint32_t i = 0; i < instances; ++i)
+        bool is_direct_delivery = (info.m_BitsPerSample == 32 && (!info.m_IsInterleaved || info.m_Channels == 1));
+        const uint32_t stride = !is_direct_delivery ? GetDecoderOutputStrideBytes(info) : (uint32_t)sizeof(float);
+
+        const uint32_t chunk_frame_count = 1024;
+        uint8_t temp[chunk_frame_count * SOUND_MAX_DECODE_CHANNELS * sizeof(float)];
+
+        dmSoundCodec::Result r = dmSoundCodec::RESULT_OK;
+        uint32_t frame_count = 0;
+        while (frame_count < channel_capacity)
         {
-            SoundInstance* instance = &sound->m_Instances[i];
-            if (instance->m_Group != group_hash)
+            uint32_t n = dmMath::Min(chunk_frame_count, channel_capacity - frame_count);
+
+            char* buffer[SOUND_MAX_DECODE_CHANNELS];
+            if (!is_direct_delivery)
             {
-                continue;
+                buffer[0] = (char*)temp;
             }
-            if (instance->m_Playing || instance->m_FrameCount > 0)
+            else
             {
-                if (instance->m_Gain.m_Prev == 0.0)
+                for(uint32_t c=0; c<info.m_Channels; ++c)
                 {
-                    continue;
+                    buffer[c] = (char*)(out[c] + frame_count);
                 }
-                reset = false;
+            }
+
+            uint32_t decoded = 0;
+            r = dmSoundCodec::Decode(sound->m_CodecContext, decoder, buffer, n * stride, &decoded);
+            if (r != dmSoundCodec::RESULT_OK || decoded == 0)
+            {
                 break;
             }
+
+            uint32_t new_frame_count = decoded / stride;
+            if (!is_direct_delivery)
+            {
+                float* new_out[] = {out[0] + frame_count, out[1] + frame_count};
+                ConvertDecodedFrames(info, temp, new_out, new_frame_count);
+            }
+            frame_count += new_frame_count;
         }
-        SoundGroup* group = &sound->m_Groups[*index];
-        group->m_Gain.Set(GainToScale(gain), reset);
-        group->m_GainParameter = gain;
 
-        return RESULT_OK;
+        *result = r;
+        return frame_count;
     }
 
-    Result GetGroupGain(dmhash_t group_hash, float* gain)
+    // Adds the decoded frames to the cache. Returns 0 if the sound is too long, or doesn't fit in the cache
+    static PcmCacheEntry* AddPcmCacheEntry(SoundSystem* sound, HSoundData sound_data, const dmSoundCodec::Info& info, float* const out[], uint32_t frame_count, uint32_t max_frame_count, dmSoundCodec::Result r)
     {
-        DM_MUTEX_OPTIONAL_SCOPED_LOCK(g_SoundSystem->m_Mutex);
-        SoundSystem* sound = g_SoundSystem;
-        int* index = sound->m_GroupMap.Get(group_hash);
-        if (!index) {
-            return RESULT_NO_SUCH_GROUP;
+        if (r != dmSoundCodec::RESULT_END_OF_STREAM || frame_count == 0 || frame_count > max_frame_count)
+        {
+            sound_data->m_PcmUncacheable = 1;
+            return 0;
         }
 
-        SoundGroup* group = &sound->m_Groups[*index];
-        *gain = group->m_GainParameter;
-        return RESULT_OK;
-    }
-
+        uint32_t size = frame_count * info.m_Channels * sizeof(float);
+        if (size > sound->m_PcmCacheCapacity)
+        {
+            sound_data->m_PcmUncacheable = 1;
+            return 0;
+        }
+
+        if (!MakeRoomInPcmCache(sound, size) || sound->m_PcmCache.Full())
+        {
+            BackOffPcmCache(sound, sound_data); // the cache is busy playing other sounds
+            return 0;
+        }
+
+        PcmCacheEntry* entry = new PcmCacheEntry;
+        memset(entry, 0, sizeof(*entry));
+        entry->m_Frames[0] = (float*)malloc(size);
+        entry->m_Frames[1] = entry->m_Frames[0];
+        if (info.m_Channels == 2)
+        {
+            entry->m_Frames[1] = entry->m_Frames[0] + frame_count;
+        }
+        for (uint32_t c = 0; c < info.m_Channels; ++c)
+        {
+            memcpy(entry->m_Frames[c], out[c], frame_count * sizeof(float));
+        }
+
+        entry->m_FrameCount = frame_count;
+        entry->m_Rate = info.m_Rate;
+        entry->m_Size = size;
+        entry->m_SoundDataIndex = sound_data->m_Index;
+        entry->m_Channels = info.m_Channels;
+
+        sound->m_PcmCache.Push(entry);
+        sound->m_PcmCacheSize += size;
+        DM_PROPERTY_SET_U32(rmtp_PcmCacheCount, sound->m_PcmCache.Size());
+        DM_PROPERTY_SET_U32(rmtp_PcmCacheSize, sound->m_PcmCacheSize);
+        return entry;
+    }
+
+    // Decodes a short compressed sound into the cache, if it isn't cached already.
+    // The lock is only held while the cache is modified, as the mixer would wait for the whole decode otherwise
+    static void FillPcmCache(SoundSystem* sound, HSoundData sound_data, dmSoundCodec::Format codec_format)
+    {
+        dmSoundCodec::HDecoder decoder;
+        dmSoundCodec::Info info;
+        uint32_t max_frame_count;
+        {
+            DM_MUTEX_OPTIONAL_SCOPED_LOCK(sound->m_Mutex);
+            if (sound_data->m_PcmCacheEntry || !IsPcmCacheable(sound, sound_data))
+            {
+                return;
+            }
+
+            decoder = BeginPcmCacheEntry(sound, sound_data, codec_format, &info, &max_frame_count);
+            if (!decoder)
+            {
+                return;
+            }
+        }
+
+        // Room for one frame more than allowed, to find out if the sound is too long
+        const uint32_t channel_capacity = max_frame_count + 1;
+        float* frames = (float*)malloc(channel_capacity * info.m_Channels * sizeof(float));
+        float* out[SOUND_MAX_DECODE_CHANNELS] = {frames, frames};
+        if (info.m_Channels == 2)
+        {
+            out[1] = frames + channel_capacity;
+        }
+
+        dmSoundCodec::Result r;
+        uint32_t frame_count = DecodePcmCacheEntry(sound, decoder, info, out, channel_capacity, &r);
+
+        {
+            DM_MUTEX_OPTIONAL_SCOPED_LOCK(sound->m_Mutex);
+            dmSoundCodec::DeleteDecoder(sound->m_CodecContext, decoder);
+
+            // The sound may have been cached by another thread meanwhile
+            if (!sound_data->m_PcmCacheEntry)
+            {
+                sound_data->m_PcmCacheEntry = AddPcmCacheEntry(sound, sound_data, info, out, frame_count, max_frame_count, r);
+            }
+        }
+        free(frames);
+    }
+
+    static PcmCacheEntry* GetPcmCacheEntry(SoundSystem* sound, HSoundData sound_data)
+    {
+        PcmCacheEntry* entry = sound_data->m_PcmCacheEntry;
+        if (entry)
+        {
+            entry->m_LastUsed = ++sound->m_PcmCacheTick;
+        }
+        return entry;
+    }
+
+    // A decoder that plays the frames of a PCM cache entry
+    struct PcmDecodeStream
+    {
+        PcmCacheEntry*  m_Entry;
+        uint32_t        m_Cursor; // frames
+    };
+
+    static dmSoundCodec::Result PcmOpenStream(HSoundData sound_data, dmSoundCodec::HDecodeStream* out)
+    {
+        PcmCacheEntry* entry = sound_data->m_PcmCacheEntry;
+        if (!entry)
+        {
+            return dmSoundCodec::RESULT_INVALID_FORMAT;
+        }
+
+        PcmDecodeStream* stream = new PcmDecodeStream;
+        stream->m_Entry = entry;
+        stream->m_Cursor = 0;
+        entry->m_RefCount++;
+        *out = stream;
+        return dmSoundCodec::RESULT_OK;
+    }
+
+    static void PcmCloseStream(dmSoundCodec::HDecodeStream _stream)
+    {
+        PcmDecodeStream* stream = (PcmDecodeStream*)_stream;
+        PcmCacheEntry* entry = stream->m_Entry;
+        entry->m_RefCount--;
+        if (entry->m_RefCount == 0)
+        {
+            if (entry->m_Orphaned)
+            {
+                FreePcmCacheEntry(g_SoundSystem, entry);
+            }
+            OnPcmCacheRoomMade(g_SoundSystem);
+        }
+        delete stream;
+    }
+
+    static dmSoundCodec::Result PcmDecode(dmSoundCodec::HDecodeStream _stream, char* buffer[], uint32_t buffer_size, uint32_t* decoded)
+    {
+        DM_PROFILE(__FUNCTION__);
+        PcmDecodeStream* stream = (PcmDecodeStream*)_stream;
+        PcmCacheEntry* entry = stream->m_Entry;
+        if (stream->m_Cursor >= entry->m_FrameCount)
+        {
+            *decoded = 0;
+            return dmSoundCodec::RESULT_END_OF_STREAM;
+        }
+
+        uint32_t n = dmMath::Min(buffer_size / (uint32_t)sizeof(float), entry->m_FrameCount - stream->m_Cursor);
+        for (uint32_t c = 0; c < entry->m_Channels; ++c)
+        {
+            memcpy(buffer[c], entry->m_Frames[c] + stream->m_Cursor, n * sizeof(float));
+        }
+        stream->m_Cursor += n;
+        *decoded = n * sizeof(float);
+        return dmSoundCodec::RESULT_OK;
+    }
+
+    static dmSoundCodec::Result PcmResetStream(dmSoundCodec::HDecodeStream _stream)
+    {
+        PcmDecodeStream* stream = (PcmDecodeStream*)_stream;
+        stream->m_Cursor = 0;
+        return dmSoundCodec::RESULT_OK;
+    }
+
+    static dmSoundCodec::Result PcmSkipInStream(dmSoundCodec::HDecodeStream _stream, uint32_t bytes, uint32_t* skipped)
+    {
+        PcmDecodeStream* stream = (PcmDecodeStream*)_stream;
+        PcmCacheEntry* entry = stream->m_Entry;
+        if (stream->m_Cursor >= entry->m_FrameCount)
+        {
+            *skipped = 0;
+            return dmSoundCodec::RESULT_END_OF_STREAM;
+        }
+
+        uint32_t n = dmMath::Min(bytes / (uint32_t)sizeof(float), entry->m_FrameCount - stream->m_Cursor);
+        stream->m_Cursor += n;
+        *skipped = n * sizeof(float);
+        return dmSoundCodec::RESULT_OK;
+    }
+
+    static void PcmGetStreamInfo(dmSoundCodec::HDecodeStream _stream, dmSoundCodec::Info* out)
+    {
+        PcmDecodeStream* stream = (PcmDecodeStream*)_stream;
+        PcmCacheEntry* entry = stream->m_Entry;
+        out->m_Rate = entry->m_Rate;
+        out->m_Size = entry->m_Size;
+        out->m_Channels = entry->m_Channels;
+        out->m_BitsPerSample = 32;
+        out->m_IsInterleaved = false;
+    }
+
+    static int64_t PcmGetInternalPos(dmSoundCodec::HDecodeStream _stream)
+    {
+        return ((PcmDecodeStream*)_stream)->m_Cursor;
+    }
+
+    // Not registered with the codec, it's only used for the sounds in the PCM cache
+    static dmSoundCodec::DecoderInfo g_PcmDecoder = {
+        "PcmDecoder",
+        dmSoundCodec::FORMAT_WAV,
+        0,
+        PcmOpenStream,
+        PcmCloseStream,
+        PcmDecode,
+        PcmResetStream,
+        PcmSkipInStream,
+        PcmGetStreamInfo,
+        PcmGetInternalPos,
+        0,
+    };
+
+    // The instances, the decoders and the PCM cache entries are only created and deleted by the thread that initialized
+    // the sound system. Calls from other threads are rejected
+    static bool IsOwnerThread(SoundSystem* sound, const char* function)
+    {
+        if (!sound->m_Thread || sound->m_CommandThread == dmThread::GetCurrentThread())
+            return true;
+        dmLogError("%s must be called from the thread that initialized the sound system", function);
+        return false;
+    }
+
+    // The mixer only touches playing instances, and an instance doesn't start playing until the Play command is
+    // applied. So a new instance is set up without locking the mixer
+    Result NewSoundInstance(HSoundData sound_data, HSoundInstance* sound_instance)
+    {
+        SoundSystem* ss = g_SoundSystem;
+        *sound_instance = 0;
+        if (!IsOwnerThread(ss, __FUNCTION__))
+        {
+            return RESULT_INIT_ERROR;
+        }
+
+        dmSoundCodec::HDecoder decoder;
+
+        dmSoundCodec::Format codec_format = GetCodecFormat(sound_data->m_Type);
+
+        if (ss->m_InstancesPool.Remaining() == 0)
+        {
+            dmLogError("Out of sound data instance slots (%u). Increase the project setting 'sound.max_sound_instances'", ss->m_InstancesPool.Capacity());
+            return RESULT_OUT_OF_INSTANCES;
+        }
+
+        FillPcmCache(ss, sound_data, codec_format);
+
+        // Short compressed sounds are played from the decoded sound cache (see FillPcmCache())
+        bool pcm_cached = GetPcmCacheEntry(ss, sound_data) != 0;
+
+        dmSoundCodec::Result r;
+        if (pcm_cached)
+            r = dmSoundCodec::NewDecoder(ss->m_CodecContext, &g_PcmDecoder, sound_data, &decoder);
+        else
+            r = dmSoundCodec::NewDecoder(ss->m_CodecContext, codec_format, sound_data, &decoder);
+        if (r != dmSoundCodec::RESULT_OK) {
+            if (r == dmSoundCodec::RESULT_UNSUPPORTED) {
+                const char* name = dmHashReverseSafe64(sound_data->m_NameHash);
+                const char* format_str = dmSoundCodec::FormatToString(codec_format);
+                dmLogError("Sound '%s' uses %s, but no decoder was found. Ensure the codec is included in your App Manifest.", name, format_str);
+            } else {
+                dmLogError("Failed to decode sound %s: (%d)", dmHashReverseSafe64(sound_data->m_NameHash), r);
+            }
+            return RESULT_INVALID_STREAM_DATA;
+        }
+
+        uint16_t index = ss->m_InstancesPool.Pop();
+        DM_PROPERTY_SET_U32(rmtp_InstanceCount, ss->m_InstancesPool.Size());
+
+        sound_data->m_RefCount ++;
+
+        SoundInstance* si = &ss->m_Instances[index];
+        assert(si->m_Index == 0xffff);
+
+        si->m_SoundDataIndex = sound_data->m_Index;
+        si->m_Index = index;
+        si->m_Gain.Reset(1.0f);
+        si->m_Pan.Reset(0.5f);
+        for(uint32_t c=0; c<SOUND_MAX_DECODE_CHANNELS; ++c)
+        {
+            si->m_ScaleL[c].Reset(0.70711f);
+            si->m_ScaleR[c].Reset(0.70711f);
+        }
+        si->m_ScaleDirty = 1;
+        si->m_ScaleInit = 1;
+        si->m_Looping = 0;
+        si->m_EndOfStream = 0;
+        si->m_Playing = 0;
+        si->m_RequestedPlaying = 0;
+        si->m_PublishedPlaying = 0;
+        si->m_PendingCommands = 0;
+        si->m_QueuedCommands = 0;
+        si->m_Priority = 0;
+        si->m_PcmCached = pcm_cached;
+        si->m_Decoder = decoder;
+        si->m_Group = MASTER_GROUP_HASH;
+        si->m_DecodeAhead = ss->m_DecodeAhead && sound_data->m_Type != SOUND_DATA_TYPE_WAV && !pcm_cached;
+        ResetInstanceMixState(si);
+
+        *sound_instance = si;
+
+        return RESULT_OK;
+    }
+
+    static void StopNoLock(SoundSystem* sound, HSoundInstance sound_instance);
+    static void ApplyCommandsNoLock(SoundSystem* sound);
+
+    static void FreeSoundInstance(SoundSystem* sound, HSoundInstance sound_instance)
+    {
+        uint16_t index = sound_instance->m_Index;
+        sound->m_InstancesPool.Push(index);
+        DM_PROPERTY_SET_U32(rmtp_InstanceCount, sound->m_InstancesPool.Size());
+        sound_instance->m_Index = 0xffff;
+
+        // Only the last reference locks, to free the data and its cache entry
+        SoundData* sound_data = &sound->m_SoundData[sound_instance->m_SoundDataIndex];
+        if (sound_data->m_RefCount > 1)
+            sound_data->m_RefCount--;
+        else
+            DeleteSoundData(sound_data);
+        sound_instance->m_SoundDataIndex = 0xffff;
+        dmSoundCodec::DeleteDecoder(sound->m_CodecContext, sound_instance->m_Decoder);
+        sound_instance->m_Decoder = 0;
+        sound_instance->m_FrameCount = 0;
+        sound_instance->m_FrameFraction = 0;
+        sound_instance->m_Speed = 1.0f;
+        sound_instance->m_EndOfStream = 0;
+    }
+
+    Result DeleteSoundInstance(HSoundInstance sound_instance)
+    {
+        SoundSystem* sound = g_SoundSystem;
+        if (!IsOwnerThread(sound, __FUNCTION__))
+        {
+            return RESULT_INIT_ERROR;
+        }
+
+        // A stopped instance without queued commands isn't touched by the mixer (see NewSoundInstance())
+        if (dmAtomicGet32(&sound_instance->m_QueuedCommands) == 0 && !IsPlaying(sound_instance))
+        {
+            FreeSoundInstance(sound, sound_instance);
+            return RESULT_OK;
+        }
+
+        DM_MUTEX_OPTIONAL_SCOPED_LOCK(sound->m_Mutex);
+        ApplyCommandsNoLock(sound);
+
+        if (sound_instance->m_Playing)
+        {
+            dmLogError("Deleting playing sound instance (%s)", GetSoundName(sound, sound_instance));
+            StopNoLock(sound, sound_instance);
+        }
+
+        FreeSoundInstance(sound, sound_instance);
+        return RESULT_OK;
+    }
+
+    Result SetInstanceGroup(HSoundInstance instance, const char* group_name)
+    {
+        dmhash_t group_hash = dmHashString64(group_name);
+        return SetInstanceGroup(instance, group_hash);
+    }
+
+    static void PushCommand(SoundSystem* sound, const SoundCommand& command);
+
+    Result SetInstanceGroup(HSoundInstance instance, dmhash_t group_hash)
+    {
+        // The groups are only added by this thread, so the lookup doesn't need the lock
+        SoundSystem* sound = g_SoundSystem;
+        int* index = sound->m_GroupMap.Get(group_hash);
+        if (!index) {
+            return RESULT_NO_SUCH_GROUP;
+        }
+
+        SoundCommand command;
+        command.m_Type = SOUND_COMMAND_SET_GROUP;
+        command.m_Instance = instance;
+        command.m_Group = group_hash;
+        command.m_Value = 0.0f;
+        command.m_Parameter = 0;
+        PushCommand(sound, command);
+        return RESULT_OK;
+    }
+
+    Result AddGroup(const char* group)
+    {
+        DM_MUTEX_OPTIONAL_SCOPED_LOCK(g_SoundSystem->m_Mutex);
+        int index = GetOrCreateGroup(group);
+        if (index == -1) {
+            return RESULT_OUT_OF_GROUPS;
+        }
+        return RESULT_OK;
+    }
+
+    static void SetGroupGainNoLock(SoundSystem* sound, dmhash_t group_hash, float gain)
+    {
+        int* index = sound->m_GroupMap.Get(group_hash);
+        if (!index) {
+            return;
+        }
+
+        // If all playing sounds is currently at gain zero
+        // we can safely do a hard reset of the group gain
+        bool reset = true;
+        uint32_t instances = sound->m_Instances.Size();
+        for (uint32_t i = 0; i < instances; ++i)
+        {
+            SoundInstance* instance = &sound->m_Instances[i];
+            if (!instance->m_Playing || instance->m_Group != group_hash)
+            {
+                continue;
+            }
+            if (instance->m_Gain.m_Prev != 0.0)
+            {
+                reset = false;
+                break;
+            }
+        }
+        SoundGroup* group = &sound->m_Groups[*index];
+        group->m_Gain.Set(GainToScale(gain), reset);
+    }
+
+    Result SetGroupGain(dmhash_t group_hash, float gain)
+    {
+        SoundSystem* sound = g_SoundSystem;
+        // Groups are only added from this thread, so the map can be read without locking
+        int* index = sound->m_GroupMap.Get(group_hash);
+        if (!index) {
+            return RESULT_NO_SUCH_GROUP;
+        }
+        sound->m_Groups[*index].m_GainParameter = gain;
+
+        SoundCommand command;
+        command.m_Type = SOUND_COMMAND_SET_GROUP_GAIN;
+        command.m_Instance = 0;
+        command.m_Group = group_hash;
+        command.m_Value = gain;
+        command.m_Parameter = 0;
+        PushCommand(sound, command);
+        return RESULT_OK;
+    }
+
+    Result GetGroupGain(dmhash_t group_hash, float* gain)
+    {
+        // The gain parameter is only written by SetGroupGain(), from this thread
+        SoundSystem* sound = g_SoundSystem;
+        int* index = sound->m_GroupMap.Get(group_hash);
+        if (!index) {
+            return RESULT_NO_SUCH_GROUP;
+        }
+
+        SoundGroup* group = &sound->m_Groups[*index];
+        *gain = group->m_GainParameter;
+        return RESULT_OK;
+    }
+
     Result SetGroupMute(dmhash_t group_hash, bool mute)
     {
         if (!g_SoundSystem)
@@ -1165,7 +1912,7 @@ namespace dmSound
         SoundGroup* g = &sound->m_Groups[*index];
         uint32_t rms_frames = (uint32_t) (sound->m_MixRate * window);
         int left = rms_frames;
-        int ss_index = (g->m_NextMemorySlot - 1) % GROUP_MEMORY_BUFFER_COUNT;
+        int ss_index = (g->m_NextMemorySlot + GROUP_MEMORY_BUFFER_COUNT - 1) % GROUP_MEMORY_BUFFER_COUNT;
         float sum_sq_left = 0;
         float sum_sq_right = 0;
         int total_frame_count = 0;
@@ -1178,7 +1925,7 @@ namespace dmSound
 
             left -= frame_count;
             total_frame_count += frame_count;
-            ss_index = (ss_index - 1) % GROUP_MEMORY_BUFFER_COUNT;
+            ss_index = (ss_index + GROUP_MEMORY_BUFFER_COUNT - 1) % GROUP_MEMORY_BUFFER_COUNT;
         }
 
         *rms_left = sqrtf(sum_sq_left / (float) (total_frame_count)) / 32767.0f;
@@ -1207,7 +1954,7 @@ namespace dmSound
         SoundGroup* g = &sound->m_Groups[*index];
         uint32_t rms_frames = (uint32_t) (sound->m_MixRate * window);
         int left = rms_frames;
-        int ss_index = (g->m_NextMemorySlot - 1) % GROUP_MEMORY_BUFFER_COUNT;
+        int ss_index = (g->m_NextMemorySlot + GROUP_MEMORY_BUFFER_COUNT - 1) % GROUP_MEMORY_BUFFER_COUNT;
         float max_peak_left_sq = 0;
         float max_peak_right_sq = 0;
         while (left > 0) {
@@ -1218,7 +1965,7 @@ namespace dmSound
                 break;
 
             left -= frame_count;
-            ss_index = (ss_index - 1) % GROUP_MEMORY_BUFFER_COUNT;
+            ss_index = (ss_index + GROUP_MEMORY_BUFFER_COUNT - 1) % GROUP_MEMORY_BUFFER_COUNT;
         }
 
         *peak_left = sqrtf(max_peak_left_sq) / 32767.0f;
@@ -1227,10 +1974,21 @@ namespace dmSound
         return RESULT_OK;
     }
 
-    Result Play(HSoundInstance sound_instance)
+    static void PushInstanceCommand(SoundCommandType type, HSoundInstance sound_instance, float value)
     {
-        DM_MUTEX_OPTIONAL_SCOPED_LOCK(g_SoundSystem->m_Mutex);
-        sound_instance->m_Playing = 1;
+        SoundCommand command;
+        command.m_Type = type;
+        command.m_Instance = sound_instance;
+        command.m_Group = 0;
+        command.m_Value = value;
+        command.m_Parameter = 0;
+        PushCommand(g_SoundSystem, command);
+    }
+
+    Result Play(HSoundInstance sound_instance)
+    {
+        sound_instance->m_RequestedPlaying = 1;
+        PushInstanceCommand(SOUND_COMMAND_PLAY, sound_instance, 0.0f);
         return RESULT_OK;
     }
 
@@ -1244,8 +2002,8 @@ namespace dmSound
 
     Result Stop(HSoundInstance sound_instance)
     {
-        DM_MUTEX_OPTIONAL_SCOPED_LOCK(g_SoundSystem->m_Mutex);
-        StopNoLock(g_SoundSystem, sound_instance);
+        sound_instance->m_RequestedPlaying = 0;
+        PushInstanceCommand(SOUND_COMMAND_STOP, sound_instance, 0.0f);
         return RESULT_OK;
     }
 
@@ -1253,8 +2011,8 @@ namespace dmSound
     {
         if (!g_SoundSystem)
             return RESULT_OK;
-        DM_MUTEX_OPTIONAL_SCOPED_LOCK(g_SoundSystem->m_Mutex);
-        sound_instance->m_Playing = (uint8_t)!pause;
+        sound_instance->m_RequestedPlaying = !pause;
+        PushInstanceCommand(SOUND_COMMAND_PAUSE, sound_instance, pause ? 1.0f : 0.0f);
         return RESULT_OK;
     }
 
@@ -1269,15 +2027,30 @@ namespace dmSound
 
     bool IsPlaying(HSoundInstance sound_instance)
     {
-        DM_MUTEX_OPTIONAL_SCOPED_LOCK(g_SoundSystem->m_Mutex);
-        return sound_instance->m_Playing;
+        if (!g_SoundSystem->m_Thread)
+            return sound_instance->m_Playing;
+
+        // Until the mixer has applied them, the state is the one requested by the queued commands
+        if (dmAtomicGet32(&sound_instance->m_PendingCommands) > 0)
+            return sound_instance->m_RequestedPlaying;
+        return dmAtomicGet32(&sound_instance->m_PublishedPlaying) != 0;
     }
 
     Result SetLooping(HSoundInstance sound_instance, bool looping, int8_t loopcounter)
     {
-        DM_MUTEX_OPTIONAL_SCOPED_LOCK(g_SoundSystem->m_Mutex);
-        sound_instance->m_Looping = (uint32_t) looping;
-        sound_instance->m_Loopcounter = loopcounter;
+        SoundCommand command;
+        command.m_Type = SOUND_COMMAND_SET_LOOPING;
+        command.m_Instance = sound_instance;
+        command.m_Group = 0;
+        command.m_Value = (float)loopcounter;
+        command.m_Parameter = (uint8_t)looping;
+        PushCommand(g_SoundSystem, command);
+        return RESULT_OK;
+    }
+
+    Result SetPriority(HSoundInstance sound_instance, uint8_t priority)
+    {
+        PushInstanceCommand(SOUND_COMMAND_SET_PRIORITY, sound_instance, (float)priority);
         return RESULT_OK;
     }
 
@@ -1289,14 +2062,14 @@ namespace dmSound
         *right_scale = sinf(theta);
     }
 
-    Result SetParameter(HSoundInstance sound_instance, Parameter parameter, const Vector4& value)
+    static void SetParameterNoLock(HSoundInstance sound_instance, Parameter parameter, float value)
     {
         bool reset = !sound_instance->m_Playing;
         switch(parameter)
         {
             case PARAMETER_GAIN:
                 {
-                    sound_instance->m_Gain.Set(GainToScale(value.getX()), reset);
+                    sound_instance->m_Gain.Set(GainToScale(value), reset);
                     // Trigger volume scale updates as soon as we know how many channels the instance has
                     // (we might not have that info initially)
                     sound_instance->m_ScaleDirty = 1;
@@ -1304,7 +2077,7 @@ namespace dmSound
                 break;
             case PARAMETER_PAN:
                 {
-                    float pan = dmMath::Max(-1.0f, dmMath::Min(1.0f, value.getX()));
+                    float pan = dmMath::Max(-1.0f, dmMath::Min(1.0f, value));
                     pan = (pan + 1.0f) * 0.5f; // map [-1,1] to [0,1] for easier calculations later
                     sound_instance->m_Pan.Set(pan, reset);
                     // Trigger volume scale updates as soon as we know how many channels the instance has
@@ -1313,26 +2086,155 @@ namespace dmSound
                 }
                 break;
             case PARAMETER_SPEED:
-                sound_instance->m_Speed = dmMath::Max(0.0f, dmMath::Min((float)SOUND_MAX_SPEED, value.getX()));
+                sound_instance->m_Speed = dmMath::Max(0.0f, dmMath::Min((float)SOUND_MAX_SPEED, value));
                 break;
             default:
-                dmLogError("Invalid parameter: %d (%s)\n", parameter, GetSoundName(g_SoundSystem, sound_instance));
-                return RESULT_INVALID_PROPERTY;
+                break;
         }
+    }
+
+    Result SetParameter(HSoundInstance sound_instance, Parameter parameter, const Vector4& value)
+    {
+        if (parameter != PARAMETER_GAIN && parameter != PARAMETER_PAN && parameter != PARAMETER_SPEED)
+        {
+            dmLogError("Invalid parameter: %d (%s)\n", parameter, GetSoundName(g_SoundSystem, sound_instance));
+            return RESULT_INVALID_PROPERTY;
+        }
+
+        SoundCommand command;
+        command.m_Type = SOUND_COMMAND_SET_PARAMETER;
+        command.m_Instance = sound_instance;
+        command.m_Group = 0;
+        command.m_Value = value.getX();
+        command.m_Parameter = (uint8_t)parameter;
+        PushCommand(g_SoundSystem, command);
         return RESULT_OK;
     }
 
+    static inline bool IsPlayCommand(uint8_t type)
+    {
+        return type == SOUND_COMMAND_PLAY || type == SOUND_COMMAND_STOP || type == SOUND_COMMAND_PAUSE;
+    }
+
+    static void ApplyCommand(SoundSystem* sound, const SoundCommand& command)
+    {
+        SoundInstance* instance = command.m_Instance;
+        switch (command.m_Type)
+        {
+            case SOUND_COMMAND_PLAY:
+                instance->m_Playing = 1;
+                break;
+            case SOUND_COMMAND_STOP:
+                StopNoLock(sound, instance);
+                break;
+            case SOUND_COMMAND_PAUSE:
+                instance->m_Playing = command.m_Value == 0.0f;
+                break;
+            case SOUND_COMMAND_SET_PARAMETER:
+                SetParameterNoLock(instance, (Parameter)command.m_Parameter, command.m_Value);
+                break;
+            case SOUND_COMMAND_SET_GROUP_GAIN:
+                SetGroupGainNoLock(sound, command.m_Group, command.m_Value);
+                return;
+            case SOUND_COMMAND_SET_GROUP:
+                instance->m_Group = command.m_Group;
+                break;
+            case SOUND_COMMAND_SET_LOOPING:
+                instance->m_Looping = command.m_Parameter;
+                instance->m_Loopcounter = (int8_t)command.m_Value;
+                break;
+            case SOUND_COMMAND_SET_PRIORITY:
+                instance->m_Priority = (uint8_t)command.m_Value;
+                break;
+        }
+
+        if (IsPlayCommand(command.m_Type))
+        {
+            dmAtomicStore32(&instance->m_PublishedPlaying, instance->m_Playing);
+            dmAtomicDecrement32(&instance->m_PendingCommands);
+        }
+        // A full barrier, so the instance isn't deleted before the mixer is done with it
+        dmAtomicDecrement32(&instance->m_QueuedCommands);
+    }
+
+    // Called by the mixer at the start of each mix period, and by api calls that need the queued changes applied first
+    static void ApplyCommandsNoLock(SoundSystem* sound)
+    {
+        // The instances may still be decoded by the jobs started after the last mix
+        WaitForDecodeAheadNoLock(sound);
+
+        uint32_t read = (uint32_t)dmAtomicGet32(&sound->m_CommandRead);
+        uint32_t write = (uint32_t)dmAtomicGet32(&sound->m_CommandWrite);
+        if (read == write)
+            return;
+
+        DM_PROFILE(__FUNCTION__);
+        for (uint32_t i = read; i != write; ++i)
+        {
+            ApplyCommand(sound, sound->m_Commands[i & (SOUND_COMMAND_QUEUE_SIZE - 1)]);
+        }
+        // A full barrier, so the slots aren't reused by the caller before the commands are read
+        dmAtomicAdd32(&sound->m_CommandRead, (int32_t)(write - read));
+    }
+
+    // Queues a change for the mixer thread, so that the caller doesn't wait for the mix period to finish
+    static void PushCommand(SoundSystem* sound, const SoundCommand& command)
+    {
+        if (command.m_Instance)
+        {
+            dmAtomicIncrement32(&command.m_Instance->m_QueuedCommands);
+            if (IsPlayCommand(command.m_Type))
+            {
+                dmAtomicIncrement32(&command.m_Instance->m_PendingCommands);
+            }
+        }
+
+        if (!sound->m_Thread)
+        {
+            WaitForDecodeAheadNoLock(sound);
+            ApplyCommand(sound, command);
+            return;
+        }
+
+        // The queue has a single producer, the thread that initialized the sound system.
+        // Calls from other threads are applied directly, holding the lock (in order, after the queued commands)
+        if (sound->m_CommandThread != dmThread::GetCurrentThread())
+        {
+            DM_MUTEX_SCOPED_LOCK(sound->m_Mutex);
+            ApplyCommandsNoLock(sound);
+            ApplyCommand(sound, command);
+            return;
+        }
+
+        uint32_t write = (uint32_t)dmAtomicGet32(&sound->m_CommandWrite);
+        uint32_t read = (uint32_t)dmAtomicGet32(&sound->m_CommandRead);
+        if (write - read >= SOUND_COMMAND_QUEUE_SIZE)
+        {
+            // The queue is full, apply the commands here instead
+            DM_MUTEX_SCOPED_LOCK(sound->m_Mutex);
+            ApplyCommandsNoLock(sound);
+            ApplyCommand(sound, command);
+            return;
+        }
+
+        sound->m_Commands[write & (SOUND_COMMAND_QUEUE_SIZE - 1)] = command;
+        // A full barrier, so the command is written before the mixer sees it
+        dmAtomicIncrement32(&sound->m_CommandWrite);
+    }
+
     static inline uint32_t GetSkipStrideBytes(const dmSoundCodec::Info& info)
     {
         return GetDecoderOutputStrideBytes(info);
     }
 
-    static Result SkipToStartFrameNoLock(HSoundInstance sound_instance, uint64_t start_frame)
+    static Result SkipDecoderFrames(HSoundInstance sound_instance, uint64_t start_frame)
     {
-        DM_PROFILE(__FUNCTION__);
         dmSoundCodec::Info info;
         dmSoundCodec::GetInfo(g_SoundSystem->m_CodecContext, sound_instance->m_Decoder, &info);
 
+        // Any frames decoded ahead are from before the new start frame
+        ResetDecodeAhead(sound_instance);
+
         uint64_t total_bytes = start_frame * (uint64_t)GetSkipStrideBytes(info);
         while (total_bytes > 0)
         {
@@ -1355,11 +2257,25 @@ namespace dmSound
         return RESULT_OK;
     }
 
+    static Result SkipToStartFrameNoLock(HSoundInstance sound_instance, uint64_t start_frame)
+    {
+        DM_PROFILE(__FUNCTION__);
+        if (sound_instance->m_Virtual)
+        {
+            // The decoder is moved when the voice is real again
+            sound_instance->m_VirtualFrame += start_frame;
+            return RESULT_OK;
+        }
+
+        return SkipDecoderFrames(sound_instance, start_frame);
+    }
+
     Result SetStartFrame(HSoundInstance sound_instance, uint32_t start_frame)
     {
         if (!g_SoundSystem)
             return RESULT_OK;
         DM_MUTEX_OPTIONAL_SCOPED_LOCK(g_SoundSystem->m_Mutex);
+        ApplyCommandsNoLock(g_SoundSystem);
         return SkipToStartFrameNoLock(sound_instance, (uint64_t)start_frame);
     }
 
@@ -1370,6 +2286,7 @@ namespace dmSound
         if (start_time_seconds <= 0.0f)
             return RESULT_OK;
         DM_MUTEX_OPTIONAL_SCOPED_LOCK(g_SoundSystem->m_Mutex);
+        ApplyCommandsNoLock(g_SoundSystem);
 
         dmSoundCodec::Info info;
         dmSoundCodec::GetInfo(g_SoundSystem->m_CodecContext, sound_instance->m_Decoder, &info);
@@ -1520,300 +2437,795 @@ namespace dmSound
         MixResample(mix_context, instance, info, delta, group->m_MixBuffer, mix_count, avail_frames);
     }
 
-    static bool IsMuted(SoundInstance* instance) {
-        SoundSystem* sound = g_SoundSystem;
+    // Called at the end of the stream. Rewinds the decoder and returns true if the sound should loop
+    static bool LoopInstance(SoundSystem* sound, SoundInstance* instance)
+    {
+        if (!instance->m_Looping || instance->m_Loopcounter == 0)
+        {
+            return false;
+        }
+
+        dmSoundCodec::Reset(sound->m_CodecContext, instance->m_Decoder);
+        if ( instance->m_Loopcounter > 0 )
+        {
+            instance->m_Loopcounter --;
+        }
+        return true;
+    }
+
+    static bool IsMuted(SoundInstance* instance) {
+        SoundSystem* sound = g_SoundSystem;
+
+        if (instance->m_Gain.IsZero()) {
+            return true;
+        }
+
+        if (instance->m_Speed == 0.0f) {
+            return true;
+        }
+
+        int* group_index = sound->m_GroupMap.Get(instance->m_Group);
+        if (group_index != NULL) {
+            SoundGroup* group = &sound->m_Groups[*group_index];
+            if (group->m_IsMuted || group->m_Gain.IsZero()) {
+                return true;
+            }
+        }
+
+        int* master_index = sound->m_GroupMap.Get(MASTER_GROUP_HASH);
+        if (master_index != NULL) {
+            SoundGroup* master = &sound->m_Groups[*master_index];
+            if (master->m_IsMuted || master->m_Gain.IsZero()) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    static inline void MixInstance(const MixContext* mix_context, SoundInstance* instance)
+    {
+        DM_PROFILE(__FUNCTION__);
+        SoundSystem* sound = g_SoundSystem;
+
+        dmSoundCodec::Info info;
+        dmSoundCodec::GetInfo(sound->m_CodecContext, instance->m_Decoder, &info);
+
+        // TODO: Move this check to the NewSoundInstance
+        bool correct_bit_depth = info.m_BitsPerSample == 32 || info.m_BitsPerSample == 16 || info.m_BitsPerSample == 8;
+        bool correct_num_channels = info.m_Channels == 1 || info.m_Channels == 2;
+        if (!correct_bit_depth || !correct_num_channels) {
+            dmLogError("Only mono/stereo with 8/16/32 bits per sample is supported (%s): %u bpp %u ch", GetSoundName(sound, instance), (uint32_t)info.m_BitsPerSample, (uint32_t)info.m_Channels);
+            instance->m_Playing = 0;
+            return;
+        }
+
+        SoundGroup* group = nullptr;
+        int* index = sound->m_GroupMap.Get(instance->m_Group);
+        if (index) {
+            group = &sound->m_Groups[*index];
+        } else {
+            dmLogError("Sound group not found");
+            return;
+        }
+
+        bool is_muted = dmSound::IsMuted(instance);
+
+        dmSoundCodec::Result r = dmSoundCodec::RESULT_OK;
+
+        // Compute how many input samples we will need to produce the requested output samples
+        uint64_t delta = GetResampleDelta(info, sound->m_MixRate, instance->m_Speed);
+        if (delta == 0) {
+            // very low speed settings can get the delta to be zero due to precision limits - we skip the mixing as resulting rates are also (alsmost) inaudibly low as a result
+            return;
+        }
+
+        uint64_t required_decoder_frame_capacity = GetRequiredDecodedFrameCapacity(delta, mix_context->m_FrameCount);
+        if (required_decoder_frame_capacity > 0xffffffffU)
+        {
+            dmLogError("Decoder scratch buffer too large for '%s'", GetSoundName(sound, instance));
+            instance->m_Playing = 0;
+            return;
+        }
+
+        Result capacity_result = EnsureDecoderScratchBufferSize(sound, info, (uint32_t)required_decoder_frame_capacity);
+        if (capacity_result != RESULT_OK)
+        {
+            dmLogError("Failed to grow decoder scratch buffer for '%s': %d", GetSoundName(sound, instance), capacity_result);
+            instance->m_Playing = 0;
+            return;
+        }
+
+        uint64_t required_state_frame_capacity = GetRequiredStateFrameCapacity(delta);
+        if (required_state_frame_capacity > 0xffffffffU)
+        {
+            dmLogError("Instance frame buffer too large for '%s'", GetSoundName(sound, instance));
+            instance->m_Playing = 0;
+            return;
+        }
+
+        capacity_result = EnsureInstanceFrameBufferSize(instance, (uint32_t)required_state_frame_capacity);
+        if (capacity_result != RESULT_OK)
+        {
+            dmLogError("Failed to grow instance frame buffer for '%s': %d", GetSoundName(sound, instance), capacity_result);
+            instance->m_Playing = 0;
+            return;
+        }
+
+        uint32_t mixed_instance_frame_count = (uint32_t)((instance->m_FrameFraction + mix_context->m_FrameCount * delta + ((1UL << RESAMPLE_FRACTION_BITS) - 1)) >> RESAMPLE_FRACTION_BITS) + SOUND_MAX_FUTURE;
+
+        // Compute initial amount of samples in temp buffer once we restore per instance state prior to actual mixing
+        uint32_t initial_frame_count = (instance->m_FrameCount > SOUND_MAX_HISTORY) ? (instance->m_FrameCount - SOUND_MAX_HISTORY) : 0;
+        uint32_t frame_count = initial_frame_count;
+        uint32_t new_frame_count = 0;
+
+        void* decoder_temp = sound->m_DecoderTempOutput;
+
+        //
+        // Refill as needed...
+        //
+        if (frame_count < mixed_instance_frame_count && instance->m_Playing && instance->m_DecodeAhead) {
+
+            // The frames were decoded and converted by DecodeAhead(), before the mix
+            uint32_t n = dmMath::Min(mixed_instance_frame_count - frame_count, instance->m_AheadCount);
+            for(uint32_t c=0; c<info.m_Channels; ++c)
+            {
+                memcpy(sound->GetDecoderBufferBase(c) + frame_count, instance->m_AheadFrames[c] + instance->m_AheadStart, n * sizeof(float));
+            }
+            instance->m_AheadStart += n;
+            instance->m_AheadCount -= n;
+            frame_count += n;
+
+            r = instance->m_AheadResult;
+            if (r != dmSoundCodec::RESULT_OK)
+            {
+                dmLogWarning("Unable to decode file '%s': %s %d", GetSoundName(sound, instance), dmSoundCodec::ResultToString(r), r);
+                instance->m_Playing = 0;
+                return;
+            }
+
+            if (frame_count < mixed_instance_frame_count && instance->m_AheadEndOfStream)
+            {
+                // Sound ends...
+                instance->m_EndOfStream = 1;
+            }
+        }
+        else if (frame_count < mixed_instance_frame_count && instance->m_Playing) {
+
+            bool is_direct_delivery = (info.m_BitsPerSample == 32 && (!info.m_IsInterleaved || info.m_Channels == 1));
+
+            const uint32_t stride = !is_direct_delivery ? GetDecoderOutputStrideBytes(info) : (uint32_t)sizeof(float);
+
+            while(frame_count < mixed_instance_frame_count)
+            {
+                uint32_t n = mixed_instance_frame_count - frame_count; // if the result contains a fractional part and we don't ceil(), we'll end up with a smaller number. Later, when deciding the mix_count in Mix(), a smaller value (integer) will be produced. This will result in leaving a small gap in the mix buffer resulting in sound crackling when the chunk changes.
+
+                char* buffer[SOUND_MAX_DECODE_CHANNELS];
+                uint32_t buffer_size;
+                if (!is_direct_delivery)
+                {
+                    // Output is non-float and/or interleaved and needs post output conversion
+                    buffer[0] = ((char*) decoder_temp) + new_frame_count * stride;
+                }
+                else
+                {
+                    // Output will be either single channel or non-interleaved in float format -> we can just have it delivered into our work buffers
+                    for(uint32_t c=0; c<info.m_Channels; ++c)
+                    {
+                        buffer[c] = (char*)(sound->GetDecoderBufferBase(c) + frame_count);
+                    }
+                }
+                buffer_size = n * stride;
+
+                uint32_t decoded = 0;
+                if (!is_muted)
+                {
+                    r = dmSoundCodec::Decode(sound->m_CodecContext, instance->m_Decoder, buffer, buffer_size, &decoded);
+                }
+                else
+                {
+                    r = dmSoundCodec::Skip(sound->m_CodecContext, instance->m_Decoder, buffer_size, &decoded);
+//TODO: COULD WE NOT AVOID MIXING ANYTHING IN THIS CASE?
+                    uint32_t nc = info.m_IsInterleaved ? 1 : info.m_Channels;
+                    for(uint32_t c=0; c<nc; ++c)
+                    {
+                        memset(buffer[c], 0x00, decoded);
+                    }
+                }
+
+                if (r == dmSoundCodec::RESULT_OK)
+                {
+                    if (decoded == 0) // we might be streaming and didn't get any content
+                    {
+                        break; // Need to break as we're not progressing this sound instance
+                    }
+
+                    frame_count += decoded / stride;
+                    new_frame_count += decoded / stride;
+                }
+                else if (r == dmSoundCodec::RESULT_END_OF_STREAM)
+                {
+                    assert(decoded == 0);
+
+                    if (!LoopInstance(sound, instance))
+                    {
+                        // Sound ends...
+                        instance->m_EndOfStream = 1;
+                        break;
+                    }
+                }
+                else
+                {
+                    // error case
+                    break;
+                }
+            }
+
+            if (r != dmSoundCodec::RESULT_OK && r != dmSoundCodec::RESULT_END_OF_STREAM)
+            {
+                dmLogWarning("Unable to decode file '%s': %s %d", GetSoundName(sound, instance), dmSoundCodec::ResultToString(r), r);
+                instance->m_Playing = 0;
+                return;
+            }
+        }
+
+        if (frame_count > 0)
+        {
+            //
+            // Convert decoded data as needed...
+            //
+            if (new_frame_count > 0)
+            {
+                float* out[] = {sound->GetDecoderBufferBase(0) + initial_frame_count,
+                                sound->GetDecoderBufferBase(1) + initial_frame_count};
+                ConvertDecodedFrames(info, decoder_temp, out, new_frame_count);
+            }
+
+            //
+            // Ensure proper "future" data (close to end of stream)
+            //
+            if (frame_count < mixed_instance_frame_count)
+            {
+                // We generated fewer samples then we asked for. Make sure we can still mix all "real" samples, by ensuring we have enough "future" sample values in any case
+                // (should only trigger at the end of samples)
+                uint32_t missing_frames = dmMath::Min(mixed_instance_frame_count - frame_count, (uint32_t)SOUND_MAX_FUTURE);
+
+                for(uint32_t c=0; c<info.m_Channels; ++c)
+                {
+                    float* decoder_output_buffer = sound->GetDecoderBufferBase(c);
+                    float last = decoder_output_buffer[frame_count - 1];
+                    uint32_t fc = frame_count;
+                    for(uint32_t mi=missing_frames; mi > 0; --mi)
+                    {
+                        decoder_output_buffer[fc++] = last;
+                    }
+                }
+                frame_count += missing_frames;
+            }
+
+            //
+            // Mix the data
+            //
+            assert(frame_count > SOUND_MAX_FUTURE);
+            Mix(mix_context, instance, delta, frame_count - SOUND_MAX_FUTURE, &info, group);
+        }
+
+        if (instance->m_EndOfStream) {
+            instance->m_Playing = 0;
+        }
+    }
+
+    // The number of frames in the sound of an instance, from the headers of the sound file. 0 if unknown, e.g. for streamed sounds
+    static uint32_t GetInstanceFrameCount(SoundSystem* sound, SoundInstance* instance, const dmSoundCodec::Info& info)
+    {
+        if (instance->m_PcmCached)
+        {
+            return info.m_Size / (info.m_Channels * sizeof(float));
+        }
+
+        return GetSoundDataFrameCount(&sound->m_SoundData[instance->m_SoundDataIndex], info);
+    }
+
+    // Replaces the decoder position with a frame cursor, that is advanced without decoding (see AdvanceVirtualInstance()).
+    // Returns false if the voice can't be virtual, since the position in the sound can't be tracked without the decoder
+    static bool BeginVirtual(SoundSystem* sound, SoundInstance* instance)
+    {
+        dmSoundCodec::Info info;
+        dmSoundCodec::GetInfo(sound->m_CodecContext, instance->m_Decoder, &info);
+
+        uint32_t frame_count = GetInstanceFrameCount(sound, instance, info);
+        int64_t decoder_frame = dmSoundCodec::GetInternalPos(sound->m_CodecContext, instance->m_Decoder);
+        if (frame_count == 0 || decoder_frame < 0)
+        {
+            return false;
+        }
+
+        // The frames decoded, but not yet mixed, are decoded again when the voice is real
+        uint32_t buffered = instance->m_AheadCount;
+        if (instance->m_FrameCount > SOUND_MAX_HISTORY)
+        {
+            buffered += instance->m_FrameCount - SOUND_MAX_HISTORY;
+        }
+
+        instance->m_VirtualFrame = (uint64_t)dmMath::Max(decoder_frame - (int64_t)buffered, (int64_t)0);
+        instance->m_VirtualFrameCount = frame_count;
+        instance->m_VirtualLooped = 0;
+        instance->m_Virtual = 1;
+        ResetDecodeAhead(instance);
+        // The frames kept for the resampler are stale by the time the voice is mixed again
+        ResetInstanceHistory(instance);
+        return true;
+    }
+
+    // Moves the decoder to the frame cursor of the virtual voice. The compressed decoders can't seek, so they decode and discard
+    // at most SOUND_VIRTUAL_CATCHUP_PERIODS mix periods per call, and the voice stays virtual until the decoder has caught up
+    static void EndVirtual(SoundSystem* sound, SoundInstance* instance)
+    {
+        DM_PROFILE(__FUNCTION__);
+
+        int64_t decoder_frame = dmSoundCodec::GetInternalPos(sound->m_CodecContext, instance->m_Decoder);
+        if (decoder_frame < 0 || instance->m_VirtualLooped)
+        {
+            // The cursor is behind the decoder, so we skip from the start
+            dmSoundCodec::Reset(sound->m_CodecContext, instance->m_Decoder);
+            instance->m_VirtualLooped = 0;
+            decoder_frame = 0;
+        }
+        else if ((uint64_t)decoder_frame > instance->m_VirtualFrame)
+        {
+            // The cursor is still within the frames that were decoded before the voice became virtual (see BeginVirtual()).
+            // Rather than decoding them again from the start, we continue at the decoder, slightly ahead
+            instance->m_VirtualFrame = (uint64_t)decoder_frame;
+        }
+
+        uint64_t skip_frames = instance->m_VirtualFrame - (uint64_t)decoder_frame;
+        bool caught_up = true;
+        if (!instance->m_PcmCached && sound->m_SoundData[instance->m_SoundDataIndex].m_Type != SOUND_DATA_TYPE_WAV)
+        {
+            dmSoundCodec::Info info;
+            dmSoundCodec::GetInfo(sound->m_CodecContext, instance->m_Decoder, &info);
+            uint64_t max_skip_frames = (uint64_t)SOUND_VIRTUAL_CATCHUP_PERIODS * sound->m_FrameCount * info.m_Rate / sound->m_MixRate;
+            if (skip_frames > max_skip_frames)
+            {
+                skip_frames = max_skip_frames;
+                caught_up = false;
+            }
+        }
+
+        if (SkipDecoderFrames(instance, skip_frames) != RESULT_OK)
+        {
+            dmLogWarning("Unable to skip in file '%s'", GetSoundName(sound, instance));
+            instance->m_Playing = 0;
+        }
+
+        if (caught_up)
+        {
+            instance->m_Virtual = 0;
+        }
+    }
+
+    // Advances the play cursor of a virtual voice, as if it was mixed. The decoder isn't used until the voice is real again (see EndVirtual())
+    static void AdvanceVirtualInstance(const MixContext* mix_context, SoundInstance* instance)
+    {
+        SoundSystem* sound = g_SoundSystem;
+
+        dmSoundCodec::Info info;
+        dmSoundCodec::GetInfo(sound->m_CodecContext, instance->m_Decoder, &info);
+
+        uint64_t delta = GetResampleDelta(info, sound->m_MixRate, instance->m_Speed);
+        if (delta == 0) {
+            return;
+        }
+
+        uint64_t position = instance->m_FrameFraction + mix_context->m_FrameCount * delta;
+        instance->m_FrameFraction = position & ((1ULL << RESAMPLE_FRACTION_BITS) - 1);
+        instance->m_VirtualFrame += position >> RESAMPLE_FRACTION_BITS;
+
+        const uint64_t frame_count = instance->m_VirtualFrameCount;
+        while (instance->m_VirtualFrame >= frame_count)
+        {
+            if (!instance->m_Looping || instance->m_Loopcounter == 0)
+            {
+                instance->m_VirtualFrame = frame_count;
+                instance->m_Playing = 0;
+                return;
+            }
+
+            instance->m_VirtualFrame -= frame_count;
+            instance->m_VirtualLooped = 1;
+            if (instance->m_Loopcounter > 0)
+            {
+                instance->m_Loopcounter--;
+            }
+        }
+    }
+
+    static float GetAudibility(SoundSystem* sound, SoundInstance* instance)
+    {
+        if (IsMuted(instance)) {
+            return 0.0f;
+        }
+
+        // A voice that is fading out stays real until the end of the ramp, to avoid a click
+        float gain = instance->m_Gain.GetMax();
+        int* group_index = sound->m_GroupMap.Get(instance->m_Group);
+        if (group_index != NULL) {
+            gain *= sound->m_Groups[*group_index].m_Gain.GetMax();
+        }
+        return gain;
+    }
+
+    struct VoicePriorityPred
+    {
+        bool operator()(const SoundInstance* a, const SoundInstance* b) const
+        {
+            if (a->m_Priority != b->m_Priority)
+                return a->m_Priority > b->m_Priority;
+            if (a->m_Audibility != b->m_Audibility)
+                return a->m_Audibility > b->m_Audibility;
+            // Keep the current real voices, to avoid switching back and forth between equal voices
+            if (a->m_Virtual != b->m_Virtual)
+                return !a->m_Virtual;
+            return a->m_Index < b->m_Index;
+        }
+    };
+
+    // Returns true if the voice is virtual
+    static bool SetVirtual(SoundSystem* sound, SoundInstance* instance, bool is_virtual)
+    {
+        if (instance->m_Virtual != is_virtual)
+        {
+            if (is_virtual)
+                BeginVirtual(sound, instance);
+            else
+                EndVirtual(sound, instance);
+        }
+        return instance->m_Virtual;
+    }
+
+    // Picks the voices to mix: the audible ones, by priority and then gain, up to the max number of real voices.
+    // The other voices are virtual, until they become audible or a real voice is freed.
+    // Voices with an unknown length (e.g. streamed sounds) are always real
+    static void SelectRealVoices(SoundSystem* sound)
+    {
+        if (sound->m_MaxRealVoices == 0)
+        {
+            return;
+        }
+
+        DM_PROFILE(__FUNCTION__);
+
+        dmArray<SoundInstance*>& voices = sound->m_Voices;
+        voices.SetSize(0);
+        uint32_t virtual_count = 0;
+        for (uint32_t i = 0; i < sound->m_Instances.Size(); ++i)
+        {
+            SoundInstance* instance = &sound->m_Instances[i];
+            if (!instance->m_Playing || instance->m_Index == 0xffff)
+            {
+                continue;
+            }
+
+            instance->m_Audibility = GetAudibility(sound, instance);
+            if (instance->m_Audibility <= SOUND_INAUDIBLE_GAIN && SetVirtual(sound, instance, true))
+            {
+                ++virtual_count;
+                continue;
+            }
+            voices.Push(instance);
+        }
+
+        if (voices.Size() > sound->m_MaxRealVoices)
+        {
+            std::sort(voices.Begin(), voices.End(), VoicePriorityPred());
+        }
+
+        uint32_t real_count = 0;
+        for (uint32_t i = 0; i < voices.Size(); ++i)
+        {
+            if (SetVirtual(sound, voices[i], i >= sound->m_MaxRealVoices))
+                ++virtual_count;
+            else
+                ++real_count;
+        }
+
+        DM_PROPERTY_SET_U32(rmtp_RealVoiceCount, real_count);
+        DM_PROPERTY_SET_U32(rmtp_VirtualVoiceCount, virtual_count);
+    }
+
+    // Tops up the decoded frames of an instance. Called from the worker threads, so it only touches the instance and its decoder
+    static void DecodeAheadInstance(SoundSystem* sound, SoundInstance* instance)
+    {
+        DM_PROFILE_DYN(GetSoundName(sound, instance), 0);
+
+        dmSoundCodec::Info info;
+        dmSoundCodec::GetInfo(sound->m_CodecContext, instance->m_Decoder, &info);
+
+        bool is_direct_delivery = (info.m_BitsPerSample == 32 && (!info.m_IsInterleaved || info.m_Channels == 1));
+        const uint32_t stride = !is_direct_delivery ? GetDecoderOutputStrideBytes(info) : (uint32_t)sizeof(float);
+
+        // Move the unconsumed frames to the front of the buffer
+        if (instance->m_AheadStart > 0)
+        {
+            for(uint32_t c=0; c<info.m_Channels; ++c)
+            {
+                memmove(instance->m_AheadFrames[c], instance->m_AheadFrames[c] + instance->m_AheadStart, instance->m_AheadCount * sizeof(float));
+            }
+            instance->m_AheadStart = 0;
+        }
+
+        dmSoundCodec::Result r = dmSoundCodec::RESULT_OK;
+        uint32_t frame_count = instance->m_AheadCount;
+        while (frame_count < instance->m_AheadTarget)
+        {
+            uint32_t n = instance->m_AheadTarget - frame_count;
+
+            char* buffer[SOUND_MAX_DECODE_CHANNELS];
+            if (!is_direct_delivery)
+            {
+                buffer[0] = (char*)instance->m_AheadTemp;
+            }
+            else
+            {
+                for(uint32_t c=0; c<info.m_Channels; ++c)
+                {
+                    buffer[c] = (char*)(instance->m_AheadFrames[c] + frame_count);
+                }
+            }
+            uint32_t buffer_size = n * stride;
+
+            uint32_t decoded = 0;
+            if (!instance->m_AheadMuted)
+            {
+                r = dmSoundCodec::Decode(sound->m_CodecContext, instance->m_Decoder, buffer, buffer_size, &decoded);
+            }
+            else
+            {
+                r = dmSoundCodec::Skip(sound->m_CodecContext, instance->m_Decoder, buffer_size, &decoded);
+                uint32_t nc = info.m_IsInterleaved ? 1 : info.m_Channels;
+                for(uint32_t c=0; c<nc; ++c)
+                {
+                    memset(buffer[c], 0x00, decoded);
+                }
+            }
+
+            if (r == dmSoundCodec::RESULT_OK)
+            {
+                if (decoded == 0)
+                {
+                    break;
+                }
+
+                uint32_t new_frame_count = decoded / stride;
+                if (!is_direct_delivery)
+                {
+                    float* out[] = {instance->m_AheadFrames[0] + frame_count,
+                                    instance->m_AheadFrames[1] + frame_count};
+                    ConvertDecodedFrames(info, instance->m_AheadTemp, out, new_frame_count);
+                }
+                frame_count += new_frame_count;
+            }
+            else if (r == dmSoundCodec::RESULT_END_OF_STREAM)
+            {
+                assert(decoded == 0);
+                if (!LoopInstance(sound, instance))
+                {
+                    instance->m_AheadEndOfStream = 1;
+                    r = dmSoundCodec::RESULT_OK;
+                    break;
+                }
+                r = dmSoundCodec::RESULT_OK;
+            }
+            else
+            {
+                // error case, reported by the mixer
+                break;
+            }
+        }
+
+        instance->m_AheadCount = frame_count;
+        instance->m_AheadResult = r;
+    }
+
+    struct DecodeAheadJobContext
+    {
+        SoundSystem*    m_Sound;
+        SoundInstance** m_Instances;
+        uint32_t        m_InstanceCount;
+        int32_atomic_t  m_NextInstance;
+        int32_atomic_t  m_InstancesDone;
+        int32_atomic_t  m_RefCount; // the sound thread and each pushed job
+    };
+
+    static void ReleaseDecodeAheadJobContext(DecodeAheadJobContext* ctx)
+    {
+        if (dmAtomicDecrement32(&ctx->m_RefCount) == 1)
+        {
+            free(ctx);
+        }
+    }
+
+    static void DecodeAheadInstances(DecodeAheadJobContext* ctx)
+    {
+        for (;;)
+        {
+            uint32_t i = (uint32_t)dmAtomicIncrement32(&ctx->m_NextInstance);
+            if (i >= ctx->m_InstanceCount)
+            {
+                break;
+            }
 
-        if (instance->m_Gain.IsZero()) {
-            return true;
+            DecodeAheadInstance(ctx->m_Sound, ctx->m_Instances[i]);
+            dmAtomicIncrement32(&ctx->m_InstancesDone);
         }
+    }
 
-        if (instance->m_Speed == 0.0f) {
-            return true;
-        }
+    static int32_t DecodeAheadJobProcess(HJobContext, HJob, void* context, void*)
+    {
+        DM_PROFILE("SoundDecodeAheadJob");
+        DecodeAheadJobContext* ctx = (DecodeAheadJobContext*)context;
+        DecodeAheadInstances(ctx);
+        ReleaseDecodeAheadJobContext(ctx);
+        return 0;
+    }
 
-        int* group_index = sound->m_GroupMap.Get(instance->m_Group);
-        if (group_index != NULL) {
-            SoundGroup* group = &sound->m_Groups[*group_index];
-            if (group->m_IsMuted || group->m_Gain.IsZero()) {
-                return true;
-            }
+    // The decode ahead jobs started after the previous mix are done
+    static void WaitForDecodeAheadNoLock(SoundSystem* sound)
+    {
+        DecodeAheadJobContext* ctx = sound->m_DecodeAheadJob;
+        if (!ctx)
+        {
+            return;
         }
 
-        int* master_index = sound->m_GroupMap.Get(MASTER_GROUP_HASH);
-        if (master_index != NULL) {
-            SoundGroup* master = &sound->m_Groups[*master_index];
-            if (master->m_IsMuted || master->m_Gain.IsZero()) {
-                return true;
-            }
+        // The caller takes part in the work, and then waits for the instances currently being decoded by the workers.
+        // It doesn't wait for jobs that haven't started yet (they will find no work left), since the audio can't wait for a busy job system
+        DM_PROFILE(__FUNCTION__);
+        DecodeAheadInstances(ctx);
+        while ((uint32_t)dmAtomicGet32(&ctx->m_InstancesDone) < ctx->m_InstanceCount)
+        {
+            dmTime::Sleep(0);
         }
+        sound->m_DecodeAheadJob = 0;
+        ReleaseDecodeAheadJobContext(ctx);
+    }
 
-        return false;
+    static bool HasDecodeAheadWorkers(SoundSystem* sound)
+    {
+        return sound->m_JobContext && JobSystemGetWorkerCount(sound->m_JobContext) > 0;
     }
 
-    static inline void MixInstance(const MixContext* mix_context, SoundInstance* instance)
+    // Returns true if the instance needs more frames decoded ahead of the next mix.
+    // The number of frames needed by the next mix is returned in mix_frames
+    static bool PrepareDecodeAhead(SoundSystem* sound, SoundInstance* instance, uint32_t mix_frame_count, uint32_t* mix_frames)
     {
-        DM_PROFILE(__FUNCTION__);
-        SoundSystem* sound = g_SoundSystem;
+        if (!instance->m_Playing || instance->m_Virtual || !instance->m_DecodeAhead || instance->m_AheadEndOfStream || instance->m_AheadResult != dmSoundCodec::RESULT_OK)
+        {
+            return false;
+        }
 
         dmSoundCodec::Info info;
         dmSoundCodec::GetInfo(sound->m_CodecContext, instance->m_Decoder, &info);
-
-        // TODO: Move this check to the NewSoundInstance
-        bool correct_bit_depth = info.m_BitsPerSample == 32 || info.m_BitsPerSample == 16 || info.m_BitsPerSample == 8;
-        bool correct_num_channels = info.m_Channels == 1 || info.m_Channels == 2;
-        if (!correct_bit_depth || !correct_num_channels) {
-            dmLogError("Only mono/stereo with 8/16/32 bits per sample is supported (%s): %u bpp %u ch", GetSoundName(sound, instance), (uint32_t)info.m_BitsPerSample, (uint32_t)info.m_Channels);
-            instance->m_Playing = 0;
-            return;
-        }
-
-        SoundGroup* group = nullptr;
-        int* index = sound->m_GroupMap.Get(instance->m_Group);
-        if (index) {
-            group = &sound->m_Groups[*index];
-        } else {
-            dmLogError("Sound group not found");
-            return;
+        if (info.m_Channels > SOUND_MAX_DECODE_CHANNELS)
+        {
+            return false; // reported by the mixer
         }
 
-        bool is_muted = dmSound::IsMuted(instance);
-
-        dmSoundCodec::Result r = dmSoundCodec::RESULT_OK;
-
-        // Compute how many input samples we will need to produce the requested output samples
         uint64_t delta = GetResampleDelta(info, sound->m_MixRate, instance->m_Speed);
         if (delta == 0) {
-            // very low speed settings can get the delta to be zero due to precision limits - we skip the mixing as resulting rates are also (alsmost) inaudibly low as a result
-            return;
+            return false;
         }
 
-        uint64_t required_decoder_frame_capacity = GetRequiredDecodedFrameCapacity(delta, mix_context->m_FrameCount);
-        if (required_decoder_frame_capacity > 0xffffffffU)
+        uint64_t required = GetRequiredDecodedFrameCapacity(delta, mix_frame_count);
+        uint64_t target = required * SOUND_DECODE_AHEAD_PERIODS;
+        if (target > 0xffffffffU || EnsureAheadBufferSize(instance, info, (uint32_t)target) != RESULT_OK)
         {
-            dmLogError("Decoder scratch buffer too large for '%s'", GetSoundName(sound, instance));
-            instance->m_Playing = 0;
-            return;
+            dmLogError("Failed to grow decode ahead buffer for '%s'", GetSoundName(sound, instance));
+            instance->m_AheadResult = dmSoundCodec::RESULT_OUT_OF_RESOURCES;
+            return false;
         }
 
-        Result capacity_result = EnsureDecoderScratchBufferSize(sound, info, (uint32_t)required_decoder_frame_capacity);
-        if (capacity_result != RESULT_OK)
+        instance->m_AheadTarget = (uint32_t)target;
+        instance->m_AheadMuted = IsMuted(instance);
+        *mix_frames = (uint32_t)required;
+        return instance->m_AheadCount < instance->m_AheadTarget;
+    }
+
+    // Decodes, on the sound thread, what the coming mix can't do without: the instances that ran out of decoded frames
+    // (e.g. a sound that just started), and the ones that aren't decoded by the jobs (see StartDecodeAhead())
+    static void DecodeAhead(SoundSystem* sound, uint32_t mix_frame_count)
+    {
+        if (!sound->m_DecodeAhead)
         {
-            dmLogError("Failed to grow decoder scratch buffer for '%s': %d", GetSoundName(sound, instance), capacity_result);
-            instance->m_Playing = 0;
             return;
         }
 
-        uint64_t required_state_frame_capacity = GetRequiredStateFrameCapacity(delta);
-        if (required_state_frame_capacity > 0xffffffffU)
+        DM_PROFILE(__FUNCTION__);
+
+        bool has_workers = HasDecodeAheadWorkers(sound);
+        for (uint32_t i = 0; i < sound->m_Instances.Size(); ++i)
         {
-            dmLogError("Instance frame buffer too large for '%s'", GetSoundName(sound, instance));
-            instance->m_Playing = 0;
-            return;
+            SoundInstance* instance = &sound->m_Instances[i];
+            uint32_t mix_frames = 0;
+            if (!instance->m_Playing || instance->m_Index == 0xffff || !PrepareDecodeAhead(sound, instance, mix_frame_count, &mix_frames))
+            {
+                continue;
+            }
+
+            // Streaming callbacks aren't necessarily thread safe, so those are decoded on this thread
+            bool is_streaming = sound->m_SoundData[instance->m_SoundDataIndex].m_DataCallbacks.m_GetData != 0;
+            if (!has_workers || is_streaming || instance->m_AheadCount < mix_frames)
+            {
+                DecodeAheadInstance(sound, instance);
+            }
         }
+    }
 
-        capacity_result = EnsureInstanceFrameBufferSize(instance, (uint32_t)required_state_frame_capacity);
-        if (capacity_result != RESULT_OK)
+    // Decodes the compressed sounds a few mix periods ahead on the worker threads, leaving only resampling and mixing to the mixer.
+    // The jobs are started after the mix, and run while the sound thread waits for the next mix period. The instances are
+    // independent, and are decoded in parallel. The jobs are waited for before the next mix, or before an instance is
+    // changed by the api (see WaitForDecodeAheadNoLock())
+    static void StartDecodeAhead(SoundSystem* sound, uint32_t mix_frame_count)
+    {
+        if (!sound->m_DecodeAhead || !HasDecodeAheadWorkers(sound))
         {
-            dmLogError("Failed to grow instance frame buffer for '%s': %d", GetSoundName(sound, instance), capacity_result);
-            instance->m_Playing = 0;
             return;
         }
+        assert(sound->m_DecodeAheadJob == 0);
 
-        uint32_t mixed_instance_frame_count = (uint32_t)((instance->m_FrameFraction + mix_context->m_FrameCount * delta + ((1UL << RESAMPLE_FRACTION_BITS) - 1)) >> RESAMPLE_FRACTION_BITS) + SOUND_MAX_FUTURE;
-
-        // Compute initial amount of samples in temp buffer once we restore per instance state prior to actual mixing
-        uint32_t initial_frame_count = (instance->m_FrameCount > SOUND_MAX_HISTORY) ? (instance->m_FrameCount - SOUND_MAX_HISTORY) : 0;
-        uint32_t frame_count = initial_frame_count;
-        uint32_t new_frame_count = 0;
-
-        void* decoder_temp = sound->m_DecoderTempOutput;
-
-        //
-        // Refill as needed...
-        //
-        if (frame_count < mixed_instance_frame_count && instance->m_Playing) {
-
-            bool is_direct_delivery = (info.m_BitsPerSample == 32 && (!info.m_IsInterleaved || info.m_Channels == 1));
-
-            const uint32_t stride = !is_direct_delivery ? GetDecoderOutputStrideBytes(info) : (uint32_t)sizeof(float);
+        DM_PROFILE(__FUNCTION__);
 
-            while(frame_count < mixed_instance_frame_count)
+        dmArray<SoundInstance*>& instances = sound->m_DecodeAheadInstances;
+        instances.SetSize(0);
+        for (uint32_t i = 0; i < sound->m_Instances.Size(); ++i)
+        {
+            SoundInstance* instance = &sound->m_Instances[i];
+            uint32_t mix_frames = 0;
+            if (!instance->m_Playing || instance->m_Index == 0xffff || !PrepareDecodeAhead(sound, instance, mix_frame_count, &mix_frames))
             {
-                uint32_t n = mixed_instance_frame_count - frame_count; // if the result contains a fractional part and we don't ceil(), we'll end up with a smaller number. Later, when deciding the mix_count in Mix(), a smaller value (integer) will be produced. This will result in leaving a small gap in the mix buffer resulting in sound crackling when the chunk changes.
-
-                char* buffer[SOUND_MAX_DECODE_CHANNELS];
-                uint32_t buffer_size;
-                if (!is_direct_delivery)
-                {
-                    // Output is non-float and/or interleaved and needs post output conversion
-                    buffer[0] = ((char*) decoder_temp) + new_frame_count * stride;
-                }
-                else
-                {
-                    // Output will be either single channel or non-interleaved in float format -> we can just have it delivered into our work buffers
-                    for(uint32_t c=0; c<info.m_Channels; ++c)
-                    {
-                        buffer[c] = (char*)(sound->GetDecoderBufferBase(c) + frame_count);
-                    }
-                }
-                buffer_size = n * stride;
-
-                uint32_t decoded = 0;
-                if (!is_muted)
-                {
-                    r = dmSoundCodec::Decode(sound->m_CodecContext, instance->m_Decoder, buffer, buffer_size, &decoded);
-                }
-                else
-                {
-                    r = dmSoundCodec::Skip(sound->m_CodecContext, instance->m_Decoder, buffer_size, &decoded);
-//TODO: COULD WE NOT AVOID MIXING ANYTHING IN THIS CASE?
-                    uint32_t nc = info.m_IsInterleaved ? 1 : info.m_Channels;
-                    for(uint32_t c=0; c<nc; ++c)
-                    {
-                        memset(buffer[c], 0x00, decoded);
-                    }
-                }
-
-                if (r == dmSoundCodec::RESULT_OK)
-                {
-                    if (decoded == 0) // we might be streaming and didn't get any content
-                    {
-                        break; // Need to break as we're not progressing this sound instance
-                    }
-
-                    frame_count += decoded / stride;
-                    new_frame_count += decoded / stride;
-                }
-                else if (r == dmSoundCodec::RESULT_END_OF_STREAM)
-                {
-                    assert(decoded == 0);
-
-                    if (instance->m_Looping && instance->m_Loopcounter != 0)
-                    {
-                        // We need to loop...
-                        dmSoundCodec::Reset(sound->m_CodecContext, instance->m_Decoder);
-                        if ( instance->m_Loopcounter > 0 )
-                        {
-                            instance->m_Loopcounter --;
-                        }
-                    }
-                    else
-                    {
-                        // Sound ends...
-                        instance->m_EndOfStream = 1;
-                        break;
-                    }
-                }
-                else
-                {
-                    // error case
-                    break;
-                }
+                continue;
             }
-
-            if (r != dmSoundCodec::RESULT_OK && r != dmSoundCodec::RESULT_END_OF_STREAM)
+            if (sound->m_SoundData[instance->m_SoundDataIndex].m_DataCallbacks.m_GetData)
             {
-                dmLogWarning("Unable to decode file '%s': %s %d", GetSoundName(sound, instance), dmSoundCodec::ResultToString(r), r);
-                instance->m_Playing = 0;
-                return;
+                continue; // decoded on the sound thread, see DecodeAhead()
             }
+            instances.Push(instance);
         }
 
-        if (frame_count > 0)
+        uint32_t n = instances.Size();
+        if (n == 0)
         {
-            //
-            // Convert decoded data as needed...
-            //
-            if (new_frame_count > 0)
-            {
-                // Yes. Interleaved?
-                if (!info.m_IsInterleaved)
-                {
-                    // No...
-
-                    // For now we only support floats in this case
-                    // (in which case we have nothing more to process)
-                    assert(info.m_BitsPerSample == 32);
-                }
-                else
-                {
-                    // Yes, convert from temp decoder output (interleaved) to per channel data (non-interleaved) & convert to float as needed
-                    const uint32_t nc = info.m_Channels;
-                    if (info.m_BitsPerSample == 8)
-                    {
-                        if (nc == 1)
-                        {
-                            ConvertFromS8(sound->GetDecoderBufferBase(0) + initial_frame_count, (int8_t*)decoder_temp, new_frame_count);
-                        }
-                        else
-                        {
-                            assert(nc == 2);
-                            float* out[] = {sound->GetDecoderBufferBase(0) + initial_frame_count,
-                                            sound->GetDecoderBufferBase(1) + initial_frame_count};
-                            DeinterleaveFromS8(out, (int8_t*)decoder_temp, new_frame_count);
-                        }
-                    }
-                    else if (info.m_BitsPerSample == 16)
-                    {
-                        if (nc == 1)
-                        {
-                            ConvertFromS16(sound->GetDecoderBufferBase(0) + initial_frame_count, (int16_t*)decoder_temp, new_frame_count);
-                        }
-                        else
-                        {
-                            assert(nc == 2);
-                            float* out[] = {sound->GetDecoderBufferBase(0) + initial_frame_count,
-                                            sound->GetDecoderBufferBase(1) + initial_frame_count};
-                            DeinterleaveFromS16(out, (int16_t*)decoder_temp, new_frame_count);
-                        }
-                    }
-                    else
-                    {
-                        assert(info.m_BitsPerSample == 32);
-                        // We only need to convert anything if the output has more than one channel...
-                        if (nc != 1)
-                        {
-                            assert(nc == 2);
-                            float* out[] = {sound->GetDecoderBufferBase(0) + initial_frame_count,
-                                            sound->GetDecoderBufferBase(1) + initial_frame_count};
-                            Deinterleave(out, (float*)decoder_temp, new_frame_count);
-                        }
-                    }
-                }
-            }
-
-            //
-            // Ensure proper "future" data (close to end of stream)
-            //
-            if (frame_count < mixed_instance_frame_count)
+            return;
+        }
+        uint32_t num_jobs = dmMath::Min(JobSystemGetWorkerCount(sound->m_JobContext), n);
+
+        // The context is released by the last one using it, as jobs that haven't started yet may run after the wait
+        DecodeAheadJobContext* ctx = (DecodeAheadJobContext*)malloc(sizeof(DecodeAheadJobContext) + n * sizeof(SoundInstance*));
+        ctx->m_Sound         = sound;
+        ctx->m_Instances     = (SoundInstance**)(ctx + 1);
+        ctx->m_InstanceCount = n;
+        ctx->m_NextInstance  = 0;
+        ctx->m_InstancesDone = 0;
+        ctx->m_RefCount      = 1;
+        memcpy(ctx->m_Instances, instances.Begin(), n * sizeof(SoundInstance*));
+
+        for (uint32_t i = 0; i < num_jobs; ++i)
+        {
+            Job job = {0};
+            job.m_Process = DecodeAheadJobProcess;
+            job.m_Context = ctx;
+            dmAtomicIncrement32(&ctx->m_RefCount);
+            HJob hjob = JobSystemCreateJob(sound->m_JobContext, &job);
+            if (!hjob || JOBSYSTEM_RESULT_OK != JobSystemPushJob(sound->m_JobContext, hjob))
             {
-                // We generated fewer samples then we asked for. Make sure we can still mix all "real" samples, by ensuring we have enough "future" sample values in any case
-                // (should only trigger at the end of samples)
-                uint32_t missing_frames = dmMath::Min(mixed_instance_frame_count - frame_count, (uint32_t)SOUND_MAX_FUTURE);
-
-                for(uint32_t c=0; c<info.m_Channels; ++c)
-                {
-                    float* decoder_output_buffer = sound->GetDecoderBufferBase(c);
-                    float last = decoder_output_buffer[frame_count - 1];
-                    uint32_t fc = frame_count;
-                    for(uint32_t mi=missing_frames; mi > 0; --mi)
-                    {
-                        decoder_output_buffer[fc++] = last;
-                    }
-                }
-                frame_count += missing_frames;
+                // The push only fails when the job system is shutting down, and the job is freed along with it
+                ReleaseDecodeAheadJobContext(ctx);
+                break;
             }
-
-            //
-            // Mix the data
-            //
-            assert(frame_count > SOUND_MAX_FUTURE);
-            Mix(mix_context, instance, delta, frame_count - SOUND_MAX_FUTURE, &info, group);
         }
 
-        if (instance->m_EndOfStream) {
-            instance->m_Playing = 0;
-        }
+        // Without any pushed job, the instances are decoded by the wait
+        sound->m_DecodeAheadJob = ctx;
     }
 
     static void MixInstances(const MixContext* mix_context)
@@ -1849,7 +3261,16 @@ namespace dmSound
             SoundInstance* instance = &sound->m_Instances[i];
             if (instance->m_Playing)
             {
-                MixInstance(mix_context, instance);
+                if (instance->m_Virtual)
+                    AdvanceVirtualInstance(mix_context, instance);
+                else
+                    MixInstance(mix_context, instance);
+            }
+
+            // The sound ended (or failed to decode)
+            if (!instance->m_Playing && instance->m_PublishedPlaying)
+            {
+                dmAtomicStore32(&instance->m_PublishedPlaying, 0);
             }
         }
     }
@@ -1928,7 +3349,8 @@ namespace dmSound
         uint32_t instances = sound->m_Instances.Size();
         for (uint32_t i = 0; i < instances; ++i) {
             SoundInstance* instance = &sound->m_Instances[i];
-            if (instance->m_Playing || instance->m_FrameCount > 0) {
+            // The instances that aren't playing may be created or deleted meanwhile (see NewSoundInstance())
+            if (instance->m_Playing) {
                 instance->m_Gain.Step();
                 instance->m_Pan.Step();
                 for(uint32_t c=0; c<SOUND_MAX_DECODE_CHANNELS; ++c) {
@@ -1961,6 +3383,7 @@ namespace dmSound
         uint16_t active_instance_count;
         {
             DM_MUTEX_OPTIONAL_SCOPED_LOCK(g_SoundSystem->m_Mutex);
+            ApplyCommandsNoLock(sound);
             active_instance_count = sound->m_InstancesPool.Size();
         }
 
@@ -2050,6 +3473,7 @@ namespace dmSound
 
             {
                 DM_MUTEX_OPTIONAL_SCOPED_LOCK(g_SoundSystem->m_Mutex);
+                WaitForDecodeAheadNoLock(sound);
 
                 sound->m_FrameCount = frame_count;
 
@@ -2058,11 +3482,16 @@ namespace dmSound
                     continue;
                 }
 
+                SelectRealVoices(sound);
+                DecodeAhead(sound, frame_count);
+
                 MixContext mix_context(current_buffer, total_buffers, frame_count);
                 MixInstances(&mix_context);
 
                 Master(&mix_context);
 
+                StartDecodeAhead(sound, frame_count);
+
                 buffer_index = sound->m_NextOutBuffer;
                 sound->m_NextOutBuffer = (sound->m_NextOutBuffer + 1) % sound->m_OutBufferCount;
             }
@@ -2206,6 +3635,10 @@ namespace dmSound
     int64_t GetInternalPos(HSoundInstance instance)
     {
         SoundSystem* sound = g_SoundSystem;
+        DM_MUTEX_OPTIONAL_SCOPED_LOCK(sound->m_Mutex);
+        WaitForDecodeAheadNoLock(sound);
+        if (instance->m_Virtual)
+            return (int64_t)instance->m_VirtualFrame;
         return dmSoundCodec::GetInternalPos(sound->m_CodecContext, instance->m_Decoder);
     }
 
@@ -2214,4 +3647,19 @@ namespace dmSound
     {
         return data->m_RefCount;
     }
+
+    bool IsVirtual(HSoundInstance instance)
+    {
+        return instance->m_Virtual;
+    }
+
+    bool IsPcmCached(HSoundData data)
+    {
+        return data->m_PcmCacheEntry != 0;
+    }
+
+    uint32_t GetPcmCacheSize()
+    {
+        return g_SoundSystem->m_PcmCacheSize;
+    }
 }
@@ -18,6 +18,7 @@
 #include <dlib/configfile.h>
 #include <dlib/hash.h>
 
+#include <dmsdk/dlib/jobsystem.h>
 #include <dmsdk/dlib/vmath.h>
 #include <dmsdk/sound/sound.h>
 
@@ -76,6 +77,11 @@ namespace dmSound
         DSPImplType  m_DSPImplementation;
         bool         m_UseLegacyStereoPan;
         bool         m_UseLinearGain;
+        bool         m_DecodeAhead;  // Decode compressed sounds ahead of the mixer
+        HJobContext  m_JobContext;   // If set, the decode ahead is done on the worker threads, in between the mix periods
+        uint32_t     m_PcmCacheSize;         // Budget in bytes for fully decoded short compressed sounds (0 disables the cache)
+        uint32_t     m_PcmCacheMaxDuration;  // Max length (ms) of a sound in the decoded sound cache
+        uint32_t     m_MaxRealVoices;        // Max number of mixed voices, the others are virtual (0 disables the voice virtualization)
 
         InitializeParams()
         {
@@ -111,6 +117,8 @@ namespace dmSound
 
     Result SoundDataRead(HSoundData sound_data, uint32_t offset, uint32_t size, void* out, uint32_t* out_size);
 
+    // The instances are created and deleted without waiting for the sound thread, and only by the thread that called
+    // Initialize (RESULT_INIT_ERROR otherwise). Deleting a playing instance waits for the sound thread
     Result NewSoundInstance(HSoundData sound_data, HSoundInstance* sound_instance);
     Result DeleteSoundInstance(HSoundInstance sound_instance);
 
@@ -126,6 +134,10 @@ namespace dmSound
     Result GetGroupPeak(dmhash_t group_hash, float window, float* peak_left, float* peak_right);
     Result GetScaleFromGain(float gain, float* scale);
 
+    // Play, Stop, Pause, SetParameter, SetGroupGain, SetInstanceGroup, SetLooping and SetPriority don't wait for the
+    // sound thread. They are queued, and applied at the start of the next mix period. IsPlaying returns the requested
+    // state until then. Only calls from the thread that called Initialize are queued, calls from other threads wait
+    // for the sound thread and are applied directly
     Result Play(HSoundInstance sound_instance);
     Result Stop(HSoundInstance sound_instance);
     Result Pause(HSoundInstance sound_instance, bool pause);
@@ -133,6 +145,8 @@ namespace dmSound
     uint32_t GetAndIncreasePlayCounter();
 
     Result SetLooping(HSoundInstance sound_instance, bool looping, int8_t loopcount);
+    // Voices with a higher priority are mixed first, when there are more voices than sound.max_real_voices
+    Result SetPriority(HSoundInstance sound_instance, uint8_t priority);
 
     Result SetParameter(HSoundInstance sound_instance, Parameter parameter, const dmVMath::Vector4& value);
     Result GetParameter(HSoundInstance sound_instance, Parameter parameter, dmVMath::Vector4& value);
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include <stdint.h>
+#include <string.h>
 #include <dlib/array.h>
 #include <dlib/index_pool.h>
 #include <dlib/endian.h>
@@ -75,6 +76,15 @@ namespace dmSoundCodec
             return RESULT_UNSUPPORTED;
         }
 
+        return NewDecoder(context, decoderImpl, sound_data, decoder);
+    }
+
+    Result NewDecoder(HCodecContext context, const DecoderInfo* decoderImpl, dmSound::HSoundData sound_data, HDecoder* decoder)
+    {
+        if (context->m_DecodersPool.Remaining() == 0) {
+            return RESULT_OUT_OF_RESOURCES;
+        }
+
         uint16_t index = context->m_DecodersPool.Pop();
         Decoder* d = &context->m_Decoders[index];
         d->m_Index = index;
@@ -123,6 +133,132 @@ namespace dmSoundCodec
         return decoder->m_DecoderInfo->m_GetInternalStreamPosition(decoder->m_Stream);
     }
 
+    static inline uint16_t ReadLE16(const uint8_t* p)
+    {
+        return (uint16_t)(p[0] | (p[1] << 8));
+    }
+
+    static inline uint32_t ReadLE32(const uint8_t* p)
+    {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    static inline int64_t ReadLE64(const uint8_t* p)
+    {
+        return (int64_t)((uint64_t)ReadLE32(p) | ((uint64_t)ReadLE32(p + 4) << 32));
+    }
+
+    static uint64_t GetWavFrameCount(const uint8_t* data, uint32_t size)
+    {
+        if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0)
+        {
+            return 0;
+        }
+
+        uint16_t audio_format = 0;
+        uint16_t channels = 0;
+        uint16_t block_align = 0;
+        uint32_t offset = 12;
+        while (offset + 8 <= size)
+        {
+            const uint8_t* chunk = data + offset;
+            uint32_t chunk_size = ReadLE32(chunk + 4);
+            if (memcmp(chunk, "fmt ", 4) == 0 && offset + 8 + 16 <= size)
+            {
+                audio_format = ReadLE16(chunk + 8);
+                channels     = ReadLE16(chunk + 10);
+                block_align  = ReadLE16(chunk + 20);
+            }
+            else if (memcmp(chunk, "data", 4) == 0)
+            {
+                if (channels == 0 || block_align == 0)
+                {
+                    return 0;
+                }
+
+                uint32_t data_size = dmMath::Min(chunk_size, size - offset - 8);
+                if (audio_format == 0x11) // IMA ADPCM, with the same block layout as the wav decoder
+                {
+                    if (block_align <= 4 * channels)
+                    {
+                        return 0;
+                    }
+                    uint32_t block_frames = (channels == 1) ? ((block_align - 4) * 2) : (block_align - 8);
+                    uint64_t frame_count = (uint64_t)(data_size / block_align) * block_frames;
+                    uint32_t remainder = data_size % block_align; // a partial last block
+                    if (remainder > 4u * channels)
+                    {
+                        frame_count += (channels == 1) ? ((remainder - 4) * 2) : ((remainder & ~7u) - 8);
+                    }
+                    return frame_count;
+                }
+                return data_size / block_align;
+            }
+            // Same chunk traversal as the wav decoder
+            offset += 8 + chunk_size;
+        }
+        return 0;
+    }
+
+    // The granule position of the last ogg page that has one, or -1
+    static int64_t GetLastOggGranulePos(const uint8_t* data, uint32_t size)
+    {
+        const uint32_t page_header_size = 27;
+        for (uint32_t offset = size >= page_header_size ? size - page_header_size + 1 : 0; offset-- > 0; )
+        {
+            if (memcmp(data + offset, "OggS", 4) == 0)
+            {
+                int64_t granule_pos = ReadLE64(data + offset + 6);
+                if (granule_pos >= 0)
+                {
+                    return granule_pos;
+                }
+            }
+        }
+        return -1;
+    }
+
+    uint64_t GetFrameCount(Format format, const void* _data, uint32_t size, const Info* info)
+    {
+        const uint8_t* data = (const uint8_t*)_data;
+        if (!data)
+        {
+            return 0;
+        }
+
+        if (format == FORMAT_WAV)
+        {
+            return GetWavFrameCount(data, size);
+        }
+
+        int64_t granule_pos = GetLastOggGranulePos(data, size);
+        if (granule_pos < 0)
+        {
+            return 0;
+        }
+
+        if (format == FORMAT_VORBIS)
+        {
+            // The granule position is the sample count
+            return (uint64_t)granule_pos;
+        }
+
+        // Opus: the granule position is at 48kHz, and includes the pre-skip from the header packet in the first page.
+        // The end trimming isn't applied by the decoder, so the count is approximate
+        const uint32_t page_header_size = 27;
+        if (format == FORMAT_OPUS && size >= page_header_size && info->m_Rate > 0)
+        {
+            uint32_t head_offset = page_header_size + data[26];
+            if (head_offset + 12 <= size && memcmp(data + head_offset, "OpusHead", 8) == 0)
+            {
+                uint64_t pre_skip = ReadLE16(data + head_offset + 10);
+                uint64_t frame_count = ((uint64_t)granule_pos * info->m_Rate) / 48000;
+                return frame_count > pre_skip ? frame_count - pre_skip : 0;
+            }
+        }
+        return 0;
+    }
+
     void DeleteDecoder(HCodecContext context, HDecoder decoder)
     {
         assert(decoder);
@@ -151,6 +151,17 @@ namespace dmSoundCodec
      */
     Result Reset(HCodecContext context, HDecoder decoder);
 
+    /**
+     * Get the number of frames in a sound, from the container headers, without decoding it
+     * @note For ogg files, the count is read from the last page. For opus, it's approximate
+     * @param format format
+     * @param data the complete sound file
+     * @param size size of the data in bytes
+     * @param info info, as returned by GetInfo() for a decoder of the sound
+     * @return number of frames, or 0 if unknown
+     */
+    uint64_t GetFrameCount(Format format, const void* data, uint32_t size, const Info* info);
+
     const char* ResultToString(Result result);
     const char* FormatToString(Format format);
 
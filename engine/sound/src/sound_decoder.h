@@ -99,6 +99,11 @@ namespace dmSoundCodec
      */
     const DecoderInfo* FindDecoderByName(const char *name);
 
+    /**
+     * Create a decoder with a specific implementation (which doesn't need to be registered)
+     */
+    Result NewDecoder(HCodecContext context, const DecoderInfo* decoder_info, dmSound::HSoundData sound_data, HDecoder* decoder);
+
     #define DM_REGISTER_SOUND_DECODER(name, desc) extern "C" void name () { \
         dmSoundCodec::RegisterDecoder(&desc); \
     }
@@ -265,6 +265,11 @@ namespace dmSound
         return RESULT_OK;
     }
 
+    Result SetPriority(HSoundInstance sound_instance, uint8_t priority)
+    {
+        return RESULT_OK;
+    }
+
     Result SetParameter(HSoundInstance sound_instance, Parameter parameter, const Vector4& value)
     {
         sound_instance->m_Parameters[parameter] = value;
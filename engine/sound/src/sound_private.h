@@ -45,6 +45,9 @@ namespace dmSound
     // Unit tests
     int64_t GetInternalPos(HSoundInstance);
     int32_t GetRefCount(HSoundData);
+    bool IsPcmCached(HSoundData);
+    bool IsVirtual(HSoundInstance);
+    uint32_t GetPcmCacheSize();
 
     #define SOUND_MAX_DECODE_CHANNELS (2)
     #define SOUND_MAX_MIX_CHANNELS (2)
@@ -54,8 +57,12 @@ namespace dmSound
     #define SOUND_MAX_SPEED (50)
     #define SOUND_MAX_HISTORY (4)
     #define SOUND_MAX_FUTURE (4)
+    #define SOUND_DECODE_AHEAD_PERIODS (3) // number of mix periods a compressed sound is decoded ahead of the mixer
+    #define SOUND_COMMAND_QUEUE_SIZE (1024) // power of two, commands from the main thread waiting for the mixer
+    #define SOUND_VIRTUAL_CATCHUP_PERIODS (16) // max number of mix periods skipped per mix period, when a compressed virtual voice becomes real
 
     const uint32_t RESAMPLE_FRACTION_BITS = 11; // matches number of polyphase filter bank entries (2048)
+    const float SOUND_INAUDIBLE_GAIN = 0.0001f; // -80dB, voices below are virtual (if the voice virtualization is enabled)
 
     const dmhash_t MASTER_GROUP_HASH = dmHashString64("master");
     const uint32_t GROUP_MEMORY_BUFFER_COUNT = 64;
@@ -2392,6 +2392,550 @@ TEST(SoundSdk, HighSpeedPlaybackCompletes)
     ASSERT_EQ(dmSound::RESULT_OK, dmSound::Finalize());
 }
 
+// Plays a few compressed sounds (one looping, one resampled) and records the output
+static void PlayCompressedSounds(bool decode_ahead, HJobContext job_context, uint32_t update_count, dmArray<int16_t>& output)
+{
+    dmSound::InitializeParams params;
+    params.m_MaxBuffers = MAX_BUFFERS;
+    params.m_MaxSources = MAX_SOURCES;
+    params.m_OutputDevice = "loopback";
+    params.m_FrameCount = 2048;
+    params.m_UseThread = false;
+    params.m_DecodeAhead = decode_ahead;
+    params.m_JobContext = job_context;
+
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Initialize(0, &params));
+
+    struct { const void* m_Data; uint32_t m_Size; dmSound::SoundDataType m_Type; } sounds[] = {
+        {CLICK_TRACK_OGG, CLICK_TRACK_OGG_SIZE, dmSound::SOUND_DATA_TYPE_OGG_VORBIS},
+        {MONO_RESAMPLE_FRAMECOUNT_16000_OGG, MONO_RESAMPLE_FRAMECOUNT_16000_OGG_SIZE, dmSound::SOUND_DATA_TYPE_OGG_VORBIS},
+        {MONO_RESAMPLE_FRAMECOUNT_16000_OPUS, MONO_RESAMPLE_FRAMECOUNT_16000_OPUS_SIZE, dmSound::SOUND_DATA_TYPE_OPUS},
+    };
+    const uint32_t sound_count = DM_ARRAY_SIZE(sounds);
+
+    dmSound::HSoundData sd[sound_count];
+    dmSound::HSoundInstance instances[sound_count];
+    for (uint32_t i = 0; i < sound_count; ++i)
+    {
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundData(sounds[i].m_Data, sounds[i].m_Size, sounds[i].m_Type, &sd[i], dmHashString64("decode_ahead")));
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundInstance(sd[i], &instances[i]));
+    }
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetLooping(instances[1], true, 2));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetParameter(instances[2], dmSound::PARAMETER_SPEED, dmVMath::Vector4(1.5f, 0.0f, 0.0f, 0.0f)));
+
+    for (uint32_t i = 0; i < sound_count; ++i)
+    {
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::Play(instances[i]));
+    }
+
+    for (uint32_t i = 0; i < update_count; ++i)
+    {
+        dmSound::Update();
+    }
+
+    output.SetCapacity(g_LoopbackDevice->m_AllOutput.Size());
+    output.PushArray(g_LoopbackDevice->m_AllOutput.Begin(), g_LoopbackDevice->m_AllOutput.Size());
+
+    for (uint32_t i = 0; i < sound_count; ++i)
+    {
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::Stop(instances[i]));
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundInstance(instances[i]));
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundData(sd[i]));
+    }
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Finalize());
+}
+
+TEST(SoundDecodeAhead, SameAsInline)
+{
+    const uint32_t update_count = 100;
+
+    JobSystemCreateParams job_params;
+    job_params.m_ThreadNamePrefix = "SoundTest";
+    job_params.m_ThreadCount = 2;
+    HJobContext job_context = JobSystemCreate(&job_params);
+    ASSERT_NE((HJobContext)0, job_context);
+
+    dmArray<int16_t> inline_output, ahead_output, parallel_output;
+    PlayCompressedSounds(false, 0, update_count, inline_output);
+    PlayCompressedSounds(true, 0, update_count, ahead_output);
+    PlayCompressedSounds(true, job_context, update_count, parallel_output);
+
+    ASSERT_LT(0U, inline_output.Size());
+    ASSERT_EQ(inline_output.Size(), ahead_output.Size());
+    ASSERT_EQ(inline_output.Size(), parallel_output.Size());
+    ASSERT_EQ(0, memcmp(inline_output.Begin(), ahead_output.Begin(), inline_output.Size() * sizeof(int16_t)));
+    ASSERT_EQ(0, memcmp(inline_output.Begin(), parallel_output.Begin(), inline_output.Size() * sizeof(int16_t)));
+
+    JobSystemDestroy(job_context);
+}
+
+// Plays a compressed sound to the end and records the output
+static void PlayCompressedSound(dmSound::HSoundData sd, dmArray<int16_t>& output)
+{
+    dmSound::HSoundInstance instance = 0;
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundInstance(sd, &instance));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Play(instance));
+
+    uint32_t start = g_LoopbackDevice->m_AllOutput.Size();
+    for (uint32_t i = 0; i < 256 && dmSound::IsPlaying(instance); ++i)
+    {
+        dmSound::Update();
+    }
+    ASSERT_FALSE(dmSound::IsPlaying(instance));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundInstance(instance));
+
+    uint32_t size = g_LoopbackDevice->m_AllOutput.Size() - start;
+    output.SetCapacity(size);
+    output.SetSize(0);
+    output.PushArray(g_LoopbackDevice->m_AllOutput.Begin() + start, size);
+}
+
+TEST(SoundPcmCache, SameAsDecoded)
+{
+    dmSound::InitializeParams params;
+    params.m_MaxBuffers = MAX_BUFFERS;
+    params.m_MaxSources = MAX_SOURCES;
+    params.m_OutputDevice = "loopback";
+    params.m_FrameCount = 2048;
+    params.m_UseThread = false;
+    params.m_PcmCacheSize = 16 * 1024 * 1024;
+    params.m_PcmCacheMaxDuration = 5000;
+
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Initialize(0, &params));
+
+    dmSound::HSoundData sds[2];
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundData(MONO_RESAMPLE_FRAMECOUNT_16000_OGG, MONO_RESAMPLE_FRAMECOUNT_16000_OGG_SIZE, dmSound::SOUND_DATA_TYPE_OGG_VORBIS, &sds[0], dmHashString64("pcm_cache_ogg")));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundData(MONO_RESAMPLE_FRAMECOUNT_16000_OPUS, MONO_RESAMPLE_FRAMECOUNT_16000_OPUS_SIZE, dmSound::SOUND_DATA_TYPE_OPUS, &sds[1], dmHashString64("pcm_cache_opus")));
+
+    for (uint32_t i = 0; i < DM_ARRAY_SIZE(sds); ++i)
+    {
+        // The first play decodes the sound into the cache
+        dmArray<int16_t> first, second;
+        PlayCompressedSound(sds[i], first);
+        ASSERT_TRUE(dmSound::IsPcmCached(sds[i]));
+        PlayCompressedSound(sds[i], second);
+        ASSERT_TRUE(dmSound::IsPcmCached(sds[i]));
+
+        ASSERT_LT(0U, first.Size());
+        ASSERT_EQ(first.Size(), second.Size());
+        ASSERT_EQ(0, memcmp(first.Begin(), second.Begin(), first.Size() * sizeof(int16_t)));
+    }
+    ASSERT_LT(0U, dmSound::GetPcmCacheSize());
+
+    // Changing the data removes it from the cache
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetSoundData(sds[0], MONO_RESAMPLE_FRAMECOUNT_16000_OGG, MONO_RESAMPLE_FRAMECOUNT_16000_OGG_SIZE));
+    ASSERT_FALSE(dmSound::IsPcmCached(sds[0]));
+
+    for (uint32_t i = 0; i < DM_ARRAY_SIZE(sds); ++i)
+    {
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundData(sds[i]));
+    }
+    ASSERT_EQ(0U, dmSound::GetPcmCacheSize());
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Finalize());
+
+    // Compare with the output when decoding each time
+    params.m_PcmCacheSize = 0;
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Initialize(0, &params));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundData(MONO_RESAMPLE_FRAMECOUNT_16000_OGG, MONO_RESAMPLE_FRAMECOUNT_16000_OGG_SIZE, dmSound::SOUND_DATA_TYPE_OGG_VORBIS, &sds[0], dmHashString64("pcm_cache_ogg")));
+    dmArray<int16_t> decoded;
+    PlayCompressedSound(sds[0], decoded);
+    ASSERT_FALSE(dmSound::IsPcmCached(sds[0]));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundData(sds[0]));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Finalize());
+
+    params.m_PcmCacheSize = 16 * 1024 * 1024;
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Initialize(0, &params));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundData(MONO_RESAMPLE_FRAMECOUNT_16000_OGG, MONO_RESAMPLE_FRAMECOUNT_16000_OGG_SIZE, dmSound::SOUND_DATA_TYPE_OGG_VORBIS, &sds[0], dmHashString64("pcm_cache_ogg")));
+    dmArray<int16_t> cached;
+    PlayCompressedSound(sds[0], cached);
+    ASSERT_TRUE(dmSound::IsPcmCached(sds[0]));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundData(sds[0]));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Finalize());
+
+    ASSERT_EQ(decoded.Size(), cached.Size());
+    ASSERT_EQ(0, memcmp(decoded.Begin(), cached.Begin(), decoded.Size() * sizeof(int16_t)));
+}
+
+TEST(SoundPcmCache, Eviction)
+{
+    dmSound::InitializeParams params;
+    params.m_MaxBuffers = MAX_BUFFERS;
+    params.m_MaxSources = MAX_SOURCES;
+    params.m_OutputDevice = "loopback";
+    params.m_FrameCount = 2048;
+    params.m_UseThread = false;
+    params.m_PcmCacheSize = 16 * 1024 * 1024;
+    params.m_PcmCacheMaxDuration = 5000;
+
+    // Find the size of one sound in the cache
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Initialize(0, &params));
+    dmSound::HSoundData sd = 0;
+    dmSound::HSoundInstance instance = 0;
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundData(MONO_RESAMPLE_FRAMECOUNT_16000_OGG, MONO_RESAMPLE_FRAMECOUNT_16000_OGG_SIZE, dmSound::SOUND_DATA_TYPE_OGG_VORBIS, &sd, dmHashString64("pcm_cache")));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundInstance(sd, &instance));
+    uint32_t sound_size = dmSound::GetPcmCacheSize();
+    ASSERT_LT(0U, sound_size);
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundInstance(instance));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundData(sd));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Finalize());
+
+    // Room for one sound only
+    params.m_PcmCacheSize = sound_size + sound_size / 2;
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Initialize(0, &params));
+
+    dmSound::HSoundData sds[2];
+    dmSound::HSoundInstance instances[2];
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundData(MONO_RESAMPLE_FRAMECOUNT_16000_OGG, MONO_RESAMPLE_FRAMECOUNT_16000_OGG_SIZE, dmSound::SOUND_DATA_TYPE_OGG_VORBIS, &sds[i], dmHashString64("pcm_cache")));
+    }
+
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundInstance(sds[0], &instances[0]));
+    ASSERT_TRUE(dmSound::IsPcmCached(sds[0]));
+
+    // The cached sound is playing, so the second one is decoded as usual
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundInstance(sds[1], &instances[1]));
+    ASSERT_TRUE(dmSound::IsPcmCached(sds[0]));
+    ASSERT_FALSE(dmSound::IsPcmCached(sds[1]));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundInstance(instances[1]));
+
+    // Once it's no longer playing, the least recently used sound is evicted
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundInstance(instances[0]));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundInstance(sds[1], &instances[1]));
+    ASSERT_FALSE(dmSound::IsPcmCached(sds[0]));
+    ASSERT_TRUE(dmSound::IsPcmCached(sds[1]));
+    ASSERT_EQ(sound_size, dmSound::GetPcmCacheSize());
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundInstance(instances[1]));
+
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundData(sds[i]));
+    }
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Finalize());
+}
+
+TEST(SoundVirtualVoices, MaxRealVoices)
+{
+    dmSound::InitializeParams params;
+    params.m_MaxBuffers = MAX_BUFFERS;
+    params.m_MaxSources = MAX_SOURCES;
+    params.m_OutputDevice = "loopback";
+    params.m_FrameCount = 2048;
+    params.m_UseThread = false;
+    params.m_MaxRealVoices = 1;
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Initialize(0, &params));
+
+    dmSound::HSoundData sd = 0;
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundData(MONO_RESAMPLE_FRAMECOUNT_16000_OGG, MONO_RESAMPLE_FRAMECOUNT_16000_OGG_SIZE, dmSound::SOUND_DATA_TYPE_OGG_VORBIS, &sd, dmHashString64("virtual")));
+
+    const uint8_t priorities[] = {0, 10, 5};
+    dmSound::HSoundInstance instances[3];
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundInstance(sd, &instances[i]));
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetPriority(instances[i], priorities[i]));
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::Play(instances[i]));
+    }
+
+    // Only the voice with the highest priority is mixed
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Update());
+    ASSERT_TRUE(dmSound::IsVirtual(instances[0]));
+    ASSERT_FALSE(dmSound::IsVirtual(instances[1]));
+    ASSERT_TRUE(dmSound::IsVirtual(instances[2]));
+
+    // The play cursor of a virtual voice advances without the decoder
+    int64_t virtual_frame = dmSound::GetInternalPos(instances[0]);
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Update());
+    ASSERT_TRUE(dmSound::IsVirtual(instances[0]));
+    ASSERT_LT(virtual_frame, dmSound::GetInternalPos(instances[0]));
+
+    // Inaudible voices are virtual, regardless of their priority, once they have faded out
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetParameter(instances[1], dmSound::PARAMETER_GAIN, dmVMath::Vector4(0.0f, 0, 0, 0)));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Update());
+    ASSERT_FALSE(dmSound::IsVirtual(instances[1]));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Update());
+    ASSERT_TRUE(dmSound::IsVirtual(instances[0]));
+    ASSERT_TRUE(dmSound::IsVirtual(instances[1]));
+    ASSERT_FALSE(dmSound::IsVirtual(instances[2]));
+
+    // The virtual voices keep playing, and end at the same time as the real one
+    uint32_t update_count = 0;
+    while (dmSound::IsPlaying(instances[2]) && update_count < 256)
+    {
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::Update());
+        ++update_count;
+    }
+    ASSERT_FALSE(dmSound::IsPlaying(instances[2]));
+    ASSERT_LT(update_count, 256U);
+    dmSound::Update();
+    ASSERT_FALSE(dmSound::IsPlaying(instances[0]));
+    ASSERT_FALSE(dmSound::IsPlaying(instances[1]));
+
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundInstance(instances[i]));
+    }
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundData(sd));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Finalize());
+}
+
+// A compressed virtual voice that becomes real catches up with its play cursor over a few mix periods, instead of all at once
+TEST(SoundVirtualVoices, CatchUp)
+{
+    dmSound::InitializeParams params;
+    params.m_MaxBuffers = MAX_BUFFERS;
+    params.m_MaxSources = MAX_SOURCES;
+    params.m_OutputDevice = "loopback";
+    params.m_FrameCount = 2048;
+    params.m_UseThread = false;
+    params.m_MaxRealVoices = 1;
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Initialize(0, &params));
+
+    dmSound::HSoundData sd = 0;
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundData(MUSIC_OPUS, MUSIC_OPUS_SIZE, dmSound::SOUND_DATA_TYPE_OPUS, &sd, dmHashString64("virtual_catchup")));
+
+    const uint8_t priorities[] = {10, 0};
+    dmSound::HSoundInstance instances[2];
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundInstance(sd, &instances[i]));
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetPriority(instances[i], priorities[i]));
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::Play(instances[i]));
+    }
+
+    // A few seconds into the sound, which is more than can be skipped in one mix period
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::Update());
+    }
+    ASSERT_FALSE(dmSound::IsVirtual(instances[0]));
+    ASSERT_TRUE(dmSound::IsVirtual(instances[1]));
+    int64_t virtual_frame = dmSound::GetInternalPos(instances[1]);
+
+    // Once the real voice is stopped, the virtual voice is decoded up to its cursor, a part in each mix period
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Stop(instances[0]));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Update());
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Update());
+    ASSERT_FALSE(dmSound::IsPlaying(instances[0]));
+    ASSERT_TRUE(dmSound::IsVirtual(instances[1]));
+
+    uint32_t update_count = 0;
+    while (dmSound::IsVirtual(instances[1]) && update_count < 32)
+    {
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::Update());
+        ++update_count;
+    }
+    ASSERT_FALSE(dmSound::IsVirtual(instances[1]));
+    ASSERT_TRUE(dmSound::IsPlaying(instances[1]));
+    // The decoder continues from the cursor, not from the start of the sound
+    ASSERT_LE(virtual_frame, dmSound::GetInternalPos(instances[1]));
+
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundInstance(instances[i]));
+    }
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundData(sd));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Finalize());
+}
+
+// The frame count read from the headers, used for the play cursor of virtual voices, matches the decoded sound
+TEST(SoundVirtualVoices, FrameCount)
+{
+    dmSound::InitializeParams params;
+    params.m_MaxBuffers = MAX_BUFFERS;
+    params.m_MaxSources = MAX_SOURCES;
+    params.m_OutputDevice = "loopback";
+    params.m_FrameCount = 2048;
+    params.m_UseThread = false;
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Initialize(0, &params));
+
+    struct { const void* m_Data; uint32_t m_Size; dmSound::SoundDataType m_Type; dmSoundCodec::Format m_Format; uint32_t m_Tolerance; } sounds[] = {
+        {MONO_TONE_440_44100_88200_WAV, MONO_TONE_440_44100_88200_WAV_SIZE, dmSound::SOUND_DATA_TYPE_WAV, dmSoundCodec::FORMAT_WAV, 0},
+        {MONO_RESAMPLE_FRAMECOUNT_16000_ADPCM_WAV, MONO_RESAMPLE_FRAMECOUNT_16000_ADPCM_WAV_SIZE, dmSound::SOUND_DATA_TYPE_WAV, dmSoundCodec::FORMAT_WAV, 0},
+        // The compressed decoders don't trim the last packet exactly
+        {MONO_RESAMPLE_FRAMECOUNT_16000_OGG, MONO_RESAMPLE_FRAMECOUNT_16000_OGG_SIZE, dmSound::SOUND_DATA_TYPE_OGG_VORBIS, dmSoundCodec::FORMAT_VORBIS, 2048},
+        {MONO_RESAMPLE_FRAMECOUNT_16000_OPUS, MONO_RESAMPLE_FRAMECOUNT_16000_OPUS_SIZE, dmSound::SOUND_DATA_TYPE_OPUS, dmSoundCodec::FORMAT_OPUS, 2048},
+    };
+
+    dmSoundCodec::NewCodecContextParams codec_params;
+    dmSoundCodec::HCodecContext codec = dmSoundCodec::New(&codec_params);
+
+    for (uint32_t i = 0; i < DM_ARRAY_SIZE(sounds); ++i)
+    {
+        dmSound::HSoundData sd = 0;
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundData(sounds[i].m_Data, sounds[i].m_Size, sounds[i].m_Type, &sd, dmHashString64("frame_count")));
+
+        dmSoundCodec::HDecoder decoder = 0;
+        ASSERT_EQ(dmSoundCodec::RESULT_OK, dmSoundCodec::NewDecoder(codec, sounds[i].m_Format, sd, &decoder));
+        dmSoundCodec::Info info;
+        dmSoundCodec::GetInfo(codec, decoder, &info);
+        ASSERT_EQ(1U, info.m_Channels);
+
+        float buffer[2048];
+        char* buffers[] = {(char*)buffer};
+        const uint32_t stride = info.m_BitsPerSample / 8;
+        uint64_t decoded_frames = 0;
+        for (;;)
+        {
+            uint32_t decoded = 0;
+            dmSoundCodec::Result r = dmSoundCodec::Decode(codec, decoder, buffers, sizeof(buffer), &decoded);
+            decoded_frames += decoded / stride;
+            if (r != dmSoundCodec::RESULT_OK || decoded == 0)
+                break;
+        }
+
+        uint64_t frame_count = dmSoundCodec::GetFrameCount(sounds[i].m_Format, sounds[i].m_Data, sounds[i].m_Size, &info);
+        ASSERT_LT(0U, frame_count);
+        ASSERT_NEAR((double)decoded_frames, (double)frame_count, (double)sounds[i].m_Tolerance);
+
+        dmSoundCodec::DeleteDecoder(codec, decoder);
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundData(sd));
+    }
+
+    dmSoundCodec::Delete(codec);
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Finalize());
+}
+
+// Waits for the sound thread to mix the master group above, or below, a level
+static bool WaitForMasterRMS(bool above, float level)
+{
+    for (uint32_t i = 0; i < 200; ++i)
+    {
+        float rms_left = 0.0f, rms_right = 0.0f;
+        dmSound::GetGroupRMS(dmHashString64("master"), 0.05f, &rms_left, &rms_right);
+        if (above ? (rms_left > level) : (rms_left < level))
+            return true;
+        dmTime::Sleep(5000);
+    }
+    return false;
+}
+
+TEST(SoundCommandQueue, Threaded)
+{
+    dmSound::InitializeParams params;
+    params.m_MaxBuffers = MAX_BUFFERS;
+    params.m_MaxSources = MAX_SOURCES;
+    params.m_OutputDevice = "loopback";
+    params.m_FrameCount = 2048;
+    params.m_UseThread = true;
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Initialize(0, &params));
+
+    dmSound::HSoundData sd = 0;
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundData(MONO_RESAMPLE_FRAMECOUNT_16000_OGG, MONO_RESAMPLE_FRAMECOUNT_16000_OGG_SIZE, dmSound::SOUND_DATA_TYPE_OGG_VORBIS, &sd, dmHashString64("queue")));
+    dmSound::HSoundInstance instance = 0;
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundInstance(sd, &instance));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetLooping(instance, true, -1));
+
+    // The requested state is visible right away, before the sound thread has applied the commands
+    ASSERT_FALSE(dmSound::IsPlaying(instance));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Play(instance));
+    ASSERT_TRUE(dmSound::IsPlaying(instance));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Pause(instance, true));
+    ASSERT_FALSE(dmSound::IsPlaying(instance));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Pause(instance, false));
+    ASSERT_TRUE(dmSound::IsPlaying(instance));
+
+    // More commands than the queue holds
+    for (uint32_t i = 0; i < 5000; ++i)
+    {
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetParameter(instance, dmSound::PARAMETER_GAIN, dmVMath::Vector4((i & 1) ? 1.0f : 0.5f, 0, 0, 0)));
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetGroupGain(dmHashString64("master"), (i & 1) ? 1.0f : 0.5f));
+    }
+    float gain = 0.0f;
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::GetGroupGain(dmHashString64("master"), &gain));
+    ASSERT_NEAR(1.0f, gain, 0.0001f);
+    ASSERT_EQ(dmSound::RESULT_INVALID_PROPERTY, dmSound::SetParameter(instance, dmSound::PARAMETER_MAX, dmVMath::Vector4(1.0f, 0, 0, 0)));
+
+    // The looping sound keeps playing on the sound thread
+    ASSERT_TRUE(WaitForMasterRMS(true, 0.01f));
+    ASSERT_TRUE(dmSound::IsPlaying(instance));
+
+    // The queued gains reach the mixer
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetParameter(instance, dmSound::PARAMETER_GAIN, dmVMath::Vector4(0.0f, 0, 0, 0)));
+    ASSERT_TRUE(WaitForMasterRMS(false, 0.0001f));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetParameter(instance, dmSound::PARAMETER_GAIN, dmVMath::Vector4(1.0f, 0, 0, 0)));
+    ASSERT_TRUE(WaitForMasterRMS(true, 0.01f));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetGroupGain(dmHashString64("master"), 0.0f));
+    ASSERT_TRUE(WaitForMasterRMS(false, 0.0001f));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetGroupGain(dmHashString64("master"), 1.0f));
+    ASSERT_TRUE(WaitForMasterRMS(true, 0.01f));
+
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Stop(instance));
+    ASSERT_FALSE(dmSound::IsPlaying(instance));
+    dmTime::Sleep(50000);
+    ASSERT_FALSE(dmSound::IsPlaying(instance));
+
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundInstance(instance));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundData(sd));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Finalize());
+}
+
+#if defined(DM_HAS_THREADS)
+struct OtherThreadContext
+{
+    dmSound::HSoundData     m_SoundData;
+    dmSound::HSoundInstance m_Instance;
+    dmSound::Result         m_NewResult;
+    dmSound::Result         m_DeleteResult;
+    dmSound::Result         m_PlayResult;
+};
+
+static void OtherThreadWorker(void* _ctx)
+{
+    OtherThreadContext* ctx = (OtherThreadContext*)_ctx;
+    dmSound::HSoundInstance instance = 0;
+    ctx->m_NewResult = dmSound::NewSoundInstance(ctx->m_SoundData, &instance);
+    ctx->m_DeleteResult = dmSound::DeleteSoundInstance(ctx->m_Instance);
+    ctx->m_PlayResult = dmSound::Play(ctx->m_Instance);
+}
+
+TEST(SoundCommandQueue, Instances)
+{
+    dmSound::InitializeParams params;
+    params.m_MaxBuffers = MAX_BUFFERS;
+    params.m_MaxSources = MAX_SOURCES;
+    params.m_OutputDevice = "loopback";
+    params.m_FrameCount = 2048;
+    params.m_UseThread = true;
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Initialize(0, &params));
+
+    dmSound::HSoundData sd = 0;
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundData(MONO_RESAMPLE_FRAMECOUNT_16000_OGG, MONO_RESAMPLE_FRAMECOUNT_16000_OGG_SIZE, dmSound::SOUND_DATA_TYPE_OGG_VORBIS, &sd, dmHashString64("instances")));
+
+    // The instances that never played are deleted without the sound thread, and their slots are reused
+    for (uint32_t i = 0; i < MAX_SOURCES * 4; ++i)
+    {
+        dmSound::HSoundInstance instance = 0;
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundInstance(sd, &instance));
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetInstanceGroup(instance, "master"));
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetLooping(instance, true, -1));
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetPriority(instance, 1));
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundInstance(instance));
+    }
+
+    // Only the thread that initialized the sound system creates and deletes the instances,
+    // while the queued calls from other threads are applied directly
+    OtherThreadContext ctx;
+    ctx.m_SoundData = sd;
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundInstance(sd, &ctx.m_Instance));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetLooping(ctx.m_Instance, true, -1));
+    dmThread::Thread thread = dmThread::New(OtherThreadWorker, 0x80000, (void*)&ctx, "sound_instances");
+    dmThread::Join(thread);
+    ASSERT_EQ(dmSound::RESULT_INIT_ERROR, ctx.m_NewResult);
+    ASSERT_EQ(dmSound::RESULT_INIT_ERROR, ctx.m_DeleteResult);
+    ASSERT_EQ(dmSound::RESULT_OK, ctx.m_PlayResult);
+    ASSERT_TRUE(dmSound::IsPlaying(ctx.m_Instance));
+    ASSERT_TRUE(WaitForMasterRMS(true, 0.01f));
+
+    // The playing instance is stopped by the sound thread before it's deleted
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundInstance(ctx.m_Instance));
+    ASSERT_TRUE(WaitForMasterRMS(false, 0.0001f));
+
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundData(sd));
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Finalize());
+}
+#endif
+
 // New tests for start_time/start_frame offset support
 
 TEST(SoundStartOffset, FrameIndependentOfSpeed)
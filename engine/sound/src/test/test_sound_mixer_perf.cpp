@@ -0,0 +1,363 @@
+// Copyright 2020-2026 The Defold Foundation
+// Copyright 2014-2020 King
+// Copyright 2009-2014 Ragnar Svensson, Christian Murray
+// Licensed under the Defold License version 1.0 (the "License"); you may not use
+// this file except in compliance with the License.
+//
+// You may obtain a copy of the License, together with FAQs at
+// https://www.defold.com/license
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// Offline benchmark of the sound mixer. The output goes to a "file" device which
+// accepts buffers as fast as they are mixed, and hashes them (and optionally writes
+// them to a wav file), so it runs without audio hardware.
+//
+// It isn't part of the test run. Build it with the tests, and run it manually:
+// Usage: test_sound_mixer_perf [--output-dir <dir>] [--seconds <n>] [jc_test options]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define JC_TEST_IMPLEMENTATION
+#include <jc_test/jc_test.h>
+#include <dlib/array.h>
+#include <dlib/dstrings.h>
+#include <dlib/hash.h>
+#include <dlib/log.h>
+#include <dlib/math.h>
+#include <dlib/time.h>
+#include "../sound.h"
+
+#define DEF_EMBED(x) \
+    extern unsigned char x[]; \
+    extern uint32_t x##_SIZE;
+
+DEF_EMBED(MONO_TONE_440_22050_44100_WAV)
+DEF_EMBED(STEREO_TONE_440_44100_88200_WAV)
+DEF_EMBED(MUSIC_ADPCM_WAV)
+DEF_EMBED(AMBIENCE_OGG)
+DEF_EMBED(EXPLOSION_OGG)
+DEF_EMBED(AMBIENCE_OPUS)
+DEF_EMBED(EXPLOSION_OPUS)
+
+#undef DEF_EMBED
+
+static const uint32_t MAX_VOICES = 64;
+static const uint32_t GROUP_COUNT = 4;
+
+static const char* g_OutputDir = 0;
+static float g_RenderSeconds = 5.0f;
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// File device
+
+struct FileDevice
+{
+    FILE*       m_File;
+    HashState64 m_Hash;
+    uint32_t    m_MixRate;
+    uint32_t    m_FrameCount;
+    uint64_t    m_FramesWritten;
+};
+
+static uint32_t   g_FileDeviceMixRate = 44100;
+static char       g_FileDevicePath[1024];
+static FileDevice* g_FileDevice = 0;
+
+static void WriteU32(FILE* f, uint32_t v)
+{
+    uint8_t b[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+    fwrite(b, 1, sizeof(b), f);
+}
+
+static void WriteU16(FILE* f, uint16_t v)
+{
+    uint8_t b[2] = { (uint8_t)v, (uint8_t)(v >> 8) };
+    fwrite(b, 1, sizeof(b), f);
+}
+
+// 16 bit stereo PCM. The sizes are patched when the device is closed
+static void WriteWavHeader(FILE* f, uint32_t mix_rate, uint32_t data_size)
+{
+    fwrite("RIFF", 1, 4, f);
+    WriteU32(f, 36 + data_size);
+    fwrite("WAVEfmt ", 1, 8, f);
+    WriteU32(f, 16);
+    WriteU16(f, 1); // PCM
+    WriteU16(f, 2);
+    WriteU32(f, mix_rate);
+    WriteU32(f, mix_rate * 2 * sizeof(int16_t));
+    WriteU16(f, 2 * sizeof(int16_t));
+    WriteU16(f, 16);
+    fwrite("data", 1, 4, f);
+    WriteU32(f, data_size);
+}
+
+static dmSound::Result DeviceFileOpen(const dmSound::OpenDeviceParams* params, dmSound::HDevice* device)
+{
+    FileDevice* d = new FileDevice;
+    d->m_File = 0;
+    d->m_MixRate = g_FileDeviceMixRate;
+    d->m_FrameCount = params->m_FrameCount;
+    d->m_FramesWritten = 0;
+    dmHashInit64(&d->m_Hash, false);
+
+    if (g_FileDevicePath[0])
+    {
+        d->m_File = fopen(g_FileDevicePath, "wb");
+        if (!d->m_File)
+        {
+            dmLogError("Unable to open '%s' for writing", g_FileDevicePath);
+        }
+        else
+        {
+            WriteWavHeader(d->m_File, d->m_MixRate, 0);
+        }
+    }
+
+    *device = d;
+    g_FileDevice = d;
+    return dmSound::RESULT_OK;
+}
+
+static void DeviceFileClose(dmSound::HDevice device)
+{
+    FileDevice* d = (FileDevice*) device;
+    if (d->m_File)
+    {
+        fseek(d->m_File, 0, SEEK_SET);
+        WriteWavHeader(d->m_File, d->m_MixRate, (uint32_t)(d->m_FramesWritten * 2 * sizeof(int16_t)));
+        fclose(d->m_File);
+    }
+    delete d;
+    g_FileDevice = 0;
+}
+
+static dmSound::Result DeviceFileQueue(dmSound::HDevice device, const void* samples, uint32_t sample_count)
+{
+    FileDevice* d = (FileDevice*) device;
+    uint32_t size = sample_count * 2 * sizeof(int16_t);
+    dmHashUpdateBuffer64(&d->m_Hash, samples, size);
+    if (d->m_File)
+    {
+        fwrite(samples, 1, size, d->m_File);
+    }
+    d->m_FramesWritten += sample_count;
+    return dmSound::RESULT_OK;
+}
+
+// The mixer never waits for the device, one buffer is mixed per dmSound::Update()
+static uint32_t DeviceFileFreeBufferSlots(dmSound::HDevice device)
+{
+    return 1;
+}
+
+static void DeviceFileDeviceInfo(dmSound::HDevice device, dmSound::DeviceInfo* info)
+{
+    FileDevice* d = (FileDevice*) device;
+    info->m_MixRate = d->m_MixRate;
+    info->m_FrameCount = d->m_FrameCount;
+}
+
+static void DeviceFileStart(dmSound::HDevice device)
+{
+}
+
+static void DeviceFileStop(dmSound::HDevice device)
+{
+}
+
+DM_DECLARE_SOUND_DEVICE(FileSoundDevice, "file", DeviceFileOpen, DeviceFileClose, DeviceFileQueue,
+                        DeviceFileFreeBufferSlots, 0, DeviceFileDeviceInfo, DeviceFileStart, DeviceFileStop);
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// Benchmark
+
+struct MixerBenchmarkParams
+{
+    const char*             m_Name;
+    const void*             m_Sound;
+    uint32_t                m_SoundSize;
+    dmSound::SoundDataType  m_Type;
+    const void*             m_Sound2;      // Optional, every other voice plays this sound
+    uint32_t                m_Sound2Size;
+    uint32_t                m_VoiceCount;
+    uint32_t                m_MixRate;
+    float                   m_Speed;
+    bool                    m_GroupRamps;  // Change the group gains every mix period
+};
+
+struct MixerBenchmarkResult
+{
+    dmhash_t m_Hash;
+    uint64_t m_FrameCount;
+    uint64_t m_Time;        // us
+};
+
+static void RunMixerBenchmark(const MixerBenchmarkParams& p, float seconds, MixerBenchmarkResult* result)
+{
+    g_FileDeviceMixRate = p.m_MixRate;
+    g_FileDevicePath[0] = 0;
+    if (g_OutputDir)
+    {
+        dmSnPrintf(g_FileDevicePath, sizeof(g_FileDevicePath), "%s/%s.wav", g_OutputDir, p.m_Name);
+    }
+
+    dmSound::InitializeParams params;
+    params.m_OutputDevice = "file";
+    params.m_MaxSoundData = 2;
+    params.m_MaxSources = MAX_VOICES;
+    params.m_MaxInstances = MAX_VOICES;
+    params.m_FrameCount = 1024;
+    params.m_UseThread = false;
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Initialize(0, &params));
+    ASSERT_NE((FileDevice*)0, g_FileDevice);
+
+    dmSound::HSoundData sound_data[2] = {0, 0};
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundData(p.m_Sound, p.m_SoundSize, p.m_Type, &sound_data[0], dmHashString64("sound0")));
+    if (p.m_Sound2)
+    {
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundData(p.m_Sound2, p.m_Sound2Size, p.m_Type, &sound_data[1], dmHashString64("sound1")));
+    }
+
+    dmhash_t groups[GROUP_COUNT];
+    for (uint32_t i = 0; i < GROUP_COUNT; ++i)
+    {
+        char name[32];
+        dmSnPrintf(name, sizeof(name), "group%u", i);
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::AddGroup(name));
+        groups[i] = dmHashString64(name);
+    }
+
+    dmSound::HSoundInstance instances[MAX_VOICES];
+    for (uint32_t i = 0; i < p.m_VoiceCount; ++i)
+    {
+        dmSound::HSoundData sd = (p.m_Sound2 && (i & 1)) ? sound_data[1] : sound_data[0];
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::NewSoundInstance(sd, &instances[i]));
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetInstanceGroup(instances[i], groups[i % GROUP_COUNT]));
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetLooping(instances[i], true, -1));
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetParameter(instances[i], dmSound::PARAMETER_GAIN, dmVMath::Vector4(1.0f / p.m_VoiceCount, 0, 0, 0)));
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetParameter(instances[i], dmSound::PARAMETER_PAN, dmVMath::Vector4((i % 5) * 0.5f - 1.0f, 0, 0, 0)));
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetParameter(instances[i], dmSound::PARAMETER_SPEED, dmVMath::Vector4(p.m_Speed, 0, 0, 0)));
+        // Spread out the voices, so they don't decode the same blocks at the same time
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::SetStartFrame(instances[i], i * 1009));
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::Play(instances[i]));
+    }
+
+    // The first update starts the device and fills the instance buffers, and isn't part of the measurement
+    dmSound::Update();
+    dmHashInit64(&g_FileDevice->m_Hash, false);
+    uint64_t frames_start = g_FileDevice->m_FramesWritten;
+
+    uint64_t frame_count = (uint64_t)(seconds * p.m_MixRate);
+    uint32_t update = 0;
+    uint64_t time_start = dmTime::GetMonotonicTime();
+    while (g_FileDevice->m_FramesWritten - frames_start < frame_count)
+    {
+        if (p.m_GroupRamps)
+        {
+            for (uint32_t i = 0; i < GROUP_COUNT; ++i)
+            {
+                dmSound::SetGroupGain(groups[i], ((update + i) & 1) ? 1.0f : 0.25f);
+            }
+        }
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::Update());
+        ++update;
+    }
+    uint64_t time_end = dmTime::GetMonotonicTime();
+
+    result->m_Hash = dmHashFinal64(&g_FileDevice->m_Hash);
+    result->m_FrameCount = g_FileDevice->m_FramesWritten - frames_start;
+    result->m_Time = time_end - time_start;
+
+    for (uint32_t i = 0; i < p.m_VoiceCount; ++i)
+    {
+        ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundInstance(instances[i]));
+    }
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        if (sound_data[i])
+            ASSERT_EQ(dmSound::RESULT_OK, dmSound::DeleteSoundData(sound_data[i]));
+    }
+    ASSERT_EQ(dmSound::RESULT_OK, dmSound::Finalize());
+}
+
+class dmSoundMixerBenchmark : public jc_test_params_class<MixerBenchmarkParams>
+{
+};
+
+// The mixer runs on the calling thread only, so the real-time factor is per core
+TEST_P(dmSoundMixerBenchmark, RealTimeFactor)
+{
+    const MixerBenchmarkParams& p = GetParam();
+
+    MixerBenchmarkResult result;
+    RunMixerBenchmark(p, g_RenderSeconds, &result);
+
+    float audio_seconds = result.m_FrameCount / (float)p.m_MixRate;
+    float wall_seconds = dmMath::Max(result.m_Time * 0.000001f, 0.000001f);
+    float rtf = audio_seconds / wall_seconds;
+    printf("[%s] %u voices @ %u Hz, speed %.2f%s: %.1f s audio in %.3f s | %.1fx real-time | %.1f us per voice per audio second | hash %016llx\n",
+            p.m_Name, p.m_VoiceCount, p.m_MixRate, p.m_Speed, p.m_GroupRamps ? ", group ramps" : "",
+            audio_seconds, wall_seconds, rtf, wall_seconds * 1000000.0f / (audio_seconds * p.m_VoiceCount),
+            (unsigned long long)result.m_Hash);
+}
+
+const MixerBenchmarkParams params_mixer_benchmark[] = {
+    {"wav_44100",           STEREO_TONE_440_44100_88200_WAV, STEREO_TONE_440_44100_88200_WAV_SIZE, dmSound::SOUND_DATA_TYPE_WAV, 0, 0, 16, 44100, 1.0f, false},
+    {"wav_44100_64",        STEREO_TONE_440_44100_88200_WAV, STEREO_TONE_440_44100_88200_WAV_SIZE, dmSound::SOUND_DATA_TYPE_WAV, 0, 0, 64, 44100, 1.0f, false},
+    {"wav_22050_to_48000",  MONO_TONE_440_22050_44100_WAV, MONO_TONE_440_22050_44100_WAV_SIZE, dmSound::SOUND_DATA_TYPE_WAV, 0, 0, 64, 48000, 1.0f, false},
+    {"wav_speed",           STEREO_TONE_440_44100_88200_WAV, STEREO_TONE_440_44100_88200_WAV_SIZE, dmSound::SOUND_DATA_TYPE_WAV, 0, 0, 64, 44100, 1.37f, false},
+    {"wav_group_ramps",     STEREO_TONE_440_44100_88200_WAV, STEREO_TONE_440_44100_88200_WAV_SIZE, dmSound::SOUND_DATA_TYPE_WAV, 0, 0, 64, 44100, 1.0f, true},
+    {"adpcm",               MUSIC_ADPCM_WAV, MUSIC_ADPCM_WAV_SIZE, dmSound::SOUND_DATA_TYPE_WAV, 0, 0, 64, 44100, 1.0f, false},
+    {"ogg_16",              AMBIENCE_OGG, AMBIENCE_OGG_SIZE, dmSound::SOUND_DATA_TYPE_OGG_VORBIS, EXPLOSION_OGG, EXPLOSION_OGG_SIZE, 16, 44100, 1.0f, false},
+    {"ogg_64",              AMBIENCE_OGG, AMBIENCE_OGG_SIZE, dmSound::SOUND_DATA_TYPE_OGG_VORBIS, EXPLOSION_OGG, EXPLOSION_OGG_SIZE, 64, 44100, 1.0f, false},
+    {"opus_16",             AMBIENCE_OPUS, AMBIENCE_OPUS_SIZE, dmSound::SOUND_DATA_TYPE_OPUS, EXPLOSION_OPUS, EXPLOSION_OPUS_SIZE, 16, 44100, 1.0f, false},
+    {"opus_64",             AMBIENCE_OPUS, AMBIENCE_OPUS_SIZE, dmSound::SOUND_DATA_TYPE_OPUS, EXPLOSION_OPUS, EXPLOSION_OPUS_SIZE, 64, 44100, 1.0f, false},
+};
+INSTANTIATE_TEST_CASE_P(dmSoundMixerBenchmark, dmSoundMixerBenchmark, jc_test_values_in(params_mixer_benchmark));
+
+// Rendering the same scene twice must give the same output, so the renders can be compared across changes
+TEST(SoundMixerBenchmark, Deterministic)
+{
+    const MixerBenchmarkParams& p = params_mixer_benchmark[7]; // ogg, 64 voices
+
+    MixerBenchmarkResult results[2];
+    RunMixerBenchmark(p, 1.0f, &results[0]);
+    RunMixerBenchmark(p, 1.0f, &results[1]);
+    ASSERT_EQ(results[0].m_FrameCount, results[1].m_FrameCount);
+    ASSERT_EQ(results[0].m_Hash, results[1].m_Hash);
+}
+
+extern "C" void dmExportedSymbols();
+
+int main(int argc, char **argv)
+{
+    dmExportedSymbols();
+
+    // Remove our own options before handing the rest over to jc_test
+    int out = 1;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--output-dir") == 0 && i + 1 < argc)
+        {
+            g_OutputDir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+        {
+            g_RenderSeconds = (float)atof(argv[++i]);
+        }
+        else
+        {
+            argv[out++] = argv[i];
+        }
+    }
+    argc = out;
+
+    jc_test_init(&argc, argv);
+    return jc_test_run_all();
+}